@@ -0,0 +1,66 @@
+#include "AssetRegistry.h"
+
+#include <wctype.h>
+
+// --------------------------------------------------------
+// Normalizes a path so that different ways of writing the
+// same one give the same key
+//
+// path - The path to normalize
+// --------------------------------------------------------
+std::wstring NormalizeAssetPath(const std::wstring& path)
+{
+	// Split into parts, resolving "." and ".." along the way
+	std::vector<std::wstring> parts;
+	std::wstring part;
+	for (size_t i = 0; i <= path.size(); i++)
+	{
+		wchar_t c = i < path.size() ? path[i] : L'\\';
+		if (c != L'\\' && c != L'/')
+		{
+			part += (wchar_t)towlower(c);
+			continue;
+		}
+
+		// Only a ".." past the start of a relative path stays
+		if (part == L"..")
+		{
+			if (!parts.empty() && parts.back() != L"..")
+				parts.pop_back();
+			else
+				parts.push_back(part);
+		}
+		else if (part != L"." && (!part.empty() || parts.empty()))
+		{
+			parts.push_back(part); // Keeps a leading empty part (from "\\server" or "/")
+		}
+		part.clear();
+	}
+
+	std::wstring normalized;
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		if (i > 0)
+			normalized += L'\\';
+		normalized += parts[i];
+	}
+	return normalized;
+}
+
+// --------------------------------------------------------
+// Hashes bytes using 64-bit FNV-1a
+//
+// data - The bytes to hash
+// size - Number of bytes
+// hash - Where to start (an earlier result, to continue it)
+// --------------------------------------------------------
+unsigned long long HashAssetData(const void* data, size_t size, unsigned long long hash)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
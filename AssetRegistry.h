@@ -0,0 +1,182 @@
+#pragma once
+
+#include <stddef.h>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Makes equivalent paths to the same file match: lower case,
+// backslashes only, and no "." or ".." parts
+std::wstring NormalizeAssetPath(const std::wstring& path);
+
+// Hashes asset contents using 64-bit FNV-1a, optionally
+// continuing from an earlier hash
+unsigned long long HashAssetData(const void* data, size_t size, unsigned long long hash = 14695981039346656037ULL);
+
+// How many references there are to an asset, including the
+// registry's own (other handle types provide their own)
+template<typename T>
+long GetAssetReferenceCount(const std::shared_ptr<T>& handle)
+{
+	return handle.use_count();
+}
+
+// --------------------------------------------------------
+// Totals for a registry, since it was created
+// --------------------------------------------------------
+struct AssetRegistryStats
+{
+	unsigned int EntryCount = 0;
+	size_t Bytes = 0;				// Of every entry
+	size_t Budget = 0;
+	unsigned int PathHits = 0;		// Found by (normalized) path
+	unsigned int HashHits = 0;		// Found by contents, under another path
+	unsigned int Misses = 0;		// Not found, so loaded and added
+	unsigned int Evictions = 0;
+};
+
+// --------------------------------------------------------
+// Shares loaded assets, so each is only loaded once no
+// matter how many things use it.  Assets are found by a
+// key (a normalized path, plus anything else that changes
+// the result) or by a hash of their contents, which
+// catches copies of the same file under different names.
+//
+// Handles are reference counted, and the registry holds
+// one reference itself.  Assets only it references are
+// kept for reuse, but the least recently used are evicted
+// once everything is over the memory budget.  Assets in
+// use are never evicted, so the budget can be exceeded.
+//
+// Has no knowledge of Direct3D, so it can be exercised on
+// its own.  Not thread safe.
+// --------------------------------------------------------
+template<typename Handle>
+class AssetRegistry
+{
+public:
+	AssetRegistry(size_t budget)
+	{
+		stats.Budget = budget;
+	}
+
+	// Finds an asset by key, returning false if there isn't one
+	bool Find(const std::wstring& key, Handle* handle)
+	{
+		auto found = byKey.find(key);
+		if (found == byKey.end())
+			return false;
+
+		stats.PathHits++;
+		*handle = Touch(found->second)->Asset;
+		return true;
+	}
+
+	// Finds an asset by contents, which is then also found by
+	// the given key from now on.  A hash of zero never matches,
+	// and neither does an asset of another size, so a collision
+	// can't hand out the wrong asset.
+	bool FindByHash(unsigned long long hash, size_t bytes, const std::wstring& key, Handle* handle)
+	{
+		auto found = byHash.find(hash);
+		if (hash == 0 || found == byHash.end() || found->second->Bytes != bytes)
+			return false;
+
+		stats.HashHits++;
+		byKey[key] = found->second;
+		found->second->Keys.push_back(key);
+		*handle = Touch(found->second)->Asset;
+		return true;
+	}
+
+	// Adds a newly loaded asset (hash is zero if unknown), then
+	// evicts whatever it can if that goes over the budget
+	void Add(const std::wstring& key, unsigned long long hash, const Handle& handle, size_t bytes)
+	{
+		Entry entry;
+		entry.Asset = handle;
+		entry.Hash = hash;
+		entry.Bytes = bytes;
+		entry.Keys.push_back(key);
+		entries.push_front(entry);
+
+		byKey[key] = entries.begin();
+		if (hash != 0)
+			byHash[hash] = entries.begin();
+
+		stats.Misses++;
+		stats.EntryCount++;
+		stats.Bytes += bytes;
+		Trim();
+	}
+
+	// Evicts unreferenced assets, least recently used first,
+	// until everything fits the budget (or nothing else can go)
+	void Trim()
+	{
+		auto entry = entries.end();
+		while (stats.Bytes > stats.Budget && entry != entries.begin())
+		{
+			--entry;
+			if (GetAssetReferenceCount(entry->Asset) > 1)
+				continue;
+
+			stats.Evictions++;
+			entry = Remove(entry);
+		}
+	}
+
+	// Forgets every asset, though any in use stay alive
+	// until they're released
+	void Clear()
+	{
+		entries.clear();
+		byKey.clear();
+		byHash.clear();
+		stats.EntryCount = 0;
+		stats.Bytes = 0;
+	}
+
+	void SetBudget(size_t budget) { stats.Budget = budget; Trim(); }
+	AssetRegistryStats GetStats() { return stats; }
+
+private:
+	struct Entry
+	{
+		Handle Asset;
+		unsigned long long Hash;
+		size_t Bytes;
+		std::vector<std::wstring> Keys;
+	};
+	typedef typename std::list<Entry>::iterator EntryIterator;
+
+	// Most recently used first
+	std::list<Entry> entries;
+	std::unordered_map<std::wstring, EntryIterator> byKey;
+	std::unordered_map<unsigned long long, EntryIterator> byHash;
+
+	AssetRegistryStats stats;
+
+	// Marks an entry as the most recently used
+	EntryIterator Touch(EntryIterator entry)
+	{
+		entries.splice(entries.begin(), entries, entry);
+		return entries.begin();
+	}
+
+	// Removes an entry, returning the one after it
+	EntryIterator Remove(EntryIterator entry)
+	{
+		for (auto& key : entry->Keys)
+			byKey.erase(key);
+		auto hash = byHash.find(entry->Hash);
+		if (hash != byHash.end() && hash->second == entry)
+			byHash.erase(hash);
+
+		stats.EntryCount--;
+		stats.Bytes -= entry->Bytes;
+		return entries.erase(entry);
+	}
+};
@@ -0,0 +1,103 @@
+#include "BindingFilter.h"
+
+#include <string.h>
+
+// --------------------------------------------------------
+// Starts with no known bindings
+// --------------------------------------------------------
+BindingFilter::BindingFilter()
+{
+	Invalidate();
+	ResetStats();
+}
+
+// --------------------------------------------------------
+// Checks an object against what is already bound to a slot
+//
+// stage         - One of the BINDING_STAGE_ values
+// type          - One of the BINDING_TYPE_ values
+// slot          - Register of the binding (0 for shaders and
+//                 input layouts)
+// object        - The object being bound (may be null)
+// firstConstant - First constant of a buffer range, if any
+// numConstants  - Number of constants in the range, if any
+//
+// Returns true if the bind call is needed.  Slots outside
+// the tracked range are always reported as needed.
+// --------------------------------------------------------
+bool BindingFilter::ShouldBind(
+	unsigned int stage,
+	unsigned int type,
+	unsigned int slot,
+	const void* object,
+	unsigned int firstConstant,
+	unsigned int numConstants)
+{
+	Binding* binding = FindBinding(stage, type, slot);
+	if (binding == 0)
+		return true;
+
+	// Already bound?
+	if (binding->Known &&
+		binding->Object == object &&
+		binding->FirstConstant == firstConstant &&
+		binding->NumConstants == numConstants)
+	{
+		filtered++;
+		filteredByType[type]++;
+		return false;
+	}
+
+	// Remember the new binding
+	binding->Object = object;
+	binding->FirstConstant = firstConstant;
+	binding->NumConstants = numConstants;
+	binding->Known = true;
+
+	issued++;
+	issuedByType[type]++;
+	return true;
+}
+
+// --------------------------------------------------------
+// Forgets every binding, so the next bind of each slot is
+// always issued.  Use whenever state may have been changed
+// without going through the filter.
+// --------------------------------------------------------
+void BindingFilter::Invalidate()
+{
+	memset(stages, 0, sizeof(stages));
+}
+
+// --------------------------------------------------------
+// Resets the issued and filtered counters
+// --------------------------------------------------------
+void BindingFilter::ResetStats()
+{
+	issued = 0;
+	filtered = 0;
+	memset(issuedByType, 0, sizeof(issuedByType));
+	memset(filteredByType, 0, sizeof(filteredByType));
+}
+
+// --------------------------------------------------------
+// Helper for finding the storage of a particular slot
+//
+// Returns null if the stage, type or slot is out of range
+// --------------------------------------------------------
+BindingFilter::Binding* BindingFilter::FindBinding(unsigned int stage, unsigned int type, unsigned int slot)
+{
+	if (stage >= BINDING_STAGE_COUNT)
+		return 0;
+
+	StageBindings& s = stages[stage];
+	switch (type)
+	{
+	case BINDING_TYPE_SHADER:			return slot == 0 ? &s.Shader : 0;
+	case BINDING_TYPE_INPUT_LAYOUT:		return slot == 0 ? &s.InputLayout : 0;
+	case BINDING_TYPE_SHADER_RESOURCE:	return slot < BINDING_SLOTS_SHADER_RESOURCE ? &s.ShaderResources[slot] : 0;
+	case BINDING_TYPE_SAMPLER:			return slot < BINDING_SLOTS_SAMPLER ? &s.Samplers[slot] : 0;
+	case BINDING_TYPE_CONSTANT_BUFFER:	return slot < BINDING_SLOTS_CONSTANT_BUFFER ? &s.ConstantBuffers[slot] : 0;
+	default:							return 0;
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+// Pipeline stages that bindings are tracked for
+#define BINDING_STAGE_VERTEX	0
+#define BINDING_STAGE_PIXEL		1
+#define BINDING_STAGE_DOMAIN	2
+#define BINDING_STAGE_HULL		3
+#define BINDING_STAGE_GEOMETRY	4
+#define BINDING_STAGE_COMPUTE	5
+#define BINDING_STAGE_COUNT		6
+
+// Kinds of objects that can be bound to a stage
+#define BINDING_TYPE_SHADER				0
+#define BINDING_TYPE_INPUT_LAYOUT		1
+#define BINDING_TYPE_SHADER_RESOURCE	2
+#define BINDING_TYPE_SAMPLER			3
+#define BINDING_TYPE_CONSTANT_BUFFER	4
+#define BINDING_TYPE_COUNT				5
+
+// Slots per stage for each kind of binding (matching
+// the D3D11 limits for SRVs, samplers and cbuffers)
+#define BINDING_SLOTS_SHADER_RESOURCE	128
+#define BINDING_SLOTS_SAMPLER			16
+#define BINDING_SLOTS_CONSTANT_BUFFER	14
+
+// --------------------------------------------------------
+// Remembers what is currently bound to each slot of each
+// pipeline stage, so redundant bind calls can be skipped.
+//
+// This knows nothing about the graphics API; objects are
+// identified purely by address (and, for ranges of larger
+// constant buffers, the first constant and count).  Anything
+// that binds state without going through the filter (UI
+// rendering, for instance), or releasing an object whose
+// address might be reused, requires a call to Invalidate().
+// --------------------------------------------------------
+class BindingFilter
+{
+public:
+	BindingFilter();
+
+	// Returns true if the object must actually be bound, and
+	// records it as bound; returns false if it already is
+	bool ShouldBind(
+		unsigned int stage,
+		unsigned int type,
+		unsigned int slot,
+		const void* object,
+		unsigned int firstConstant = 0,
+		unsigned int numConstants = 0);
+
+	void Invalidate();
+	void ResetStats();
+
+	unsigned int GetIssuedCount() const { return issued; }
+	unsigned int GetFilteredCount() const { return filtered; }
+	unsigned int GetIssuedCount(unsigned int type) const { return type < BINDING_TYPE_COUNT ? issuedByType[type] : 0; }
+	unsigned int GetFilteredCount(unsigned int type) const { return type < BINDING_TYPE_COUNT ? filteredByType[type] : 0; }
+
+private:
+	// A single tracked slot
+	struct Binding
+	{
+		const void* Object;
+		unsigned int FirstConstant;
+		unsigned int NumConstants;
+		bool Known; // False until something goes through the filter
+	};
+
+	// Per-stage storage for every kind of slot
+	struct StageBindings
+	{
+		Binding Shader;
+		Binding InputLayout;
+		Binding ShaderResources[BINDING_SLOTS_SHADER_RESOURCE];
+		Binding Samplers[BINDING_SLOTS_SAMPLER];
+		Binding ConstantBuffers[BINDING_SLOTS_CONSTANT_BUFFER];
+	};
+
+	StageBindings stages[BINDING_STAGE_COUNT];
+
+	// Statistics since the last reset
+	unsigned int issued;
+	unsigned int filtered;
+	unsigned int issuedByType[BINDING_TYPE_COUNT];
+	unsigned int filteredByType[BINDING_TYPE_COUNT];
+
+	Binding* FindBinding(unsigned int stage, unsigned int type, unsigned int slot);
+};
@@ -0,0 +1,24 @@
+// Include guard
+#ifndef _CLUSTERING_HLSL
+#define _CLUSTERING_HLSL
+
+// Size of the view-space cluster grid
+// Must match definitions in LightClusters.h
+#define CLUSTER_GRID_X	16
+#define CLUSTER_GRID_Y	9
+#define CLUSTER_GRID_Z	24
+
+// Finds the cluster (screen tile and exponential depth slice)
+// that a pixel falls in, matching the CPU-side grid
+uint GetClusterIndex(float2 screenPos, float viewDepth, float2 screenSize, float depthScale, float depthBias)
+{
+	uint2 tile = min(
+		(uint2)(screenPos / screenSize * float2(CLUSTER_GRID_X, CLUSTER_GRID_Y)),
+		uint2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+
+	int slice = clamp((int)floor(log(viewDepth) * depthScale + depthBias), 0, CLUSTER_GRID_Z - 1);
+
+	return tile.x + tile.y * CLUSTER_GRID_X + slice * CLUSTER_GRID_X * CLUSTER_GRID_Y;
+}
+
+#endif
@@ -0,0 +1,343 @@
+#include "CommandRecording.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <memory>
+
+// --------------------------------------------------------
+// Splits a list of draws into contiguous batches, one per
+// context at most.  Small lists get fewer batches, as each
+// batch has a fixed cost (setting up the context's state,
+// then finishing and executing its command list).
+//
+// drawCount    - Draws to split
+// contextCount - Contexts available to record on
+// minBatchSize - Fewest draws worth giving a batch
+// batches      - Receives the batches, in draw order
+// --------------------------------------------------------
+void PlanCommandBatches(unsigned int drawCount, unsigned int contextCount, unsigned int minBatchSize, std::vector<CommandBatch>* batches)
+{
+	batches->clear();
+	if (drawCount == 0 || contextCount == 0)
+		return;
+
+	unsigned int batchCount = (std::min)(contextCount, drawCount / (std::max)(minBatchSize, 1u));
+	batchCount = (std::max)(batchCount, 1u);
+
+	// Evenly sized batches, the first few one larger
+	unsigned int batchSize = drawCount / batchCount;
+	unsigned int remainder = drawCount % batchCount;
+	unsigned int start = 0;
+	for (unsigned int b = 0; b < batchCount; b++)
+	{
+		CommandBatch batch;
+		batch.Start = start;
+		batch.End = start + batchSize + (b < remainder ? 1 : 0);
+		batch.Context = b;
+		batches->push_back(batch);
+		start = batch.End;
+	}
+}
+
+// Records one batch from start to finish on its context
+static void RecordBatch(ICommandRecorder* recorder, const CommandBatch& batch, unsigned int index)
+{
+	PROFILE_SCOPE("Record Batch");
+	recorder->BeginBatch(batch.Context);
+	for (unsigned int d = batch.Start; d < batch.End; d++)
+		recorder->RecordDraw(batch.Context, d);
+	recorder->FinishBatch(batch.Context, index);
+}
+
+// --------------------------------------------------------
+// Records batches in parallel and executes them in order.
+// Every batch but the first is a job; the calling thread
+// records the first itself, executes it, then waits for
+// each of the others in turn (running jobs while it does),
+// so earlier batches execute while later ones still record.
+//
+// jobs     - System to record on
+// batches  - Batches to record, each on a different context
+// recorder - Does the actual recording and executing
+// --------------------------------------------------------
+void RecordCommandBatches(JobSystem& jobs, const std::vector<CommandBatch>& batches, ICommandRecorder* recorder)
+{
+	if (batches.empty())
+		return;
+
+	std::vector<std::unique_ptr<JobCounter>> counters;
+	for (unsigned int b = 1; b < batches.size(); b++)
+	{
+		counters.push_back(std::unique_ptr<JobCounter>(new JobCounter()));
+		const CommandBatch* batch = &batches[b];
+		jobs.Run([recorder, batch, b]() { RecordBatch(recorder, *batch, b); }, counters.back().get());
+	}
+
+	RecordBatch(recorder, batches[0], 0);
+	recorder->ExecuteBatch(0);
+
+	for (unsigned int b = 1; b < batches.size(); b++)
+	{
+		jobs.Wait(counters[b - 1].get());
+		recorder->ExecuteBatch(b);
+	}
+}
+
+
+// === VALIDATION ===================================================
+
+// Busy work that can't be optimized away
+static unsigned int Spin(unsigned int seed, unsigned int iterations)
+{
+	for (unsigned int i = 0; i < iterations; i++)
+		seed = seed * 1664525u + 1013904223u;
+	return seed;
+}
+
+// --------------------------------------------------------
+// Stands in for deferred contexts, checking every call it
+// gets: that contexts are never used by two threads at
+// once, that each batch records its draws in order, and
+// that batches execute in order on the recording thread
+// once they're finished.  Executing a batch appends its
+// draws to a single stream, as the immediate context would.
+// --------------------------------------------------------
+class MockCommandRecorder : public ICommandRecorder
+{
+public:
+	MockCommandRecorder(unsigned int contextCount, const std::vector<unsigned int>* drawCosts) :
+		drawCosts(drawCosts),
+		valid(true),
+		nextBatch(0),
+		executingThread(std::this_thread::get_id())
+	{
+		for (unsigned int c = 0; c < contextCount; c++)
+			contexts.push_back(std::unique_ptr<MockContext>(new MockContext()));
+	}
+
+	// Starts a new frame of the given number of batches,
+	// keeping the contexts (and whatever they last recorded)
+	void BeginFrame(unsigned int batchCount)
+	{
+		lists.assign(batchCount, std::vector<unsigned int>());
+		finished.assign(batchCount, 0);
+		nextBatch = 0;
+		executed.clear();
+	}
+
+	void BeginBatch(unsigned int context)
+	{
+		MockContext& c = *contexts[context];
+		if (c.Users.fetch_add(1) != 0 || c.Open)
+			valid = false;
+		c.Open = true;
+		c.Draws.clear();
+	}
+
+	void RecordDraw(unsigned int context, unsigned int draw)
+	{
+		MockContext& c = *contexts[context];
+		if (!c.Open || (!c.Draws.empty() && draw != c.Draws.back() + 1))
+			valid = false;
+		c.Draws.push_back(draw);
+		c.Work += Spin(draw, (*drawCosts)[draw]);
+	}
+
+	void FinishBatch(unsigned int context, unsigned int batch)
+	{
+		MockContext& c = *contexts[context];
+		if (!c.Open || batch >= lists.size())
+		{
+			valid = false;
+			return;
+		}
+		lists[batch].swap(c.Draws);
+		finished[batch] = 1;
+		c.Open = false;
+		c.Users--;
+	}
+
+	void ExecuteBatch(unsigned int batch)
+	{
+		if (std::this_thread::get_id() != executingThread ||
+			batch != nextBatch ||
+			batch >= lists.size() ||
+			!finished[batch])
+		{
+			valid = false;
+			return;
+		}
+		executed.insert(executed.end(), lists[batch].begin(), lists[batch].end());
+		nextBatch++;
+	}
+
+	// Did the frame execute exactly the given draws, in order?
+	bool FrameIsValid(unsigned int drawCount)
+	{
+		if (!valid || nextBatch != lists.size() || executed.size() != drawCount)
+			return false;
+		for (unsigned int d = 0; d < drawCount; d++)
+		{
+			if (executed[d] != d)
+				return false;
+		}
+		return true;
+	}
+
+private:
+	struct MockContext
+	{
+		std::atomic<int> Users;
+		bool Open;
+		std::vector<unsigned int> Draws;
+		unsigned int Work;
+
+		MockContext() : Users(0), Open(false), Work(0) {}
+	};
+
+	const std::vector<unsigned int>* drawCosts;
+	std::vector<std::unique_ptr<MockContext>> contexts;
+	std::atomic<bool> valid;
+
+	// Per batch: what it recorded, and whether it's done.
+	// Finished flags are written by the recording thread, but
+	// only read after waiting on that batch's job.
+	std::vector<std::vector<unsigned int>> lists;
+	std::vector<char> finished;
+
+	// Executing
+	unsigned int nextBatch;
+	std::thread::id executingThread;
+	std::vector<unsigned int> executed;
+};
+
+// Records a frame of draws with the given costs on a mock,
+// returning whether everything happened as it should
+static bool RecordMockFrame(JobSystem& jobs, MockCommandRecorder& recorder, unsigned int contextCount, unsigned int minBatchSize, const std::vector<unsigned int>& costs)
+{
+	std::vector<CommandBatch> batches;
+	PlanCommandBatches((unsigned int)costs.size(), contextCount, minBatchSize, &batches);
+
+	recorder.BeginFrame((unsigned int)batches.size());
+	RecordCommandBatches(jobs, batches, &recorder);
+	return recorder.FrameIsValid((unsigned int)costs.size());
+}
+
+// Batches must cover every draw exactly once, in order, on
+// distinct contexts, and be as even as possible
+static bool TestPlanning(JobSystem&)
+{
+	const unsigned int drawCounts[] = { 0, 1, 2, 7, 64, 1000, 100003 };
+	const unsigned int contextCounts[] = { 1, 2, 3, 8, 64 };
+	const unsigned int minSizes[] = { 0, 1, 16, 256 };
+
+	std::vector<CommandBatch> batches;
+	for (unsigned int draws : drawCounts)
+	{
+		for (unsigned int contexts : contextCounts)
+		{
+			for (unsigned int minSize : minSizes)
+			{
+				PlanCommandBatches(draws, contexts, minSize, &batches);
+				if (draws == 0)
+				{
+					if (!batches.empty())
+						return false;
+					continue;
+				}
+				if (batches.empty() || batches.size() > contexts)
+					return false;
+
+				unsigned int expectedStart = 0;
+				unsigned int smallest = draws;
+				unsigned int largest = 0;
+				for (unsigned int b = 0; b < batches.size(); b++)
+				{
+					const CommandBatch& batch = batches[b];
+					if (batch.Start != expectedStart || batch.End <= batch.Start || batch.Context != b)
+						return false;
+					smallest = (std::min)(smallest, batch.End - batch.Start);
+					largest = (std::max)(largest, batch.End - batch.Start);
+					expectedStart = batch.End;
+				}
+				if (expectedStart != draws || largest - smallest > 1)
+					return false;
+				if (batches.size() > 1 && smallest < minSize)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Cheap, even draws across various list and context counts
+static bool TestOrdering(JobSystem& jobs)
+{
+	const unsigned int drawCounts[] = { 0, 1, 5, 100, 4000 };
+	const unsigned int contextCounts[] = { 1, 2, jobs.GetThreadCount(), jobs.GetThreadCount() * 2 + 1 };
+	for (unsigned int draws : drawCounts)
+	{
+		std::vector<unsigned int> costs(draws, 50);
+		for (unsigned int contexts : contextCounts)
+		{
+			MockCommandRecorder recorder(contexts, &costs);
+			if (!RecordMockFrame(jobs, recorder, contexts, 1, costs))
+				return false;
+		}
+	}
+	return true;
+}
+
+// The first draws are far slower, so later batches finish
+// recording long before the earlier ones, but must still
+// wait their turn to execute
+static bool TestUnevenDraws(JobSystem& jobs)
+{
+	const unsigned int draws = 2000;
+	std::vector<unsigned int> costs(draws);
+	for (unsigned int d = 0; d < draws; d++)
+		costs[d] = d < draws / 4 ? 5000 : 10;
+
+	unsigned int contexts = jobs.GetThreadCount() * 2;
+	MockCommandRecorder recorder(contexts, &costs);
+	return RecordMockFrame(jobs, recorder, contexts, 1, costs);
+}
+
+// The same contexts reused frame after frame, with draw
+// counts that change from one frame to the next
+static bool TestFrames(JobSystem& jobs)
+{
+	const unsigned int contexts = 4;
+	std::vector<unsigned int> costs(0);
+	MockCommandRecorder recorder(contexts, &costs);
+
+	unsigned int seed = 1;
+	for (unsigned int frame = 0; frame < 100; frame++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		costs.assign((seed >> 16) % 300, 20);
+		if (!RecordMockFrame(jobs, recorder, contexts, 8, costs))
+			return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Runs each validation test for a number of rounds,
+// stopping a test at its first failure
+//
+// jobs    - System to record with, created on the calling
+//           thread (which executes the batches)
+// rounds  - Times to repeat each test
+// results - Receives a result per test
+// --------------------------------------------------------
+void RunCommandRecordingValidation(JobSystem& jobs, unsigned int rounds, std::vector<ValidationResult>* results)
+{
+	const ValidationTest<JobSystem&> tests[] = {
+		{ "Planning", TestPlanning },
+		{ "Ordering", TestOrdering },
+		{ "Uneven Draws", TestUnevenDraws },
+		{ "Frames", TestFrames } };
+
+	RunValidationTests(tests, rounds, results, jobs);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "Validation.h"
+
+#include <vector>
+
+// --------------------------------------------------------
+// A contiguous run of draws, recorded on one context
+// --------------------------------------------------------
+struct CommandBatch
+{
+	unsigned int Start;		// First draw of the batch
+	unsigned int End;		// One past its last draw
+	unsigned int Context;	// Which context records it
+};
+
+// --------------------------------------------------------
+// Something that can record draws on one of several
+// contexts and later replay what each batch recorded, like
+// D3D11 deferred contexts and their command lists.
+//
+// A context only ever records one batch at a time, but
+// different contexts record on different threads at once.
+// Executing always happens on the thread that started the
+// recording, in batch order.
+// --------------------------------------------------------
+class ICommandRecorder
+{
+public:
+	virtual ~ICommandRecorder() {}
+
+	virtual void BeginBatch(unsigned int context) = 0;
+	virtual void RecordDraw(unsigned int context, unsigned int draw) = 0;
+	virtual void FinishBatch(unsigned int context, unsigned int batch) = 0;
+	virtual void ExecuteBatch(unsigned int batch) = 0;
+};
+
+// Splits draws into at most one batch per context, with no
+// batch smaller than the given size unless there's only one
+void PlanCommandBatches(unsigned int drawCount, unsigned int contextCount, unsigned int minBatchSize, std::vector<CommandBatch>* batches);
+
+// Records every batch (each on its own context, with the
+// calling thread taking the first) and executes them in
+// order as they finish.  Returns once all have executed.
+void RecordCommandBatches(JobSystem& jobs, const std::vector<CommandBatch>& batches, ICommandRecorder* recorder);
+
+// Checks batch planning, and the ordering and exclusivity of
+// recording against a mock recorder that checks every call
+void RunCommandRecordingValidation(JobSystem& jobs, unsigned int rounds, std::vector<ValidationResult>* results);
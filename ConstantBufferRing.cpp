@@ -0,0 +1,108 @@
+#include "ConstantBufferRing.h"
+
+#include <string.h>
+
+// --------------------------------------------------------
+// Creates the dynamic buffer backing the ring and checks
+// whether the device can actually use it
+//
+// device      - Used to create the buffer and check features
+// context     - Must be convertible to an 11.1 context
+// sizeInBytes - Total size of the ring (max 64 KB per draw)
+// --------------------------------------------------------
+ConstantBufferRing::ConstantBufferRing(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	unsigned int sizeInBytes)
+	:
+	supported(false),
+	discardPending(false),
+	allocator(sizeInBytes, CONSTANT_BUFFER_RING_ALIGNMENT)
+{
+	// Offset binding requires the 11.1 version of the context
+	if (FAILED(context.As(&context1)))
+		return;
+
+	// The driver must support both offsets and NO_OVERWRITE
+	// maps of dynamic constant buffers
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+	if (!options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer)
+		return;
+
+	// Create the actual buffer
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = allocator.GetCapacity();
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	HRESULT hr = device->CreateBuffer(&desc, 0, buffer.GetAddressOf());
+
+	supported = SUCCEEDED(hr);
+}
+
+// --------------------------------------------------------
+// Makes room for several uploads that are used together
+// (like all of a draw's constants), wrapping now rather than
+// partway through them.  Otherwise the wrap's discard would
+// throw away the ranges already uploaded and bound.
+//
+// size - Total aligned size of the uploads to follow
+//
+// Returns false if they can't all fit in the ring
+// --------------------------------------------------------
+bool ConstantBufferRing::Reserve(unsigned int size)
+{
+	if (!supported)
+		return false;
+
+	// The discard waits for the next map
+	bool wrapped = false;
+	if (!allocator.Reserve(size, &wrapped))
+		return false;
+	discardPending = discardPending || wrapped;
+	return true;
+}
+
+// --------------------------------------------------------
+// Copies data into a fresh range of the ring
+//
+// data       - The constant data to copy
+// size       - Number of bytes of data
+// allocation - Receives the range (for binding)
+//
+// Returns true if the data was copied
+// --------------------------------------------------------
+bool ConstantBufferRing::Upload(const void* data, unsigned int size, RingAllocation* allocation)
+{
+	if (!supported)
+		return false;
+
+	// Find room for the data
+	bool wrapped = false;
+	if (!allocator.Allocate(size, allocation, &wrapped))
+		return false;
+
+	// Discard the entire buffer when we wrap (here or in an
+	// earlier reservation), as the GPU may still be reading the
+	// older ranges, otherwise promise the driver we won't touch
+	// anything that's in use
+	bool discard = wrapped || discardPending;
+	discardPending = false;
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	HRESULT hr = context1->Map(
+		buffer.Get(),
+		0,
+		discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE,
+		0,
+		&mapped);
+	if (FAILED(hr))
+	{
+		allocator.Reset();
+		return false;
+	}
+
+	memcpy((unsigned char*)mapped.pData + allocation->Offset, data, size);
+	context1->Unmap(buffer.Get(), 0);
+	return true;
+}
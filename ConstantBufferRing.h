@@ -0,0 +1,48 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <wrl/client.h>
+
+#include "RingAllocator.h"
+
+// --------------------------------------------------------
+// A large dynamic constant buffer that per-draw constants
+// are suballocated from.  Uploads use Map(NO_OVERWRITE) and
+// Map(DISCARD) whenever the ring wraps, and the resulting
+// ranges are bound using the *SetConstantBuffers1() methods
+// of the D3D 11.1 context.
+//
+// A wrap discards every range bound so far, so anything that
+// uploads several ranges for one draw should Reserve() their
+// total first.
+//
+// Check IsSupported() before use: offset binding requires
+// the 11.1 runtime and driver support, which is not
+// guaranteed on feature level 11.0 hardware.
+// --------------------------------------------------------
+class ConstantBufferRing
+{
+public:
+	ConstantBufferRing(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		unsigned int sizeInBytes);
+
+	bool IsSupported() { return supported; }
+	bool Reserve(unsigned int size);
+	bool Upload(const void* data, unsigned int size, RingAllocation* allocation);
+	bool IsAllocationValid(const RingAllocation& allocation) const { return allocator.IsAllocationValid(allocation); }
+	void BeginFrame() { allocator.BeginFrame(); }
+
+	ID3D11Buffer* GetBuffer() { return buffer.Get(); }
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> GetContext1() { return context1; }
+	const RingAllocator& GetAllocator() const { return allocator; }
+
+private:
+	bool supported;
+	bool discardPending;
+	RingAllocator allocator;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> context1;
+};
@@ -0,0 +1,294 @@
+#include "D3D11RenderDevice.h"
+
+#include <string.h>
+
+// --------------------------------------------------------
+// Wraps a device and one of its contexts
+// --------------------------------------------------------
+D3D11RenderDevice::D3D11RenderDevice(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) :
+	device(device),
+	context(context)
+{
+	// Null if this isn't an 11.1 runtime, which only matters
+	// for binding ranges of constant buffers
+	context.As(&context1);
+
+	// Nothing here draws anything but triangle lists
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+RenderHandle D3D11RenderDevice::CreateBuffer(const RenderBufferDesc& desc, const void* initialData)
+{
+	const UINT bindFlags[] = { D3D11_BIND_VERTEX_BUFFER, D3D11_BIND_INDEX_BUFFER, D3D11_BIND_CONSTANT_BUFFER };
+	if (desc.Type > RENDER_BUFFER_CONSTANT)
+		return 0;
+
+	D3D11_BUFFER_DESC bd = {};
+	bd.ByteWidth = desc.Type == RENDER_BUFFER_CONSTANT ? (desc.Size + 15) / 16 * 16 : desc.Size;
+	bd.BindFlags = bindFlags[desc.Type];
+	bd.Usage = desc.Dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
+	bd.CPUAccessFlags = desc.Dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
+
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = initialData;
+
+	ID3D11Buffer* buffer = 0;
+	device->CreateBuffer(&bd, initialData ? &data : 0, &buffer);
+	return GetHandle(buffer);
+}
+
+// The texture itself is only referenced by its view
+RenderHandle D3D11RenderDevice::CreateTexture(const RenderTextureDesc& desc, const void* pixels, unsigned int rowPitch)
+{
+	D3D11_TEXTURE2D_DESC td = {};
+	td.Width = desc.Width;
+	td.Height = desc.Height;
+	td.MipLevels = 1;
+	td.ArraySize = 1;
+	td.Format = desc.Format == RENDER_FORMAT_R32_FLOAT ? DXGI_FORMAT_R32_FLOAT : DXGI_FORMAT_R8G8B8A8_UNORM;
+	td.SampleDesc.Count = 1;
+	td.Usage = D3D11_USAGE_DEFAULT;
+	td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = pixels;
+	data.SysMemPitch = rowPitch;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(device->CreateTexture2D(&td, pixels ? &data : 0, texture.GetAddressOf())))
+		return 0;
+
+	ID3D11ShaderResourceView* srv = 0;
+	device->CreateShaderResourceView(texture.Get(), 0, &srv);
+	return GetHandle(srv);
+}
+
+RenderHandle D3D11RenderDevice::CreateShader(unsigned int stage, const void* bytecode, size_t size)
+{
+	if (stage == BINDING_STAGE_VERTEX)
+	{
+		ID3D11VertexShader* shader = 0;
+		device->CreateVertexShader(bytecode, size, 0, &shader);
+		return GetHandle(shader);
+	}
+	if (stage == BINDING_STAGE_PIXEL)
+	{
+		ID3D11PixelShader* shader = 0;
+		device->CreatePixelShader(bytecode, size, 0, &shader);
+		return GetHandle(shader);
+	}
+	return 0;
+}
+
+RenderHandle D3D11RenderDevice::CreateInputLayout(const RenderVertexElement* elements, unsigned int count, const void* vsBytecode, size_t size)
+{
+	const DXGI_FORMAT formats[] = { DXGI_FORMAT_R32G32_FLOAT, DXGI_FORMAT_R32G32B32_FLOAT, DXGI_FORMAT_R32G32B32A32_FLOAT };
+	if (count > D3D11_IA_VERTEX_INPUT_STRUCTURE_ELEMENT_COUNT)
+		return 0;
+
+	D3D11_INPUT_ELEMENT_DESC descs[D3D11_IA_VERTEX_INPUT_STRUCTURE_ELEMENT_COUNT] = {};
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (elements[i].Format > RENDER_ELEMENT_FLOAT4)
+			return 0;
+		descs[i].SemanticName = elements[i].Semantic;
+		descs[i].SemanticIndex = elements[i].SemanticIndex;
+		descs[i].Format = formats[elements[i].Format];
+		descs[i].AlignedByteOffset = elements[i].Offset;
+		descs[i].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+	}
+
+	ID3D11InputLayout* layout = 0;
+	device->CreateInputLayout(descs, count, vsBytecode, size, &layout);
+	return GetHandle(layout);
+}
+
+RenderHandle D3D11RenderDevice::CreateSampler(const RenderSamplerDesc& desc)
+{
+	const D3D11_FILTER filters[] = { D3D11_FILTER_MIN_MAG_MIP_POINT, D3D11_FILTER_MIN_MAG_MIP_LINEAR, D3D11_FILTER_ANISOTROPIC };
+	D3D11_TEXTURE_ADDRESS_MODE address = desc.Address == RENDER_ADDRESS_CLAMP ? D3D11_TEXTURE_ADDRESS_CLAMP : D3D11_TEXTURE_ADDRESS_WRAP;
+
+	D3D11_SAMPLER_DESC sd = {};
+	sd.Filter = filters[desc.Filter <= RENDER_FILTER_ANISOTROPIC ? desc.Filter : RENDER_FILTER_LINEAR];
+	sd.AddressU = address;
+	sd.AddressV = address;
+	sd.AddressW = address;
+	sd.MaxAnisotropy = desc.MaxAnisotropy;
+	sd.MaxLOD = D3D11_FLOAT32_MAX;
+
+	ID3D11SamplerState* sampler = 0;
+	device->CreateSamplerState(&sd, &sampler);
+	return GetHandle(sampler);
+}
+
+RenderHandle D3D11RenderDevice::CreateRasterizerState(const RenderRasterizerDesc& desc)
+{
+	const D3D11_CULL_MODE cullModes[] = { D3D11_CULL_NONE, D3D11_CULL_FRONT, D3D11_CULL_BACK };
+
+	D3D11_RASTERIZER_DESC rd = {};
+	rd.FillMode = desc.Wireframe ? D3D11_FILL_WIREFRAME : D3D11_FILL_SOLID;
+	rd.CullMode = cullModes[desc.CullMode <= RENDER_CULL_BACK ? desc.CullMode : RENDER_CULL_BACK];
+	rd.DepthClipEnable = true;
+
+	ID3D11RasterizerState* state = 0;
+	device->CreateRasterizerState(&rd, &state);
+	return GetHandle(state);
+}
+
+RenderHandle D3D11RenderDevice::CreateDepthStencilState(const RenderDepthStencilDesc& desc)
+{
+	D3D11_DEPTH_STENCIL_DESC dd = {};
+	dd.DepthEnable = desc.DepthTest;
+	dd.DepthWriteMask = desc.DepthWrite ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
+	dd.DepthFunc = desc.LessEqual ? D3D11_COMPARISON_LESS_EQUAL : D3D11_COMPARISON_LESS;
+
+	ID3D11DepthStencilState* state = 0;
+	device->CreateDepthStencilState(&dd, &state);
+	return GetHandle(state);
+}
+
+RenderHandle D3D11RenderDevice::CreateBlendState(const RenderBlendDesc& desc)
+{
+	D3D11_BLEND_DESC bd = {};
+	bd.RenderTarget[0].BlendEnable = desc.AlphaBlend;
+	bd.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+	bd.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+	bd.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	bd.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+	bd.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ZERO;
+	bd.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	bd.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+
+	ID3D11BlendState* state = 0;
+	device->CreateBlendState(&bd, &state);
+	return GetHandle(state);
+}
+
+// Every handle is a COM object, whatever its type
+void D3D11RenderDevice::Release(RenderHandle object)
+{
+	if (object)
+		FromHandle<IUnknown>(object)->Release();
+}
+
+// --------------------------------------------------------
+// Replaces a buffer's contents: discarding dynamic buffers,
+// and updating the others in place
+// --------------------------------------------------------
+void D3D11RenderDevice::UpdateBuffer(RenderHandle buffer, const void* data, unsigned int size)
+{
+	ID3D11Buffer* b = FromHandle<ID3D11Buffer>(buffer);
+	D3D11_BUFFER_DESC desc = {};
+	b->GetDesc(&desc);
+
+	if (desc.Usage != D3D11_USAGE_DYNAMIC)
+	{
+		context->UpdateSubresource(b, 0, 0, data, 0, 0);
+		return;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(b, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	memcpy(mapped.pData, data, size < desc.ByteWidth ? size : desc.ByteWidth);
+	context->Unmap(b, 0);
+}
+
+void D3D11RenderDevice::SetViewport(float x, float y, float width, float height)
+{
+	D3D11_VIEWPORT viewport = { x, y, width, height, 0.0f, 1.0f };
+	context->RSSetViewports(1, &viewport);
+}
+
+void D3D11RenderDevice::SetInputLayout(RenderHandle layout)
+{
+	context->IASetInputLayout(FromHandle<ID3D11InputLayout>(layout));
+}
+
+void D3D11RenderDevice::SetShader(unsigned int stage, RenderHandle shader)
+{
+	if (stage == BINDING_STAGE_VERTEX)
+		context->VSSetShader(FromHandle<ID3D11VertexShader>(shader), 0, 0);
+	else if (stage == BINDING_STAGE_PIXEL)
+		context->PSSetShader(FromHandle<ID3D11PixelShader>(shader), 0, 0);
+}
+
+// --------------------------------------------------------
+// Binds a constant buffer, or a range of one (in 16-byte
+// constants) using the 11.1 methods if available
+// --------------------------------------------------------
+void D3D11RenderDevice::SetConstantBuffer(unsigned int stage, unsigned int slot, RenderHandle buffer, unsigned int firstConstant, unsigned int numConstants)
+{
+	ID3D11Buffer* b = FromHandle<ID3D11Buffer>(buffer);
+	bool range = numConstants > 0 && context1;
+
+	if (stage == BINDING_STAGE_VERTEX)
+	{
+		if (range)
+			context1->VSSetConstantBuffers1(slot, 1, &b, &firstConstant, &numConstants);
+		else
+			context->VSSetConstantBuffers(slot, 1, &b);
+	}
+	else if (stage == BINDING_STAGE_PIXEL)
+	{
+		if (range)
+			context1->PSSetConstantBuffers1(slot, 1, &b, &firstConstant, &numConstants);
+		else
+			context->PSSetConstantBuffers(slot, 1, &b);
+	}
+}
+
+void D3D11RenderDevice::SetTexture(unsigned int stage, unsigned int slot, RenderHandle texture)
+{
+	ID3D11ShaderResourceView* srv = FromHandle<ID3D11ShaderResourceView>(texture);
+	if (stage == BINDING_STAGE_VERTEX)
+		context->VSSetShaderResources(slot, 1, &srv);
+	else if (stage == BINDING_STAGE_PIXEL)
+		context->PSSetShaderResources(slot, 1, &srv);
+}
+
+void D3D11RenderDevice::SetSampler(unsigned int stage, unsigned int slot, RenderHandle sampler)
+{
+	ID3D11SamplerState* s = FromHandle<ID3D11SamplerState>(sampler);
+	if (stage == BINDING_STAGE_VERTEX)
+		context->VSSetSamplers(slot, 1, &s);
+	else if (stage == BINDING_STAGE_PIXEL)
+		context->PSSetSamplers(slot, 1, &s);
+}
+
+void D3D11RenderDevice::SetVertexBuffer(RenderHandle buffer, unsigned int stride)
+{
+	ID3D11Buffer* b = FromHandle<ID3D11Buffer>(buffer);
+	UINT offset = 0;
+	context->IASetVertexBuffers(0, 1, &b, &stride, &offset);
+}
+
+void D3D11RenderDevice::SetIndexBuffer(RenderHandle buffer)
+{
+	context->IASetIndexBuffer(FromHandle<ID3D11Buffer>(buffer), DXGI_FORMAT_R32_UINT, 0);
+}
+
+void D3D11RenderDevice::SetRasterizerState(RenderHandle state)
+{
+	context->RSSetState(FromHandle<ID3D11RasterizerState>(state));
+}
+
+void D3D11RenderDevice::SetDepthStencilState(RenderHandle state)
+{
+	context->OMSetDepthStencilState(FromHandle<ID3D11DepthStencilState>(state), 0);
+}
+
+void D3D11RenderDevice::SetBlendState(RenderHandle state)
+{
+	context->OMSetBlendState(FromHandle<ID3D11BlendState>(state), 0, 0xFFFFFFFF);
+}
+
+void D3D11RenderDevice::Draw(unsigned int vertexCount, unsigned int startVertex)
+{
+	context->Draw(vertexCount, startVertex);
+}
+
+void D3D11RenderDevice::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <wrl/client.h>
+#include <stdint.h>
+
+#include "RenderDevice.h"
+
+// --------------------------------------------------------
+// The D3D11 backend.  Handles are the addresses of the D3D
+// objects themselves (textures are their shader resource
+// views), so objects made elsewhere can be used directly
+// through GetHandle() and created objects can be used with
+// D3D directly through FromHandle().
+//
+// Works on any context, immediate or deferred.  Binding
+// ranges of constant buffers needs an 11.1 context.  The
+// topology is set to triangle lists on creation, and must
+// be set again by anything clearing the context's state.
+// --------------------------------------------------------
+class D3D11RenderDevice : public IRenderDevice
+{
+public:
+	D3D11RenderDevice(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	template<typename T>
+	static RenderHandle GetHandle(T* object) { return (RenderHandle)(uintptr_t)object; }
+
+	template<typename T>
+	static T* FromHandle(RenderHandle handle) { return (T*)(uintptr_t)handle; }
+
+	ID3D11DeviceContext* GetContext() { return context.Get(); }
+
+	// IRenderDevice
+	RenderHandle CreateBuffer(const RenderBufferDesc& desc, const void* initialData);
+	RenderHandle CreateTexture(const RenderTextureDesc& desc, const void* pixels, unsigned int rowPitch);
+	RenderHandle CreateShader(unsigned int stage, const void* bytecode, size_t size);
+	RenderHandle CreateInputLayout(const RenderVertexElement* elements, unsigned int count, const void* vsBytecode, size_t size);
+	RenderHandle CreateSampler(const RenderSamplerDesc& desc);
+	RenderHandle CreateRasterizerState(const RenderRasterizerDesc& desc);
+	RenderHandle CreateDepthStencilState(const RenderDepthStencilDesc& desc);
+	RenderHandle CreateBlendState(const RenderBlendDesc& desc);
+	void Release(RenderHandle object);
+	void UpdateBuffer(RenderHandle buffer, const void* data, unsigned int size);
+
+	void SetViewport(float x, float y, float width, float height);
+	void SetInputLayout(RenderHandle layout);
+	void SetShader(unsigned int stage, RenderHandle shader);
+	void SetConstantBuffer(unsigned int stage, unsigned int slot, RenderHandle buffer, unsigned int firstConstant, unsigned int numConstants);
+	void SetTexture(unsigned int stage, unsigned int slot, RenderHandle texture);
+	void SetSampler(unsigned int stage, unsigned int slot, RenderHandle sampler);
+	void SetVertexBuffer(RenderHandle buffer, unsigned int stride);
+	void SetIndexBuffer(RenderHandle buffer);
+	void SetRasterizerState(RenderHandle state);
+	void SetDepthStencilState(RenderHandle state);
+	void SetBlendState(RenderHandle state);
+
+	void Draw(unsigned int vertexCount, unsigned int startVertex);
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> context1;
+};
@@ -1,5 +1,7 @@
 #include "DXCore.h"
 #include "Input.h"
+#include "Profiler.h"
+#include "JobSystem.h"
 #include "ImGui/imgui.h"
 #include "ImGui/imgui_impl_win32.h"
 
@@ -50,6 +52,10 @@ DXCore::DXCore(
 	dxFeatureLevel(D3D_FEATURE_LEVEL_11_0),
 	fpsTimeElapsed(0),
 	fpsFrameCount(0),
+	recordFrameStats(true),
+	useFixedTimestep(false),
+	frameEndTime(0),
+	messageTime(0),
 	previousTime(0),
 	currentTime(0),
 	hasFocus(true),
@@ -221,20 +227,47 @@ HRESULT DXCore::InitDirect3D()
 	// Result variable for below function calls
 	HRESULT hr = S_OK;
 
+	// Ask for 11.1 first (needed for things like constant buffer
+	// offsets), falling back to 11.0 and below if unavailable
+	D3D_FEATURE_LEVEL featureLevels[] =
+	{
+		D3D_FEATURE_LEVEL_11_1,
+		D3D_FEATURE_LEVEL_11_0,
+		D3D_FEATURE_LEVEL_10_1,
+		D3D_FEATURE_LEVEL_10_0
+	};
+	unsigned int featureLevelCount = ARRAYSIZE(featureLevels);
+
 	// Attempt to initialize Direct3D
 	hr = D3D11CreateDeviceAndSwapChain(
 		0,							// Video adapter (physical GPU) to use, or null for default
 		D3D_DRIVER_TYPE_HARDWARE,	// We want to use the hardware (GPU)
 		0,							// Used when doing software rendering
 		deviceFlags,				// Any special options
-		0,							// Optional array of possible verisons we want as fallbacks
-		0,							// The number of fallbacks in the above param
+		featureLevels,				// Optional array of possible verisons we want as fallbacks
+		featureLevelCount,			// The number of fallbacks in the above param
 		D3D11_SDK_VERSION,			// Current version of the SDK
 		&swapDesc,					// Address of swap chain options
 		swapChain.GetAddressOf(),	// Pointer to our Swap Chain pointer
 		device.GetAddressOf(),		// Pointer to our Device pointer
 		&dxFeatureLevel,			// This will hold the actual feature level the app will use
 		context.GetAddressOf());	// Pointer to our Device Context pointer
+
+	// A runtime without 11.1 support rejects the entire list,
+	// so try again without it
+	if (hr == E_INVALIDARG)
+	{
+		hr = D3D11CreateDeviceAndSwapChain(
+			0, D3D_DRIVER_TYPE_HARDWARE, 0, deviceFlags,
+			&featureLevels[1],
+			featureLevelCount - 1,
+			D3D11_SDK_VERSION,
+			&swapDesc,
+			swapChain.GetAddressOf(),
+			device.GetAddressOf(),
+			&dxFeatureLevel,
+			context.GetAddressOf());
+	}
 	if (FAILED(hr)) return hr;
 
 	// Create the Render Target View for the back buffer render target
@@ -401,6 +434,11 @@ void DXCore::OnResize()
 // --------------------------------------------------------
 HRESULT DXCore::Run()
 {
+	PROFILE_THREAD("Main");
+
+	// Jobs that need the immediate context come back to this thread
+	JobSystem::GetInstance().SetMainThread();
+
 	// Grab the start time now that
 	// the game loop is running
 	__int64 now = 0;
@@ -412,6 +450,9 @@ HRESULT DXCore::Run()
 	// Give subclass a chance to initialize
 	Init();
 
+	// The first frame starts once initialization is over
+	QueryPerformanceCounter((LARGE_INTEGER*)&frameEndTime);
+
 	// Our overall game and message loop
 	MSG msg = {};
 	while (msg.message != WM_QUIT)
@@ -419,13 +460,22 @@ HRESULT DXCore::Run()
 		// Determine if there is a message waiting
 		if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
 		{
+			__int64 messageStart = 0;
+			QueryPerformanceCounter((LARGE_INTEGER*)&messageStart);
+
 			// Translate and dispatch the message
 			// to our custom WindowProc function
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
+
+			__int64 messageEnd = 0;
+			QueryPerformanceCounter((LARGE_INTEGER*)&messageEnd);
+			messageTime += (messageEnd - messageStart) * perfCounterSeconds * 1000.0;
 		}
 		else
 		{
+			PROFILE_FRAME();
+
 			// Update timer and title bar (if necessary)
 			UpdateTimer();
 			if(titleBarStats)
@@ -434,9 +484,25 @@ HRESULT DXCore::Run()
 			// Update the input manager
 			Input::GetInstance().Update();
 
-			// The game loop
+			// Run anything other threads left for this one
+			JobSystem::GetInstance().RunMainThreadJobs();
+
+			// The game loop, timing each part
+			__int64 updateStart = 0;
+			__int64 drawStart = 0;
+			__int64 drawEnd = 0;
+			QueryPerformanceCounter((LARGE_INTEGER*)&updateStart);
+			if (useFixedTimestep)
+			{
+				fixedTimestep.Accumulate(deltaTime);
+				while (fixedTimestep.Step())
+					FixedUpdate((float)fixedTimestep.GetStepTime(), (float)fixedTimestep.GetSimulatedTime());
+			}
 			Update(deltaTime, totalTime);
+			QueryPerformanceCounter((LARGE_INTEGER*)&drawStart);
 			Draw(deltaTime, totalTime);
+			QueryPerformanceCounter((LARGE_INTEGER*)&drawEnd);
+			RecordFrame(updateStart, drawStart, drawEnd);
 
 			// Frame is over, notify the input manager
 			Input::GetInstance().EndOfFrame();
@@ -483,6 +549,30 @@ void DXCore::UpdateTimer()
 }
 
 
+// --------------------------------------------------------
+// Adds the frame that just finished to the frame stats,
+// then starts timing the next one
+//
+// updateStart - When Update() was called
+// drawStart   - When Draw() was called
+// drawEnd     - When Draw() returned
+// --------------------------------------------------------
+void DXCore::RecordFrame(__int64 updateStart, __int64 drawStart, __int64 drawEnd)
+{
+	double msPerCount = perfCounterSeconds * 1000.0;
+	currentFrame.Times[FRAME_STATS_TOTAL] = (drawEnd - frameEndTime) * msPerCount;
+	currentFrame.Times[FRAME_STATS_UPDATE] = (drawStart - updateStart) * msPerCount;
+	currentFrame.Times[FRAME_STATS_DRAW] = max((drawEnd - drawStart) * msPerCount - currentFrame.Times[FRAME_STATS_PRESENT], 0.0);
+	currentFrame.Times[FRAME_STATS_MESSAGES] = messageTime;
+	if (recordFrameStats)
+		frameStats.AddFrame(currentFrame);
+
+	currentFrame = FrameTiming();
+	frameEndTime = drawEnd;
+	messageTime = 0;
+}
+
+
 // --------------------------------------------------------
 // Updates the window's title bar with several stats once
 // per second, including:
@@ -5,6 +5,9 @@
 #include <string>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 
+#include "FrameStats.h"
+#include "FixedTimestep.h"
+
 // We can include the correct library files here
 // instead of in Visual Studio settings if we want
 #pragma comment(lib, "d3d11.lib")
@@ -46,6 +49,10 @@ public:
 	virtual void Update(float deltaTime, float totalTime) = 0;
 	virtual void Draw(float deltaTime, float totalTime) = 0;
 
+	// Called for each fixed step, before Update(), while the
+	// fixed timestep is in use
+	virtual void FixedUpdate(float stepTime, float totalTime) {}
+
 protected:
 	HINSTANCE		hInstance;		// The handle to the application
 	HWND			hWnd;			// The handle to the window itself
@@ -78,6 +85,18 @@ protected:
 	// Helper function for allocating a console window
 	void CreateConsoleWindow(int bufferLines, int bufferColumns, int windowLines, int windowColumns);
 
+	// Timing of recent frames.  The frame in progress is recorded
+	// once Draw() returns, and Draw() fills in how long Present()
+	// took itself, as that happens inside it.
+	FrameStats frameStats;
+	FrameTiming currentFrame;
+	bool recordFrameStats;
+
+	// Optionally, simulation runs in fixed steps (in FixedUpdate())
+	// and drawing interpolates using the timestep's alpha
+	FixedTimestep fixedTimestep;
+	bool useFixedTimestep;
+
 private:
 	// Timing related data
 	double perfCounterSeconds;
@@ -86,12 +105,15 @@ private:
 	__int64 startTime;
 	__int64 currentTime;
 	__int64 previousTime;
+	__int64 frameEndTime;
+	double messageTime;		// Milliseconds pumping messages since the last frame
 
 	// FPS calculation
 	int fpsFrameCount;
 	float fpsTimeElapsed;
 
 	void UpdateTimer();			// Updates the timer for this frame
+	void RecordFrame(__int64 updateStart, __int64 drawStart, __int64 drawEnd);
 	void UpdateTitleBarStats();	// Puts debug info in the title bar
 };
 
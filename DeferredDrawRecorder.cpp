@@ -0,0 +1,284 @@
+#include "DeferredDrawRecorder.h"
+#include "Profiler.h"
+
+// Releases a captured object, if there is one
+template<typename T>
+static void SafeRelease(T*& object)
+{
+	if (object)
+		object->Release();
+	object = 0;
+}
+
+// Adds a shader's current constant buffers to the draw list
+static void AddConstantBuffers(RenderDrawList* list, unsigned int stage, ISimpleShader* shader)
+{
+	SimpleConstantBufferBinding bindings[DEFERRED_DRAW_MAX_CONSTANT_BUFFERS];
+	unsigned int count = shader->GetConstantBufferBindings(bindings, DEFERRED_DRAW_MAX_CONSTANT_BUFFERS);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		list->AddConstantBuffer(
+			stage,
+			bindings[i].BindIndex,
+			D3D11RenderDevice::GetHandle(bindings[i].Buffer),
+			bindings[i].FirstConstant,
+			bindings[i].NumConstants);
+	}
+}
+
+// --------------------------------------------------------
+// Creates the deferred contexts, unless the ring isn't
+// supported (in which case IsSupported() returns false)
+//
+// device       - Device to create contexts with
+// context      - Immediate context to execute on
+// ring         - Ring every recorded shader uses
+// contextCount - Contexts to create, usually one per thread
+// --------------------------------------------------------
+DeferredDrawRecorder::DeferredDrawRecorder(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	std::shared_ptr<ConstantBufferRing> ring,
+	unsigned int contextCount)
+	:
+	immediateContext(context),
+	ring(ring),
+	ringGeneration(0),
+	recordable(false),
+	state()
+{
+	if (!ring || !ring->IsSupported())
+		return;
+
+	for (unsigned int c = 0; c < contextCount; c++)
+	{
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> deferred;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext1> deferred1;
+		if (FAILED(device->CreateDeferredContext(0, deferred.GetAddressOf())) ||
+			FAILED(deferred.As(&deferred1)))
+		{
+			contexts.clear();
+			devices.clear();
+			filters.clear();
+			return;
+		}
+
+		contexts.push_back(deferred1);
+		devices.push_back(std::unique_ptr<D3D11RenderDevice>(new D3D11RenderDevice(device, deferred)));
+		filters.push_back(std::unique_ptr<BindingFilter>(new BindingFilter()));
+	}
+}
+
+DeferredDrawRecorder::~DeferredDrawRecorder()
+{
+	ReleaseState();
+}
+
+// --------------------------------------------------------
+// Starts a frame's draws, capturing the immediate context's
+// state for every batch to start from.  Everything the draws
+// don't bind themselves (render targets, per-frame textures,
+// etc.) must already be set.
+// --------------------------------------------------------
+void DeferredDrawRecorder::BeginFrame()
+{
+	drawList.Clear();
+	batches.clear();
+	ringGeneration = 0;
+	recordable = IsSupported();
+
+	CaptureState();
+}
+
+// --------------------------------------------------------
+// Sets and uploads a draw's data, then captures what it
+// binds.  Any shader data that isn't the material's (like
+// per-object lights) should be set before calling this.
+//
+// material  - Material to draw with
+// transform - Where to draw
+// mesh      - What to draw
+//
+// Returns false if the draw can't be recorded, in which
+// case none of this frame's draws can, and Submit() won't
+// draw anything
+// --------------------------------------------------------
+bool DeferredDrawRecorder::AddDraw(Material* material, Transform* transform, Mesh* mesh)
+{
+	std::shared_ptr<SimpleVertexShader> vs = material->GetVertexShader();
+	std::shared_ptr<SimplePixelShader> ps = material->GetPixelShader();
+	if (!recordable || vs->GetConstantBufferRing() != ring || ps->GetConstantBufferRing() != ring)
+	{
+		recordable = false;
+		return false;
+	}
+
+	// Every draw of the frame must come from the same lap of
+	// the ring, as wrapping discards the ranges before it
+	unsigned int generation = ring->GetAllocator().GetGeneration();
+	if (drawList.GetDrawCount() == 0)
+		ringGeneration = generation;
+
+	material->SetShaderData(transform);
+	ISimpleShader::ReserveRingSpace(vs.get(), ps.get());
+	if (!vs->UploadAllBufferData() ||
+		!ps->UploadAllBufferData() ||
+		ring->GetAllocator().GetGeneration() != ringGeneration)
+	{
+		recordable = false;
+		return false;
+	}
+
+	AddConstantBuffers(&drawList, BINDING_STAGE_VERTEX, vs.get());
+	AddConstantBuffers(&drawList, BINDING_STAGE_PIXEL, ps.get());
+
+	// Material resources, by the register they're bound to
+	for (auto& t : material->GetTextureSRVs())
+	{
+		const SimpleSRV* info = ps->GetShaderResourceViewInfo(t.first);
+		if (info)
+			drawList.AddTexture(BINDING_STAGE_PIXEL, info->BindIndex, D3D11RenderDevice::GetHandle(t.second.Get()));
+	}
+	for (auto& s : material->GetSamplers())
+	{
+		const SimpleSampler* info = ps->GetSamplerInfo(s.first);
+		if (info)
+			drawList.AddSampler(BINDING_STAGE_PIXEL, info->BindIndex, D3D11RenderDevice::GetHandle(s.second.Get()));
+	}
+
+	RenderDraw draw = {};
+	draw.InputLayout = D3D11RenderDevice::GetHandle(vs->GetInputLayout().Get());
+	draw.VertexShader = D3D11RenderDevice::GetHandle(vs->GetDirectXShader().Get());
+	draw.PixelShader = D3D11RenderDevice::GetHandle(ps->GetDirectXShader().Get());
+	draw.VertexBuffer = D3D11RenderDevice::GetHandle(mesh->GetVertexBuffer().Get());
+	draw.IndexBuffer = D3D11RenderDevice::GetHandle(mesh->GetIndexBuffer().Get());
+	draw.VertexStride = sizeof(Vertex);
+	draw.IndexCount = mesh->GetIndexCount();
+	drawList.AddDraw(draw);
+	return true;
+}
+
+// --------------------------------------------------------
+// Records the frame's draws across threads, in batches of
+// at least the given size, and executes them in order
+//
+// jobs         - System to record on
+// minBatchSize - Fewest draws worth giving a context
+//
+// Returns false (having drawn nothing) if any draw couldn't
+// be recorded, so they should all be drawn some other way
+// --------------------------------------------------------
+bool DeferredDrawRecorder::Submit(JobSystem& jobs, unsigned int minBatchSize)
+{
+	PROFILE_FUNCTION();
+
+	bool submitted = recordable;
+	if (submitted)
+	{
+		PlanCommandBatches(drawList.GetDrawCount(), (unsigned int)contexts.size(), minBatchSize, &batches);
+		commandLists.clear();
+		commandLists.resize(batches.size());
+		RecordCommandBatches(jobs, batches, this);
+	}
+	else
+	{
+		batches.clear();
+	}
+
+	// Don't hold on to the back buffer (or anything else)
+	// between frames
+	ReleaseState();
+	return submitted;
+}
+
+// --------------------------------------------------------
+// Starts a batch on a deferred context, from the captured
+// immediate context state
+// --------------------------------------------------------
+void DeferredDrawRecorder::BeginBatch(unsigned int context)
+{
+	ID3D11DeviceContext1* deferred = contexts[context].Get();
+	filters[context]->Invalidate();
+
+	deferred->OMSetRenderTargets(1, &state.RenderTarget, state.DepthStencil);
+	deferred->OMSetDepthStencilState(state.DepthStencilState, state.StencilRef);
+	deferred->OMSetBlendState(state.BlendState, state.BlendFactor, state.SampleMask);
+	deferred->RSSetViewports(state.ViewportCount, state.Viewports);
+	deferred->RSSetState(state.RasterizerState);
+	deferred->IASetPrimitiveTopology(state.Topology);
+
+	if (state.PSTextureCount > 0)
+		deferred->PSSetShaderResources(0, state.PSTextureCount, state.PSTextures);
+	deferred->PSSetSamplers(0, D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT, state.PSSamplers);
+}
+
+// --------------------------------------------------------
+// Records one draw's binds and draw call
+// --------------------------------------------------------
+void DeferredDrawRecorder::RecordDraw(unsigned int context, unsigned int drawIndex)
+{
+	drawList.Submit(devices[context].get(), filters[context].get(), drawIndex, drawIndex + 1);
+}
+
+// --------------------------------------------------------
+// Turns everything the context recorded into the batch's
+// command list, clearing the context's state
+// --------------------------------------------------------
+void DeferredDrawRecorder::FinishBatch(unsigned int context, unsigned int batch)
+{
+	contexts[context]->FinishCommandList(FALSE, commandLists[batch].ReleaseAndGetAddressOf());
+}
+
+// --------------------------------------------------------
+// Plays a batch's command list back on the immediate
+// context, restoring the immediate state afterwards so the
+// binding filter (and everything drawn later) can rely on it
+// --------------------------------------------------------
+void DeferredDrawRecorder::ExecuteBatch(unsigned int batch)
+{
+	if (commandLists[batch])
+		immediateContext->ExecuteCommandList(commandLists[batch].Get(), TRUE);
+	commandLists[batch].Reset();
+}
+
+// --------------------------------------------------------
+// Grabs the immediate context's current state, holding a
+// reference to each object until ReleaseState()
+// --------------------------------------------------------
+void DeferredDrawRecorder::CaptureState()
+{
+	ReleaseState();
+
+	immediateContext->OMGetRenderTargets(1, &state.RenderTarget, &state.DepthStencil);
+	immediateContext->OMGetDepthStencilState(&state.DepthStencilState, &state.StencilRef);
+	immediateContext->OMGetBlendState(&state.BlendState, state.BlendFactor, &state.SampleMask);
+
+	state.ViewportCount = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	immediateContext->RSGetViewports(&state.ViewportCount, state.Viewports);
+	immediateContext->RSGetState(&state.RasterizerState);
+	immediateContext->IAGetPrimitiveTopology(&state.Topology);
+
+	// Only bind textures up to the last one that's set
+	immediateContext->PSGetShaderResources(0, D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT, state.PSTextures);
+	state.PSTextureCount = 0;
+	for (UINT i = 0; i < D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT; i++)
+	{
+		if (state.PSTextures[i])
+			state.PSTextureCount = i + 1;
+	}
+	immediateContext->PSGetSamplers(0, D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT, state.PSSamplers);
+}
+
+void DeferredDrawRecorder::ReleaseState()
+{
+	SafeRelease(state.RenderTarget);
+	SafeRelease(state.DepthStencil);
+	SafeRelease(state.DepthStencilState);
+	SafeRelease(state.BlendState);
+	SafeRelease(state.RasterizerState);
+	for (UINT i = 0; i < D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT; i++)
+		SafeRelease(state.PSTextures[i]);
+	for (UINT i = 0; i < D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT; i++)
+		SafeRelease(state.PSSamplers[i]);
+	state.PSTextureCount = 0;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <wrl/client.h>
+#include <memory>
+#include <vector>
+
+#include "BindingFilter.h"
+#include "CommandRecording.h"
+#include "ConstantBufferRing.h"
+#include "D3D11RenderDevice.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "Transform.h"
+
+// Fewest draws worth recording on a context of their own
+#define DEFERRED_DRAW_MIN_BATCH_SIZE 32
+
+// Constant buffers per stage (the D3D11 limit)
+#define DEFERRED_DRAW_MAX_CONSTANT_BUFFERS 14
+
+// --------------------------------------------------------
+// Records a frame's draws on D3D11 deferred contexts, one
+// per job system thread, and executes the resulting command
+// lists on the immediate context in draw order.
+//
+// Draws are added on the main thread, which sets each
+// material's data and uploads it to the constant buffer
+// ring (SimpleShader isn't thread safe), capturing what the
+// draw binds in a RenderDrawList.  Submitting the list to
+// a D3D11RenderDevice per context, the bulk of the API
+// cost, is then spread across threads.  Deferred contexts
+// start with no state at all, so every batch begins by
+// applying the immediate context's state as it was at
+// BeginFrame().
+//
+// Requires the ring: without it every draw's constants
+// would share one buffer per cbuffer.
+// --------------------------------------------------------
+class DeferredDrawRecorder : public ICommandRecorder
+{
+public:
+	DeferredDrawRecorder(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		std::shared_ptr<ConstantBufferRing> ring,
+		unsigned int contextCount);
+	~DeferredDrawRecorder();
+
+	bool IsSupported() { return !contexts.empty(); }
+	unsigned int GetContextCount() { return (unsigned int)contexts.size(); }
+
+	// Main thread, once per frame
+	void BeginFrame();
+	bool AddDraw(Material* material, Transform* transform, Mesh* mesh);
+	bool Submit(JobSystem& jobs, unsigned int minBatchSize = DEFERRED_DRAW_MIN_BATCH_SIZE);
+
+	// Details of the last submission
+	unsigned int GetDrawCount() { return drawList.GetDrawCount(); }
+	unsigned int GetBatchCount() { return (unsigned int)batches.size(); }
+
+	// ICommandRecorder, called by RecordCommandBatches()
+	void BeginBatch(unsigned int context);
+	void RecordDraw(unsigned int context, unsigned int draw);
+	void FinishBatch(unsigned int context, unsigned int batch);
+	void ExecuteBatch(unsigned int batch);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> immediateContext;
+	std::shared_ptr<ConstantBufferRing> ring;
+
+	// One per thread, each with a device to submit through
+	// and a filter for its own binds
+	std::vector<Microsoft::WRL::ComPtr<ID3D11DeviceContext1>> contexts;
+	std::vector<std::unique_ptr<D3D11RenderDevice>> devices;
+	std::vector<std::unique_ptr<BindingFilter>> filters;
+
+	// This frame's draws.  Objects aren't referenced, as their
+	// owners outlive the frame's recording.
+	RenderDrawList drawList;
+	unsigned int ringGeneration;
+	bool recordable;
+
+	// Recording
+	std::vector<CommandBatch> batches;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11CommandList>> commandLists;
+
+	// The immediate context's state at BeginFrame(), which
+	// holds a reference to everything it captures
+	struct CapturedState
+	{
+		ID3D11RenderTargetView* RenderTarget;
+		ID3D11DepthStencilView* DepthStencil;
+		D3D11_VIEWPORT Viewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+		UINT ViewportCount;
+		ID3D11RasterizerState* RasterizerState;
+		ID3D11DepthStencilState* DepthStencilState;
+		UINT StencilRef;
+		ID3D11BlendState* BlendState;
+		float BlendFactor[4];
+		UINT SampleMask;
+		D3D11_PRIMITIVE_TOPOLOGY Topology;
+
+		// Per-frame resources (lights, IBL, etc.), as each draw
+		// binds all of its own constant buffers
+		ID3D11ShaderResourceView* PSTextures[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+		UINT PSTextureCount;	// Up to the last one actually bound
+		ID3D11SamplerState* PSSamplers[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+	} state;
+
+	void CaptureState();
+	void ReleaseState();
+};
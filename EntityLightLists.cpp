@@ -0,0 +1,404 @@
+#include "EntityLightLists.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+using namespace DirectX;
+
+// Lists are ordered by score, then by light index
+static bool IsBetter(float scoreA, unsigned int lightA, float scoreB, unsigned int lightB)
+{
+	return scoreA > scoreB || (scoreA == scoreB && lightA < lightB);
+}
+
+// --------------------------------------------------------
+// Scores a light against an entity's bounding sphere
+//
+// light  - A point or spot light (others score 0)
+// sphere - World space center (xyz) and radius (w)
+// --------------------------------------------------------
+float ScoreLight(const Light& light, const XMFLOAT4& sphere)
+{
+	if (light.Type != LIGHT_TYPE_POINT && light.Type != LIGHT_TYPE_SPOT)
+		return 0.0f;
+	if (light.Range <= 0.0f || light.Intensity <= 0.0f)
+		return 0.0f;
+
+	// Out of range of the entire sphere?
+	XMFLOAT3 toCenter(sphere.x - light.Position.x, sphere.y - light.Position.y, sphere.z - light.Position.z);
+	float distSq = toCenter.x * toCenter.x + toCenter.y * toCenter.y + toCenter.z * toCenter.z;
+	float reach = light.Range + sphere.w;
+	if (distSq >= reach * reach)
+		return 0.0f;
+
+	// Range-based attenuation at the closest point of the
+	// sphere, the same as Attenuate() in Lighting.hlsli
+	float dist = sqrtf(distSq);
+	float closest = fmaxf(dist - sphere.w, 0.0f);
+	float att = 1.0f - (closest * closest / (light.Range * light.Range));
+	att *= att;
+
+	// Spot falloff at the angle closest to the cone's direction,
+	// which is the angle to the center minus the angle the
+	// sphere covers (lights inside the sphere are unaffected)
+	if (light.Type == LIGHT_TYPE_SPOT && dist > sphere.w)
+	{
+		XMFLOAT3 dir = light.Direction;
+		float dirLength = sqrtf(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z);
+		if (dirLength > 0.0f)
+		{
+			float cosToCenter = (toCenter.x * dir.x + toCenter.y * dir.y + toCenter.z * dir.z) / (dist * dirLength);
+			float sinToCenter = sqrtf(fmaxf(1.0f - cosToCenter * cosToCenter, 0.0f));
+			float sinSphere = sphere.w / dist;
+			float cosSphere = sqrtf(1.0f - sinSphere * sinSphere);
+
+			float cosClosest = cosToCenter >= cosSphere ? 1.0f : cosToCenter * cosSphere + sinToCenter * sinSphere;
+			att *= powf(fminf(fmaxf(cosClosest, 0.0f), 1.0f), light.SpotFalloff);
+		}
+	}
+
+	// Perceived brightness of the light's color
+	float luminance = light.Color.x * 0.2126f + light.Color.y * 0.7152f + light.Color.z * 0.0722f;
+	return att * light.Intensity * luminance;
+}
+
+
+// --------------------------------------------------------
+// Starts with no entities and no previous lights
+// --------------------------------------------------------
+EntityLightLists::EntityLightLists() :
+	previousFirstLight(0),
+	previousValid(false),
+	changedLightCount(0),
+	rescoredEntityCount(0),
+	wasFullRebuild(false)
+{
+}
+
+// --------------------------------------------------------
+// Sets the number of entities.  New entities start with
+// empty lists, and are scored on the next update.
+// --------------------------------------------------------
+void EntityLightLists::SetEntityCount(unsigned int count)
+{
+	EntityList empty = {};
+	empty.BoundsChanged = true;
+	entities.resize(count, empty);
+}
+
+// --------------------------------------------------------
+// Sets the world space bounds of an entity, marking it for
+// scoring only if they actually changed
+// --------------------------------------------------------
+void EntityLightLists::SetEntityBounds(unsigned int entity, const XMFLOAT4& sphere)
+{
+	EntityList& list = entities[entity];
+	if (memcmp(&list.Bounds, &sphere, sizeof(XMFLOAT4)) == 0)
+		return;
+
+	list.Bounds = sphere;
+	list.BoundsChanged = true;
+}
+
+// --------------------------------------------------------
+// Updates every entity's list for the current lights
+//
+// lights        - Packed lights (as uploaded to the GPU)
+// firstLight    - Index of the first non-directional light
+// multithreaded - Whether to use more than this thread
+// --------------------------------------------------------
+void EntityLightLists::Update(const std::vector<Light>& lights, unsigned int firstLight, bool multithreaded)
+{
+	bool fullRebuild = !FindChangedLights(lights, firstLight);
+
+	auto update = [&](unsigned int start, unsigned int end)
+	{
+		for (unsigned int i = start; i < end; i++)
+		{
+			EntityList& list = entities[i];
+			list.Rescored =
+				fullRebuild ||
+				list.BoundsChanged ||
+				!ScoreChangedLights(list, lights);
+
+			if (list.Rescored)
+				ScoreAllLights(list, lights, firstLight);
+
+			list.BoundsChanged = false;
+		}
+	};
+
+	if (multithreaded)
+		ParallelFor((unsigned int)entities.size(), update);
+	else
+		update(0, (unsigned int)entities.size());
+
+	// Statistics
+	wasFullRebuild = fullRebuild;
+	rescoredEntityCount = 0;
+	for (auto& list : entities)
+		rescoredEntityCount += list.Rescored ? 1 : 0;
+
+	// Remember these lights for next time
+	previousLights = lights;
+	previousFirstLight = firstLight;
+	previousValid = true;
+}
+
+// --------------------------------------------------------
+// Forgets the previous lights, forcing a full rebuild
+// --------------------------------------------------------
+void EntityLightLists::Invalidate()
+{
+	previousValid = false;
+}
+
+// --------------------------------------------------------
+// Checks whether every entity has the same lights, in the
+// same order, as the other instance
+// --------------------------------------------------------
+bool EntityLightLists::Matches(const EntityLightLists& other) const
+{
+	if (entities.size() != other.entities.size())
+		return false;
+
+	for (size_t i = 0; i < entities.size(); i++)
+	{
+		const EntityList& a = entities[i];
+		const EntityList& b = other.entities[i];
+		if (a.Count != b.Count || memcmp(a.Lights, b.Lights, sizeof(unsigned int) * a.Count) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Compares the lights to those of the previous update,
+// gathering the indices of any that changed
+//
+// Returns false if the lists must be fully rebuilt: the
+// first update, a different number of lights, or so many
+// changes that checking them would cost more than scoring
+// --------------------------------------------------------
+bool EntityLightLists::FindChangedLights(const std::vector<Light>& lights, unsigned int firstLight)
+{
+	changedLights.clear();
+	changedLightCount = 0;
+
+	if (!previousValid ||
+		previousLights.size() != lights.size() ||
+		previousFirstLight != firstLight)
+	{
+		changedLightCount = lights.size() > firstLight ? (unsigned int)lights.size() - firstLight : 0;
+		return false;
+	}
+
+	for (unsigned int i = firstLight; i < lights.size(); i++)
+	{
+		if (memcmp(&lights[i], &previousLights[i], sizeof(Light)) != 0)
+			changedLights.push_back(i);
+	}
+
+	changedLightCount = (unsigned int)changedLights.size();
+	return changedLights.size() <= (lights.size() - firstLight) / 4;
+}
+
+// --------------------------------------------------------
+// Scores every point and spot light for an entity, keeping
+// only the best
+// --------------------------------------------------------
+void EntityLightLists::ScoreAllLights(EntityList& list, const std::vector<Light>& lights, unsigned int firstLight) const
+{
+	list.Count = 0;
+	for (unsigned int i = firstLight; i < lights.size(); i++)
+	{
+		float score = ScoreLight(lights[i], list.Bounds);
+		if (score > 0.0f)
+			Insert(list, i, score);
+	}
+}
+
+// --------------------------------------------------------
+// Rescores only the lights that changed for an entity
+//
+// Returns false if the list can't be fixed up this way,
+// which happens when a light in a full list got worse
+// (as any other light might now belong in its place)
+// --------------------------------------------------------
+bool EntityLightLists::ScoreChangedLights(EntityList& list, const std::vector<Light>& lights) const
+{
+	for (unsigned int light : changedLights)
+	{
+		float score = ScoreLight(lights[light], list.Bounds);
+
+		// Already in the list?
+		unsigned int position = 0;
+		while (position < list.Count && list.Lights[position] != light)
+			position++;
+
+		if (position < list.Count)
+		{
+			// A list with room holds every light that reaches the
+			// entity, so only a full list can be missing a better one
+			if (list.Count == ENTITY_MAX_LIGHTS && score < list.Scores[position])
+				return false;
+
+			Remove(list, position);
+		}
+
+		if (score > 0.0f)
+			Insert(list, light, score);
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Adds a light in order, dropping the worst if the list is
+// already full (or not adding it at all if it is the worst)
+// --------------------------------------------------------
+void EntityLightLists::Insert(EntityList& list, unsigned int light, float score)
+{
+	unsigned int position = 0;
+	while (position < list.Count && !IsBetter(score, light, list.Scores[position], list.Lights[position]))
+		position++;
+
+	if (position >= ENTITY_MAX_LIGHTS)
+		return;
+
+	// Shift the worse lights down to make room
+	unsigned int last = list.Count < ENTITY_MAX_LIGHTS ? list.Count : ENTITY_MAX_LIGHTS - 1;
+	for (unsigned int i = last; i > position; i--)
+	{
+		list.Lights[i] = list.Lights[i - 1];
+		list.Scores[i] = list.Scores[i - 1];
+	}
+
+	list.Lights[position] = light;
+	list.Scores[position] = score;
+	if (list.Count < ENTITY_MAX_LIGHTS)
+		list.Count++;
+}
+
+// --------------------------------------------------------
+// Removes the light at a position, keeping the order
+// --------------------------------------------------------
+void EntityLightLists::Remove(EntityList& list, unsigned int position)
+{
+	for (unsigned int i = position + 1; i < list.Count; i++)
+	{
+		list.Lights[i - 1] = list.Lights[i];
+		list.Scores[i - 1] = list.Scores[i];
+	}
+	list.Count--;
+}
+
+
+// === BENCHMARK ====================================================
+
+// --------------------------------------------------------
+// Validates and times light selection for 10,000 entities
+// and 1,000 lights: a full build, then incremental updates
+// after moving increasing portions of the scene.  Each
+// update is compared against a full rebuild of the same
+// scene, and lights come from a fixed seed so every run
+// tests exactly the same scenes.
+//
+// timings - Filled in with one timing per pass
+// --------------------------------------------------------
+void RunLightSelectionBenchmark(std::vector<LightSelectionTiming>* timings)
+{
+	const unsigned int entityCount = 10000;
+	const unsigned int testLightCount = 1000;
+	timings->clear();
+
+	// Simple LCG, so the results don't depend on rand()
+	unsigned int seed = 24680;
+	auto random = [&seed](float min, float max)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return min + (seed >> 8) / 16777216.0f * (max - min);
+	};
+	auto randomIndex = [&random](unsigned int count)
+	{
+		return (std::min)((unsigned int)random(0.0f, (float)count), count - 1);
+	};
+
+	// Half point lights, half spot lights, spread over a much
+	// larger area than the demo scene
+	std::vector<Light> testLights(testLightCount);
+	for (unsigned int i = 0; i < testLightCount; i++)
+	{
+		Light& light = testLights[i];
+		light = {};
+		light.Type = (i % 2 == 0) ? LIGHT_TYPE_POINT : LIGHT_TYPE_SPOT;
+		light.Position = XMFLOAT3(random(-50.0f, 50.0f), random(-5.0f, 5.0f), random(-50.0f, 50.0f));
+		light.Direction = XMFLOAT3(random(-1.0f, 1.0f), random(-1.0f, 0.0f), random(-1.0f, 1.0f));
+		light.Color = XMFLOAT3(random(0.0f, 1.0f), random(0.0f, 1.0f), random(0.0f, 1.0f));
+		light.Range = random(3.0f, 10.0f);
+		light.Intensity = random(0.5f, 2.0f);
+		light.SpotFalloff = random(1.0f, 50.0f);
+	}
+
+	std::vector<XMFLOAT4> bounds(entityCount);
+	for (auto& b : bounds)
+		b = XMFLOAT4(random(-50.0f, 50.0f), random(-5.0f, 5.0f), random(-50.0f, 50.0f), random(0.5f, 2.0f));
+
+	EntityLightLists threaded, single;
+	threaded.SetEntityCount(entityCount);
+	single.SetEntityCount(entityCount);
+
+	unsigned int movedPercents[] = { 100, 1, 5, 25 };
+	for (unsigned int percent : movedPercents)
+	{
+		// Move some of the scene (the first pass is a full build)
+		if (percent < 100)
+		{
+			for (unsigned int i = 0; i < testLightCount * percent / 100; i++)
+			{
+				Light& light = testLights[randomIndex(testLightCount)];
+				light.Position.x += random(-1.0f, 1.0f);
+				light.Position.z += random(-1.0f, 1.0f);
+			}
+			for (unsigned int i = 0; i < entityCount * percent / 100; i++)
+			{
+				XMFLOAT4& b = bounds[randomIndex(entityCount)];
+				b.x += random(-1.0f, 1.0f);
+				b.z += random(-1.0f, 1.0f);
+			}
+		}
+
+		for (unsigned int i = 0; i < entityCount; i++)
+		{
+			threaded.SetEntityBounds(i, bounds[i]);
+			single.SetEntityBounds(i, bounds[i]);
+		}
+
+		LightSelectionTiming timing = {};
+		timing.MovedPercent = percent;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		threaded.Update(testLights, 0, true);
+		auto singleStart = std::chrono::high_resolution_clock::now();
+		single.Update(testLights, 0, false);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		timing.UpdateTime = std::chrono::duration<double, std::milli>(singleStart - start).count();
+		timing.SingleThreadTime = std::chrono::duration<double, std::milli>(end - singleStart).count();
+		timing.RescoredEntities = threaded.GetRescoredEntityCount();
+
+		// Compare against a full rebuild of the same scene
+		EntityLightLists reference;
+		reference.SetEntityCount(entityCount);
+		for (unsigned int i = 0; i < entityCount; i++)
+			reference.SetEntityBounds(i, bounds[i]);
+		reference.Update(testLights, 0);
+		timing.Matches = threaded.Matches(reference) && single.Matches(reference);
+
+		timings->push_back(timing);
+	}
+}
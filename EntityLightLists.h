@@ -0,0 +1,115 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Lights.h"
+
+// Most point and spot lights passed to a single entity.
+// Must match the define in Lighting.hlsli, and must be
+// a multiple of 4 (the shader packs indices in uint4s)
+#define ENTITY_MAX_LIGHTS	8
+
+// --------------------------------------------------------
+// Estimates the most light a point or spot light can give
+// anywhere within a bounding sphere (center and radius):
+// brightness, times the range attenuation at the closest
+// point, times the spot falloff at the closest angle.
+// Returns 0 if the light can't reach the sphere at all.
+// --------------------------------------------------------
+float ScoreLight(const Light& light, const DirectX::XMFLOAT4& sphere);
+
+// --------------------------------------------------------
+// Chooses the few point and spot lights that matter most
+// to each entity, so shading it doesn't need to consider
+// every light near each pixel.
+//
+// Update() only redoes the work that could have changed:
+// entities whose bounds moved are scored against every
+// light again, while the rest are only checked against
+// the lights that changed since the last update.  When a
+// light drops out of a full list, any light might replace
+// it, so that entity is scored from scratch too.
+//
+// The lists are always identical to a full rebuild, as
+// scores tie-break on the lower light index.
+// --------------------------------------------------------
+class EntityLightLists
+{
+public:
+	EntityLightLists();
+
+	// Entities are identified by index, and must be given
+	// their world space bounds (center and radius)
+	void SetEntityCount(unsigned int count);
+	void SetEntityBounds(unsigned int entity, const DirectX::XMFLOAT4& sphere);
+
+	// Brings every list up to date with these lights
+	void Update(const std::vector<Light>& lights, unsigned int firstLight, bool multithreaded = true);
+
+	// Discards all previous results, so the next update is
+	// a full rebuild
+	void Invalidate();
+
+	// Compares the lists of two instances (for validation)
+	bool Matches(const EntityLightLists& other) const;
+
+	// Results, as indices into the packed lights
+	unsigned int GetEntityCount() const { return (unsigned int)entities.size(); }
+	unsigned int GetLightCount(unsigned int entity) const { return entities[entity].Count; }
+	const unsigned int* GetLights(unsigned int entity) const { return entities[entity].Lights; }
+
+	// Statistics from the last update
+	unsigned int GetChangedLightCount() const { return changedLightCount; }
+	unsigned int GetRescoredEntityCount() const { return rescoredEntityCount; }
+	bool WasFullRebuild() const { return wasFullRebuild; }
+
+private:
+	// The chosen lights of one entity, best first
+	struct EntityList
+	{
+		DirectX::XMFLOAT4 Bounds;
+		bool BoundsChanged;
+		bool Rescored; // During the last update
+		unsigned int Count;
+		unsigned int Lights[ENTITY_MAX_LIGHTS];
+		float Scores[ENTITY_MAX_LIGHTS];
+	};
+
+	std::vector<EntityList> entities;
+
+	// Lights as of the last update, for finding changes
+	std::vector<Light> previousLights;
+	unsigned int previousFirstLight;
+	bool previousValid;
+	std::vector<unsigned int> changedLights;
+
+	// Statistics
+	unsigned int changedLightCount;
+	unsigned int rescoredEntityCount;
+	bool wasFullRebuild;
+
+	bool FindChangedLights(const std::vector<Light>& lights, unsigned int firstLight);
+	void ScoreAllLights(EntityList& list, const std::vector<Light>& lights, unsigned int firstLight) const;
+	bool ScoreChangedLights(EntityList& list, const std::vector<Light>& lights) const;
+	static void Insert(EntityList& list, unsigned int light, float score);
+	static void Remove(EntityList& list, unsigned int position);
+};
+
+// --------------------------------------------------------
+// Results of validating and timing one pass of light
+// selection
+// --------------------------------------------------------
+struct LightSelectionTiming
+{
+	unsigned int MovedPercent;	// Of lights and entities (100 for a full build)
+	double UpdateTime;			// Multithreaded, milliseconds
+	double SingleThreadTime;	// Milliseconds
+	unsigned int RescoredEntities;
+	bool Matches;				// Did both match a full rebuild?
+};
+
+// Builds light lists for a large scene, then updates them
+// after moving more and more of it, multithreaded and not,
+// checking each against a full rebuild
+void RunLightSelectionBenchmark(std::vector<LightSelectionTiming>* timings);
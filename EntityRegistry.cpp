@@ -0,0 +1,316 @@
+#include "EntityRegistry.h"
+#include "Transform.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+using namespace DirectX;
+
+unsigned int NextComponentTypeId()
+{
+	static std::atomic<unsigned int> next(0);
+	return next++;
+}
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Makes an entity without components, reusing the slot of
+// a destroyed one if there is one
+// --------------------------------------------------------
+Entity EntityRegistry::Create()
+{
+	unsigned int index;
+	if (freeSlots.empty())
+	{
+		index = (unsigned int)generations.size();
+		generations.push_back(0);
+	}
+	else
+	{
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	return GetEntity(index);
+}
+
+// --------------------------------------------------------
+// Removes every component of an entity and frees its slot,
+// which makes every handle to it stale
+// --------------------------------------------------------
+void EntityRegistry::Destroy(Entity entity)
+{
+	if (!IsAlive(entity))
+		return;
+
+	for (auto& pool : pools)
+	{
+		if (pool)
+			pool->Remove(entity.Index);
+	}
+	generations[entity.Index]++;
+	freeSlots.push_back(entity.Index);
+}
+
+// Free slots have moved on a generation from any handle
+bool EntityRegistry::IsAlive(Entity entity) const
+{
+	return entity.Index < generations.size() && generations[entity.Index] == entity.Generation;
+}
+
+void EntityRegistry::Clear()
+{
+	for (auto& pool : pools)
+	{
+		if (pool)
+			pool->Clear();
+	}
+	generations.clear();
+	freeSlots.clear();
+}
+
+
+// === BENCHMARK ==============================================
+
+// Stand-ins for the game's meshes and materials, which
+// can't be made without a device
+struct BenchmarkMesh
+{
+	XMFLOAT4 BoundingSphere;
+};
+
+struct BenchmarkMaterial
+{
+	float Roughness;
+};
+
+// --------------------------------------------------------
+// An entity as the game used to keep one: an object on the
+// heap, sharing ownership of what it draws with
+// --------------------------------------------------------
+class SharedEntity
+{
+public:
+	SharedEntity(std::shared_ptr<BenchmarkMesh> mesh, std::shared_ptr<BenchmarkMaterial> material, unsigned int id) :
+		mesh(mesh),
+		material(material),
+		id(id)
+	{
+	}
+
+	std::shared_ptr<BenchmarkMesh> GetMesh() { return mesh; }
+	std::shared_ptr<BenchmarkMaterial> GetMaterial() { return material; }
+	Transform* GetTransform() { return &transform; }
+	unsigned int GetId() { return id; }
+
+private:
+	std::shared_ptr<BenchmarkMesh> mesh;
+	std::shared_ptr<BenchmarkMaterial> material;
+	Transform transform;
+	unsigned int id;	// Order of creation
+};
+
+// Registry components, like the game's
+struct BenchmarkMeshRef
+{
+	BenchmarkMesh* Asset;
+};
+
+struct BenchmarkMaterialRef
+{
+	BenchmarkMaterial* Asset;
+};
+
+struct BenchmarkBounds
+{
+	XMFLOAT4 Sphere;
+};
+
+// Mesh bounds moved into world space, with the radius grown
+// to cover the largest scale (as the game does)
+static XMFLOAT4 GetWorldSphere(const XMFLOAT4& local, Transform& transform)
+{
+	XMFLOAT4X4 world = transform.GetWorldMatrix();
+	XMFLOAT3 scale = transform.GetScale();
+
+	XMFLOAT4 sphere;
+	XMStoreFloat4(&sphere, XMVector3Transform(XMVectorSet(local.x, local.y, local.z, 1), XMLoadFloat4x4(&world)));
+	sphere.w = local.w * (std::max)(fabsf(scale.x), (std::max)(fabsf(scale.y), fabsf(scale.z)));
+	return sphere;
+}
+
+// --------------------------------------------------------
+// Makes the given number of entities, each with a transform,
+// a mesh, a material and bounds, as shared objects (the way
+// the game used to keep them, in creation order and
+// shuffled, as a heap that's seen some use would leave them)
+// and in a registry, then times two systems over each: one
+// spinning every entity and updating its bounds, and one
+// only reading bounds and materials (like culling, or
+// sorting draws).  Every layout should end up with exactly
+// the same bounds.
+//
+// entityCount - How many entities to make
+// frames      - How many times to run the systems
+// timings     - Filled in with one timing per layout
+// --------------------------------------------------------
+void RunEntityRegistryBenchmark(unsigned int entityCount, unsigned int frames, std::vector<EntityRegistryTiming>* timings)
+{
+	timings->clear();
+	if (entityCount == 0 || frames == 0)
+		return;
+
+	const float deltaTime = 1.0f / 60.0f;
+
+	// A handful of meshes and materials, shared by everything
+	std::vector<std::shared_ptr<BenchmarkMesh>> meshes;
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		BenchmarkMesh mesh = { XMFLOAT4(0, 0.1f * i, 0, 0.5f + 0.25f * i) };
+		meshes.push_back(std::make_shared<BenchmarkMesh>(mesh));
+	}
+	std::vector<std::shared_ptr<BenchmarkMaterial>> materials;
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		BenchmarkMaterial material = { i / 15.0f };
+		materials.push_back(std::make_shared<BenchmarkMaterial>(material));
+	}
+
+	// Where each entity is, and what it's made of
+	struct Placement
+	{
+		XMFLOAT3 Position;
+		float Yaw;
+		float Scale;
+		unsigned int Mesh;
+		unsigned int Material;
+	};
+	std::vector<Placement> placements(entityCount);
+	unsigned int seed = 24680;
+	auto random = [&seed]()
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	};
+	for (auto& p : placements)
+	{
+		p.Position = XMFLOAT3((random() % 2000) * 0.5f, (random() % 20) * 0.5f, (random() % 2000) * 0.5f);
+		p.Yaw = (random() % 628) * 0.01f;
+		p.Scale = 0.5f + (random() % 16) * 0.1f;
+		p.Mesh = random() % meshes.size();
+		p.Material = random() % materials.size();
+	}
+
+	// Bounds of each entity (in order of creation) at the end
+	std::vector<XMFLOAT4> reference;
+	std::vector<XMFLOAT4> results(entityCount);
+
+	// === Shared objects, visited in two orders ===
+	for (unsigned int shuffled = 0; shuffled < 2; shuffled++)
+	{
+		std::vector<std::shared_ptr<SharedEntity>> entities;
+		entities.reserve(entityCount);
+		for (unsigned int i = 0; i < entityCount; i++)
+		{
+			const Placement& p = placements[i];
+			std::shared_ptr<SharedEntity> e = std::make_shared<SharedEntity>(meshes[p.Mesh], materials[p.Material], i);
+			e->GetTransform()->SetPosition(p.Position);
+			e->GetTransform()->SetRotation(0, p.Yaw, 0);
+			e->GetTransform()->SetScale(p.Scale);
+			entities.push_back(e);
+		}
+		if (shuffled)
+		{
+			for (unsigned int i = entityCount - 1; i > 0; i--)
+				std::swap(entities[i], entities[random() % (i + 1)]);
+		}
+
+		// The game kept bounds in arrays alongside the entities
+		std::vector<XMFLOAT4> bounds(entityCount);
+
+		EntityRegistryTiming timing = {};
+		timing.Layout = shuffled ? "Shared (shuffled)" : "Shared";
+		double total = 0;
+		for (unsigned int f = 0; f < frames; f++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			for (unsigned int i = 0; i < entityCount; i++)
+			{
+				auto& e = entities[i];
+				e->GetTransform()->Rotate(0, deltaTime, 0);
+				bounds[i] = GetWorldSphere(e->GetMesh()->BoundingSphere, *e->GetTransform());
+			}
+			timing.UpdateTime += MillisecondsSince(start);
+
+			start = std::chrono::high_resolution_clock::now();
+			for (unsigned int i = 0; i < entityCount; i++)
+				total += bounds[i].w * entities[i]->GetMaterial()->Roughness;
+			timing.IterateTime += MillisecondsSince(start);
+		}
+		timing.UpdateTime /= frames;
+		timing.IterateTime /= frames;
+
+		for (unsigned int i = 0; i < entityCount; i++)
+			results[entities[i]->GetId()] = bounds[i];
+		if (reference.empty())
+			reference = results;
+		timing.Matches = total > 0 && memcmp(&reference[0], &results[0], sizeof(XMFLOAT4) * entityCount) == 0;
+		timings->push_back(timing);
+	}
+
+	// === Registry ===
+	{
+		EntityRegistry registry;
+		registry.GetPool<Transform>().Reserve(entityCount);
+		registry.GetPool<BenchmarkMeshRef>().Reserve(entityCount);
+		registry.GetPool<BenchmarkMaterialRef>().Reserve(entityCount);
+		registry.GetPool<BenchmarkBounds>().Reserve(entityCount);
+		for (unsigned int i = 0; i < entityCount; i++)
+		{
+			const Placement& p = placements[i];
+			Entity e = registry.Create();
+			Transform transform;
+			transform.SetPosition(p.Position);
+			transform.SetRotation(0, p.Yaw, 0);
+			transform.SetScale(p.Scale);
+			registry.Add(e, transform);
+			registry.Add(e, BenchmarkMeshRef{ meshes[p.Mesh].get() });
+			registry.Add(e, BenchmarkMaterialRef{ materials[p.Material].get() });
+			registry.Add(e, BenchmarkBounds{ XMFLOAT4(0, 0, 0, 0) });
+		}
+
+		EntityRegistryTiming timing = {};
+		timing.Layout = "Registry";
+		double total = 0;
+		for (unsigned int f = 0; f < frames; f++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			registry.Each<Transform, BenchmarkMeshRef, BenchmarkBounds>([&](Entity, Transform& transform, BenchmarkMeshRef& mesh, BenchmarkBounds& bounds)
+			{
+				transform.Rotate(0, deltaTime, 0);
+				bounds.Sphere = GetWorldSphere(mesh.Asset->BoundingSphere, transform);
+			});
+			timing.UpdateTime += MillisecondsSince(start);
+
+			start = std::chrono::high_resolution_clock::now();
+			registry.Each<BenchmarkBounds, BenchmarkMaterialRef>([&](Entity, BenchmarkBounds& bounds, BenchmarkMaterialRef& material)
+			{
+				total += bounds.Sphere.w * material.Asset->Roughness;
+			});
+			timing.IterateTime += MillisecondsSince(start);
+		}
+		timing.UpdateTime /= frames;
+		timing.IterateTime /= frames;
+
+		// Entities were made in order, so slots match creation
+		registry.Each<BenchmarkBounds>([&](Entity e, BenchmarkBounds& bounds) { results[e.Index] = bounds.Sphere; });
+		timing.Matches = total > 0 && memcmp(&reference[0], &results[0], sizeof(XMFLOAT4) * entityCount) == 0;
+		timings->push_back(timing);
+	}
+}
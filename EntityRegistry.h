@@ -0,0 +1,263 @@
+#pragma once
+
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Marks sparse slots without a component
+#define ENTITY_NO_COMPONENT	0xFFFFFFFF
+
+// --------------------------------------------------------
+// An entity is only a handle: a slot in the registry and
+// the generation of that slot, which changes whenever the
+// slot's entity is destroyed, so stale handles are caught
+// once the slot is reused
+// --------------------------------------------------------
+struct Entity
+{
+	unsigned int Index;
+	unsigned int Generation;
+};
+
+// Each component type gets its own small number, the first
+// time it's asked for
+unsigned int NextComponentTypeId();
+template<typename T>
+unsigned int GetComponentTypeId()
+{
+	static unsigned int id = NextComponentTypeId();
+	return id;
+}
+
+// --------------------------------------------------------
+// The parts of a component pool that don't depend on the
+// component type, so the registry can remove an entity from
+// every pool without knowing what they hold
+// --------------------------------------------------------
+class ComponentPoolBase
+{
+public:
+	virtual ~ComponentPoolBase() {}
+	virtual void Remove(unsigned int entity) = 0;
+	virtual void Clear() = 0;
+
+	bool Has(unsigned int entity) const { return entity < sparse.size() && sparse[entity] != ENTITY_NO_COMPONENT; }
+	unsigned int GetSize() const { return (unsigned int)dense.size(); }
+
+	// Slot of the entity owning each component, in order
+	const unsigned int* GetEntities() const { return dense.data(); }
+
+protected:
+	std::vector<unsigned int> sparse;	// Entity slot to component index
+	std::vector<unsigned int> dense;	// Component index to entity slot
+};
+
+// --------------------------------------------------------
+// A sparse set of one type of component: components are
+// packed together in one array (in the order they were
+// added, until some are removed), with a sparse array from
+// entity slots to their place in it.  Removing moves the
+// last component into the gap, so the array never has holes.
+// --------------------------------------------------------
+template<typename T>
+class ComponentPool : public ComponentPoolBase
+{
+public:
+	// Adds a component to an entity, or replaces the one it has
+	T& Add(unsigned int entity, const T& component)
+	{
+		if (Has(entity))
+			return components[sparse[entity]] = component;
+
+		if (entity >= sparse.size())
+			sparse.resize(entity + 1, ENTITY_NO_COMPONENT);
+		sparse[entity] = (unsigned int)dense.size();
+		dense.push_back(entity);
+		components.push_back(component);
+		return components.back();
+	}
+
+	void Remove(unsigned int entity)
+	{
+		if (!Has(entity))
+			return;
+
+		unsigned int index = sparse[entity];
+		unsigned int last = (unsigned int)dense.size() - 1;
+		if (index != last)
+		{
+			components[index] = std::move(components[last]);
+			dense[index] = dense[last];
+			sparse[dense[index]] = index;
+		}
+		components.pop_back();
+		dense.pop_back();
+		sparse[entity] = ENTITY_NO_COMPONENT;
+	}
+
+	void Clear()
+	{
+		components.clear();
+		sparse.clear();
+		dense.clear();
+	}
+
+	void Reserve(unsigned int count)
+	{
+		components.reserve(count);
+		dense.reserve(count);
+	}
+
+	// Only valid if the entity has one
+	T& Get(unsigned int entity) { return components[sparse[entity]]; }
+
+	// The component of an entity, or null if it has none.  The
+	// hint is where it's likely to be, which is checked first.
+	T* Find(unsigned int entity, unsigned int hint)
+	{
+		if (hint < dense.size() && dense[hint] == entity)
+			return &components[hint];
+		return Has(entity) ? &components[sparse[entity]] : 0;
+	}
+
+	// Every component, in the same order as GetEntities()
+	T* GetComponents() { return components.data(); }
+
+private:
+	std::vector<T> components;
+};
+
+// --------------------------------------------------------
+// Entities and their components, stored as one sparse set
+// per component type rather than as objects: each type of
+// component is contiguous in memory, so code that only needs
+// a few types (like spinning transforms, or culling bounds)
+// streams through exactly those arrays, with no pointers to
+// chase or reference counts to touch.
+//
+// Queries walk the pool of their first component type and
+// look up the rest.  Pools that had components added to the
+// same entities in the same order line up, which queries
+// notice, so the lookups are skipped and every array is read
+// straight through.  Entities made with all of the same
+// components at once stay that way until some are removed.
+//
+// Any copyable type can be a component.  Pointers to them
+// last until that type's pool next grows or shrinks.
+//
+// Has no knowledge of Direct3D, so it can be exercised on
+// its own.  Not thread safe, though queries can be split
+// across threads by their component indices.
+// --------------------------------------------------------
+class EntityRegistry
+{
+public:
+	// Entities, which start without any components
+	Entity Create();
+	void Destroy(Entity entity);
+	bool IsAlive(Entity entity) const;
+
+	// Destroys every entity, and forgets every slot
+	void Clear();
+
+	unsigned int GetCount() const { return (unsigned int)(generations.size() - freeSlots.size()); }
+
+	// Components of single entities
+	template<typename T>
+	T& Add(Entity entity, const T& component) { return GetPool<T>().Add(entity.Index, component); }
+
+	template<typename T>
+	void Remove(Entity entity) { GetPool<T>().Remove(entity.Index); }
+
+	template<typename T>
+	bool Has(Entity entity) { return GetPool<T>().Has(entity.Index); }
+
+	// Only valid if the entity has one
+	template<typename T>
+	T& Get(Entity entity) { return GetPool<T>().Get(entity.Index); }
+
+	// Every component of a type, for walking by hand
+	template<typename T>
+	ComponentPool<T>& GetPool()
+	{
+		unsigned int id = GetComponentTypeId<T>();
+		if (id >= pools.size())
+			pools.resize(id + 1);
+		if (!pools[id])
+			pools[id].reset(new ComponentPool<T>());
+		return static_cast<ComponentPool<T>&>(*pools[id]);
+	}
+
+	// Calls func(Entity, First&, Rest&...) for every entity with
+	// all of the given components, in the order of First's pool
+	template<typename First, typename... Rest, typename Func>
+	void Each(Func func)
+	{
+		EachInRange<First, Rest...>(0, GetPool<First>().GetSize(), func, std::index_sequence_for<Rest...>());
+	}
+
+	// The same, for only the components in [begin, end) of
+	// First's pool, so a query can be split into pieces
+	template<typename First, typename... Rest, typename Func>
+	void EachInRange(unsigned int begin, unsigned int end, Func func)
+	{
+		EachInRange<First, Rest...>(begin, end, func, std::index_sequence_for<Rest...>());
+	}
+
+	// The entity in a slot (as pools list them)
+	Entity GetEntity(unsigned int index) const
+	{
+		Entity entity = { index, generations[index] };
+		return entity;
+	}
+
+private:
+	std::vector<std::unique_ptr<ComponentPoolBase>> pools;	// By component type
+	std::vector<unsigned int> generations;					// By slot
+	std::vector<unsigned int> freeSlots;
+
+	template<typename First, typename... Rest, typename Func, size_t... I>
+	void EachInRange(unsigned int begin, unsigned int end, Func& func, std::index_sequence<I...>)
+	{
+		ComponentPool<First>& first = GetPool<First>();
+		std::tuple<ComponentPool<Rest>*...> rest{ &GetPool<Rest>()... };
+		(void)rest;
+
+		const unsigned int* entities = first.GetEntities();
+		First* components = first.GetComponents();
+		for (unsigned int i = begin; i < end; i++)
+			Visit(func, entities[i], components[i], std::get<I>(rest)->Find(entities[i], i)...);
+	}
+
+	template<typename Func, typename First, typename... Rest>
+	void Visit(Func& func, unsigned int index, First& first, Rest*... rest)
+	{
+		if (AllFound(rest...))
+			func(GetEntity(index), first, *rest...);
+	}
+
+	static bool AllFound() { return true; }
+
+	template<typename T, typename... Rest>
+	static bool AllFound(T* component, Rest*... rest) { return component && AllFound(rest...); }
+};
+
+// --------------------------------------------------------
+// Milliseconds per frame to run the same systems over one
+// layout of entities
+// --------------------------------------------------------
+struct EntityRegistryTiming
+{
+	const char* Layout;
+	double UpdateTime;		// Spinning and recomputing bounds
+	double IterateTime;		// Reading bounds and materials
+	bool Matches;			// Same results as the first layout?
+};
+
+// Makes the given number of entities, each with a transform,
+// a mesh, a material and bounds, as shared objects (the way
+// the game used to keep them, in creation order and
+// shuffled, as a heap that's seen some use would leave them)
+// and in a registry, then times systems over each
+void RunEntityRegistryBenchmark(unsigned int entityCount, unsigned int frames, std::vector<EntityRegistryTiming>* timings);
@@ -0,0 +1,466 @@
+#include "FileSystem.h"
+#include "AssetRegistry.h"
+#include "Helpers.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string.h>
+
+// Every mounted pack, most recently mounted last
+static std::mutex mountMutex;
+static std::vector<std::shared_ptr<AssetPack>> mountedPacks;
+
+// Totals for GetAssetFileStats()
+static std::atomic<unsigned int> packFiles(0);
+static std::atomic<unsigned int> decompressedFiles(0);
+static std::atomic<unsigned int> looseFiles(0);
+static std::atomic<size_t> packBytes(0);
+static std::atomic<size_t> decompressedBytes(0);
+static std::atomic<size_t> looseBytes(0);
+
+
+// === PACKS ========================================================
+
+// --------------------------------------------------------
+// Maps a pack archive into memory and reads its index.
+// Check IsValid() afterwards, as a missing or corrupt
+// file leaves the pack empty.
+// --------------------------------------------------------
+AssetPack::AssetPack(const std::wstring& path) :
+	path(path),
+	file(INVALID_HANDLE_VALUE),
+	mapping(0),
+	data(0),
+	size(0)
+{
+	file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		return;
+
+	mapping = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapping)
+		return;
+
+	const unsigned char* view = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+		return;
+
+	if (!ReadPackArchiveIndex(view, (size_t)fileSize.QuadPart, &entries))
+	{
+		UnmapViewOfFile(view);
+		entries.clear();
+		return;
+	}
+
+	data = view;
+	size = (size_t)fileSize.QuadPart;
+	for (size_t i = 0; i < entries.size(); i++)
+		byKey[NarrowToWide(entries[i].Path)] = i;
+}
+
+AssetPack::~AssetPack()
+{
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+}
+
+// --------------------------------------------------------
+// Opens an entry: in place if it's stored as is, or
+// decompressed into a copy otherwise
+//
+// key  - From GetAssetFileKey()
+// file - Receives the contents
+// --------------------------------------------------------
+bool AssetPack::Open(const std::wstring& key, AssetFile* file)
+{
+	auto found = byKey.find(key);
+	if (found == byKey.end())
+		return false;
+
+	const PackArchiveEntry& entry = entries[found->second];
+	if (entry.Compression == PACK_ARCHIVE_STORED)
+	{
+		file->Data = data + entry.Offset;
+		file->Size = (size_t)entry.Size;
+		file->FromPack = true;
+		file->Owner = shared_from_this();
+		packFiles++;
+		packBytes += file->Size;
+		return true;
+	}
+
+	std::shared_ptr<std::vector<unsigned char>> copy = std::make_shared<std::vector<unsigned char>>((size_t)entry.Size + 1);
+	if (!ReadPackArchiveEntry(data, entry, &(*copy)[0]))
+		return false;
+
+	file->Data = &(*copy)[0];
+	file->Size = (size_t)entry.Size;
+	file->FromPack = true;
+	file->Owner = copy;
+	decompressedFiles++;
+	decompressedBytes += file->Size;
+	return true;
+}
+
+// --------------------------------------------------------
+// Copies part of an entry, which only touches those bytes
+// of the mapping if it's stored as is
+// --------------------------------------------------------
+bool AssetPack::ReadRange(const std::wstring& key, size_t offset, size_t size, void* data)
+{
+	auto found = byKey.find(key);
+	if (found == byKey.end())
+		return false;
+
+	const PackArchiveEntry& entry = entries[found->second];
+	if (offset > entry.Size || size > entry.Size - offset)
+		return false;
+
+	if (entry.Compression == PACK_ARCHIVE_STORED)
+	{
+		memcpy(data, this->data + entry.Offset + offset, size);
+		packBytes += size;
+		return true;
+	}
+
+	AssetFile whole;
+	if (!Open(key, &whole))
+		return false;
+	memcpy(data, whole.Data + offset, size);
+	return true;
+}
+
+
+// === ASSET FILES ==================================================
+
+// Splits a normalized path into its parts
+static std::vector<std::wstring> SplitPath(const std::wstring& path)
+{
+	std::vector<std::wstring> parts;
+	size_t start = 0;
+	for (size_t i = 0; i <= path.size(); i++)
+	{
+		if (i < path.size() && path[i] != L'\\')
+			continue;
+		parts.push_back(path.substr(start, i - start));
+		start = i + 1;
+	}
+	return parts;
+}
+
+// --------------------------------------------------------
+// Gets the name a file has within packs: its path relative
+// to the executable's folder, normalized, so the full
+// paths FixPath() makes match no matter where the program
+// is run from.  Relative paths are assumed to already be
+// relative to that folder.
+// --------------------------------------------------------
+std::wstring GetAssetFileKey(const std::wstring& path)
+{
+	std::wstring normalized = NormalizeAssetPath(path);
+	bool absolute = (normalized.size() > 1 && normalized[1] == L':') || (!normalized.empty() && normalized[0] == L'\\');
+	if (!absolute)
+		return normalized;
+
+	// The folder never changes, so it's only split once
+	static const std::vector<std::wstring> rootParts = SplitPath(NormalizeAssetPath(GetExePath()));
+	std::vector<std::wstring> parts = SplitPath(normalized);
+
+	// Files on another drive keep their full path
+	size_t common = 0;
+	while (common < rootParts.size() && common < parts.size() && rootParts[common] == parts[common])
+		common++;
+	if (common == 0)
+		return normalized;
+
+	std::wstring key;
+	for (size_t i = common; i < rootParts.size(); i++)
+		key += L"..\\";
+	for (size_t i = common; i < parts.size(); i++)
+		key += parts[i] + (i + 1 < parts.size() ? L"\\" : L"");
+	return key;
+}
+
+// --------------------------------------------------------
+// Maps a pack, whose files are then found before any loose
+// files (or earlier packs) with the same names
+//
+// Returns false if the pack is missing or corrupt
+// --------------------------------------------------------
+bool MountAssetPack(const std::wstring& path)
+{
+	std::shared_ptr<AssetPack> pack = std::make_shared<AssetPack>(path);
+	if (!pack->IsValid())
+		return false;
+
+	std::lock_guard<std::mutex> lock(mountMutex);
+	mountedPacks.push_back(pack);
+	return true;
+}
+
+// --------------------------------------------------------
+// Stops using every pack.  Each is unmapped once nothing
+// is using its files anymore.
+// --------------------------------------------------------
+void UnmountAssetPacks()
+{
+	std::lock_guard<std::mutex> lock(mountMutex);
+	mountedPacks.clear();
+}
+
+std::vector<std::shared_ptr<AssetPack>> GetMountedAssetPacks()
+{
+	std::lock_guard<std::mutex> lock(mountMutex);
+	return mountedPacks;
+}
+
+// Finds the most recently mounted pack that has a file
+static std::shared_ptr<AssetPack> FindPackWith(const std::wstring& key)
+{
+	std::lock_guard<std::mutex> lock(mountMutex);
+	for (auto pack = mountedPacks.rbegin(); pack != mountedPacks.rend(); ++pack)
+	{
+		if ((*pack)->Contains(key))
+			return *pack;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// Opens an asset file from whichever mounted pack has it,
+// or reads it from disk if none do.  Safe on any thread.
+//
+// path - Full path to the file, usually from FixPath()
+// file - Receives the contents
+//
+// Returns false if the file can't be found or read
+// --------------------------------------------------------
+bool OpenAssetFile(const std::wstring& path, AssetFile* file)
+{
+	std::wstring key = GetAssetFileKey(path);
+	std::shared_ptr<AssetPack> pack = FindPackWith(key);
+	if (pack)
+		return pack->Open(key, file);
+
+	std::ifstream in(path, std::ios::binary | std::ios::ate);
+	if (!in.is_open())
+		return false;
+
+	size_t size = (size_t)in.tellg();
+	std::shared_ptr<std::vector<unsigned char>> copy = std::make_shared<std::vector<unsigned char>>(size + 1);
+	in.seekg(0);
+	if (!in.read((char*)&(*copy)[0], size))
+		return false;
+
+	file->Data = &(*copy)[0];
+	file->Size = size;
+	file->FromPack = false;
+	file->Owner = copy;
+	looseFiles++;
+	looseBytes += size;
+	return true;
+}
+
+// --------------------------------------------------------
+// Reads part of an asset file, without reading the rest
+// (unless it's compressed in a pack)
+// --------------------------------------------------------
+bool ReadAssetFileRange(const std::wstring& path, size_t offset, size_t size, void* data)
+{
+	std::wstring key = GetAssetFileKey(path);
+	std::shared_ptr<AssetPack> pack = FindPackWith(key);
+	if (pack)
+		return pack->ReadRange(key, offset, size, data);
+
+	std::ifstream in(path, std::ios::binary);
+	if (!in.is_open())
+		return false;
+
+	in.seekg(offset);
+	in.read((char*)data, size);
+	looseBytes += size;
+	return in.good() && (size_t)in.gcount() == size;
+}
+
+AssetFileStats GetAssetFileStats()
+{
+	AssetFileStats stats;
+	stats.PackFiles = packFiles;
+	stats.DecompressedFiles = decompressedFiles;
+	stats.LooseFiles = looseFiles;
+	stats.PackBytes = packBytes;
+	stats.DecompressedBytes = decompressedBytes;
+	stats.LooseBytes = looseBytes;
+	return stats;
+}
+
+void ResetAssetFileStats()
+{
+	packFiles = 0;
+	decompressedFiles = 0;
+	looseFiles = 0;
+	packBytes = 0;
+	decompressedBytes = 0;
+	looseBytes = 0;
+}
+
+
+// === BUILDING PACKS ===============================================
+
+// --------------------------------------------------------
+// Finds every file in a folder and its subfolders
+//
+// directory - Full path to the folder
+// extension - Only files ending with this (case doesn't
+//             matter), or every file if it's empty
+// files     - Full paths are added to this
+// --------------------------------------------------------
+void FindAssetFiles(const std::wstring& directory, const std::wstring& extension, std::vector<std::wstring>* files)
+{
+	WIN32_FIND_DATAW found;
+	HANDLE find = FindFirstFileW((directory + L"\\*").c_str(), &found);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+
+	do
+	{
+		std::wstring name = found.cFileName;
+		if (name == L"." || name == L"..")
+			continue;
+
+		std::wstring path = directory + L"\\" + name;
+		if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			FindAssetFiles(path, extension, files);
+			continue;
+		}
+
+		if (name.size() >= extension.size() &&
+			_wcsicmp(name.c_str() + name.size() - extension.size(), extension.c_str()) == 0)
+			files->push_back(path);
+	} while (FindNextFileW(find, &found));
+
+	FindClose(find);
+}
+
+// --------------------------------------------------------
+// Packs loose files (never ones from mounted packs) into
+// an archive, each named by GetAssetFileKey()
+//
+// packPath - Where to save the pack, which can't be
+//            mounted at the time
+// files    - Full paths of the files to pack
+// compress - Compress entries with LZ4 where it helps
+//
+// Returns false if any file can't be read, or the pack
+// can't be saved
+// --------------------------------------------------------
+bool BuildAssetPack(const std::wstring& packPath, const std::vector<std::wstring>& files, bool compress)
+{
+	std::vector<PackArchiveSource> sources(files.size());
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		std::ifstream in(files[i], std::ios::binary);
+		if (!in.is_open())
+			return false;
+
+		sources[i].Path = WideToNarrow(GetAssetFileKey(files[i]));
+		sources[i].Data.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	}
+
+	std::vector<unsigned char> archive;
+	BuildPackArchive(sources, compress, &archive);
+
+	std::ofstream out(packPath, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return false;
+	out.write((const char*)&archive[0], archive.size());
+	return out.good();
+}
+
+
+// === BENCHMARK ====================================================
+
+// --------------------------------------------------------
+// Times reading every packable file three ways: as loose
+// files, from a pack of them stored as is, and from one
+// compressed with LZ4.  Every byte is hashed, so mapped
+// data is actually read.  The files are likely in the OS
+// file cache, so this mostly measures the cost per file.
+//
+// files   - Loose files to read (and pack)
+// timings - Filled in with one timing per way of reading
+// --------------------------------------------------------
+void RunAssetReadBenchmark(const std::vector<std::wstring>& files, std::vector<AssetReadTiming>* timings)
+{
+	timings->clear();
+
+	std::wstring packPaths[2] = { FixPath(L"Benchmark.pak"), FixPath(L"BenchmarkLZ4.pak") };
+	if (!BuildAssetPack(packPaths[0], files, false) || !BuildAssetPack(packPaths[1], files, true))
+		return;
+
+	const char* methods[] = { "Loose Files", "Pack", "Pack (LZ4)" };
+	for (int m = 0; m < 3; m++)
+	{
+		const int runs = 3;
+		AssetReadTiming timing = {};
+		timing.Method = methods[m];
+		timing.FileCount = (unsigned int)files.size();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int run = 0; run < runs; run++)
+		{
+			// Mapping the pack counts as part of reading it
+			std::shared_ptr<AssetPack> pack;
+			if (m > 0)
+			{
+				pack = std::make_shared<AssetPack>(packPaths[m - 1]);
+				timing.Bytes = pack->GetSize();
+			}
+
+			size_t bytes = 0;
+			for (auto& f : files)
+			{
+				AssetFile file;
+				if (pack)
+				{
+					if (!pack->Open(GetAssetFileKey(f), &file))
+						continue;
+				}
+				else
+				{
+					std::ifstream in(f, std::ios::binary);
+					std::shared_ptr<std::vector<unsigned char>> copy = std::make_shared<std::vector<unsigned char>>(
+						(std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+					copy->push_back(0);
+					file.Data = &(*copy)[0];
+					file.Size = copy->size() - 1;
+					file.Owner = copy;
+				}
+
+				timing.Hash = HashAssetData(file.Data, file.Size, timing.Hash);
+				bytes += file.Size;
+			}
+
+			if (!pack)
+				timing.Bytes = bytes;
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		timing.Time = std::chrono::duration<double, std::milli>(end - start).count() / runs;
+
+		timings->push_back(timing);
+	}
+
+	for (auto& p : packPaths)
+		DeleteFileW(p.c_str());
+}
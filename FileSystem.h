@@ -0,0 +1,128 @@
+#pragma once
+
+#include <Windows.h>
+#include <istream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PackArchive.h"
+
+// --------------------------------------------------------
+// The contents of an asset file.  Data points straight into
+// a mounted pack when it can, or at a copy (for loose files
+// and compressed entries).  Either way it stays valid as
+// long as this (or a copy of it) exists.
+// --------------------------------------------------------
+struct AssetFile
+{
+	const unsigned char* Data = 0;
+	size_t Size = 0;
+	bool FromPack = false;
+	std::shared_ptr<const void> Owner;	// Keeps Data alive
+};
+
+// --------------------------------------------------------
+// Totals across every asset file opened, since the last reset
+// --------------------------------------------------------
+struct AssetFileStats
+{
+	unsigned int PackFiles = 0;			// Used in place from a pack
+	unsigned int DecompressedFiles = 0;	// From a pack, but compressed
+	unsigned int LooseFiles = 0;		// Not in any pack, so read from disk
+	size_t PackBytes = 0;
+	size_t DecompressedBytes = 0;
+	size_t LooseBytes = 0;
+};
+
+// --------------------------------------------------------
+// A pack archive (see PackArchive.h), memory mapped once and
+// kept mapped.  Entries are named by their path relative to
+// the executable's folder (see GetAssetFileKey()).
+// --------------------------------------------------------
+class AssetPack : public std::enable_shared_from_this<AssetPack>
+{
+public:
+	AssetPack(const std::wstring& path);
+	~AssetPack();
+
+	bool IsValid() { return data != 0; }
+	bool Open(const std::wstring& key, AssetFile* file);
+	bool ReadRange(const std::wstring& key, size_t offset, size_t size, void* data);
+	bool Contains(const std::wstring& key) { return byKey.count(key) > 0; }
+
+	const std::wstring& GetPath() { return path; }
+	size_t GetSize() { return size; }
+	const std::vector<PackArchiveEntry>& GetEntries() { return entries; }
+
+private:
+	std::wstring path;
+	HANDLE file;
+	HANDLE mapping;
+	const unsigned char* data;
+	size_t size;
+
+	std::vector<PackArchiveEntry> entries;
+	std::unordered_map<std::wstring, size_t> byKey;
+};
+
+// --------------------------------------------------------
+// Reads an asset file's bytes through a stream, without
+// copying them
+// --------------------------------------------------------
+class AssetFileStream : public std::istream
+{
+public:
+	AssetFileStream(const AssetFile& file) : std::istream(&buffer), file(file), buffer(file) {}
+
+private:
+	struct Buffer : public std::streambuf
+	{
+		Buffer(const AssetFile& file)
+		{
+			char* start = (char*)file.Data;
+			setg(start, start, start + file.Size);
+		}
+	};
+
+	AssetFile file;
+	Buffer buffer;
+};
+
+// The name of a file within packs: its normalized path,
+// relative to the executable's folder
+std::wstring GetAssetFileKey(const std::wstring& path);
+
+// Mounted packs are searched most recently mounted first.
+// Only mount or unmount while nothing is being loaded.
+bool MountAssetPack(const std::wstring& path);
+void UnmountAssetPacks();
+std::vector<std::shared_ptr<AssetPack>> GetMountedAssetPacks();
+
+// Reading asset files (full paths, usually from FixPath()),
+// from a mounted pack if one has the file, or from disk
+bool OpenAssetFile(const std::wstring& path, AssetFile* file);
+bool ReadAssetFileRange(const std::wstring& path, size_t offset, size_t size, void* data);
+AssetFileStats GetAssetFileStats();
+void ResetAssetFileStats();
+
+// Building packs from loose files
+void FindAssetFiles(const std::wstring& directory, const std::wstring& extension, std::vector<std::wstring>* files);
+bool BuildAssetPack(const std::wstring& packPath, const std::vector<std::wstring>& files, bool compress);
+
+// --------------------------------------------------------
+// Results of timing reads of every file one way
+// --------------------------------------------------------
+struct AssetReadTiming
+{
+	const char* Method;
+	unsigned int FileCount;
+	size_t Bytes;				// Read from disk (or mapped)
+	double Time;				// Milliseconds per pass over every file
+	unsigned long long Hash;	// Of everything read, so nothing is skipped
+};
+
+// Reads the same files loose, and from packs of them built
+// (and deleted again) for the benchmark
+void RunAssetReadBenchmark(const std::vector<std::wstring>& files, std::vector<AssetReadTiming>* timings);
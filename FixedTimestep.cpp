@@ -0,0 +1,85 @@
+#include "FixedTimestep.h"
+
+#include <algorithm>
+
+// --------------------------------------------------------
+// Creates a timestep with nothing accumulated yet
+//
+// stepTime - Seconds each step simulates
+// maxSteps - Most steps to run in a single frame
+// --------------------------------------------------------
+FixedTimestep::FixedTimestep(double stepTime, unsigned int maxSteps) :
+	stepTime(1.0),
+	maxSteps(1),
+	accumulator(0)
+{
+	SetStepTime(stepTime);
+	SetMaxSteps(maxSteps);
+	Reset();
+}
+
+// --------------------------------------------------------
+// Adds a frame's worth of real time.  Anything more than
+// the most steps a frame can run is dropped, so the
+// simulation slows down instead of falling further behind.
+// --------------------------------------------------------
+void FixedTimestep::Accumulate(double deltaTime)
+{
+	stepsThisFrame = 0;
+
+	double clamped = (std::min)((std::max)(deltaTime, 0.0), FIXED_TIMESTEP_MAX_DELTA);
+	droppedTime += (std::max)(deltaTime, 0.0) - clamped;
+	accumulator += clamped;
+
+	double limit = stepTime * maxSteps;
+	if (accumulator > limit)
+	{
+		droppedTime += accumulator - limit;
+		accumulator = limit;
+		cappedFrames++;
+	}
+}
+
+// --------------------------------------------------------
+// Takes one step's worth of accumulated time
+//
+// Returns true if the simulation should step once more
+// --------------------------------------------------------
+bool FixedTimestep::Step()
+{
+	// Leftovers from rounding don't add up to a lost step
+	if (accumulator < stepTime * (1.0 - 1e-9) || stepsThisFrame >= maxSteps)
+		return false;
+
+	accumulator = (std::max)(accumulator - stepTime, 0.0);
+	simulatedTime += stepTime;
+	stepsThisFrame++;
+	totalSteps++;
+	return true;
+}
+
+// --------------------------------------------------------
+// Starts over, with no time accumulated or simulated
+// --------------------------------------------------------
+void FixedTimestep::Reset()
+{
+	accumulator = 0;
+	simulatedTime = 0;
+	stepsThisFrame = 0;
+	totalSteps = 0;
+	cappedFrames = 0;
+	droppedTime = 0;
+}
+
+// Changing the step keeps whatever's accumulated, though
+// no more than one new step's worth
+void FixedTimestep::SetStepTime(double stepTime)
+{
+	this->stepTime = (std::max)(stepTime, 0.0001);
+	accumulator = (std::min)(accumulator, this->stepTime);
+}
+
+void FixedTimestep::SetMaxSteps(unsigned int maxSteps)
+{
+	this->maxSteps = (std::max)(maxSteps, 1u);
+}
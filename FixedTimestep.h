@@ -0,0 +1,65 @@
+#pragma once
+
+// Default length of a simulation step, in seconds
+#define FIXED_TIMESTEP_STEP			(1.0 / 60.0)
+
+// Most steps run in one frame.  Past this the simulation
+// falls behind real time rather than taking ever longer
+// frames to catch up (the "spiral of death").
+#define FIXED_TIMESTEP_MAX_STEPS	5
+
+// Longest frame that's counted in full, so a stall (like a
+// breakpoint or dragging the window) isn't caught up on
+#define FIXED_TIMESTEP_MAX_DELTA	0.25
+
+// --------------------------------------------------------
+// Accumulates real time and hands it out as steps of a
+// fixed length, so a simulation behaves the same (and costs
+// the same per simulated second) at any frame rate.
+//
+// Each frame, call Accumulate() with the frame's length,
+// then simulate once for every time Step() returns true.
+// Whatever time is left over, as a fraction of a step, is
+// how far to interpolate from the previous step's state to
+// the latest when drawing.
+//
+// Has no knowledge of Direct3D, so it can be exercised on
+// its own.
+// --------------------------------------------------------
+class FixedTimestep
+{
+public:
+	FixedTimestep(double stepTime = FIXED_TIMESTEP_STEP, unsigned int maxSteps = FIXED_TIMESTEP_MAX_STEPS);
+
+	void Accumulate(double deltaTime);
+	bool Step();
+	void Reset();
+
+	double GetStepTime() { return stepTime; }
+	void SetStepTime(double stepTime);
+	unsigned int GetMaxSteps() { return maxSteps; }
+	void SetMaxSteps(unsigned int maxSteps);
+
+	// From 0 (just stepped) up to 1 (due to step)
+	double GetAlpha() { return accumulator < stepTime ? accumulator / stepTime : 1.0; }
+
+	// Seconds of simulation run so far
+	double GetSimulatedTime() { return simulatedTime; }
+
+	// Statistics, since the last Reset()
+	unsigned int GetStepsThisFrame() { return stepsThisFrame; }
+	unsigned long long GetTotalSteps() { return totalSteps; }
+	unsigned int GetCappedFrames() { return cappedFrames; }
+	double GetDroppedTime() { return droppedTime; }
+
+private:
+	double stepTime;
+	unsigned int maxSteps;
+	double accumulator;			// Real time not yet simulated
+	double simulatedTime;
+
+	unsigned int stepsThisFrame;
+	unsigned long long totalSteps;
+	unsigned int cappedFrames;	// Frames that couldn't catch up
+	double droppedTime;			// Seconds never simulated
+};
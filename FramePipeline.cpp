@@ -0,0 +1,98 @@
+#include "FramePipeline.h"
+
+#include <chrono>
+
+// A frame of the benchmark, standing in for a snapshot
+struct BenchmarkFrame
+{
+	unsigned int Number = 0;
+	unsigned int Value = 0;
+};
+
+// --------------------------------------------------------
+// Keeps a thread busy for a while
+// --------------------------------------------------------
+static unsigned int BusyWork(double milliseconds, unsigned int seed)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	do
+	{
+		for (int i = 0; i < 100; i++)
+			seed = seed * 1664525u + 1013904223u;
+	} while (std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() < milliseconds);
+	return seed;
+}
+
+// What a frame's simulation produces, which only depends on
+// the frame's number (unlike how much busy work fit)
+static unsigned int SimulateFrame(unsigned int frame, double milliseconds)
+{
+	BusyWork(milliseconds, frame);
+	return frame * 2654435761u;
+}
+
+// --------------------------------------------------------
+// Times frames of busy work run serially (simulate, then
+// render) and pipelined (simulating the next frame on
+// another thread while rendering this one), for a few
+// mixes of simulation and render cost.  The pipelined
+// frame time should approach the larger of the two costs
+// rather than their sum, given a spare core.
+//
+// frameCount - Frames to run each way, for each mix
+// timings    - Receives a timing per mix
+// --------------------------------------------------------
+void RunFramePipelineBenchmark(unsigned int frameCount, std::vector<FramePipelineTiming>* timings)
+{
+	timings->clear();
+
+	const double costs[][2] = { { 2, 2 }, { 4, 1 }, { 1, 4 }, { 8, 8 } };
+	for (auto& cost : costs)
+	{
+		FramePipelineTiming timing;
+		timing.SimulationCost = cost[0];
+		timing.RenderCost = cost[1];
+
+		// One after the other, as Update() and Draw() run
+		unsigned int serialSum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int f = 0; f < frameCount; f++)
+		{
+			unsigned int value = SimulateFrame(f, cost[0]);
+			BusyWork(cost[1], value);
+			serialSum = serialSum * 31 + value;
+		}
+		timing.SerialTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frameCount;
+
+		// Overlapped, with the simulation a frame ahead
+		FramePipeline<BenchmarkFrame> pipeline;
+		unsigned int pipelinedSum = 0;
+		start = std::chrono::high_resolution_clock::now();
+		std::thread simulation([&]()
+		{
+			for (unsigned int f = 0; f < frameCount; f++)
+			{
+				BenchmarkFrame* frame = pipeline.BeginWrite();
+				if (!frame)
+					return;
+				frame->Number = f;
+				frame->Value = SimulateFrame(f, cost[0]);
+				pipeline.EndWrite();
+			}
+		});
+		for (unsigned int f = 0; f < frameCount; f++)
+		{
+			const BenchmarkFrame* frame = pipeline.BeginRead();
+			if (!frame)
+				break;
+			BusyWork(cost[1], frame->Value);
+			pipelinedSum = pipelinedSum * 31 + (frame->Number == f ? frame->Value : 0);
+			pipeline.EndRead();
+		}
+		simulation.join();
+		timing.PipelinedTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frameCount;
+
+		timing.Matches = serialSum == pipelinedSum;
+		timings->push_back(timing);
+	}
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// Hands frames from one producing thread to one consuming
+// thread through two buffers, so the producer can build
+// frame N+1 while the consumer uses frame N.
+//
+// Handing a frame over is just an atomic store of a count
+// that the other side reads, so neither side locks while
+// there's a buffer ready for it.  A side that must wait
+// spins briefly, then sleeps until the other wakes it
+// (which it only bothers to do when someone's asleep).
+//
+// Stop() wakes both sides, after which Begin calls return
+// null.  T must be default constructible, and is reused
+// frame after frame so its storage can be too.
+// --------------------------------------------------------
+template<typename T>
+class FramePipeline
+{
+public:
+	FramePipeline() :
+		produced(0),
+		consumed(0),
+		sleepers(0),
+		stopping(false)
+	{
+	}
+
+	// Producer: a buffer to fill, once the consumer is done
+	// with the frame that was last in it
+	T* BeginWrite()
+	{
+		unsigned long long p = produced.load(std::memory_order_relaxed);
+		if (!WaitFor([&]() { return p - consumed.load(std::memory_order_seq_cst) < 2; }))
+			return 0;
+		return &frames[p % 2];
+	}
+
+	// Producer: hands the filled buffer over
+	void EndWrite()
+	{
+		produced.store(produced.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+		Wake();
+	}
+
+	// Consumer: the oldest frame not yet consumed
+	const T* BeginRead()
+	{
+		unsigned long long c = consumed.load(std::memory_order_relaxed);
+		if (!WaitFor([&]() { return produced.load(std::memory_order_seq_cst) > c; }))
+			return 0;
+		return &frames[c % 2];
+	}
+
+	// Consumer: gives the buffer back to the producer
+	void EndRead()
+	{
+		consumed.store(consumed.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+		Wake();
+	}
+
+	// Makes both sides give up waiting, now and from now on
+	void Stop()
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+		wake.notify_all();
+	}
+
+	// Starts over, with no frames in either buffer.  Only
+	// safe while neither side is using the pipeline.
+	void Reset()
+	{
+		produced = 0;
+		consumed = 0;
+		stopping = false;
+	}
+
+	unsigned long long GetFramesProduced() { return produced.load(); }
+	unsigned long long GetFramesConsumed() { return consumed.load(); }
+
+private:
+	T frames[2];
+	std::atomic<unsigned long long> produced;
+	std::atomic<unsigned long long> consumed;
+
+	// Sleeping while there's nothing to do
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> sleepers;
+	bool stopping;
+
+	// Returns false if stopped before the condition was met
+	template<typename Condition>
+	bool WaitFor(Condition ready)
+	{
+		for (int spin = 0; spin < 64; spin++)
+		{
+			if (ready())
+				return true;
+			std::this_thread::yield();
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepers.fetch_add(1, std::memory_order_seq_cst);
+		wake.wait(lock, [&]() { return stopping || ready(); });
+		sleepers.fetch_sub(1, std::memory_order_seq_cst);
+		return !stopping;
+	}
+
+	// The count was stored first, so anyone who went to sleep
+	// before seeing it is counted here
+	void Wake()
+	{
+		if (sleepers.load(std::memory_order_seq_cst) == 0)
+			return;
+
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wake.notify_all();
+	}
+};
+
+// --------------------------------------------------------
+// Throughput of running frames one part after the other
+// versus overlapping the parts through a FramePipeline
+// --------------------------------------------------------
+struct FramePipelineTiming
+{
+	double SimulationCost;	// Milliseconds of work per frame
+	double RenderCost;		// Milliseconds of work per frame
+	double SerialTime;		// Average milliseconds per frame
+	double PipelinedTime;	// Average milliseconds per frame
+	bool Matches;			// Did both consume the same frames?
+};
+
+// Runs frames made of busy work, first serially and then
+// pipelined, for a few mixes of simulation and render cost
+void RunFramePipelineBenchmark(unsigned int frameCount, std::vector<FramePipelineTiming>* timings);
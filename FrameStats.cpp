@@ -0,0 +1,132 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <math.h>
+
+// --------------------------------------------------------
+// Creates empty statistics
+//
+// capacity - Frames of history to keep
+// --------------------------------------------------------
+FrameStats::FrameStats(unsigned int capacity) :
+	frames((std::max)(capacity, 1u)),
+	next(0),
+	count(0),
+	totalFrames(0)
+{
+}
+
+// --------------------------------------------------------
+// Records a frame, replacing the oldest once full
+// --------------------------------------------------------
+void FrameStats::AddFrame(const FrameTiming& frame)
+{
+	frames[next] = frame;
+	next = (next + 1) % frames.size();
+	count = (std::min)(count + 1, (unsigned int)frames.size());
+	totalFrames++;
+}
+
+// --------------------------------------------------------
+// Forgets every frame recorded so far (though frames keep
+// their numbers)
+// --------------------------------------------------------
+void FrameStats::Clear()
+{
+	next = 0;
+	count = 0;
+}
+
+// --------------------------------------------------------
+// Gets the average, percentiles (nearest rank) and maximum
+// of each part, and counts the frames that hitched: those
+// over FRAME_STATS_HITCH_FACTOR times the median total
+// --------------------------------------------------------
+FrameStatsSummary FrameStats::Summarize()
+{
+	FrameStatsSummary summary;
+	summary.FrameCount = count;
+	if (count == 0)
+		return summary;
+
+	std::vector<double> times(count);
+	auto percentile = [&](double p)
+	{
+		size_t rank = (size_t)ceil(p / 100.0 * count);
+		return times[(std::max)(rank, (size_t)1) - 1];
+	};
+
+	for (unsigned int part = 0; part < FRAME_STATS_PART_COUNT; part++)
+	{
+		double sum = 0;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			times[i] = GetFrame(i).Times[part];
+			sum += times[i];
+		}
+		std::sort(times.begin(), times.end());
+
+		FrameTimeDistribution& d = summary.Parts[part];
+		d.Average = sum / count;
+		d.P50 = percentile(50);
+		d.P95 = percentile(95);
+		d.P99 = percentile(99);
+		d.Max = times.back();
+	}
+
+	summary.HitchThreshold = summary.Parts[FRAME_STATS_TOTAL].P50 * FRAME_STATS_HITCH_FACTOR;
+	for (unsigned int i = 0; i < count; i++)
+		summary.Hitches += GetFrame(i).Times[FRAME_STATS_TOTAL] > summary.HitchThreshold ? 1 : 0;
+
+	return summary;
+}
+
+// --------------------------------------------------------
+// Counts how many frames fall into each of a range of
+// equally sized buckets of time, for a histogram
+//
+// part        - Which FRAME_STATS_ part
+// maxTime     - Milliseconds where the last bucket ends (and
+//               which also holds any slower frames)
+// bucketCount - How many buckets to split it into
+// buckets     - Receives the counts (as floats, for plotting)
+// --------------------------------------------------------
+void FrameStats::GetHistogram(unsigned int part, double maxTime, unsigned int bucketCount, std::vector<float>* buckets)
+{
+	buckets->assign(bucketCount, 0.0f);
+	if (bucketCount == 0 || maxTime <= 0)
+		return;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		double time = GetFrame(i).Times[part];
+		unsigned int bucket = (unsigned int)(std::max)(time / maxTime * bucketCount, 0.0);
+		(*buckets)[(std::min)(bucket, bucketCount - 1)] += 1.0f;
+	}
+}
+
+// --------------------------------------------------------
+// Writes every recorded frame as comma separated values,
+// one row per frame with a header row first
+// --------------------------------------------------------
+void FrameStats::WriteCSV(std::ostream& out)
+{
+	out << "Frame";
+	for (unsigned int part = 0; part < FRAME_STATS_PART_COUNT; part++)
+		out << "," << GetPartName(part) << " (ms)";
+	out << "\n";
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		out << GetFrameNumber(i);
+		for (unsigned int part = 0; part < FRAME_STATS_PART_COUNT; part++)
+			out << "," << GetFrame(i).Times[part];
+		out << "\n";
+	}
+}
+
+const char* FrameStats::GetPartName(unsigned int part)
+{
+	const char* names[FRAME_STATS_PART_COUNT] = { "Total", "Update", "Draw", "Present", "Messages" };
+	return part < FRAME_STATS_PART_COUNT ? names[part] : "";
+}
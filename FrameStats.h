@@ -0,0 +1,83 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+// Frames of history kept for statistics
+#define FRAME_STATS_HISTORY		1024
+
+// Frames taking this many times longer than the median count as hitches
+#define FRAME_STATS_HITCH_FACTOR	2.0
+
+// Each part of a frame that's timed
+#define FRAME_STATS_TOTAL		0
+#define FRAME_STATS_UPDATE		1
+#define FRAME_STATS_DRAW		2	// Not including Present()
+#define FRAME_STATS_PRESENT		3
+#define FRAME_STATS_MESSAGES	4	// Pumping window messages since the last frame
+#define FRAME_STATS_PART_COUNT	5
+
+// --------------------------------------------------------
+// CPU times for one frame, in milliseconds, indexed by the
+// FRAME_STATS_ parts above.  The total runs from the end of
+// the last frame to the end of this one, so it includes
+// anything not timed separately.
+// --------------------------------------------------------
+struct FrameTiming
+{
+	double Times[FRAME_STATS_PART_COUNT] = {};
+};
+
+// --------------------------------------------------------
+// Distribution of one part's times across the history
+// --------------------------------------------------------
+struct FrameTimeDistribution
+{
+	double Average = 0;
+	double P50 = 0;
+	double P95 = 0;
+	double P99 = 0;
+	double Max = 0;
+};
+
+struct FrameStatsSummary
+{
+	unsigned int FrameCount = 0;
+	FrameTimeDistribution Parts[FRAME_STATS_PART_COUNT];
+	unsigned int Hitches = 0;		// Frames whose total was over the threshold
+	double HitchThreshold = 0;		// Milliseconds
+};
+
+// --------------------------------------------------------
+// Records the timing of recent frames in a ring buffer, and
+// summarizes them as percentiles, which show stutter that
+// an average frame rate hides.
+//
+// Has no knowledge of Direct3D, so it can be exercised on
+// its own.
+// --------------------------------------------------------
+class FrameStats
+{
+public:
+	FrameStats(unsigned int capacity = FRAME_STATS_HISTORY);
+
+	void AddFrame(const FrameTiming& frame);
+	void Clear();
+
+	// Recorded frames, oldest first
+	unsigned int GetFrameCount() { return count; }
+	const FrameTiming& GetFrame(unsigned int index) { return frames[(next + frames.size() - count + index) % frames.size()]; }
+	unsigned long long GetFrameNumber(unsigned int index) { return totalFrames - count + index; }
+
+	FrameStatsSummary Summarize();
+	void GetHistogram(unsigned int part, double maxTime, unsigned int bucketCount, std::vector<float>* buckets);
+	void WriteCSV(std::ostream& out);
+
+	static const char* GetPartName(unsigned int part);
+
+private:
+	std::vector<FrameTiming> frames;
+	unsigned int next;
+	unsigned int count;
+	unsigned long long totalFrames;		// Ever recorded, for numbering frames
+};
@@ -1,11 +1,19 @@
 
 #include <stdlib.h>     // For seeding random and rand()
 #include <time.h>       // For grabbing time (to seed random)
+#include <chrono>       // For timing the light upload
+#include <algorithm>    // For std::max
+#include <math.h>       // For sqrtf()
+#include <string.h>     // For memcpy()
+#include <fstream>      // For saving frames and traces
 
 #include "Game.h"
 #include "Vertex.h"
 #include "Input.h"
 #include "Helpers.h"
+#include "FileSystem.h"
+#include "Profiler.h"
+#include "InspectorUI.h"
 
 #include "WICTextureLoader.h"
 #include "ImGui/imgui.h"
@@ -24,9 +32,38 @@ using namespace DirectX;
 #define RandomRange(min, max) (float)rand() / RAND_MAX * (max - min) + min
 
 // Helper macros for making texture and shader loading code more succinct
-#define LoadTexture(file, srv) CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(file).c_str(), 0, srv.GetAddressOf())
+// (textures are queued on the asset loading graph, and only finish
+// loading once it runs)
+#define LoadTexture(file, format, srv) textureJobs.push_back(QueueTextureLoad(graph, FixPath(file), format, &srv))
+#define LoadPackedTexture(roughnessFile, metalFile, srv) textureJobs.push_back(QueuePackedTextureLoad(graph, FixPath(roughnessFile), FixPath(metalFile), &srv))
 #define LoadShader(type, file) std::make_shared<type>(device.Get(), context.Get(), FixPath(file).c_str())
 
+// Bytes of loaded assets to keep around, once nothing uses them, for
+// sharing with later loads
+#define TEXTURE_REGISTRY_BUDGET	(256 * 1024 * 1024)
+#define MESH_REGISTRY_BUDGET	(32 * 1024 * 1024)
+
+// Starting memory budget for streamed textures, in megabytes
+#define TEXTURE_STREAMING_BUDGET_MB	16
+
+// Pack of every asset, next to the executable, which is used
+// instead of the loose files whenever it exists
+#define ASSET_PACK_FILE	L"Assets.pak"
+
+// Where the frame stats are saved, next to the executable
+#define FRAME_STATS_CSV_FILE	L"FrameStats.csv"
+
+// Where profiler traces are saved, and how many frames they cover
+#define PROFILER_TRACE_FILE		L"Trace.json"
+#define PROFILER_TRACE_FRAMES	120
+
+// Where software rendered frames are saved, next to the
+// executable, and how far (per channel) they can be from the
+// golden image before they count as different
+#define SOFTWARE_FRAME_FILE			L"SoftwareFrame.ppm"
+#define SOFTWARE_GOLDEN_FILE		L"SoftwareGolden.ppm"
+#define SOFTWARE_GOLDEN_TOLERANCE	2
+
 
 // --------------------------------------------------------
 // Constructor
@@ -46,7 +83,49 @@ Game::Game(HINSTANCE hInstance)
 		true),				// Show extra stats (fps) in title bar?
 	camera(0),
 	sky(0),
+	iblIntensity(1.0f),
+	softwareRenderTime(0),
+	useOcclusionCulling(false),
+	occlusionCullingTime(0),
 	lightCount(0),
+	activeLightCount(0),
+	lightPackTime(0),
+	lightUploadTime(0),
+	directionalLightCount(0),
+	clusterBuildTime(0),
+	useEntityLightLists(false),
+	entityLightListTime(0),
+	assetLoadThreadCount(0),
+	assetLoadTime(0),
+	parallelAssetLoadTime(0),
+	sequentialAssetLoadTime(0),
+	assetsLoaded(false),
+	reloadAssets(false),
+	reloadAssetsMultithreaded(false),
+	keepLoadedAssets(false),
+	useTextureStreaming(true),
+	useAssetPack(false),
+	compressAssetPack(true),
+	frameStatsSaved(false),
+	profiledFrameStart(0),
+	profiledFrameEnd(0),
+	freezeProfiler(false),
+	assetLoadTraceStart(0),
+	assetLoadTraceEnd(0),
+	profilerTraceSaved(0),
+	animateScene(false),
+	simulationStepCost(0),
+	simulationLightCount(0),
+	simulationAnimate(false),
+	simulationCost(0),
+	currentSnapshot(0),
+	simulateOnThread(false),
+	recordDrawsInParallel(false),
+	deferredDrawMinBatchSize(DEFERRED_DRAW_MIN_BATCH_SIZE),
+	captureSceneSubmission(false),
+	textureStreamingBudget(TEXTURE_STREAMING_BUDGET_MB),
+	textureStreamingTime(0),
+	meshRegistry(MESH_REGISTRY_BUDGET),
 	showUIDemoWindow(false),
 	showPointLights(false)
 {
@@ -68,6 +147,9 @@ Game::Game(HINSTANCE hInstance)
 // --------------------------------------------------------
 Game::~Game()
 {
+	// The simulation thread uses the scene, so it has to stop first
+	StopSimulationThread();
+
 	// Note: Since we're using smart pointers (ComPtr),
 	// we don't need to explicitly clean up those DirectX objects
 	// - If we weren't using smart pointers, we'd need
@@ -79,6 +161,23 @@ Game::~Game()
 	ImGui::DestroyContext();
 }
 
+// --------------------------------------------------------
+// Reads a compiled shader through the asset file system,
+// for SimpleShader.  The blob needs its own copy, as the
+// shader keeps it after loading.
+// --------------------------------------------------------
+static HRESULT ReadShaderFile(LPCWSTR shaderFile, ID3DBlob** blob)
+{
+	AssetFile file;
+	if (!OpenAssetFile(shaderFile, &file))
+		return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+
+	HRESULT hr = D3DCreateBlob(file.Size, blob);
+	if (SUCCEEDED(hr))
+		memcpy((*blob)->GetBufferPointer(), file.Data, file.Size);
+	return hr;
+}
+
 // --------------------------------------------------------
 // Called once per program, after DirectX and the window
 // are initialized but before the game loop.
@@ -92,8 +191,20 @@ void Game::Init()
 	ImGui_ImplDX11_Init(device.Get(), context.Get());
 	ImGui::StyleColorsDark();
 
-	// Asset loading and entity creation
-	LoadAssetsAndCreateEntities();
+	// Shaders are read like every other asset, so they can come
+	// from the pack (which is used whenever there is one)
+	ISimpleShader::FileReader = ReadShaderFile;
+	useAssetPack = MountAssetPack(FixPath(ASSET_PACK_FILE));
+
+	// Asset loading and entity creation, which can't go on
+	// if the shaders aren't usable (the reason is reported)
+	ISimpleShader::ReportErrors = true;
+	assetsLoaded = LoadAssetsAndCreateEntities(true);
+	if (!assetsLoaded)
+	{
+		Quit();
+		return;
+	}
 	
 	// Tell the input assembler stage of the pipeline what kind of
 	// geometric primitives (points, lines or triangles) we want to draw.  
@@ -126,70 +237,70 @@ void Game::Init()
 }
 
 
+// --------------------------------------------------------
+// Finds every file that goes in the asset pack: the whole
+// Assets folder, plus compiled shaders and the caches made
+// next to the executable (so a packed build can skip
+// cooking and baking)
+// --------------------------------------------------------
+static void FindPackableFiles(std::vector<std::wstring>* files)
+{
+	FindAssetFiles(FixPath(L"..\\..\\Assets"), L"", files);
+	FindAssetFiles(GetExePath(), L".cso", files);
+	FindAssetFiles(GetExePath(), L".cooked.dds", files);
+	FindAssetFiles(GetExePath(), L".iblcache", files);
+}
+
+// --------------------------------------------------------
+// Gets just the name of an asset file, for the timeline
+// --------------------------------------------------------
+static std::string GetAssetName(const std::wstring& path)
+{
+	size_t start = path.find_last_of(L"\\/");
+	start = start == std::wstring::npos ? 0 : start + 1;
+	return WideToNarrow(path.substr(start));
+}
+
 // --------------------------------------------------------
 // Load all assets and create materials, entities, etc.
+//
+// Loading is described as a graph of jobs, so reading and
+// decoding files happens on worker threads while anything
+// using the context stays on this one.  Materials wait on
+// their textures, the sky waits on its faces, and so on.
+//
+// multithreaded - Spread the jobs across worker threads?
+// Returns false if the assets can't be drawn correctly
 // --------------------------------------------------------
-void Game::LoadAssetsAndCreateEntities()
+bool Game::LoadAssetsAndCreateEntities(bool multithreaded)
 {
-	// Load shaders using our succinct LoadShader() macro
-	std::shared_ptr<SimpleVertexShader> vertexShader	= LoadShader(SimpleVertexShader, L"VertexShader.cso");
-	std::shared_ptr<SimplePixelShader> pixelShader		= LoadShader(SimplePixelShader, L"PixelShader.cso");
-	std::shared_ptr<SimplePixelShader> pixelShaderPBR	= LoadShader(SimplePixelShader, L"PixelShaderPBR.cso");
-	std::shared_ptr<SimplePixelShader> solidColorPS		= LoadShader(SimplePixelShader, L"SolidColorPS.cso");
-	
-	std::shared_ptr<SimpleVertexShader> skyVS = LoadShader(SimpleVertexShader, L"SkyVS.cso");
-	std::shared_ptr<SimplePixelShader> skyPS  = LoadShader(SimplePixelShader, L"SkyPS.cso");
+	PROFILE_FUNCTION();
+	assetLoadTraceStart = Profiler::Now();
+
+	// Start from scratch, so assets can be reloaded.  Assets
+	// loaded last time are only shared if they're being kept.
+	entities.Clear();
+	entityMeshes.clear();
+	entityMaterials.clear();
+	queuedAssetLoads.clear();
+	softwareTextureSets.clear();
+	softwareMeshFiles.clear();
+	softwareScene.reset();
+	occluderMeshes.clear();
+	if (!textureCache || !keepLoadedAssets || useTextureStreaming != (textureStreamer != 0))
+	{
+		textureStreamer.reset();
+		if (useTextureStreaming)
+			textureStreamer = std::make_shared<TextureStreamer>(device, context, textureStreamingBudget * 1024 * 1024, 2);
 
-	// Make the meshes
-	std::shared_ptr<Mesh> sphereMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/sphere.obj").c_str(), device);
-	std::shared_ptr<Mesh> helixMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/helix.obj").c_str(), device);
-	std::shared_ptr<Mesh> cubeMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/cube.obj").c_str(), device);
-	std::shared_ptr<Mesh> coneMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/cone.obj").c_str(), device);
-	
-	// Declare the textures we'll need
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobbleA,  cobbleN,  cobbleR,  cobbleM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorA,  floorN,  floorR,  floorM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintA,  paintN,  paintR,  paintM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedA,  scratchedN,  scratchedR,  scratchedM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeA,  bronzeN,  bronzeR,  bronzeM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughA,  roughN,  roughR,  roughM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodA,  woodN,  woodR,  woodM;
-
-	// Load the textures using our succinct LoadTexture() macro
-	LoadTexture(L"../../Assets/Textures/cobblestone_albedo.png", cobbleA);
-	LoadTexture(L"../../Assets/Textures/cobblestone_normals.png", cobbleN);
-	LoadTexture(L"../../Assets/Textures/cobblestone_roughness.png", cobbleR);
-	LoadTexture(L"../../Assets/Textures/cobblestone_metal.png", cobbleM);
-
-	LoadTexture(L"../../Assets/Textures/floor_albedo.png", floorA);
-	LoadTexture(L"../../Assets/Textures/floor_normals.png", floorN);
-	LoadTexture(L"../../Assets/Textures/floor_roughness.png", floorR);
-	LoadTexture(L"../../Assets/Textures/floor_metal.png", floorM);
-	
-	LoadTexture(L"../../Assets/Textures/paint_albedo.png", paintA);
-	LoadTexture(L"../../Assets/Textures/paint_normals.png", paintN);
-	LoadTexture(L"../../Assets/Textures/paint_roughness.png", paintR);
-	LoadTexture(L"../../Assets/Textures/paint_metal.png", paintM);
-	
-	LoadTexture(L"../../Assets/Textures/scratched_albedo.png", scratchedA);
-	LoadTexture(L"../../Assets/Textures/scratched_normals.png", scratchedN);
-	LoadTexture(L"../../Assets/Textures/scratched_roughness.png", scratchedR);
-	LoadTexture(L"../../Assets/Textures/scratched_metal.png", scratchedM);
-	
-	LoadTexture(L"../../Assets/Textures/bronze_albedo.png", bronzeA);
-	LoadTexture(L"../../Assets/Textures/bronze_normals.png", bronzeN);
-	LoadTexture(L"../../Assets/Textures/bronze_roughness.png", bronzeR);
-	LoadTexture(L"../../Assets/Textures/bronze_metal.png", bronzeM);
-	
-	LoadTexture(L"../../Assets/Textures/rough_albedo.png", roughA);
-	LoadTexture(L"../../Assets/Textures/rough_normals.png", roughN);
-	LoadTexture(L"../../Assets/Textures/rough_roughness.png", roughR);
-	LoadTexture(L"../../Assets/Textures/rough_metal.png", roughM);
-	
-	LoadTexture(L"../../Assets/Textures/wood_albedo.png", woodA);
-	LoadTexture(L"../../Assets/Textures/wood_normals.png", woodN);
-	LoadTexture(L"../../Assets/Textures/wood_roughness.png", woodR);
-	LoadTexture(L"../../Assets/Textures/wood_metal.png", woodM);
+		textureCache = std::make_shared<TextureCache>(device, context, TEXTURE_REGISTRY_BUDGET);
+		textureCache->SetStreamer(textureStreamer);
+		meshRegistry.Clear();
+	}
+	textureCache->ResetStats();
+	ResetAssetFileStats();
+	JobGraph graph;
+	bool buffersShared = true;
 
 	// Describe and create our sampler state
 	D3D11_SAMPLER_DESC sampDesc = {};
@@ -199,218 +310,479 @@ void Game::LoadAssetsAndCreateEntities()
 	sampDesc.Filter = D3D11_FILTER_ANISOTROPIC;
 	sampDesc.MaxAnisotropy = 16;
 	sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
-	device->CreateSamplerState(&sampDesc, samplerOptions.GetAddressOf());
-
-
-	// Create the sky using 6 images
-	sky = std::make_shared<Sky>(
-		FixPath(L"..\\..\\Assets\\Skies\\Clouds Blue\\right.png").c_str(),
-		FixPath(L"..\\..\\Assets\\Skies\\Clouds Blue\\left.png").c_str(),
-		FixPath(L"..\\..\\Assets\\Skies\\Clouds Blue\\up.png").c_str(),
-		FixPath(L"..\\..\\Assets\\Skies\\Clouds Blue\\down.png").c_str(),
-		FixPath(L"..\\..\\Assets\\Skies\\Clouds Blue\\front.png").c_str(),
-		FixPath(L"..\\..\\Assets\\Skies\\Clouds Blue\\back.png").c_str(),
-		cubeMesh,
-		skyVS,
-		skyPS,
-		samplerOptions,
-		device,
-		context);
-
-	// Create non-PBR materials
-	std::shared_ptr<Material> cobbleMat2x = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
-	cobbleMat2x->AddSampler("BasicSampler", samplerOptions);
-	cobbleMat2x->AddTextureSRV("Albedo", cobbleA);
-	cobbleMat2x->AddTextureSRV("NormalMap", cobbleN);
-	cobbleMat2x->AddTextureSRV("RoughnessMap", cobbleR);
-
-	std::shared_ptr<Material> cobbleMat4x = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(4, 4));
-	cobbleMat4x->AddSampler("BasicSampler", samplerOptions);
-	cobbleMat4x->AddTextureSRV("Albedo", cobbleA);
-	cobbleMat4x->AddTextureSRV("NormalMap", cobbleN);
-	cobbleMat4x->AddTextureSRV("RoughnessMap", cobbleR);
-
-	std::shared_ptr<Material> floorMat = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
-	floorMat->AddSampler("BasicSampler", samplerOptions);
-	floorMat->AddTextureSRV("Albedo", floorA);
-	floorMat->AddTextureSRV("NormalMap", floorN);
-	floorMat->AddTextureSRV("RoughnessMap", floorR);
-
-	std::shared_ptr<Material> paintMat = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
-	paintMat->AddSampler("BasicSampler", samplerOptions);
-	paintMat->AddTextureSRV("Albedo", paintA);
-	paintMat->AddTextureSRV("NormalMap", paintN);
-	paintMat->AddTextureSRV("RoughnessMap", paintR);
-
-	std::shared_ptr<Material> scratchedMat = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
-	scratchedMat->AddSampler("BasicSampler", samplerOptions);
-	scratchedMat->AddTextureSRV("Albedo", scratchedA);
-	scratchedMat->AddTextureSRV("NormalMap", scratchedN);
-	scratchedMat->AddTextureSRV("RoughnessMap", scratchedR);
-
-	std::shared_ptr<Material> bronzeMat = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
-	bronzeMat->AddSampler("BasicSampler", samplerOptions);
-	bronzeMat->AddTextureSRV("Albedo", bronzeA);
-	bronzeMat->AddTextureSRV("NormalMap", bronzeN);
-	bronzeMat->AddTextureSRV("RoughnessMap", bronzeR);
-
-	std::shared_ptr<Material> roughMat = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
-	roughMat->AddSampler("BasicSampler", samplerOptions);
-	roughMat->AddTextureSRV("Albedo", roughA);
-	roughMat->AddTextureSRV("NormalMap", roughN);
-	roughMat->AddTextureSRV("RoughnessMap", roughR);
-
-	std::shared_ptr<Material> woodMat = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
-	woodMat->AddSampler("BasicSampler", samplerOptions);
-	woodMat->AddTextureSRV("Albedo", woodA);
-	woodMat->AddTextureSRV("NormalMap", woodN);
-	woodMat->AddTextureSRV("RoughnessMap", woodR);
-
-
-	// Create PBR materials
-	std::shared_ptr<Material> cobbleMat2xPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
-	cobbleMat2xPBR->AddSampler("BasicSampler", samplerOptions);
-	cobbleMat2xPBR->AddTextureSRV("Albedo", cobbleA);
-	cobbleMat2xPBR->AddTextureSRV("NormalMap", cobbleN);
-	cobbleMat2xPBR->AddTextureSRV("RoughnessMap", cobbleR);
-	cobbleMat2xPBR->AddTextureSRV("MetalMap", cobbleM);
-
-	std::shared_ptr<Material> cobbleMat4xPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(4, 4));
-	cobbleMat4xPBR->AddSampler("BasicSampler", samplerOptions);
-	cobbleMat4xPBR->AddTextureSRV("Albedo", cobbleA);
-	cobbleMat4xPBR->AddTextureSRV("NormalMap", cobbleN);
-	cobbleMat4xPBR->AddTextureSRV("RoughnessMap", cobbleR);
-	cobbleMat4xPBR->AddTextureSRV("MetalMap", cobbleM);
-
-	std::shared_ptr<Material> floorMatPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
-	floorMatPBR->AddSampler("BasicSampler", samplerOptions);
-	floorMatPBR->AddTextureSRV("Albedo", floorA);
-	floorMatPBR->AddTextureSRV("NormalMap", floorN);
-	floorMatPBR->AddTextureSRV("RoughnessMap", floorR);
-	floorMatPBR->AddTextureSRV("MetalMap", floorM);
-
-	std::shared_ptr<Material> paintMatPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
-	paintMatPBR->AddSampler("BasicSampler", samplerOptions);
-	paintMatPBR->AddTextureSRV("Albedo", paintA);
-	paintMatPBR->AddTextureSRV("NormalMap", paintN);
-	paintMatPBR->AddTextureSRV("RoughnessMap", paintR);
-	paintMatPBR->AddTextureSRV("MetalMap", paintM);
-
-	std::shared_ptr<Material> scratchedMatPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
-	scratchedMatPBR->AddSampler("BasicSampler", samplerOptions);
-	scratchedMatPBR->AddTextureSRV("Albedo", scratchedA);
-	scratchedMatPBR->AddTextureSRV("NormalMap", scratchedN);
-	scratchedMatPBR->AddTextureSRV("RoughnessMap", scratchedR);
-	scratchedMatPBR->AddTextureSRV("MetalMap", scratchedM);
-
-	std::shared_ptr<Material> bronzeMatPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
-	bronzeMatPBR->AddSampler("BasicSampler", samplerOptions);
-	bronzeMatPBR->AddTextureSRV("Albedo", bronzeA);
-	bronzeMatPBR->AddTextureSRV("NormalMap", bronzeN);
-	bronzeMatPBR->AddTextureSRV("RoughnessMap", bronzeR);
-	bronzeMatPBR->AddTextureSRV("MetalMap", bronzeM);
-
-	std::shared_ptr<Material> roughMatPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
-	roughMatPBR->AddSampler("BasicSampler", samplerOptions);
-	roughMatPBR->AddTextureSRV("Albedo", roughA);
-	roughMatPBR->AddTextureSRV("NormalMap", roughN);
-	roughMatPBR->AddTextureSRV("RoughnessMap", roughR);
-	roughMatPBR->AddTextureSRV("MetalMap", roughM);
-
-	std::shared_ptr<Material> woodMatPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
-	woodMatPBR->AddSampler("BasicSampler", samplerOptions);
-	woodMatPBR->AddTextureSRV("Albedo", woodA);
-	woodMatPBR->AddTextureSRV("NormalMap", woodN);
-	woodMatPBR->AddTextureSRV("RoughnessMap", woodR);
-	woodMatPBR->AddTextureSRV("MetalMap", woodM);
-
-
-
-	// === Create the PBR entities =====================================
-	std::shared_ptr<GameEntity> cobSpherePBR = std::make_shared<GameEntity>(sphereMesh, cobbleMat2xPBR);
-	cobSpherePBR->GetTransform()->SetPosition(-6, 2, 0);
-	cobSpherePBR->GetTransform()->SetScale(2, 2, 2);
-
-	std::shared_ptr<GameEntity> floorSpherePBR = std::make_shared<GameEntity>(sphereMesh, floorMatPBR);
-	floorSpherePBR->GetTransform()->SetPosition(-4, 2, 0);
-	floorSpherePBR->GetTransform()->SetScale(2, 2, 2);
-
-	std::shared_ptr<GameEntity> paintSpherePBR = std::make_shared<GameEntity>(sphereMesh, paintMatPBR);
-	paintSpherePBR->GetTransform()->SetPosition(-2, 2, 0);
-	paintSpherePBR->GetTransform()->SetScale(2, 2, 2);
-
-	std::shared_ptr<GameEntity> scratchSpherePBR = std::make_shared<GameEntity>(sphereMesh, scratchedMatPBR);
-	scratchSpherePBR->GetTransform()->SetPosition(0, 2, 0);
-	scratchSpherePBR->GetTransform()->SetScale(2, 2, 2);
-
-	std::shared_ptr<GameEntity> bronzeSpherePBR = std::make_shared<GameEntity>(sphereMesh, bronzeMatPBR);
-	bronzeSpherePBR->GetTransform()->SetPosition(2, 2, 0);
-	bronzeSpherePBR->GetTransform()->SetScale(2, 2, 2);
-
-	std::shared_ptr<GameEntity> roughSpherePBR = std::make_shared<GameEntity>(sphereMesh, roughMatPBR);
-	roughSpherePBR->GetTransform()->SetPosition(4, 2, 0);
-	roughSpherePBR->GetTransform()->SetScale(2, 2, 2);
-
-	std::shared_ptr<GameEntity> woodSpherePBR = std::make_shared<GameEntity>(sphereMesh, woodMatPBR);
-	woodSpherePBR->GetTransform()->SetPosition(6, 2, 0);
-	woodSpherePBR->GetTransform()->SetScale(2, 2, 2);
-
-	entities.push_back(cobSpherePBR);
-	entities.push_back(floorSpherePBR);
-	entities.push_back(paintSpherePBR);
-	entities.push_back(scratchSpherePBR);
-	entities.push_back(bronzeSpherePBR);
-	entities.push_back(roughSpherePBR);
-	entities.push_back(woodSpherePBR);
-
-	// Create the non-PBR entities ==============================
-	std::shared_ptr<GameEntity> cobSphere = std::make_shared<GameEntity>(sphereMesh, cobbleMat2x);
-	cobSphere->GetTransform()->SetPosition(-6, -2, 0);
-	cobSphere->GetTransform()->SetScale(2, 2, 2);
-
-	std::shared_ptr<GameEntity> floorSphere = std::make_shared<GameEntity>(sphereMesh, floorMat);
-	floorSphere->GetTransform()->SetPosition(-4, -2, 0);
-	floorSphere->GetTransform()->SetScale(2, 2, 2);
-
-	std::shared_ptr<GameEntity> paintSphere = std::make_shared<GameEntity>(sphereMesh, paintMat);
-	paintSphere->GetTransform()->SetPosition(-2, -2, 0);
-	paintSphere->GetTransform()->SetScale(2, 2, 2);
-
-	std::shared_ptr<GameEntity> scratchSphere = std::make_shared<GameEntity>(sphereMesh, scratchedMat);
-	scratchSphere->GetTransform()->SetPosition(0, -2, 0);
-	scratchSphere->GetTransform()->SetScale(2, 2, 2);
-
-	std::shared_ptr<GameEntity> bronzeSphere = std::make_shared<GameEntity>(sphereMesh, bronzeMat);
-	bronzeSphere->GetTransform()->SetPosition(2, -2, 0);
-	bronzeSphere->GetTransform()->SetScale(2, 2, 2);
-
-	std::shared_ptr<GameEntity> roughSphere = std::make_shared<GameEntity>(sphereMesh, roughMat);
-	roughSphere->GetTransform()->SetPosition(4, -2, 0);
-	roughSphere->GetTransform()->SetScale(2, 2, 2);
-
-	std::shared_ptr<GameEntity> woodSphere = std::make_shared<GameEntity>(sphereMesh, woodMat);
-	woodSphere->GetTransform()->SetPosition(6, -2, 0);
-	woodSphere->GetTransform()->SetScale(2, 2, 2);
-
-	entities.push_back(cobSphere);
-	entities.push_back(floorSphere);
-	entities.push_back(paintSphere);
-	entities.push_back(scratchSphere);
-	entities.push_back(bronzeSphere);
-	entities.push_back(roughSphere);
-	entities.push_back(woodSphere);
+	device->CreateSamplerState(&sampDesc, samplerOptions.ReleaseAndGetAddressOf());
+
+	// Clamped (and not anisotropic) for the IBL look ups
+	sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	sampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	device->CreateSamplerState(&sampDesc, clampSampler.ReleaseAndGetAddressOf());
+
+	// Lights live in a structured buffer that grows as necessary
+	lightBuffer = std::make_shared<StructuredBuffer>(device, context, (unsigned int)sizeof(Light), 1024);
+	clusterGridBuffer = std::make_shared<StructuredBuffer>(device, context, (unsigned int)sizeof(ClusterRange), CLUSTER_COUNT);
+	clusterIndexBuffer = std::make_shared<StructuredBuffer>(device, context, (unsigned int)sizeof(unsigned int), 64 * 1024);
+
+	// Shaders (and everything shared between them) are made on this thread
+	std::shared_ptr<SimpleVertexShader> vertexShader;
+	std::shared_ptr<SimplePixelShader> pixelShader;
+	std::shared_ptr<SimplePixelShader> pixelShaderPBR;
+	std::shared_ptr<SimplePixelShader> solidColorPS;
+	std::shared_ptr<SimpleVertexShader> skyVS;
+	std::shared_ptr<SimplePixelShader> skyPS;
+	JobGraph::Job shaderJob = graph.Add("Shaders", JOB_GRAPH_MAIN_THREAD, [&]()
+	{
+		// Load shaders using our succinct LoadShader() macro
+		vertexShader	= LoadShader(SimpleVertexShader, L"VertexShader.cso");
+		pixelShader		= LoadShader(SimplePixelShader, L"PixelShader.cso");
+		pixelShaderPBR	= LoadShader(SimplePixelShader, L"PixelShaderPBR.cso");
+		solidColorPS	= LoadShader(SimplePixelShader, L"SolidColorPS.cso");
+
+		skyVS = LoadShader(SimpleVertexShader, L"SkyVS.cso");
+		skyPS = LoadShader(SimplePixelShader, L"SkyPS.cso");
+
+		// Per-draw constant data is suballocated from one large ring buffer,
+		// as long as the device supports binding ranges of it (D3D 11.1).
+		// Otherwise the shaders keep using their own constant buffers.
+		constantBufferRing = std::make_shared<ConstantBufferRing>(device, context, 4 * 1024 * 1024);
+		std::shared_ptr<ISimpleShader> shaders[] = { vertexShader, pixelShader, pixelShaderPBR, solidColorPS, skyVS, skyPS };
+		for (auto& s : shaders)
+			s->SetConstantBufferRing(constantBufferRing);
+
+		// All shaders share a single filter, which skips any bind
+		// calls for objects that are already bound to that slot
+		bindingFilter = std::make_shared<BindingFilter>();
+		for (auto& s : shaders)
+			s->SetBindingFilter(bindingFilter);
+
+		// Every bind and draw goes through one render device, which
+		// can be swapped for a null one to capture a frame
+		renderDevice = std::make_shared<D3D11RenderDevice>(device, context);
+		SetShaderRenderDevice(renderDevice);
+
+		// Entities can be recorded on deferred contexts, one per job
+		// system thread, which relies on the ring for per-draw data
+		deferredDraws = std::make_shared<DeferredDrawRecorder>(device, context, constantBufferRing, JobSystem::GetInstance().GetThreadCount());
+
+		// Share the per-frame buffers between all shaders that use them.
+		// Only the shared buffers are ever filled in, so any shader that
+		// can't share (reported by SimpleShader) fails the whole load.
+		vsPerFrame = vertexShader->CreateSharedConstantBuffer("perFrame");
+		buffersShared &= vertexShader->SetSharedConstantBuffer(vsPerFrame);
+		buffersShared &= skyVS->SetSharedConstantBuffer(vsPerFrame);
+
+		psPerFrame = pixelShaderPBR->CreateSharedConstantBuffer("perFrame");
+		buffersShared &= pixelShaderPBR->SetSharedConstantBuffer(psPerFrame);
+		buffersShared &= pixelShader->SetSharedConstantBuffer(psPerFrame);
+
+		psPerSky = pixelShaderPBR->CreateSharedConstantBuffer("perSky");
+		buffersShared &= pixelShaderPBR->SetSharedConstantBuffer(psPerSky);
+	});
+
+	// Make the meshes
+	std::shared_ptr<Mesh> sphereMesh, helixMesh, cubeMesh, coneMesh;
+	JobGraph::Job sphereJob = QueueMeshLoad(graph, FixPath(L"../../Assets/Models/sphere.obj"), &sphereMesh);
+	QueueMeshLoad(graph, FixPath(L"../../Assets/Models/helix.obj"), &helixMesh);
+	JobGraph::Job cubeJob = QueueMeshLoad(graph, FixPath(L"../../Assets/Models/cube.obj"), &cubeMesh);
+	QueueMeshLoad(graph, FixPath(L"../../Assets/Models/cone.obj"), &coneMesh);
+	
+	// Declare the textures we'll need
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobbleA,  cobbleN,  cobbleRM;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorA,  floorN,  floorRM;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintA,  paintN,  paintRM;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedA,  scratchedN,  scratchedRM;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeA,  bronzeN,  bronzeRM;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughA,  roughN,  roughRM;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodA,  woodN,  woodRM;
+
+	// Load the textures using our succinct LoadTexture() macro, which
+	// queues them to be cooked to block compressed formats suited to
+	// each usage.
+	// Roughness and metalness are packed together (roughness in red,
+	// so shaders that only need roughness can use the same texture).
+	std::vector<JobGraph::Job> textureJobs;
+	LoadTexture(L"../../Assets/Textures/cobblestone_albedo.png", TEXTURE_COOK_BC7, cobbleA);
+	LoadTexture(L"../../Assets/Textures/cobblestone_normals.png", TEXTURE_COOK_BC5, cobbleN);
+	LoadPackedTexture(L"../../Assets/Textures/cobblestone_roughness.png", L"../../Assets/Textures/cobblestone_metal.png", cobbleRM);
+
+	LoadTexture(L"../../Assets/Textures/floor_albedo.png", TEXTURE_COOK_BC7, floorA);
+	LoadTexture(L"../../Assets/Textures/floor_normals.png", TEXTURE_COOK_BC5, floorN);
+	LoadPackedTexture(L"../../Assets/Textures/floor_roughness.png", L"../../Assets/Textures/floor_metal.png", floorRM);
+	
+	LoadTexture(L"../../Assets/Textures/paint_albedo.png", TEXTURE_COOK_BC7, paintA);
+	LoadTexture(L"../../Assets/Textures/paint_normals.png", TEXTURE_COOK_BC5, paintN);
+	LoadPackedTexture(L"../../Assets/Textures/paint_roughness.png", L"../../Assets/Textures/paint_metal.png", paintRM);
+	
+	LoadTexture(L"../../Assets/Textures/scratched_albedo.png", TEXTURE_COOK_BC7, scratchedA);
+	LoadTexture(L"../../Assets/Textures/scratched_normals.png", TEXTURE_COOK_BC5, scratchedN);
+	LoadPackedTexture(L"../../Assets/Textures/scratched_roughness.png", L"../../Assets/Textures/scratched_metal.png", scratchedRM);
+	
+	LoadTexture(L"../../Assets/Textures/bronze_albedo.png", TEXTURE_COOK_BC7, bronzeA);
+	LoadTexture(L"../../Assets/Textures/bronze_normals.png", TEXTURE_COOK_BC5, bronzeN);
+	LoadPackedTexture(L"../../Assets/Textures/bronze_roughness.png", L"../../Assets/Textures/bronze_metal.png", bronzeRM);
+	
+	LoadTexture(L"../../Assets/Textures/rough_albedo.png", TEXTURE_COOK_BC7, roughA);
+	LoadTexture(L"../../Assets/Textures/rough_normals.png", TEXTURE_COOK_BC5, roughN);
+	LoadPackedTexture(L"../../Assets/Textures/rough_roughness.png", L"../../Assets/Textures/rough_metal.png", roughRM);
+	
+	LoadTexture(L"../../Assets/Textures/wood_albedo.png", TEXTURE_COOK_BC7, woodA);
+	LoadTexture(L"../../Assets/Textures/wood_normals.png", TEXTURE_COOK_BC5, woodN);
+	LoadPackedTexture(L"../../Assets/Textures/wood_roughness.png", L"../../Assets/Textures/wood_metal.png", woodRM);
+
+	// Decode the sky's 6 images on any thread, then create the
+	// sky (and its image based lighting) on this one
+	const wchar_t* skyFaceFiles[6] = { L"right.png", L"left.png", L"up.png", L"down.png", L"front.png", L"back.png" };
+	TextureImage skyFaces[6];
+	std::vector<JobGraph::Job> skyJobs = { shaderJob, cubeJob };
+	for (int i = 0; i < 6; i++)
+	{
+		std::wstring file = FixPath(std::wstring(L"..\\..\\Assets\\Skies\\Clouds Blue\\") + skyFaceFiles[i]);
+		TextureImage* face = &skyFaces[i];
+		skyJobs.push_back(graph.Add(GetAssetName(file), JOB_GRAPH_ANY_THREAD, [=]() { DecodeImageFile(file, face); }));
+	}
+
+	graph.Add("Sky", JOB_GRAPH_MAIN_THREAD, [&]()
+	{
+		sky = std::make_shared<Sky>(
+			skyFaces,
+			cubeMesh,
+			skyVS,
+			skyPS,
+			samplerOptions,
+			device,
+			context);
+	}, skyJobs);
+
+	// Materials and entities are quick to make, so they're
+	// simply made here once everything they use is loaded
+	std::vector<JobGraph::Job> materialJobs = textureJobs;
+	materialJobs.push_back(shaderJob);
+	materialJobs.push_back(sphereJob);
+	graph.Add("Materials and entities", JOB_GRAPH_MAIN_THREAD, [&]()
+	{
+		// Create non-PBR materials
+		std::shared_ptr<Material> cobbleMat2x = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+		cobbleMat2x->AddSampler("BasicSampler", samplerOptions);
+		cobbleMat2x->AddTextureSRV("Albedo", cobbleA);
+		cobbleMat2x->AddTextureSRV("NormalMap", cobbleN);
+		cobbleMat2x->AddTextureSRV("RoughnessMap", cobbleRM);
+
+		std::shared_ptr<Material> cobbleMat4x = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(4, 4));
+		cobbleMat4x->AddSampler("BasicSampler", samplerOptions);
+		cobbleMat4x->AddTextureSRV("Albedo", cobbleA);
+		cobbleMat4x->AddTextureSRV("NormalMap", cobbleN);
+		cobbleMat4x->AddTextureSRV("RoughnessMap", cobbleRM);
+
+		std::shared_ptr<Material> floorMat = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+		floorMat->AddSampler("BasicSampler", samplerOptions);
+		floorMat->AddTextureSRV("Albedo", floorA);
+		floorMat->AddTextureSRV("NormalMap", floorN);
+		floorMat->AddTextureSRV("RoughnessMap", floorRM);
+
+		std::shared_ptr<Material> paintMat = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+		paintMat->AddSampler("BasicSampler", samplerOptions);
+		paintMat->AddTextureSRV("Albedo", paintA);
+		paintMat->AddTextureSRV("NormalMap", paintN);
+		paintMat->AddTextureSRV("RoughnessMap", paintRM);
+
+		std::shared_ptr<Material> scratchedMat = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+		scratchedMat->AddSampler("BasicSampler", samplerOptions);
+		scratchedMat->AddTextureSRV("Albedo", scratchedA);
+		scratchedMat->AddTextureSRV("NormalMap", scratchedN);
+		scratchedMat->AddTextureSRV("RoughnessMap", scratchedRM);
+
+		std::shared_ptr<Material> bronzeMat = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+		bronzeMat->AddSampler("BasicSampler", samplerOptions);
+		bronzeMat->AddTextureSRV("Albedo", bronzeA);
+		bronzeMat->AddTextureSRV("NormalMap", bronzeN);
+		bronzeMat->AddTextureSRV("RoughnessMap", bronzeRM);
+
+		std::shared_ptr<Material> roughMat = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+		roughMat->AddSampler("BasicSampler", samplerOptions);
+		roughMat->AddTextureSRV("Albedo", roughA);
+		roughMat->AddTextureSRV("NormalMap", roughN);
+		roughMat->AddTextureSRV("RoughnessMap", roughRM);
+
+		std::shared_ptr<Material> woodMat = std::make_shared<Material>(pixelShader, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+		woodMat->AddSampler("BasicSampler", samplerOptions);
+		woodMat->AddTextureSRV("Albedo", woodA);
+		woodMat->AddTextureSRV("NormalMap", woodN);
+		woodMat->AddTextureSRV("RoughnessMap", woodRM);
+
+
+		// Create PBR materials
+		std::shared_ptr<Material> cobbleMat2xPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+		cobbleMat2xPBR->AddSampler("BasicSampler", samplerOptions);
+		cobbleMat2xPBR->AddTextureSRV("Albedo", cobbleA);
+		cobbleMat2xPBR->AddTextureSRV("NormalMap", cobbleN);
+		cobbleMat2xPBR->AddTextureSRV("RoughnessMetalMap", cobbleRM);
+
+		std::shared_ptr<Material> cobbleMat4xPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(4, 4));
+		cobbleMat4xPBR->AddSampler("BasicSampler", samplerOptions);
+		cobbleMat4xPBR->AddTextureSRV("Albedo", cobbleA);
+		cobbleMat4xPBR->AddTextureSRV("NormalMap", cobbleN);
+		cobbleMat4xPBR->AddTextureSRV("RoughnessMetalMap", cobbleRM);
+
+		std::shared_ptr<Material> floorMatPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+		floorMatPBR->AddSampler("BasicSampler", samplerOptions);
+		floorMatPBR->AddTextureSRV("Albedo", floorA);
+		floorMatPBR->AddTextureSRV("NormalMap", floorN);
+		floorMatPBR->AddTextureSRV("RoughnessMetalMap", floorRM);
+
+		std::shared_ptr<Material> paintMatPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+		paintMatPBR->AddSampler("BasicSampler", samplerOptions);
+		paintMatPBR->AddTextureSRV("Albedo", paintA);
+		paintMatPBR->AddTextureSRV("NormalMap", paintN);
+		paintMatPBR->AddTextureSRV("RoughnessMetalMap", paintRM);
+
+		std::shared_ptr<Material> scratchedMatPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+		scratchedMatPBR->AddSampler("BasicSampler", samplerOptions);
+		scratchedMatPBR->AddTextureSRV("Albedo", scratchedA);
+		scratchedMatPBR->AddTextureSRV("NormalMap", scratchedN);
+		scratchedMatPBR->AddTextureSRV("RoughnessMetalMap", scratchedRM);
+
+		std::shared_ptr<Material> bronzeMatPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+		bronzeMatPBR->AddSampler("BasicSampler", samplerOptions);
+		bronzeMatPBR->AddTextureSRV("Albedo", bronzeA);
+		bronzeMatPBR->AddTextureSRV("NormalMap", bronzeN);
+		bronzeMatPBR->AddTextureSRV("RoughnessMetalMap", bronzeRM);
+
+		std::shared_ptr<Material> roughMatPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+		roughMatPBR->AddSampler("BasicSampler", samplerOptions);
+		roughMatPBR->AddTextureSRV("Albedo", roughA);
+		roughMatPBR->AddTextureSRV("NormalMap", roughN);
+		roughMatPBR->AddTextureSRV("RoughnessMetalMap", roughRM);
+
+		std::shared_ptr<Material> woodMatPBR = std::make_shared<Material>(pixelShaderPBR, vertexShader, XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+		woodMatPBR->AddSampler("BasicSampler", samplerOptions);
+		woodMatPBR->AddTextureSRV("Albedo", woodA);
+		woodMatPBR->AddTextureSRV("NormalMap", woodN);
+		woodMatPBR->AddTextureSRV("RoughnessMetalMap", woodRM);
+
+		// The software rasterizer loads its own copies of what the
+		// PBR entities use, by name
+		softwareTextureSets[cobbleMat2xPBR.get()] = L"cobblestone";
+		softwareTextureSets[cobbleMat4xPBR.get()] = L"cobblestone";
+		softwareTextureSets[floorMatPBR.get()] = L"floor";
+		softwareTextureSets[paintMatPBR.get()] = L"paint";
+		softwareTextureSets[scratchedMatPBR.get()] = L"scratched";
+		softwareTextureSets[bronzeMatPBR.get()] = L"bronze";
+		softwareTextureSets[roughMatPBR.get()] = L"rough";
+		softwareTextureSets[woodMatPBR.get()] = L"wood";
+		softwareMeshFiles[sphereMesh.get()] = L"../../Assets/Models/sphere.obj";
+
+		// Spheres occlude with the box inside them, shrunk a little
+		// as the mesh's faces are inside its bounding sphere
+		XMFLOAT4 sphereBounds = sphereMesh->GetBoundingSphere();
+		float inside = sphereBounds.w * 0.9f / sqrtf(3.0f);
+		MakeOcclusionBox(
+			XMFLOAT3(sphereBounds.x - inside, sphereBounds.y - inside, sphereBounds.z - inside),
+			XMFLOAT3(sphereBounds.x + inside, sphereBounds.y + inside, sphereBounds.z + inside),
+			&occluderMeshes[sphereMesh.get()]);
+
+
+		// === Create the PBR entities =====================================
+		std::shared_ptr<Material> pbrMaterials[] = { cobbleMat2xPBR, floorMatPBR, paintMatPBR, scratchedMatPBR, bronzeMatPBR, roughMatPBR, woodMatPBR };
+		for (int i = 0; i < 7; i++)
+		{
+			Transform& transform = entities.Get<Transform>(CreateEntity(sphereMesh, pbrMaterials[i]));
+			transform.SetPosition(-6.0f + i * 2, 2, 0);
+			transform.SetScale(2, 2, 2);
+		}
+
+		// Create the non-PBR entities ==============================
+		std::shared_ptr<Material> basicMaterials[] = { cobbleMat2x, floorMat, paintMat, scratchedMat, bronzeMat, roughMat, woodMat };
+		for (int i = 0; i < 7; i++)
+		{
+			Transform& transform = entities.Get<Transform>(CreateEntity(sphereMesh, basicMaterials[i]));
+			transform.SetPosition(-6.0f + i * 2, -2, 0);
+			transform.SetScale(2, 2, 2);
+		}
+
+		// Nothing has moved yet, so there's nothing to interpolate from
+		SavePreviousEntityStates();
+
+		// Streamed textures are swapped into the materials
+		// that use them as their mips change
+		if (textureStreamer)
+		{
+			const char* textureNames[] = { "Albedo", "NormalMap", "RoughnessMap", "RoughnessMetalMap" };
+			for (auto& material : entityMaterials)
+			{
+				for (auto name : textureNames)
+					textureStreamer->Track(material, name);
+			}
+		}
+
+
+		// Save assets needed for drawing point lights
+		lightMesh = sphereMesh;
+		lightVS = vertexShader;
+		lightPS = solidColorPS;
+	}, materialJobs);
+
+	// Workers need COM for decoding images (always on new
+	// threads, so initializing can't fail)
+	graph.SetWorkerCallbacks(
+		[]() { CoInitializeEx(0, COINIT_MULTITHREADED); },
+		[]() { CoUninitialize(); });
+
+	graph.Run(multithreaded);
+
+	// Anything the last load used that this one didn't is
+	// now unreferenced, so it may be over the budget
+	textureCache->TrimRegistry();
+	meshRegistry.Trim();
+
+	assetLoadTimeline = graph.GetTimeline();
+	assetLoadThreadCount = graph.GetThreadCount();
+	assetLoadTime = graph.GetTotalTime();
+	assetLoadTraceEnd = Profiler::Now();
+	if (multithreaded)
+		parallelAssetLoadTime = assetLoadTime;
+	else
+		sequentialAssetLoadTime = assetLoadTime;
+
+	return buffersShared;
+}
+
+// --------------------------------------------------------
+// Makes an entity with a transform at the origin, bounds
+// and the given mesh and material, which are kept alive as
+// long as the entities are
+// --------------------------------------------------------
+Entity Game::CreateEntity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material)
+{
+	if (std::find(entityMeshes.begin(), entityMeshes.end(), mesh) == entityMeshes.end())
+		entityMeshes.push_back(mesh);
+	if (std::find(entityMaterials.begin(), entityMaterials.end(), material) == entityMaterials.end())
+		entityMaterials.push_back(material);
+
+	Entity entity = entities.Create();
+	entities.Add(entity, Transform());
+	entities.Add(entity, MeshRef{ mesh.get() });
+	entities.Add(entity, MaterialRef{ material.get() });
+	entities.Add(entity, Bounds{ mesh->GetBoundingSphere() });
+	return entity;
+}
+
+// --------------------------------------------------------
+// Queues a mesh to be read from an OBJ file on any thread,
+// then have its buffers made on this one.  Meshes already
+// loaded (or queued) are shared instead, as are meshes
+// with identical geometry from other files.
+//
+// Returns the job that finishes the mesh
+// --------------------------------------------------------
+JobGraph::Job Game::QueueMeshLoad(JobGraph& graph, const std::wstring& file, std::shared_ptr<Mesh>* mesh)
+{
+	std::wstring key = NormalizeAssetPath(file);
+	std::string name = GetAssetName(file);
+	if (meshRegistry.Find(key, mesh))
+		return graph.Add(name + " (shared)", JOB_GRAPH_MAIN_THREAD, []() {});
+
+	auto queued = queuedAssetLoads.find(key);
+	if (queued != queuedAssetLoads.end())
+		return graph.Add(name + " (shared)", JOB_GRAPH_MAIN_THREAD, [=]() { meshRegistry.Find(key, mesh); }, { queued->second });
+
+	struct MeshData
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<unsigned int> Indices;
+		unsigned long long Hash = 0;
+	};
+	std::shared_ptr<MeshData> data = std::make_shared<MeshData>();
+
+	JobGraph::Job read = graph.Add(name, JOB_GRAPH_ANY_THREAD, [=]()
+	{
+		if (!Mesh::LoadOBJ(file, &data->Vertices, &data->Indices) || data->Vertices.empty() || data->Indices.empty())
+			return;
+
+		data->Hash = HashAssetData(&data->Vertices[0], data->Vertices.size() * sizeof(Vertex));
+		data->Hash = HashAssetData(&data->Indices[0], data->Indices.size() * sizeof(unsigned int), data->Hash);
+	});
+
+	JobGraph::Job create = graph.Add(name + " (buffers)", JOB_GRAPH_MAIN_THREAD, [=]()
+	{
+		size_t bytes = data->Vertices.size() * sizeof(Vertex) + data->Indices.size() * sizeof(unsigned int);
+		if (data->Hash == 0 || meshRegistry.FindByHash(data->Hash, bytes, key, mesh))
+			return;
+
+		*mesh = std::make_shared<Mesh>(&data->Vertices[0], data->Vertices.size(), &data->Indices[0], data->Indices.size(), device);
+		meshRegistry.Add(key, data->Hash, *mesh, bytes);
+	}, { read });
+
+	queuedAssetLoads[key] = create;
+	return create;
+}
+
+// --------------------------------------------------------
+// Queues a texture to be read (or cooked) on any thread,
+// then created on this one
+//
+// Returns the job that finishes the texture
+// --------------------------------------------------------
+JobGraph::Job Game::QueueTextureLoad(JobGraph& graph, const std::wstring& file, unsigned int format, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* srv)
+{
+	std::wstring key = TextureCache::GetKey(file, format);
+	std::string name = GetAssetName(file);
+	if (textureCache->Find(key, srv))
+		return graph.Add(name + " (shared)", JOB_GRAPH_MAIN_THREAD, []() {});
+
+	auto queued = queuedAssetLoads.find(key);
+	if (queued != queuedAssetLoads.end())
+		return graph.Add(name + " (shared)", JOB_GRAPH_MAIN_THREAD, [=]() { textureCache->Find(key, srv); }, { queued->second });
 
+	std::shared_ptr<PreparedTexture> prepared = std::make_shared<PreparedTexture>();
+	JobGraph::Job prepare = graph.Add(name, JOB_GRAPH_ANY_THREAD, [=]()
+	{
+		TextureCache::Prepare(file, format, prepared.get());
+	});
+
+	JobGraph::Job create = graph.Add(name + " (texture)", JOB_GRAPH_MAIN_THREAD, [=]()
+	{
+		*srv = textureCache->Create(*prepared);
+	}, { prepare });
 
-	// Save assets needed for drawing point lights
-	lightMesh = sphereMesh;
-	lightVS = vertexShader;
-	lightPS = solidColorPS;
+	queuedAssetLoads[key] = create;
+	return create;
+}
+
+// --------------------------------------------------------
+// QueueTextureLoad() for a packed roughness and metalness
+// texture
+// --------------------------------------------------------
+JobGraph::Job Game::QueuePackedTextureLoad(JobGraph& graph, const std::wstring& roughnessFile, const std::wstring& metalFile, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* srv)
+{
+	std::wstring key = TextureCache::GetPackedKey(roughnessFile, metalFile);
+	std::string name = GetAssetName(roughnessFile) + " + " + GetAssetName(metalFile);
+	if (textureCache->Find(key, srv))
+		return graph.Add(name + " (shared)", JOB_GRAPH_MAIN_THREAD, []() {});
+
+	auto queued = queuedAssetLoads.find(key);
+	if (queued != queuedAssetLoads.end())
+		return graph.Add(name + " (shared)", JOB_GRAPH_MAIN_THREAD, [=]() { textureCache->Find(key, srv); }, { queued->second });
+
+	std::shared_ptr<PreparedTexture> prepared = std::make_shared<PreparedTexture>();
+	JobGraph::Job prepare = graph.Add(name, JOB_GRAPH_ANY_THREAD, [=]()
+	{
+		TextureCache::PreparePacked(roughnessFile, metalFile, prepared.get());
+	});
+
+	JobGraph::Job create = graph.Add(name + " (texture)", JOB_GRAPH_MAIN_THREAD, [=]()
+	{
+		*srv = textureCache->Create(*prepared);
+	}, { prepare });
+
+	queuedAssetLoads[key] = create;
+	return create;
 }
 
 
 // --------------------------------------------------------
 // Generates the lights in the scene: 3 directional lights
-// and many random point lights.
+// and enough random point lights for the light count.
 // --------------------------------------------------------
 void Game::GenerateLights()
 {
@@ -442,7 +814,29 @@ void Game::GenerateLights()
 	lights.push_back(dir3);
 
 	// Create the rest of the lights
-	while (lights.size() < MAX_LIGHTS)
+	AddLights((unsigned int)lightCount);
+}
+
+// --------------------------------------------------------
+// Makes sure there are at least the given number of lights,
+// adding random point lights to the end as needed.  Lights
+// are only made once something asks for them, as MAX_LIGHTS
+// of them would be far more than the scene usually uses.
+//
+// count - How many lights are needed
+// --------------------------------------------------------
+void Game::AddLights(unsigned int count)
+{
+	if (lights.size() >= count)
+		return;
+
+	// The simulation thread has its own copy of the lights,
+	// so it restarts to pick up the new ones
+	bool restart = simulationThread.joinable();
+	StopSimulationThread();
+
+	lights.reserve(count);
+	while (lights.size() < count)
 	{
 		Light point = {};
 		point.Type = LIGHT_TYPE_POINT;
@@ -451,126 +845,982 @@ void Game::GenerateLights()
 		point.Range = RandomRange(5.0f, 10.0f);
 		point.Intensity = RandomRange(0.1f, 3.0f);
 
-		// Add to the list
-		lights.push_back(point);
+		// Add to the list
+		lights.push_back(point);
+	}
+
+	if (restart)
+		StartSimulationThread();
+}
+
+
+// --------------------------------------------------------
+// Packs the active lights together and copies them to the
+// GPU, timing both steps
+// --------------------------------------------------------
+void Game::UploadLights()
+{
+	PROFILE_FUNCTION();
+	auto packStart = std::chrono::high_resolution_clock::now();
+	activeLightCount = PackActiveLights(lights, (unsigned int)lightCount, packedLights, &directionalLightCount);
+
+	auto uploadStart = std::chrono::high_resolution_clock::now();
+	lightBuffer->Upload(packedLights.empty() ? 0 : &packedLights[0], activeLightCount);
+
+	auto uploadEnd = std::chrono::high_resolution_clock::now();
+	lightPackTime = std::chrono::duration<double, std::milli>(uploadStart - packStart).count();
+	lightUploadTime = std::chrono::duration<double, std::milli>(uploadEnd - uploadStart).count();
+}
+
+
+// --------------------------------------------------------
+// Times the CPU side of the light upload (packing and
+// mapping/copying) at increasing light counts, to show
+// how it scales.  The scene's own light count is restored
+// afterwards, and the next frame uploads it as usual.
+// --------------------------------------------------------
+void Game::RunLightUploadBenchmark()
+{
+	const int iterations = 32;
+	int originalCount = lightCount;
+	lightUploadTimings.clear();
+	AddLights(MAX_LIGHTS);
+
+	for (int count = 1024; count <= MAX_LIGHTS; count *= 4)
+	{
+		LightUploadTiming timing = {};
+		timing.LightCount = count;
+
+		lightCount = count;
+		for (int i = 0; i < iterations; i++)
+		{
+			UploadLights();
+			timing.PackTime += lightPackTime;
+			timing.UploadTime += lightUploadTime;
+		}
+
+		timing.PackTime /= iterations;
+		timing.UploadTime /= iterations;
+		lightUploadTimings.push_back(timing);
+	}
+
+	lightCount = originalCount;
+}
+
+
+// --------------------------------------------------------
+// Gathers the camera details needed for the cluster grid
+// --------------------------------------------------------
+ClusterFrustum Game::GetClusterFrustum()
+{
+	ClusterFrustum frustum = {};
+	frustum.View = camera->GetView();
+	frustum.FieldOfView = camera->GetFieldOfView();
+	frustum.AspectRatio = camera->GetAspectRatio();
+	frustum.NearClip = camera->GetNearClip();
+	frustum.FarClip = camera->GetFarClip();
+	frustum.Orthographic = camera->GetProjectionType() == CameraProjectionType::Orthographic;
+	frustum.OrthographicWidth = camera->GetOrthographicWidth();
+	return frustum;
+}
+
+
+// --------------------------------------------------------
+// Assigns this frame's packed lights to clusters and
+// uploads the resulting lists
+// --------------------------------------------------------
+void Game::BuildLightClusters()
+{
+	PROFILE_FUNCTION();
+	auto start = std::chrono::high_resolution_clock::now();
+	lightClusters.Build(GetClusterFrustum(), packedLights, directionalLightCount);
+	auto end = std::chrono::high_resolution_clock::now();
+	clusterBuildTime = std::chrono::duration<double, std::milli>(end - start).count();
+
+	const std::vector<ClusterRange>& ranges = lightClusters.GetClusterRanges();
+	const std::vector<unsigned int>& indices = lightClusters.GetLightIndices();
+	clusterGridBuffer->Upload(&ranges[0], (unsigned int)ranges.size());
+	clusterIndexBuffer->Upload(indices.empty() ? 0 : &indices[0], (unsigned int)indices.size());
+}
+
+
+// --------------------------------------------------------
+// Moves every entity's bounds to where it is now, once for
+// everything that needs them this frame
+// --------------------------------------------------------
+void Game::UpdateEntityBounds()
+{
+	PROFILE_FUNCTION();
+	entities.Each<Transform, MeshRef, Bounds>([](Entity, Transform& transform, MeshRef& mesh, Bounds& bounds)
+	{
+		bounds.Sphere = GetWorldBoundingSphere(transform, mesh.Asset);
+	});
+}
+
+// --------------------------------------------------------
+// Chooses the most important lights for each entity from
+// its current bounds, only redoing work for entities and
+// lights that changed since last frame
+// --------------------------------------------------------
+void Game::UpdateEntityLightLists()
+{
+	PROFILE_FUNCTION();
+	auto start = std::chrono::high_resolution_clock::now();
+
+	unsigned int index = 0;
+	entityLightLists.SetEntityCount(entities.GetPool<Transform>().GetSize());
+	entities.Each<Transform, Bounds>([&](Entity, Transform&, Bounds& bounds)
+	{
+		entityLightLists.SetEntityBounds(index++, bounds.Sphere);
+	});
+	entityLightLists.Update(packedLights, directionalLightCount);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	entityLightListTime = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// --------------------------------------------------------
+// Rasterizes the occluders of every entity with one, then
+// tests every entity's bounds against them, on the job
+// system's threads.  Entities are placed where they'll be
+// drawn, between their last two simulation steps.
+//
+// interpolation - How far between those steps
+// --------------------------------------------------------
+void Game::UpdateOcclusionCulling(float interpolation)
+{
+	PROFILE_FUNCTION();
+	auto start = std::chrono::high_resolution_clock::now();
+
+	unsigned int count = entities.GetPool<Transform>().GetSize();
+	unsigned int index = 0;
+	occluders.clear();
+	entityBounds.resize(count);
+	entityOcclusion.resize(count);
+	entities.Each<Transform, MeshRef>([&](Entity, Transform& current, MeshRef& mesh)
+	{
+		Transform* transform = &current;
+		Transform drawn;
+		if (interpolation < 1.0f)
+		{
+			transform->Interpolate(interpolation, &drawn);
+			transform = &drawn;
+		}
+		XMFLOAT4X4 world = transform->GetWorldMatrix();
+
+		auto occluderMesh = occluderMeshes.find(mesh.Asset);
+		if (occluderMesh != occluderMeshes.end())
+		{
+			OcclusionOccluder occluder = { &occluderMesh->second, world };
+			occluders.push_back(occluder);
+		}
+
+		// Box around the bounding sphere, as drawn
+		XMFLOAT4 sphere = GetWorldBoundingSphere(*transform, mesh.Asset);
+		entityBounds[index].Min = XMFLOAT3(sphere.x - sphere.w, sphere.y - sphere.w, sphere.z - sphere.w);
+		entityBounds[index].Max = XMFLOAT3(sphere.x + sphere.w, sphere.y + sphere.w, sphere.z + sphere.w);
+		index++;
+	});
+
+	XMFLOAT4X4 view = camera->GetView();
+	XMFLOAT4X4 projection = camera->GetProjection();
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+
+	JobSystem& jobs = JobSystem::GetInstance();
+	unsigned int height = (std::max)(OCCLUSION_BUFFER_WIDTH * windowHeight / (std::max)(windowWidth, 1u), 1u);
+	occlusionBuffer.Render(occluders.empty() ? 0 : &occluders[0], (unsigned int)occluders.size(), viewProjection, OCCLUSION_BUFFER_WIDTH, height, jobs);
+	if (count > 0)
+		occlusionBuffer.Test(&entityBounds[0], count, jobs, &entityOcclusion[0]);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	occlusionCullingTime = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+// --------------------------------------------------------
+// Renders the PBR entities (with the current lights, camera
+// and sky) on the CPU at the window's size, saves the frame
+// and compares it with the golden image, if there is one.
+// Meshes and textures are loaded the first time they're
+// needed, straight from the asset files.
+//
+// saveAsGolden - Replace the golden image with this frame?
+// --------------------------------------------------------
+void Game::RenderSoftwareFrame(bool saveAsGolden)
+{
+	PROFILE_FUNCTION();
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// The sky needs its full IBL, which the GPU version
+	// doesn't keep on the CPU
+	if (!softwareScene)
+	{
+		softwareScene = std::make_shared<SoftwareScene>();
+		softwareAssetIndices.clear();
+		if (sky->HasIBL())
+		{
+			softwareScene->Sky = sky->GetIBLSource();
+			BakeIBL(softwareScene->Sky, IBLBakeSettings(), &softwareScene->IBL);
+		}
+	}
+	SoftwareScene& scene = *softwareScene;
+
+	// Textures are cooked the same way the GPU's are, minus
+	// the compression
+	auto loadTexture = [&](const std::wstring& name, unsigned int format)
+	{
+		auto found = softwareAssetIndices.find(name);
+		if (found != softwareAssetIndices.end())
+			return found->second;
+
+		TextureImage image;
+		std::wstring path = FixPath(L"../../Assets/Textures/" + name);
+		bool loaded = false;
+		if (format == TEXTURE_COOK_BC5_LINEAR)
+		{
+			TextureImage roughness;
+			TextureImage metal;
+			loaded = DecodeImageFile(path + L"_roughness.png", &roughness) && DecodeImageFile(path + L"_metal.png", &metal);
+			const TextureImage* sources[4] = { &roughness, &metal, 0, 0 };
+			if (loaded)
+				PackTextureChannels(sources, &image);
+		}
+		else
+		{
+			loaded = DecodeImageFile(path + L".png", &image);
+		}
+
+		int index = -1;
+		if (loaded)
+		{
+			SoftwareTexture texture;
+			GenerateMipChain(image, format, &texture.Mips);
+			scene.Textures.push_back(texture);
+			index = (int)scene.Textures.size() - 1;
+		}
+		softwareAssetIndices[name] = index;
+		return index;
+	};
+
+	// Only entities drawn with the PBR shader, as that's
+	// the only one the rasterizer implements
+	scene.Materials.clear();
+	scene.Draws.clear();
+	entities.Each<Transform, MeshRef, MaterialRef>([&](Entity, Transform& transform, MeshRef& meshRef, MaterialRef& materialRef)
+	{
+		auto textureSet = softwareTextureSets.find(materialRef.Asset);
+		auto meshFile = softwareMeshFiles.find(meshRef.Asset);
+		if (textureSet == softwareTextureSets.end() || meshFile == softwareMeshFiles.end())
+			return;
+
+		auto meshIndex = softwareAssetIndices.find(meshFile->second);
+		if (meshIndex == softwareAssetIndices.end())
+		{
+			SoftwareMesh mesh;
+			int index = -1;
+			if (Mesh::LoadOBJ(FixPath(meshFile->second), &mesh.Vertices, &mesh.Indices) && !mesh.Vertices.empty())
+			{
+				// Sphere around the middle of the bounds
+				XMFLOAT3 minPos = mesh.Vertices[0].Position;
+				XMFLOAT3 maxPos = mesh.Vertices[0].Position;
+				for (auto& v : mesh.Vertices)
+				{
+					minPos = XMFLOAT3((std::min)(minPos.x, v.Position.x), (std::min)(minPos.y, v.Position.y), (std::min)(minPos.z, v.Position.z));
+					maxPos = XMFLOAT3((std::max)(maxPos.x, v.Position.x), (std::max)(maxPos.y, v.Position.y), (std::max)(maxPos.z, v.Position.z));
+				}
+				XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&minPos), XMLoadFloat3(&maxPos)), 0.5f);
+				float radius = 0.0f;
+				for (auto& v : mesh.Vertices)
+					radius = (std::max)(radius, XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&v.Position), center))));
+				XMStoreFloat4(&mesh.BoundingSphere, XMVectorSetW(center, radius));
+
+				scene.Meshes.push_back(mesh);
+				index = (int)scene.Meshes.size() - 1;
+			}
+			meshIndex = softwareAssetIndices.insert(std::make_pair(meshFile->second, index)).first;
+		}
+		if (meshIndex->second < 0)
+			return;
+
+		Material* mat = materialRef.Asset;
+		SoftwareMaterial material;
+		material.ColorTint = mat->GetColorTint();
+		material.UVScale = mat->GetUVScale();
+		material.UVOffset = mat->GetUVOffset();
+		material.Albedo = loadTexture(textureSet->second + L"_albedo", TEXTURE_COOK_BC7);
+		material.NormalMap = loadTexture(textureSet->second + L"_normals", TEXTURE_COOK_BC5);
+		material.RoughnessMetalMap = loadTexture(textureSet->second, TEXTURE_COOK_BC5_LINEAR);
+		scene.Materials.push_back(material);
+
+		SoftwareDraw draw;
+		draw.Mesh = (unsigned int)meshIndex->second;
+		draw.Material = (unsigned int)scene.Materials.size() - 1;
+		draw.World = transform.GetWorldMatrix();
+		draw.WorldInverseTranspose = transform.GetWorldInverseTransposeMatrix();
+		scene.Draws.push_back(draw);
+	});
+
+	PackActiveLights(lights, (unsigned int)lightCount, scene.Lights);
+	scene.View = camera->GetView();
+	scene.Projection = camera->GetProjection();
+	scene.CameraPosition = camera->GetTransform()->GetPosition();
+	scene.IBLIntensity = sky->HasIBL() ? iblIntensity : 0.0f;
+
+	TextureImage frame;
+	softwareRasterizer.Render(scene, windowWidth, windowHeight, JobSystem::GetInstance(), &frame);
+	softwareRenderTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// Save it, and check it against the golden image
+	std::vector<unsigned char> bytes;
+	SerializeSoftwareImage(frame, bytes);
+	std::ofstream out(FixPath(saveAsGolden ? SOFTWARE_GOLDEN_FILE : SOFTWARE_FRAME_FILE), std::ios::binary);
+	out.write((const char*)&bytes[0], bytes.size());
+	if (!out.good())
+	{
+		softwareRenderResult = "Couldn't save the frame";
+		return;
+	}
+	if (saveAsGolden)
+	{
+		softwareRenderResult = "Saved as the golden image";
+		return;
+	}
+
+	std::ifstream in(FixPath(SOFTWARE_GOLDEN_FILE), std::ios::binary);
+	std::vector<unsigned char> goldenBytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	TextureImage golden;
+	if (goldenBytes.empty() || !DeserializeSoftwareImage(&goldenBytes[0], goldenBytes.size(), &golden))
+	{
+		softwareRenderResult = "No golden image to compare with";
+		return;
+	}
+
+	SoftwareImageDifference difference = CompareSoftwareImages(frame, golden, SOFTWARE_GOLDEN_TOLERANCE);
+	if (!difference.SameSize)
+		softwareRenderResult = "MISMATCH (golden image is a different size)";
+	else if (difference.DifferentPixels > 0)
+		softwareRenderResult = "MISMATCH (" + std::to_string(difference.DifferentPixels) + " pixels, up to " + std::to_string(difference.MaxDifference) + " apart)";
+	else
+		softwareRenderResult = "OK (up to " + std::to_string(difference.MaxDifference) + " apart)";
+}
+
+
+// --------------------------------------------------------
+// Packs every asset into the asset pack (replacing it) and
+// mounts it, or just unmounts the pack when it's not used.
+// Assets already loaded are unaffected until reloaded.
+// --------------------------------------------------------
+void Game::UpdateAssetPack(bool rebuild)
+{
+	// A mapped file can't be replaced, so always unmount first
+	UnmountAssetPacks();
+	std::wstring path = FixPath(ASSET_PACK_FILE);
+	if (rebuild)
+	{
+		std::vector<std::wstring> files;
+		FindPackableFiles(&files);
+		useAssetPack = BuildAssetPack(path, files, compressAssetPack);
+	}
+
+	if (useAssetPack)
+		useAssetPack = MountAssetPack(path);
+}
+
+
+// --------------------------------------------------------
+// Gives the texture streamer this frame's feedback (how
+// large each entity is on screen), then lets it evict and
+// stream in mips
+// --------------------------------------------------------
+void Game::UpdateTextureStreaming()
+{
+	PROFILE_FUNCTION();
+	auto start = std::chrono::high_resolution_clock::now();
+
+	XMFLOAT3 camPos = camera->GetTransform()->GetPosition();
+	XMFLOAT3 camForward = camera->GetTransform()->GetForward();
+
+	textureStreamer->SetBudget((size_t)textureStreamingBudget * 1024 * 1024);
+	textureStreamer->BeginFeedback();
+	entities.Each<Bounds, MaterialRef>([&](Entity, Bounds& bounds, MaterialRef& material)
+	{
+		float pixels = GetSphereScreenSize(
+			XMFLOAT3(bounds.Sphere.x, bounds.Sphere.y, bounds.Sphere.z),
+			bounds.Sphere.w,
+			camPos,
+			camForward,
+			camera->GetFieldOfView(),
+			(float)windowHeight);
+		textureStreamer->AddFeedback(material.Asset, pixels);
+	});
+	textureStreamer->Update();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	textureStreamingTime = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+// --------------------------------------------------------
+// Saves every profiled scope in a span of time as a trace,
+// which chrome://tracing or ui.perfetto.dev can open
+//
+// start, end - Span to save, in profiler time
+//
+// Returns false if the file couldn't be written
+// --------------------------------------------------------
+bool Game::SaveProfilerTrace(unsigned long long start, unsigned long long end)
+{
+	std::vector<ProfileThreadEvents> threads;
+	Profiler::Collect(start, end, &threads);
+
+	std::ofstream out(FixPath(PROFILER_TRACE_FILE));
+	Profiler::WriteChromeTrace(out, threads);
+	return out.good();
+}
+
+
+
+// --------------------------------------------------------
+// Handle resizing DirectX "stuff" to match the new window size.
+// For instance, updating our projection matrix's aspect ratio.
+// --------------------------------------------------------
+void Game::OnResize()
+{
+	// Handle base-level DX resize stuff
+	DXCore::OnResize();
+
+	// Update our projection matrix to match the new aspect ratio
+	if (camera)
+		camera->UpdateProjectionMatrix(this->windowWidth / (float)this->windowHeight);
+}
+
+// --------------------------------------------------------
+// Update your game here - user input, move objects, AI, etc.
+// --------------------------------------------------------
+void Game::Update(float deltaTime, float totalTime)
+{
+	PROFILE_FUNCTION();
+
+	// Reload everything if the UI asked last frame, before
+	// anything uses the current assets
+	// (The simulation thread restarts with the new scene)
+	if (reloadAssets)
+	{
+		StopSimulationThread();
+		assetsLoaded = LoadAssetsAndCreateEntities(reloadAssetsMultithreaded);
+		reloadAssets = false;
+		if (!assetsLoaded)
+			Quit();
+		else if (simulateOnThread)
+			StartSimulationThread();
+	}
+
+	// Nothing is usable after a failed load, so just wait
+	// for the window to close
+	if (!assetsLoaded)
+		return;
+
+	// Set up the new frame for the UI, then build
+	// this frame's interface.  Note that the building
+	// of the UI could happen at any point during update.
+	{
+		PROFILE_SCOPE("Build UI");
+		UINewFrame(deltaTime);
+		BuildUI();
+	}
+
+	// The simulation either runs on its own thread, or (without
+	// the fixed timestep) moves once per frame by however long
+	// the frame took
+	if (simulationThread.joinable())
+		ApplySimulationSnapshot();
+	else if (!useFixedTimestep)
+		SimulateEntities(deltaTime);
+	UpdateEntityBounds();
+
+	// Update the camera
+	camera->Update(deltaTime);
+
+	// Stream textures for what the camera now sees
+	if (textureStreamer)
+		UpdateTextureStreaming();
+
+	// Check individual input
+	Input& input = Input::GetInstance();
+	if (input.KeyDown(VK_ESCAPE)) Quit();
+	if (input.KeyPress(VK_TAB))
+	{
+		StopSimulationThread();
+		GenerateLights();
+		if (simulateOnThread)
+			StartSimulationThread();
+	}
+}
+
+// --------------------------------------------------------
+// Advances the simulation one fixed step, while the fixed
+// timestep is in use.  Runs as many times per frame as
+// there are steps due, so input and the UI stay in Update().
+// --------------------------------------------------------
+void Game::FixedUpdate(float stepTime, float totalTime)
+{
+	if (!assetsLoaded || simulationThread.joinable())
+		return;
+	PROFILE_FUNCTION();
+
+	// Drawing interpolates from here to the step's result
+	SavePreviousEntityStates();
+	SimulateEntities(stepTime);
+}
+
+// --------------------------------------------------------
+// Clear the screen, redraw everything, present to the user
+// --------------------------------------------------------
+void Game::Draw(float deltaTime, float totalTime)
+{
+	PROFILE_FUNCTION();
+	if (!assetsLoaded)
+		return;
+
+	// Frame START
+	// - These things should happen ONCE PER FRAME
+	// - At the beginning of Game::Draw() before drawing *anything*
+	{
+		// Clear the back buffer (erases what's on the screen)
+		const float bgColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f }; // Black
+		context->ClearRenderTargetView(backBufferRTV.Get(), bgColor);
+
+		// Clear the depth buffer (resets per-pixel occlusion information)
+		context->ClearDepthStencilView(depthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+		// Start tracking this frame's constant data
+		constantBufferRing->BeginFrame();
+
+		// The UI (and anything else outside of SimpleShader) changed
+		// bindings last frame, so the filter must start fresh
+		bindingFilter->Invalidate();
+		bindingFilter->ResetStats();
+	}
+
+
+	// Set the "per frame" data once, as the buffers are
+	// shared by every shader that declares them
+	vsPerFrame->SetMatrix4x4("view", camera->GetView());
+	vsPerFrame->SetMatrix4x4("projection", camera->GetProjection());
+	vsPerFrame->CopyBufferData();
+
+	UploadLights();
+	BuildLightClusters();
+	if (useEntityLightLists)
+		UpdateEntityLightLists();
+	psPerFrame->SetInt("directionalLightCount", directionalLightCount);
+	psPerFrame->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
+	psPerFrame->SetFloat3("cameraForward", camera->GetTransform()->GetForward());
+	psPerFrame->SetFloat2("screenSize", XMFLOAT2((float)windowWidth, (float)windowHeight));
+	psPerFrame->SetFloat("clusterDepthScale", lightClusters.GetDepthScale());
+	psPerFrame->SetFloat("clusterDepthBias", lightClusters.GetDepthBias());
+	psPerFrame->CopyBufferData();
+
+	// Image based lighting from the sky (only changes if the
+	// intensity does, so this rarely actually uploads)
+	XMFLOAT4 irradianceSH[IBL_SH_COEFFICIENTS] = {};
+	for (int i = 0; i < IBL_SH_COEFFICIENTS; i++)
+	{
+		XMFLOAT3 sh = sky->GetIrradianceSH()[i];
+		irradianceSH[i] = XMFLOAT4(sh.x, sh.y, sh.z, 0);
+	}
+	psPerSky->SetData("irradianceSH", irradianceSH, sizeof(irradianceSH));
+	psPerSky->SetFloat("specularMipCount", (float)sky->GetSpecularMipCount());
+	psPerSky->SetFloat("iblIntensity", sky->HasIBL() ? iblIntensity : 0.0f);
+	psPerSky->CopyBufferData();
+
+	// Entities are drawn between their last two simulation
+	// steps when those are fixed
+	float interpolation = 1.0f;
+	if (currentSnapshot)
+		interpolation = currentSnapshot->Interpolation;
+	else if (useFixedTimestep)
+		interpolation = (float)fixedTimestep.GetAlpha();
+
+	// Find what's hidden before anything is submitted
+	if (useOcclusionCulling)
+		UpdateOcclusionCulling(interpolation);
+
+	// Time submitting this exact frame to a null device first?
+	if (captureSceneSubmission)
+	{
+		CaptureSceneSubmission(interpolation);
+		captureSceneSubmission = false;
+	}
+
+	DrawScene(renderDevice.get(), interpolation, recordDrawsInParallel && deferredDraws->IsSupported());
+
+	// Frame END
+	// - These should happen exactly ONCE PER FRAME
+	// - At the very end of the frame (after drawing *everything*)
+	{
+		// Draw the UI after everything else
+		{
+			PROFILE_SCOPE("Draw UI");
+			ImGui::Render();
+			ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+		}
+
+		// Present the back buffer to the user
+		//  - Puts the results of what we've drawn onto the window
+		//  - Without this, the user never sees anything
+		//  - Timed for the frame stats, as it can block on the GPU or vsync
+		bool vsyncNecessary = vsync || !deviceSupportsTearing || isFullscreen;
+		auto presentStart = std::chrono::high_resolution_clock::now();
+		{
+			PROFILE_SCOPE("Present");
+			swapChain->Present(
+				vsyncNecessary ? 1 : 0,
+				vsyncNecessary ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+		}
+		auto presentEnd = std::chrono::high_resolution_clock::now();
+		currentFrame.Times[FRAME_STATS_PRESENT] = std::chrono::duration<double, std::milli>(presentEnd - presentStart).count();
+
+		// Must re-bind buffers after presenting, as they become unbound
+		context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
+
+		// The simulation thread can now reuse this frame's snapshot
+		if (currentSnapshot)
+		{
+			simulationPipeline.EndRead();
+			currentSnapshot = 0;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Submits the scene: the per frame lighting textures, the
+// entities, the light sources and the sky.  Returns the
+// number of draws made.
+//
+// drawDevice       - Receives the mesh and sky draws (the
+//                    shaders send their binds to their own)
+// interpolation    - How far between the last two simulation
+//                    steps entities are drawn
+// recordInParallel - Record entities on deferred contexts?
+// --------------------------------------------------------
+unsigned int Game::DrawScene(IRenderDevice* drawDevice, float interpolation, bool recordInParallel)
+{
+	pixelShaderPBR->SetShaderResourceView("SpecularIBL", sky->GetSpecularIBL());
+	pixelShaderPBR->SetShaderResourceView("BRDFLookUp", sky->GetBRDFLookUpTexture());
+	pixelShaderPBR->SetSamplerState("ClampSampler", clampSampler);
+
+	// Both pixel shaders read lights from the same registers, so
+	// these stay bound for the entire frame
+	std::shared_ptr<SimplePixelShader> lightingShaders[] = { pixelShader, pixelShaderPBR };
+	for (auto& ps : lightingShaders)
+	{
+		ps->SetShaderResourceView("lights", lightBuffer->GetSRV());
+		ps->SetShaderResourceView("clusterGrid", clusterGridBuffer->GetSRV());
+		ps->SetShaderResourceView("clusterLightIndices", clusterIndexBuffer->GetSRV());
+	}
+
+	// Draw all of the entities
+	unsigned int drawCount = 0;
+	{
+		PROFILE_SCOPE("Draw Entities");
+		auto isCulled = [&](unsigned int i) { return useOcclusionCulling && entityOcclusion[i] != OCCLUSION_VISIBLE; };
+
+		// Record on deferred contexts across threads?  If anything
+		// can't be recorded, everything is drawn as usual instead
+		bool recorded = false;
+		if (recordInParallel)
+		{
+			deferredDraws->BeginFrame();
+			unsigned int i = 0;
+			bool recording = true;
+			entities.Each<Transform, MeshRef, MaterialRef>([&](Entity, Transform& current, MeshRef& mesh, MaterialRef& material)
+			{
+				unsigned int index = i++;
+				if (!recording || isCulled(index))
+					return;
+				SetEntityLights(index, material.Asset);
+
+				Transform* transform = &current;
+				Transform drawn;
+				if (interpolation < 1.0f)
+				{
+					transform->Interpolate(interpolation, &drawn);
+					transform = &drawn;
+				}
+				recording = deferredDraws->AddDraw(material.Asset, transform, mesh.Asset);
+			});
+			recorded = deferredDraws->Submit(JobSystem::GetInstance(), deferredDrawMinBatchSize);
+		}
+
+		if (!recorded)
+		{
+			unsigned int i = 0;
+			entities.Each<Transform, MeshRef, MaterialRef>([&](Entity, Transform& transform, MeshRef& mesh, MaterialRef& material)
+			{
+				unsigned int index = i++;
+				if (isCulled(index))
+					return;
+				SetEntityLights(index, material.Asset);
+				DrawEntity(drawDevice, camera, transform, mesh.Asset, material.Asset, interpolation);
+				drawCount++;
+			});
+		}
+	}
+
+	// Draw the light sources?
+	if(showPointLights)
+		drawCount += DrawPointLights(drawDevice);
+
+	// Draw the sky
+	{
+		PROFILE_SCOPE("Draw Sky");
+		sky->Draw(drawDevice);
+		drawCount++;
+	}
+	return drawCount;
+}
+
+// --------------------------------------------------------
+// Draws the scene once more, this time with every shader
+// bind, mesh and sky draw going to a null render device that
+// records them.  This times submitting the real frame with
+// no driver in the way, like the synthetic benchmark.
+//
+// interpolation - As for drawing the frame itself
+// --------------------------------------------------------
+void Game::CaptureSceneSubmission(float interpolation)
+{
+	PROFILE_FUNCTION();
+
+	// The filter only knows what the real device has bound
+	std::shared_ptr<NullRenderDevice> nullDevice = std::make_shared<NullRenderDevice>();
+	SetShaderRenderDevice(nullDevice);
+	bindingFilter->Invalidate();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	unsigned int drawCount = DrawScene(nullDevice.get(), interpolation, false);
+	auto end = std::chrono::high_resolution_clock::now();
+
+	// And then nothing the real device has bound
+	SetShaderRenderDevice(renderDevice);
+	bindingFilter->Invalidate();
+	bindingFilter->ResetStats();
+
+	RenderSubmissionTiming timing = {};
+	timing.Method = "Scene";
+	timing.TimePerDraw = std::chrono::duration<double, std::micro>(end - start).count() / (std::max)(drawCount, 1u);
+	timing.Commands = (unsigned int)nullDevice->GetCommands().size();
+	timing.Verified = nullDevice->GetCallCount(RENDER_COMMAND_DRAW_INDEXED) == drawCount;
+	renderSubmissionTimings.push_back(timing);
+}
+
+// --------------------------------------------------------
+// Sends every shader's binds to the given render device
+// --------------------------------------------------------
+void Game::SetShaderRenderDevice(std::shared_ptr<IRenderDevice> device)
+{
+	std::shared_ptr<ISimpleShader> shaders[] = { vertexShader, pixelShader, pixelShaderPBR, solidColorPS, skyVS, skyPS };
+	for (auto& s : shaders)
+		s->SetRenderDevice(device);
+}
+
+
+// --------------------------------------------------------
+// Moves a scene forward: spins the entities and swings the
+// point and spot lights around the middle (if animated),
+// then burns any extra time asked for, standing in for a
+// costlier simulation.  Only the first lightCount lights
+// are in use, so only those move.  Only touches what it's
+// given, so it can run on any thread.
+// --------------------------------------------------------
+static void SimulateScene(const std::vector<Transform*>& transforms, std::vector<Light>& lights, unsigned int lightCount, bool animate, float stepCost, float deltaTime)
+{
+	if (animate)
+	{
+		for (unsigned int i = 0; i < transforms.size(); i++)
+			transforms[i]->Rotate(0, (0.25f + 0.25f * (i % 4)) * deltaTime, 0);
+
+		XMMATRIX orbit = XMMatrixRotationY(0.2f * deltaTime);
+		lightCount = (std::min)(lightCount, (unsigned int)lights.size());
+		for (unsigned int i = 0; i < lightCount; i++)
+		{
+			Light& light = lights[i];
+			if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+				continue;
+			XMStoreFloat3(&light.Position, XMVector3Transform(XMLoadFloat3(&light.Position), orbit));
+			XMStoreFloat3(&light.Direction, XMVector3TransformNormal(XMLoadFloat3(&light.Direction), orbit));
+		}
 	}
 
+	if (stepCost > 0)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		while (std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() < stepCost);
+	}
 }
 
-
-
 // --------------------------------------------------------
-// Handle resizing DirectX "stuff" to match the new window size.
-// For instance, updating our projection matrix's aspect ratio.
+// Moves the simulation forward on this thread
 // --------------------------------------------------------
-void Game::OnResize()
+void Game::SimulateEntities(float deltaTime)
 {
-	// Handle base-level DX resize stuff
-	DXCore::OnResize();
+	std::vector<Transform*> transforms;
+	entities.Each<Transform>([&](Entity, Transform& transform) { transforms.push_back(&transform); });
 
-	// Update our projection matrix to match the new aspect ratio
-	if (camera)
-		camera->UpdateProjectionMatrix(this->windowWidth / (float)this->windowHeight);
+	SimulateScene(transforms, lights, (unsigned int)lightCount, animateScene, simulationStepCost, deltaTime);
+}
+
+void Game::SavePreviousEntityStates()
+{
+	entities.Each<Transform>([](Entity, Transform& transform) { transform.SavePreviousState(); });
 }
 
 // --------------------------------------------------------
-// Update your game here - user input, move objects, AI, etc.
+// Moves the simulation onto a thread of its own, starting
+// from the scene as it is now
 // --------------------------------------------------------
-void Game::Update(float deltaTime, float totalTime)
+void Game::StartSimulationThread()
 {
-	// Set up the new frame for the UI, then build
-	// this frame's interface.  Note that the building
-	// of the UI could happen at any point during update.
-	UINewFrame(deltaTime);
-	BuildUI();
+	if (simulationThread.joinable())
+		return;
+
+	simulatedTransforms.clear();
+	entities.Each<Transform>([&](Entity, Transform& transform) { simulatedTransforms.push_back(transform); });
+	simulatedLights = lights;
+	simulationLightCount = (unsigned int)lightCount;
+	simulationAnimate = animateScene;
+	simulationCost = simulationStepCost;
+
+	simulationPipeline.Reset();
+	simulationThread = std::thread(&Game::SimulationThreadLoop, this, fixedTimestep.GetStepTime(), fixedTimestep.GetMaxSteps());
+}
 
-	// Update the camera
-	camera->Update(deltaTime);
+// --------------------------------------------------------
+// Stops the simulation thread, leaving the scene as of the
+// last snapshot applied
+// --------------------------------------------------------
+void Game::StopSimulationThread()
+{
+	if (!simulationThread.joinable())
+		return;
 
-	// Check individual input
-	Input& input = Input::GetInstance();
-	if (input.KeyDown(VK_ESCAPE)) Quit();
-	if (input.KeyPress(VK_TAB)) GenerateLights();
+	simulationPipeline.Stop();
+	simulationThread.join();
+	currentSnapshot = 0;
 }
 
 // --------------------------------------------------------
-// Clear the screen, redraw everything, present to the user
+// The simulation thread: steps its copy of the scene at a
+// fixed rate, as real time passes, and publishes a snapshot
+// for every frame the render thread draws.  Waits whenever
+// it's a frame ahead.
+//
+// stepTime - Seconds each step simulates
+// maxSteps - Most steps per snapshot
 // --------------------------------------------------------
-void Game::Draw(float deltaTime, float totalTime)
+void Game::SimulationThreadLoop(double stepTime, unsigned int maxSteps)
 {
-	// Frame START
-	// - These things should happen ONCE PER FRAME
-	// - At the beginning of Game::Draw() before drawing *anything*
-	{
-		// Clear the back buffer (erases what's on the screen)
-		const float bgColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f }; // Black
-		context->ClearRenderTargetView(backBufferRTV.Get(), bgColor);
-
-		// Clear the depth buffer (resets per-pixel occlusion information)
-		context->ClearDepthStencilView(depthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
-	}
+	PROFILE_THREAD("Simulation");
 
+	FixedTimestep timestep(stepTime, maxSteps);
+	std::vector<Transform*> transforms;
+	for (auto& t : simulatedTransforms)
+		transforms.push_back(&t);
 
-	// Draw all of the entities
-	for (auto& ge : entities)
+	auto last = std::chrono::high_resolution_clock::now();
+	while (SimulationSnapshot* snapshot = simulationPipeline.BeginWrite())
 	{
-		// Set the "per frame" data
-		// Note that this should literally be set once PER FRAME, before
-		// the draw loop, but we're currently setting it per entity since 
-		// we are just using whichever shader the current entity has.  
-		// Inefficient!!!
-		std::shared_ptr<SimplePixelShader> ps = ge->GetMaterial()->GetPixelShader();
-		ps->SetData("lights", (void*)(&lights[0]), sizeof(Light) * lightCount);
-		ps->SetInt("lightCount", lightCount);
-		ps->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
-		ps->CopyBufferData("perFrame");
+		PROFILE_SCOPE("Simulate Frame");
+		auto start = std::chrono::high_resolution_clock::now();
+		timestep.Accumulate(std::chrono::duration<double>(start - last).count());
+		last = start;
+
+		unsigned int lightCount = simulationLightCount;
+		bool animate = simulationAnimate;
+		float cost = simulationCost;
+		while (timestep.Step())
+		{
+			for (auto t : transforms)
+				t->SavePreviousState();
+			SimulateScene(transforms, simulatedLights, lightCount, animate, cost, (float)stepTime);
+		}
 
-		// Draw the entity
-		ge->Draw(context, camera);
+		// Only the lights in use go into the snapshot, reusing
+		// its storage from the last time round
+		lightCount = (std::min)(lightCount, (unsigned int)simulatedLights.size());
+		snapshot->Transforms = simulatedTransforms;
+		snapshot->Lights.assign(simulatedLights.begin(), simulatedLights.begin() + lightCount);
+		snapshot->Interpolation = (float)timestep.GetAlpha();
+		snapshot->SimulatedTime = timestep.GetSimulatedTime();
+		snapshot->SimulationTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		simulationPipeline.EndWrite();
 	}
+}
 
-	// Draw the light sources?
-	if(showPointLights)
-		DrawPointLights();
+// --------------------------------------------------------
+// Takes the next snapshot from the simulation thread and
+// puts the scene in that state, holding onto the snapshot
+// until the frame has been drawn
+// --------------------------------------------------------
+void Game::ApplySimulationSnapshot()
+{
+	PROFILE_FUNCTION();
 
-	// Draw the sky
-	sky->Draw(camera);
+	// Settings for the steps still to come
+	simulationLightCount = (unsigned int)lightCount;
+	simulationAnimate = animateScene;
+	simulationCost = simulationStepCost;
 
-	// Frame END
-	// - These should happen exactly ONCE PER FRAME
-	// - At the very end of the frame (after drawing *everything*)
-	{
-		// Draw the UI after everything else
-		ImGui::Render();
-		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+	currentSnapshot = simulationPipeline.BeginRead();
+	if (!currentSnapshot)
+		return;
 
-		// Present the back buffer to the user
-		//  - Puts the results of what we've drawn onto the window
-		//  - Without this, the user never sees anything
-		bool vsyncNecessary = vsync || !deviceSupportsTearing || isFullscreen;
-		swapChain->Present(
-			vsyncNecessary ? 1 : 0,
-			vsyncNecessary ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+	ComponentPool<Transform>& transforms = entities.GetPool<Transform>();
+	for (size_t i = 0; i < transforms.GetSize() && i < currentSnapshot->Transforms.size(); i++)
+		transforms.GetComponents()[i] = currentSnapshot->Transforms[i];
 
-		// Must re-bind buffers after presenting, as they become unbound
-		context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
+	// The snapshot only has the lights that were in use, and
+	// the rest stay where they are until they're used again
+	for (size_t i = 0; i < lights.size() && i < currentSnapshot->Lights.size(); i++)
+		lights[i] = currentSnapshot->Lights[i];
+}
+
+
+// --------------------------------------------------------
+// Passes along an entity's chosen lights to its pixel
+// shader, or a negative count so the shader uses the
+// cluster lists instead
+// --------------------------------------------------------
+void Game::SetEntityLights(unsigned int index, Material* material)
+{
+	std::shared_ptr<SimplePixelShader> ps = material->GetPixelShader();
+	unsigned int objectLights[ENTITY_MAX_LIGHTS] = {};
+	int objectLightCount = -1;
+	if (useEntityLightLists)
+	{
+		objectLightCount = (int)entityLightLists.GetLightCount(index);
+		memcpy(objectLights, entityLightLists.GetLights(index), sizeof(unsigned int) * objectLightCount);
 	}
+	ps->SetData("objectLights", objectLights, sizeof(objectLights));
+	ps->SetInt("objectLightCount", objectLightCount);
 }
 
 
 // --------------------------------------------------------
-// Draws the point lights as solid color spheres
+// Draws the point lights as solid color spheres, returning
+// how many were drawn
 // --------------------------------------------------------
-void Game::DrawPointLights()
+unsigned int Game::DrawPointLights(IRenderDevice* drawDevice)
 {
+	PROFILE_FUNCTION();
+
 	// Turn on these shaders
 	lightVS->SetShader();
 	lightPS->SetShader();
 
-	// Set up vertex shader
-	lightVS->SetMatrix4x4("view", camera->GetView());
-	lightVS->SetMatrix4x4("projection", camera->GetProjection());
-
+	unsigned int drawCount = 0;
 	for (int i = 0; i < lightCount; i++)
 	{
 		Light light = lights[i];
@@ -604,14 +1854,16 @@ void Game::DrawPointLights()
 		finalColor.z *= light.Intensity;
 		lightPS->SetFloat3("Color", finalColor);
 
-		// Copy data
+		// Copy data, with room for both reserved up front
+		ISimpleShader::ReserveRingSpace(lightVS.get(), lightPS.get());
 		lightVS->CopyAllBufferData();
 		lightPS->CopyAllBufferData();
 
 		// Draw
-		lightMesh->SetBuffersAndDraw(context);
+		lightMesh->SetBuffersAndDraw(drawDevice);
+		drawCount++;
 	}
-
+	return drawCount;
 }
 
 
@@ -671,6 +1923,19 @@ void Game::BuildUI()
 			ImGui::Text("Frame rate: %f fps", ImGui::GetIO().Framerate);
 			ImGui::Text("Window Client Size: %dx%d", windowWidth, windowHeight);
 
+			// Constant buffer details
+			ImGui::Spacing();
+			ConstantBufferRingUI(*constantBufferRing, &ringAllocatorTestResults);
+
+			ImGui::Spacing();
+			TextureCacheUI(*textureCache);
+
+			ImGui::Spacing();
+			ShaderReflectionUI(&shaderReflectionTestResults);
+
+			ImGui::Spacing();
+			BindingFilterUI(*bindingFilter, device, vertexShader, pixelShaderPBR, "BRDFLookUp", "ClampSampler", &bindingFilterTestResults);
+
 			ImGui::Spacing();
 			ImGui::Text("Scene Details");
 			ImGui::Text("Top Row:");    ImGui::SameLine(125); ImGui::Text("PBR Materials");
@@ -687,6 +1952,224 @@ void Game::BuildUI()
 			ImGui::TreePop();
 		}
 		
+		// === Frame stats ===
+		if (ImGui::TreeNode("Frame Stats"))
+		{
+			ImGui::Spacing();
+			FrameStatsUI(frameStats, &recordFrameStats, FRAME_STATS_CSV_FILE, &frameStatsSaved);
+
+			ImGui::Spacing();
+
+			// Finalize the tree node
+			ImGui::TreePop();
+		}
+
+		// === Profiler ===
+		if (ImGui::TreeNode("Profiler"))
+		{
+			ProfilerUI();
+
+			// Finalize the tree node
+			ImGui::TreePop();
+		}
+
+		// === Simulation ===
+		if (ImGui::TreeNode("Simulation"))
+		{
+			ImGui::Spacing();
+			ImGui::Checkbox("Animate Scene", &animateScene);
+			ImGui::SliderFloat("Extra Cost Per Step (ms)", &simulationStepCost, 0.0f, 20.0f);
+
+			// Starting fresh, so nothing interpolates from stale states
+			if (ImGui::Checkbox("Fixed Timestep", &useFixedTimestep))
+			{
+				fixedTimestep.Reset();
+				SavePreviousEntityStates();
+			}
+
+			// The simulation thread always uses a fixed step, so it
+			// restarts to pick up changes
+			int stepsPerSecond = (int)(1.0 / fixedTimestep.GetStepTime() + 0.5);
+			int maxSteps = (int)fixedTimestep.GetMaxSteps();
+			bool stepChanged = ImGui::SliderInt("Steps Per Second", &stepsPerSecond, 10, 240);
+			stepChanged |= ImGui::SliderInt("Max Steps Per Frame", &maxSteps, 1, 20);
+			if (stepChanged)
+			{
+				fixedTimestep.SetStepTime(1.0 / stepsPerSecond);
+				fixedTimestep.SetMaxSteps((unsigned int)maxSteps);
+			}
+			if (ImGui::Checkbox("Simulate On Its Own Thread", &simulateOnThread) || (stepChanged && simulateOnThread))
+			{
+				StopSimulationThread();
+				if (simulateOnThread)
+					StartSimulationThread();
+			}
+
+			if (useFixedTimestep)
+			{
+				ImGui::Text("Steps:");         ImGui::SameLine(125); ImGui::Text("%u this frame, %llu total", fixedTimestep.GetStepsThisFrame(), fixedTimestep.GetTotalSteps());
+				ImGui::Text("Interpolation:"); ImGui::SameLine(125); ImGui::Text("%.2f", fixedTimestep.GetAlpha());
+				ImGui::Text("Simulated:");     ImGui::SameLine(125); ImGui::Text("%.2f s", fixedTimestep.GetSimulatedTime());
+				ImGui::Text("Fell Behind:");   ImGui::SameLine(125); ImGui::Text("%u frames, %.2f s dropped", fixedTimestep.GetCappedFrames(), fixedTimestep.GetDroppedTime());
+			}
+
+			// On its own thread, entities and lights come from its
+			// snapshots (so editing them elsewhere doesn't last)
+			if (currentSnapshot)
+			{
+				ImGui::Text("Snapshot:");      ImGui::SameLine(125); ImGui::Text("%.2f ms to make, %.2f s simulated", currentSnapshot->SimulationTime, currentSnapshot->SimulatedTime);
+				ImGui::Text("Frames:");        ImGui::SameLine(125); ImGui::Text("%llu simulated, %llu drawn", simulationPipeline.GetFramesProduced(), simulationPipeline.GetFramesConsumed());
+			}
+
+			ImGui::Spacing();
+			FramePipelineUI(&framePipelineTimings);
+
+			ImGui::Spacing();
+
+			// Finalize the tree node
+			ImGui::TreePop();
+		}
+
+		// === Job system ===
+		if (ImGui::TreeNode("Job System"))
+		{
+			ImGui::Spacing();
+			JobSystemUI(JobSystem::GetInstance(), &jobSystemTestResults, &jobSystemTimings);
+
+			ImGui::Spacing();
+
+			// Finalize the tree node
+			ImGui::TreePop();
+		}
+
+		// === Command recording ===
+		if (ImGui::TreeNode("Command Recording"))
+		{
+			ImGui::Spacing();
+			CommandRecordingUI(*deferredDraws, &recordDrawsInParallel, &deferredDrawMinBatchSize, &commandRecordingTestResults);
+
+			ImGui::Spacing();
+			RenderSubmissionUI(&renderSubmissionTimings, &captureSceneSubmission);
+
+			ImGui::Spacing();
+
+			// Finalize the tree node
+			ImGui::TreePop();
+		}
+
+		// === Software rendering ===
+		if (ImGui::TreeNode("Software Rendering"))
+		{
+			ImGui::Spacing();
+			if (ImGui::Button("Render Frame"))
+				RenderSoftwareFrame(false);
+			ImGui::SameLine();
+			if (ImGui::Button("Save As Golden"))
+				RenderSoftwareFrame(true);
+
+			SoftwareRasterizerUI(softwareRasterizer, softwareRenderResult, softwareRenderTime, &softwareRasterizerTimings);
+
+			ImGui::Spacing();
+
+			// Finalize the tree node
+			ImGui::TreePop();
+		}
+
+		// === Occlusion culling ===
+		if (ImGui::TreeNode("Occlusion Culling"))
+		{
+			ImGui::Spacing();
+			OcclusionCullingUI(occlusionBuffer, &useOcclusionCulling, occlusionCullingTime, &occlusionCullingTimings);
+
+			ImGui::Spacing();
+
+			// Finalize the tree node
+			ImGui::TreePop();
+		}
+
+		// === Asset loading ===
+		if (ImGui::TreeNode("Asset Loading"))
+		{
+			ImGui::Spacing();
+			ImGui::Text("Last Load: %.2f ms on %u thread(s)", assetLoadTime, assetLoadThreadCount);
+			ImGui::Text("Parallel:");   ImGui::SameLine(125); ImGui::Text(parallelAssetLoadTime > 0 ? "%.2f ms" : "Not run", parallelAssetLoadTime);
+			ImGui::Text("Sequential:"); ImGui::SameLine(125); ImGui::Text(sequentialAssetLoadTime > 0 ? "%.2f ms" : "Not run", sequentialAssetLoadTime);
+
+			// Sharing of loaded assets
+			ImGui::Spacing();
+			AssetRegistryUI("Textures:", textureCache->GetRegistryStats());
+			AssetRegistryUI("Meshes:", meshRegistry.GetStats());
+			ImGui::Checkbox("Keep Loaded Assets on Reload", &keepLoadedAssets);
+
+			// Reloading happens at the start of the next update,
+			// rather than in the middle of building the UI
+			if (ImGui::Button("Reload Assets (Parallel)"))
+			{
+				reloadAssets = true;
+				reloadAssetsMultithreaded = true;
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Reload Assets (Sequential)"))
+			{
+				reloadAssets = true;
+				reloadAssetsMultithreaded = false;
+			}
+
+			ImGui::Spacing();
+			if (ImGui::TreeNode("Timeline"))
+			{
+				JobTimelineUI(assetLoadTimeline, assetLoadTime);
+				ImGui::TreePop();
+			}
+
+			ImGui::Spacing();
+
+			// Finalize the tree node
+			ImGui::TreePop();
+		}
+
+		// === Asset pack ===
+		if (ImGui::TreeNode("Asset Pack"))
+		{
+			ImGui::Spacing();
+			AssetFilesUI();
+
+			// Changes apply to assets loaded from now on
+			if (ImGui::Checkbox("Use Asset Pack", &useAssetPack))
+				UpdateAssetPack(false);
+			ImGui::SameLine();
+			ImGui::Checkbox("Compress with LZ4", &compressAssetPack);
+			ImGui::SameLine();
+			if (ImGui::Button("Build Asset Pack"))
+			{
+				useAssetPack = true;
+				UpdateAssetPack(true);
+			}
+
+			ImGui::Spacing();
+			AssetReadUI(FindPackableFiles, &assetReadTimings);
+
+			ImGui::Spacing();
+
+			// Finalize the tree node
+			ImGui::TreePop();
+		}
+
+		// === Texture streaming ===
+		if (ImGui::TreeNode("Texture Streaming"))
+		{
+			ImGui::Spacing();
+			ImGui::Checkbox("Stream Textures (on Reload)", &useTextureStreaming);
+			ImGui::SliderInt("Budget (MB)", &textureStreamingBudget, 1, 128);
+
+			TextureStreamingUI(textureStreamer.get(), textureStreamingTime, camera->GetFieldOfView(), (float)windowHeight, &textureStreamingResults);
+
+			ImGui::Spacing();
+
+			// Finalize the tree node
+			ImGui::TreePop();
+		}
+
 		// === Controls ===
 		if (ImGui::TreeNode("Controls"))
 		{
@@ -715,17 +2198,22 @@ void Game::BuildUI()
 		// === Entities ===
 		if (ImGui::TreeNode("Scene Entities"))
 		{
+			ImGui::Spacing();
+			EntityRegistryUI(&entityRegistryTimings);
+			ImGui::Spacing();
+
 			// Loop and show the details for each entity
-			for (int i = 0; i < entities.size(); i++)
+			ComponentPool<Transform>& transforms = entities.GetPool<Transform>();
+			for (unsigned int i = 0; i < transforms.GetSize(); i++)
 			{
 				// New node for each entity
 				// Note the use of PushID(), so that each tree node and its widgets
 				// have unique internal IDs in the ImGui system
 				ImGui::PushID(i);
-				if (ImGui::TreeNode("Entity Node", "Entity %d", i))
+				if (ImGui::TreeNode("Entity Node", "Entity %u", i))
 				{
 					// Build UI for one entity at a time
-					EntityUI(entities[i]);
+					EntityUI(entities.GetEntity(transforms.GetEntities()[i]));
 
 					ImGui::TreePop();
 				}
@@ -736,17 +2224,51 @@ void Game::BuildUI()
 			ImGui::TreePop();
 		}
 
+		// === Sky ===
+		if (ImGui::TreeNode("Sky"))
+		{
+			IBLUI(*sky, &iblIntensity, &iblTimings);
+
+			// Finalize the tree node
+			ImGui::TreePop();
+		}
+
 		// === Lights ===
 		if (ImGui::TreeNode("Lights"))
 		{
 			// Light details
 			ImGui::Spacing();
-			ImGui::SliderInt("Light Count", &lightCount, 0, MAX_LIGHTS);
+			if (ImGui::SliderInt("Light Count", &lightCount, 0, MAX_LIGHTS))
+				AddLights((unsigned int)lightCount);
 			ImGui::Checkbox("Show Point Lights", &showPointLights);
+			ImGui::Text("Active Lights: %u", activeLightCount);
+			ImGui::Text("Pack: %.3f ms, Upload: %.3f ms", lightPackTime, lightUploadTime);
 			ImGui::Spacing();
 
-			// Loop and show the details for each entity
-			for (int i = 0; i < lightCount; i++)
+			// Time the upload path at several sizes
+			if (ImGui::Button("Benchmark Light Upload"))
+				RunLightUploadBenchmark();
+			for (auto& t : lightUploadTimings)
+			{
+				ImGui::Text("%u lights:", t.LightCount);
+				ImGui::SameLine(125);
+				ImGui::Text("Pack %.3f ms, Upload %.3f ms", t.PackTime, t.UploadTime);
+			}
+			ImGui::Spacing();
+
+			LightClustersUI(lightClusters, clusterBuildTime, GetClusterFrustum(), &clusterTimings);
+			ImGui::Spacing();
+
+			EntityLightListsUI(entityLightLists, &useEntityLightLists, entityLightListTime, &lightSelectionTimings);
+			ImGui::Spacing();
+
+			ShadingUI(&shadingTimings);
+			ImGui::Spacing();
+
+			// Loop and show the details for each light (though only
+			// the first few, as there could be tens of thousands)
+			const int maxLightsInUI = 256;
+			for (int i = 0; i < lightCount && i < maxLightsInUI; i++)
 			{
 				// Name of this light based on type
 				std::string lightName = "Light %d";
@@ -835,12 +2357,12 @@ void Game::CameraUI(std::shared_ptr<Camera> cam)
 // --------------------------------------------------------
 // Builds the UI for a single entity
 // --------------------------------------------------------
-void Game::EntityUI(std::shared_ptr<GameEntity> entity)
+void Game::EntityUI(Entity entity)
 {
 	ImGui::Spacing();
 
 	// Transform details
-	Transform* trans = entity->GetTransform();
+	Transform* trans = &entities.Get<Transform>(entity);
 	XMFLOAT3 pos = trans->GetPosition();
 	XMFLOAT3 rot = trans->GetPitchYawRoll();
 	XMFLOAT3 sca = trans->GetScale();
@@ -851,7 +2373,7 @@ void Game::EntityUI(std::shared_ptr<GameEntity> entity)
 
 	// Mesh details
 	ImGui::Spacing();
-	ImGui::Text("Mesh Index Count: %d", entity->GetMesh()->GetIndexCount());
+	ImGui::Text("Mesh Index Count: %d", entities.Get<MeshRef>(entity).Asset->GetIndexCount());
 
 	ImGui::Spacing();
 }
@@ -909,3 +2431,98 @@ void Game::LightUI(Light& light)
 }
 
 
+// --------------------------------------------------------
+// Builds the profiler's UI: a flame graph of the last frame,
+// with a block of rows for each thread and a row for each
+// level of nesting, and buttons for saving traces
+// --------------------------------------------------------
+void Game::ProfilerUI()
+{
+	ImGui::Spacing();
+
+	bool recording = Profiler::IsRecording();
+	if (ImGui::Checkbox("Record", &recording))
+		Profiler::SetRecording(recording);
+	ImGui::SameLine();
+	ImGui::Checkbox("Freeze", &freezeProfiler);
+
+	// Grab the last finished frame, unless frozen
+	if (!freezeProfiler && Profiler::GetFrame(0, &profiledFrameStart, &profiledFrameEnd))
+		Profiler::Collect(profiledFrameStart, profiledFrameEnd, &profiledFrame);
+
+	double frameLength = (double)(profiledFrameEnd - profiledFrameStart);
+	ImGui::Text("Frame: %.3f ms", frameLength / 1000000.0);
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	float width = ImGui::GetContentRegionAvail().x;
+	float height = ImGui::GetTextLineHeightWithSpacing();
+	for (auto& thread : profiledFrame)
+	{
+		unsigned int depthCount = 0;
+		for (auto& e : thread.Events)
+			depthCount = (std::max)(depthCount, e.Depth + 1);
+
+		ImGui::Spacing();
+		if (thread.Name.empty())
+			ImGui::Text("Thread %u", thread.Thread);
+		else
+			ImGui::Text("%s", thread.Name.c_str());
+
+		ImVec2 pos = ImGui::GetCursorScreenPos();
+		ImGui::Dummy(ImVec2(width, height * depthCount));
+		bool hovered = ImGui::IsItemHovered();
+		ImVec2 mouse = ImGui::GetIO().MousePos;
+
+		for (auto& e : thread.Events)
+		{
+			// Scopes hanging over either end of the frame are cut off
+			double start = (std::max)((double)e.Start, (double)profiledFrameStart) - profiledFrameStart;
+			double end = (std::min)((double)e.End, (double)profiledFrameEnd) - profiledFrameStart;
+			float x0 = pos.x + (float)(start / frameLength) * width;
+			float x1 = (std::max)(x0 + 1.0f, pos.x + (float)(end / frameLength) * width);
+			float y0 = pos.y + e.Depth * height;
+			float y1 = y0 + height - 1;
+
+			// Colored by name, so each scope keeps its color
+			unsigned int hash = (unsigned int)(std::hash<std::string>()(e.Name));
+			drawList->AddRectFilled(
+				ImVec2(x0, y0),
+				ImVec2(x1, y1),
+				IM_COL32(60 + hash % 140, 60 + (hash >> 8) % 140, 60 + (hash >> 16) % 140, 255));
+
+			// Labels only go where they fit
+			if (x1 - x0 > 20)
+			{
+				drawList->PushClipRect(ImVec2(x0, y0), ImVec2(x1, y1), true);
+				drawList->AddText(ImVec2(x0 + 2, y0), IM_COL32(255, 255, 255, 255), e.Name);
+				drawList->PopClipRect();
+			}
+
+			if (hovered && mouse.x >= x0 && mouse.x < x1 && mouse.y >= y0 && mouse.y < y1)
+				ImGui::SetTooltip("%s\n%.3f ms", e.Name, (e.End - e.Start) / 1000000.0);
+		}
+	}
+
+	// Traces of recent frames, or the last asset load (which
+	// happens outside of frames)
+	ImGui::Spacing();
+	if (ImGui::Button("Save Chrome Trace"))
+	{
+		unsigned int frames = (std::min)(Profiler::GetFrameCount(), (unsigned int)PROFILER_TRACE_FRAMES);
+		unsigned long long start = 0;
+		unsigned long long end = 0;
+		unsigned long long unused = 0;
+		if (frames > 0 &&
+			Profiler::GetFrame(frames - 1, &start, &unused) &&
+			Profiler::GetFrame(0, &unused, &end))
+			profilerTraceSaved = SaveProfilerTrace(start, end) ? "recent frames" : 0;
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Save Asset Load Trace"))
+		profilerTraceSaved = SaveProfilerTrace(assetLoadTraceStart, assetLoadTraceEnd) ? "the last asset load" : 0;
+	if (profilerTraceSaved)
+		ImGui::Text("Saved %s to %s", profilerTraceSaved, WideToNarrow(PROFILER_TRACE_FILE).c_str());
+
+	ImGui::Spacing();
+}
+
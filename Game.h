@@ -7,10 +7,28 @@
 #include "SimpleShader.h"
 #include "Lights.h"
 #include "Sky.h"
+#include "ConstantBufferRing.h"
+#include "StructuredBuffer.h"
+#include "LightClusters.h"
+#include "EntityLightLists.h"
+#include "TextureCache.h"
+#include "JobGraph.h"
+#include "TextureStreaming.h"
+#include "Profiler.h"
+#include "JobSystemBenchmark.h"
+#include "FramePipeline.h"
+#include "DeferredDrawRecorder.h"
+#include "NullRenderDevice.h"
+#include "D3D11RenderDevice.h"
+#include "SoftwareRasterizer.h"
+#include "OcclusionCulling.h"
 
 #include <DirectXMath.h>
 #include <wrl/client.h>
 #include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
 
 class Game 
 	: public DXCore
@@ -26,18 +44,67 @@ public:
 	void OnResize();
 	void Update(float deltaTime, float totalTime);
 	void Draw(float deltaTime, float totalTime);
+	void FixedUpdate(float stepTime, float totalTime);
 
 private:
 
-	// Our scene
-	std::vector<std::shared_ptr<GameEntity>> entities;
+	// Our scene.  Entities are numbered in the order of their
+	// transforms, which queries led by Transform follow and
+	// per-entity arrays (like the light lists) are indexed by.
+	// Meshes and materials are kept alive here, as the
+	// entities' components only point to them.
+	EntityRegistry entities;
+	std::vector<std::shared_ptr<Mesh>> entityMeshes;
+	std::vector<std::shared_ptr<Material>> entityMaterials;
 	std::shared_ptr<Camera> camera;
 
+	// Results of timing entity systems over the registry and
+	// over the shared objects entities used to be
+	std::vector<EntityRegistryTiming> entityRegistryTimings;
+
 	// Lights
 	std::vector<Light> lights;
 	int lightCount;
 	bool showPointLights;
 
+	// Only the active lights are packed and uploaded
+	std::vector<Light> packedLights;
+	std::shared_ptr<StructuredBuffer> lightBuffer;
+	unsigned int activeLightCount;
+	double lightPackTime;	// In milliseconds
+	double lightUploadTime;	// In milliseconds
+
+	// Results of timing the light upload path at various sizes
+	struct LightUploadTiming
+	{
+		unsigned int LightCount;
+		double PackTime;	// Average milliseconds
+		double UploadTime;	// Average milliseconds
+	};
+	std::vector<LightUploadTiming> lightUploadTimings;
+
+	// Point and spot lights are assigned to view-space clusters
+	unsigned int directionalLightCount;
+	LightClusters lightClusters;
+	std::shared_ptr<StructuredBuffer> clusterGridBuffer;
+	std::shared_ptr<StructuredBuffer> clusterIndexBuffer;
+	double clusterBuildTime; // In milliseconds
+
+	// Results of validating and timing cluster assignment
+	std::vector<ClusterTiming> clusterTimings;
+
+	// Each entity's most important point and spot lights,
+	// used in place of the clusters when enabled
+	bool useEntityLightLists;
+	EntityLightLists entityLightLists;
+	double entityLightListTime; // In milliseconds
+
+	// Results of validating and timing light selection
+	std::vector<LightSelectionTiming> lightSelectionTimings;
+
+	// Results of comparing and timing the CPU lighting ports
+	std::vector<ShadingTiming> shadingTimings;
+
 	// These will be loaded along with other assets and
 	// saved to these variables for ease of access
 	std::shared_ptr<Mesh> lightMesh;
@@ -46,21 +113,196 @@ private:
 
 	// Texture related resources
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerOptions;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> clampSampler;
+
+	// Shared storage for per-draw constant data, and results
+	// of validating the allocator behind it
+	std::shared_ptr<ConstantBufferRing> constantBufferRing;
+	std::vector<ValidationResult> ringAllocatorTestResults;
+
+	// Per-frame constant buffers shared by all shaders that
+	// declare them, so they're only set and uploaded once
+	std::shared_ptr<SimpleSharedConstantBuffer> vsPerFrame;
+	std::shared_ptr<SimpleSharedConstantBuffer> psPerFrame;
+	std::shared_ptr<SimpleSharedConstantBuffer> psPerSky;
+
+	// Results of validating the shader reflection cache format
+	std::vector<ValidationResult> shaderReflectionTestResults;
+
+	// Tracks bound state to skip redundant bind calls, and
+	// results of validating it
+	std::shared_ptr<BindingFilter> bindingFilter;
+	std::vector<ValidationResult> bindingFilterTestResults;
+
+	// Loads (and cooks) block compressed material textures
+	std::shared_ptr<TextureCache> textureCache;
+
+	// Timeline of the last asset load, and the total time of
+	// the last load done each way, all in milliseconds
+	std::vector<JobTiming> assetLoadTimeline;
+	unsigned int assetLoadThreadCount;
+	double assetLoadTime;
+	double parallelAssetLoadTime;
+	double sequentialAssetLoadTime;
+
+	// Whether the last load succeeded (nothing updates or
+	// draws otherwise)
+	bool assetsLoaded;
 
-	// Skybox
+	// Requested from the UI, and done before the next update
+	bool reloadAssets;
+	bool reloadAssetsMultithreaded;
+	bool keepLoadedAssets;
+
+	// Loaded meshes, shared by everything that loads them (the
+	// texture cache has its own registry), and the assets
+	// queued so far by the current load, by registry key
+	AssetRegistry<std::shared_ptr<Mesh>> meshRegistry;
+	std::unordered_map<std::wstring, JobGraph::Job> queuedAssetLoads;
+
+	// Have the frame stats been saved as CSV?
+	bool frameStatsSaved;
+
+	// The frame shown by the profiler (kept while frozen), and
+	// the span of the last asset load, in profiler time
+	std::vector<ProfileThreadEvents> profiledFrame;
+	unsigned long long profiledFrameStart;
+	unsigned long long profiledFrameEnd;
+	bool freezeProfiler;
+	unsigned long long assetLoadTraceStart;
+	unsigned long long assetLoadTraceEnd;
+	const char* profilerTraceSaved;		// What was saved last, if anything
+
+	// Simulation, stepped at a fixed rate or once per frame
+	bool animateScene;
+	float simulationStepCost;	// Extra milliseconds of busy work per step
+
+	// Optionally, the simulation runs on a thread of its own,
+	// a frame ahead of drawing.  It keeps its own copy of the
+	// scene, and hands over a snapshot of it for each frame,
+	// which the render thread holds until the frame is drawn.
+	struct SimulationSnapshot
+	{
+		std::vector<Transform> Transforms;	// Per entity, with the step before
+		std::vector<Light> Lights;			// Only the ones in use
+		float Interpolation = 0;
+		double SimulatedTime = 0;			// Seconds
+		double SimulationTime = 0;			// Milliseconds to make the snapshot
+	};
+	FramePipeline<SimulationSnapshot> simulationPipeline;
+	std::thread simulationThread;
+	std::vector<Transform> simulatedTransforms;	// Only used by the thread
+	std::vector<Light> simulatedLights;
+	std::atomic<unsigned int> simulationLightCount;	// Settings, from the UI
+	std::atomic<bool> simulationAnimate;
+	std::atomic<float> simulationCost;
+	const SimulationSnapshot* currentSnapshot;	// Held until drawn
+	bool simulateOnThread;
+	std::vector<FramePipelineTiming> framePipelineTimings;
+
+	// Recording entity draws on deferred contexts across threads,
+	// results of validating the scheduling against a mock, and
+	// timings of submitting to a null render device
+	std::shared_ptr<DeferredDrawRecorder> deferredDraws;
+	bool recordDrawsInParallel;
+	int deferredDrawMinBatchSize;
+	std::vector<ValidationResult> commandRecordingTestResults;
+	std::vector<RenderSubmissionTiming> renderSubmissionTimings;
+
+	// Where all shader binds and draws go, and whether the next
+	// frame is first captured on a null device and timed
+	std::shared_ptr<D3D11RenderDevice> renderDevice;
+	bool captureSceneSubmission;
+
+	// Results of testing and timing the job system
+	std::vector<ValidationResult> jobSystemTestResults;
+	std::vector<JobSystemBenchmarkTiming> jobSystemTimings;
+
+	// Whether assets come from the asset pack, and results of
+	// timing reads from it
+	bool useAssetPack;
+	bool compressAssetPack;
+	std::vector<AssetReadTiming> assetReadTimings;
+
+	// Streams texture mips based on what the camera sees
+	std::shared_ptr<TextureStreamer> textureStreamer;
+	bool useTextureStreaming;
+	int textureStreamingBudget;		// Megabytes
+	double textureStreamingTime;	// Milliseconds, including feedback
+
+	// Results of simulating the streaming policy
+	std::vector<TextureStreamingResult> textureStreamingResults;
+
+	// Skybox, which also provides image based lighting
 	std::shared_ptr<Sky> sky;
+	float iblIntensity;
+
+	// Results of timing the IBL bake at various resolutions
+	std::vector<IBLTiming> iblTimings;
+
+	// Rendering the PBR entities on the CPU, for comparing against
+	// a golden image, and results of timing a test scene.  The
+	// scene keeps its meshes and textures (indexed by asset name)
+	// between renders.
+	std::unordered_map<Material*, std::wstring> softwareTextureSets;	// Asset name of each PBR material's textures
+	std::unordered_map<Mesh*, std::wstring> softwareMeshFiles;
+	std::unordered_map<std::wstring, int> softwareAssetIndices;		// -1 if it failed to load
+	std::shared_ptr<SoftwareScene> softwareScene;
+	SoftwareRasterizer softwareRasterizer;
+	double softwareRenderTime;			// Milliseconds, including loading
+	std::string softwareRenderResult;	// Of comparing with the golden image
+	std::vector<SoftwareRasterizerTiming> softwareRasterizerTimings;
+
+	// Skipping entities hidden behind others, using boxes inside
+	// the solid meshes as occluders, and results of timing a
+	// test scene
+	bool useOcclusionCulling;
+	std::unordered_map<Mesh*, OcclusionMesh> occluderMeshes;
+	OcclusionBuffer occlusionBuffer;
+	std::vector<OcclusionOccluder> occluders;
+	std::vector<OcclusionBounds> entityBounds;
+	std::vector<unsigned char> entityOcclusion;		// OCCLUSION_ result for each entity
+	double occlusionCullingTime;					// Milliseconds
+	std::vector<OcclusionCullingTiming> occlusionCullingTimings;
 
 	// General helpers for setup and drawing
-	void LoadAssetsAndCreateEntities();
+	bool LoadAssetsAndCreateEntities(bool multithreaded);
+	Entity CreateEntity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material);
+	void UpdateEntityBounds();
+	JobGraph::Job QueueMeshLoad(JobGraph& graph, const std::wstring& file, std::shared_ptr<Mesh>* mesh);
+	JobGraph::Job QueueTextureLoad(JobGraph& graph, const std::wstring& file, unsigned int format, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* srv);
+	JobGraph::Job QueuePackedTextureLoad(JobGraph& graph, const std::wstring& roughnessFile, const std::wstring& metalFile, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* srv);
 	void GenerateLights();
-	void DrawPointLights();
+	void AddLights(unsigned int count);
+	void UploadLights();
+	void RunLightUploadBenchmark();
+	void BuildLightClusters();
+	void UpdateEntityLightLists();
+	void SetEntityLights(unsigned int index, Material* material);
+	void RenderSoftwareFrame(bool saveAsGolden);
+	void UpdateOcclusionCulling(float interpolation);
+	void UpdateAssetPack(bool rebuild);
+	void UpdateTextureStreaming();
+	bool SaveProfilerTrace(unsigned long long start, unsigned long long end);
+	ClusterFrustum GetClusterFrustum();
+	void SimulateEntities(float deltaTime);
+	void SavePreviousEntityStates();
+	void StartSimulationThread();
+	void StopSimulationThread();
+	void SimulationThreadLoop(double stepTime, unsigned int maxSteps);
+	void ApplySimulationSnapshot();
+	unsigned int DrawScene(IRenderDevice* drawDevice, float interpolation, bool recordInParallel);
+	void CaptureSceneSubmission(float interpolation);
+	void SetShaderRenderDevice(std::shared_ptr<IRenderDevice> device);
+	unsigned int DrawPointLights(IRenderDevice* drawDevice);
 
 	// UI functions
 	void UINewFrame(float deltaTime);
 	void BuildUI();
 	void CameraUI(std::shared_ptr<Camera> cam);
-	void EntityUI(std::shared_ptr<GameEntity> entity);	
+	void EntityUI(Entity entity);
 	void LightUI(Light& light);
+	void ProfilerUI();
 	
 	// Should the ImGui demo window be shown?
 	bool showUIDemoWindow;
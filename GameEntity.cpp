@@ -1,26 +1,46 @@
 #include "GameEntity.h"
 
+#include <algorithm>
+#include <math.h>
+
 using namespace DirectX;
 
-GameEntity::GameEntity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material) :
-	mesh(mesh),
-	material(material)
+// Mesh bounds moved into world space, with the radius grown
+// to cover the largest scale (as rotation could face any way)
+DirectX::XMFLOAT4 GetWorldBoundingSphere(Transform& transform, Mesh* mesh)
 {
-}
+	XMFLOAT4 local = mesh->GetBoundingSphere();
+	XMFLOAT4X4 world = transform.GetWorldMatrix();
+	XMFLOAT3 scale = transform.GetScale();
 
-std::shared_ptr<Mesh> GameEntity::GetMesh() { return mesh; }
-std::shared_ptr<Material> GameEntity::GetMaterial() { return material; }
-Transform* GameEntity::GetTransform() { return &transform; }
-
-void GameEntity::SetMesh(std::shared_ptr<Mesh> mesh) { this->mesh = mesh; }
-void GameEntity::SetMaterial(std::shared_ptr<Material> material) { this->material = material; }
+	XMFLOAT4 sphere;
+	XMStoreFloat4(&sphere, XMVector3Transform(XMVectorSet(local.x, local.y, local.z, 1), XMLoadFloat4x4(&world)));
+	sphere.w = local.w * (std::max)(fabsf(scale.x), (std::max)(fabsf(scale.y), fabsf(scale.z)));
+	return sphere;
+}
 
 
-void GameEntity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera)
+void DrawEntity(
+	IRenderDevice* device,
+	std::shared_ptr<Camera> camera,
+	Transform& transform,
+	Mesh* mesh,
+	Material* material,
+	float interpolation)
 {
-	// Set up the material (shaders)
-	material->PrepareMaterial(&transform, camera);
+	// Set up the material (shaders), placing the entity partway
+	// between its last two simulation steps if asked
+	if (interpolation < 1.0f)
+	{
+		Transform drawn;
+		transform.Interpolate(interpolation, &drawn);
+		material->PrepareMaterial(&drawn, camera);
+	}
+	else
+	{
+		material->PrepareMaterial(&transform, camera);
+	}
 
 	// Draw the mesh
-	mesh->SetBuffersAndDraw(context);
+	mesh->SetBuffersAndDraw(device);
 }
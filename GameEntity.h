@@ -3,29 +3,44 @@
 #include <wrl/client.h>
 #include <DirectXMath.h>
 #include <memory>
+#include "EntityRegistry.h"
 #include "Mesh.h"
 #include "Transform.h"
 #include "Camera.h"
 #include "Material.h"
 
-class GameEntity
+// --------------------------------------------------------
+// Components of the game's entities, along with Transform,
+// each kept in its own array by an EntityRegistry.  Meshes
+// and materials are pointed to without being owned, so
+// going through entities never touches reference counts;
+// whatever makes entities keeps what they use alive.
+// --------------------------------------------------------
+struct MeshRef
 {
-public:
-	GameEntity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material);
-
-	std::shared_ptr<Mesh> GetMesh();
-	std::shared_ptr<Material> GetMaterial();
-	Transform* GetTransform();
-
-	void SetMesh(std::shared_ptr<Mesh> mesh);
-	void SetMaterial(std::shared_ptr<Material> material);
-
-	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera);
+	Mesh* Asset;
+};
 
-private:
+struct MaterialRef
+{
+	Material* Asset;
+};
 
-	std::shared_ptr<Mesh> mesh;
-	std::shared_ptr<Material> material;
-	Transform transform;
+struct Bounds
+{
+	DirectX::XMFLOAT4 Sphere;	// World space
 };
 
+// Mesh bounds moved into world space, with the radius grown
+// to cover the largest scale (as rotation could face any way)
+DirectX::XMFLOAT4 GetWorldBoundingSphere(Transform& transform, Mesh* mesh);
+
+// Draws a mesh with a material, placed partway between its
+// last two simulation steps if asked
+void DrawEntity(
+	IRenderDevice* device,
+	std::shared_ptr<Camera> camera,
+	Transform& transform,
+	Mesh* mesh,
+	Material* material,
+	float interpolation = 1.0f);
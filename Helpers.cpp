@@ -20,8 +20,10 @@
 //    that option is stored in a user file (.suo), which is ignored by most
 //    version control packages by default.  Meaning: the option must be
 //    changed on every PC.  Ugh.  So instead, here's a helper.
+// - The executable never moves while it runs, so the path is only
+//    looked up the first time and remembered after that.
 // --------------------------------------------------------------------------
-std::wstring GetExePath()
+static std::wstring FindExePath()
 {
 	// Assume the path is just the "current directory" for now
 	std::wstring path = L".\\";
@@ -48,6 +50,13 @@ std::wstring GetExePath()
 	return path;
 }
 
+std::wstring GetExePath()
+{
+	// Initialized once, even with several threads asking at once
+	static const std::wstring path = FindExePath();
+	return path;
+}
+
 
 // ----------------------------------------------------
 //  Fixes a relative path so that it is consistently
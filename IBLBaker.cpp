@@ -0,0 +1,689 @@
+#include "IBLBaker.h"
+#include "AssetRegistry.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+using namespace DirectX;
+
+#define IBL_PI	3.14159265359f
+
+// === CUBE MAP HELPERS =============================================
+
+// --------------------------------------------------------
+// Direction through a point on a face, where s and t are
+// -1 to 1 across and down the face (D3D's cube layout)
+// --------------------------------------------------------
+static XMFLOAT3 FaceDirection(unsigned int face, float s, float t)
+{
+	XMFLOAT3 dir;
+	switch (face)
+	{
+	case 0: dir = XMFLOAT3(1, -t, -s); break;
+	case 1: dir = XMFLOAT3(-1, -t, s); break;
+	case 2: dir = XMFLOAT3(s, 1, t); break;
+	case 3: dir = XMFLOAT3(s, -1, -t); break;
+	case 4: dir = XMFLOAT3(s, -t, 1); break;
+	default: dir = XMFLOAT3(-s, -t, -1); break;
+	}
+
+	float invLength = 1.0f / sqrtf(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z);
+	return XMFLOAT3(dir.x * invLength, dir.y * invLength, dir.z * invLength);
+}
+
+// --------------------------------------------------------
+// The face (and position on it) a direction points at,
+// the inverse of FaceDirection()
+// --------------------------------------------------------
+static void DirectionToFace(XMFLOAT3 dir, unsigned int* face, float* s, float* t)
+{
+	float ax = fabsf(dir.x);
+	float ay = fabsf(dir.y);
+	float az = fabsf(dir.z);
+
+	if (ax >= ay && ax >= az)
+	{
+		*face = dir.x > 0 ? 0 : 1;
+		*s = (dir.x > 0 ? -dir.z : dir.z) / ax;
+		*t = -dir.y / ax;
+	}
+	else if (ay >= az)
+	{
+		*face = dir.y > 0 ? 2 : 3;
+		*s = dir.x / ay;
+		*t = (dir.y > 0 ? dir.z : -dir.z) / ay;
+	}
+	else
+	{
+		*face = dir.z > 0 ? 4 : 5;
+		*s = (dir.z > 0 ? dir.x : -dir.x) / az;
+		*t = -dir.y / az;
+	}
+}
+
+// --------------------------------------------------------
+// Bilinear sample of a cube map in a direction (clamped at
+// face edges, which is invisible at these resolutions)
+// --------------------------------------------------------
+XMFLOAT4 SampleIBLCubemap(const IBLCubemap& cube, XMFLOAT3 dir)
+{
+	unsigned int face;
+	float s, t;
+	DirectionToFace(dir, &face, &s, &t);
+
+	// Texel space, with centers on whole numbers
+	float maxCoord = (float)(cube.Size - 1);
+	float x = fminf(fmaxf((s * 0.5f + 0.5f) * cube.Size - 0.5f, 0.0f), maxCoord);
+	float y = fminf(fmaxf((t * 0.5f + 0.5f) * cube.Size - 0.5f, 0.0f), maxCoord);
+
+	unsigned int x0 = (unsigned int)x;
+	unsigned int y0 = (unsigned int)y;
+	unsigned int x1 = x0 + 1 < cube.Size ? x0 + 1 : x0;
+	unsigned int y1 = y0 + 1 < cube.Size ? y0 + 1 : y0;
+	float fx = x - x0;
+	float fy = y - y0;
+
+	const XMFLOAT4* texels = &cube.Texels[face * cube.Size * cube.Size];
+	XMVECTOR top = XMVectorLerp(XMLoadFloat4(&texels[y0 * cube.Size + x0]), XMLoadFloat4(&texels[y0 * cube.Size + x1]), fx);
+	XMVECTOR bottom = XMVectorLerp(XMLoadFloat4(&texels[y1 * cube.Size + x0]), XMLoadFloat4(&texels[y1 * cube.Size + x1]), fx);
+
+	XMFLOAT4 result;
+	XMStoreFloat4(&result, XMVectorLerp(top, bottom, fy));
+	return result;
+}
+
+// --------------------------------------------------------
+// Trilinear sample across a chain of cube map mips
+// --------------------------------------------------------
+XMFLOAT4 SampleIBLCubemapLevel(const std::vector<IBLCubemap>& mips, XMFLOAT3 dir, float level)
+{
+	level = fminf(fmaxf(level, 0.0f), (float)(mips.size() - 1));
+	unsigned int level0 = (unsigned int)level;
+	unsigned int level1 = level0 + 1 < mips.size() ? level0 + 1 : level0;
+
+	XMFLOAT4 a = SampleIBLCubemap(mips[level0], dir);
+	if (level1 == level0)
+		return a;
+
+	XMFLOAT4 b = SampleIBLCubemap(mips[level1], dir);
+	XMFLOAT4 result;
+	XMStoreFloat4(&result, XMVectorLerp(XMLoadFloat4(&a), XMLoadFloat4(&b), level - level0));
+	return result;
+}
+
+// --------------------------------------------------------
+// Solid angle covered by a single texel of a face
+// --------------------------------------------------------
+static float AreaElement(float x, float y)
+{
+	return atan2f(x * y, sqrtf(x * x + y * y + 1));
+}
+
+static float TexelSolidAngle(unsigned int x, unsigned int y, unsigned int size)
+{
+	float invSize = 1.0f / size;
+	float x0 = (2.0f * x) * invSize - 1.0f;
+	float y0 = (2.0f * y) * invSize - 1.0f;
+	float x1 = x0 + 2.0f * invSize;
+	float y1 = y0 + 2.0f * invSize;
+	return AreaElement(x0, y0) - AreaElement(x0, y1) - AreaElement(x1, y0) + AreaElement(x1, y1);
+}
+
+// --------------------------------------------------------
+// Halves a cube map with a 2x2 box filter
+// --------------------------------------------------------
+static void DownsampleCube(const IBLCubemap& source, IBLCubemap* dest)
+{
+	dest->Size = source.Size / 2;
+	dest->Texels.resize(6 * dest->Size * dest->Size);
+
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		const XMFLOAT4* src = &source.Texels[face * source.Size * source.Size];
+		XMFLOAT4* dst = &dest->Texels[face * dest->Size * dest->Size];
+		for (unsigned int y = 0; y < dest->Size; y++)
+		{
+			for (unsigned int x = 0; x < dest->Size; x++)
+			{
+				XMVECTOR sum =
+					XMLoadFloat4(&src[(y * 2) * source.Size + x * 2]) +
+					XMLoadFloat4(&src[(y * 2) * source.Size + x * 2 + 1]) +
+					XMLoadFloat4(&src[(y * 2 + 1) * source.Size + x * 2]) +
+					XMLoadFloat4(&src[(y * 2 + 1) * source.Size + x * 2 + 1]);
+				XMStoreFloat4(&dst[y * dest->Size + x], sum * 0.25f);
+			}
+		}
+	}
+}
+
+
+// === SAMPLING HELPERS =============================================
+
+// --------------------------------------------------------
+// Point i of n in the Hammersley sequence, giving the same
+// well spread sample positions on every bake
+// --------------------------------------------------------
+static XMFLOAT2 Hammersley(unsigned int i, unsigned int n)
+{
+	unsigned int bits = i;
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return XMFLOAT2((float)i / n, bits * 2.3283064365386963e-10f);
+}
+
+// --------------------------------------------------------
+// A half vector around the normal, distributed by the GGX
+// lobe of the given roughness (squared, as in the shader)
+// --------------------------------------------------------
+static XMVECTOR ImportanceSampleGGX(XMFLOAT2 xi, XMVECTOR n, float roughness)
+{
+	float a = roughness * roughness;
+	float phi = 2.0f * IBL_PI * xi.x;
+	float cosTheta = sqrtf((1.0f - xi.y) / (1.0f + (a * a - 1.0f) * xi.y));
+	float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+
+	// Tangent space around the normal
+	XMVECTOR up = fabsf(XMVectorGetZ(n)) < 0.999f ? XMVectorSet(0, 0, 1, 0) : XMVectorSet(1, 0, 0, 0);
+	XMVECTOR tangentX = XMVector3Normalize(XMVector3Cross(up, n));
+	XMVECTOR tangentY = XMVector3Cross(n, tangentX);
+
+	return XMVector3Normalize(
+		tangentX * (sinTheta * cosf(phi)) +
+		tangentY * (sinTheta * sinf(phi)) +
+		n * cosTheta);
+}
+
+// GGX normal distribution, matching SpecDistribution() in Lighting.hlsli
+static float DistributionGGX(float NdotH, float roughness)
+{
+	float a = roughness * roughness;
+	float a2 = fmaxf(a * a, 0.0000001f);
+	float denom = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+	return a2 / (IBL_PI * denom * denom);
+}
+
+
+// === BAKING =======================================================
+
+// --------------------------------------------------------
+// Converts one 8-bit face image into the source cube map,
+// averaging blocks of pixels down to the source's size
+//
+// pixels   - The face's pixel data
+// size     - Width and height of the face, in pixels
+// rowPitch - Bytes from one row to the next
+// bgra     - Whether channels are in BGRA (not RGBA) order
+// face     - Which face (0 - 5) this is
+// source   - Cube map to fill (Size must already be set)
+// --------------------------------------------------------
+void DownsampleIBLFace(
+	const unsigned char* pixels,
+	unsigned int size,
+	unsigned int rowPitch,
+	bool bgra,
+	unsigned int face,
+	IBLCubemap* source)
+{
+	if (source->Texels.size() != 6 * source->Size * source->Size)
+		source->Texels.resize(6 * source->Size * source->Size);
+
+	// Gamma 2.2 back to linear, as the shaders do
+	float toLinear[256];
+	for (int i = 0; i < 256; i++)
+		toLinear[i] = powf(i / 255.0f, 2.2f);
+
+	unsigned int r = bgra ? 2 : 0;
+	unsigned int b = bgra ? 0 : 2;
+	XMFLOAT4* dest = &source->Texels[face * source->Size * source->Size];
+
+	for (unsigned int y = 0; y < source->Size; y++)
+	{
+		unsigned int startY = y * size / source->Size;
+		unsigned int endY = (std::max)((y + 1) * size / source->Size, startY + 1);
+		for (unsigned int x = 0; x < source->Size; x++)
+		{
+			unsigned int startX = x * size / source->Size;
+			unsigned int endX = (std::max)((x + 1) * size / source->Size, startX + 1);
+
+			// Average this block
+			XMFLOAT4 sum(0, 0, 0, 0);
+			for (unsigned int py = startY; py < endY; py++)
+			{
+				const unsigned char* row = pixels + py * rowPitch;
+				for (unsigned int px = startX; px < endX; px++)
+				{
+					const unsigned char* p = row + px * 4;
+					sum.x += toLinear[p[r]];
+					sum.y += toLinear[p[1]];
+					sum.z += toLinear[p[b]];
+				}
+			}
+
+			float invCount = 1.0f / ((endX - startX) * (endY - startY));
+			dest[y * source->Size + x] = XMFLOAT4(sum.x * invCount, sum.y * invCount, sum.z * invCount, 1.0f);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Hashes the source texels and bake settings, the same way
+// as every other asset
+// --------------------------------------------------------
+unsigned long long HashIBLSource(const IBLCubemap& source, const IBLBakeSettings& settings)
+{
+	unsigned int values[] = {
+		source.Size,
+		settings.SourceSize,
+		settings.SpecularSize,
+		settings.SpecularMipCount,
+		settings.SpecularSamples,
+		settings.BRDFLUTSize,
+		settings.BRDFSamples };
+	unsigned long long hash = HashAssetData(values, sizeof(values));
+	if (!source.Texels.empty())
+		hash = HashAssetData(&source.Texels[0], source.Texels.size() * sizeof(XMFLOAT4), hash);
+
+	return hash;
+}
+
+// --------------------------------------------------------
+// Projects the sky onto 9 SH coefficients, then convolves
+// them with the cosine lobe for irradiance.  Each row is
+// summed separately and the rows are then added in order,
+// so the result doesn't depend on the thread count.
+// --------------------------------------------------------
+static void BakeIrradianceSH(const IBLCubemap& source, IBLData* data, bool multithreaded)
+{
+	unsigned int rowCount = 6 * source.Size;
+	std::vector<XMFLOAT3> rowSums(rowCount * IBL_SH_COEFFICIENTS, XMFLOAT3(0, 0, 0));
+
+	auto projectRows = [&](unsigned int start, unsigned int end)
+	{
+		for (unsigned int row = start; row < end; row++)
+		{
+			unsigned int face = row / source.Size;
+			unsigned int y = row % source.Size;
+			XMFLOAT3* sums = &rowSums[row * IBL_SH_COEFFICIENTS];
+
+			for (unsigned int x = 0; x < source.Size; x++)
+			{
+				XMFLOAT3 n = FaceDirection(face, (x + 0.5f) / source.Size * 2.0f - 1.0f, (y + 0.5f) / source.Size * 2.0f - 1.0f);
+				const XMFLOAT4& color = source.Texels[row * source.Size + x];
+				float weight = TexelSolidAngle(x, y, source.Size);
+
+				float basis[IBL_SH_COEFFICIENTS] = {
+					0.282095f,
+					0.488603f * n.y,
+					0.488603f * n.z,
+					0.488603f * n.x,
+					1.092548f * n.x * n.y,
+					1.092548f * n.y * n.z,
+					0.315392f * (3.0f * n.z * n.z - 1.0f),
+					1.092548f * n.x * n.z,
+					0.546274f * (n.x * n.x - n.y * n.y) };
+
+				for (unsigned int i = 0; i < IBL_SH_COEFFICIENTS; i++)
+				{
+					float w = basis[i] * weight;
+					sums[i].x += color.x * w;
+					sums[i].y += color.y * w;
+					sums[i].z += color.z * w;
+				}
+			}
+		}
+	};
+
+	if (multithreaded)
+		ParallelFor(rowCount, projectRows);
+	else
+		projectRows(0, rowCount);
+
+	// Cosine lobe convolution per band (pi, 2pi/3, pi/4),
+	// then divided by pi for outgoing diffuse light
+	const float bandScale[IBL_SH_COEFFICIENTS] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+	for (unsigned int i = 0; i < IBL_SH_COEFFICIENTS; i++)
+	{
+		XMFLOAT3 total(0, 0, 0);
+		for (unsigned int row = 0; row < rowCount; row++)
+		{
+			total.x += rowSums[row * IBL_SH_COEFFICIENTS + i].x;
+			total.y += rowSums[row * IBL_SH_COEFFICIENTS + i].y;
+			total.z += rowSums[row * IBL_SH_COEFFICIENTS + i].z;
+		}
+		data->IrradianceSH[i] = XMFLOAT3(total.x * bandScale[i], total.y * bandScale[i], total.z * bandScale[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Convolves the sky with the GGX lobe for each mip's
+// roughness, assuming the view and normal match the
+// reflection direction.  Samples read from a lower mip
+// of the source the less likely they are ("filtered
+// importance sampling"), avoiding noise at low counts.
+// --------------------------------------------------------
+static void BakeSpecular(const IBLCubemap& source, const IBLBakeSettings& settings, IBLData* data, bool multithreaded)
+{
+	// Box filtered chain of the source for sampling
+	std::vector<IBLCubemap> sourceMips(1, source);
+	while (sourceMips.back().Size > 1)
+	{
+		IBLCubemap smaller;
+		DownsampleCube(sourceMips.back(), &smaller);
+		sourceMips.push_back(smaller);
+	}
+
+	float texelSolidAngle = 4.0f * IBL_PI / (6.0f * source.Size * source.Size);
+	unsigned int mipCount = settings.SpecularMipCount > 0 ? settings.SpecularMipCount : 1;
+
+	data->SpecularMips.resize(mipCount);
+	for (unsigned int mip = 0; mip < mipCount; mip++)
+	{
+		IBLCubemap& dest = data->SpecularMips[mip];
+		dest.Size = (std::max)(settings.SpecularSize >> mip, 1u);
+		dest.Texels.resize(6 * dest.Size * dest.Size);
+
+		float roughness = mipCount > 1 ? (float)mip / (mipCount - 1) : 0.0f;
+		unsigned int texelsPerFace = dest.Size * dest.Size;
+
+		auto filterTexels = [&](unsigned int start, unsigned int end)
+		{
+			for (unsigned int i = start; i < end; i++)
+			{
+				unsigned int face = i / texelsPerFace;
+				unsigned int x = i % dest.Size;
+				unsigned int y = (i % texelsPerFace) / dest.Size;
+				XMFLOAT3 dir = FaceDirection(face, (x + 0.5f) / dest.Size * 2.0f - 1.0f, (y + 0.5f) / dest.Size * 2.0f - 1.0f);
+
+				// A perfect mirror is just the sky itself
+				if (mip == 0 || roughness == 0.0f)
+				{
+					dest.Texels[i] = SampleIBLCubemapLevel(sourceMips, dir, 0.0f);
+					continue;
+				}
+
+				XMVECTOR n = XMLoadFloat3(&dir);
+				XMVECTOR total = XMVectorZero();
+				float totalWeight = 0.0f;
+
+				for (unsigned int s = 0; s < settings.SpecularSamples; s++)
+				{
+					XMVECTOR h = ImportanceSampleGGX(Hammersley(s, settings.SpecularSamples), n, roughness);
+					float NdotH = XMVectorGetX(XMVector3Dot(n, h));
+					XMVECTOR l = 2.0f * NdotH * h - n;
+
+					float NdotL = XMVectorGetX(XMVector3Dot(n, l));
+					if (NdotL <= 0.0f)
+						continue;
+
+					// With N == V the pdf simplifies to D / 4
+					float pdf = DistributionGGX(NdotH, roughness) * 0.25f;
+					float sampleSolidAngle = 1.0f / (settings.SpecularSamples * pdf + 0.0001f);
+					float level = 0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1.0f;
+
+					XMFLOAT3 sampleDir;
+					XMStoreFloat3(&sampleDir, l);
+					XMFLOAT4 color = SampleIBLCubemapLevel(sourceMips, sampleDir, level);
+
+					total += XMLoadFloat4(&color) * NdotL;
+					totalWeight += NdotL;
+				}
+
+				XMStoreFloat4(&dest.Texels[i], XMVectorSetW(total / (std::max)(totalWeight, 0.0001f), 1.0f));
+			}
+		};
+
+		if (multithreaded)
+			ParallelFor((unsigned int)dest.Texels.size(), filterTexels);
+		else
+			filterTexels(0, (unsigned int)dest.Texels.size());
+	}
+}
+
+// --------------------------------------------------------
+// Integrates the split-sum BRDF for every combination of
+// view angle and roughness, using the IBL form of the
+// Schlick-GGX geometry term (k = a / 2)
+// --------------------------------------------------------
+static void BakeBRDFLUT(const IBLBakeSettings& settings, IBLData* data, bool multithreaded)
+{
+	unsigned int size = settings.BRDFLUTSize;
+	data->BRDFLUTSize = size;
+	data->BRDFLUT.resize(size * size);
+
+	auto integrateRows = [&](unsigned int start, unsigned int end)
+	{
+		for (unsigned int y = start; y < end; y++)
+		{
+			float roughness = (y + 0.5f) / size;
+			float a = roughness * roughness;
+			float k = a / 2.0f;
+
+			for (unsigned int x = 0; x < size; x++)
+			{
+				float NdotV = (x + 0.5f) / size;
+				XMVECTOR n = XMVectorSet(0, 0, 1, 0);
+				XMVECTOR v = XMVectorSet(sqrtf(1.0f - NdotV * NdotV), 0, NdotV, 0);
+
+				float scale = 0.0f;
+				float bias = 0.0f;
+				for (unsigned int s = 0; s < settings.BRDFSamples; s++)
+				{
+					XMVECTOR h = ImportanceSampleGGX(Hammersley(s, settings.BRDFSamples), n, roughness);
+					float VdotH = XMVectorGetX(XMVector3Dot(v, h));
+					XMVECTOR l = 2.0f * VdotH * h - v;
+
+					float NdotL = XMVectorGetZ(l);
+					float NdotH = XMVectorGetZ(h);
+					VdotH = fmaxf(VdotH, 0.0f);
+					if (NdotL <= 0.0f)
+						continue;
+
+					float G = (NdotV / (NdotV * (1.0f - k) + k)) * (NdotL / (NdotL * (1.0f - k) + k));
+					float visibility = G * VdotH / (NdotH * NdotV);
+					float fresnel = powf(1.0f - VdotH, 5.0f);
+
+					scale += (1.0f - fresnel) * visibility;
+					bias += fresnel * visibility;
+				}
+
+				data->BRDFLUT[y * size + x] = XMFLOAT2(scale / settings.BRDFSamples, bias / settings.BRDFSamples);
+			}
+		}
+	};
+
+	if (multithreaded)
+		ParallelFor(size, integrateRows);
+	else
+		integrateRows(0, size);
+}
+
+// --------------------------------------------------------
+// Bakes the irradiance SH, the prefiltered specular mips
+// and the BRDF look up table
+//
+// source        - The sky, in linear color
+// settings      - Resolutions and sample counts
+// data          - Receives the results
+// timings       - Receives the time of each step (optional)
+// multithreaded - Whether to use more than this thread
+// --------------------------------------------------------
+void BakeIBL(
+	const IBLCubemap& source,
+	const IBLBakeSettings& settings,
+	IBLData* data,
+	IBLBakeTimings* timings,
+	bool multithreaded)
+{
+	data->Hash = HashIBLSource(source, settings);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	BakeIrradianceSH(source, data, multithreaded);
+	auto specularStart = std::chrono::high_resolution_clock::now();
+	BakeSpecular(source, settings, data, multithreaded);
+	auto brdfStart = std::chrono::high_resolution_clock::now();
+	BakeBRDFLUT(settings, data, multithreaded);
+	auto end = std::chrono::high_resolution_clock::now();
+
+	if (timings)
+	{
+		timings->Irradiance = std::chrono::duration<double, std::milli>(specularStart - start).count();
+		timings->Specular = std::chrono::duration<double, std::milli>(brdfStart - specularStart).count();
+		timings->BRDFLUT = std::chrono::duration<double, std::milli>(end - brdfStart).count();
+	}
+}
+
+
+// === CACHE FORMAT =================================================
+
+// Appends raw bytes to the cache data
+static void WriteBytes(std::vector<unsigned char>& bytes, const void* data, size_t size)
+{
+	const unsigned char* raw = (const unsigned char*)data;
+	bytes.insert(bytes.end(), raw, raw + size);
+}
+
+// Reads raw bytes, failing (and staying failed) at the end
+static bool ReadBytes(const unsigned char* bytes, size_t size, size_t* position, void* dest, size_t count)
+{
+	if (count > size - *position)
+	{
+		*position = size + 1; // Poison any further reads
+		return false;
+	}
+
+	memcpy(dest, bytes + *position, count);
+	*position += count;
+	return true;
+}
+
+// --------------------------------------------------------
+// Writes baked data into the binary cache format:
+//  magic, version, hash, SH, mip count, then each mip's
+//  size and texels, then the LUT size and texels
+// --------------------------------------------------------
+void SerializeIBL(const IBLData& data, std::vector<unsigned char>& bytes)
+{
+	bytes.clear();
+
+	unsigned int header[] = { IBL_CACHE_MAGIC, IBL_CACHE_VERSION };
+	WriteBytes(bytes, header, sizeof(header));
+	WriteBytes(bytes, &data.Hash, sizeof(data.Hash));
+	WriteBytes(bytes, data.IrradianceSH, sizeof(data.IrradianceSH));
+
+	unsigned int mipCount = (unsigned int)data.SpecularMips.size();
+	WriteBytes(bytes, &mipCount, sizeof(mipCount));
+	for (auto& mip : data.SpecularMips)
+	{
+		WriteBytes(bytes, &mip.Size, sizeof(mip.Size));
+		if (!mip.Texels.empty())
+			WriteBytes(bytes, &mip.Texels[0], mip.Texels.size() * sizeof(XMFLOAT4));
+	}
+
+	WriteBytes(bytes, &data.BRDFLUTSize, sizeof(data.BRDFLUTSize));
+	if (!data.BRDFLUT.empty())
+		WriteBytes(bytes, &data.BRDFLUT[0], data.BRDFLUT.size() * sizeof(XMFLOAT2));
+}
+
+// --------------------------------------------------------
+// Reads baked data from the binary cache format
+//
+// Returns false (leaving data untouched) if the bytes are
+// truncated, corrupt or from a different version
+// --------------------------------------------------------
+bool DeserializeIBL(const unsigned char* bytes, size_t size, IBLData* data)
+{
+	if (bytes == 0)
+		return false;
+
+	size_t position = 0;
+	unsigned int header[2] = {};
+	if (!ReadBytes(bytes, size, &position, header, sizeof(header)) ||
+		header[0] != IBL_CACHE_MAGIC ||
+		header[1] != IBL_CACHE_VERSION)
+		return false;
+
+	IBLData result;
+	unsigned int mipCount = 0;
+	if (!ReadBytes(bytes, size, &position, &result.Hash, sizeof(result.Hash)) ||
+		!ReadBytes(bytes, size, &position, result.IrradianceSH, sizeof(result.IrradianceSH)) ||
+		!ReadBytes(bytes, size, &position, &mipCount, sizeof(mipCount)) ||
+		mipCount > 16)
+		return false;
+
+	result.SpecularMips.resize(mipCount);
+	for (auto& mip : result.SpecularMips)
+	{
+		// Reject sizes that couldn't fit in the remaining bytes
+		if (!ReadBytes(bytes, size, &position, &mip.Size, sizeof(mip.Size)) ||
+			(unsigned long long)mip.Size * mip.Size * 6 * sizeof(XMFLOAT4) > size - position)
+			return false;
+
+		mip.Texels.resize(6 * mip.Size * mip.Size);
+		if (!mip.Texels.empty() && !ReadBytes(bytes, size, &position, &mip.Texels[0], mip.Texels.size() * sizeof(XMFLOAT4)))
+			return false;
+	}
+
+	if (!ReadBytes(bytes, size, &position, &result.BRDFLUTSize, sizeof(result.BRDFLUTSize)) ||
+		(unsigned long long)result.BRDFLUTSize * result.BRDFLUTSize * sizeof(XMFLOAT2) != size - position)
+		return false;
+
+	result.BRDFLUT.resize(result.BRDFLUTSize * result.BRDFLUTSize);
+	if (!result.BRDFLUT.empty() && !ReadBytes(bytes, size, &position, &result.BRDFLUT[0], result.BRDFLUT.size() * sizeof(XMFLOAT2)))
+		return false;
+
+	*data = result;
+	return true;
+}
+
+
+// === BENCHMARK ====================================================
+
+// --------------------------------------------------------
+// Bakes IBL at increasing resolutions, timing each step,
+// and checks that a single-threaded bake gives exactly the
+// same bytes as the multithreaded one
+//
+// source  - Sky cube map to bake from (nothing is baked if
+//           it's empty)
+// timings - Filled in with one timing per size
+// --------------------------------------------------------
+void RunIBLBenchmark(const IBLCubemap& source, std::vector<IBLTiming>* timings)
+{
+	timings->clear();
+	if (source.Size == 0)
+		return;
+
+	for (unsigned int size = 32; size <= 256; size *= 2)
+	{
+		// Specular mips go down to 4x4
+		IBLBakeSettings settings;
+		settings.SpecularSize = size;
+		settings.SpecularMipCount = 1;
+		while ((size >> settings.SpecularMipCount) >= 4)
+			settings.SpecularMipCount++;
+		settings.BRDFLUTSize = size;
+
+		IBLTiming timing = {};
+		timing.Size = size;
+
+		IBLData threaded, single;
+		BakeIBL(source, settings, &threaded, &timing.Threaded, true);
+
+		IBLBakeTimings singleTimings;
+		BakeIBL(source, settings, &single, &singleTimings, false);
+		timing.SingleThreadTime = singleTimings.Irradiance + singleTimings.Specular + singleTimings.BRDFLUT;
+
+		std::vector<unsigned char> threadedBytes, singleBytes;
+		SerializeIBL(threaded, threadedBytes);
+		SerializeIBL(single, singleBytes);
+		timing.Deterministic = threadedBytes == singleBytes;
+
+		timings->push_back(timing);
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// Irradiance is stored as 3 bands of spherical harmonics.
+// The order (and constants) must match IrradianceSH()
+// in Lighting.hlsli
+#define IBL_SH_COEFFICIENTS		9
+
+// Identifies (and versions) the binary layout of a cache file
+#define IBL_CACHE_MAGIC			0x434C4249 // "IBLC"
+#define IBL_CACHE_VERSION		1
+
+// --------------------------------------------------------
+// A square cube map in linear color, one face after another
+// in D3D order (+X, -X, +Y, -Y, +Z, -Z), each face's rows
+// from top to bottom
+// --------------------------------------------------------
+struct IBLCubemap
+{
+	unsigned int Size = 0;
+	std::vector<DirectX::XMFLOAT4> Texels;
+};
+
+// --------------------------------------------------------
+// Resolutions and sample counts for a bake.  Every value
+// is part of the cache key, so changing any of them bakes
+// the sky again.
+// --------------------------------------------------------
+struct IBLBakeSettings
+{
+	unsigned int SourceSize = 256;		// Sky faces are downsampled to this first
+	unsigned int SpecularSize = 128;	// Top mip of the prefiltered cube map
+	unsigned int SpecularMipCount = 6;	// Roughness 0 to 1 across these mips
+	unsigned int SpecularSamples = 64;	// Per texel
+	unsigned int BRDFLUTSize = 128;
+	unsigned int BRDFSamples = 256;		// Per texel
+};
+
+// --------------------------------------------------------
+// Everything the PBR shader needs for image based lighting
+// --------------------------------------------------------
+struct IBLData
+{
+	unsigned long long Hash = 0; // Of the source and the settings
+
+	// Diffuse irradiance, already convolved with the cosine
+	// lobe and divided by pi (ready to multiply by albedo)
+	DirectX::XMFLOAT3 IrradianceSH[IBL_SH_COEFFICIENTS] = {};
+
+	// GGX prefiltered sky, one cube map per mip level
+	std::vector<IBLCubemap> SpecularMips;
+
+	// Split-sum BRDF: scale (x) and bias (y) of F0, indexed
+	// by NdotV (across) and roughness (down)
+	unsigned int BRDFLUTSize = 0;
+	std::vector<DirectX::XMFLOAT2> BRDFLUT;
+};
+
+// --------------------------------------------------------
+// How long each part of a bake took, in milliseconds
+// --------------------------------------------------------
+struct IBLBakeTimings
+{
+	double Irradiance = 0;
+	double Specular = 0;
+	double BRDFLUT = 0;
+};
+
+// Filling in a source cube map from 8-bit (gamma 2.2) face
+// images, box filtering down to the source's Size
+void DownsampleIBLFace(
+	const unsigned char* pixels,
+	unsigned int size,
+	unsigned int rowPitch,
+	bool bgra,
+	unsigned int face,
+	IBLCubemap* source);
+
+// Sampling cube maps in a direction (which needn't be
+// normalized), bilinear within a face and trilinear across
+// a chain of mips
+DirectX::XMFLOAT4 SampleIBLCubemap(const IBLCubemap& cube, DirectX::XMFLOAT3 dir);
+DirectX::XMFLOAT4 SampleIBLCubemapLevel(const std::vector<IBLCubemap>& mips, DirectX::XMFLOAT3 dir, float level);
+
+// Hashing the source and settings, which keys the cache
+unsigned long long HashIBLSource(const IBLCubemap& source, const IBLBakeSettings& settings);
+
+// Bakes everything.  Results are identical regardless of
+// thread count (and on every run), so they can be cached.
+void BakeIBL(
+	const IBLCubemap& source,
+	const IBLBakeSettings& settings,
+	IBLData* data,
+	IBLBakeTimings* timings = 0,
+	bool multithreaded = true);
+
+// Converting to and from the cache file format
+void SerializeIBL(const IBLData& data, std::vector<unsigned char>& bytes);
+bool DeserializeIBL(const unsigned char* bytes, size_t size, IBLData* data);
+
+// --------------------------------------------------------
+// Results of timing the bake at one resolution
+// --------------------------------------------------------
+struct IBLTiming
+{
+	unsigned int Size;			// Of the specular cube and BRDF LUT
+	IBLBakeTimings Threaded;	// Milliseconds per step
+	double SingleThreadTime;	// Total milliseconds
+	bool Deterministic;			// Did both bakes match exactly?
+};
+
+// Bakes from the same source at several sizes, both
+// multithreaded and not
+void RunIBLBenchmark(const IBLCubemap& source, std::vector<IBLTiming>* timings);
@@ -0,0 +1,610 @@
+#include "InspectorUI.h"
+#include "Helpers.h"
+#include "ImGui/imgui.h"
+
+#include <algorithm>
+#include <fstream>
+
+// --------------------------------------------------------
+// Lists the outcome of each test of a validation suite
+//
+// results   - From one of the Run*Validation() functions
+// showTimes - Whether the suite's tests were timed
+// --------------------------------------------------------
+void ShowValidationResults(const std::vector<ValidationResult>& results, bool showTimes)
+{
+	for (auto& r : results)
+	{
+		ImGui::Text("%s:", r.Name);
+		ImGui::SameLine(125);
+		if (showTimes)
+			ImGui::Text("%s (%.2f ms)", r.Passed ? "OK" : "FAILED", r.Time);
+		else
+			ImGui::Text("%s", r.Passed ? "OK" : "FAILED");
+	}
+}
+
+
+// === RENDERING ====================================================
+
+// --------------------------------------------------------
+// Constant buffer ring usage, and validating its allocator
+// --------------------------------------------------------
+void ConstantBufferRingUI(ConstantBufferRing& ring, std::vector<ValidationResult>* tests)
+{
+	if (ring.IsSupported())
+	{
+		const RingAllocator& allocator = ring.GetAllocator();
+		ImGui::Text("Constant Buffer Ring: %u KB", allocator.GetCapacity() / 1024);
+		ImGui::Text("Last Frame: %u KB in %u allocations, %u wrap(s)", allocator.GetFrameBytes() / 1024, allocator.GetFrameAllocations(), allocator.GetFrameWraps());
+	}
+	else
+	{
+		ImGui::Text("Constant Buffer Ring: Unsupported (per-shader buffers)");
+	}
+
+	// Checks the ring's suballocation on small rings of its own
+	if (ImGui::Button("Validate Ring Allocator"))
+		RunRingAllocatorValidation(tests);
+	ShowValidationResults(*tests);
+}
+
+// --------------------------------------------------------
+// Texture memory, compared to loading without cooking
+// --------------------------------------------------------
+void TextureCacheUI(TextureCache& cache)
+{
+	TextureCacheStats stats = cache.GetStats();
+	ImGui::Text("Textures: %u (%u cooked this run in %.2f ms, %u uncompressed, %u shared)",
+		stats.TextureCount, stats.CookedCount, stats.CookTime, stats.UncompressedCount, stats.SharedCount);
+	ImGui::Text("Texture Memory: %.2f MB (%.2f MB uncompressed)",
+		stats.CompressedBytes / (1024.0 * 1024.0), stats.UncompressedBytes / (1024.0 * 1024.0));
+	ImGui::Text("Packed Roughness/Metal: %u textures, %.2f MB (%.2f MB cooked separately)",
+		stats.PackedCount, stats.PackedBytes / (1024.0 * 1024.0), stats.PackedSeparateBytes / (1024.0 * 1024.0));
+}
+
+// --------------------------------------------------------
+// Checks the shader reflection cache's format on a fixture
+// --------------------------------------------------------
+void ShaderReflectionUI(std::vector<ValidationResult>* tests)
+{
+	if (ImGui::Button("Validate Reflection Cache"))
+		RunShaderReflectionValidation(tests);
+	ShowValidationResults(*tests);
+}
+
+// --------------------------------------------------------
+// Bind calls issued and filtered last frame, and checking
+// what a pair of shaders (the scene's own) sends through a
+// fresh filter to a recording device
+//
+// srvName, samplerName - Declared by the pixel shader
+// --------------------------------------------------------
+void BindingFilterUI(
+	BindingFilter& filter,
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	std::shared_ptr<SimpleVertexShader> vs,
+	std::shared_ptr<SimplePixelShader> ps,
+	const std::string& srvName,
+	const std::string& samplerName,
+	std::vector<ValidationResult>* tests)
+{
+	ImGui::Text("Bind Calls Last Frame: %u issued, %u filtered", filter.GetIssuedCount(), filter.GetFilteredCount());
+	if (ImGui::TreeNode("Bind Calls by Type"))
+	{
+		const char* typeNames[] = { "Shaders", "Input Layouts", "SRVs", "Samplers", "Constant Buffers" };
+		for (unsigned int t = 0; t < BINDING_TYPE_COUNT; t++)
+		{
+			ImGui::Text("%s:", typeNames[t]);
+			ImGui::SameLine(125);
+			ImGui::Text("%u issued, %u filtered", filter.GetIssuedCount(t), filter.GetFilteredCount(t));
+		}
+		ImGui::TreePop();
+	}
+
+	if (ImGui::Button("Validate Binding Filter"))
+		RunBindingFilterValidation(device, vs, ps, srvName, samplerName, tests);
+	ShowValidationResults(*tests);
+}
+
+// --------------------------------------------------------
+// Recording draws on deferred contexts, and validating the
+// scheduling with a mock recorder, on a job system of its
+// own like the job system tests
+// --------------------------------------------------------
+void CommandRecordingUI(DeferredDrawRecorder& recorder, bool* recordInParallel, int* minBatchSize, std::vector<ValidationResult>* tests)
+{
+	if (recorder.IsSupported())
+	{
+		ImGui::Checkbox("Record Draws In Parallel", recordInParallel);
+		ImGui::SliderInt("Min Draws Per Context", minBatchSize, 1, 256);
+		ImGui::Text("Contexts:");  ImGui::SameLine(125); ImGui::Text("%u deferred", recorder.GetContextCount());
+		if (*recordInParallel)
+		{
+			ImGui::Text("Last Frame:"); ImGui::SameLine(125);
+			ImGui::Text("%u draws in %u command list(s)", recorder.GetDrawCount(), recorder.GetBatchCount());
+		}
+	}
+	else
+	{
+		ImGui::Text("Deferred Contexts: Unsupported (requires the constant buffer ring)");
+	}
+
+	ImGui::Spacing();
+	if (ImGui::Button("Validate Scheduling"))
+	{
+		JobSystem testJobs(JobSystem::GetInstance().GetThreadCount() - 1);
+		RunCommandRecordingValidation(testJobs, 20, tests);
+	}
+	ShowValidationResults(*tests, true);
+}
+
+// --------------------------------------------------------
+// Times submitting a synthetic scene to the null render
+// device, with no driver or GPU cost in the way, and then
+// asks for the next real frame to be captured too (its
+// timing is added once it's drawn)
+// --------------------------------------------------------
+void RenderSubmissionUI(std::vector<RenderSubmissionTiming>* timings, bool* captureScene)
+{
+	if (ImGui::Button("Benchmark Submission"))
+	{
+		JobSystem testJobs(JobSystem::GetInstance().GetThreadCount() - 1);
+		RunRenderSubmissionBenchmark(testJobs, 5000, 20, timings);
+		*captureScene = true;
+	}
+	for (auto& t : *timings)
+	{
+		ImGui::Text("%s:", t.Method);
+		ImGui::SameLine(125);
+		ImGui::Text("%.3f us/draw, %u commands %s", t.TimePerDraw, t.Commands, t.Verified ? "OK" : "MISMATCH");
+	}
+}
+
+// --------------------------------------------------------
+// The last frame rendered on the CPU, and timing a
+// procedural scene at several resolutions, on a job system
+// of its own like the job system tests
+//
+// result     - Of comparing with the golden image (empty if
+//              nothing has been rendered)
+// renderTime - Milliseconds, including loading
+// --------------------------------------------------------
+void SoftwareRasterizerUI(SoftwareRasterizer& rasterizer, const std::string& result, double renderTime, std::vector<SoftwareRasterizerTiming>* timings)
+{
+	if (!result.empty())
+	{
+		const SoftwareRenderStats& stats = rasterizer.GetStats();
+		ImGui::Text("Result:"); ImGui::SameLine(125); ImGui::Text("%s", result.c_str());
+		ImGui::Text("Render Time:"); ImGui::SameLine(125); ImGui::Text("%.2f ms (%.2f ms with loading)", stats.TotalTime, renderTime);
+		ImGui::Text("Stages:"); ImGui::SameLine(125);
+		ImGui::Text("Vertices %.2f, setup %.2f, binning %.2f, tiles %.2f ms", stats.VertexTime, stats.SetupTime, stats.BinTime, stats.TileTime);
+		ImGui::Text("Triangles:"); ImGui::SameLine(125);
+		ImGui::Text("%u (%u rasterized, %u binned)", stats.Triangles, stats.Rasterized, stats.Binned);
+		ImGui::Text("Pixels Shaded:"); ImGui::SameLine(125); ImGui::Text("%u", stats.ShadedPixels);
+	}
+
+	ImGui::Spacing();
+	if (ImGui::Button("Benchmark Test Scene"))
+	{
+		JobSystem testJobs(JobSystem::GetInstance().GetThreadCount() - 1);
+		SoftwareScene testScene;
+		BuildSoftwareTestScene(8, 16.0f / 9.0f, &testScene);
+		RunSoftwareRasterizerBenchmark(testJobs, testScene, 5, timings);
+	}
+	for (auto& t : *timings)
+	{
+		ImGui::Text("%ux%u:", t.Width, t.Height);
+		ImGui::SameLine(125);
+		ImGui::Text("%.2f ms (%.2f ms 1 thread), %u triangles %s", t.Time, t.SingleThreadTime, t.Triangles, t.Deterministic ? "OK" : "MISMATCH");
+	}
+}
+
+// --------------------------------------------------------
+// What occlusion culling skipped last frame, and culling a
+// city along a camera path, on a job system of its own like
+// the job system tests
+//
+// cullingTime - Milliseconds last frame
+// --------------------------------------------------------
+void OcclusionCullingUI(OcclusionBuffer& buffer, bool* enabled, double cullingTime, std::vector<OcclusionCullingTiming>* timings)
+{
+	ImGui::Checkbox("Cull Hidden Entities", enabled);
+	if (*enabled)
+	{
+		const OcclusionStats& stats = buffer.GetStats();
+		ImGui::Text("Occluders:"); ImGui::SameLine(125);
+		ImGui::Text("%u (%u of %u triangles rasterized)", stats.Occluders, stats.Rasterized, stats.Triangles);
+		ImGui::Text("Culled:"); ImGui::SameLine(125);
+		ImGui::Text("%u outside view, %u occluded (of %u)", stats.Outside, stats.Occluded, stats.Tested);
+		ImGui::Text("Time:"); ImGui::SameLine(125);
+		ImGui::Text("%.3f ms (setup %.3f, raster %.3f, hierarchy %.3f, tests %.3f)",
+			cullingTime, stats.SetupTime, stats.RasterizeTime, stats.HierarchyTime, stats.TestTime);
+	}
+
+	ImGui::Spacing();
+	if (ImGui::Button("Benchmark Test Scene"))
+	{
+		JobSystem testJobs(JobSystem::GetInstance().GetThreadCount() - 1);
+		OcclusionTestScene testScene;
+		BuildOcclusionTestScene(16, 40, 120, &testScene);
+		RunOcclusionCullingBenchmark(testJobs, testScene, timings);
+	}
+	for (auto& t : *timings)
+	{
+		ImGui::Text("%s:", t.Method);
+		ImGui::SameLine(125);
+		ImGui::Text("%.3f ms raster, %.3f ms tests, %.1f%% outside, %.1f%% occluded %s",
+			t.RasterizeTime, t.TestTime, t.OutsidePercent, t.OccludedPercent, t.Verified ? "OK" : "MISMATCH");
+	}
+}
+
+// --------------------------------------------------------
+// How the sky's IBL was made, and timing the bake at
+// several sizes
+// --------------------------------------------------------
+void IBLUI(Sky& sky, float* intensity, std::vector<IBLTiming>* timings)
+{
+	if (sky.HasIBL())
+	{
+		IBLBakeTimings bake = sky.GetIBLBakeTimings();
+		if (sky.WasIBLCached())
+			ImGui::Text("IBL: Loaded from cache");
+		else
+			ImGui::Text("IBL: Baked in %.2f ms (SH %.2f, specular %.2f, BRDF %.2f)",
+				bake.Irradiance + bake.Specular + bake.BRDFLUT, bake.Irradiance, bake.Specular, bake.BRDFLUT);
+		ImGui::SliderFloat("IBL Intensity", intensity, 0.0f, 2.0f);
+	}
+	else
+	{
+		ImGui::Text("IBL: Not available for this sky");
+	}
+
+	if (ImGui::Button("Benchmark IBL Bake"))
+		RunIBLBenchmark(sky.GetIBLSource(), timings);
+	for (auto& t : *timings)
+	{
+		ImGui::Text("%ux%u:", t.Size, t.Size);
+		ImGui::SameLine(125);
+		ImGui::Text("SH %.2f ms, specular %.2f ms, BRDF %.2f ms (%.2f ms 1 thread) %s",
+			t.Threaded.Irradiance, t.Threaded.Specular, t.Threaded.BRDFLUT, t.SingleThreadTime,
+			t.Deterministic ? "OK" : "MISMATCH");
+	}
+}
+
+
+// === FRAMES AND THREADS ===========================================
+
+// --------------------------------------------------------
+// Distribution of recent frame times, per part of the frame
+//
+// record   - Keep recording frames?
+// csvFile  - Where to save them, relative to the executable
+// csvSaved - Were they saved (shown until the app closes)?
+// --------------------------------------------------------
+void FrameStatsUI(FrameStats& stats, bool* record, const std::wstring& csvFile, bool* csvSaved)
+{
+	FrameStatsSummary summary = stats.Summarize();
+
+	ImGui::Text("Last %u frames (ms):", summary.FrameCount);
+	ImGui::Text("Part");    ImGui::SameLine(100); ImGui::Text("Average"); ImGui::SameLine(175); ImGui::Text("50%%");
+	ImGui::SameLine(250);   ImGui::Text("95%%");  ImGui::SameLine(325); ImGui::Text("99%%"); ImGui::SameLine(400); ImGui::Text("Max");
+	for (unsigned int part = 0; part < FRAME_STATS_PART_COUNT; part++)
+	{
+		FrameTimeDistribution& d = summary.Parts[part];
+		ImGui::Text("%s", FrameStats::GetPartName(part));
+		ImGui::SameLine(100); ImGui::Text("%.2f", d.Average);
+		ImGui::SameLine(175); ImGui::Text("%.2f", d.P50);
+		ImGui::SameLine(250); ImGui::Text("%.2f", d.P95);
+		ImGui::SameLine(325); ImGui::Text("%.2f", d.P99);
+		ImGui::SameLine(400); ImGui::Text("%.2f", d.Max);
+	}
+	ImGui::Text("Hitches: %u (over %.2f ms)", summary.Hitches, summary.HitchThreshold);
+
+	// Every recorded frame, and how they're distributed up
+	// to a few times the median (slower ones land in the last bar)
+	float graphWidth = ImGui::GetContentRegionAvail().x;
+	std::vector<float> totals(stats.GetFrameCount());
+	for (unsigned int i = 0; i < totals.size(); i++)
+		totals[i] = (float)stats.GetFrame(i).Times[FRAME_STATS_TOTAL];
+	if (!totals.empty())
+		ImGui::PlotLines("##FrameTimes", &totals[0], (int)totals.size(), 0, "Frame Time", 0.0f, (float)summary.Parts[FRAME_STATS_TOTAL].Max, ImVec2(graphWidth, 60));
+
+	std::vector<float> histogram;
+	double histogramMax = (std::max)(summary.HitchThreshold * 2.0, 1.0);
+	stats.GetHistogram(FRAME_STATS_TOTAL, histogramMax, 50, &histogram);
+	ImGui::PlotHistogram("##FrameHistogram", &histogram[0], (int)histogram.size(), 0, "Distribution", 0.0f, FLT_MAX, ImVec2(graphWidth, 60));
+	ImGui::Text("0 ms");
+	ImGui::SameLine(graphWidth - 60);
+	ImGui::Text("%.1f+ ms", histogramMax);
+
+	ImGui::Checkbox("Record", record);
+	ImGui::SameLine();
+	if (ImGui::Button("Clear"))
+		stats.Clear();
+	ImGui::SameLine();
+	if (ImGui::Button("Save CSV"))
+	{
+		std::ofstream csv(FixPath(csvFile));
+		stats.WriteCSV(csv);
+		*csvSaved = csv.good();
+	}
+	if (*csvSaved)
+	{
+		ImGui::SameLine();
+		ImGui::Text("Saved to %s", WideToNarrow(csvFile).c_str());
+	}
+}
+
+// --------------------------------------------------------
+// Overlapping busy work standing in for each half of a
+// frame, against running the halves one after the other
+// --------------------------------------------------------
+void FramePipelineUI(std::vector<FramePipelineTiming>* timings)
+{
+	if (ImGui::Button("Benchmark Pipelining"))
+		RunFramePipelineBenchmark(60, timings);
+	for (auto& t : *timings)
+	{
+		ImGui::Text("%.0f + %.0f ms:", t.SimulationCost, t.RenderCost);
+		ImGui::SameLine(125);
+		ImGui::Text("%.2f ms per frame pipelined (%.2f ms serial) %s", t.PipelinedTime, t.SerialTime, t.Matches ? "OK" : "MISMATCH");
+	}
+}
+
+// --------------------------------------------------------
+// The job system's stats, and testing and timing it.  Tests
+// and timings use a system of their own, so the given one's
+// stats aren't disturbed.
+// --------------------------------------------------------
+void JobSystemUI(JobSystem& jobs, std::vector<ValidationResult>* tests, std::vector<JobSystemBenchmarkTiming>* timings)
+{
+	JobSystemStats stats = jobs.GetStats();
+	ImGui::Text("Threads:");     ImGui::SameLine(125); ImGui::Text("%u (including the main thread)", jobs.GetThreadCount());
+	ImGui::Text("Jobs Run:");    ImGui::SameLine(125); ImGui::Text("%llu", stats.JobsRun);
+	ImGui::Text("Stolen:");      ImGui::SameLine(125); ImGui::Text("%llu", stats.JobsStolen);
+	ImGui::Text("Main Thread:"); ImGui::SameLine(125); ImGui::Text("%llu", stats.MainThreadJobs);
+	if (ImGui::Button("Reset Stats"))
+		jobs.ResetStats();
+
+	ImGui::Spacing();
+	if (ImGui::Button("Run Stress Test"))
+	{
+		JobSystem testJobs(jobs.GetThreadCount() - 1);
+		RunJobSystemStressTest(testJobs, 20, tests);
+	}
+	ShowValidationResults(*tests, true);
+
+	ImGui::Spacing();
+	if (ImGui::Button("Run Benchmark"))
+	{
+		JobSystem testJobs(jobs.GetThreadCount() - 1);
+		RunJobSystemBenchmark(testJobs, timings);
+	}
+	for (auto& t : *timings)
+	{
+		ImGui::Text("%s:", t.Workload);
+		ImGui::SameLine(150);
+		ImGui::Text("%.2f ms (%.2f ms 1 thread, %.2f ms thread per loop) %s",
+			t.JobSystemTime, t.SequentialTime, t.ThreadPerCallTime, t.Matches ? "OK" : "MISMATCH");
+	}
+}
+
+
+// === ASSETS =======================================================
+
+// --------------------------------------------------------
+// How much of a registry's budget is used, and how often
+// loads were shared
+// --------------------------------------------------------
+void AssetRegistryUI(const char* name, const AssetRegistryStats& stats)
+{
+	ImGui::Text("%s", name);
+	ImGui::SameLine(125);
+	ImGui::Text("%u loaded, %.2f MB of %.2f MB budget", stats.EntryCount, stats.Bytes / (1024.0 * 1024.0), stats.Budget / (1024.0 * 1024.0));
+	ImGui::NewLine();
+	ImGui::SameLine(125);
+	ImGui::Text("%u path hits, %u content hits, %u misses, %u evicted", stats.PathHits, stats.HashHits, stats.Misses, stats.Evictions);
+}
+
+// --------------------------------------------------------
+// Each job of a graph as a bar showing when it ran, colored
+// by whether it had to stay on the main thread
+//
+// totalTime - Milliseconds the whole graph took
+// --------------------------------------------------------
+void JobTimelineUI(const std::vector<JobTiming>& timeline, double totalTime)
+{
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	float width = (std::max)(ImGui::GetContentRegionAvail().x - 250.0f, 100.0f);
+	float height = ImGui::GetTextLineHeight();
+	for (auto& job : timeline)
+	{
+		ImGui::Text("%s", job.Name.c_str());
+		ImGui::SameLine(250);
+
+		ImVec2 pos = ImGui::GetCursorScreenPos();
+		float start = pos.x + (float)(job.Start / totalTime) * width;
+		float end = (std::max)(start + 1.0f, pos.x + (float)(job.End / totalTime) * width);
+		drawList->AddRectFilled(
+			ImVec2(start, pos.y + 2),
+			ImVec2(end, pos.y + height - 2),
+			job.MainThreadOnly ? IM_COL32(230, 150, 60, 255) : IM_COL32(80, 160, 230, 255));
+
+		ImGui::Dummy(ImVec2(width, height));
+		if (ImGui::IsItemHovered())
+			ImGui::SetTooltip("%.2f - %.2f ms (%.2f ms) on thread %u", job.Start, job.End, job.End - job.Start, job.Thread);
+	}
+}
+
+// --------------------------------------------------------
+// Mounted asset packs, and where the files read by the
+// last load came from
+// --------------------------------------------------------
+void AssetFilesUI()
+{
+	auto packs = GetMountedAssetPacks();
+	if (packs.empty())
+		ImGui::Text("No pack mounted (loading loose files)");
+	for (auto& pack : packs)
+		ImGui::Text("Mounted: %s (%u files, %.2f MB)", WideToNarrow(pack->GetPath()).c_str(), (unsigned int)pack->GetEntries().size(), pack->GetSize() / (1024.0 * 1024.0));
+
+	AssetFileStats files = GetAssetFileStats();
+	ImGui::Text("Last Load:");
+	ImGui::SameLine(125);
+	ImGui::Text("%u in place (%.2f MB), %u decompressed (%.2f MB), %u loose (%.2f MB)",
+		files.PackFiles, files.PackBytes / (1024.0 * 1024.0),
+		files.DecompressedFiles, files.DecompressedBytes / (1024.0 * 1024.0),
+		files.LooseFiles, files.LooseBytes / (1024.0 * 1024.0));
+}
+
+// --------------------------------------------------------
+// Timing reads of a set of files, loose and packed
+//
+// findFiles - Gathers the files to read when asked
+// --------------------------------------------------------
+void AssetReadUI(void(*findFiles)(std::vector<std::wstring>* files), std::vector<AssetReadTiming>* timings)
+{
+	if (ImGui::Button("Benchmark Asset Reads"))
+	{
+		std::vector<std::wstring> files;
+		findFiles(&files);
+		RunAssetReadBenchmark(files, timings);
+	}
+	for (auto& t : *timings)
+	{
+		ImGui::Text("%s:", t.Method);
+		ImGui::SameLine(125);
+		ImGui::Text("%.2f ms for %u files (%.2f MB on disk)", t.Time, t.FileCount, t.Bytes / (1024.0 * 1024.0));
+	}
+}
+
+// --------------------------------------------------------
+// What the streamer has resident, and testing the policy
+// along simulated camera paths
+//
+// streamer     - Null when not streaming
+// updateTime   - Milliseconds last frame, including feedback
+// fieldOfView  - For the simulated camera (radians)
+// screenHeight - For the simulated camera (pixels)
+// --------------------------------------------------------
+void TextureStreamingUI(TextureStreamer* streamer, double updateTime, float fieldOfView, float screenHeight, std::vector<TextureStreamingResult>* results)
+{
+	if (streamer)
+	{
+		TextureStreamerStats s = streamer->GetStats();
+		ImGui::Text("Textures: %u, %u loads in flight", s.TextureCount, s.LoadsInFlight);
+		ImGui::Text("Resident: %.2f MB (%.2f MB with every mip)", s.ResidentBytes / (1024.0 * 1024.0), s.FullBytes / (1024.0 * 1024.0));
+		ImGui::Text("Required Mips Resident: %.1f%% of visible textures", s.SatisfiedPercent);
+		ImGui::Text("Mips Loaded: %llu, Evictions: %llu", s.MipLoads, s.Evictions);
+		ImGui::Text("Update: %.3f ms (%.3f ms in the streamer)", updateTime, s.UpdateTime);
+	}
+	else
+	{
+		ImGui::Text("Not streaming (all mips resident)");
+	}
+
+	ImGui::Spacing();
+	if (ImGui::Button("Run Streaming Simulation"))
+		RunTextureStreamingSimulation(fieldOfView, screenHeight, results);
+	for (auto& r : *results)
+	{
+		ImGui::Text("%s, %u MB:", r.PathName, r.BudgetMB);
+		ImGui::SameLine(175);
+		ImGui::Text("peak %.1f MB, %.1f%% satisfied (%.2f mips short), %llu mips loaded, %llu evictions, %u frames over, %.1f ms",
+			r.Results.PeakBytes / (1024.0 * 1024.0), r.Results.SatisfiedPercent, r.Results.AverageMipsMissing,
+			r.Results.MipLoads, r.Results.Evictions, r.Results.FramesOverBudget, r.Time);
+	}
+}
+
+
+// === SCENE ========================================================
+
+// --------------------------------------------------------
+// Times spinning and reading a million entities kept in a
+// registry, against keeping them as shared objects
+// --------------------------------------------------------
+void EntityRegistryUI(std::vector<EntityRegistryTiming>* timings)
+{
+	if (ImGui::Button("Benchmark Entity Storage"))
+		RunEntityRegistryBenchmark(1000000, 10, timings);
+	for (auto& t : *timings)
+	{
+		ImGui::Text("%s:", t.Layout);
+		ImGui::SameLine(150);
+		ImGui::Text("%.3f ms update, %.3f ms iterate %s", t.UpdateTime, t.IterateTime, t.Matches ? "OK" : "MISMATCH");
+	}
+}
+
+// --------------------------------------------------------
+// The cluster grid's last build, and validating and timing
+// builds at several light counts
+//
+// buildTime - Milliseconds last frame
+// frustum   - Camera the benchmark builds for
+// --------------------------------------------------------
+void LightClustersUI(const LightClusters& clusters, double buildTime, const ClusterFrustum& frustum, std::vector<ClusterTiming>* timings)
+{
+	ImGui::Text("Clusters: %dx%dx%d, build %.3f ms", CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, buildTime);
+	ImGui::Text("Light Indices: %u (max %u per cluster, %u full)",
+		(unsigned int)clusters.GetLightIndices().size(),
+		clusters.GetMaxLightsPerCluster(),
+		clusters.GetFullClusterCount());
+	if (ImGui::Button("Validate & Benchmark Clusters"))
+		RunClusterBenchmark(frustum, timings);
+	for (auto& t : *timings)
+	{
+		ImGui::Text("%u lights:", t.LightCount);
+		ImGui::SameLine(125);
+		ImGui::Text("%.2f ms (%.2f ms 1 thread, %.2f ms brute force) %s",
+			t.BuildTime, t.SingleThreadTime, t.ReferenceTime, t.Matches ? "OK" : "MISMATCH");
+	}
+}
+
+// --------------------------------------------------------
+// Per-entity light lists (used instead of the clusters when
+// enabled), and validating and timing their updates
+//
+// updateTime - Milliseconds last frame
+// --------------------------------------------------------
+void EntityLightListsUI(const EntityLightLists& lists, bool* enabled, double updateTime, std::vector<LightSelectionTiming>* timings)
+{
+	ImGui::Checkbox("Per-Entity Lights (instead of clusters)", enabled);
+	ImGui::Text("Entity lights: top %d, update %.3f ms (%u changed lights, %u entities rescored)",
+		ENTITY_MAX_LIGHTS,
+		updateTime,
+		lists.GetChangedLightCount(),
+		lists.GetRescoredEntityCount());
+	if (ImGui::Button("Validate & Benchmark Light Selection"))
+		RunLightSelectionBenchmark(timings);
+	for (auto& t : *timings)
+	{
+		if (t.MovedPercent == 100)
+			ImGui::Text("Full build:");
+		else
+			ImGui::Text("%u%% moved:", t.MovedPercent);
+		ImGui::SameLine(125);
+		ImGui::Text("%.2f ms (%.2f ms 1 thread, %u rescored) %s",
+			t.UpdateTime, t.SingleThreadTime, t.RescoredEntities, t.Matches ? "OK" : "MISMATCH");
+	}
+}
+
+// --------------------------------------------------------
+// Comparing and timing the CPU lighting ports (64K samples,
+// 16 lights of each type)
+// --------------------------------------------------------
+void ShadingUI(std::vector<ShadingTiming>* timings)
+{
+	if (ImGui::Button("Validate & Benchmark CPU Shading"))
+		RunShadingBenchmark(timings);
+	if (!timings->empty())
+		ImGui::Text("AVX: %s", IsLightingAVXSupported() ? "Supported" : "Not supported (using SSE)");
+	for (auto& t : *timings)
+	{
+		const char* typeNames[] = { "Directional", "Point", "Spot" };
+		ImGui::Text("%s:", typeNames[t.LightType]);
+		ImGui::SameLine(125);
+		ImGui::Text("Scalar %.2f ms, SSE %.2f ms, AVX %.2f ms, error %.1e %s",
+			t.ScalarTime, t.SSETime, t.AVXTime, t.MaxError, t.MaxError < 0.001f ? "OK" : "MISMATCH");
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Validation.h"
+#include "ConstantBufferRing.h"
+#include "TextureCache.h"
+#include "ShaderReflectionCache.h"
+#include "BindingFilter.h"
+#include "SimpleShader.h"
+#include "FrameStats.h"
+#include "FramePipeline.h"
+#include "JobSystemBenchmark.h"
+#include "DeferredDrawRecorder.h"
+#include "NullRenderDevice.h"
+#include "SoftwareRasterizer.h"
+#include "OcclusionCulling.h"
+#include "AssetRegistry.h"
+#include "JobGraph.h"
+#include "FileSystem.h"
+#include "TextureStreamer.h"
+#include "EntityRegistry.h"
+#include "Sky.h"
+#include "LightClusters.h"
+#include "EntityLightLists.h"
+#include "LightingSIMD.h"
+
+// --------------------------------------------------------
+// Panels for the Inspector window, one per module: what it
+// reports about itself, plus buttons running its validation
+// and benchmarks, with their results.  Each is drawn into
+// the current ImGui window (inside a tree node of the
+// game's), and only touches what it's given.
+// --------------------------------------------------------
+
+// Results of a validation suite, one line per test
+void ShowValidationResults(const std::vector<ValidationResult>& results, bool showTimes = false);
+
+// Rendering
+void ConstantBufferRingUI(ConstantBufferRing& ring, std::vector<ValidationResult>* tests);
+void TextureCacheUI(TextureCache& cache);
+void ShaderReflectionUI(std::vector<ValidationResult>* tests);
+void BindingFilterUI(
+	BindingFilter& filter,
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	std::shared_ptr<SimpleVertexShader> vs,
+	std::shared_ptr<SimplePixelShader> ps,
+	const std::string& srvName,
+	const std::string& samplerName,
+	std::vector<ValidationResult>* tests);
+void CommandRecordingUI(DeferredDrawRecorder& recorder, bool* recordInParallel, int* minBatchSize, std::vector<ValidationResult>* tests);
+void RenderSubmissionUI(std::vector<RenderSubmissionTiming>* timings, bool* captureScene);
+void SoftwareRasterizerUI(SoftwareRasterizer& rasterizer, const std::string& result, double renderTime, std::vector<SoftwareRasterizerTiming>* timings);
+void OcclusionCullingUI(OcclusionBuffer& buffer, bool* enabled, double cullingTime, std::vector<OcclusionCullingTiming>* timings);
+void IBLUI(Sky& sky, float* intensity, std::vector<IBLTiming>* timings);
+
+// Frames and threads
+void FrameStatsUI(FrameStats& stats, bool* record, const std::wstring& csvFile, bool* csvSaved);
+void FramePipelineUI(std::vector<FramePipelineTiming>* timings);
+void JobSystemUI(JobSystem& jobs, std::vector<ValidationResult>* tests, std::vector<JobSystemBenchmarkTiming>* timings);
+
+// Assets
+void AssetRegistryUI(const char* name, const AssetRegistryStats& stats);
+void JobTimelineUI(const std::vector<JobTiming>& timeline, double totalTime);
+void AssetFilesUI();
+void AssetReadUI(void(*findFiles)(std::vector<std::wstring>* files), std::vector<AssetReadTiming>* timings);
+void TextureStreamingUI(TextureStreamer* streamer, double updateTime, float fieldOfView, float screenHeight, std::vector<TextureStreamingResult>* results);
+
+// Scene
+void EntityRegistryUI(std::vector<EntityRegistryTiming>* timings);
+void LightClustersUI(const LightClusters& clusters, double buildTime, const ClusterFrustum& frustum, std::vector<ClusterTiming>* timings);
+void EntityLightListsUI(const EntityLightLists& lists, bool* enabled, double updateTime, std::vector<LightSelectionTiming>* timings);
+void ShadingUI(std::vector<ShadingTiming>* timings);
@@ -0,0 +1,176 @@
+#include "JobGraph.h"
+#include "Parallel.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// --------------------------------------------------------
+// Creates an empty graph
+// --------------------------------------------------------
+JobGraph::JobGraph() :
+	totalTime(0),
+	threadCount(0)
+{
+}
+
+// --------------------------------------------------------
+// Adds a job to the graph
+//
+// name         - For the timeline
+// thread       - JOB_GRAPH_ANY_THREAD or JOB_GRAPH_MAIN_THREAD
+// work         - What the job does
+// dependencies - Jobs that must finish before this starts
+//
+// Returns the new job, for others to depend on
+// --------------------------------------------------------
+JobGraph::Job JobGraph::Add(
+	const std::string& name,
+	unsigned int thread,
+	const std::function<void()>& work,
+	const std::vector<Job>& dependencies)
+{
+	Job job = (Job)jobs.size();
+
+	JobInfo info;
+	info.Name = name;
+	info.ProfileName = Profiler::Intern(name);
+	info.Thread = thread;
+	info.Work = work;
+	info.DependencyCount = 0;
+	jobs.push_back(info);
+
+	// Only earlier jobs can be dependencies, which rules out cycles
+	for (Job dependency : dependencies)
+	{
+		if (dependency >= job)
+			continue;
+
+		jobs[dependency].Dependents.push_back(job);
+		jobs[job].DependencyCount++;
+	}
+
+	return job;
+}
+
+// --------------------------------------------------------
+// Sets functions for each worker thread to call when it
+// starts and right before it ends
+// --------------------------------------------------------
+void JobGraph::SetWorkerCallbacks(const std::function<void()>& start, const std::function<void()>& end)
+{
+	workerStart = start;
+	workerEnd = end;
+}
+
+// --------------------------------------------------------
+// Runs every job, using as many threads as ParallelFor()
+// (the calling thread included) when multithreaded.  The
+// calling thread always prefers jobs that only it can run,
+// and helps with the rest otherwise.
+// --------------------------------------------------------
+void JobGraph::Run(bool multithreaded)
+{
+	PROFILE_FUNCTION();
+	auto runStart = std::chrono::high_resolution_clock::now();
+	auto elapsed = [&]() { return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - runStart).count(); };
+
+	// Everything without dependencies is ready right away
+	std::vector<unsigned int> remaining(jobs.size());
+	std::deque<Job> anyReady;
+	std::deque<Job> mainReady;
+	for (Job job = 0; job < jobs.size(); job++)
+	{
+		remaining[job] = jobs[job].DependencyCount;
+		if (remaining[job] == 0)
+			(jobs[job].Thread == JOB_GRAPH_MAIN_THREAD ? mainReady : anyReady).push_back(job);
+	}
+
+	timeline.assign(jobs.size(), JobTiming());
+	size_t finished = 0;
+	std::mutex mutex;
+	std::condition_variable changed;
+
+	// Runs a job with the lock released, then readies any
+	// dependents that were only waiting on it
+	auto runJob = [&](Job job, unsigned int thread, std::unique_lock<std::mutex>& lock)
+	{
+		lock.unlock();
+		double start = elapsed();
+		{
+			PROFILE_SCOPE(jobs[job].ProfileName);
+			jobs[job].Work();
+		}
+		double end = elapsed();
+		lock.lock();
+
+		JobTiming& timing = timeline[job];
+		timing.Name = jobs[job].Name;
+		timing.Start = start;
+		timing.End = end;
+		timing.Thread = thread;
+		timing.MainThreadOnly = jobs[job].Thread == JOB_GRAPH_MAIN_THREAD;
+
+		for (Job dependent : jobs[job].Dependents)
+		{
+			if (--remaining[dependent] == 0)
+				(jobs[dependent].Thread == JOB_GRAPH_MAIN_THREAD ? mainReady : anyReady).push_back(dependent);
+		}
+
+		finished++;
+		changed.notify_all();
+	};
+
+	threadCount = multithreaded ? GetParallelThreadCount() : 1;
+	std::vector<std::thread> workers;
+	for (unsigned int t = 1; t < threadCount; t++)
+	{
+		workers.push_back(std::thread([&, t]()
+		{
+			PROFILE_THREAD("Job Graph Worker");
+			if (workerStart)
+				workerStart();
+
+			std::unique_lock<std::mutex> lock(mutex);
+			while (true)
+			{
+				changed.wait(lock, [&]() { return !anyReady.empty() || finished == jobs.size(); });
+				if (anyReady.empty())
+					break;
+
+				Job job = anyReady.front();
+				anyReady.pop_front();
+				runJob(job, t, lock);
+			}
+			lock.unlock();
+
+			if (workerEnd)
+				workerEnd();
+		}));
+	}
+
+	// This thread's share
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (finished < jobs.size())
+		{
+			changed.wait(lock, [&]() { return !mainReady.empty() || !anyReady.empty() || finished == jobs.size(); });
+
+			std::deque<Job>& queue = !mainReady.empty() ? mainReady : anyReady;
+			if (queue.empty())
+				continue;
+
+			Job job = queue.front();
+			queue.pop_front();
+			runJob(job, 0, lock);
+		}
+	}
+
+	for (auto& worker : workers)
+		worker.join();
+
+	totalTime = elapsed();
+}
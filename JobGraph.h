@@ -0,0 +1,78 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Where a job is allowed to run
+#define JOB_GRAPH_ANY_THREAD	0	// Any worker, or the thread calling Run()
+#define JOB_GRAPH_MAIN_THREAD	1	// Only the thread calling Run() (for D3D context work)
+
+// --------------------------------------------------------
+// When and where a job ran, in milliseconds since Run()
+// started.  Thread 0 is the one that called Run().
+// --------------------------------------------------------
+struct JobTiming
+{
+	std::string Name;
+	double Start;
+	double End;
+	unsigned int Thread;
+	bool MainThreadOnly;
+};
+
+// --------------------------------------------------------
+// A set of jobs with dependencies between them, run once.
+// Each job starts only after everything it depends on has
+// finished.  Jobs that must stay on the calling thread
+// (like anything using the immediate context) are run
+// there, while the rest are spread across worker threads.
+// --------------------------------------------------------
+class JobGraph
+{
+public:
+	typedef unsigned int Job;
+
+	JobGraph();
+
+	// Adding jobs, which must each depend only on jobs that
+	// were added before them
+	Job Add(
+		const std::string& name,
+		unsigned int thread,
+		const std::function<void()>& work,
+		const std::vector<Job>& dependencies = std::vector<Job>());
+
+	// Called on each worker thread before and after it runs
+	// jobs (such as for initializing COM)
+	void SetWorkerCallbacks(const std::function<void()>& start, const std::function<void()>& end);
+
+	// Runs every job, returning once they've all finished.
+	// Without multithreading, jobs run one at a time in the
+	// order they become ready.
+	void Run(bool multithreaded);
+
+	// Results of the last run
+	const std::vector<JobTiming>& GetTimeline() { return timeline; }
+	double GetTotalTime() { return totalTime; }
+	unsigned int GetThreadCount() { return threadCount; }
+
+private:
+	struct JobInfo
+	{
+		std::string Name;
+		const char* ProfileName;	// Name, interned for the profiler
+		unsigned int Thread;
+		std::function<void()> Work;
+		std::vector<Job> Dependents;
+		unsigned int DependencyCount;
+	};
+	std::vector<JobInfo> jobs;
+
+	std::function<void()> workerStart;
+	std::function<void()> workerEnd;
+
+	std::vector<JobTiming> timeline;
+	double totalTime;
+	unsigned int threadCount;
+};
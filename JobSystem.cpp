@@ -0,0 +1,364 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+// Which system (if any) the calling thread works for, and
+// which of its workers it is
+static thread_local JobSystem* currentSystem = 0;
+static thread_local int currentWorker = -1;
+
+// --------------------------------------------------------
+// Starts the worker threads, which sleep until there are
+// jobs to run
+//
+// workerCount - Threads to start, besides the main thread
+// --------------------------------------------------------
+JobSystem::JobSystem(unsigned int workerCount) :
+	mainThread(std::this_thread::get_id()),
+	pending(0),
+	mainPending(0),
+	stopping(false),
+	jobsRun(0),
+	jobsStolen(0),
+	mainThreadJobs(0)
+{
+	for (unsigned int w = 0; w < workerCount; w++)
+		queues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+
+	for (unsigned int w = 0; w < workerCount; w++)
+		workers.push_back(std::thread(&JobSystem::WorkerLoop, this, w));
+}
+
+// --------------------------------------------------------
+// Lets the workers finish every queued job, then stops
+// them.  Jobs left for the main thread never run.
+// --------------------------------------------------------
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (auto& worker : workers)
+		worker.join();
+}
+
+// --------------------------------------------------------
+// Gets the shared system, starting it on first use
+// --------------------------------------------------------
+JobSystem& JobSystem::GetInstance()
+{
+	static JobSystem instance((std::max)(std::thread::hardware_concurrency(), 1u) - 1);
+	return instance;
+}
+
+// --------------------------------------------------------
+// Queues a job
+//
+// work       - What the job does
+// counter    - Counts the job until it finishes (optional)
+// thread     - JOB_SYSTEM_ANY_THREAD or JOB_SYSTEM_MAIN_THREAD
+// dependency - The job isn't queued until this reaches
+//              zero (optional)
+// --------------------------------------------------------
+void JobSystem::Run(const std::function<void()>& work, JobCounter* counter, unsigned int thread, JobCounter* dependency)
+{
+	if (counter)
+		counter->count.fetch_add(1, std::memory_order_relaxed);
+
+	JobSystemJob job;
+	job.Work = work;
+	job.Counter = counter;
+	job.Thread = thread;
+
+	// Finishing the dependency's last job takes this same lock,
+	// so the job is either queued now or picked up then
+	if (dependency)
+	{
+		std::lock_guard<std::mutex> lock(dependency->mutex);
+		if (!dependency->IsDone())
+		{
+			dependency->dependents.push_back(job);
+			return;
+		}
+	}
+
+	Queue(job);
+}
+
+// --------------------------------------------------------
+// Runs other jobs until every job the counter counts has
+// finished, sleeping only when there's nothing to run
+// --------------------------------------------------------
+void JobSystem::Wait(JobCounter* counter)
+{
+	int worker = currentSystem == this ? currentWorker : -1;
+	bool mainThread = IsMainThread();
+
+	while (!counter->IsDone())
+	{
+		if (TryRunJob(worker, mainThread))
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [&]()
+		{
+			return counter->IsDone() || pending > 0 || (mainThread && mainPending > 0);
+		});
+	}
+
+	// The last job may still be releasing the counter's lock,
+	// and the counter can't go away until it has
+	std::lock_guard<std::mutex> lock(counter->mutex);
+}
+
+// --------------------------------------------------------
+// Runs the body over the range in chunks, with the calling
+// thread taking the first and helping with the rest.  There
+// are a few chunks per thread, so threads that finish early
+// can steal from the others.
+//
+// count     - Number of items in the range
+// grainSize - Fewest items worth giving a chunk
+// body      - Function to call for each chunk of the range
+// --------------------------------------------------------
+void JobSystem::ParallelFor(unsigned int count, unsigned int grainSize, const std::function<void(unsigned int start, unsigned int end)>& body)
+{
+	if (count == 0)
+		return;
+
+	unsigned int chunkCount = (std::min)(count / (std::max)(grainSize, 1u), GetThreadCount() * 4);
+	if (chunkCount <= 1 || workers.empty())
+	{
+		body(0, count);
+		return;
+	}
+
+	// Evenly sized chunks, the first few one larger
+	unsigned int chunkSize = count / chunkCount;
+	unsigned int remainder = count % chunkCount;
+	unsigned int firstEnd = chunkSize + (remainder > 0 ? 1 : 0);
+
+	JobCounter counter;
+	const std::function<void(unsigned int, unsigned int)>* chunkBody = &body;
+	unsigned int start = firstEnd;
+	for (unsigned int c = 1; c < chunkCount; c++)
+	{
+		unsigned int end = start + chunkSize + (c < remainder ? 1 : 0);
+		Run([chunkBody, start, end]() { (*chunkBody)(start, end); }, &counter);
+		start = end;
+	}
+
+	body(0, firstEnd);
+	Wait(&counter);
+}
+
+// --------------------------------------------------------
+// Makes the calling thread the one main thread jobs run on
+// --------------------------------------------------------
+void JobSystem::SetMainThread()
+{
+	mainThread = std::this_thread::get_id();
+}
+
+// --------------------------------------------------------
+// Runs every job queued for the main thread so far, which
+// the main thread should do regularly (like once a frame)
+//
+// Returns the number of jobs run
+// --------------------------------------------------------
+unsigned int JobSystem::RunMainThreadJobs()
+{
+	if (!IsMainThread())
+		return 0;
+
+	unsigned int count = 0;
+	while (mainPending > 0 && TryRunJob(-1, true))
+		count++;
+	return count;
+}
+
+JobSystemStats JobSystem::GetStats()
+{
+	JobSystemStats stats;
+	stats.JobsRun = jobsRun;
+	stats.JobsStolen = jobsStolen;
+	stats.MainThreadJobs = mainThreadJobs;
+	return stats;
+}
+
+void JobSystem::ResetStats()
+{
+	jobsRun = 0;
+	jobsStolen = 0;
+	mainThreadJobs = 0;
+}
+
+// --------------------------------------------------------
+// Puts a ready job on the right queue and wakes a thread
+// that can run it
+// --------------------------------------------------------
+void JobSystem::Queue(const JobSystemJob& job)
+{
+	if (job.Thread == JOB_SYSTEM_MAIN_THREAD)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mainQueue.Mutex);
+			mainQueue.Jobs.push_back(job);
+		}
+		mainPending++;
+
+		// Only the main thread can run it, and it may be asleep
+		// among the others
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wake.notify_all();
+		return;
+	}
+
+	JobQueue& queue = currentSystem == this ? *queues[currentWorker] : sharedQueue;
+	{
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		queue.Jobs.push_back(job);
+	}
+	pending++;
+
+	std::lock_guard<std::mutex> lock(sleepMutex);
+	wake.notify_one();
+}
+
+// --------------------------------------------------------
+// Runs one job, if there's one this thread can run: main
+// thread jobs first (on the main thread), then the newest
+// from its own queue, then the oldest from the shared queue
+// or another worker's queue
+//
+// worker     - The calling thread's worker index, or -1
+// mainThread - Is the calling thread the main thread?
+//
+// Returns false if there was nothing to run
+// --------------------------------------------------------
+bool JobSystem::TryRunJob(int worker, bool mainThread)
+{
+	JobSystemJob job;
+	bool found = false;
+	bool stolen = false;
+
+	if (mainThread && mainPending > 0)
+	{
+		std::lock_guard<std::mutex> lock(mainQueue.Mutex);
+		if (!mainQueue.Jobs.empty())
+		{
+			job = mainQueue.Jobs.front();
+			mainQueue.Jobs.pop_front();
+			mainPending--;
+			mainThreadJobs++;
+			found = true;
+		}
+	}
+
+	if (!found && worker >= 0)
+	{
+		JobQueue& own = *queues[worker];
+		std::lock_guard<std::mutex> lock(own.Mutex);
+		if (!own.Jobs.empty())
+		{
+			job = own.Jobs.back();
+			own.Jobs.pop_back();
+			found = true;
+		}
+	}
+
+	if (!found)
+	{
+		std::lock_guard<std::mutex> lock(sharedQueue.Mutex);
+		if (!sharedQueue.Jobs.empty())
+		{
+			job = sharedQueue.Jobs.front();
+			sharedQueue.Jobs.pop_front();
+			found = true;
+		}
+	}
+
+	// Steal, starting with the next worker along so thieves
+	// spread out rather than all hitting the first queue
+	unsigned int queueCount = (unsigned int)queues.size();
+	for (unsigned int i = 1; !found && i <= queueCount; i++)
+	{
+		unsigned int victim = (unsigned int)(worker + i + queueCount) % queueCount;
+		if ((int)victim == worker)
+			continue;
+
+		JobQueue& queue = *queues[victim];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		if (!queue.Jobs.empty())
+		{
+			job = queue.Jobs.front();
+			queue.Jobs.pop_front();
+			found = stolen = true;
+		}
+	}
+
+	if (!found)
+		return false;
+
+	if (job.Thread != JOB_SYSTEM_MAIN_THREAD)
+		pending--;
+	if (stolen)
+		jobsStolen++;
+
+	job.Work();
+	jobsRun++;
+	Finish(job.Counter);
+	return true;
+}
+
+// --------------------------------------------------------
+// Counts a job as finished, queuing anything that was
+// waiting for its counter to reach zero
+// --------------------------------------------------------
+void JobSystem::Finish(JobCounter* counter)
+{
+	if (!counter)
+		return;
+
+	std::vector<JobSystemJob> ready;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (counter->count.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+		ready.swap(counter->dependents);
+	}
+
+	// The counter may be gone from here on, as waiting on it
+	// can now return
+	for (auto& job : ready)
+		Queue(job);
+
+	std::lock_guard<std::mutex> lock(sleepMutex);
+	wake.notify_all();
+}
+
+// --------------------------------------------------------
+// Runs jobs until the system is destroyed, sleeping
+// whenever there are none
+// --------------------------------------------------------
+void JobSystem::WorkerLoop(unsigned int worker)
+{
+	PROFILE_THREAD("Job System Worker");
+	currentSystem = this;
+	currentWorker = (int)worker;
+
+	while (true)
+	{
+		if (TryRunJob((int)worker, false))
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [&]() { return pending > 0 || stopping; });
+		if (stopping && pending <= 0)
+			break;
+	}
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Where a job is allowed to run
+#define JOB_SYSTEM_ANY_THREAD	0	// Any worker, or any thread waiting on a counter
+#define JOB_SYSTEM_MAIN_THREAD	1	// Only the main thread (for D3D context work)
+
+// A job waiting for its turn
+struct JobSystemJob
+{
+	std::function<void()> Work;
+	class JobCounter* Counter;
+	unsigned int Thread;
+};
+
+// --------------------------------------------------------
+// Counts jobs that haven't finished yet.  Jobs are added to
+// a counter when they're queued, and waiting on it returns
+// once they've all finished.  Jobs can also be queued to
+// start only once a counter reaches zero, which is how jobs
+// depend on each other.
+//
+// A counter must outlive every job using it.
+// --------------------------------------------------------
+class JobCounter
+{
+public:
+	JobCounter() : count(0) {}
+	JobCounter(const JobCounter&) = delete;
+	void operator=(const JobCounter&) = delete;
+
+	bool IsDone() const { return count.load(std::memory_order_acquire) == 0; }
+	unsigned int GetCount() const { return count.load(std::memory_order_acquire); }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<unsigned int> count;
+
+	// Jobs waiting for this to reach zero
+	std::mutex mutex;
+	std::vector<JobSystemJob> dependents;
+};
+
+// --------------------------------------------------------
+// Totals since the stats were last reset
+// --------------------------------------------------------
+struct JobSystemStats
+{
+	unsigned long long JobsRun = 0;
+	unsigned long long JobsStolen = 0;		// Taken from another thread's queue
+	unsigned long long MainThreadJobs = 0;
+};
+
+// --------------------------------------------------------
+// Runs jobs on a fixed set of worker threads that last as
+// long as the system does.
+//
+// Each worker has its own queue: it adds and takes jobs at
+// the back (so the newest, most likely still cached, work
+// goes first) while idle threads steal from the front of
+// others' queues.  Threads that aren't workers queue jobs
+// on a shared queue.  Any thread waiting on a counter runs
+// other jobs meanwhile rather than blocking, so jobs can
+// queue and wait on more jobs.
+//
+// Jobs that must stay on the main thread go on a queue of
+// their own, run only while the main thread waits on a
+// counter or calls RunMainThreadJobs().
+//
+// Has no knowledge of Direct3D, so it can be exercised on
+// its own.
+// --------------------------------------------------------
+class JobSystem
+{
+public:
+	// Zero workers runs every job on waiting threads
+	JobSystem(unsigned int workerCount);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	void operator=(const JobSystem&) = delete;
+
+	// The system shared by the whole program, with a worker
+	// for each hardware thread beyond the first
+	static JobSystem& GetInstance();
+
+	// Queuing jobs, which are added to the counter (if any).
+	// Jobs with a dependency wait until it reaches zero.
+	void Run(
+		const std::function<void()>& work,
+		JobCounter* counter,
+		unsigned int thread = JOB_SYSTEM_ANY_THREAD,
+		JobCounter* dependency = 0);
+
+	// Runs other jobs until the counter reaches zero
+	void Wait(JobCounter* counter);
+
+	// Splits [0, count) into chunks of at least grainSize and
+	// runs them as jobs, returning once they've all finished
+	void ParallelFor(unsigned int count, unsigned int grainSize, const std::function<void(unsigned int start, unsigned int end)>& body);
+
+	// The main thread is the one that created the system,
+	// unless another claims it
+	void SetMainThread();
+	bool IsMainThread() { return std::this_thread::get_id() == mainThread; }
+	unsigned int RunMainThreadJobs();
+
+	// Workers, plus a thread that waits
+	unsigned int GetThreadCount() { return (unsigned int)workers.size() + 1; }
+
+	JobSystemStats GetStats();
+	void ResetStats();
+
+private:
+	// A worker's jobs, locked only briefly to add or take one
+	struct JobQueue
+	{
+		std::mutex Mutex;
+		std::deque<JobSystemJob> Jobs;
+	};
+
+	void Queue(const JobSystemJob& job);
+	bool TryRunJob(int worker, bool mainThread);
+	void Finish(JobCounter* counter);
+	void WorkerLoop(unsigned int worker);
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<JobQueue>> queues;	// One per worker
+	JobQueue sharedQueue;							// From other threads
+	JobQueue mainQueue;								// For the main thread only
+	std::thread::id mainThread;
+
+	// Sleeping and waking threads with nothing to do
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> pending;		// Any thread jobs queued
+	std::atomic<int> mainPending;	// Main thread jobs queued
+	bool stopping;
+
+	std::atomic<unsigned long long> jobsRun;
+	std::atomic<unsigned long long> jobsStolen;
+	std::atomic<unsigned long long> mainThreadJobs;
+};
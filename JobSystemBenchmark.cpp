@@ -0,0 +1,278 @@
+#include "JobSystemBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+
+// Busy work that can't be optimized away
+static unsigned int Spin(unsigned int seed, unsigned int iterations)
+{
+	for (unsigned int i = 0; i < iterations; i++)
+		seed = seed * 1664525u + 1013904223u;
+	return seed;
+}
+
+// Milliseconds since a time
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+
+// === STRESS TESTS =================================================
+
+// Lots of tiny jobs on one counter
+static bool TestCounters(JobSystem& jobs)
+{
+	const unsigned int jobCount = 20000;
+	std::atomic<unsigned int> sum(0);
+	JobCounter counter;
+	for (unsigned int i = 0; i < jobCount; i++)
+		jobs.Run([&sum, i]() { sum += i; }, &counter);
+	jobs.Wait(&counter);
+
+	return counter.IsDone() && sum == jobCount * (jobCount - 1) / 2;
+}
+
+// Jobs that run parallel loops of their own
+static bool TestNesting(JobSystem& jobs)
+{
+	const unsigned int outerCount = 64;
+	const unsigned int innerCount = 1000;
+	std::vector<std::atomic<unsigned int>> visits(outerCount * innerCount);
+	for (auto& v : visits)
+		v = 0;
+
+	JobCounter counter;
+	for (unsigned int o = 0; o < outerCount; o++)
+	{
+		jobs.Run([&jobs, &visits, o]()
+		{
+			jobs.ParallelFor(innerCount, 16, [&visits, o](unsigned int start, unsigned int end)
+			{
+				for (unsigned int i = start; i < end; i++)
+					visits[o * innerCount + i]++;
+			});
+		}, &counter);
+	}
+	jobs.Wait(&counter);
+
+	for (auto& v : visits)
+	{
+		if (v != 1)
+			return false;
+	}
+	return true;
+}
+
+// A chain of stages, each of which must start only once
+// every job of the stage before it has finished
+static bool TestDependencies(JobSystem& jobs)
+{
+	const unsigned int stageCount = 100;
+	const unsigned int jobsPerStage = 8;
+	std::vector<std::unique_ptr<JobCounter>> stages;
+	std::vector<std::atomic<unsigned int>> finished(stageCount);
+	std::atomic<bool> inOrder(true);
+	for (unsigned int s = 0; s < stageCount; s++)
+	{
+		finished[s] = 0;
+		stages.push_back(std::unique_ptr<JobCounter>(new JobCounter()));
+	}
+
+	for (unsigned int s = 0; s < stageCount; s++)
+	{
+		for (unsigned int j = 0; j < jobsPerStage; j++)
+		{
+			jobs.Run([&finished, &inOrder, s, j]()
+			{
+				if (s > 0 && finished[s - 1] != jobsPerStage)
+					inOrder = false;
+				Spin(j, 100);
+				finished[s]++;
+			}, stages[s].get(), JOB_SYSTEM_ANY_THREAD, s > 0 ? stages[s - 1].get() : 0);
+		}
+	}
+
+	// Every stage has to be waited on, as a counter can't go
+	// away while jobs depending on it are still being queued
+	for (auto& stage : stages)
+		jobs.Wait(stage.get());
+
+	return inOrder && finished[stageCount - 1] == jobsPerStage;
+}
+
+// Main thread jobs queued from other threads, which must
+// only ever run on the main thread
+static bool TestMainThreadJobs(JobSystem& jobs)
+{
+	const unsigned int jobCount = 256;
+	std::thread::id mainThread = std::this_thread::get_id();
+	std::atomic<unsigned int> onMainThread(0);
+
+	JobCounter counter;
+	for (unsigned int i = 0; i < jobCount; i++)
+	{
+		jobs.Run([&jobs, &counter, &onMainThread, mainThread]()
+		{
+			jobs.Run([&onMainThread, mainThread]()
+			{
+				if (std::this_thread::get_id() == mainThread)
+					onMainThread++;
+			}, &counter, JOB_SYSTEM_MAIN_THREAD);
+		}, &counter);
+	}
+	jobs.Wait(&counter);
+
+	return onMainThread == jobCount;
+}
+
+// Every item of ranges of awkward sizes visited exactly once
+static bool TestParallelFor(JobSystem& jobs)
+{
+	const unsigned int counts[] = { 0, 1, 7, 1000, 100003 };
+	const unsigned int grains[] = { 1, 16, 1000 };
+	for (unsigned int count : counts)
+	{
+		for (unsigned int grain : grains)
+		{
+			std::vector<std::atomic<unsigned int>> visits(count);
+			for (auto& v : visits)
+				v = 0;
+
+			jobs.ParallelFor(count, grain, [&visits](unsigned int start, unsigned int end)
+			{
+				for (unsigned int i = start; i < end; i++)
+					visits[i]++;
+			});
+
+			for (auto& v : visits)
+			{
+				if (v != 1)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Runs each stress test for a number of rounds, stopping a
+// test at its first failure
+//
+// jobs    - System to test, created on the calling thread
+// rounds  - Times to repeat each test
+// results - Receives a result per test
+// --------------------------------------------------------
+void RunJobSystemStressTest(JobSystem& jobs, unsigned int rounds, std::vector<ValidationResult>* results)
+{
+	const ValidationTest<JobSystem&> tests[] = {
+		{ "Counters", TestCounters },
+		{ "Nesting", TestNesting },
+		{ "Dependencies", TestDependencies },
+		{ "Main Thread", TestMainThreadJobs },
+		{ "Parallel For", TestParallelFor } };
+
+	RunValidationTests(tests, rounds, results, jobs);
+}
+
+
+// === BENCHMARK ====================================================
+
+// --------------------------------------------------------
+// How ParallelFor() used to work: a thread started per
+// core for every loop, each taking one even chunk
+// --------------------------------------------------------
+static void ThreadPerCallFor(unsigned int threadCount, unsigned int count, const std::function<void(unsigned int start, unsigned int end)>& body)
+{
+	threadCount = (std::min)(threadCount, count);
+	if (threadCount <= 1)
+	{
+		body(0, count);
+		return;
+	}
+
+	unsigned int chunkSize = count / threadCount;
+	unsigned int remainder = count % threadCount;
+
+	std::vector<std::thread> workers;
+	unsigned int start = chunkSize + (remainder > 0 ? 1 : 0);
+	for (unsigned int t = 1; t < threadCount; t++)
+	{
+		unsigned int size = chunkSize + (t < remainder ? 1 : 0);
+		workers.push_back(std::thread(std::cref(body), start, start + size));
+		start += size;
+	}
+
+	body(0, chunkSize + (remainder > 0 ? 1 : 0));
+
+	for (auto& w : workers)
+		w.join();
+}
+
+// --------------------------------------------------------
+// Times each workload run sequentially, with a thread per
+// core started for every loop, and with the job system
+//
+// jobs    - System to time, created on the calling thread
+// timings - Receives a timing per workload
+// --------------------------------------------------------
+void RunJobSystemBenchmark(JobSystem& jobs, std::vector<JobSystemBenchmarkTiming>* timings)
+{
+	timings->clear();
+
+	struct Workload
+	{
+		const char* Name;
+		unsigned int Loops;		// Parallel loops run, one after another
+		unsigned int Count;		// Items per loop
+		bool Uneven;			// Do a few items take far longer?
+	};
+	const Workload workloads[] = {
+		{ "Many Small Loops", 2000, 256, false },
+		{ "One Large Loop", 1, 1 << 20, false },
+		{ "Uneven Loop", 20, 4096, true } };
+
+	for (const Workload& workload : workloads)
+	{
+		// Each item's result is kept, so every way can be checked
+		std::vector<unsigned int> results[3];
+		double times[3] = {};
+		for (int method = 0; method < 3; method++)
+		{
+			std::vector<unsigned int>& out = results[method];
+			out.assign(workload.Count, 0);
+
+			auto body = [&](unsigned int start, unsigned int end)
+			{
+				for (unsigned int i = start; i < end; i++)
+				{
+					unsigned int iterations = workload.Uneven && i % 64 == 0 ? 20000 : 50;
+					out[i] += Spin(i, iterations);
+				}
+			};
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (unsigned int l = 0; l < workload.Loops; l++)
+			{
+				switch (method)
+				{
+				case 0: body(0, workload.Count); break;
+				case 1: ThreadPerCallFor(jobs.GetThreadCount(), workload.Count, body); break;
+				case 2: jobs.ParallelFor(workload.Count, 1, body); break;
+				}
+			}
+			times[method] = MillisecondsSince(start);
+		}
+
+		JobSystemBenchmarkTiming timing;
+		timing.Workload = workload.Name;
+		timing.SequentialTime = times[0];
+		timing.ThreadPerCallTime = times[1];
+		timing.JobSystemTime = times[2];
+		timing.Matches = results[0] == results[1] && results[0] == results[2];
+		timings->push_back(timing);
+	}
+}
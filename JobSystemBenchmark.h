@@ -0,0 +1,27 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "Validation.h"
+
+#include <vector>
+
+// --------------------------------------------------------
+// Milliseconds to run one workload each way
+// --------------------------------------------------------
+struct JobSystemBenchmarkTiming
+{
+	const char* Workload;
+	double SequentialTime;
+	double ThreadPerCallTime;	// Starting threads for every loop
+	double JobSystemTime;
+	bool Matches;				// Did every way compute the same result?
+};
+
+// Checks counters, nesting, dependencies, main thread jobs
+// and ParallelFor() coverage, repeating each test to shake
+// out races.  Must be called from the system's main thread.
+void RunJobSystemStressTest(JobSystem& jobs, unsigned int rounds, std::vector<ValidationResult>* results);
+
+// Times a few kinds of parallel loop against running them
+// sequentially and against starting threads for each loop
+void RunJobSystemBenchmark(JobSystem& jobs, std::vector<JobSystemBenchmarkTiming>* timings);
@@ -0,0 +1,578 @@
+#include "LightClusters.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits.h>
+#include <math.h>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Starts with empty results (and no grid bounds)
+// --------------------------------------------------------
+LightClusters::LightClusters() :
+	boundsFrustum(),
+	boundsValid(false),
+	depthScale(0),
+	depthBias(0),
+	firstCullLight(0),
+	maxLightsPerCluster(0),
+	fullClusterCount(0)
+{
+	bounds.resize(CLUSTER_COUNT);
+	sliceLights.resize(CLUSTER_GRID_Z);
+	clusterLights.resize(CLUSTER_COUNT);
+	clusterRanges.resize(CLUSTER_COUNT);
+}
+
+// --------------------------------------------------------
+// Assigns lights to clusters, culling each light against
+// only the clusters near it, spread across threads
+//
+// frustum       - The camera to build the grid for
+// lights        - Packed lights (as uploaded to the GPU)
+// firstLight    - Index of the first non-directional light
+// multithreaded - Whether to use more than this thread
+// --------------------------------------------------------
+void LightClusters::Build(const ClusterFrustum& frustum, const std::vector<Light>& lights, unsigned int firstLight, bool multithreaded)
+{
+	UpdateBounds(frustum);
+	PrepareLights(frustum, lights, firstLight, multithreaded);
+
+	// Bin each light into the depth slices it might touch,
+	// which keeps every slice's list in light order
+	for (auto& s : sliceLights)
+		s.clear();
+
+	for (unsigned int i = 0; i < cullLights.size(); i++)
+	{
+		for (unsigned int z = cullLights[i].FirstSlice; z <= cullLights[i].LastSlice; z++)
+			sliceLights[z].push_back(i);
+	}
+
+	// Each slice owns its own clusters, so they can be
+	// culled in parallel without any locking
+	if (multithreaded)
+	{
+		ParallelFor(CLUSTER_GRID_Z, [&](unsigned int start, unsigned int end)
+		{
+			for (unsigned int z = start; z < end; z++)
+				CullSlice(z);
+		});
+	}
+	else
+	{
+		for (unsigned int z = 0; z < CLUSTER_GRID_Z; z++)
+			CullSlice(z);
+	}
+
+	GatherResults();
+}
+
+// --------------------------------------------------------
+// Assigns lights to clusters by testing every light against
+// every cluster, without any of the code Build() uses.  Slow,
+// but simple enough to trust, so it serves as the reference
+// for validating Build() with MatchesReference().
+//
+// Lists aren't limited to CLUSTER_MAX_LIGHTS, and lights
+// within rounding distance of a cluster are kept apart, as
+// a build could go either way with them.
+//
+// frustum    - The camera to build the grid for
+// lights     - Packed lights (as uploaded to the GPU)
+// firstLight - Index of the first non-directional light
+// --------------------------------------------------------
+void LightClusters::BuildReference(const ClusterFrustum& frustum, const std::vector<Light>& lights, unsigned int firstLight)
+{
+	const double pi = 3.14159265358979323846;
+	const XMFLOAT4X4& v = frustum.View;
+	borderlineLights.resize(CLUSTER_COUNT);
+
+	// Size of the view volume at a depth of 1 (perspective),
+	// or at every depth (orthographic)
+	double halfHeight = frustum.Orthographic ?
+		frustum.OrthographicWidth / (double)frustum.AspectRatio / 2 :
+		tan(frustum.FieldOfView / 2.0);
+	double halfWidth = frustum.Orthographic ?
+		frustum.OrthographicWidth / 2.0 :
+		halfHeight * frustum.AspectRatio;
+
+	for (unsigned int c = 0; c < CLUSTER_COUNT; c++)
+	{
+		unsigned int x = c % CLUSTER_GRID_X;
+		unsigned int y = (c / CLUSTER_GRID_X) % CLUSTER_GRID_Y;
+		unsigned int z = c / (CLUSTER_GRID_X * CLUSTER_GRID_Y);
+
+		// The cluster's box: around its eight corners, found
+		// from the screen rectangle of its tile at the depths
+		// that bound its slice
+		double depths[2] = {
+			frustum.NearClip * pow((double)frustum.FarClip / frustum.NearClip, (double)z / CLUSTER_GRID_Z),
+			frustum.NearClip * pow((double)frustum.FarClip / frustum.NearClip, (double)(z + 1) / CLUSTER_GRID_Z) };
+		double screenX[2] = { -1.0 + 2.0 * x / CLUSTER_GRID_X, -1.0 + 2.0 * (x + 1) / CLUSTER_GRID_X };
+		double screenY[2] = { 1.0 - 2.0 * y / CLUSTER_GRID_Y, 1.0 - 2.0 * (y + 1) / CLUSTER_GRID_Y };
+
+		double boxMin[3] = { 1e30, 1e30, 1e30 };
+		double boxMax[3] = { -1e30, -1e30, -1e30 };
+		for (unsigned int corner = 0; corner < 8; corner++)
+		{
+			double depth = depths[corner & 1];
+			double scale = frustum.Orthographic ? 1.0 : depth;
+			double point[3] = {
+				screenX[(corner >> 1) & 1] * halfWidth * scale,
+				screenY[(corner >> 2) & 1] * halfHeight * scale,
+				depth };
+			for (unsigned int axis = 0; axis < 3; axis++)
+			{
+				boxMin[axis] = (std::min)(boxMin[axis], point[axis]);
+				boxMax[axis] = (std::max)(boxMax[axis], point[axis]);
+			}
+		}
+
+		// And the sphere around that box, for cones
+		double center[3];
+		double clusterRadiusSq = 0;
+		for (unsigned int axis = 0; axis < 3; axis++)
+		{
+			center[axis] = (boxMin[axis] + boxMax[axis]) / 2;
+			clusterRadiusSq += (boxMax[axis] - center[axis]) * (boxMax[axis] - center[axis]);
+		}
+		double clusterRadius = sqrt(clusterRadiusSq);
+
+		std::vector<unsigned int>& list = clusterLights[c];
+		std::vector<unsigned int>& borderline = borderlineLights[c];
+		list.clear();
+		borderline.clear();
+
+		for (unsigned int i = firstLight; i < lights.size(); i++)
+		{
+			const Light& light = lights[i];
+
+			// Light position and direction in view space (the
+			// view matrix is applied to row vectors)
+			double pos[3], dir[3];
+			for (unsigned int axis = 0; axis < 3; axis++)
+			{
+				pos[axis] = light.Position.x * v.m[0][axis] + light.Position.y * v.m[1][axis] + light.Position.z * v.m[2][axis] + v.m[3][axis];
+				dir[axis] = light.Direction.x * v.m[0][axis] + light.Direction.y * v.m[1][axis] + light.Direction.z * v.m[2][axis];
+			}
+
+			// How far inside the cluster the light's sphere reaches
+			// (negative if it falls short), from the distance to
+			// the nearest point of the box
+			double distSq = 0;
+			for (unsigned int axis = 0; axis < 3; axis++)
+			{
+				double outside = (std::max)(boxMin[axis] - pos[axis], (std::max)(0.0, pos[axis] - boxMax[axis]));
+				distSq += outside * outside;
+			}
+			double margin = light.Range - sqrt(distSq);
+
+			// Spot lights only reach as far out from their direction
+			// as the angle where pow(cos, falloff) hits the cutoff,
+			// so also find how far the cluster's sphere is from
+			// that cone
+			if (light.Type == LIGHT_TYPE_SPOT && light.SpotFalloff > 0.0f)
+			{
+				double coneAngle = acos(pow((double)CLUSTER_SPOT_CUTOFF, 1.0 / light.SpotFalloff));
+				double toCluster[3] = { center[0] - pos[0], center[1] - pos[1], center[2] - pos[2] };
+				double distance = sqrt(toCluster[0] * toCluster[0] + toCluster[1] * toCluster[1] + toCluster[2] * toCluster[2]);
+				double dirLength = sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+
+				// Distance from the cone to the cluster's center: none
+				// inside it, straight to the tip when that's the closest
+				// point, and otherwise to the nearest edge
+				double coneDistance = 0;
+				if (distance > 0 && dirLength > 0)
+				{
+					double cosAngle = (toCluster[0] * dir[0] + toCluster[1] * dir[1] + toCluster[2] * dir[2]) / (distance * dirLength);
+					double angle = acos((std::max)(-1.0, (std::min)(1.0, cosAngle)));
+					if (angle - coneAngle >= pi / 2)
+						coneDistance = distance;
+					else if (angle > coneAngle)
+						coneDistance = distance * sin(angle - coneAngle);
+				}
+				margin = (std::min)(margin, clusterRadius - coneDistance);
+			}
+
+			// Builds round in single precision, so anything close
+			// to the edge could go either way
+			double tolerance = 1e-4 * (1.0 + light.Range + depths[1]);
+			if (margin > tolerance)
+				list.push_back(i);
+			else if (margin >= -tolerance)
+				borderline.push_back(i);
+		}
+	}
+
+	GatherResults();
+}
+
+// --------------------------------------------------------
+// Determines if two builds produced exactly the same lists
+// --------------------------------------------------------
+bool LightClusters::Matches(const LightClusters& other) const
+{
+	if (lightIndices != other.lightIndices)
+		return false;
+
+	for (unsigned int c = 0; c < CLUSTER_COUNT; c++)
+	{
+		if (clusterRanges[c].Offset != other.clusterRanges[c].Offset ||
+			clusterRanges[c].Count != other.clusterRanges[c].Count)
+			return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Determines if a build agrees with a reference build: every
+// light it lists must be in the reference (or borderline),
+// and every light the reference lists must be there too, up
+// to the last one that fit if a list is full
+//
+// reference - Made with BuildReference()
+// --------------------------------------------------------
+bool LightClusters::MatchesReference(const LightClusters& reference) const
+{
+	for (unsigned int c = 0; c < CLUSTER_COUNT; c++)
+	{
+		// Every list is in light order, so they can be searched
+		auto first = lightIndices.begin() + clusterRanges[c].Offset;
+		auto last = first + clusterRanges[c].Count;
+		const std::vector<unsigned int>& certain = reference.clusterLights[c];
+		const std::vector<unsigned int>& borderline = reference.borderlineLights[c];
+
+		for (auto light = first; light != last; ++light)
+		{
+			if (!std::binary_search(certain.begin(), certain.end(), *light) &&
+				!std::binary_search(borderline.begin(), borderline.end(), *light))
+				return false;
+		}
+
+		unsigned int limit = clusterRanges[c].Count == CLUSTER_MAX_LIGHTS ? *(last - 1) : UINT_MAX;
+		for (unsigned int light : certain)
+		{
+			if (light > limit)
+				break;
+			if (!std::binary_search(first, last, light))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Calculates the view-space bounds of every cluster, but
+// only when the projection has changed since last time
+// --------------------------------------------------------
+void LightClusters::UpdateBounds(const ClusterFrustum& frustum)
+{
+	if (boundsValid &&
+		boundsFrustum.FieldOfView == frustum.FieldOfView &&
+		boundsFrustum.AspectRatio == frustum.AspectRatio &&
+		boundsFrustum.NearClip == frustum.NearClip &&
+		boundsFrustum.FarClip == frustum.FarClip &&
+		boundsFrustum.Orthographic == frustum.Orthographic &&
+		boundsFrustum.OrthographicWidth == frustum.OrthographicWidth)
+		return;
+
+	boundsFrustum = frustum;
+	boundsValid = true;
+
+	// Depth slices are spaced exponentially, so that clusters
+	// stay roughly cube shaped as they get further away
+	float nearClip = frustum.NearClip;
+	float farClip = frustum.FarClip;
+	float logRatio = logf(farClip / nearClip);
+	depthScale = CLUSTER_GRID_Z / logRatio;
+	depthBias = -CLUSTER_GRID_Z * logf(nearClip) / logRatio;
+
+	// Half-extents of the view volume, either at a depth of 1
+	// (perspective) or for all depths (orthographic)
+	float halfHeight = frustum.Orthographic ?
+		frustum.OrthographicWidth / frustum.AspectRatio * 0.5f :
+		tanf(frustum.FieldOfView * 0.5f);
+	float halfWidth = frustum.Orthographic ?
+		frustum.OrthographicWidth * 0.5f :
+		halfHeight * frustum.AspectRatio;
+
+	for (unsigned int z = 0; z < CLUSTER_GRID_Z; z++)
+	{
+		float sliceNear = nearClip * powf(farClip / nearClip, (float)z / CLUSTER_GRID_Z);
+		float sliceFar = nearClip * powf(farClip / nearClip, (float)(z + 1) / CLUSTER_GRID_Z);
+
+		// Perspective extents grow with depth
+		float scaleNear = frustum.Orthographic ? 1.0f : sliceNear;
+		float scaleFar = frustum.Orthographic ? 1.0f : sliceFar;
+
+		for (unsigned int y = 0; y < CLUSTER_GRID_Y; y++)
+		{
+			// Row zero is the top of the screen
+			float top = (1.0f - 2.0f * y / CLUSTER_GRID_Y) * halfHeight;
+			float bottom = (1.0f - 2.0f * (y + 1) / CLUSTER_GRID_Y) * halfHeight;
+
+			for (unsigned int x = 0; x < CLUSTER_GRID_X; x++)
+			{
+				float left = (-1.0f + 2.0f * x / CLUSTER_GRID_X) * halfWidth;
+				float right = (-1.0f + 2.0f * (x + 1) / CLUSTER_GRID_X) * halfWidth;
+
+				ClusterBounds& b = bounds[x + y * CLUSTER_GRID_X + z * CLUSTER_GRID_X * CLUSTER_GRID_Y];
+				b.Min = XMFLOAT3(
+					fminf(left * scaleNear, left * scaleFar),
+					fminf(bottom * scaleNear, bottom * scaleFar),
+					sliceNear);
+				b.Max = XMFLOAT3(
+					fmaxf(right * scaleNear, right * scaleFar),
+					fmaxf(top * scaleNear, top * scaleFar),
+					sliceFar);
+
+				// Sphere around the box for cone tests
+				XMVECTOR boxMin = XMLoadFloat3(&b.Min);
+				XMVECTOR boxMax = XMLoadFloat3(&b.Max);
+				XMVECTOR center = (boxMin + boxMax) * 0.5f;
+				XMVECTOR radius = XMVector3Length(boxMax - center);
+				XMStoreFloat4(&b.Sphere, XMVectorSelect(center, radius, g_XMSelect0001));
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Converts the non-directional lights to view space and
+// finds the (conservative) range of slices for each
+// --------------------------------------------------------
+void LightClusters::PrepareLights(const ClusterFrustum& frustum, const std::vector<Light>& lights, unsigned int firstLight, bool multithreaded)
+{
+	firstCullLight = firstLight;
+	cullLights.resize(firstLight < lights.size() ? lights.size() - firstLight : 0);
+
+	XMMATRIX view = XMLoadFloat4x4(&frustum.View);
+
+	auto prepare = [&](unsigned int start, unsigned int end)
+	{
+		for (unsigned int i = start; i < end; i++)
+		{
+			const Light& light = lights[firstLight + i];
+			CullLight& cull = cullLights[i];
+
+			// Position and direction in view space
+			XMVECTOR pos = XMVector3TransformCoord(XMLoadFloat3(&light.Position), view);
+			XMVECTOR dir = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&light.Direction), view));
+			XMStoreFloat4(&cull.Sphere, XMVectorSetW(pos, light.Range));
+			XMStoreFloat3(&cull.Direction, dir);
+
+			// Spot lights fade out as pow(cos, falloff), so find the
+			// angle where that reaches the cutoff.  No falloff means
+			// there's no cone to cull with.
+			cull.IsSpot = light.Type == LIGHT_TYPE_SPOT && light.SpotFalloff > 0.0f;
+			cull.CosAngle = cull.IsSpot ? powf(CLUSTER_SPOT_CUTOFF, 1.0f / light.SpotFalloff) : -1.0f;
+			cull.SinAngle = sqrtf(fmaxf(0.0f, 1.0f - cull.CosAngle * cull.CosAngle));
+
+			// Which slices could the light touch?  Expanded by one
+			// in each direction, as the exact tests come later.
+			float minDepth = cull.Sphere.z - light.Range;
+			float maxDepth = cull.Sphere.z + light.Range;
+			if (maxDepth < frustum.NearClip || minDepth > frustum.FarClip)
+			{
+				cull.FirstSlice = 1;
+				cull.LastSlice = 0;
+				continue;
+			}
+
+			int first = (int)floorf(logf(fmaxf(minDepth, frustum.NearClip)) * depthScale + depthBias) - 1;
+			int last = (int)floorf(logf(fminf(maxDepth, frustum.FarClip)) * depthScale + depthBias) + 1;
+			cull.FirstSlice = first < 0 ? 0 : (unsigned int)first;
+			cull.LastSlice = last > CLUSTER_GRID_Z - 1 ? CLUSTER_GRID_Z - 1 : (unsigned int)last;
+		}
+	};
+
+	if (multithreaded)
+		ParallelFor((unsigned int)cullLights.size(), prepare);
+	else
+		prepare(0, (unsigned int)cullLights.size());
+}
+
+// --------------------------------------------------------
+// Builds the light lists for every cluster in one slice,
+// from the lights binned into that slice
+// --------------------------------------------------------
+void LightClusters::CullSlice(unsigned int slice)
+{
+	const unsigned int sliceStart = slice * CLUSTER_GRID_X * CLUSTER_GRID_Y;
+	for (unsigned int c = 0; c < CLUSTER_GRID_X * CLUSTER_GRID_Y; c++)
+		clusterLights[sliceStart + c].clear();
+
+	for (unsigned int i : sliceLights[slice])
+	{
+		const CullLight& light = cullLights[i];
+		float radius = light.Sphere.w;
+
+		// Narrow down the columns and rows whose boxes overlap the
+		// light's box, which is every cluster that could pass the
+		// exact test.  Column extents don't depend on the row
+		// (and vice versa), so the first row/column are enough.
+		unsigned int firstX = CLUSTER_GRID_X, lastX = 0;
+		for (unsigned int x = 0; x < CLUSTER_GRID_X; x++)
+		{
+			const ClusterBounds& b = bounds[sliceStart + x];
+			if (b.Max.x >= light.Sphere.x - radius && b.Min.x <= light.Sphere.x + radius)
+			{
+				if (firstX == CLUSTER_GRID_X) firstX = x;
+				lastX = x;
+			}
+		}
+
+		unsigned int firstY = CLUSTER_GRID_Y, lastY = 0;
+		for (unsigned int y = 0; y < CLUSTER_GRID_Y; y++)
+		{
+			const ClusterBounds& b = bounds[sliceStart + y * CLUSTER_GRID_X];
+			if (b.Max.y >= light.Sphere.y - radius && b.Min.y <= light.Sphere.y + radius)
+			{
+				if (firstY == CLUSTER_GRID_Y) firstY = y;
+				lastY = y;
+			}
+		}
+
+		if (firstX == CLUSTER_GRID_X || firstY == CLUSTER_GRID_Y)
+			continue;
+
+		// Exact tests for the remaining clusters
+		for (unsigned int y = firstY; y <= lastY; y++)
+		{
+			for (unsigned int x = firstX; x <= lastX; x++)
+			{
+				unsigned int c = sliceStart + x + y * CLUSTER_GRID_X;
+				if (clusterLights[c].size() < CLUSTER_MAX_LIGHTS && TestCluster(light, bounds[c]))
+					clusterLights[c].push_back(firstCullLight + i);
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Flattens the per-cluster lists into a single index list,
+// recording where each cluster's lights start
+// --------------------------------------------------------
+void LightClusters::GatherResults()
+{
+	lightIndices.clear();
+	maxLightsPerCluster = 0;
+	fullClusterCount = 0;
+
+	for (unsigned int c = 0; c < CLUSTER_COUNT; c++)
+	{
+		const std::vector<unsigned int>& list = clusterLights[c];
+		clusterRanges[c].Offset = (unsigned int)lightIndices.size();
+		clusterRanges[c].Count = (unsigned int)list.size();
+		lightIndices.insert(lightIndices.end(), list.begin(), list.end());
+
+		if (list.size() > maxLightsPerCluster)
+			maxLightsPerCluster = (unsigned int)list.size();
+
+		if (list.size() == CLUSTER_MAX_LIGHTS)
+			fullClusterCount++;
+	}
+}
+
+// --------------------------------------------------------
+// Tests a single light against a single cluster: the light's
+// sphere against the cluster's box, and then (for spot
+// lights) the light's cone against the cluster's sphere
+//
+// Returns true if the light may affect the cluster
+// --------------------------------------------------------
+bool LightClusters::TestCluster(const CullLight& light, const ClusterBounds& cluster) const
+{
+	// Closest point in the box to the sphere's center
+	XMVECTOR sphere = XMLoadFloat4(&light.Sphere);
+	XMVECTOR closest = XMVectorClamp(sphere, XMLoadFloat3(&cluster.Min), XMLoadFloat3(&cluster.Max));
+	float distSq = XMVectorGetX(XMVector3LengthSq(sphere - closest));
+	if (distSq > light.Sphere.w * light.Sphere.w)
+		return false;
+
+	if (!light.IsSpot)
+		return true;
+
+	// Cone vs. sphere, splitting the vector to the cluster into
+	// parts along and perpendicular to the cone's axis
+	XMVECTOR toCluster = XMLoadFloat4(&cluster.Sphere) - sphere;
+	float lengthSq = XMVectorGetX(XMVector3LengthSq(toCluster));
+	float along = XMVectorGetX(XMVector3Dot(toCluster, XMLoadFloat3(&light.Direction)));
+	float across = sqrtf(fmaxf(0.0f, lengthSq - along * along));
+	float clusterRadius = cluster.Sphere.w;
+
+	float distToCone = light.CosAngle * across - light.SinAngle * along;
+	if (distToCone > clusterRadius) return false;			// Outside the cone's angle
+	if (light.CosAngle * along + light.SinAngle * across < 0 &&
+		lengthSq > clusterRadius * clusterRadius) return false;	// Closest to the tip, but not touching it
+	if (along > clusterRadius + light.Sphere.w) return false;	// Beyond the cone's range
+	if (along < -clusterRadius) return false;				// Behind the cone
+
+	return true;
+}
+
+
+// === BENCHMARK ====================================================
+
+// --------------------------------------------------------
+// Validates the cluster assignment against the brute force
+// reference, and times it, at increasing light counts.
+// Lights come from a fixed seed so every run (and every
+// machine) tests exactly the same scenes.
+//
+// frustum - Camera to build the clusters for
+// timings - Filled in with one timing per light count
+// --------------------------------------------------------
+void RunClusterBenchmark(const ClusterFrustum& frustum, std::vector<ClusterTiming>* timings)
+{
+	timings->clear();
+
+	// Simple LCG, so the results don't depend on rand()
+	unsigned int seed = 12345;
+	auto random = [&seed](float min, float max)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return min + (seed >> 8) / 16777216.0f * (max - min);
+	};
+
+	for (unsigned int count = 1024; count <= MAX_LIGHTS; count *= 4)
+	{
+		// Half point lights, half spot lights
+		std::vector<Light> testLights(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			Light& light = testLights[i];
+			light = {};
+			light.Type = (i % 2 == 0) ? LIGHT_TYPE_POINT : LIGHT_TYPE_SPOT;
+			light.Position = XMFLOAT3(random(-10.0f, 10.0f), random(-5.0f, 5.0f), random(-10.0f, 10.0f));
+			light.Direction = XMFLOAT3(random(-1.0f, 1.0f), random(-1.0f, 0.0f), random(-1.0f, 1.0f));
+			light.Color = XMFLOAT3(1, 1, 1);
+			light.Range = random(1.0f, 5.0f);
+			light.Intensity = 1.0f;
+			light.SpotFalloff = random(1.0f, 50.0f);
+		}
+
+		ClusterTiming timing = {};
+		timing.LightCount = count;
+
+		LightClusters threaded, single, reference;
+		auto start = std::chrono::high_resolution_clock::now();
+		threaded.Build(frustum, testLights, 0, true);
+		auto singleStart = std::chrono::high_resolution_clock::now();
+		single.Build(frustum, testLights, 0, false);
+		auto referenceStart = std::chrono::high_resolution_clock::now();
+		reference.BuildReference(frustum, testLights, 0);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		timing.BuildTime = std::chrono::duration<double, std::milli>(singleStart - start).count();
+		timing.SingleThreadTime = std::chrono::duration<double, std::milli>(referenceStart - singleStart).count();
+		timing.ReferenceTime = std::chrono::duration<double, std::milli>(end - referenceStart).count();
+		timing.Matches = threaded.Matches(single) && single.MatchesReference(reference);
+		timings->push_back(timing);
+	}
+}
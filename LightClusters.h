@@ -0,0 +1,157 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Lights.h"
+
+// Size of the view-space cluster grid.  These defines
+// must match the ones in Clustering.hlsli
+#define CLUSTER_GRID_X		16
+#define CLUSTER_GRID_Y		9
+#define CLUSTER_GRID_Z		24
+#define CLUSTER_COUNT		(CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+
+// Most lights any single cluster will reference (any
+// more are dropped, keeping the lowest light indices)
+#define CLUSTER_MAX_LIGHTS	256
+
+// Spot lights are treated as having no effect once their
+// penumbra term drops below this value
+#define CLUSTER_SPOT_CUTOFF	(1.0f / 256.0f)
+
+// --------------------------------------------------------
+// The range of the light index list used by one cluster
+// (matches the uint2 read by the shader)
+// --------------------------------------------------------
+struct ClusterRange
+{
+	unsigned int Offset;
+	unsigned int Count;
+};
+
+// --------------------------------------------------------
+// The camera details the cluster grid is built from
+// --------------------------------------------------------
+struct ClusterFrustum
+{
+	DirectX::XMFLOAT4X4 View;
+	float FieldOfView;			// Vertical, in radians (perspective)
+	float AspectRatio;
+	float NearClip;
+	float FarClip;
+	bool Orthographic;
+	float OrthographicWidth;	// In world units (orthographic)
+};
+
+// --------------------------------------------------------
+// Assigns point and spot lights to a froxel grid: screen
+// tiles split into exponentially spaced view depth slices.
+// Each pixel then only needs to evaluate the lights listed
+// for the cluster it falls in.
+//
+// Build() culls lights against each cluster's view-space
+// bounding box (and spot cones against its bounding sphere)
+// using SIMD math across multiple threads.
+//
+// BuildReference() shares none of that code: it tests every
+// light against every cluster in double precision, working
+// out the boxes, view-space lights and cone angles itself.
+// MatchesReference() then checks that a build agrees with
+// it, other than for lights within rounding distance of a
+// cluster (which either answer is right for).
+// --------------------------------------------------------
+class LightClusters
+{
+public:
+	LightClusters();
+
+	void Build(const ClusterFrustum& frustum, const std::vector<Light>& lights, unsigned int firstLight, bool multithreaded = true);
+	void BuildReference(const ClusterFrustum& frustum, const std::vector<Light>& lights, unsigned int firstLight);
+
+	// Compares the lists of two builds, or of a build and the
+	// reference (for validation)
+	bool Matches(const LightClusters& other) const;
+	bool MatchesReference(const LightClusters& reference) const;
+
+	// Results for uploading
+	const std::vector<ClusterRange>& GetClusterRanges() const { return clusterRanges; }
+	const std::vector<unsigned int>& GetLightIndices() const { return lightIndices; }
+
+	// Values for converting view depth to a slice in the shader:
+	// slice = log(depth) * scale + bias
+	float GetDepthScale() const { return depthScale; }
+	float GetDepthBias() const { return depthBias; }
+
+	// Statistics from the last build
+	unsigned int GetMaxLightsPerCluster() const { return maxLightsPerCluster; }
+	unsigned int GetFullClusterCount() const { return fullClusterCount; }
+
+private:
+	// View-space box around a single cluster
+	struct ClusterBounds
+	{
+		DirectX::XMFLOAT3 Min;
+		DirectX::XMFLOAT3 Max;
+		DirectX::XMFLOAT4 Sphere; // Center and radius around the box
+	};
+
+	// A light converted to view space for culling
+	struct CullLight
+	{
+		DirectX::XMFLOAT4 Sphere;		// Center and range
+		DirectX::XMFLOAT3 Direction;	// Normalized (spot lights)
+		float CosAngle;					// Cone angle (spot lights)
+		float SinAngle;
+		bool IsSpot;
+		unsigned int FirstSlice;		// Conservative range of slices
+		unsigned int LastSlice;			// (Last < First if not visible)
+	};
+
+	// Bounds only change along with the camera's projection
+	ClusterFrustum boundsFrustum;
+	bool boundsValid;
+	std::vector<ClusterBounds> bounds;
+	float depthScale;
+	float depthBias;
+
+	// Working storage, kept between builds
+	std::vector<CullLight> cullLights;
+	unsigned int firstCullLight; // Index of cullLights[0] in the packed lights
+	std::vector<std::vector<unsigned int>> sliceLights;
+	std::vector<std::vector<unsigned int>> clusterLights;
+
+	// Lights too close to call for each cluster, which are
+	// left out of the lists (reference builds only)
+	std::vector<std::vector<unsigned int>> borderlineLights;
+
+	// Results
+	std::vector<ClusterRange> clusterRanges;
+	std::vector<unsigned int> lightIndices;
+	unsigned int maxLightsPerCluster;
+	unsigned int fullClusterCount; // Clusters that hit the light limit
+
+	void UpdateBounds(const ClusterFrustum& frustum);
+	void PrepareLights(const ClusterFrustum& frustum, const std::vector<Light>& lights, unsigned int firstLight, bool multithreaded);
+	void CullSlice(unsigned int slice);
+	void GatherResults();
+	bool TestCluster(const CullLight& light, const ClusterBounds& cluster) const;
+};
+
+// --------------------------------------------------------
+// Results of validating and timing cluster assignment for
+// one scene
+// --------------------------------------------------------
+struct ClusterTiming
+{
+	unsigned int LightCount;
+	double BuildTime;			// Multithreaded, milliseconds
+	double SingleThreadTime;	// Milliseconds
+	double ReferenceTime;		// Brute force, milliseconds
+	bool Matches;				// Did both builds match the reference?
+};
+
+// Builds clusters for scenes of increasing light counts
+// (up to MAX_LIGHTS), multithreaded and not, and checks
+// both against the brute force reference
+void RunClusterBenchmark(const ClusterFrustum& frustum, std::vector<ClusterTiming>* timings);
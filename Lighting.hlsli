@@ -6,6 +6,10 @@
 #define LIGHT_TYPE_POINT		1
 #define LIGHT_TYPE_SPOT			2
 
+// Most point and spot lights chosen for a single entity
+// Must match the definition in EntityLightLists.h
+#define ENTITY_MAX_LIGHTS		8
+
 struct Light
 {
 	int		Type;
@@ -23,10 +27,13 @@ struct Light
 
 // === UTILITY FUNCTIONS ============================================
 
-// Basic sample and unpack
+// Basic sample and unpack.  Only x and y are read, as normal
+// maps are cooked to two channel (BC5) textures, and z is
+// rebuilt from them
 float3 SampleAndUnpackNormalMap(Texture2D map, SamplerState samp, float2 uv)
 {
-	return map.Sample(samp, uv).rgb * 2.0f - 1.0f;
+	float2 xy = map.Sample(samp, uv).rg * 2.0f - 1.0f;
+	return float3(xy, sqrt(saturate(1.0f - dot(xy, xy))));
 }
 
 // Handle converting tangent-space normal map to world space normal
@@ -305,4 +312,45 @@ float3 SpotLightPBR(Light light, float3 normal, float3 worldPos, float3 camPos,
 }
 
 
+// === IMAGE BASED LIGHTING =========================================
+
+// Diffuse light from 9 spherical harmonic coefficients, which
+// are already convolved and divided by pi (see IBLBaker.h)
+float3 IrradianceSH(float4 sh[9], float3 n)
+{
+	float3 irradiance =
+		sh[0].rgb * 0.282095f +
+		sh[1].rgb * 0.488603f * n.y +
+		sh[2].rgb * 0.488603f * n.z +
+		sh[3].rgb * 0.488603f * n.x +
+		sh[4].rgb * 1.092548f * n.x * n.y +
+		sh[5].rgb * 1.092548f * n.y * n.z +
+		sh[6].rgb * 0.315392f * (3.0f * n.z * n.z - 1.0f) +
+		sh[7].rgb * 1.092548f * n.x * n.z +
+		sh[8].rgb * 0.546274f * (n.x * n.x - n.y * n.y);
+
+	// Ringing can dip below zero opposite bright areas
+	return max(irradiance, 0);
+}
+
+// Split-sum specular: the prefiltered sky (each mip for a higher
+// roughness) scaled and biased by the BRDF look up table
+float3 IndirectPBR(float3 normal, float3 worldPos, float3 camPos, float roughness, float metalness, float3 surfaceColor, float3 specularColor,
+	float3 irradiance, TextureCube specularIBL, Texture2D brdfLookUp, SamplerState clampSampler, float specularMipCount)
+{
+	float3 toCam = normalize(camPos - worldPos);
+	float NdotV = saturate(dot(normal, toCam));
+
+	// Reflected sky, blurrier as roughness increases
+	float3 reflection = reflect(-toCam, normal);
+	float3 prefiltered = specularIBL.SampleLevel(clampSampler, reflection, roughness * (specularMipCount - 1)).rgb;
+	float2 brdf = brdfLookUp.Sample(clampSampler, float2(NdotV, roughness)).rg;
+	float3 specularAmount = specularColor * brdf.x + brdf.y;
+
+	// Reflected light doesn't diffuse, and metals don't diffuse at all
+	float3 diffuse = irradiance * surfaceColor * (1 - specularAmount) * (1 - metalness);
+	return diffuse + prefiltered * specularAmount;
+}
+
+
 #endif
\ No newline at end of file
@@ -0,0 +1,497 @@
+#include "LightingSIMD.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <math.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// MSVC allows AVX intrinsics in any build (they're only checked
+// at runtime), while GCC and Clang need AVX enabled for the file
+#if defined(_MSC_VER) || defined(__AVX__)
+#define LIGHTING_AVX_AVAILABLE
+#endif
+
+using namespace DirectX;
+
+
+// === SCALAR REFERENCE =============================================
+
+// Small helpers mirroring HLSL's float3 operations
+static XMFLOAT3 Add(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z); }
+static XMFLOAT3 Sub(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+static XMFLOAT3 Mul(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x * b.x, a.y * b.y, a.z * b.z); }
+static XMFLOAT3 Scale(XMFLOAT3 a, float s) { return XMFLOAT3(a.x * s, a.y * s, a.z * s); }
+static float Dot(XMFLOAT3 a, XMFLOAT3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static float Saturate(float f) { return f < 0.0f ? 0.0f : (f > 1.0f ? 1.0f : f); }
+static XMFLOAT3 Saturate(XMFLOAT3 a) { return XMFLOAT3(Saturate(a.x), Saturate(a.y), Saturate(a.z)); }
+static XMFLOAT3 Normalize(XMFLOAT3 a) { return Scale(a, 1.0f / sqrtf(Dot(a, a))); }
+
+// GGX (Trowbridge-Reitz) normal distribution
+float SpecDistributionScalar(XMFLOAT3 n, XMFLOAT3 h, float roughness)
+{
+	float NdotH = Saturate(Dot(n, h));
+	float NdotH2 = NdotH * NdotH;
+	float a = roughness * roughness;
+	float a2 = fmaxf(a * a, LIGHTING_MIN_ROUGHNESS);
+
+	float denomToSquare = NdotH2 * (a2 - 1) + 1;
+	return a2 / (LIGHTING_PI * denomToSquare * denomToSquare);
+}
+
+// Fresnel term - Schlick approx.
+XMFLOAT3 FresnelScalar(XMFLOAT3 v, XMFLOAT3 h, XMFLOAT3 f0)
+{
+	float VdotH = Saturate(Dot(v, h));
+	float p = powf(1 - VdotH, 5);
+	return XMFLOAT3(
+		f0.x + (1 - f0.x) * p,
+		f0.y + (1 - f0.y) * p,
+		f0.z + (1 - f0.z) * p);
+}
+
+// Geometric Shadowing - Schlick-GGX
+float GeometricShadowingScalar(XMFLOAT3 n, XMFLOAT3 v, float roughness)
+{
+	float k = powf(roughness + 1, 2) / 8.0f;
+	float NdotV = Saturate(Dot(n, v));
+	return NdotV / (NdotV * (1 - k) + k);
+}
+
+// Microfacet BRDF (Specular)
+XMFLOAT3 MicrofacetBRDFScalar(XMFLOAT3 n, XMFLOAT3 l, XMFLOAT3 v, float roughness, float metalness, XMFLOAT3 specColor)
+{
+	XMFLOAT3 h = Normalize(Add(v, l));
+
+	float D = SpecDistributionScalar(n, h, roughness);
+	XMFLOAT3 F = FresnelScalar(v, h, specColor);
+	float G = GeometricShadowingScalar(n, v, roughness) * GeometricShadowingScalar(n, l, roughness);
+
+	return Scale(F, D * G / (4 * fmaxf(Dot(n, v), Dot(n, l))));
+}
+
+// Diffuse amount based on energy conservation
+static XMFLOAT3 DiffuseEnergyConserve(float diffuse, XMFLOAT3 specular, float metalness)
+{
+	XMFLOAT3 s = Saturate(specular);
+	return Scale(XMFLOAT3(1 - s.x, 1 - s.y, 1 - s.z), diffuse * (1 - metalness));
+}
+
+// Range-based attenuation
+static float Attenuate(const Light& light, XMFLOAT3 worldPos)
+{
+	XMFLOAT3 d = Sub(light.Position, worldPos);
+	float dist = sqrtf(Dot(d, d));
+	float att = Saturate(1.0f - (dist * dist / (light.Range * light.Range)));
+	return att * att;
+}
+
+XMFLOAT3 DirLightPBRScalar(const Light& light, const ShadingSample& sample, XMFLOAT3 camPos)
+{
+	XMFLOAT3 toLight = Normalize(Scale(light.Direction, -1));
+	XMFLOAT3 toCam = Normalize(Sub(camPos, sample.WorldPos));
+
+	float diff = Saturate(Dot(sample.Normal, toLight));
+	XMFLOAT3 spec = MicrofacetBRDFScalar(sample.Normal, toLight, toCam, sample.Roughness, sample.Metalness, sample.SpecularColor);
+	XMFLOAT3 balancedDiff = DiffuseEnergyConserve(diff, spec, sample.Metalness);
+
+	return Mul(Scale(Add(Mul(balancedDiff, sample.SurfaceColor), spec), light.Intensity), light.Color);
+}
+
+XMFLOAT3 PointLightPBRScalar(const Light& light, const ShadingSample& sample, XMFLOAT3 camPos)
+{
+	XMFLOAT3 toLight = Normalize(Sub(light.Position, sample.WorldPos));
+	XMFLOAT3 toCam = Normalize(Sub(camPos, sample.WorldPos));
+
+	float atten = Attenuate(light, sample.WorldPos);
+	float diff = Saturate(Dot(sample.Normal, toLight));
+	XMFLOAT3 spec = MicrofacetBRDFScalar(sample.Normal, toLight, toCam, sample.Roughness, sample.Metalness, sample.SpecularColor);
+	XMFLOAT3 balancedDiff = DiffuseEnergyConserve(diff, spec, sample.Metalness);
+
+	return Mul(Scale(Add(Mul(balancedDiff, sample.SurfaceColor), spec), atten * light.Intensity), light.Color);
+}
+
+XMFLOAT3 SpotLightPBRScalar(const Light& light, const ShadingSample& sample, XMFLOAT3 camPos)
+{
+	XMFLOAT3 toLight = Normalize(Sub(light.Position, sample.WorldPos));
+	float penumbra = powf(Saturate(-Dot(toLight, light.Direction)), light.SpotFalloff);
+
+	return Scale(PointLightPBRScalar(light, sample, camPos), penumbra);
+}
+
+// --------------------------------------------------------
+// Sums the lighting of every light for each sample, one
+// sample at a time
+// --------------------------------------------------------
+void ShadeSamplesScalar(const Light* lights, unsigned int lightCount, const ShadingSample* samples, unsigned int sampleCount, XMFLOAT3 camPos, XMFLOAT3* results)
+{
+	for (unsigned int s = 0; s < sampleCount; s++)
+	{
+		XMFLOAT3 total(0, 0, 0);
+		for (unsigned int l = 0; l < lightCount; l++)
+		{
+			switch (lights[l].Type)
+			{
+			case LIGHT_TYPE_DIRECTIONAL: total = Add(total, DirLightPBRScalar(lights[l], samples[s], camPos)); break;
+			case LIGHT_TYPE_POINT: total = Add(total, PointLightPBRScalar(lights[l], samples[s], camPos)); break;
+			case LIGHT_TYPE_SPOT: total = Add(total, SpotLightPBRScalar(lights[l], samples[s], camPos)); break;
+			}
+		}
+		results[s] = total;
+	}
+}
+
+
+// === SIMD LANES ===================================================
+
+// 4 samples at once using SSE
+struct Lane4
+{
+	static const unsigned int Width = 4;
+	__m128 v;
+
+	Lane4() {}
+	Lane4(__m128 v) : v(v) {}
+	Lane4(float f) : v(_mm_set1_ps(f)) {}
+
+	static Lane4 Load(const float* p) { return _mm_loadu_ps(p); }
+	void Store(float* p) const { _mm_storeu_ps(p, v); }
+};
+
+static inline Lane4 operator+(Lane4 a, Lane4 b) { return _mm_add_ps(a.v, b.v); }
+static inline Lane4 operator-(Lane4 a, Lane4 b) { return _mm_sub_ps(a.v, b.v); }
+static inline Lane4 operator*(Lane4 a, Lane4 b) { return _mm_mul_ps(a.v, b.v); }
+static inline Lane4 operator/(Lane4 a, Lane4 b) { return _mm_div_ps(a.v, b.v); }
+static inline Lane4 Min(Lane4 a, Lane4 b) { return _mm_min_ps(a.v, b.v); }
+static inline Lane4 Max(Lane4 a, Lane4 b) { return _mm_max_ps(a.v, b.v); }
+static inline Lane4 Sqrt(Lane4 a) { return _mm_sqrt_ps(a.v); }
+
+#ifdef LIGHTING_AVX_AVAILABLE
+// 8 samples at once using AVX
+struct Lane8
+{
+	static const unsigned int Width = 8;
+	__m256 v;
+
+	Lane8() {}
+	Lane8(__m256 v) : v(v) {}
+	Lane8(float f) : v(_mm256_set1_ps(f)) {}
+
+	static Lane8 Load(const float* p) { return _mm256_loadu_ps(p); }
+	void Store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+static inline Lane8 operator+(Lane8 a, Lane8 b) { return _mm256_add_ps(a.v, b.v); }
+static inline Lane8 operator-(Lane8 a, Lane8 b) { return _mm256_sub_ps(a.v, b.v); }
+static inline Lane8 operator*(Lane8 a, Lane8 b) { return _mm256_mul_ps(a.v, b.v); }
+static inline Lane8 operator/(Lane8 a, Lane8 b) { return _mm256_div_ps(a.v, b.v); }
+static inline Lane8 Min(Lane8 a, Lane8 b) { return _mm256_min_ps(a.v, b.v); }
+static inline Lane8 Max(Lane8 a, Lane8 b) { return _mm256_max_ps(a.v, b.v); }
+static inline Lane8 Sqrt(Lane8 a) { return _mm256_sqrt_ps(a.v); }
+#endif
+
+// Operations shared by every lane type
+template<class V> static inline V Saturate(V a) { return Min(Max(a, V(0.0f)), V(1.0f)); }
+
+// There's no vector pow(), so each lane uses the C runtime's
+template<class V> static inline V Pow(V a, float power)
+{
+	float lanes[V::Width];
+	a.Store(lanes);
+	for (unsigned int i = 0; i < V::Width; i++)
+		lanes[i] = powf(lanes[i], power);
+	return V::Load(lanes);
+}
+
+// A float3 per lane
+template<class V> struct Vec3
+{
+	V x, y, z;
+
+	Vec3() {}
+	Vec3(V x, V y, V z) : x(x), y(y), z(z) {}
+	Vec3(XMFLOAT3 f) : x(f.x), y(f.y), z(f.z) {}
+};
+
+template<class V> static inline Vec3<V> operator+(const Vec3<V>& a, const Vec3<V>& b) { return Vec3<V>(a.x + b.x, a.y + b.y, a.z + b.z); }
+template<class V> static inline Vec3<V> operator-(const Vec3<V>& a, const Vec3<V>& b) { return Vec3<V>(a.x - b.x, a.y - b.y, a.z - b.z); }
+template<class V> static inline Vec3<V> operator*(const Vec3<V>& a, const Vec3<V>& b) { return Vec3<V>(a.x * b.x, a.y * b.y, a.z * b.z); }
+template<class V> static inline Vec3<V> operator*(const Vec3<V>& a, V s) { return Vec3<V>(a.x * s, a.y * s, a.z * s); }
+template<class V> static inline V Dot(const Vec3<V>& a, const Vec3<V>& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+template<class V> static inline Vec3<V> Normalize(const Vec3<V>& a) { return a * (V(1.0f) / Sqrt(Dot(a, a))); }
+template<class V> static inline Vec3<V> Saturate(const Vec3<V>& a) { return Vec3<V>(Saturate(a.x), Saturate(a.y), Saturate(a.z)); }
+
+// A batch of samples, one per lane
+template<class V> struct SampleBatch
+{
+	Vec3<V> Normal;
+	Vec3<V> WorldPos;
+	V Roughness;
+	V Metalness;
+	Vec3<V> SurfaceColor;
+	Vec3<V> SpecularColor;
+};
+
+
+// === SIMD LIGHTING ================================================
+
+// Same as MicrofacetBRDFScalar(), for a full batch of lanes
+template<class V> static Vec3<V> MicrofacetBRDF(const Vec3<V>& n, const Vec3<V>& l, const Vec3<V>& v, V roughness, const Vec3<V>& specColor)
+{
+	Vec3<V> h = Normalize(v + l);
+
+	// Spec distribution
+	V NdotH = Saturate(Dot(n, h));
+	V a = roughness * roughness;
+	V a2 = Max(a * a, V(LIGHTING_MIN_ROUGHNESS));
+	V denomToSquare = NdotH * NdotH * (a2 - V(1.0f)) + V(1.0f);
+	V D = a2 / (V(LIGHTING_PI) * denomToSquare * denomToSquare);
+
+	// Fresnel
+	V oneMinusVdotH = V(1.0f) - Saturate(Dot(v, h));
+	V squared = oneMinusVdotH * oneMinusVdotH;
+	V p = squared * squared * oneMinusVdotH;
+	Vec3<V> F = specColor + (Vec3<V>(V(1.0f), V(1.0f), V(1.0f)) - specColor) * p;
+
+	// Geometric shadowing for both directions
+	V k = (roughness + V(1.0f)) * (roughness + V(1.0f)) / V(8.0f);
+	V NdotV = Saturate(Dot(n, v));
+	V NdotL = Saturate(Dot(n, l));
+	V G = (NdotV / (NdotV * (V(1.0f) - k) + k)) * (NdotL / (NdotL * (V(1.0f) - k) + k));
+
+	return F * (D * G / (V(4.0f) * Max(Dot(n, v), Dot(n, l))));
+}
+
+// Same as the *LightPBRScalar() functions, for a full batch of lanes
+template<class V> static Vec3<V> ShadeLight(const Light& light, const SampleBatch<V>& s, const Vec3<V>& camPos)
+{
+	Vec3<V> toCam = Normalize(camPos - s.WorldPos);
+	Vec3<V> toLight;
+	V amount(light.Intensity);
+
+	if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+	{
+		toLight = Normalize(Vec3<V>(XMFLOAT3(-light.Direction.x, -light.Direction.y, -light.Direction.z)));
+	}
+	else
+	{
+		Vec3<V> toLightUnnormalized = Vec3<V>(light.Position) - s.WorldPos;
+		toLight = Normalize(toLightUnnormalized);
+
+		// Range-based attenuation
+		V distSq = Dot(toLightUnnormalized, toLightUnnormalized);
+		V att = Saturate(V(1.0f) - distSq / V(light.Range * light.Range));
+		amount = amount * att * att;
+
+		// Spot falloff
+		if (light.Type == LIGHT_TYPE_SPOT)
+		{
+			V cosAngle = V(0.0f) - Dot(toLight, Vec3<V>(light.Direction));
+			amount = amount * Pow(Saturate(cosAngle), light.SpotFalloff);
+		}
+	}
+
+	V diff = Saturate(Dot(s.Normal, toLight));
+	Vec3<V> spec = MicrofacetBRDF(s.Normal, toLight, toCam, s.Roughness, s.SpecularColor);
+
+	// Energy conserving diffuse
+	Vec3<V> balancedDiff = (Vec3<V>(V(1.0f), V(1.0f), V(1.0f)) - Saturate(spec)) * (diff * (V(1.0f) - s.Metalness));
+
+	return (balancedDiff * s.SurfaceColor + spec) * amount * Vec3<V>(light.Color);
+}
+
+// --------------------------------------------------------
+// Shades all samples a batch at a time.  Samples are copied
+// into lane order (padding the last batch by repeating the
+// final sample), and results copied back out.
+// --------------------------------------------------------
+template<class V> static void ShadeSamples(const Light* lights, unsigned int lightCount, const ShadingSample* samples, unsigned int sampleCount, XMFLOAT3 camPos, XMFLOAT3* results)
+{
+	const unsigned int W = V::Width;
+	Vec3<V> cam(camPos);
+
+	for (unsigned int start = 0; start < sampleCount; start += W)
+	{
+		// Gather this batch of samples into lanes
+		float lanes[16][W];
+		for (unsigned int i = 0; i < W; i++)
+		{
+			unsigned int index = start + i < sampleCount ? start + i : sampleCount - 1;
+			const ShadingSample& s = samples[index];
+			lanes[0][i] = s.Normal.x;			lanes[1][i] = s.Normal.y;			lanes[2][i] = s.Normal.z;
+			lanes[3][i] = s.WorldPos.x;			lanes[4][i] = s.WorldPos.y;			lanes[5][i] = s.WorldPos.z;
+			lanes[6][i] = s.Roughness;			lanes[7][i] = s.Metalness;
+			lanes[8][i] = s.SurfaceColor.x;		lanes[9][i] = s.SurfaceColor.y;		lanes[10][i] = s.SurfaceColor.z;
+			lanes[11][i] = s.SpecularColor.x;	lanes[12][i] = s.SpecularColor.y;	lanes[13][i] = s.SpecularColor.z;
+		}
+
+		SampleBatch<V> batch;
+		batch.Normal = Vec3<V>(V::Load(lanes[0]), V::Load(lanes[1]), V::Load(lanes[2]));
+		batch.WorldPos = Vec3<V>(V::Load(lanes[3]), V::Load(lanes[4]), V::Load(lanes[5]));
+		batch.Roughness = V::Load(lanes[6]);
+		batch.Metalness = V::Load(lanes[7]);
+		batch.SurfaceColor = Vec3<V>(V::Load(lanes[8]), V::Load(lanes[9]), V::Load(lanes[10]));
+		batch.SpecularColor = Vec3<V>(V::Load(lanes[11]), V::Load(lanes[12]), V::Load(lanes[13]));
+
+		// Sum every light
+		Vec3<V> total(V(0.0f), V(0.0f), V(0.0f));
+		for (unsigned int l = 0; l < lightCount; l++)
+		{
+			if (lights[l].Type <= LIGHT_TYPE_SPOT)
+				total = total + ShadeLight(lights[l], batch, cam);
+		}
+
+		// Scatter the valid lanes back out
+		total.x.Store(lanes[0]);
+		total.y.Store(lanes[1]);
+		total.z.Store(lanes[2]);
+		for (unsigned int i = 0; i < W && start + i < sampleCount; i++)
+			results[start + i] = XMFLOAT3(lanes[0][i], lanes[1][i], lanes[2][i]);
+	}
+}
+
+// --------------------------------------------------------
+// Sums the lighting of every light for each sample, four
+// samples at a time
+// --------------------------------------------------------
+void ShadeSamplesSSE(const Light* lights, unsigned int lightCount, const ShadingSample* samples, unsigned int sampleCount, XMFLOAT3 camPos, XMFLOAT3* results)
+{
+	ShadeSamples<Lane4>(lights, lightCount, samples, sampleCount, camPos, results);
+}
+
+// --------------------------------------------------------
+// Sums the lighting of every light for each sample, eight
+// samples at a time (or four, if AVX isn't available)
+// --------------------------------------------------------
+void ShadeSamplesAVX(const Light* lights, unsigned int lightCount, const ShadingSample* samples, unsigned int sampleCount, XMFLOAT3 camPos, XMFLOAT3* results)
+{
+#ifdef LIGHTING_AVX_AVAILABLE
+	if (IsLightingAVXSupported())
+	{
+		ShadeSamples<Lane8>(lights, lightCount, samples, sampleCount, camPos, results);
+		return;
+	}
+#endif
+
+	ShadeSamplesSSE(lights, lightCount, samples, sampleCount, camPos, results);
+}
+
+// --------------------------------------------------------
+// Checks both the CPU and OS for AVX support (the OS must
+// save the larger registers during context switches)
+// --------------------------------------------------------
+bool IsLightingAVXSupported()
+{
+#if defined(_MSC_VER)
+	int info[4] = {};
+	__cpuid(info, 1);
+	bool osSaves = (info[2] & (1 << 27)) != 0;
+	bool cpuHasAVX = (info[2] & (1 << 28)) != 0;
+	return osSaves && cpuHasAVX && (_xgetbv(0) & 0x6) == 0x6;
+#elif defined(__AVX__)
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+// === BENCHMARK ====================================================
+
+// --------------------------------------------------------
+// Shades a fixed set of random samples with each light type
+// using the scalar, SSE and AVX ports of the PBR lighting,
+// timing each and checking that the SIMD results stay within
+// tolerance of the scalar reference.
+//
+// timings - Filled in with one timing per light type
+// --------------------------------------------------------
+void RunShadingBenchmark(std::vector<ShadingTiming>* timings)
+{
+	const unsigned int sampleCount = 65536;
+	const unsigned int lightsPerType = 16;
+	timings->clear();
+
+	// Simple LCG, so the results don't depend on rand()
+	unsigned int seed = 54321;
+	auto random = [&seed](float min, float max)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return min + (seed >> 8) / 16777216.0f * (max - min);
+	};
+
+	// Random surfaces scattered around the origin
+	std::vector<ShadingSample> samples(sampleCount);
+	for (auto& s : samples)
+	{
+		XMVECTOR normal = XMVector3Normalize(XMVectorSet(random(-1, 1), random(-1, 1), random(-1, 1), 0));
+		XMStoreFloat3(&s.Normal, normal);
+		s.WorldPos = XMFLOAT3(random(-10, 10), random(-5, 5), random(-10, 10));
+		s.Roughness = random(0, 1);
+		s.Metalness = random(0, 1) > 0.5f ? 1.0f : 0.0f;
+		s.SurfaceColor = XMFLOAT3(random(0, 1), random(0, 1), random(0, 1));
+		s.SpecularColor = s.Metalness > 0 ? s.SurfaceColor : XMFLOAT3(LIGHTING_F0_NON_METAL, LIGHTING_F0_NON_METAL, LIGHTING_F0_NON_METAL);
+	}
+
+	XMFLOAT3 camPos(0, 0, -15);
+	std::vector<XMFLOAT3> scalarResults(sampleCount);
+	std::vector<XMFLOAT3> simdResults(sampleCount);
+
+	for (int type = LIGHT_TYPE_DIRECTIONAL; type <= LIGHT_TYPE_SPOT; type++)
+	{
+		std::vector<Light> testLights(lightsPerType);
+		for (auto& light : testLights)
+		{
+			light = {};
+			light.Type = type;
+			light.Position = XMFLOAT3(random(-10, 10), random(-5, 5), random(-10, 10));
+			light.Direction = XMFLOAT3(random(-1, 1), random(-1, 0), random(-1, 1));
+			light.Color = XMFLOAT3(random(0, 1), random(0, 1), random(0, 1));
+			light.Range = random(5, 20);
+			light.Intensity = random(0.5f, 2.0f);
+			light.SpotFalloff = random(1, 50);
+		}
+
+		ShadingTiming timing = {};
+		timing.LightType = type;
+
+		// Scalar reference
+		auto start = std::chrono::high_resolution_clock::now();
+		ShadeSamplesScalar(testLights.data(), lightsPerType, samples.data(), sampleCount, camPos, scalarResults.data());
+		auto end = std::chrono::high_resolution_clock::now();
+		timing.ScalarTime = std::chrono::duration<double, std::milli>(end - start).count();
+
+		// Largest difference of either SIMD version, relative
+		// to the magnitude of the reference value
+		auto compare = [&]()
+		{
+			for (unsigned int i = 0; i < sampleCount; i++)
+			{
+				const XMFLOAT3& a = scalarResults[i];
+				const XMFLOAT3& b = simdResults[i];
+				float scale = (std::max)(1.0f, (std::max)(fabsf(a.x), (std::max)(fabsf(a.y), fabsf(a.z))));
+				float diff = (std::max)(fabsf(a.x - b.x), (std::max)(fabsf(a.y - b.y), fabsf(a.z - b.z)));
+				timing.MaxError = (std::max)(timing.MaxError, diff / scale);
+			}
+		};
+
+		// SSE
+		start = std::chrono::high_resolution_clock::now();
+		ShadeSamplesSSE(testLights.data(), lightsPerType, samples.data(), sampleCount, camPos, simdResults.data());
+		end = std::chrono::high_resolution_clock::now();
+		timing.SSETime = std::chrono::duration<double, std::milli>(end - start).count();
+		compare();
+
+		// AVX
+		start = std::chrono::high_resolution_clock::now();
+		ShadeSamplesAVX(testLights.data(), lightsPerType, samples.data(), sampleCount, camPos, simdResults.data());
+		end = std::chrono::high_resolution_clock::now();
+		timing.AVXTime = std::chrono::duration<double, std::milli>(end - start).count();
+		compare();
+
+		timings->push_back(timing);
+	}
+}
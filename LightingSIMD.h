@@ -0,0 +1,72 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "Lights.h"
+
+// These constants should match Lighting.hlsli
+#define LIGHTING_F0_NON_METAL	0.04f
+#define LIGHTING_MIN_ROUGHNESS	0.0000001f
+#define LIGHTING_PI				3.14159265359f
+
+// --------------------------------------------------------
+// Everything the PBR light functions need about a single
+// pixel, matching the parameters of the shader functions
+// --------------------------------------------------------
+struct ShadingSample
+{
+	DirectX::XMFLOAT3 Normal;			// Normalized, world space
+	DirectX::XMFLOAT3 WorldPos;
+	float Roughness;
+	float Metalness;
+	DirectX::XMFLOAT3 SurfaceColor;		// Linear
+	DirectX::XMFLOAT3 SpecularColor;	// F0
+};
+
+// --------------------------------------------------------
+// CPU ports of the PBR lighting in Lighting.hlsli, for
+// checking shading changes without a GPU and measuring
+// the relative cost of each light type.
+//
+// The scalar functions follow the shader code line by
+// line and serve as the reference.  The SSE (4-wide) and
+// AVX (8-wide) versions shade that many samples at once
+// against each light, and should match the reference to
+// within floating point tolerance.
+// --------------------------------------------------------
+
+// Scalar reference, one function per shader function
+float SpecDistributionScalar(DirectX::XMFLOAT3 n, DirectX::XMFLOAT3 h, float roughness);
+DirectX::XMFLOAT3 FresnelScalar(DirectX::XMFLOAT3 v, DirectX::XMFLOAT3 h, DirectX::XMFLOAT3 f0);
+float GeometricShadowingScalar(DirectX::XMFLOAT3 n, DirectX::XMFLOAT3 v, float roughness);
+DirectX::XMFLOAT3 MicrofacetBRDFScalar(DirectX::XMFLOAT3 n, DirectX::XMFLOAT3 l, DirectX::XMFLOAT3 v, float roughness, float metalness, DirectX::XMFLOAT3 specColor);
+DirectX::XMFLOAT3 DirLightPBRScalar(const Light& light, const ShadingSample& sample, DirectX::XMFLOAT3 camPos);
+DirectX::XMFLOAT3 PointLightPBRScalar(const Light& light, const ShadingSample& sample, DirectX::XMFLOAT3 camPos);
+DirectX::XMFLOAT3 SpotLightPBRScalar(const Light& light, const ShadingSample& sample, DirectX::XMFLOAT3 camPos);
+
+// Total lighting for many samples from a set of lights.
+// Results are the sum of every light, as the shader does.
+void ShadeSamplesScalar(const Light* lights, unsigned int lightCount, const ShadingSample* samples, unsigned int sampleCount, DirectX::XMFLOAT3 camPos, DirectX::XMFLOAT3* results);
+void ShadeSamplesSSE(const Light* lights, unsigned int lightCount, const ShadingSample* samples, unsigned int sampleCount, DirectX::XMFLOAT3 camPos, DirectX::XMFLOAT3* results);
+void ShadeSamplesAVX(const Light* lights, unsigned int lightCount, const ShadingSample* samples, unsigned int sampleCount, DirectX::XMFLOAT3 camPos, DirectX::XMFLOAT3* results);
+
+// Whether this CPU (and build) can run the AVX version.
+// ShadeSamplesAVX() falls back to SSE when it can't.
+bool IsLightingAVXSupported();
+
+// --------------------------------------------------------
+// Results of comparing and timing the ports for one type
+// of light
+// --------------------------------------------------------
+struct ShadingTiming
+{
+	int LightType;
+	double ScalarTime;	// Milliseconds
+	double SSETime;		// Milliseconds
+	double AVXTime;		// Milliseconds
+	float MaxError;		// Largest difference from scalar
+};
+
+// Shades the same random samples with every port, for each
+// type of light
+void RunShadingBenchmark(std::vector<ShadingTiming>* timings);
@@ -0,0 +1,58 @@
+#include "Lights.h"
+
+// --------------------------------------------------------
+// Helper for determining if a light affects anything
+// --------------------------------------------------------
+static bool IsLightActive(const Light& light)
+{
+	if (light.Intensity <= 0.0f)
+		return false;
+
+	return light.Type == LIGHT_TYPE_DIRECTIONAL || light.Range > 0.0f;
+}
+
+// --------------------------------------------------------
+// Gathers the lights that will actually affect the scene,
+// skipping any with no intensity (or no range, for point
+// and spot lights), so the GPU never loops over them.
+// Directional lights are placed first, as they affect
+// every pixel and are handled separately from the rest.
+//
+// lights           - The full set of lights
+// count            - How many of those lights are in use
+// packed           - Receives the active lights (previous
+//                    contents are replaced, but its memory
+//                    is reused)
+// directionalCount - Optionally receives the number of
+//                    directional lights at the front
+//
+// Returns the number of active lights
+// --------------------------------------------------------
+unsigned int PackActiveLights(const std::vector<Light>& lights, unsigned int count, std::vector<Light>& packed, unsigned int* directionalCount)
+{
+	if (count > lights.size())
+		count = (unsigned int)lights.size();
+
+	packed.resize(count);
+
+	// Directional lights first
+	unsigned int active = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (lights[i].Type == LIGHT_TYPE_DIRECTIONAL && IsLightActive(lights[i]))
+			packed[active++] = lights[i];
+	}
+
+	if (directionalCount)
+		*directionalCount = active;
+
+	// Then everything else
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (lights[i].Type != LIGHT_TYPE_DIRECTIONAL && IsLightActive(lights[i]))
+			packed[active++] = lights[i];
+	}
+
+	packed.resize(active);
+	return active;
+}
@@ -1,10 +1,12 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <vector>
 
-// This define should match your
-// MAX_LIGHTS definition in your shader(s)
-#define MAX_LIGHTS 128
+// Lights are uploaded to a structured buffer, so this is
+// only a limit on how many the light count (and the upload
+// benchmark) can ask for; lights are made as they're needed
+#define MAX_LIGHTS 65536
 
 // Light types
 // Must match definitions in shader
@@ -25,4 +27,9 @@ struct Light
 
 	float				SpotFalloff;
 	DirectX::XMFLOAT3	Padding;	// 64 bytes
-};
\ No newline at end of file
+};
+
+// Copies only the lights that contribute anything into a
+// tightly packed array (directional lights first), ready
+// for uploading
+unsigned int PackActiveLights(const std::vector<Light>& lights, unsigned int count, std::vector<Light>& packed, unsigned int* directionalCount = 0);
@@ -1,4 +1,5 @@
 #include "Material.h"
+#include "Profiler.h"
 
 Material::Material(
 	std::shared_ptr<SimplePixelShader> ps, 
@@ -80,25 +81,37 @@ void Material::RemoveSampler(std::string name)
 
 void Material::PrepareMaterial(Transform* transform, std::shared_ptr<Camera> camera)
 {
-	// Turn on these shaders
+	PROFILE_FUNCTION();
+
+	// Send data to both shaders.  With a ring, room for all of
+	// it is reserved first, as wrapping partway through would
+	// discard the vertex shader's range after it was bound.
+	SetShaderData(transform);
+	ISimpleShader::ReserveRingSpace(vs.get(), ps.get());
+	vs->CopyAllBufferData();
+	ps->CopyAllBufferData();
+
+	// Turn on these shaders (after copying, so they bind the
+	// ranges just uploaded rather than uploading their own)
 	vs->SetShader();
 	ps->SetShader();
 
-	// Send data to the vertex shader
+	// Loop and set any other resources
+	for (auto& t : textureSRVs) { ps->SetShaderResourceView(t.first.c_str(), t.second.Get()); }
+	for (auto& s : samplers) { ps->SetSamplerState(s.first.c_str(), s.second.Get()); }
+}
+
+// Sets the shaders' local copies of this material's data,
+// without copying or binding anything
+void Material::SetShaderData(Transform* transform)
+{
+	// Vertex shader data
 	vs->SetMatrix4x4("world", transform->GetWorldMatrix());
 	vs->SetMatrix4x4("worldInverseTranspose", transform->GetWorldInverseTransposeMatrix());
-	vs->SetMatrix4x4("view", camera->GetView());
-	vs->SetMatrix4x4("projection", camera->GetProjection());
-	vs->CopyAllBufferData();
 
-	// Send data to the pixel shader
+	// Pixel shader data
 	ps->SetFloat3("colorTint", colorTint);
-	ps->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
 	ps->SetFloat2("uvScale", uvScale);
 	ps->SetFloat2("uvOffset", uvOffset);
-	ps->CopyAllBufferData();
-
-	// Loop and set any other resources
-	for (auto& t : textureSRVs) { ps->SetShaderResourceView(t.first.c_str(), t.second.Get()); }
-	for (auto& s : samplers) { ps->SetSamplerState(s.first.c_str(), s.second.Get()); }
+	ps->SetInt("packedRoughnessMetal", textureSRVs.count("RoughnessMetalMap") > 0 ? 1 : 0);
 }
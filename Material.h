@@ -27,6 +27,8 @@ public:
 	DirectX::XMFLOAT3 GetColorTint();
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetTextureSRV(std::string name);
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> GetSampler(std::string name);
+	const std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>& GetTextureSRVs() { return textureSRVs; }
+	const std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>>& GetSamplers() { return samplers; }
 
 	void SetPixelShader(std::shared_ptr<SimplePixelShader> ps);
 	void SetVertexShader(std::shared_ptr<SimpleVertexShader> ps);
@@ -41,6 +43,7 @@ public:
 	void RemoveSampler(std::string name);
 
 	void PrepareMaterial(Transform* transform, std::shared_ptr<Camera> camera);
+	void SetShaderData(Transform* transform);
 
 private:
 
@@ -1,7 +1,8 @@
 #include "Mesh.h"
+#include "FileSystem.h"
+#include "D3D11RenderDevice.h"
 #include <DirectXMath.h>
 #include <vector>
-#include <fstream>
 
 using namespace DirectX;
 
@@ -15,7 +16,8 @@ using namespace DirectX;
 // device     - The D3D device to use for buffer creation
 // --------------------------------------------------------
 Mesh::Mesh(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device) :
-	numIndices(0)
+	numIndices(0),
+	boundingSphere(0, 0, 0, 0)
 {
 	CreateBuffers(vertArray, numVerts, indexArray, numIndices, device);
 }
@@ -28,21 +30,41 @@ Mesh::Mesh(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t
 // device   - The D3D device to use for buffer creation
 // --------------------------------------------------------
 Mesh::Mesh(const std::wstring& objFile, Microsoft::WRL::ComPtr<ID3D11Device> device) :
-	numIndices(0)
+	numIndices(0),
+	boundingSphere(0, 0, 0, 0)
 {
-	// File input object
-	std::ifstream obj(objFile);
-
-	// Check for successful open
-	if (!obj.is_open())
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	if (!LoadOBJ(objFile, &verts, &indices))
 		return;
 
+	CreateBuffers(&verts[0], verts.size(), &indices[0], indices.size(), device);
+}
+
+
+// --------------------------------------------------------
+// Reads the vertices and indices from an .obj file, without
+// creating any D3D objects (so it's safe on any thread).
+// The file comes from a mounted pack if one has it.
+// 
+// objFile  - Path to the .obj 3D model file to load
+// verts    - Receives the vertices
+// indices  - Receives the indices
+//
+// Returns false if the file can't be read or has no faces
+// --------------------------------------------------------
+bool Mesh::LoadOBJ(const std::wstring& objFile, std::vector<Vertex>* verts, std::vector<unsigned int>* indices)
+{
+	// Open the file, then read it as a stream (without copying it)
+	AssetFile file;
+	if (!OpenAssetFile(objFile, &file))
+		return false;
+	AssetFileStream obj(file);
+
 	// Variables used while reading the file
 	std::vector<XMFLOAT3> positions;     // Positions from the file
 	std::vector<XMFLOAT3> normals;       // Normals from the file
 	std::vector<XMFLOAT2> uvs;           // UVs from the file
-	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
 	unsigned int vertCounter = 0;        // Count of vertices/indices
 	char chars[100];                     // String for line reading
 
@@ -151,14 +173,14 @@ Mesh::Mesh(const std::wstring& objFile, Microsoft::WRL::ComPtr<ID3D11Device> dev
 			v3.Normal.z *= -1.0f;
 
 			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
+			verts->push_back(v1);
+			verts->push_back(v3);
+			verts->push_back(v2);
 
 			// Add three more indices
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
+			indices->push_back(vertCounter); vertCounter += 1;
+			indices->push_back(vertCounter); vertCounter += 1;
+			indices->push_back(vertCounter); vertCounter += 1;
 
 			// Was there a 4th face?
 			if (facesRead == 12)
@@ -175,21 +197,21 @@ Mesh::Mesh(const std::wstring& objFile, Microsoft::WRL::ComPtr<ID3D11Device> dev
 				v4.Normal.z *= -1.0f;
 
 				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
+				verts->push_back(v1);
+				verts->push_back(v4);
+				verts->push_back(v3);
 
 				// Add three more indices
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
+				indices->push_back(vertCounter); vertCounter += 1;
+				indices->push_back(vertCounter); vertCounter += 1;
+				indices->push_back(vertCounter); vertCounter += 1;
 			}
 		}
 	}
 
-	// Close the file and create the actual buffers
+	// Close the file
 	obj.close();
-	CreateBuffers(&verts[0], vertCounter, &indices[0], vertCounter, device);
+	return vertCounter > 0;
 }
 
 
@@ -207,6 +229,7 @@ Mesh::~Mesh() { }
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer() { return vb; }
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer() { return ib; }
 unsigned int Mesh::GetIndexCount() { return numIndices; }
+DirectX::XMFLOAT4 Mesh::GetBoundingSphere() { return boundingSphere; }
 
 
 // --------------------------------------------------------
@@ -223,6 +246,7 @@ void Mesh::CreateBuffers(Vertex* vertArray, size_t numVerts, unsigned int* index
 {
 	// Calculate the tangents of each vertex first
 	CalculateTangents(vertArray, numVerts, indexArray, numIndices);
+	CalculateBounds(vertArray, numVerts);
 
 	// Create the vertex buffer
 	D3D11_BUFFER_DESC vbd = {};
@@ -337,20 +361,50 @@ void Mesh::CalculateTangents(Vertex* verts, size_t numVerts, unsigned int* indic
 }
 
 
+// --------------------------------------------------------
+// Finds a sphere around all vertices, centered on the
+// middle of their bounding box
+// --------------------------------------------------------
+void Mesh::CalculateBounds(Vertex* verts, size_t numVerts)
+{
+	if (numVerts == 0)
+		return;
+
+	// Box around everything
+	XMVECTOR boxMin = XMLoadFloat3(&verts[0].Position);
+	XMVECTOR boxMax = boxMin;
+	for (size_t i = 1; i < numVerts; i++)
+	{
+		XMVECTOR pos = XMLoadFloat3(&verts[i].Position);
+		boxMin = XMVectorMin(boxMin, pos);
+		boxMax = XMVectorMax(boxMax, pos);
+	}
+
+	// Radius reaches the farthest vertex from the center
+	XMVECTOR center = (boxMin + boxMax) * 0.5f;
+	XMVECTOR radiusSq = XMVectorZero();
+	for (size_t i = 0; i < numVerts; i++)
+	{
+		XMVECTOR toVert = XMLoadFloat3(&verts[i].Position) - center;
+		radiusSq = XMVectorMax(radiusSq, XMVector3LengthSq(toVert));
+	}
+
+	XMStoreFloat4(&boundingSphere, XMVectorSetW(center, XMVectorGetX(XMVectorSqrt(radiusSq))));
+}
+
+
 // --------------------------------------------------------
 // Binds the mesh buffers and issues a draw call.  Note that
 // this method assumes you're drawing the entire mesh.
 // 
-// context - D3D context for issuing rendering calls
+// device - Render device for issuing rendering calls
 // --------------------------------------------------------
-void Mesh::SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+void Mesh::SetBuffersAndDraw(IRenderDevice* device)
 {
 	// Set buffers in the input assembler
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-	context->IASetVertexBuffers(0, 1, vb.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(ib.Get(), DXGI_FORMAT_R32_UINT, 0);
+	device->SetVertexBuffer(D3D11RenderDevice::GetHandle(vb.Get()), sizeof(Vertex));
+	device->SetIndexBuffer(D3D11RenderDevice::GetHandle(ib.Get()));
 
 	// Draw this mesh
-	context->DrawIndexed(this->numIndices, 0, 0);
+	device->DrawIndexed(this->numIndices, 0, 0);
 }
@@ -3,8 +3,10 @@
 #include <d3d11.h>
 #include <wrl/client.h>
 #include <string>
+#include <vector>
 
 #include "Vertex.h"
+#include "RenderDevice.h"
 
 
 class Mesh
@@ -14,13 +16,19 @@ public:
 	Mesh(const std::wstring& objFile, Microsoft::WRL::ComPtr<ID3D11Device> device);
 	~Mesh();
 
+	// Reads an .obj file without creating a mesh
+	static bool LoadOBJ(const std::wstring& objFile, std::vector<Vertex>* verts, std::vector<unsigned int>* indices);
+
 	// Getters for mesh data
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
 	unsigned int GetIndexCount();
 
+	// Local space bounding sphere (center and radius)
+	DirectX::XMFLOAT4 GetBoundingSphere();
+
 	// Basic mesh drawing
-	void SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void SetBuffersAndDraw(IRenderDevice* device);
 
 private:
 	// D3D buffers
@@ -30,8 +38,12 @@ private:
 	// Total indices in this mesh
 	unsigned int numIndices;
 
+	// Sphere around all of the vertices
+	DirectX::XMFLOAT4 boundingSphere;
+
 	// Helper for creating buffers (in the event we add more constructor overloads)
 	void CreateBuffers(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
 	void CalculateTangents(Vertex* verts, size_t numVerts, unsigned int* indices, size_t numIndices);
+	void CalculateBounds(Vertex* verts, size_t numVerts);
 };
 
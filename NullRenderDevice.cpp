@@ -0,0 +1,403 @@
+#include "NullRenderDevice.h"
+#include "CommandRecording.h"
+
+#include <chrono>
+#include <memory>
+
+// --------------------------------------------------------
+// Creates the device
+//
+// recording - Keep every call as a command?  Without it,
+//             only the calls are counted.
+// --------------------------------------------------------
+NullRenderDevice::NullRenderDevice(bool recording) :
+	recording(recording),
+	nextHandle(1),
+	liveObjects(0)
+{
+	ResetCallCounts();
+}
+
+void NullRenderDevice::ResetCallCounts()
+{
+	for (unsigned int t = 0; t < RENDER_COMMAND_COUNT; t++)
+		callCounts[t] = 0;
+}
+
+// Counts (and possibly records) a call
+void NullRenderDevice::Record(unsigned int type, unsigned int stage, unsigned int slot, RenderHandle object, unsigned int a, unsigned int b, unsigned int c, unsigned int d)
+{
+	callCounts[type]++;
+	if (!recording)
+		return;
+
+	RenderCommand command;
+	command.Type = type;
+	command.Stage = stage;
+	command.Slot = slot;
+	command.Object = object;
+	command.Args[0] = a;
+	command.Args[1] = b;
+	command.Args[2] = c;
+	command.Args[3] = d;
+	commands.push_back(command);
+}
+
+// Hands out the next handle, recording its creation
+RenderHandle NullRenderDevice::Create(unsigned int a, unsigned int b, unsigned int c)
+{
+	RenderHandle handle = nextHandle++;
+	liveObjects++;
+	Record(RENDER_COMMAND_CREATE, 0, 0, handle, a, b, c);
+	return handle;
+}
+
+RenderHandle NullRenderDevice::CreateBuffer(const RenderBufferDesc& desc, const void*) { return Create(desc.Type, desc.Size, desc.Dynamic ? 1 : 0); }
+RenderHandle NullRenderDevice::CreateTexture(const RenderTextureDesc& desc, const void*, unsigned int) { return Create(desc.Width, desc.Height, desc.Format); }
+RenderHandle NullRenderDevice::CreateShader(unsigned int stage, const void*, size_t size) { return Create(stage, (unsigned int)size); }
+RenderHandle NullRenderDevice::CreateInputLayout(const RenderVertexElement*, unsigned int count, const void*, size_t) { return Create(count); }
+RenderHandle NullRenderDevice::CreateSampler(const RenderSamplerDesc& desc) { return Create(desc.Filter, desc.Address, desc.MaxAnisotropy); }
+RenderHandle NullRenderDevice::CreateRasterizerState(const RenderRasterizerDesc& desc) { return Create(desc.CullMode, desc.Wireframe ? 1 : 0); }
+RenderHandle NullRenderDevice::CreateDepthStencilState(const RenderDepthStencilDesc& desc) { return Create(desc.DepthTest ? 1 : 0, desc.DepthWrite ? 1 : 0, desc.LessEqual ? 1 : 0); }
+RenderHandle NullRenderDevice::CreateBlendState(const RenderBlendDesc& desc) { return Create(desc.AlphaBlend ? 1 : 0); }
+
+void NullRenderDevice::Release(RenderHandle object)
+{
+	if (object && liveObjects > 0)
+		liveObjects--;
+	Record(RENDER_COMMAND_RELEASE, 0, 0, object);
+}
+
+void NullRenderDevice::UpdateBuffer(RenderHandle buffer, const void*, unsigned int size) { Record(RENDER_COMMAND_UPDATE_BUFFER, 0, 0, buffer, size); }
+
+void NullRenderDevice::SetViewport(float x, float y, float width, float height)
+{
+	Record(RENDER_COMMAND_SET_VIEWPORT, 0, 0, 0, (unsigned int)x, (unsigned int)y, (unsigned int)width, (unsigned int)height);
+}
+
+void NullRenderDevice::SetInputLayout(RenderHandle layout) { Record(RENDER_COMMAND_SET_INPUT_LAYOUT, 0, 0, layout); }
+void NullRenderDevice::SetShader(unsigned int stage, RenderHandle shader) { Record(RENDER_COMMAND_SET_SHADER, stage, 0, shader); }
+void NullRenderDevice::SetConstantBuffer(unsigned int stage, unsigned int slot, RenderHandle buffer, unsigned int firstConstant, unsigned int numConstants) { Record(RENDER_COMMAND_SET_CONSTANT_BUFFER, stage, slot, buffer, firstConstant, numConstants); }
+void NullRenderDevice::SetTexture(unsigned int stage, unsigned int slot, RenderHandle texture) { Record(RENDER_COMMAND_SET_TEXTURE, stage, slot, texture); }
+void NullRenderDevice::SetSampler(unsigned int stage, unsigned int slot, RenderHandle sampler) { Record(RENDER_COMMAND_SET_SAMPLER, stage, slot, sampler); }
+void NullRenderDevice::SetVertexBuffer(RenderHandle buffer, unsigned int stride) { Record(RENDER_COMMAND_SET_VERTEX_BUFFER, 0, 0, buffer, stride); }
+void NullRenderDevice::SetIndexBuffer(RenderHandle buffer) { Record(RENDER_COMMAND_SET_INDEX_BUFFER, 0, 0, buffer); }
+void NullRenderDevice::SetRasterizerState(RenderHandle state) { Record(RENDER_COMMAND_SET_RASTERIZER_STATE, 0, 0, state); }
+void NullRenderDevice::SetDepthStencilState(RenderHandle state) { Record(RENDER_COMMAND_SET_DEPTH_STENCIL_STATE, 0, 0, state); }
+void NullRenderDevice::SetBlendState(RenderHandle state) { Record(RENDER_COMMAND_SET_BLEND_STATE, 0, 0, state); }
+
+void NullRenderDevice::Draw(unsigned int vertexCount, unsigned int startVertex) { Record(RENDER_COMMAND_DRAW, 0, 0, 0, vertexCount, startVertex); }
+void NullRenderDevice::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) { Record(RENDER_COMMAND_DRAW_INDEXED, 0, 0, 0, indexCount, startIndex, (unsigned int)baseVertex); }
+
+
+// === VERIFICATION =================================================
+
+// What's bound to the vertex and pixel stages during replay
+struct ReplayState
+{
+	RenderHandle InputLayout = 0;
+	RenderHandle VertexBuffer = 0;
+	unsigned int VertexStride = 0;
+	RenderHandle IndexBuffer = 0;
+	RenderHandle Shaders[2] = {};
+	RenderBinding ConstantBuffers[2][BINDING_SLOTS_CONSTANT_BUFFER] = {};
+	RenderHandle Textures[2][BINDING_SLOTS_SHADER_RESOURCE] = {};
+	RenderHandle Samplers[2][BINDING_SLOTS_SAMPLER] = {};
+};
+
+// Does the state match everything the draw binds?
+static bool DrawMatches(const ReplayState& state, const RenderDrawList& list, const RenderDraw& draw, unsigned int indexCount)
+{
+	if (state.InputLayout != draw.InputLayout ||
+		state.Shaders[BINDING_STAGE_VERTEX] != draw.VertexShader ||
+		state.Shaders[BINDING_STAGE_PIXEL] != draw.PixelShader ||
+		state.VertexBuffer != draw.VertexBuffer ||
+		state.VertexStride != draw.VertexStride ||
+		state.IndexBuffer != draw.IndexBuffer ||
+		indexCount != draw.IndexCount)
+		return false;
+
+	for (unsigned int i = draw.FirstConstantBuffer; i < draw.FirstConstantBuffer + draw.ConstantBufferCount; i++)
+	{
+		const RenderBinding& expected = list.GetConstantBuffer(i);
+		if (expected.Stage > BINDING_STAGE_PIXEL || expected.Slot >= BINDING_SLOTS_CONSTANT_BUFFER)
+			return false;
+		const RenderBinding& bound = state.ConstantBuffers[expected.Stage][expected.Slot];
+		if (bound.Object != expected.Object || bound.FirstConstant != expected.FirstConstant || bound.NumConstants != expected.NumConstants)
+			return false;
+	}
+	for (unsigned int i = draw.FirstTexture; i < draw.FirstTexture + draw.TextureCount; i++)
+	{
+		const RenderBinding& expected = list.GetTexture(i);
+		if (expected.Stage > BINDING_STAGE_PIXEL || expected.Slot >= BINDING_SLOTS_SHADER_RESOURCE ||
+			state.Textures[expected.Stage][expected.Slot] != expected.Object)
+			return false;
+	}
+	for (unsigned int i = draw.FirstSampler; i < draw.FirstSampler + draw.SamplerCount; i++)
+	{
+		const RenderBinding& expected = list.GetSampler(i);
+		if (expected.Stage > BINDING_STAGE_PIXEL || expected.Slot >= BINDING_SLOTS_SAMPLER ||
+			state.Samplers[expected.Stage][expected.Slot] != expected.Object)
+			return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Replays a stream of commands, checking each indexed draw
+// against the next draw of a range of the list
+//
+// commands - Stream recorded by a NullRenderDevice, starting
+//            from nothing bound (as a deferred context does)
+// drawList - Draws that were submitted
+// start    - First draw the stream should contain
+// end      - One past the last draw it should contain
+//
+// Returns true if the stream draws exactly those draws, in
+// order, each with everything it binds in place
+// --------------------------------------------------------
+bool VerifyRenderCommands(const std::vector<RenderCommand>& commands, const RenderDrawList& drawList, unsigned int start, unsigned int end)
+{
+	std::unique_ptr<ReplayState> state(new ReplayState());
+	unsigned int next = start;
+
+	for (const RenderCommand& c : commands)
+	{
+		bool stageValid = c.Stage <= BINDING_STAGE_PIXEL;
+		switch (c.Type)
+		{
+		case RENDER_COMMAND_SET_INPUT_LAYOUT: state->InputLayout = c.Object; break;
+		case RENDER_COMMAND_SET_INDEX_BUFFER: state->IndexBuffer = c.Object; break;
+		case RENDER_COMMAND_SET_VERTEX_BUFFER:
+			state->VertexBuffer = c.Object;
+			state->VertexStride = c.Args[0];
+			break;
+
+		case RENDER_COMMAND_SET_SHADER:
+			if (!stageValid)
+				return false;
+			state->Shaders[c.Stage] = c.Object;
+			break;
+
+		case RENDER_COMMAND_SET_CONSTANT_BUFFER:
+			if (!stageValid || c.Slot >= BINDING_SLOTS_CONSTANT_BUFFER)
+				return false;
+			state->ConstantBuffers[c.Stage][c.Slot] = { c.Stage, c.Slot, c.Object, c.Args[0], c.Args[1] };
+			break;
+
+		case RENDER_COMMAND_SET_TEXTURE:
+			if (!stageValid || c.Slot >= BINDING_SLOTS_SHADER_RESOURCE)
+				return false;
+			state->Textures[c.Stage][c.Slot] = c.Object;
+			break;
+
+		case RENDER_COMMAND_SET_SAMPLER:
+			if (!stageValid || c.Slot >= BINDING_SLOTS_SAMPLER)
+				return false;
+			state->Samplers[c.Stage][c.Slot] = c.Object;
+			break;
+
+		case RENDER_COMMAND_DRAW:
+			return false;
+
+		case RENDER_COMMAND_DRAW_INDEXED:
+			if (next >= end || !DrawMatches(*state, drawList, drawList.GetDraw(next), c.Args[0]))
+				return false;
+			next++;
+			break;
+		}
+	}
+
+	return next == end;
+}
+
+
+// === BENCHMARK ====================================================
+
+// Milliseconds since a time
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Builds a frame resembling the scene's: a few shaders and
+// meshes, materials with a handful of textures each drawn
+// in runs, per-draw constants suballocated from a ring and
+// per-frame constants shared by every draw
+// --------------------------------------------------------
+static void BuildBenchmarkDraws(IRenderDevice* device, unsigned int drawCount, RenderDrawList* list)
+{
+	const unsigned int meshCount = 4;
+	const unsigned int materialCount = 8;
+	const unsigned int texturesPerMaterial = 4;
+	const unsigned char bytecode[16] = {};
+
+	RenderBufferDesc ringDesc = { RENDER_BUFFER_CONSTANT, 4 * 1024 * 1024, true };
+	RenderBufferDesc perFrameDesc = { RENDER_BUFFER_CONSTANT, 256, false };
+	RenderHandle ring = device->CreateBuffer(ringDesc, 0);
+	RenderHandle vsPerFrame = device->CreateBuffer(perFrameDesc, 0);
+	RenderHandle psPerFrame = device->CreateBuffer(perFrameDesc, 0);
+
+	RenderVertexElement elements[] = {
+		{ "POSITION", 0, RENDER_ELEMENT_FLOAT3, 0 },
+		{ "NORMAL", 0, RENDER_ELEMENT_FLOAT3, 12 } };
+	RenderHandle layout = device->CreateInputLayout(elements, 2, bytecode, sizeof(bytecode));
+	RenderHandle vs = device->CreateShader(BINDING_STAGE_VERTEX, bytecode, sizeof(bytecode));
+	RenderHandle ps[2] = {
+		device->CreateShader(BINDING_STAGE_PIXEL, bytecode, sizeof(bytecode)),
+		device->CreateShader(BINDING_STAGE_PIXEL, bytecode, sizeof(bytecode)) };
+
+	RenderHandle vertexBuffers[meshCount];
+	RenderHandle indexBuffers[meshCount];
+	for (unsigned int m = 0; m < meshCount; m++)
+	{
+		RenderBufferDesc vbDesc = { RENDER_BUFFER_VERTEX, 1024 * 24, false };
+		RenderBufferDesc ibDesc = { RENDER_BUFFER_INDEX, 4096 * 4, false };
+		vertexBuffers[m] = device->CreateBuffer(vbDesc, 0);
+		indexBuffers[m] = device->CreateBuffer(ibDesc, 0);
+	}
+
+	RenderTextureDesc textureDesc = { 256, 256, RENDER_FORMAT_RGBA8 };
+	RenderHandle textures[materialCount][texturesPerMaterial];
+	for (unsigned int m = 0; m < materialCount; m++)
+	{
+		for (unsigned int t = 0; t < texturesPerMaterial; t++)
+			textures[m][t] = device->CreateTexture(textureDesc, 0, 0);
+	}
+	RenderSamplerDesc samplerDesc = { RENDER_FILTER_ANISOTROPIC, RENDER_ADDRESS_WRAP, 16 };
+	RenderHandle sampler = device->CreateSampler(samplerDesc);
+
+	list->Clear();
+	for (unsigned int d = 0; d < drawCount; d++)
+	{
+		unsigned int material = (d / 16) % materialCount;
+		unsigned int mesh = d % meshCount;
+
+		// Each draw has 256 bytes of constants per stage
+		list->AddConstantBuffer(BINDING_STAGE_VERTEX, 0, vsPerFrame);
+		list->AddConstantBuffer(BINDING_STAGE_VERTEX, 1, ring, d * 32, 16);
+		list->AddConstantBuffer(BINDING_STAGE_PIXEL, 0, psPerFrame);
+		list->AddConstantBuffer(BINDING_STAGE_PIXEL, 1, ring, d * 32 + 16, 16);
+		for (unsigned int t = 0; t < texturesPerMaterial; t++)
+			list->AddTexture(BINDING_STAGE_PIXEL, t, textures[material][t]);
+		list->AddSampler(BINDING_STAGE_PIXEL, 0, sampler);
+
+		RenderDraw draw = {};
+		draw.InputLayout = layout;
+		draw.VertexShader = vs;
+		draw.PixelShader = ps[material % 2];
+		draw.VertexBuffer = vertexBuffers[mesh];
+		draw.IndexBuffer = indexBuffers[mesh];
+		draw.VertexStride = 24;
+		draw.IndexCount = 1024 * (mesh + 1);
+		list->AddDraw(draw);
+	}
+}
+
+// --------------------------------------------------------
+// Records draw list batches on null devices, one per
+// context, keeping each batch's stream so it can be checked
+// --------------------------------------------------------
+class NullCommandRecorder : public ICommandRecorder
+{
+public:
+	NullCommandRecorder(const RenderDrawList* list, unsigned int contextCount) : list(list)
+	{
+		for (unsigned int c = 0; c < contextCount; c++)
+		{
+			devices.push_back(std::unique_ptr<NullRenderDevice>(new NullRenderDevice()));
+			filters.push_back(std::unique_ptr<BindingFilter>(new BindingFilter()));
+		}
+	}
+
+	void BeginFrame(const std::vector<CommandBatch>& batches) { streams.resize(batches.size()); }
+	const std::vector<RenderCommand>& GetStream(unsigned int batch) { return streams[batch]; }
+
+	void BeginBatch(unsigned int context)
+	{
+		devices[context]->ClearCommands();
+		filters[context]->Invalidate();
+	}
+
+	void RecordDraw(unsigned int context, unsigned int draw)
+	{
+		list->Submit(devices[context].get(), filters[context].get(), draw, draw + 1);
+	}
+
+	// The stream is copied, like a command list taking what
+	// its deferred context recorded
+	void FinishBatch(unsigned int context, unsigned int batch)
+	{
+		streams[batch] = devices[context]->GetCommands();
+	}
+
+	void ExecuteBatch(unsigned int) {}
+
+private:
+	const RenderDrawList* list;
+	std::vector<std::unique_ptr<NullRenderDevice>> devices;
+	std::vector<std::unique_ptr<BindingFilter>> filters;
+	std::vector<std::vector<RenderCommand>> streams;
+};
+
+// --------------------------------------------------------
+// Times submitting a frame of draws to null devices, which
+// is all CPU cost, and checks what was submitted
+//
+// jobs      - System to record with across threads
+// drawCount - Draws per frame
+// frames    - Frames to time each way
+// timings   - Receives a timing per way of submitting
+// --------------------------------------------------------
+void RunRenderSubmissionBenchmark(JobSystem& jobs, unsigned int drawCount, unsigned int frames, std::vector<RenderSubmissionTiming>* timings)
+{
+	timings->clear();
+
+	NullRenderDevice device;
+	RenderDrawList list;
+	BuildBenchmarkDraws(&device, drawCount, &list);
+
+	// One device, with and without skipping redundant binds
+	BindingFilter filter;
+	const char* methods[] = { "Unfiltered", "Filtered" };
+	for (int m = 0; m < 2; m++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int f = 0; f < frames; f++)
+		{
+			device.ClearCommands();
+			filter.Invalidate();
+			list.Submit(&device, m == 0 ? 0 : &filter, 0, drawCount);
+		}
+
+		RenderSubmissionTiming timing;
+		timing.Method = methods[m];
+		timing.TimePerDraw = MillisecondsSince(start) * 1000.0 / ((double)frames * drawCount);
+		timing.Commands = (unsigned int)device.GetCommands().size();
+		timing.Verified = VerifyRenderCommands(device.GetCommands(), list, 0, drawCount);
+		timings->push_back(timing);
+	}
+
+	// A context per thread, as with deferred contexts
+	std::vector<CommandBatch> batches;
+	PlanCommandBatches(drawCount, jobs.GetThreadCount(), 1, &batches);
+	NullCommandRecorder recorder(&list, jobs.GetThreadCount());
+	recorder.BeginFrame(batches);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int f = 0; f < frames; f++)
+		RecordCommandBatches(jobs, batches, &recorder);
+
+	RenderSubmissionTiming timing;
+	timing.Method = "All Threads";
+	timing.TimePerDraw = MillisecondsSince(start) * 1000.0 / ((double)frames * drawCount);
+	timing.Commands = 0;
+	timing.Verified = true;
+	for (unsigned int b = 0; b < batches.size(); b++)
+	{
+		timing.Commands += (unsigned int)recorder.GetStream(b).size();
+		timing.Verified = timing.Verified && VerifyRenderCommands(recorder.GetStream(b), list, batches[b].Start, batches[b].End);
+	}
+	timings->push_back(timing);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "JobSystem.h"
+
+#include <vector>
+
+// Kinds of recorded commands
+#define RENDER_COMMAND_CREATE					0
+#define RENDER_COMMAND_RELEASE					1
+#define RENDER_COMMAND_UPDATE_BUFFER			2
+#define RENDER_COMMAND_SET_VIEWPORT				3
+#define RENDER_COMMAND_SET_INPUT_LAYOUT			4
+#define RENDER_COMMAND_SET_SHADER				5
+#define RENDER_COMMAND_SET_CONSTANT_BUFFER		6
+#define RENDER_COMMAND_SET_TEXTURE				7
+#define RENDER_COMMAND_SET_SAMPLER				8
+#define RENDER_COMMAND_SET_VERTEX_BUFFER		9
+#define RENDER_COMMAND_SET_INDEX_BUFFER			10
+#define RENDER_COMMAND_SET_RASTERIZER_STATE		11
+#define RENDER_COMMAND_SET_DEPTH_STENCIL_STATE	12
+#define RENDER_COMMAND_SET_BLEND_STATE			13
+#define RENDER_COMMAND_DRAW						14
+#define RENDER_COMMAND_DRAW_INDEXED				15
+#define RENDER_COMMAND_COUNT					16
+
+// --------------------------------------------------------
+// One call made to a NullRenderDevice.  What the arguments
+// mean depends on the command (sizes, counts, strides and
+// constant ranges, or the viewport rounded to pixels).
+// --------------------------------------------------------
+struct RenderCommand
+{
+	unsigned int Type;		// RENDER_COMMAND_*
+	unsigned int Stage;		// For shaders and resources
+	unsigned int Slot;		// For resources
+	RenderHandle Object;
+	unsigned int Args[4];
+};
+
+// --------------------------------------------------------
+// A device that draws nothing, just handing out handles and
+// (optionally) recording every call as a command, so the
+// CPU cost of submission can be measured and the resulting
+// streams checked anywhere.  Has no knowledge of Direct3D,
+// so it can be exercised on its own.
+// --------------------------------------------------------
+class NullRenderDevice : public IRenderDevice
+{
+public:
+	NullRenderDevice(bool recording = true);
+
+	// Recorded commands
+	const std::vector<RenderCommand>& GetCommands() const { return commands; }
+	void ClearCommands() { commands.clear(); }
+	void SetRecording(bool record) { recording = record; }
+	unsigned int GetCallCount(unsigned int type) const { return type < RENDER_COMMAND_COUNT ? callCounts[type] : 0; }
+	unsigned int GetLiveObjectCount() const { return liveObjects; }
+	void ResetCallCounts();
+
+	// IRenderDevice
+	RenderHandle CreateBuffer(const RenderBufferDesc& desc, const void* initialData);
+	RenderHandle CreateTexture(const RenderTextureDesc& desc, const void* pixels, unsigned int rowPitch);
+	RenderHandle CreateShader(unsigned int stage, const void* bytecode, size_t size);
+	RenderHandle CreateInputLayout(const RenderVertexElement* elements, unsigned int count, const void* vsBytecode, size_t size);
+	RenderHandle CreateSampler(const RenderSamplerDesc& desc);
+	RenderHandle CreateRasterizerState(const RenderRasterizerDesc& desc);
+	RenderHandle CreateDepthStencilState(const RenderDepthStencilDesc& desc);
+	RenderHandle CreateBlendState(const RenderBlendDesc& desc);
+	void Release(RenderHandle object);
+	void UpdateBuffer(RenderHandle buffer, const void* data, unsigned int size);
+
+	void SetViewport(float x, float y, float width, float height);
+	void SetInputLayout(RenderHandle layout);
+	void SetShader(unsigned int stage, RenderHandle shader);
+	void SetConstantBuffer(unsigned int stage, unsigned int slot, RenderHandle buffer, unsigned int firstConstant, unsigned int numConstants);
+	void SetTexture(unsigned int stage, unsigned int slot, RenderHandle texture);
+	void SetSampler(unsigned int stage, unsigned int slot, RenderHandle sampler);
+	void SetVertexBuffer(RenderHandle buffer, unsigned int stride);
+	void SetIndexBuffer(RenderHandle buffer);
+	void SetRasterizerState(RenderHandle state);
+	void SetDepthStencilState(RenderHandle state);
+	void SetBlendState(RenderHandle state);
+
+	void Draw(unsigned int vertexCount, unsigned int startVertex);
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+
+private:
+	bool recording;
+	std::vector<RenderCommand> commands;
+	unsigned int callCounts[RENDER_COMMAND_COUNT];
+	RenderHandle nextHandle;
+	unsigned int liveObjects;
+
+	void Record(unsigned int type, unsigned int stage = 0, unsigned int slot = 0, RenderHandle object = 0,
+		unsigned int a = 0, unsigned int b = 0, unsigned int c = 0, unsigned int d = 0);
+	RenderHandle Create(unsigned int a = 0, unsigned int b = 0, unsigned int c = 0);
+};
+
+// Replays a recorded stream from a blank state, checking
+// that every indexed draw sees exactly what the given draws
+// of the list bind (so filtering never dropped a bind)
+bool VerifyRenderCommands(const std::vector<RenderCommand>& commands, const RenderDrawList& drawList, unsigned int start, unsigned int end);
+
+// --------------------------------------------------------
+// Cost of submitting a draw list one way
+// --------------------------------------------------------
+struct RenderSubmissionTiming
+{
+	const char* Method;
+	double TimePerDraw;			// Microseconds
+	unsigned int Commands;		// Per frame, across every context
+	bool Verified;				// Did the stream(s) check out?
+};
+
+// Submits a synthetic frame of draws to null devices a few
+// ways (unfiltered, filtered, and across threads)
+void RunRenderSubmissionBenchmark(JobSystem& jobs, unsigned int drawCount, unsigned int frames, std::vector<RenderSubmissionTiming>* timings);
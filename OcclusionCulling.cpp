@@ -0,0 +1,839 @@
+#include "OcclusionCulling.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <float.h>
+#include <math.h>
+#include <emmintrin.h>
+
+using namespace DirectX;
+
+// Triangles are clipped to the near plane and to this many
+// buffer widths (and heights) around the buffer, which keeps
+// edge equations precise
+#define OCCLUSION_GUARD_BAND	4.0f
+
+// The most vertices clipping a triangle against the near
+// plane and the four guard band planes can produce
+#define OCCLUSION_MAX_CLIPPED_VERTICES	8
+
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Row vector times matrix, as DirectXMath does
+static XMFLOAT4 Transform(XMFLOAT4 v, const XMFLOAT4X4& m)
+{
+	return XMFLOAT4(
+		v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0] + v.w * m.m[3][0],
+		v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1] + v.w * m.m[3][1],
+		v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2] + v.w * m.m[3][2],
+		v.x * m.m[0][3] + v.y * m.m[1][3] + v.z * m.m[2][3] + v.w * m.m[3][3]);
+}
+
+static XMFLOAT4X4 Multiply(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+{
+	XMFLOAT4X4 result;
+	for (int r = 0; r < 4; r++)
+		for (int c = 0; c < 4; c++)
+			result.m[r][c] = a.m[r][0] * b.m[0][c] + a.m[r][1] * b.m[1][c] + a.m[r][2] * b.m[2][c] + a.m[r][3] * b.m[3][c];
+	return result;
+}
+
+
+// === OCCLUDERS ====================================================
+
+// --------------------------------------------------------
+// Fills in a mesh for an axis aligned box, as two clockwise
+// triangles per face
+// --------------------------------------------------------
+void MakeOcclusionBox(XMFLOAT3 min, XMFLOAT3 max, OcclusionMesh* mesh)
+{
+	// Corners, with bits 0, 1 and 2 choosing max x, y and z
+	mesh->Positions.resize(8);
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		mesh->Positions[i] = XMFLOAT3(
+			i & 1 ? max.x : min.x,
+			i & 2 ? max.y : min.y,
+			i & 4 ? max.z : min.z);
+	}
+
+	// -X, +X, -Y, +Y, -Z, +Z
+	const unsigned int faces[6][4] =
+	{
+		{ 0, 4, 6, 2 }, { 1, 3, 7, 5 },
+		{ 0, 1, 5, 4 }, { 2, 6, 7, 3 },
+		{ 0, 2, 3, 1 }, { 4, 5, 7, 6 },
+	};
+
+	mesh->Indices.clear();
+	for (auto& f : faces)
+	{
+		unsigned int quad[6] = { f[0], f[1], f[2], f[0], f[2], f[3] };
+		mesh->Indices.insert(mesh->Indices.end(), quad, quad + 6);
+	}
+}
+
+
+// === OCCLUSION BUFFER =============================================
+
+OcclusionBuffer::OcclusionBuffer() :
+	stats(),
+	viewProjection()
+{
+}
+
+// --------------------------------------------------------
+// Rasterizes occluders into the depth buffer, then reduces
+// it to the hierarchy occludees are tested against
+//
+// occluders      - What hides things
+// count          - How many occluders there are
+// viewProjection - Camera matrices, multiplied together
+// width          - Size of the depth buffer
+// height
+// jobs           - System to spread the work across
+// simd           - Rasterize 4 pixels at a time with SSE?
+// --------------------------------------------------------
+void OcclusionBuffer::Render(
+	const OcclusionOccluder* occluders,
+	unsigned int count,
+	const XMFLOAT4X4& viewProjection,
+	unsigned int width,
+	unsigned int height,
+	JobSystem& jobs,
+	bool simd)
+{
+	PROFILE_FUNCTION();
+	stats = OcclusionStats();
+	stats.Occluders = count;
+	this->viewProjection = viewProjection;
+
+	// Levels down to 1x1, made again only when the size changes
+	width = (std::max)(width, 1u);
+	height = (std::max)(height, 1u);
+	if (levels.empty() || levels[0].Width != width || levels[0].Height != height)
+	{
+		levels.clear();
+		unsigned int levelWidth = width;
+		unsigned int levelHeight = height;
+		while (true)
+		{
+			Level level;
+			level.Width = levelWidth;
+			level.Height = levelHeight;
+			level.Pitch = (levelWidth + 3) & ~3u;
+			level.Depth.resize(level.Pitch * levelHeight);
+			levels.push_back(level);
+
+			if (levelWidth == 1 && levelHeight == 1)
+				break;
+			levelWidth = (levelWidth + 1) / 2;
+			levelHeight = (levelHeight + 1) / 2;
+		}
+	}
+
+	// Triangles, kept in occluder order
+	auto start = std::chrono::high_resolution_clock::now();
+	occluderTriangles.resize(count);
+	jobs.ParallelFor(count, 1, [&](unsigned int first, unsigned int end)
+	{
+		for (unsigned int i = first; i < end; i++)
+			SetUpTriangles(occluders[i], &occluderTriangles[i]);
+	});
+
+	triangles.clear();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		stats.Triangles += (unsigned int)occluders[i].Mesh->Indices.size() / 3;
+		triangles.insert(triangles.end(), occluderTriangles[i].begin(), occluderTriangles[i].end());
+	}
+	stats.Rasterized = (unsigned int)triangles.size();
+	stats.SetupTime = MillisecondsSince(start);
+
+	// Bands of rows, each clearing and filling its own part
+	start = std::chrono::high_resolution_clock::now();
+	unsigned int bandCount = (height + OCCLUSION_BAND_HEIGHT - 1) / OCCLUSION_BAND_HEIGHT;
+	jobs.ParallelFor(bandCount, 1, [&](unsigned int first, unsigned int end)
+	{
+		for (unsigned int b = first; b < end; b++)
+			RasterizeBand(b, simd);
+	});
+	stats.RasterizeTime = MillisecondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	BuildHierarchy();
+	stats.HierarchyTime = MillisecondsSince(start);
+}
+
+// --------------------------------------------------------
+// Moves an occluder's triangles to clip space, then clips
+// them to the near plane and the guard band
+// --------------------------------------------------------
+void OcclusionBuffer::SetUpTriangles(const OcclusionOccluder& occluder, std::vector<Triangle>* output)
+{
+	output->clear();
+	const OcclusionMesh& mesh = *occluder.Mesh;
+	XMFLOAT4X4 worldViewProj = Multiply(occluder.World, viewProjection);
+
+	// Clip space planes, as (x, y, z, w) weights that must sum
+	// to zero or more
+	static const float planes[5][4] =
+	{
+		{ 0, 0, 1, 0 },						// Near
+		{ 1, 0, 0, OCCLUSION_GUARD_BAND },	// Left
+		{ -1, 0, 0, OCCLUSION_GUARD_BAND },	// Right
+		{ 0, 1, 0, OCCLUSION_GUARD_BAND },	// Bottom
+		{ 0, -1, 0, OCCLUSION_GUARD_BAND },	// Top
+	};
+
+	std::vector<XMFLOAT4> clip(mesh.Positions.size());
+	for (size_t i = 0; i < mesh.Positions.size(); i++)
+	{
+		const XMFLOAT3& p = mesh.Positions[i];
+		clip[i] = Transform(XMFLOAT4(p.x, p.y, p.z, 1.0f), worldViewProj);
+	}
+
+	for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3)
+	{
+		XMFLOAT4 polygon[OCCLUSION_MAX_CLIPPED_VERTICES];
+		polygon[0] = clip[mesh.Indices[i]];
+		polygon[1] = clip[mesh.Indices[i + 1]];
+		polygon[2] = clip[mesh.Indices[i + 2]];
+		unsigned int vertexCount = 3;
+
+		// Skip triangles entirely outside the view, which are most
+		// of them, before doing any clipping
+		bool outside = false;
+		static const float frustum[6][4] = { { 1, 0, 0, 1 }, { -1, 0, 0, 1 }, { 0, 1, 0, 1 }, { 0, -1, 0, 1 }, { 0, 0, 1, 0 }, { 0, 0, -1, 1 } };
+		for (int p = 0; p < 6 && !outside; p++)
+		{
+			outside = true;
+			for (unsigned int v = 0; v < 3 && outside; v++)
+			{
+				const XMFLOAT4& pos = polygon[v];
+				outside = pos.x * frustum[p][0] + pos.y * frustum[p][1] + pos.z * frustum[p][2] + pos.w * frustum[p][3] < 0.0f;
+			}
+		}
+		if (outside)
+			continue;
+
+		for (int p = 0; p < 5 && vertexCount >= 3; p++)
+		{
+			float distances[OCCLUSION_MAX_CLIPPED_VERTICES];
+			bool anyOutside = false;
+			for (unsigned int v = 0; v < vertexCount; v++)
+			{
+				const XMFLOAT4& pos = polygon[v];
+				distances[v] = pos.x * planes[p][0] + pos.y * planes[p][1] + pos.z * planes[p][2] + pos.w * planes[p][3];
+				anyOutside |= distances[v] < 0.0f;
+			}
+			if (!anyOutside)
+				continue;
+
+			XMFLOAT4 clipped[OCCLUSION_MAX_CLIPPED_VERTICES];
+			unsigned int clippedCount = 0;
+			for (unsigned int v = 0; v < vertexCount; v++)
+			{
+				unsigned int next = (v + 1) % vertexCount;
+				if (distances[v] >= 0.0f)
+					clipped[clippedCount++] = polygon[v];
+				if ((distances[v] >= 0.0f) != (distances[next] >= 0.0f) && clippedCount < OCCLUSION_MAX_CLIPPED_VERTICES)
+				{
+					float t = distances[v] / (distances[v] - distances[next]);
+					const XMFLOAT4& a = polygon[v];
+					const XMFLOAT4& b = polygon[next];
+					clipped[clippedCount++] = XMFLOAT4(
+						a.x + (b.x - a.x) * t,
+						a.y + (b.y - a.y) * t,
+						a.z + (b.z - a.z) * t,
+						a.w + (b.w - a.w) * t);
+				}
+			}
+
+			for (unsigned int v = 0; v < clippedCount; v++)
+				polygon[v] = clipped[v];
+			vertexCount = clippedCount;
+		}
+
+		for (unsigned int v = 1; v + 1 < vertexCount; v++)
+		{
+			XMFLOAT4 triangle[3] = { polygon[0], polygon[v], polygon[v + 1] };
+			AddTriangle(triangle, output);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Projects a clipped triangle, keeping it if it faces the
+// camera and covers any pixel centers
+// --------------------------------------------------------
+void OcclusionBuffer::AddTriangle(const XMFLOAT4* clip, std::vector<Triangle>* output)
+{
+	const Level& level = levels[0];
+	float x[3], y[3], z[3];
+	for (int v = 0; v < 3; v++)
+	{
+		float invW = 1.0f / clip[v].w;
+		x[v] = (clip[v].x * invW * 0.5f + 0.5f) * level.Width;
+		y[v] = (0.5f - clip[v].y * invW * 0.5f) * level.Height;
+		z[v] = clip[v].z * invW;
+	}
+
+	// Clockwise (on screen) is the front, as D3D's default
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (area <= 0.0f)
+		return;
+
+	Triangle t;
+	t.MinX = (std::max)((int)ceilf((std::min)(x[0], (std::min)(x[1], x[2])) - 0.5f), 0);
+	t.MinY = (std::max)((int)ceilf((std::min)(y[0], (std::min)(y[1], y[2])) - 0.5f), 0);
+	t.MaxX = (std::min)((int)floorf((std::max)(x[0], (std::max)(x[1], x[2])) - 0.5f), (int)level.Width - 1);
+	t.MaxY = (std::min)((int)floorf((std::max)(y[0], (std::max)(y[1], y[2])) - 0.5f), (int)level.Height - 1);
+	if (t.MinX > t.MaxX || t.MinY > t.MaxY)
+		return;
+
+	// Each edge's function, which is the weight of the vertex
+	// opposite it (scaled by the area)
+	static const int edgeStart[3] = { 1, 2, 0 };
+	static const int edgeEnd[3] = { 2, 0, 1 };
+	for (int e = 0; e < 3; e++)
+	{
+		int a = edgeStart[e];
+		int b = edgeEnd[e];
+		t.EdgeA[e] = y[a] - y[b];
+		t.EdgeB[e] = x[b] - x[a];
+		t.EdgeC[e] = -(t.EdgeA[e] * x[a] + t.EdgeB[e] * y[a]);
+	}
+
+	// Depth's plane across the screen
+	t.DepthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+	t.DepthB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+	t.DepthC = z[0] - t.DepthA * x[0] - t.DepthB * y[0];
+
+	output->push_back(t);
+}
+
+// --------------------------------------------------------
+// Clears one band of rows, then rasterizes every triangle
+// that overlaps it
+// --------------------------------------------------------
+void OcclusionBuffer::RasterizeBand(unsigned int band, bool simd)
+{
+	Level& level = levels[0];
+	int bandStart = (int)(band * OCCLUSION_BAND_HEIGHT);
+	int bandEnd = (std::min)(bandStart + OCCLUSION_BAND_HEIGHT, (int)level.Height) - 1;
+	std::fill(level.Depth.begin() + bandStart * level.Pitch, level.Depth.begin() + (bandEnd + 1) * level.Pitch, 1.0f);
+
+	for (auto& t : triangles)
+	{
+		int minY = (std::max)(t.MinY, bandStart);
+		int maxY = (std::min)(t.MaxY, bandEnd);
+		if (minY > maxY)
+			continue;
+
+		if (simd)
+			RasterizeSSE(t, minY, maxY);
+		else
+			RasterizeScalar(t, minY, maxY);
+	}
+}
+
+// --------------------------------------------------------
+// Rasterizes rows of a triangle a pixel at a time, keeping
+// the nearest depth at each pixel center it covers
+// --------------------------------------------------------
+void OcclusionBuffer::RasterizeScalar(const Triangle& t, int minY, int maxY)
+{
+	Level& level = levels[0];
+	for (int y = minY; y <= maxY; y++)
+	{
+		float py = (float)y + 0.5f;
+		float row[3];
+		for (int e = 0; e < 3; e++)
+			row[e] = t.EdgeB[e] * py + t.EdgeC[e];
+		float rowDepth = t.DepthB * py + t.DepthC;
+
+		float* depth = &level.Depth[y * level.Pitch];
+		for (int x = t.MinX; x <= t.MaxX; x++)
+		{
+			float px = (float)x + 0.5f;
+			if (t.EdgeA[0] * px + row[0] >= 0.0f &&
+				t.EdgeA[1] * px + row[1] >= 0.0f &&
+				t.EdgeA[2] * px + row[2] >= 0.0f)
+			{
+				float z = t.DepthA * px + rowDepth;
+				if (z < depth[x])
+					depth[x] = z;
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Same as RasterizeScalar(), 4 pixels at a time (starting
+// on a multiple of 4), giving exactly the same depths
+// --------------------------------------------------------
+void OcclusionBuffer::RasterizeSSE(const Triangle& t, int minY, int maxY)
+{
+	Level& level = levels[0];
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 laneCenters = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 first = _mm_set1_ps((float)t.MinX + 0.5f);
+	const __m128 last = _mm_set1_ps((float)t.MaxX + 0.5f);
+	const __m128 edgeA0 = _mm_set1_ps(t.EdgeA[0]);
+	const __m128 edgeA1 = _mm_set1_ps(t.EdgeA[1]);
+	const __m128 edgeA2 = _mm_set1_ps(t.EdgeA[2]);
+	const __m128 depthA = _mm_set1_ps(t.DepthA);
+
+	for (int y = minY; y <= maxY; y++)
+	{
+		float py = (float)y + 0.5f;
+		__m128 row0 = _mm_set1_ps(t.EdgeB[0] * py + t.EdgeC[0]);
+		__m128 row1 = _mm_set1_ps(t.EdgeB[1] * py + t.EdgeC[1]);
+		__m128 row2 = _mm_set1_ps(t.EdgeB[2] * py + t.EdgeC[2]);
+		__m128 rowDepth = _mm_set1_ps(t.DepthB * py + t.DepthC);
+
+		float* depth = &level.Depth[y * level.Pitch];
+		for (int x = t.MinX & ~3; x <= t.MaxX; x += 4)
+		{
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneCenters);
+
+			// Inside every edge, and within the triangle's bounds
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(px, first), _mm_cmple_ps(px, last));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA0, px), row0), zero));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA1, px), row1), zero));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA2, px), row2), zero));
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			__m128 old = _mm_loadu_ps(depth + x);
+			__m128 nearest = _mm_min_ps(_mm_add_ps(_mm_mul_ps(depthA, px), rowDepth), old);
+			_mm_storeu_ps(depth + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Reduces each level to the next, keeping the farthest
+// depth of each 2x2 block (or less, along odd edges)
+// --------------------------------------------------------
+void OcclusionBuffer::BuildHierarchy()
+{
+	for (size_t l = 1; l < levels.size(); l++)
+	{
+		const Level& source = levels[l - 1];
+		Level& level = levels[l];
+		for (unsigned int y = 0; y < level.Height; y++)
+		{
+			const float* row0 = &source.Depth[(y * 2) * source.Pitch];
+			const float* row1 = &source.Depth[(std::min)(y * 2 + 1, source.Height - 1) * source.Pitch];
+			float* out = &level.Depth[y * level.Pitch];
+			for (unsigned int x = 0; x < level.Width; x++)
+			{
+				unsigned int x0 = x * 2;
+				unsigned int x1 = (std::min)(x0 + 1, source.Width - 1);
+				out[x] = (std::max)((std::max)(row0[x0], row0[x1]), (std::max)(row1[x0], row1[x1]));
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Finds the pixels a box could cover and its nearest depth.
+// Boxes crossing the near plane cover the whole screen at
+// zero depth, so they're never occluded.
+//
+// Returns OCCLUSION_OUTSIDE if the box can't be seen at all
+// --------------------------------------------------------
+unsigned char OcclusionBuffer::ProjectBounds(const OcclusionBounds& bounds, ScreenRect* rect) const
+{
+	const Level& level = levels[0];
+	unsigned int outsideAll = 0x3F;
+	bool crossesNear = false;
+	XMFLOAT4 corners[8];
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		XMFLOAT4 corner(
+			i & 1 ? bounds.Max.x : bounds.Min.x,
+			i & 2 ? bounds.Max.y : bounds.Min.y,
+			i & 4 ? bounds.Max.z : bounds.Min.z,
+			1.0f);
+		XMFLOAT4 c = Transform(corner, viewProjection);
+		corners[i] = c;
+
+		unsigned int outside =
+			(c.x < -c.w ? 1 : 0) | (c.x > c.w ? 2 : 0) |
+			(c.y < -c.w ? 4 : 0) | (c.y > c.w ? 8 : 0) |
+			(c.z < 0.0f ? 16 : 0) | (c.z > c.w ? 32 : 0);
+		outsideAll &= outside;
+		crossesNear |= c.z < 0.0f;
+	}
+
+	if (outsideAll != 0)
+		return OCCLUSION_OUTSIDE;
+
+	if (crossesNear)
+	{
+		rect->MinX = 0;
+		rect->MinY = 0;
+		rect->MaxX = (int)level.Width - 1;
+		rect->MaxY = (int)level.Height - 1;
+		rect->NearestDepth = 0.0f;
+		return OCCLUSION_VISIBLE;
+	}
+
+	// Screen space bounds of the corners, which contain the
+	// whole box as they're all in front of the camera
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float nearest = FLT_MAX;
+	for (auto& c : corners)
+	{
+		float invW = 1.0f / c.w;
+		float x = (c.x * invW * 0.5f + 0.5f) * level.Width;
+		float y = (0.5f - c.y * invW * 0.5f) * level.Height;
+		minX = (std::min)(minX, x);
+		minY = (std::min)(minY, y);
+		maxX = (std::max)(maxX, x);
+		maxY = (std::max)(maxY, y);
+		nearest = (std::min)(nearest, c.z * invW);
+	}
+
+	rect->MinX = (std::max)((int)floorf(minX), 0);
+	rect->MinY = (std::max)((int)floorf(minY), 0);
+	rect->MaxX = (std::min)((int)floorf(maxX), (int)level.Width - 1);
+	rect->MaxY = (std::min)((int)floorf(maxY), (int)level.Height - 1);
+	rect->NearestDepth = nearest;
+	if (rect->MinX > rect->MaxX || rect->MinY > rect->MaxY)
+		return OCCLUSION_OUTSIDE;
+	return OCCLUSION_VISIBLE;
+}
+
+// --------------------------------------------------------
+// Tests a box against the coarsest level of the hierarchy
+// where it covers at most 2x2 texels
+// --------------------------------------------------------
+unsigned char OcclusionBuffer::TestBounds(const OcclusionBounds& bounds) const
+{
+	if (levels.empty())
+		return OCCLUSION_VISIBLE;
+
+	ScreenRect rect;
+	unsigned char result = ProjectBounds(bounds, &rect);
+	if (result != OCCLUSION_VISIBLE)
+		return result;
+
+	unsigned int l = 0;
+	while (l + 1 < levels.size() &&
+		((rect.MaxX >> l) - (rect.MinX >> l) > 1 || (rect.MaxY >> l) - (rect.MinY >> l) > 1))
+		l++;
+
+	const Level& level = levels[l];
+	float farthest = 0.0f;
+	for (int y = rect.MinY >> l; y <= rect.MaxY >> l; y++)
+		for (int x = rect.MinX >> l; x <= rect.MaxX >> l; x++)
+			farthest = (std::max)(farthest, level.Depth[y * level.Pitch + x]);
+
+	return rect.NearestDepth > farthest ? OCCLUSION_OCCLUDED : OCCLUSION_VISIBLE;
+}
+
+// --------------------------------------------------------
+// Same as TestBounds(), but always at full resolution
+// --------------------------------------------------------
+unsigned char OcclusionBuffer::TestBoundsReference(const OcclusionBounds& bounds) const
+{
+	if (levels.empty())
+		return OCCLUSION_VISIBLE;
+
+	ScreenRect rect;
+	unsigned char result = ProjectBounds(bounds, &rect);
+	if (result != OCCLUSION_VISIBLE)
+		return result;
+
+	const Level& level = levels[0];
+	for (int y = rect.MinY; y <= rect.MaxY; y++)
+	{
+		for (int x = rect.MinX; x <= rect.MaxX; x++)
+		{
+			if (level.Depth[y * level.Pitch + x] >= rect.NearestDepth)
+				return OCCLUSION_VISIBLE;
+		}
+	}
+	return OCCLUSION_OCCLUDED;
+}
+
+// --------------------------------------------------------
+// Tests many boxes at once, spread across threads
+//
+// bounds  - Boxes to test
+// count   - How many boxes there are
+// jobs    - System to spread the work across
+// results - Receives an OCCLUSION_ result for each box
+// --------------------------------------------------------
+void OcclusionBuffer::Test(const OcclusionBounds* bounds, unsigned int count, JobSystem& jobs, unsigned char* results)
+{
+	PROFILE_FUNCTION();
+	auto start = std::chrono::high_resolution_clock::now();
+
+	jobs.ParallelFor(count, 64, [&](unsigned int first, unsigned int end)
+	{
+		for (unsigned int i = first; i < end; i++)
+			results[i] = TestBounds(bounds[i]);
+	});
+
+	stats.Tested = count;
+	stats.Outside = 0;
+	stats.Occluded = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		stats.Outside += results[i] == OCCLUSION_OUTSIDE ? 1 : 0;
+		stats.Occluded += results[i] == OCCLUSION_OCCLUDED ? 1 : 0;
+	}
+	stats.TestTime = MillisecondsSince(start);
+}
+
+const float* OcclusionBuffer::GetLevel(unsigned int level, unsigned int* width, unsigned int* height, unsigned int* pitch) const
+{
+	const Level& l = levels[level];
+	*width = l.Width;
+	*height = l.Height;
+	*pitch = l.Pitch;
+	return &l.Depth[0];
+}
+
+
+// === TEST SCENE ===================================================
+
+// Left handed camera matrices, like Camera's
+static XMFLOAT4X4 LookToViewProjection(XMFLOAT3 eye, XMFLOAT3 forward, float aspectRatio)
+{
+	float length = sqrtf(forward.x * forward.x + forward.y * forward.y + forward.z * forward.z);
+	XMFLOAT3 f(forward.x / length, forward.y / length, forward.z / length);
+	float rightLength = sqrtf(f.z * f.z + f.x * f.x);
+	XMFLOAT3 r(f.z / rightLength, 0, -f.x / rightLength);
+	XMFLOAT3 u(f.y * r.z - f.z * r.y, f.z * r.x - f.x * r.z, f.x * r.y - f.y * r.x);
+
+	XMFLOAT4X4 view = {};
+	view.m[0][0] = r.x; view.m[0][1] = u.x; view.m[0][2] = f.x;
+	view.m[1][0] = r.y; view.m[1][1] = u.y; view.m[1][2] = f.y;
+	view.m[2][0] = r.z; view.m[2][1] = u.z; view.m[2][2] = f.z;
+	view.m[3][0] = -(r.x * eye.x + r.y * eye.y + r.z * eye.z);
+	view.m[3][1] = -(u.x * eye.x + u.y * eye.y + u.z * eye.z);
+	view.m[3][2] = -(f.x * eye.x + f.y * eye.y + f.z * eye.z);
+	view.m[3][3] = 1.0f;
+
+	float nearClip = 0.1f;
+	float farClip = 1000.0f;
+	float yScale = 1.0f / tanf(3.14159265359f / 6.0f);
+	XMFLOAT4X4 projection = {};
+	projection.m[0][0] = yScale / aspectRatio;
+	projection.m[1][1] = yScale;
+	projection.m[2][2] = farClip / (farClip - nearClip);
+	projection.m[2][3] = 1.0f;
+	projection.m[3][2] = -nearClip * farClip / (farClip - nearClip);
+
+	return Multiply(view, projection);
+}
+
+// --------------------------------------------------------
+// Fills in a square grid of city blocks, each a building of
+// random height with props scattered on the streets around
+// it, and a camera walking down the middle street while
+// looking around (with a 16:9 view)
+//
+// blocks        - Blocks along each side of the city
+// propsPerBlock - Small objects around each block
+// frames        - Camera positions along the path
+// scene         - Receives the scene (which is cleared first)
+// --------------------------------------------------------
+void BuildOcclusionTestScene(unsigned int blocks, unsigned int propsPerBlock, unsigned int frames, OcclusionTestScene* scene)
+{
+	*scene = OcclusionTestScene();
+	MakeOcclusionBox(XMFLOAT3(-0.5f, -0.5f, -0.5f), XMFLOAT3(0.5f, 0.5f, 0.5f), &scene->Box);
+
+	// Simple LCG, so every run tests exactly the same scene
+	unsigned int seed = 13579;
+	auto random = [&seed](float min, float max)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return min + (seed >> 8) / 16777216.0f * (max - min);
+	};
+
+	// Blocks are 10 units across, with 4 unit streets
+	const float blockSize = 10.0f;
+	const float pitch = 14.0f;
+	float cityStart = -(blocks * pitch) * 0.5f;
+	for (unsigned int bz = 0; bz < blocks; bz++)
+	{
+		for (unsigned int bx = 0; bx < blocks; bx++)
+		{
+			float centerX = cityStart + (bx + 0.5f) * pitch;
+			float centerZ = cityStart + (bz + 0.5f) * pitch;
+			float height = random(6.0f, 30.0f);
+
+			// The occluder is a little smaller than the building,
+			// as it has to be
+			XMFLOAT4X4 world = {};
+			world.m[0][0] = blockSize * 0.98f;
+			world.m[1][1] = height * 0.98f;
+			world.m[2][2] = blockSize * 0.98f;
+			world.m[3][0] = centerX;
+			world.m[3][1] = height * 0.5f;
+			world.m[3][2] = centerZ;
+			world.m[3][3] = 1.0f;
+			scene->Buildings.push_back(world);
+
+			OcclusionBounds building;
+			building.Min = XMFLOAT3(centerX - blockSize * 0.5f, 0.0f, centerZ - blockSize * 0.5f);
+			building.Max = XMFLOAT3(centerX + blockSize * 0.5f, height, centerZ + blockSize * 0.5f);
+			scene->Occludees.push_back(building);
+		}
+	}
+
+	// Props along the streets around each block
+	for (unsigned int b = 0; b < blocks * blocks; b++)
+	{
+		float centerX = cityStart + (b % blocks + 0.5f) * pitch;
+		float centerZ = cityStart + (b / blocks + 0.5f) * pitch;
+		for (unsigned int p = 0; p < propsPerBlock; p++)
+		{
+			// On one of the four sides, between building and street
+			float along = random(-pitch * 0.5f, pitch * 0.5f);
+			float across = random(blockSize * 0.5f + 0.2f, pitch * 0.5f);
+			int side = (int)random(0.0f, 4.0f);
+			float x = side < 2 ? along : (side == 2 ? across : -across);
+			float z = side < 2 ? (side == 0 ? across : -across) : along;
+
+			float size = random(0.3f, 1.5f);
+			OcclusionBounds prop;
+			prop.Min = XMFLOAT3(centerX + x - size * 0.5f, 0.0f, centerZ + z - size * 0.5f);
+			prop.Max = XMFLOAT3(centerX + x + size * 0.5f, size * 2.0f, centerZ + z + size * 0.5f);
+			scene->Occludees.push_back(prop);
+		}
+	}
+
+	// Walking down the street nearest the middle, at eye level,
+	// looking from side to side
+	float streetZ = cityStart + (blocks / 2) * pitch;
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		float t = frames > 1 ? (float)f / (frames - 1) : 0.0f;
+		XMFLOAT3 eye(cityStart + t * blocks * pitch, 1.7f, streetZ);
+		float yaw = 1.5707963f + sinf(t * 12.0f) * 0.8f;
+		scene->ViewProjections.push_back(LookToViewProjection(eye, XMFLOAT3(sinf(yaw), -0.05f, cosf(yaw)), 16.0f / 9.0f));
+	}
+}
+
+
+// === BENCHMARK ====================================================
+
+// --------------------------------------------------------
+// Culls the test scene along its camera path three ways:
+// scalar and SSE rasterizing on one thread, then SSE on the
+// given jobs.  Each is checked against the first (depth and
+// results must match exactly), and every occludee culled is
+// checked against the full resolution buffer, so culling
+// is conservative.
+//
+// jobs    - System to spread the work across
+// scene   - What to cull
+// timings - Receives one timing per method
+// --------------------------------------------------------
+void RunOcclusionCullingBenchmark(JobSystem& jobs, const OcclusionTestScene& scene, std::vector<OcclusionCullingTiming>* timings)
+{
+	timings->clear();
+
+	std::vector<OcclusionOccluder> occluders(scene.Buildings.size());
+	for (size_t i = 0; i < scene.Buildings.size(); i++)
+	{
+		occluders[i].Mesh = &scene.Box;
+		occluders[i].World = scene.Buildings[i];
+	}
+
+	struct Method
+	{
+		const char* Name;
+		bool SIMD;
+		bool Threaded;
+	};
+	const Method methods[] =
+	{
+		{ "Scalar", false, false },
+		{ "SSE", true, false },
+		{ "SSE Threaded", true, true },
+	};
+
+	// Results of the first method, for checking the others
+	unsigned int frames = (unsigned int)scene.ViewProjections.size();
+	unsigned int occludeeCount = (unsigned int)scene.Occludees.size();
+	std::vector<std::vector<float>> referenceDepth(frames);
+	std::vector<std::vector<unsigned char>> referenceResults(frames);
+
+	JobSystem singleThread(0);
+	for (auto& m : methods)
+	{
+		OcclusionCullingTiming timing = {};
+		timing.Method = m.Name;
+		timing.Verified = true;
+
+		OcclusionBuffer buffer;
+		std::vector<unsigned char> results(occludeeCount);
+		unsigned long long outside = 0;
+		unsigned long long occluded = 0;
+		JobSystem& methodJobs = m.Threaded ? jobs : singleThread;
+		unsigned int height = OCCLUSION_BUFFER_WIDTH * 9 / 16;
+		for (unsigned int f = 0; f < frames; f++)
+		{
+			buffer.Render(&occluders[0], (unsigned int)occluders.size(), scene.ViewProjections[f], OCCLUSION_BUFFER_WIDTH, height, methodJobs, m.SIMD);
+			if (occludeeCount > 0)
+				buffer.Test(&scene.Occludees[0], occludeeCount, methodJobs, &results[0]);
+
+			const OcclusionStats& stats = buffer.GetStats();
+			timing.RasterizeTime += stats.SetupTime + stats.RasterizeTime + stats.HierarchyTime;
+			timing.TestTime += stats.TestTime;
+			timing.Triangles += stats.Rasterized;
+			outside += stats.Outside;
+			occluded += stats.Occluded;
+
+			// Only the visible part of the buffer is compared
+			unsigned int width, levelHeight, pitch;
+			const float* depth = buffer.GetLevel(0, &width, &levelHeight, &pitch);
+			std::vector<float> visible(width * levelHeight);
+			for (unsigned int y = 0; y < levelHeight; y++)
+				std::copy(depth + y * pitch, depth + y * pitch + width, &visible[y * width]);
+
+			if (&m == &methods[0])
+			{
+				referenceDepth[f] = visible;
+				referenceResults[f] = results;
+			}
+			else if (visible != referenceDepth[f] || results != referenceResults[f])
+			{
+				timing.Verified = false;
+			}
+
+			for (unsigned int i = 0; i < occludeeCount; i++)
+			{
+				if (results[i] == OCCLUSION_OCCLUDED && buffer.TestBoundsReference(scene.Occludees[i]) != OCCLUSION_OCCLUDED)
+					timing.Verified = false;
+			}
+		}
+
+		if (frames > 0)
+		{
+			timing.RasterizeTime /= frames;
+			timing.TestTime /= frames;
+			timing.Triangles /= frames;
+			if (occludeeCount > 0)
+			{
+				timing.OutsidePercent = 100.0f * outside / ((float)frames * occludeeCount);
+				timing.OccludedPercent = 100.0f * occluded / ((float)frames * occludeeCount);
+			}
+		}
+		timings->push_back(timing);
+	}
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "JobSystem.h"
+
+// Width of the depth buffer occluders are rasterized into (the
+// height follows the aspect ratio), which is kept small since
+// only large occluders matter
+#define OCCLUSION_BUFFER_WIDTH	256
+
+// Rows of the depth buffer each job rasterizes
+#define OCCLUSION_BAND_HEIGHT	16
+
+// Results of testing an occludee
+#define OCCLUSION_VISIBLE		0
+#define OCCLUSION_OUTSIDE		1	// Outside the view frustum
+#define OCCLUSION_OCCLUDED		2	// Hidden behind occluders
+
+// --------------------------------------------------------
+// Simplified geometry for occluding, which must fit entirely
+// inside what it stands in for (or things would be culled
+// that can be seen around it).  Triangles are wound
+// clockwise from outside, like the meshes they replace.
+// --------------------------------------------------------
+struct OcclusionMesh
+{
+	std::vector<DirectX::XMFLOAT3> Positions;
+	std::vector<unsigned int> Indices;
+};
+
+// Fills in a mesh for an axis aligned box
+void MakeOcclusionBox(DirectX::XMFLOAT3 min, DirectX::XMFLOAT3 max, OcclusionMesh* mesh);
+
+// --------------------------------------------------------
+// An occluder mesh placed in the world
+// --------------------------------------------------------
+struct OcclusionOccluder
+{
+	const OcclusionMesh* Mesh;
+	DirectX::XMFLOAT4X4 World;
+};
+
+// --------------------------------------------------------
+// World space box around something that could be culled
+// --------------------------------------------------------
+struct OcclusionBounds
+{
+	DirectX::XMFLOAT3 Min;
+	DirectX::XMFLOAT3 Max;
+};
+
+// --------------------------------------------------------
+// Counts and times (in milliseconds) for the last frame
+// --------------------------------------------------------
+struct OcclusionStats
+{
+	unsigned int Occluders;
+	unsigned int Triangles;		// In every occluder
+	unsigned int Rasterized;	// After culling and clipping
+	unsigned int Tested;
+	unsigned int Outside;
+	unsigned int Occluded;
+	double SetupTime;
+	double RasterizeTime;
+	double HierarchyTime;
+	double TestTime;
+};
+
+// --------------------------------------------------------
+// Culls objects hidden behind others on the CPU, before
+// anything is submitted.  Occluders are rasterized into a
+// small depth buffer (keeping the nearest depth), which is
+// then reduced to a hierarchy of the farthest depth in each
+// 2x2 block.  Each occludee's bounds are projected to a
+// screen rectangle and their nearest depth, and compared
+// against the coarsest level where the rectangle covers at
+// most 2x2 texels: if every texel is nearer, it's hidden.
+//
+// Rasterizing is split into bands of rows, each a job that
+// rasterizes every triangle overlapping it, 4 pixels at a
+// time with SSE (or one at a time, as a reference the SSE
+// version should match exactly).  Occludees are tested in
+// parallel, and results don't depend on the thread count.
+//
+// Depth is sampled at pixel centers, so occludees can be
+// culled when only a sliver of them (smaller than a texel
+// of the buffer) would show.
+//
+// Has no knowledge of Direct3D, so it can be exercised on
+// its own.
+// --------------------------------------------------------
+class OcclusionBuffer
+{
+public:
+	OcclusionBuffer();
+
+	// Rasterizes occluders from a new point of view, at the
+	// given resolution
+	void Render(
+		const OcclusionOccluder* occluders,
+		unsigned int count,
+		const DirectX::XMFLOAT4X4& viewProjection,
+		unsigned int width,
+		unsigned int height,
+		JobSystem& jobs,
+		bool simd = true);
+
+	// Tests bounds against the last render, filling in one
+	// OCCLUSION_ result for each
+	void Test(const OcclusionBounds* bounds, unsigned int count, JobSystem& jobs, unsigned char* results);
+	unsigned char TestBounds(const OcclusionBounds& bounds) const;
+
+	// Same, but against every texel of the full resolution
+	// buffer, for checking the hierarchy
+	unsigned char TestBoundsReference(const OcclusionBounds& bounds) const;
+
+	// Depth at full resolution (level 0) and each coarser level,
+	// where rows are the level's pitch apart
+	unsigned int GetLevelCount() const { return (unsigned int)levels.size(); }
+	const float* GetLevel(unsigned int level, unsigned int* width, unsigned int* height, unsigned int* pitch) const;
+
+	const OcclusionStats& GetStats() { return stats; }
+
+private:
+	// Projected triangle, set up for edge functions and depth
+	// interpolation across the screen
+	struct Triangle
+	{
+		float EdgeA[3];			// Each edge is A * x + B * y + C,
+		float EdgeB[3];			// positive inside
+		float EdgeC[3];
+		float DepthA;			// Depth is A * x + B * y + C
+		float DepthB;
+		float DepthC;
+		int MinX, MinY, MaxX, MaxY;	// Pixels covered, within the buffer
+	};
+
+	// A box projected onto the screen
+	struct ScreenRect
+	{
+		int MinX, MinY, MaxX, MaxY;
+		float NearestDepth;
+	};
+
+	OcclusionStats stats;
+	DirectX::XMFLOAT4X4 viewProjection;
+	std::vector<std::vector<Triangle>> occluderTriangles;
+	std::vector<Triangle> triangles;
+
+	// Depth levels, each half the size of the last (rounding up)
+	struct Level
+	{
+		unsigned int Width;
+		unsigned int Height;
+		unsigned int Pitch;		// A multiple of 4, for SSE
+		std::vector<float> Depth;
+	};
+	std::vector<Level> levels;
+
+	void SetUpTriangles(const OcclusionOccluder& occluder, std::vector<Triangle>* output);
+	void AddTriangle(const DirectX::XMFLOAT4* clip, std::vector<Triangle>* output);
+	void RasterizeBand(unsigned int band, bool simd);
+	void RasterizeScalar(const Triangle& t, int minY, int maxY);
+	void RasterizeSSE(const Triangle& t, int minY, int maxY);
+	void BuildHierarchy();
+	unsigned char ProjectBounds(const OcclusionBounds& bounds, ScreenRect* rect) const;
+};
+
+// --------------------------------------------------------
+// A city of box buildings, seen from a camera moving along
+// its streets, with props scattered between the buildings
+// --------------------------------------------------------
+struct OcclusionTestScene
+{
+	OcclusionMesh Box;							// Unit cube at the origin
+	std::vector<DirectX::XMFLOAT4X4> Buildings;	// Occluders, scaling the box
+	std::vector<OcclusionBounds> Occludees;		// Buildings, then props
+	std::vector<DirectX::XMFLOAT4X4> ViewProjections;	// One per frame
+};
+
+// Fills in a grid of city blocks, with a number of props in
+// each, and a camera path (for a 16:9 buffer) over the given
+// number of frames
+void BuildOcclusionTestScene(unsigned int blocks, unsigned int propsPerBlock, unsigned int frames, OcclusionTestScene* scene);
+
+// --------------------------------------------------------
+// Cost (in milliseconds per frame) and effect of culling
+// the test scene one way
+// --------------------------------------------------------
+struct OcclusionCullingTiming
+{
+	const char* Method;
+	double RasterizeTime;		// Setup, rasterizing and the hierarchy
+	double TestTime;
+	unsigned int Triangles;		// Rasterized per frame
+	float OutsidePercent;		// Of occludees, on average
+	float OccludedPercent;
+	bool Verified;				// Same as the reference, and conservative?
+};
+
+// Culls the test scene's occludees every frame with scalar
+// and SSE rasterizing, on one thread and the given jobs
+void RunOcclusionCullingBenchmark(JobSystem& jobs, const OcclusionTestScene& scene, std::vector<OcclusionCullingTiming>* timings);
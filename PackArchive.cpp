@@ -0,0 +1,335 @@
+#include "PackArchive.h"
+
+#include <algorithm>
+#include <string.h>
+
+// Identifies an archive, and the version of its layout
+#define PACK_ARCHIVE_MAGIC		0x4B434150	// "PACK"
+#define PACK_ARCHIVE_VERSION	1
+
+// LZ4 block format limits
+#define LZ4_MIN_MATCH		4
+#define LZ4_LAST_LITERALS	5	// The block always ends with this many literals
+#define LZ4_MATCH_LIMIT		12	// No match starts this close to the end
+#define LZ4_MAX_OFFSET		65535
+#define LZ4_HASH_BITS		14
+
+// --------------------------------------------------------
+// The start of every archive.  The index table (one
+// IndexEntry and its path per file) is at the end, so the
+// data can be written first.
+// --------------------------------------------------------
+struct PackArchiveHeader
+{
+	unsigned int Magic;
+	unsigned int Version;
+	unsigned int EntryCount;
+	unsigned int Alignment;
+	unsigned long long IndexOffset;
+	unsigned long long IndexSize;
+};
+
+struct PackArchiveIndexEntry
+{
+	unsigned long long Offset;
+	unsigned long long StoredSize;
+	unsigned long long Size;
+	unsigned int Compression;
+	unsigned int PathLength;		// UTF-8 bytes that follow
+};
+
+
+// === LZ4 ==========================================================
+
+// Reads 4 bytes at any alignment
+static unsigned int Read32(const unsigned char* data)
+{
+	unsigned int value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+// Writes the rest of a length that didn't fit in its token
+static void WriteLZ4Length(std::vector<unsigned char>* out, size_t length)
+{
+	while (length >= 255)
+	{
+		out->push_back(255);
+		length -= 255;
+	}
+	out->push_back((unsigned char)length);
+}
+
+// Reads the rest of a length that didn't fit in its token,
+// returning false if it runs past the end
+static bool ReadLZ4Length(const unsigned char* in, size_t inSize, size_t* position, size_t* length)
+{
+	unsigned char byte;
+	do
+	{
+		if (*position >= inSize)
+			return false;
+		byte = in[(*position)++];
+		*length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+// Writes one sequence: literals, then a match (unless this
+// is the last sequence, which is only literals)
+static void WriteLZ4Sequence(std::vector<unsigned char>* out, const unsigned char* literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+	size_t matchCode = matchLength >= LZ4_MIN_MATCH ? matchLength - LZ4_MIN_MATCH : 0;
+	unsigned char token = (unsigned char)(((std::min)(literalCount, (size_t)15) << 4) | (matchLength > 0 ? (std::min)(matchCode, (size_t)15) : 0));
+	out->push_back(token);
+	if (literalCount >= 15)
+		WriteLZ4Length(out, literalCount - 15);
+	out->insert(out->end(), literals, literals + literalCount);
+
+	if (matchLength == 0)
+		return;
+
+	out->push_back((unsigned char)(offset & 0xFF));
+	out->push_back((unsigned char)(offset >> 8));
+	if (matchCode >= 15)
+		WriteLZ4Length(out, matchCode - 15);
+}
+
+// --------------------------------------------------------
+// Compresses data to an LZ4 block, finding matches with a
+// single hash table (so it favors speed over ratio, like
+// LZ4's default level).  Any LZ4 decoder can read the
+// result.
+//
+// data       - The bytes to compress
+// size       - Number of bytes
+// compressed - Receives the block
+// --------------------------------------------------------
+void CompressLZ4(const unsigned char* data, size_t size, std::vector<unsigned char>* compressed)
+{
+	compressed->clear();
+	compressed->reserve(size + size / 255 + 16);
+
+	std::vector<size_t> table((size_t)1 << LZ4_HASH_BITS, (size_t)-1);
+	size_t anchor = 0;
+	size_t position = 0;
+	while (size > LZ4_MATCH_LIMIT && position < size - LZ4_MATCH_LIMIT)
+	{
+		unsigned int sequence = Read32(data + position);
+		unsigned int hash = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+		size_t candidate = table[hash];
+		table[hash] = position;
+
+		if (candidate == (size_t)-1 ||
+			position - candidate > LZ4_MAX_OFFSET ||
+			Read32(data + candidate) != sequence)
+		{
+			position++;
+			continue;
+		}
+
+		// Extend the match as far as the block allows
+		size_t length = LZ4_MIN_MATCH;
+		size_t maxLength = size - LZ4_LAST_LITERALS - position;
+		while (length < maxLength && data[candidate + length] == data[position + length])
+			length++;
+
+		WriteLZ4Sequence(compressed, data + anchor, position - anchor, position - candidate, length);
+		position += length;
+		anchor = position;
+	}
+
+	WriteLZ4Sequence(compressed, data + anchor, size - anchor, 0, 0);
+}
+
+// --------------------------------------------------------
+// Decompresses an LZ4 block, checking every length and
+// offset so a corrupt block fails instead of overrunning
+//
+// Returns true only if the block decompresses to exactly
+// the expected size
+// --------------------------------------------------------
+bool DecompressLZ4(const unsigned char* compressed, size_t compressedSize, unsigned char* data, size_t size)
+{
+	size_t in = 0;
+	size_t out = 0;
+	while (in < compressedSize)
+	{
+		unsigned char token = compressed[in++];
+
+		// Literals
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !ReadLZ4Length(compressed, compressedSize, &in, &literalCount))
+			return false;
+		if (literalCount > compressedSize - in || literalCount > size - out)
+			return false;
+		memcpy(data + out, compressed + in, literalCount);
+		in += literalCount;
+		out += literalCount;
+
+		// The last sequence has no match
+		if (in == compressedSize)
+			break;
+
+		// Match, which may overlap what it's copying
+		if (compressedSize - in < 2)
+			return false;
+		size_t offset = compressed[in] | (compressed[in + 1] << 8);
+		in += 2;
+		if (offset == 0 || offset > out)
+			return false;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !ReadLZ4Length(compressed, compressedSize, &in, &matchLength))
+			return false;
+		matchLength += LZ4_MIN_MATCH;
+		if (matchLength > size - out)
+			return false;
+
+		for (size_t i = 0; i < matchLength; i++, out++)
+			data[out] = data[out - offset];
+	}
+
+	return out == size;
+}
+
+
+// === ARCHIVES =====================================================
+
+// Appends raw bytes to an archive
+static void Append(std::vector<unsigned char>* archive, const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	archive->insert(archive->end(), bytes, bytes + size);
+}
+
+// --------------------------------------------------------
+// Builds an archive: a header, each file's data (starting
+// on an aligned offset), then the index table.
+//
+// files    - What to put in the archive
+// compress - Compress entries with LZ4 when it's worthwhile
+// archive  - Receives the whole archive
+// --------------------------------------------------------
+void BuildPackArchive(const std::vector<PackArchiveSource>& files, bool compress, std::vector<unsigned char>* archive)
+{
+	archive->assign(sizeof(PackArchiveHeader), 0);
+
+	std::vector<PackArchiveIndexEntry> index(files.size());
+	std::vector<unsigned char> compressed;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		const PackArchiveSource& file = files[i];
+		archive->resize((archive->size() + PACK_ARCHIVE_ALIGNMENT - 1) / PACK_ARCHIVE_ALIGNMENT * PACK_ARCHIVE_ALIGNMENT, 0);
+
+		index[i].Offset = archive->size();
+		index[i].Size = file.Data.size();
+		index[i].Compression = PACK_ARCHIVE_STORED;
+		index[i].PathLength = (unsigned int)file.Path.size();
+
+		// Only worth decompressing if it saves at least an eighth
+		if (compress && !file.Data.empty())
+		{
+			CompressLZ4(&file.Data[0], file.Data.size(), &compressed);
+			if (compressed.size() < file.Data.size() - file.Data.size() / 8)
+			{
+				index[i].Compression = PACK_ARCHIVE_LZ4;
+				index[i].StoredSize = compressed.size();
+				Append(archive, &compressed[0], compressed.size());
+				continue;
+			}
+		}
+
+		index[i].StoredSize = file.Data.size();
+		if (!file.Data.empty())
+			Append(archive, &file.Data[0], file.Data.size());
+	}
+
+	PackArchiveHeader header = {};
+	header.Magic = PACK_ARCHIVE_MAGIC;
+	header.Version = PACK_ARCHIVE_VERSION;
+	header.EntryCount = (unsigned int)files.size();
+	header.Alignment = PACK_ARCHIVE_ALIGNMENT;
+	header.IndexOffset = archive->size();
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		Append(archive, &index[i], sizeof(PackArchiveIndexEntry));
+		Append(archive, files[i].Path.data(), files[i].Path.size());
+	}
+	header.IndexSize = archive->size() - header.IndexOffset;
+	memcpy(&(*archive)[0], &header, sizeof(header));
+}
+
+// --------------------------------------------------------
+// Reads the index table of an archive, checking that every
+// entry lies within it
+//
+// archive - The whole archive (usually memory mapped)
+// size    - Its size in bytes
+// entries - Receives every entry
+// --------------------------------------------------------
+bool ReadPackArchiveIndex(const unsigned char* archive, size_t size, std::vector<PackArchiveEntry>* entries)
+{
+	entries->clear();
+
+	PackArchiveHeader header;
+	if (size < sizeof(header))
+		return false;
+	memcpy(&header, archive, sizeof(header));
+	if (header.Magic != PACK_ARCHIVE_MAGIC ||
+		header.Version != PACK_ARCHIVE_VERSION ||
+		header.IndexOffset > size ||
+		header.IndexSize > size - header.IndexOffset)
+		return false;
+
+	// Every entry needs at least its fixed part in the index, so
+	// a larger count is corrupt (and mustn't be allocated for)
+	if (header.EntryCount > header.IndexSize / sizeof(PackArchiveIndexEntry))
+		return false;
+
+	size_t position = (size_t)header.IndexOffset;
+	size_t end = position + (size_t)header.IndexSize;
+	entries->resize(header.EntryCount);
+	for (auto& entry : *entries)
+	{
+		PackArchiveIndexEntry indexEntry;
+		if (end - position < sizeof(indexEntry))
+			return false;
+		memcpy(&indexEntry, archive + position, sizeof(indexEntry));
+		position += sizeof(indexEntry);
+
+		if (indexEntry.PathLength > end - position ||
+			indexEntry.Offset > header.IndexOffset ||
+			indexEntry.StoredSize > header.IndexOffset - indexEntry.Offset ||
+			(indexEntry.Compression == PACK_ARCHIVE_STORED && indexEntry.StoredSize != indexEntry.Size) ||
+			indexEntry.Compression > PACK_ARCHIVE_LZ4)
+			return false;
+
+		entry.Path.assign((const char*)archive + position, indexEntry.PathLength);
+		position += indexEntry.PathLength;
+		entry.Offset = indexEntry.Offset;
+		entry.StoredSize = indexEntry.StoredSize;
+		entry.Size = indexEntry.Size;
+		entry.Compression = indexEntry.Compression;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Copies (or decompresses) an entry's data out of an
+// archive.  Stored entries can also be used in place, at
+// archive + entry.Offset.
+//
+// data - Receives entry.Size bytes
+// --------------------------------------------------------
+bool ReadPackArchiveEntry(const unsigned char* archive, const PackArchiveEntry& entry, unsigned char* data)
+{
+	const unsigned char* stored = archive + entry.Offset;
+	if (entry.Compression == PACK_ARCHIVE_LZ4)
+		return DecompressLZ4(stored, (size_t)entry.StoredSize, data, (size_t)entry.Size);
+
+	if (entry.Size > 0)
+		memcpy(data, stored, (size_t)entry.Size);
+	return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Entry data starts on multiples of this many bytes (from the
+// start of the archive, which is mapped page-aligned)
+#define PACK_ARCHIVE_ALIGNMENT	64
+
+// How an entry's data is stored
+#define PACK_ARCHIVE_STORED	0	// As is, so it can be used in place
+#define PACK_ARCHIVE_LZ4	1	// LZ4 block format
+
+// --------------------------------------------------------
+// A file to put in an archive
+// --------------------------------------------------------
+struct PackArchiveSource
+{
+	std::string Path;					// UTF-8, as it will be looked up
+	std::vector<unsigned char> Data;
+};
+
+// --------------------------------------------------------
+// Where a file is in an archive, from its index table
+// --------------------------------------------------------
+struct PackArchiveEntry
+{
+	std::string Path;
+	unsigned long long Offset = 0;		// From the start of the archive
+	unsigned long long StoredSize = 0;	// Bytes in the archive
+	unsigned long long Size = 0;		// Bytes once decompressed
+	unsigned int Compression = PACK_ARCHIVE_STORED;
+};
+
+// LZ4 block compression, without the frame format around it
+// (the archive records each entry's sizes itself)
+void CompressLZ4(const unsigned char* data, size_t size, std::vector<unsigned char>* compressed);
+bool DecompressLZ4(const unsigned char* compressed, size_t compressedSize, unsigned char* data, size_t size);
+
+// Building an archive in memory, and reading one back.  When
+// compressing, entries that barely shrink are stored as is.
+void BuildPackArchive(const std::vector<PackArchiveSource>& files, bool compress, std::vector<unsigned char>* archive);
+bool ReadPackArchiveIndex(const unsigned char* archive, size_t size, std::vector<PackArchiveEntry>* entries);
+bool ReadPackArchiveEntry(const unsigned char* archive, const PackArchiveEntry& entry, unsigned char* data);
@@ -0,0 +1,27 @@
+#include "Parallel.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+// --------------------------------------------------------
+// Gets the number of threads work is split across: the
+// shared job system's workers plus the calling thread
+// --------------------------------------------------------
+unsigned int GetParallelThreadCount()
+{
+	return JobSystem::GetInstance().GetThreadCount();
+}
+
+// --------------------------------------------------------
+// Runs the body over the range in parallel chunks
+//
+// count - Number of items in the range
+// body  - Function to call for each chunk of the range
+// --------------------------------------------------------
+void ParallelFor(unsigned int count, const std::function<void(unsigned int start, unsigned int end)>& body)
+{
+	if (count == 0)
+		return;
+	PROFILE_FUNCTION();
+
+	JobSystem::GetInstance().ParallelFor(count, 1, body);
+}
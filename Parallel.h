@@ -0,0 +1,19 @@
+#pragma once
+
+#include <functional>
+
+// --------------------------------------------------------
+// Splits the range [0, count) into contiguous chunks and
+// runs the body on each chunk, using the calling thread
+// plus the shared job system's workers (one per extra
+// core).  Returns once every chunk has finished, and can
+// be called from within jobs.
+//
+// The body receives the start (inclusive) and end
+// (exclusive) of its chunk, and must be safe to run
+// concurrently with itself on disjoint ranges.
+// --------------------------------------------------------
+void ParallelFor(unsigned int count, const std::function<void(unsigned int start, unsigned int end)>& body);
+
+// Number of threads ParallelFor() will use
+unsigned int GetParallelThreadCount();
@@ -1,8 +1,6 @@
 
 #include "Lighting.hlsli"
-
-// How many lights could we handle?
-#define MAX_LIGHTS 128
+#include "Clustering.hlsli"
 
 // Data that can change per material
 cbuffer perMaterial : register(b0)
@@ -18,14 +16,25 @@ cbuffer perMaterial : register(b0)
 // Data that only changes once per frame
 cbuffer perFrame : register(b1)
 {
-	// An array of light data
-	Light lights[MAX_LIGHTS];
-
-	// The amount of lights THIS FRAME
-	int lightCount;
+	// Directional lights are at the start of the light buffer
+	int directionalLightCount;
 
 	// Needed for specular (reflection) calculation
 	float3 cameraPosition;
+
+	// Needed for finding this pixel's light cluster
+	float3 cameraForward;
+	float clusterDepthScale;
+	float2 screenSize;
+	float clusterDepthBias;
+};
+
+// The point and spot lights chosen for the entity being drawn,
+// or a negative count to use this pixel's cluster instead
+cbuffer perObjectLights : register(b2)
+{
+	uint4 objectLights[ENTITY_MAX_LIGHTS / 4];
+	int objectLightCount;
 };
 
 
@@ -47,6 +56,14 @@ Texture2D NormalMap			: register(t1);
 Texture2D RoughnessMap		: register(t2);
 SamplerState BasicSampler		: register(s0);
 
+// All active lights, tightly packed (no size limit)
+StructuredBuffer<Light> lights	: register(t8);
+
+// Offset and count into the index list for each cluster,
+// and the list of point and spot lights for all clusters
+StructuredBuffer<uint2> clusterGrid			: register(t9);
+StructuredBuffer<uint> clusterLightIndices	: register(t10);
+
 
 // Entry point for this pixel shader
 float4 main(VertexToPixel input) : SV_TARGET
@@ -72,22 +89,36 @@ float4 main(VertexToPixel input) : SV_TARGET
 	// Total color for this pixel
 	float3 totalColor = float3(0,0,0);
 
-	// Loop through all lights this frame
-	for(int i = 0; i < lightCount; i++)
+	// Directional lights affect every pixel
+	for(int i = 0; i < directionalLightCount; i++)
 	{
+		totalColor += DirLight(lights[i], input.normal, input.worldPos, cameraPosition, specPower, surfaceColor.rgb);
+	}
+
+	// Only the point and spot lights chosen for this entity, or
+	// else those assigned to this pixel's cluster
+	bool useObjectLights = objectLightCount >= 0;
+	uint2 cluster = uint2(0, objectLightCount);
+	if (!useObjectLights)
+	{
+		float viewDepth = dot(input.worldPos - cameraPosition, cameraForward);
+		cluster = clusterGrid[GetClusterIndex(input.screenPosition.xy, viewDepth, screenSize, clusterDepthScale, clusterDepthBias)];
+	}
+
+	for(uint c = 0; c < cluster.y; c++)
+	{
+		uint index = useObjectLights ? objectLights[c / 4][c % 4] : clusterLightIndices[cluster.x + c];
+		Light light = lights[index];
+
 		// Which kind of light?
-		switch (lights[i].Type)
+		switch (light.Type)
 		{
-		case LIGHT_TYPE_DIRECTIONAL:
-			totalColor += DirLight(lights[i], input.normal, input.worldPos, cameraPosition, specPower, surfaceColor.rgb);
-			break;
-
 		case LIGHT_TYPE_POINT:
-			totalColor += PointLight(lights[i], input.normal, input.worldPos, cameraPosition, specPower, surfaceColor.rgb);
+			totalColor += PointLight(light, input.normal, input.worldPos, cameraPosition, specPower, surfaceColor.rgb);
 			break;
 
 		case LIGHT_TYPE_SPOT:
-			totalColor += SpotLight(lights[i], input.normal, input.worldPos, cameraPosition, specPower, surfaceColor.rgb);
+			totalColor += SpotLight(light, input.normal, input.worldPos, cameraPosition, specPower, surfaceColor.rgb);
 			break;
 		}
 	}
@@ -1,8 +1,6 @@
 
 #include "Lighting.hlsli"
-
-// How many lights could we handle?
-#define MAX_LIGHTS 128
+#include "Clustering.hlsli"
 
 // Data that can change per material
 cbuffer perMaterial : register(b0)
@@ -13,19 +11,42 @@ cbuffer perMaterial : register(b0)
 	// UV adjustments
 	float2 uvScale;
 	float2 uvOffset;
+
+	// Are roughness (red) and metalness (green) packed into
+	// RoughnessMetalMap, rather than separate textures?
+	int packedRoughnessMetal;
 };
 
 // Data that only changes once per frame
 cbuffer perFrame : register(b1)
 {
-	// An array of light data
-	Light lights[MAX_LIGHTS];
-
-	// The amount of lights THIS FRAME
-	int lightCount;
+	// Directional lights are at the start of the light buffer
+	int directionalLightCount;
 
 	// Needed for specular (reflection) calculation
 	float3 cameraPosition;
+
+	// Needed for finding this pixel's light cluster
+	float3 cameraForward;
+	float clusterDepthScale;
+	float2 screenSize;
+	float clusterDepthBias;
+};
+
+// Image based lighting from the sky, set once per frame
+cbuffer perSky : register(b3)
+{
+	float4 irradianceSH[9];
+	float specularMipCount;
+	float iblIntensity; // Zero when the sky has no IBL
+};
+
+// The point and spot lights chosen for the entity being drawn,
+// or a negative count to use this pixel's cluster instead
+cbuffer perObjectLights : register(b2)
+{
+	uint4 objectLights[ENTITY_MAX_LIGHTS / 4];
+	int objectLightCount;
 };
 
 
@@ -46,8 +67,22 @@ Texture2D Albedo			: register(t0);
 Texture2D NormalMap			: register(t1);
 Texture2D RoughnessMap		: register(t2);
 Texture2D MetalMap			: register(t3);
+Texture2D RoughnessMetalMap	: register(t4);
 SamplerState BasicSampler	: register(s0);
 
+// Baked from the sky for image based lighting
+TextureCube SpecularIBL		: register(t5);
+Texture2D BRDFLookUp		: register(t6);
+SamplerState ClampSampler	: register(s1);
+
+// All active lights, tightly packed (no size limit)
+StructuredBuffer<Light> lights	: register(t8);
+
+// Offset and count into the index list for each cluster,
+// and the list of point and spot lights for all clusters
+StructuredBuffer<uint2> clusterGrid			: register(t9);
+StructuredBuffer<uint> clusterLightIndices	: register(t10);
+
 
 // Entry point for this pixel shader
 float4 main(VertexToPixel input) : SV_TARGET
@@ -61,8 +96,19 @@ float4 main(VertexToPixel input) : SV_TARGET
 
 	// Sample various textures
 	input.normal = NormalMapping(NormalMap, BasicSampler, input.uv, input.normal, input.tangent);
-	float roughness = RoughnessMap.Sample(BasicSampler, input.uv).r;
-	float metal = MetalMap.Sample(BasicSampler, input.uv).r;
+	float roughness;
+	float metal;
+	if (packedRoughnessMetal)
+	{
+		float2 roughnessMetal = RoughnessMetalMap.Sample(BasicSampler, input.uv).rg;
+		roughness = roughnessMetal.r;
+		metal = roughnessMetal.g;
+	}
+	else
+	{
+		roughness = RoughnessMap.Sample(BasicSampler, input.uv).r;
+		metal = MetalMap.Sample(BasicSampler, input.uv).r;
+	}
 
 	// Gamma correct the texture back to linear space and apply the color tint
 	float4 surfaceColor = Albedo.Sample(BasicSampler, input.uv);
@@ -76,26 +122,48 @@ float4 main(VertexToPixel input) : SV_TARGET
 	// Total color for this pixel
 	float3 totalColor = float3(0,0,0);
 
-	// Loop through all lights this frame
-	for(int i = 0; i < lightCount; i++)
+	// Directional lights affect every pixel
+	for(int i = 0; i < directionalLightCount; i++)
+	{
+		totalColor += DirLightPBR(lights[i], input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor);
+	}
+
+	// Only the point and spot lights chosen for this entity, or
+	// else those assigned to this pixel's cluster
+	bool useObjectLights = objectLightCount >= 0;
+	uint2 cluster = uint2(0, objectLightCount);
+	if (!useObjectLights)
+	{
+		float viewDepth = dot(input.worldPos - cameraPosition, cameraForward);
+		cluster = clusterGrid[GetClusterIndex(input.screenPosition.xy, viewDepth, screenSize, clusterDepthScale, clusterDepthBias)];
+	}
+
+	for(uint c = 0; c < cluster.y; c++)
 	{
+		uint index = useObjectLights ? objectLights[c / 4][c % 4] : clusterLightIndices[cluster.x + c];
+		Light light = lights[index];
+
 		// Which kind of light?
-		switch (lights[i].Type)
+		switch (light.Type)
 		{
-		case LIGHT_TYPE_DIRECTIONAL:
-			totalColor += DirLightPBR(lights[i], input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor);
-			break;
-
 		case LIGHT_TYPE_POINT:
-			totalColor += PointLightPBR(lights[i], input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor);
+			totalColor += PointLightPBR(light, input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor);
 			break;
 
 		case LIGHT_TYPE_SPOT:
-			totalColor += SpotLightPBR(lights[i], input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor);
+			totalColor += SpotLightPBR(light, input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor);
 			break;
 		}
 	}
 
+	// Light from the sky itself
+	if (iblIntensity > 0)
+	{
+		float3 irradiance = IrradianceSH(irradianceSH, input.normal);
+		totalColor += IndirectPBR(input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor,
+			irradiance, SpecularIBL, BRDFLookUp, ClampSampler, specularMipCount) * iblIntensity;
+	}
+
 	// Gamma correction
 	return float4(pow(totalColor, 1.0f / 2.2f), 1);
 }
\ No newline at end of file
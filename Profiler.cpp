@@ -0,0 +1,284 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+std::atomic<bool> Profiler::recording(true);
+
+// --------------------------------------------------------
+// A thread's events, in a ring.  Only the owning thread
+// writes them, and it publishes each by advancing Written,
+// so readers know which slots are complete.
+// --------------------------------------------------------
+struct ProfileThreadBuffer
+{
+	unsigned int Index = 0;
+	std::string Name;
+	bool InUse = false;			// By a running thread
+	unsigned int Depth = 0;
+	std::vector<ProfileEvent> Events;
+	std::atomic<unsigned long long> Written;
+
+	ProfileThreadBuffer() : Events(PROFILER_THREAD_EVENTS), Written(0) {}
+};
+
+// Every buffer ever made (never freed, so events survive
+// their threads), guarded for adding and reusing buffers
+static std::mutex buffersMutex;
+static std::vector<std::shared_ptr<ProfileThreadBuffer>> buffers;
+
+// Interned names, and recent frame start times
+static std::mutex namesMutex;
+static std::unordered_set<std::string> names;
+static std::mutex framesMutex;
+static unsigned long long frameStarts[PROFILER_FRAME_HISTORY];
+static unsigned long long frameCount = 0;
+
+// When the profiler started, which times are relative to
+static const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+// --------------------------------------------------------
+// Gives a thread a buffer the first time it records, and
+// frees it for reuse when the thread exits
+// --------------------------------------------------------
+struct ProfileThreadBufferHandle
+{
+	ProfileThreadBuffer* Buffer = 0;
+
+	ProfileThreadBuffer* Get()
+	{
+		if (Buffer)
+			return Buffer;
+
+		std::lock_guard<std::mutex> lock(buffersMutex);
+		for (auto& b : buffers)
+		{
+			if (!b->InUse)
+			{
+				Buffer = b.get();
+				break;
+			}
+		}
+
+		if (!Buffer)
+		{
+			buffers.push_back(std::make_shared<ProfileThreadBuffer>());
+			Buffer = buffers.back().get();
+			Buffer->Index = (unsigned int)buffers.size() - 1;
+		}
+
+		Buffer->InUse = true;
+		Buffer->Name.clear();
+		Buffer->Depth = 0;
+		return Buffer;
+	}
+
+	~ProfileThreadBufferHandle()
+	{
+		if (!Buffer)
+			return;
+
+		std::lock_guard<std::mutex> lock(buffersMutex);
+		Buffer->InUse = false;
+	}
+};
+
+static thread_local ProfileThreadBufferHandle threadBuffer;
+
+// --------------------------------------------------------
+// Nanoseconds since the profiler started
+// --------------------------------------------------------
+unsigned long long Profiler::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	ProfileThreadBuffer* buffer = threadBuffer.Get();
+	std::lock_guard<std::mutex> lock(buffersMutex);
+	buffer->Name = name;
+}
+
+// --------------------------------------------------------
+// Stores a copy of a name for as long as the program runs,
+// returning the same copy for the same name every time
+// --------------------------------------------------------
+const char* Profiler::Intern(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(namesMutex);
+	return names.insert(name).first->c_str();
+}
+
+// --------------------------------------------------------
+// Marks the start of a new frame (and the end of the last)
+// --------------------------------------------------------
+void Profiler::MarkFrame()
+{
+	unsigned long long now = Now();
+	std::lock_guard<std::mutex> lock(framesMutex);
+	frameStarts[frameCount % PROFILER_FRAME_HISTORY] = now;
+	frameCount++;
+}
+
+// --------------------------------------------------------
+// Gets when a finished frame started and ended
+//
+// framesAgo - 0 for the last finished frame, 1 for the one
+//             before it, and so on
+//
+// Returns false if that frame isn't remembered
+// --------------------------------------------------------
+bool Profiler::GetFrame(unsigned int framesAgo, unsigned long long* start, unsigned long long* end)
+{
+	std::lock_guard<std::mutex> lock(framesMutex);
+	if ((unsigned long long)framesAgo + 2 > frameCount || framesAgo + 1 >= PROFILER_FRAME_HISTORY)
+		return false;
+
+	unsigned long long endIndex = frameCount - 1 - framesAgo;
+	*start = frameStarts[(endIndex - 1) % PROFILER_FRAME_HISTORY];
+	*end = frameStarts[endIndex % PROFILER_FRAME_HISTORY];
+	return true;
+}
+
+// Number of finished frames that GetFrame() can find
+unsigned int Profiler::GetFrameCount()
+{
+	std::lock_guard<std::mutex> lock(framesMutex);
+	return (unsigned int)(std::min)(frameCount > 0 ? frameCount - 1 : 0, (unsigned long long)PROFILER_FRAME_HISTORY - 1);
+}
+
+// --------------------------------------------------------
+// Copies every event overlapping a span of time, from every
+// thread that has any.  Threads keep recording meanwhile,
+// so events that may have been overwritten while they were
+// copied are left out.
+// --------------------------------------------------------
+void Profiler::Collect(unsigned long long start, unsigned long long end, std::vector<ProfileThreadEvents>* threads)
+{
+	threads->clear();
+
+	std::vector<std::shared_ptr<ProfileThreadBuffer>> snapshot;
+	std::vector<std::string> threadNames;
+	{
+		std::lock_guard<std::mutex> lock(buffersMutex);
+		snapshot = buffers;
+		for (auto& b : buffers)
+			threadNames.push_back(b->Name);
+	}
+
+	for (size_t t = 0; t < snapshot.size(); t++)
+	{
+		ProfileThreadBuffer& buffer = *snapshot[t];
+		unsigned long long written = buffer.Written.load(std::memory_order_acquire);
+		unsigned long long first = written > PROFILER_THREAD_EVENTS ? written - PROFILER_THREAD_EVENTS : 0;
+
+		ProfileThreadEvents thread;
+		thread.Thread = buffer.Index;
+		thread.Name = threadNames[t];
+		std::vector<unsigned long long> indices;
+		for (unsigned long long i = first; i < written; i++)
+		{
+			const ProfileEvent& e = buffer.Events[i % PROFILER_THREAD_EVENTS];
+			if (e.End < start || e.Start > end)
+				continue;
+			thread.Events.push_back(e);
+			indices.push_back(i);
+		}
+
+		// Anything the thread has since lapped is unreliable
+		unsigned long long after = buffer.Written.load(std::memory_order_acquire);
+		unsigned long long safe = after > PROFILER_THREAD_EVENTS ? after - PROFILER_THREAD_EVENTS : 0;
+		size_t keep = 0;
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			if (indices[i] >= safe)
+				thread.Events[keep++] = thread.Events[i];
+		}
+		thread.Events.resize(keep);
+
+		if (!thread.Events.empty())
+			threads->push_back(thread);
+	}
+}
+
+// Writes a string as a JSON string, escaping what needs it
+static void WriteJSONString(std::ostream& out, const char* text)
+{
+	out << '"';
+	for (const char* c = text; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			out << '\\' << *c;
+		else if ((unsigned char)*c < 0x20)
+			out << ' ';
+		else
+			out << *c;
+	}
+	out << '"';
+}
+
+// --------------------------------------------------------
+// Writes events as a JSON trace: a name for each thread,
+// then each event as a "complete" event with its start and
+// duration in (fractional) microseconds
+// --------------------------------------------------------
+void Profiler::WriteChromeTrace(std::ostream& out, const std::vector<ProfileThreadEvents>& threads)
+{
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out.setf(std::ios::fixed);
+	out.precision(3);
+
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (auto& thread : threads)
+	{
+		std::string name = thread.Name.empty() ? "Thread " + std::to_string(thread.Thread) : thread.Name;
+		out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.Thread << ",\"args\":{\"name\":";
+		WriteJSONString(out, name.c_str());
+		out << "}}";
+		first = false;
+
+		for (auto& e : thread.Events)
+		{
+			out << ",\n{\"name\":";
+			WriteJSONString(out, e.Name);
+			out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.Thread <<
+				",\"ts\":" << e.Start / 1000.0 <<
+				",\"dur\":" << (e.End - e.Start) / 1000.0 << "}";
+		}
+	}
+	out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+// --------------------------------------------------------
+// Starts a scope on this thread, returning its depth
+// --------------------------------------------------------
+unsigned int Profiler::BeginScope()
+{
+	return threadBuffer.Get()->Depth++;
+}
+
+// --------------------------------------------------------
+// Finishes a scope on this thread, publishing its event
+// --------------------------------------------------------
+void Profiler::EndScope(const char* name, unsigned long long start, unsigned int depth)
+{
+	ProfileThreadBuffer* buffer = threadBuffer.Get();
+	buffer->Depth = depth;
+
+	unsigned long long written = buffer->Written.load(std::memory_order_relaxed);
+	ProfileEvent& e = buffer->Events[written % PROFILER_THREAD_EVENTS];
+	e.Name = name;
+	e.Start = start;
+	e.End = Now();
+	e.Depth = depth;
+	buffer->Written.store(written + 1, std::memory_order_release);
+}
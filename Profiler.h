@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Set to 0 (before this is included anywhere, such as in the
+// project settings) to compile every profiling marker out
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED	1
+#endif
+
+// Scopes remembered per thread (older ones are overwritten)
+#define PROFILER_THREAD_EVENTS	65536
+
+// Frame boundaries remembered, for finding recent frames
+#define PROFILER_FRAME_HISTORY	256
+
+// --------------------------------------------------------
+// One finished scope.  Times are in nanoseconds since the
+// profiler started.
+// --------------------------------------------------------
+struct ProfileEvent
+{
+	const char* Name;
+	unsigned long long Start;
+	unsigned long long End;
+	unsigned int Depth;			// Scopes it's nested inside
+};
+
+// --------------------------------------------------------
+// The events one thread recorded in some span of time
+// --------------------------------------------------------
+struct ProfileThreadEvents
+{
+	unsigned int Thread;		// Index of the thread's buffer
+	std::string Name;			// Empty if it was never named
+	std::vector<ProfileEvent> Events;
+};
+
+// --------------------------------------------------------
+// Records nested, named scopes on any number of threads.
+//
+// Each thread writes finished scopes into a buffer only it
+// writes to, so recording never takes a lock.  Buffers of
+// threads that exit are reused by later threads, as some
+// code (like JobGraph) starts threads often.
+//
+// Scopes are marked with the macros below, which cost one
+// atomic load while recording is off and nothing at all
+// when compiled out.  Has no knowledge of Direct3D.
+// --------------------------------------------------------
+class Profiler
+{
+public:
+	static unsigned long long Now();
+
+	static bool IsRecording() { return recording.load(std::memory_order_relaxed); }
+	static void SetRecording(bool record) { recording.store(record, std::memory_order_relaxed); }
+
+	// Names the calling thread in traces
+	static void SetThreadName(const char* name);
+
+	// Gives a name made at run time a permanent address, so it
+	// can be used as a scope name
+	static const char* Intern(const std::string& name);
+
+	// Frames, for views of whole frames.  Call MarkFrame() at
+	// the start of each frame on the main thread.
+	static void MarkFrame();
+	static bool GetFrame(unsigned int framesAgo, unsigned long long* start, unsigned long long* end);
+	static unsigned int GetFrameCount();
+
+	// Every event overlapping the given time, per thread
+	static void Collect(unsigned long long start, unsigned long long end, std::vector<ProfileThreadEvents>* threads);
+
+	// Writes events in the Chrome trace event format, which
+	// chrome://tracing and Perfetto can open
+	static void WriteChromeTrace(std::ostream& out, const std::vector<ProfileThreadEvents>& threads);
+
+	// Used by ProfileScope
+	static unsigned int BeginScope();
+	static void EndScope(const char* name, unsigned long long start, unsigned int depth);
+
+private:
+	static std::atomic<bool> recording;
+};
+
+// --------------------------------------------------------
+// Records the time from its creation to its destruction
+// --------------------------------------------------------
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name) :
+		name(name),
+		recording(Profiler::IsRecording())
+	{
+		if (recording)
+		{
+			depth = Profiler::BeginScope();
+			start = Profiler::Now();
+		}
+	}
+
+	~ProfileScope()
+	{
+		if (recording)
+			Profiler::EndScope(name, start, depth);
+	}
+
+private:
+	const char* name;
+	bool recording;
+	unsigned int depth;
+	unsigned long long start;
+};
+
+#if PROFILER_ENABLED
+#define PROFILE_CONCAT_INNER(a, b)	a##b
+#define PROFILE_CONCAT(a, b)		PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name)			ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION()			PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_THREAD(name)		Profiler::SetThreadName(name)
+#define PROFILE_FRAME()				Profiler::MarkFrame()
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD(name)
+#define PROFILE_FRAME()
+#endif
@@ -0,0 +1,110 @@
+#include "RenderDevice.h"
+
+#include <stdint.h>
+
+// The binding filter identifies objects by address, which a
+// handle stands in for just as well
+static const void* FilterKey(RenderHandle handle)
+{
+	return (const void*)(uintptr_t)handle;
+}
+
+// Is the bind necessary, given the filter (if any)?
+static bool ShouldBind(BindingFilter* filter, unsigned int stage, unsigned int type, unsigned int slot, RenderHandle object, unsigned int firstConstant = 0, unsigned int numConstants = 0)
+{
+	return !filter || filter->ShouldBind(stage, type, slot, FilterKey(object), firstConstant, numConstants);
+}
+
+void RenderDrawList::Clear()
+{
+	draws.clear();
+	constantBuffers.clear();
+	textures.clear();
+	samplers.clear();
+}
+
+void RenderDrawList::AddConstantBuffer(unsigned int stage, unsigned int slot, RenderHandle buffer, unsigned int firstConstant, unsigned int numConstants)
+{
+	constantBuffers.push_back({ stage, slot, buffer, firstConstant, numConstants });
+}
+
+void RenderDrawList::AddTexture(unsigned int stage, unsigned int slot, RenderHandle texture)
+{
+	textures.push_back({ stage, slot, texture, 0, 0 });
+}
+
+void RenderDrawList::AddSampler(unsigned int stage, unsigned int slot, RenderHandle sampler)
+{
+	samplers.push_back({ stage, slot, sampler, 0, 0 });
+}
+
+// --------------------------------------------------------
+// Adds a draw, which binds everything added since the last
+// draw (its own ranges are filled in here)
+// --------------------------------------------------------
+void RenderDrawList::AddDraw(const RenderDraw& draw)
+{
+	unsigned int previousConstantBuffers = draws.empty() ? 0 : draws.back().FirstConstantBuffer + draws.back().ConstantBufferCount;
+	unsigned int previousTextures = draws.empty() ? 0 : draws.back().FirstTexture + draws.back().TextureCount;
+	unsigned int previousSamplers = draws.empty() ? 0 : draws.back().FirstSampler + draws.back().SamplerCount;
+
+	RenderDraw added = draw;
+	added.FirstConstantBuffer = previousConstantBuffers;
+	added.ConstantBufferCount = (unsigned int)constantBuffers.size() - previousConstantBuffers;
+	added.FirstTexture = previousTextures;
+	added.TextureCount = (unsigned int)textures.size() - previousTextures;
+	added.FirstSampler = previousSamplers;
+	added.SamplerCount = (unsigned int)samplers.size() - previousSamplers;
+	draws.push_back(added);
+}
+
+// --------------------------------------------------------
+// Binds and draws a range of the list on a device.  Vertex
+// and index buffers are always bound, as with Mesh.
+//
+// device - Device to submit to
+// filter - Skips binds that are already in place (optional,
+//          and must match the device's current state)
+// start  - First draw to submit
+// end    - One past the last draw to submit
+// --------------------------------------------------------
+void RenderDrawList::Submit(IRenderDevice* device, BindingFilter* filter, unsigned int start, unsigned int end) const
+{
+	for (unsigned int d = start; d < end; d++)
+	{
+		const RenderDraw& draw = draws[d];
+
+		// Shaders
+		if (ShouldBind(filter, BINDING_STAGE_VERTEX, BINDING_TYPE_INPUT_LAYOUT, 0, draw.InputLayout))
+			device->SetInputLayout(draw.InputLayout);
+		if (ShouldBind(filter, BINDING_STAGE_VERTEX, BINDING_TYPE_SHADER, 0, draw.VertexShader))
+			device->SetShader(BINDING_STAGE_VERTEX, draw.VertexShader);
+		if (ShouldBind(filter, BINDING_STAGE_PIXEL, BINDING_TYPE_SHADER, 0, draw.PixelShader))
+			device->SetShader(BINDING_STAGE_PIXEL, draw.PixelShader);
+
+		// Resources
+		for (unsigned int i = draw.FirstConstantBuffer; i < draw.FirstConstantBuffer + draw.ConstantBufferCount; i++)
+		{
+			const RenderBinding& cb = constantBuffers[i];
+			if (ShouldBind(filter, cb.Stage, BINDING_TYPE_CONSTANT_BUFFER, cb.Slot, cb.Object, cb.FirstConstant, cb.NumConstants))
+				device->SetConstantBuffer(cb.Stage, cb.Slot, cb.Object, cb.FirstConstant, cb.NumConstants);
+		}
+		for (unsigned int i = draw.FirstTexture; i < draw.FirstTexture + draw.TextureCount; i++)
+		{
+			const RenderBinding& t = textures[i];
+			if (ShouldBind(filter, t.Stage, BINDING_TYPE_SHADER_RESOURCE, t.Slot, t.Object))
+				device->SetTexture(t.Stage, t.Slot, t.Object);
+		}
+		for (unsigned int i = draw.FirstSampler; i < draw.FirstSampler + draw.SamplerCount; i++)
+		{
+			const RenderBinding& s = samplers[i];
+			if (ShouldBind(filter, s.Stage, BINDING_TYPE_SAMPLER, s.Slot, s.Object))
+				device->SetSampler(s.Stage, s.Slot, s.Object);
+		}
+
+		// Geometry
+		device->SetVertexBuffer(draw.VertexBuffer, draw.VertexStride);
+		device->SetIndexBuffer(draw.IndexBuffer);
+		device->DrawIndexed(draw.IndexCount, 0, 0);
+	}
+}
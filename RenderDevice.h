@@ -0,0 +1,204 @@
+#pragma once
+
+#include "BindingFilter.h"
+
+#include <stddef.h>
+#include <vector>
+
+// Identifies a resource or state object on a device.  What
+// it holds is up to the device (D3D11 uses the address of
+// the object), but zero is never a valid object.
+typedef unsigned long long RenderHandle;
+
+// Kinds of buffers
+#define RENDER_BUFFER_VERTEX	0
+#define RENDER_BUFFER_INDEX		1
+#define RENDER_BUFFER_CONSTANT	2
+
+// Texture formats
+#define RENDER_FORMAT_RGBA8		0
+#define RENDER_FORMAT_R32_FLOAT	1
+
+// Vertex element formats
+#define RENDER_ELEMENT_FLOAT2	0
+#define RENDER_ELEMENT_FLOAT3	1
+#define RENDER_ELEMENT_FLOAT4	2
+
+// Sampler filtering and addressing
+#define RENDER_FILTER_POINT			0
+#define RENDER_FILTER_LINEAR		1
+#define RENDER_FILTER_ANISOTROPIC	2
+#define RENDER_ADDRESS_WRAP			0
+#define RENDER_ADDRESS_CLAMP		1
+
+// Triangle culling
+#define RENDER_CULL_NONE	0
+#define RENDER_CULL_FRONT	1
+#define RENDER_CULL_BACK	2
+
+// Shader stages are the BINDING_STAGE_* values, of which
+// devices support vertex and pixel shaders
+
+// --------------------------------------------------------
+// Descriptions of the things a device can create
+// --------------------------------------------------------
+struct RenderBufferDesc
+{
+	unsigned int Type;		// RENDER_BUFFER_*
+	unsigned int Size;		// In bytes
+	bool Dynamic;			// Updated often from the CPU?
+};
+
+struct RenderTextureDesc
+{
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int Format;	// RENDER_FORMAT_*
+};
+
+struct RenderVertexElement
+{
+	const char* Semantic;
+	unsigned int SemanticIndex;
+	unsigned int Format;	// RENDER_ELEMENT_*
+	unsigned int Offset;	// Bytes from the start of a vertex
+};
+
+struct RenderSamplerDesc
+{
+	unsigned int Filter;	// RENDER_FILTER_*
+	unsigned int Address;	// RENDER_ADDRESS_*
+	unsigned int MaxAnisotropy;
+};
+
+struct RenderRasterizerDesc
+{
+	unsigned int CullMode;	// RENDER_CULL_*
+	bool Wireframe;
+};
+
+struct RenderDepthStencilDesc
+{
+	bool DepthTest;
+	bool DepthWrite;
+	bool LessEqual;			// Otherwise strictly less
+};
+
+struct RenderBlendDesc
+{
+	bool AlphaBlend;		// Otherwise opaque
+};
+
+// --------------------------------------------------------
+// A thin layer over a graphics API's device and context:
+// creating buffers, textures, shaders and state, binding
+// them and drawing.  Only what the renderer needs is here,
+// so a backend is little more than a call per method.
+//
+// Objects are created with one reference, which Release()
+// gives up.  Binding a handle never takes a reference.
+// --------------------------------------------------------
+class IRenderDevice
+{
+public:
+	virtual ~IRenderDevice() {}
+
+	// Resources and state objects
+	virtual RenderHandle CreateBuffer(const RenderBufferDesc& desc, const void* initialData) = 0;
+	virtual RenderHandle CreateTexture(const RenderTextureDesc& desc, const void* pixels, unsigned int rowPitch) = 0;
+	virtual RenderHandle CreateShader(unsigned int stage, const void* bytecode, size_t size) = 0;
+	virtual RenderHandle CreateInputLayout(const RenderVertexElement* elements, unsigned int count, const void* vsBytecode, size_t size) = 0;
+	virtual RenderHandle CreateSampler(const RenderSamplerDesc& desc) = 0;
+	virtual RenderHandle CreateRasterizerState(const RenderRasterizerDesc& desc) = 0;
+	virtual RenderHandle CreateDepthStencilState(const RenderDepthStencilDesc& desc) = 0;
+	virtual RenderHandle CreateBlendState(const RenderBlendDesc& desc) = 0;
+	virtual void Release(RenderHandle object) = 0;
+	virtual void UpdateBuffer(RenderHandle buffer, const void* data, unsigned int size) = 0;
+
+	// Binding
+	virtual void SetViewport(float x, float y, float width, float height) = 0;
+	virtual void SetInputLayout(RenderHandle layout) = 0;
+	virtual void SetShader(unsigned int stage, RenderHandle shader) = 0;
+	virtual void SetConstantBuffer(unsigned int stage, unsigned int slot, RenderHandle buffer, unsigned int firstConstant = 0, unsigned int numConstants = 0) = 0;
+	virtual void SetTexture(unsigned int stage, unsigned int slot, RenderHandle texture) = 0;
+	virtual void SetSampler(unsigned int stage, unsigned int slot, RenderHandle sampler) = 0;
+	virtual void SetVertexBuffer(RenderHandle buffer, unsigned int stride) = 0;
+	virtual void SetIndexBuffer(RenderHandle buffer) = 0;
+	virtual void SetRasterizerState(RenderHandle state) = 0;
+	virtual void SetDepthStencilState(RenderHandle state) = 0;
+	virtual void SetBlendState(RenderHandle state) = 0;
+
+	// Drawing (always triangle lists, with 32-bit indices)
+	virtual void Draw(unsigned int vertexCount, unsigned int startVertex) = 0;
+	virtual void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) = 0;
+};
+
+// --------------------------------------------------------
+// Something bound for a draw.  For constant buffers, a
+// range of 16-byte constants (zero meaning all of it).
+// --------------------------------------------------------
+struct RenderBinding
+{
+	unsigned int Stage;
+	unsigned int Slot;
+	RenderHandle Object;
+	unsigned int FirstConstant;
+	unsigned int NumConstants;
+};
+
+// --------------------------------------------------------
+// Everything one indexed draw binds.  Constant buffers,
+// textures and samplers are ranges of the draw list's
+// binding lists.
+// --------------------------------------------------------
+struct RenderDraw
+{
+	RenderHandle InputLayout;
+	RenderHandle VertexShader;
+	RenderHandle PixelShader;
+	RenderHandle VertexBuffer;
+	RenderHandle IndexBuffer;
+	unsigned int VertexStride;
+	unsigned int IndexCount;
+
+	unsigned int FirstConstantBuffer;
+	unsigned int ConstantBufferCount;
+	unsigned int FirstTexture;
+	unsigned int TextureCount;
+	unsigned int FirstSampler;
+	unsigned int SamplerCount;
+};
+
+// --------------------------------------------------------
+// A frame's worth of draws, built up front and submitted to
+// a device afterwards, whole or in parts (possibly on
+// different threads, to different devices).  Bindings are
+// added first, and claimed by the next AddDraw().
+// --------------------------------------------------------
+class RenderDrawList
+{
+public:
+	void Clear();
+
+	// Building
+	void AddConstantBuffer(unsigned int stage, unsigned int slot, RenderHandle buffer, unsigned int firstConstant = 0, unsigned int numConstants = 0);
+	void AddTexture(unsigned int stage, unsigned int slot, RenderHandle texture);
+	void AddSampler(unsigned int stage, unsigned int slot, RenderHandle sampler);
+	void AddDraw(const RenderDraw& draw);
+
+	unsigned int GetDrawCount() const { return (unsigned int)draws.size(); }
+	const RenderDraw& GetDraw(unsigned int index) const { return draws[index]; }
+	const RenderBinding& GetConstantBuffer(unsigned int index) const { return constantBuffers[index]; }
+	const RenderBinding& GetTexture(unsigned int index) const { return textures[index]; }
+	const RenderBinding& GetSampler(unsigned int index) const { return samplers[index]; }
+
+	// Submitting draws [start, end), optionally skipping binds
+	// the filter has already seen
+	void Submit(IRenderDevice* device, BindingFilter* filter, unsigned int start, unsigned int end) const;
+
+private:
+	std::vector<RenderDraw> draws;
+	std::vector<RenderBinding> constantBuffers;
+	std::vector<RenderBinding> textures;
+	std::vector<RenderBinding> samplers;
+};
@@ -0,0 +1,287 @@
+#include "RingAllocator.h"
+
+// --------------------------------------------------------
+// Creates a ring of the given capacity.  Every allocation
+// is rounded up to (and placed on) a multiple of alignment.
+//
+// capacity  - Total bytes available in the ring
+// alignment - Size and offset alignment (must be a power of 2)
+// --------------------------------------------------------
+RingAllocator::RingAllocator(unsigned int capacity, unsigned int alignment) :
+	capacity(capacity & ~(alignment - 1)),
+	alignment(alignment),
+	head(0),
+	generation(0),
+	frameBytes(0),
+	frameAllocations(0),
+	frameWraps(0)
+{
+}
+
+// --------------------------------------------------------
+// Suballocates the requested number of bytes
+//
+// size       - Number of bytes needed (will be aligned)
+// allocation - Receives the resulting range
+// wrapped    - Set to true if this allocation started a new
+//              generation, meaning the owner must discard
+//              the old contents before writing
+//
+// Returns false if the request can never fit in the ring
+// --------------------------------------------------------
+bool RingAllocator::Allocate(unsigned int size, RingAllocation* allocation, bool* wrapped)
+{
+	// Round the size up to the alignment (checking the size
+	// first, so huge requests can't overflow to something small)
+	if (size == 0 || size > capacity)
+		return false;
+	unsigned int alignedSize = (size + alignment - 1) & ~(alignment - 1);
+
+	// Wrap when there isn't enough room left at the end, or
+	// when this is the very first allocation from the ring
+	*wrapped = false;
+	if (generation == 0 || head + alignedSize > capacity)
+	{
+		head = 0;
+		generation++;
+		frameWraps++;
+		*wrapped = true;
+	}
+
+	// Hand out the range and move the head along
+	allocation->Offset = head;
+	allocation->Size = alignedSize;
+	allocation->Generation = generation;
+	head += alignedSize;
+
+	frameBytes += alignedSize;
+	frameAllocations++;
+	return true;
+}
+
+// --------------------------------------------------------
+// Makes sure the next allocations, up to the given total,
+// all come from the same generation, wrapping right away if
+// they wouldn't fit before the end.  Nothing is allocated.
+//
+// size    - Total bytes of the allocations to follow (the
+//           sum of their aligned sizes)
+// wrapped - Set to true if this started a new generation,
+//           meaning the owner must discard the old contents
+//           before the next write
+//
+// Returns false if the total can never fit in the ring
+// --------------------------------------------------------
+bool RingAllocator::Reserve(unsigned int size, bool* wrapped)
+{
+	*wrapped = false;
+	if (size > capacity)
+		return false;
+	unsigned int alignedSize = (size + alignment - 1) & ~(alignment - 1);
+
+	if (generation == 0 || head + alignedSize > capacity)
+	{
+		head = 0;
+		generation++;
+		frameWraps++;
+		*wrapped = true;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Determines if the data from an earlier allocation is still
+// present in the ring (it has not been wrapped over since)
+// --------------------------------------------------------
+bool RingAllocator::IsAllocationValid(const RingAllocation& allocation) const
+{
+	return allocation.Generation != 0 && allocation.Generation == generation;
+}
+
+// --------------------------------------------------------
+// Forgets all allocations.  The next allocation will
+// start a new generation at the beginning of the ring.
+// --------------------------------------------------------
+void RingAllocator::Reset()
+{
+	head = capacity;
+}
+
+// --------------------------------------------------------
+// Resets the per-frame statistics
+// --------------------------------------------------------
+void RingAllocator::BeginFrame()
+{
+	frameBytes = 0;
+	frameAllocations = 0;
+	frameWraps = 0;
+}
+
+
+// === VALIDATION =============================================
+
+// Sizes are rounded up to the alignment, and every range
+// starts on it, as does the capacity
+static bool TestAlignment()
+{
+	RingAllocator ring(4096 + 100, 256);
+	if (ring.GetCapacity() != 4096)
+		return false;
+
+	const unsigned int sizes[] = { 1, 256, 257, 100, 511, 512 };
+	const unsigned int aligned[] = { 256, 256, 512, 256, 512, 512 };
+	unsigned int offset = 0;
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		RingAllocation a;
+		bool wrapped;
+		if (!ring.Allocate(sizes[i], &a, &wrapped) ||
+			a.Size != aligned[i] ||
+			a.Offset != offset ||
+			a.Offset % 256 != 0)
+			return false;
+		offset += aligned[i];
+	}
+	return true;
+}
+
+// The first allocation signals a discard, as does the first
+// one that doesn't fit before the end, and nothing between
+static bool TestWrapping()
+{
+	RingAllocator ring(1024, 256);
+	RingAllocation a;
+	bool wrapped;
+
+	ring.BeginFrame();
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		if (!ring.Allocate(200, &a, &wrapped) || wrapped != (i == 0) || a.Offset != i * 256)
+			return false;
+	}
+
+	// No room left, so back to the start
+	if (!ring.Allocate(1, &a, &wrapped) || !wrapped || a.Offset != 0)
+		return false;
+
+	// Too big for what's left (but not for the ring)
+	if (!ring.Allocate(768, &a, &wrapped) || wrapped || a.Offset != 256)
+		return false;
+	if (!ring.Allocate(512, &a, &wrapped) || !wrapped || a.Offset != 0)
+		return false;
+
+	return ring.GetFrameWraps() == 3 && ring.GetFrameAllocations() == 7;
+}
+
+// Allocations stay valid until the ring wraps over them
+static bool TestGenerations()
+{
+	RingAllocator ring(1024, 256);
+	RingAllocation never;
+	if (ring.IsAllocationValid(never))
+		return false;
+
+	RingAllocation first, second;
+	bool wrapped;
+	ring.Allocate(512, &first, &wrapped);
+	ring.Allocate(512, &second, &wrapped);
+	if (first.Generation != 1 || second.Generation != 1 ||
+		!ring.IsAllocationValid(first) || !ring.IsAllocationValid(second))
+		return false;
+
+	RingAllocation third;
+	ring.Allocate(256, &third, &wrapped);
+	return
+		third.Generation == 2 &&
+		ring.GetGeneration() == 2 &&
+		!ring.IsAllocationValid(first) &&
+		!ring.IsAllocationValid(second) &&
+		ring.IsAllocationValid(third);
+}
+
+// Reserving wraps early when the total won't fit, so the
+// allocations it covers all share one generation
+static bool TestReserve()
+{
+	RingAllocator ring(1024, 256);
+	RingAllocation a, b, c;
+	bool wrapped;
+	ring.Allocate(512, &a, &wrapped);
+
+	// Fits after the first allocation, so nothing happens
+	if (!ring.Reserve(512, &wrapped) || wrapped || ring.GetGeneration() != 1)
+		return false;
+
+	// Doesn't, so the ring wraps before anything is allocated
+	if (!ring.Reserve(768, &wrapped) || !wrapped || ring.GetGeneration() != 2)
+		return false;
+	if (!ring.Allocate(200, &a, &wrapped) || wrapped || a.Offset != 0 ||
+		!ring.Allocate(256, &b, &wrapped) || wrapped || b.Offset != 256 ||
+		!ring.Allocate(300, &c, &wrapped) || wrapped || c.Offset != 512)
+		return false;
+	if (!ring.IsAllocationValid(a) || !ring.IsAllocationValid(b) || !ring.IsAllocationValid(c))
+		return false;
+
+	// More than the whole ring can never be reserved
+	return !ring.Reserve(1025, &wrapped) && !wrapped && ring.GetGeneration() == 2;
+}
+
+// Requests that could never fit (or are empty) fail, and
+// leave the ring as it was
+static bool TestOversized()
+{
+	RingAllocator ring(1024, 256);
+	RingAllocation a;
+	bool wrapped;
+	ring.Allocate(256, &a, &wrapped);
+
+	RingAllocation rejected;
+	if (ring.Allocate(1025, &rejected, &wrapped) ||
+		ring.Allocate(0xFFFFFFF0, &rejected, &wrapped) ||
+		ring.Allocate(0, &rejected, &wrapped))
+		return false;
+	if (ring.GetGeneration() != 1 || !ring.IsAllocationValid(a))
+		return false;
+
+	// The next allocation carries on where the last left off,
+	// and the whole ring is still a valid size
+	if (!ring.Allocate(256, &a, &wrapped) || wrapped || a.Offset != 256)
+		return false;
+	return ring.Allocate(1024, &a, &wrapped) && wrapped && a.Offset == 0;
+}
+
+// Resetting makes the next allocation wrap, however much
+// room was left
+static bool TestReset()
+{
+	RingAllocator ring(4096, 256);
+	RingAllocation before, after;
+	bool wrapped;
+	ring.Allocate(256, &before, &wrapped);
+	ring.Reset();
+
+	return
+		ring.Allocate(256, &after, &wrapped) &&
+		wrapped &&
+		after.Offset == 0 &&
+		after.Generation == before.Generation + 1 &&
+		!ring.IsAllocationValid(before);
+}
+
+// --------------------------------------------------------
+// Runs each validation test on rings of its own
+//
+// results - Receives a result per test
+// --------------------------------------------------------
+void RunRingAllocatorValidation(std::vector<ValidationResult>* results)
+{
+	const ValidationTest<> tests[] = {
+		{ "Alignment", TestAlignment },
+		{ "Wrapping", TestWrapping },
+		{ "Generations", TestGenerations },
+		{ "Reserve", TestReserve },
+		{ "Oversized", TestOversized },
+		{ "Reset", TestReset } };
+
+	RunValidationTests(tests, 1, results);
+}
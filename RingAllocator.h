@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+#include "Validation.h"
+
+// Constant buffer offsets (for *SetConstantBuffers1) are measured in
+// 16-byte constants and must be multiples of 16 constants (256 bytes)
+#define CONSTANT_BUFFER_RING_ALIGNMENT 256
+
+// --------------------------------------------------------
+// A single suballocation from a ring
+// --------------------------------------------------------
+struct RingAllocation
+{
+	unsigned int Offset = 0;		// Byte offset into the ring
+	unsigned int Size = 0;			// Aligned size in bytes
+	unsigned int Generation = 0;	// Which "lap" of the ring this came from (0 = never allocated)
+};
+
+// --------------------------------------------------------
+// Linear suballocator that wraps around when it reaches
+// the end of its capacity.  Has no knowledge of Direct3D,
+// so it can be exercised on its own.
+//
+// Every wrap starts a new "generation".  The owner of the
+// memory is expected to discard (rename) the underlying
+// storage when a wrap occurs, which invalidates all
+// allocations from older generations.
+// --------------------------------------------------------
+class RingAllocator
+{
+public:
+	RingAllocator(unsigned int capacity, unsigned int alignment);
+
+	bool Allocate(unsigned int size, RingAllocation* allocation, bool* wrapped);
+	bool Reserve(unsigned int size, bool* wrapped);
+	bool IsAllocationValid(const RingAllocation& allocation) const;
+	void Reset();
+
+	// Per-frame statistics
+	void BeginFrame();
+	unsigned int GetCapacity() const { return capacity; }
+	unsigned int GetGeneration() const { return generation; }
+	unsigned int GetFrameBytes() const { return frameBytes; }
+	unsigned int GetFrameAllocations() const { return frameAllocations; }
+	unsigned int GetFrameWraps() const { return frameWraps; }
+
+private:
+	unsigned int capacity;
+	unsigned int alignment;
+	unsigned int head;
+	unsigned int generation;
+
+	unsigned int frameBytes;
+	unsigned int frameAllocations;
+	unsigned int frameWraps;
+};
+
+// Checks alignment, wrapping (and the discards it signals),
+// generations, reservations, oversized requests and resets
+// on small rings
+void RunRingAllocatorValidation(std::vector<ValidationResult>* results);
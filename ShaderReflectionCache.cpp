@@ -0,0 +1,469 @@
+#include "ShaderReflectionCache.h"
+#include "AssetRegistry.h"
+
+#include <string.h>
+
+// --------------------------------------------------------
+// Helpers for writing little pieces of the binary format.
+// Integers are written in the host's (little endian) order.
+// --------------------------------------------------------
+static void WriteUInt(std::vector<unsigned char>& bytes, unsigned int value)
+{
+	unsigned char raw[sizeof(value)];
+	memcpy(raw, &value, sizeof(value));
+	bytes.insert(bytes.end(), raw, raw + sizeof(value));
+}
+
+static void WriteUInt64(std::vector<unsigned char>& bytes, unsigned long long value)
+{
+	unsigned char raw[sizeof(value)];
+	memcpy(raw, &value, sizeof(value));
+	bytes.insert(bytes.end(), raw, raw + sizeof(value));
+}
+
+static void WriteString(std::vector<unsigned char>& bytes, const std::string& str)
+{
+	WriteUInt(bytes, (unsigned int)str.size());
+	bytes.insert(bytes.end(), str.begin(), str.end());
+}
+
+// --------------------------------------------------------
+// Bounds-checked reader for the binary format.  Once any
+// read fails, every subsequent read fails too, so callers
+// only need to check the result at the end.
+// --------------------------------------------------------
+struct CacheReader
+{
+	const unsigned char* Bytes;
+	size_t Size;
+	size_t Position;
+	bool Failed;
+
+	CacheReader(const unsigned char* bytes, size_t size) :
+		Bytes(bytes), Size(size), Position(0), Failed(bytes == 0) { }
+
+	bool Read(void* dest, size_t count)
+	{
+		if (Failed || count > Size - Position)
+		{
+			Failed = true;
+			return false;
+		}
+
+		memcpy(dest, Bytes + Position, count);
+		Position += count;
+		return true;
+	}
+
+	unsigned int ReadUInt()
+	{
+		unsigned int value = 0;
+		Read(&value, sizeof(value));
+		return value;
+	}
+
+	unsigned long long ReadUInt64()
+	{
+		unsigned long long value = 0;
+		Read(&value, sizeof(value));
+		return value;
+	}
+
+	std::string ReadString()
+	{
+		unsigned int length = ReadUInt();
+		if (Failed || length > Size - Position)
+		{
+			Failed = true;
+			return std::string();
+		}
+
+		std::string str((const char*)(Bytes + Position), length);
+		Position += length;
+		return str;
+	}
+
+	// Reads an element count, rejecting any count that could
+	// not possibly fit in the remaining bytes (corrupt files)
+	unsigned int ReadCount(size_t minElementSize)
+	{
+		unsigned int count = ReadUInt();
+		if (!Failed && count > (Size - Position) / minElementSize)
+			Failed = true;
+		return Failed ? 0 : count;
+	}
+};
+
+// --------------------------------------------------------
+// Hashes the bytes of a compiled shader, the same way as
+// every other asset
+//
+// data - The compiled shader bytes
+// size - Number of bytes
+// --------------------------------------------------------
+unsigned long long HashShaderBytes(const void* data, size_t size)
+{
+	return HashAssetData(data, size);
+}
+
+// --------------------------------------------------------
+// Writes reflection data into the compact binary format
+//
+// data  - The reflection data to write
+// bytes - Receives the binary data (replaces any contents)
+// --------------------------------------------------------
+void SerializeShaderReflection(const ShaderReflectionData& data, std::vector<unsigned char>& bytes)
+{
+	bytes.clear();
+
+	// Header
+	WriteUInt(bytes, SHADER_REFLECTION_CACHE_MAGIC);
+	WriteUInt(bytes, SHADER_REFLECTION_CACHE_VERSION);
+	WriteUInt64(bytes, data.Hash);
+
+	// Constant buffers and their variables
+	WriteUInt(bytes, (unsigned int)data.ConstantBuffers.size());
+	for (auto& cb : data.ConstantBuffers)
+	{
+		WriteString(bytes, cb.Name);
+		WriteUInt(bytes, cb.Type);
+		WriteUInt(bytes, cb.BindIndex);
+		WriteUInt(bytes, cb.Size);
+
+		WriteUInt(bytes, (unsigned int)cb.Variables.size());
+		for (auto& v : cb.Variables)
+		{
+			WriteString(bytes, v.Name);
+			WriteUInt(bytes, v.ByteOffset);
+			WriteUInt(bytes, v.Size);
+		}
+	}
+
+	// Resources
+	WriteUInt(bytes, (unsigned int)data.ShaderResourceViews.size());
+	for (auto& srv : data.ShaderResourceViews)
+	{
+		WriteString(bytes, srv.Name);
+		WriteUInt(bytes, srv.BindIndex);
+	}
+
+	WriteUInt(bytes, (unsigned int)data.Samplers.size());
+	for (auto& samp : data.Samplers)
+	{
+		WriteString(bytes, samp.Name);
+		WriteUInt(bytes, samp.BindIndex);
+	}
+
+	// Input signature
+	WriteUInt(bytes, (unsigned int)data.InputElements.size());
+	for (auto& e : data.InputElements)
+	{
+		WriteString(bytes, e.SemanticName);
+		WriteUInt(bytes, e.SemanticIndex);
+		WriteUInt(bytes, e.Format);
+		WriteUInt(bytes, e.PerInstance ? 1 : 0);
+	}
+}
+
+// --------------------------------------------------------
+// Reads reflection data from the compact binary format
+//
+// bytes - The binary data
+// size  - Number of bytes of binary data
+// data  - Receives the reflection data
+//
+// Returns false if the data is from a different version or
+// is truncated or otherwise corrupt, in which case the
+// shader should simply be reflected again
+// --------------------------------------------------------
+bool DeserializeShaderReflection(const unsigned char* bytes, size_t size, ShaderReflectionData* data)
+{
+	CacheReader reader(bytes, size);
+
+	// Header
+	if (reader.ReadUInt() != SHADER_REFLECTION_CACHE_MAGIC ||
+		reader.ReadUInt() != SHADER_REFLECTION_CACHE_VERSION)
+		return false;
+
+	ShaderReflectionData result;
+	result.Hash = reader.ReadUInt64();
+
+	// Smallest possible encodings of each element, used to
+	// reject impossible counts before allocating anything
+	const size_t minString = sizeof(unsigned int);
+	const size_t minVariable = minString + sizeof(unsigned int) * 2;
+	const size_t minBuffer = minString + sizeof(unsigned int) * 4;
+	const size_t minResource = minString + sizeof(unsigned int);
+	const size_t minElement = minString + sizeof(unsigned int) * 3;
+
+	// Constant buffers and their variables
+	result.ConstantBuffers.resize(reader.ReadCount(minBuffer));
+	for (auto& cb : result.ConstantBuffers)
+	{
+		cb.Name = reader.ReadString();
+		cb.Type = reader.ReadUInt();
+		cb.BindIndex = reader.ReadUInt();
+		cb.Size = reader.ReadUInt();
+
+		cb.Variables.resize(reader.ReadCount(minVariable));
+		for (auto& v : cb.Variables)
+		{
+			v.Name = reader.ReadString();
+			v.ByteOffset = reader.ReadUInt();
+			v.Size = reader.ReadUInt();
+
+			// Variables must lie within their buffer
+			if (v.ByteOffset > cb.Size || v.Size > cb.Size - v.ByteOffset)
+				return false;
+		}
+	}
+
+	// Resources
+	result.ShaderResourceViews.resize(reader.ReadCount(minResource));
+	for (auto& srv : result.ShaderResourceViews)
+	{
+		srv.Name = reader.ReadString();
+		srv.BindIndex = reader.ReadUInt();
+	}
+
+	result.Samplers.resize(reader.ReadCount(minResource));
+	for (auto& samp : result.Samplers)
+	{
+		samp.Name = reader.ReadString();
+		samp.BindIndex = reader.ReadUInt();
+	}
+
+	// Input signature
+	result.InputElements.resize(reader.ReadCount(minElement));
+	for (auto& e : result.InputElements)
+	{
+		e.SemanticName = reader.ReadString();
+		e.SemanticIndex = reader.ReadUInt();
+		e.Format = reader.ReadUInt();
+		e.PerInstance = reader.ReadUInt() != 0;
+	}
+
+	// Everything must have been read, with nothing left over
+	if (reader.Failed || reader.Position != size)
+		return false;
+
+	*data = result;
+	return true;
+}
+
+// --------------------------------------------------------
+// Reads a sidecar cache file's contents, then verifies it
+// belongs to the exact shader it's being loaded for
+//
+// bytes      - The binary data
+// size       - Number of bytes of binary data
+// shaderHash - HashShaderBytes() of the compiled shader
+// data       - Receives the reflection data
+//
+// Returns false if the data can't be read or was made for
+// another shader (such as one that's since been rebuilt)
+// --------------------------------------------------------
+bool ReadShaderReflectionCache(const unsigned char* bytes, size_t size, unsigned long long shaderHash, ShaderReflectionData* data)
+{
+	ShaderReflectionData result;
+	if (!DeserializeShaderReflection(bytes, size, &result))
+		return false;
+
+	if (result.Hash != shaderHash)
+		return false;
+
+	*data = result;
+	return true;
+}
+
+
+// === VALIDATION =============================================
+
+// --------------------------------------------------------
+// Reflection data shaped like the game's own shaders: a
+// few buffers (one empty), resources and an input layout
+// with per-instance elements
+// --------------------------------------------------------
+static ShaderReflectionData MakeFixture()
+{
+	ShaderReflectionData data;
+	data.Hash = 0x0123456789ABCDEFULL;
+
+	ReflectedConstantBuffer perFrame;
+	perFrame.Name = "perFrame";
+	perFrame.Type = 0;
+	perFrame.BindIndex = 0;
+	perFrame.Size = 144;
+	perFrame.Variables.push_back({ "view", 0, 64 });
+	perFrame.Variables.push_back({ "projection", 64, 64 });
+	perFrame.Variables.push_back({ "cameraPosition", 128, 12 });
+	data.ConstantBuffers.push_back(perFrame);
+
+	ReflectedConstantBuffer empty;
+	empty.Name = "";
+	empty.Type = 1;
+	empty.BindIndex = 3;
+	empty.Size = 16;
+	data.ConstantBuffers.push_back(empty);
+
+	data.ShaderResourceViews.push_back({ "Albedo", 0 });
+	data.ShaderResourceViews.push_back({ "NormalMap", 1 });
+	data.ShaderResourceViews.push_back({ "RoughnessMetal", 7 });
+	data.Samplers.push_back({ "BasicSampler", 0 });
+	data.Samplers.push_back({ "ClampSampler", 2 });
+
+	ReflectedInputElement position = { "POSITION", 0, 6, false };
+	ReflectedInputElement uv = { "TEXCOORD", 0, 16, false };
+	ReflectedInputElement world = { "WORLD", 3, 2, true };
+	data.InputElements.push_back(position);
+	data.InputElements.push_back(uv);
+	data.InputElements.push_back(world);
+	return data;
+}
+
+static bool Equal(const ShaderReflectionData& a, const ShaderReflectionData& b)
+{
+	if (a.Hash != b.Hash ||
+		a.ConstantBuffers.size() != b.ConstantBuffers.size() ||
+		a.ShaderResourceViews.size() != b.ShaderResourceViews.size() ||
+		a.Samplers.size() != b.Samplers.size() ||
+		a.InputElements.size() != b.InputElements.size())
+		return false;
+
+	for (size_t i = 0; i < a.ConstantBuffers.size(); i++)
+	{
+		const ReflectedConstantBuffer& ca = a.ConstantBuffers[i];
+		const ReflectedConstantBuffer& cb = b.ConstantBuffers[i];
+		if (ca.Name != cb.Name || ca.Type != cb.Type || ca.BindIndex != cb.BindIndex ||
+			ca.Size != cb.Size || ca.Variables.size() != cb.Variables.size())
+			return false;
+
+		for (size_t v = 0; v < ca.Variables.size(); v++)
+		{
+			if (ca.Variables[v].Name != cb.Variables[v].Name ||
+				ca.Variables[v].ByteOffset != cb.Variables[v].ByteOffset ||
+				ca.Variables[v].Size != cb.Variables[v].Size)
+				return false;
+		}
+	}
+
+	for (size_t i = 0; i < a.ShaderResourceViews.size(); i++)
+	{
+		if (a.ShaderResourceViews[i].Name != b.ShaderResourceViews[i].Name ||
+			a.ShaderResourceViews[i].BindIndex != b.ShaderResourceViews[i].BindIndex)
+			return false;
+	}
+
+	for (size_t i = 0; i < a.Samplers.size(); i++)
+	{
+		if (a.Samplers[i].Name != b.Samplers[i].Name ||
+			a.Samplers[i].BindIndex != b.Samplers[i].BindIndex)
+			return false;
+	}
+
+	for (size_t i = 0; i < a.InputElements.size(); i++)
+	{
+		const ReflectedInputElement& ea = a.InputElements[i];
+		const ReflectedInputElement& eb = b.InputElements[i];
+		if (ea.SemanticName != eb.SemanticName || ea.SemanticIndex != eb.SemanticIndex ||
+			ea.Format != eb.Format || ea.PerInstance != eb.PerInstance)
+			return false;
+	}
+	return true;
+}
+
+// The fixture comes back exactly as it went in
+static bool TestRoundTrip()
+{
+	ShaderReflectionData fixture = MakeFixture();
+	std::vector<unsigned char> bytes;
+	SerializeShaderReflection(fixture, bytes);
+
+	ShaderReflectionData read;
+	return
+		DeserializeShaderReflection(&bytes[0], bytes.size(), &read) &&
+		Equal(fixture, read);
+}
+
+// Every cut short copy fails, as does one with extra bytes,
+// and a failed read leaves the output alone
+static bool TestTruncated()
+{
+	std::vector<unsigned char> bytes;
+	SerializeShaderReflection(MakeFixture(), bytes);
+
+	ShaderReflectionData untouched;
+	untouched.Hash = 42;
+	for (size_t size = 0; size < bytes.size(); size++)
+	{
+		if (DeserializeShaderReflection(&bytes[0], size, &untouched) || untouched.Hash != 42)
+			return false;
+	}
+
+	bytes.push_back(0);
+	return !DeserializeShaderReflection(&bytes[0], bytes.size(), &untouched) && untouched.Hash == 42;
+}
+
+// Overwrites one of the header's integers
+static void PatchUInt(std::vector<unsigned char>& bytes, size_t offset, unsigned int value)
+{
+	memcpy(&bytes[offset], &value, sizeof(value));
+}
+
+static bool TestWrongMagic()
+{
+	std::vector<unsigned char> bytes;
+	SerializeShaderReflection(MakeFixture(), bytes);
+	PatchUInt(bytes, 0, SHADER_REFLECTION_CACHE_MAGIC ^ 0xFF);
+
+	ShaderReflectionData read;
+	return !DeserializeShaderReflection(&bytes[0], bytes.size(), &read);
+}
+
+static bool TestWrongVersion()
+{
+	std::vector<unsigned char> bytes;
+	SerializeShaderReflection(MakeFixture(), bytes);
+
+	ShaderReflectionData read;
+	PatchUInt(bytes, sizeof(unsigned int), SHADER_REFLECTION_CACHE_VERSION + 1);
+	if (DeserializeShaderReflection(&bytes[0], bytes.size(), &read))
+		return false;
+
+	PatchUInt(bytes, sizeof(unsigned int), SHADER_REFLECTION_CACHE_VERSION - 1);
+	return !DeserializeShaderReflection(&bytes[0], bytes.size(), &read);
+}
+
+// Readable data made for a different shader is refused,
+// while the same data for the right shader is accepted
+static bool TestHashMismatch()
+{
+	ShaderReflectionData fixture = MakeFixture();
+	std::vector<unsigned char> bytes;
+	SerializeShaderReflection(fixture, bytes);
+
+	ShaderReflectionData read;
+	if (ReadShaderReflectionCache(&bytes[0], bytes.size(), fixture.Hash + 1, &read))
+		return false;
+
+	return
+		ReadShaderReflectionCache(&bytes[0], bytes.size(), fixture.Hash, &read) &&
+		Equal(fixture, read);
+}
+
+// --------------------------------------------------------
+// Runs each validation test on the cache format
+//
+// results - Filled in with one result per test
+// --------------------------------------------------------
+void RunShaderReflectionValidation(std::vector<ValidationResult>* results)
+{
+	const ValidationTest<> tests[] = {
+		{ "Round Trip", TestRoundTrip },
+		{ "Truncated", TestTruncated },
+		{ "Wrong Magic", TestWrongMagic },
+		{ "Wrong Version", TestWrongVersion },
+		{ "Hash Mismatch", TestHashMismatch } };
+
+	RunValidationTests(tests, 1, results);
+}
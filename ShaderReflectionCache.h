@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Validation.h"
+
+// Identifies (and versions) the binary layout of a cache file
+#define SHADER_REFLECTION_CACHE_MAGIC	0x43525353 // "SSRC"
+#define SHADER_REFLECTION_CACHE_VERSION	1
+
+// --------------------------------------------------------
+// Reflected layout of a single variable within a cbuffer
+// --------------------------------------------------------
+struct ReflectedVariable
+{
+	std::string Name;
+	unsigned int ByteOffset = 0;
+	unsigned int Size = 0;
+};
+
+// --------------------------------------------------------
+// Reflected layout of a single constant buffer
+// --------------------------------------------------------
+struct ReflectedConstantBuffer
+{
+	std::string Name;
+	unsigned int Type = 0;		// A D3D_CBUFFER_TYPE value
+	unsigned int BindIndex = 0;
+	unsigned int Size = 0;
+	std::vector<ReflectedVariable> Variables;
+};
+
+// --------------------------------------------------------
+// A named bind point (texture, structured buffer, sampler)
+// --------------------------------------------------------
+struct ReflectedResource
+{
+	std::string Name;
+	unsigned int BindIndex = 0;
+};
+
+// --------------------------------------------------------
+// A single input parameter of a shader, used for creating
+// vertex shader input layouts without reflection
+// --------------------------------------------------------
+struct ReflectedInputElement
+{
+	std::string SemanticName;
+	unsigned int SemanticIndex = 0;
+	unsigned int Format = 0;	// A DXGI_FORMAT value
+	bool PerInstance = false;
+};
+
+// --------------------------------------------------------
+// Everything SimpleShader needs to know about a compiled
+// shader, in the same order reflection reports it
+// --------------------------------------------------------
+struct ShaderReflectionData
+{
+	unsigned long long Hash = 0; // Hash of the compiled shader bytes
+	std::vector<ReflectedConstantBuffer> ConstantBuffers;
+	std::vector<ReflectedResource> ShaderResourceViews;
+	std::vector<ReflectedResource> Samplers;
+	std::vector<ReflectedInputElement> InputElements;
+};
+
+// Hashing the compiled shader, which keys the cache
+unsigned long long HashShaderBytes(const void* data, size_t size);
+
+// Converting to and from the compact sidecar format
+void SerializeShaderReflection(const ShaderReflectionData& data, std::vector<unsigned char>& bytes);
+bool DeserializeShaderReflection(const unsigned char* bytes, size_t size, ShaderReflectionData* data);
+
+// Reads a sidecar cache, only accepting it if it was made
+// for the shader with the given hash
+bool ReadShaderReflectionCache(const unsigned char* bytes, size_t size, unsigned long long shaderHash, ShaderReflectionData* data);
+
+// Checks that a known fixture survives a round trip field
+// by field, and that truncated data, a wrong magic or
+// version and a mismatched shader hash are all rejected
+void RunShaderReflectionValidation(std::vector<ValidationResult>* results);
@@ -1,9 +1,20 @@
 #include "SimpleShader.h"
+#include "D3D11RenderDevice.h"
+#include "NullRenderDevice.h"
+
+#include <algorithm>
+#include <fstream>
 
 // Default error reporting state
 bool ISimpleShader::ReportErrors = false;
 bool ISimpleShader::ReportWarnings = false;
 
+// Reflection results are cached next to each shader by default
+bool ISimpleShader::ReflectionCacheEnabled = true;
+
+// Shader files are read straight from disk by default
+std::function<HRESULT(LPCWSTR shaderFile, ID3DBlob** blob)> ISimpleShader::FileReader;
+
 // To enable error reporting, use either or both 
 // of the following lines somewhere in your program, 
 // preferably before loading/using any shaders.
@@ -21,14 +32,17 @@ bool ISimpleShader::ReportWarnings = false;
 // --------------------------------------------------------
 ISimpleShader::ISimpleShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
 {
-	// Save the device
+	// Save the device, and bind through the context until
+	// told otherwise
 	this->device = device;
 	this->deviceContext = context;
+	this->renderDevice = std::make_shared<D3D11RenderDevice>(device, context);
 
 	// Set up fields
 	this->constantBufferCount = 0;
 	this->constantBuffers = 0;
 	this->shaderValid = false;
+	this->reflectionCached = false;
 }
 
 // --------------------------------------------------------
@@ -72,7 +86,8 @@ void ISimpleShader::CleanUp()
 
 // --------------------------------------------------------
 // Loads the specified shader and builds the variable table 
-// using shader reflection.
+// using shader reflection (or the cached results of an
+// earlier reflection of the same shader).
 //
 // shaderFile - A "wide string" specifying the compiled shader to load
 // 
@@ -81,7 +96,9 @@ void ISimpleShader::CleanUp()
 bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 {
 	// Load the shader to a blob and ensure it worked
-	HRESULT hr = D3DReadFileToBlob(shaderFile, shaderBlob.GetAddressOf());
+	HRESULT hr = FileReader ?
+		FileReader(shaderFile, shaderBlob.GetAddressOf()) :
+		D3DReadFileToBlob(shaderFile, shaderBlob.GetAddressOf());
 	if (hr != S_OK)
 	{
 		if (ReportErrors)
@@ -94,6 +111,16 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
+	// Grab the layout of the shader from the sidecar cache if it
+	// matches this exact shader, otherwise reflect and re-cache it
+	reflectionCached = ReflectionCacheEnabled && LoadReflectionCache(shaderFile);
+	if (!reflectionCached)
+	{
+		ReflectShader();
+		if (ReflectionCacheEnabled)
+			SaveReflectionCache(shaderFile);
+	}
+
 	// Create the shader - Calls an overloaded version of this abstract
 	// method in the appropriate child class
 	shaderValid = CreateShader(shaderBlob);
@@ -109,6 +136,23 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
+	// Build the resource tables from the reflected data
+	BuildTables();
+
+	// All set
+	return true;
+}
+
+// --------------------------------------------------------
+// Uses shader reflection to gather information about
+// the loaded shader's variables, buffers, resources and
+// inputs into the reflection data
+// --------------------------------------------------------
+void ISimpleShader::ReflectShader()
+{
+	reflection = ShaderReflectionData();
+	reflection.Hash = HashShaderBytes(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize());
+
 	// Set up shader reflection to get information about
 	// this shader and its variables,  buffers, etc.
 	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
@@ -122,10 +166,6 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	D3D11_SHADER_DESC shaderDesc;
 	refl->GetDesc(&shaderDesc);
 
-	// Create resource arrays
-	constantBufferCount = shaderDesc.ConstantBuffers;
-	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
-	
 	// Handle bound resources (like shaders and samplers)
 	unsigned int resourceCount = shaderDesc.BoundResources;
 	for (unsigned int r = 0; r < resourceCount; r++)
@@ -134,38 +174,26 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
 		refl->GetResourceBindingDesc(r, &resourceDesc);
 
+		ReflectedResource resource;
+		resource.Name = resourceDesc.Name;
+		resource.BindIndex = resourceDesc.BindPoint;
+
 		// Check the type
 		switch (resourceDesc.Type)
 		{
 		case D3D_SIT_STRUCTURED: // Treat structured buffers as texture resources
 		case D3D_SIT_TEXTURE: // A texture resource
-		{
-			// Create the SRV wrapper
-			SimpleSRV* srv = new SimpleSRV();
-			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
-			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
-
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
-			shaderResourceViews.push_back(srv);
-		}
+			reflection.ShaderResourceViews.push_back(resource);
 			break;
 
 		case D3D_SIT_SAMPLER: // A sampler resource
-		{
-			// Create the sampler wrapper
-			SimpleSampler* samp = new SimpleSampler();
-			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
-			samp->Index = (unsigned int)samplerStates.size();	// Raw index
-
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
-			samplerStates.push_back(samp);
-		}
+			reflection.Samplers.push_back(resource);
 			break;
 		}
 	}
 
 	// Loop through all constant buffers
-	for (unsigned int b = 0; b < constantBufferCount; b++)
+	for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
 	{
 		// Get this buffer
 		ID3D11ShaderReflectionConstantBuffer* cb =
@@ -175,16 +203,129 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		D3D11_SHADER_BUFFER_DESC bufferDesc;
 		cb->GetDesc(&bufferDesc);
 
-		// Save the type, which we reference when setting these buffers
-		constantBuffers[b].Type = bufferDesc.Type;
-		
 		// Get the description of the resource binding, so
 		// we know exactly how it's bound in the shader
 		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
 		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+
+		ReflectedConstantBuffer buffer;
+		buffer.Name = bufferDesc.Name;
+		buffer.Type = bufferDesc.Type;
+		buffer.BindIndex = bindDesc.BindPoint;
+		buffer.Size = bufferDesc.Size;
+
+		// Loop through all variables in this buffer
+		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		{
+			// Get the description of this variable
+			D3D11_SHADER_VARIABLE_DESC varDesc;
+			cb->GetVariableByIndex(v)->GetDesc(&varDesc);
+
+			ReflectedVariable var;
+			var.Name = varDesc.Name;
+			var.ByteOffset = varDesc.StartOffset;
+			var.Size = varDesc.Size;
+			buffer.Variables.push_back(var);
+		}
+
+		reflection.ConstantBuffers.push_back(buffer);
+	}
+
+	// Loop through the input signature, which vertex shaders
+	// use to build an input layout.  Code adapted from:
+	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
+	for (unsigned int i = 0; i < shaderDesc.InputParameters; i++)
+	{
+		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+		refl->GetInputParameterDesc(i, &paramDesc);
+
+		ReflectedInputElement element;
+		element.SemanticName = paramDesc.SemanticName;
+		element.SemanticIndex = paramDesc.SemanticIndex;
+
+		// Check the semantic name for "_PER_INSTANCE"
+		std::string perInstanceStr = "_PER_INSTANCE";
+		std::string sem = paramDesc.SemanticName;
+		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
+		element.PerInstance = 
+			lenDiff >= 0 &&
+			sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
+
+		// Determine DXGI format
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+		if (paramDesc.Mask == 1)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 3)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32G32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32G32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32G32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 7)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32G32B32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32G32B32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32G32B32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 15)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32G32B32A32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32G32B32A32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		}
+		element.Format = format;
+
+		reflection.InputElements.push_back(element);
+	}
+}
+
+// --------------------------------------------------------
+// Creates the constant buffers and fills in the variable,
+// buffer and resource tables from the reflection data
+// --------------------------------------------------------
+void ISimpleShader::BuildTables()
+{
+	// Create resource arrays
+	constantBufferCount = (unsigned int)reflection.ConstantBuffers.size();
+	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
+	
+	// Handle bound resources (like shaders and samplers)
+	for (auto& r : reflection.ShaderResourceViews)
+	{
+		// Create the SRV wrapper
+		SimpleSRV* srv = new SimpleSRV();
+		srv->BindIndex = r.BindIndex;							// Shader bind point
+		srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
+
+		textureTable.insert(std::pair<std::string, SimpleSRV*>(r.Name, srv));
+		shaderResourceViews.push_back(srv);
+	}
+
+	for (auto& r : reflection.Samplers)
+	{
+		// Create the sampler wrapper
+		SimpleSampler* samp = new SimpleSampler();
+		samp->BindIndex = r.BindIndex;						// Shader bind point
+		samp->Index = (unsigned int)samplerStates.size();	// Raw index
+
+		samplerTable.insert(std::pair<std::string, SimpleSampler*>(r.Name, samp));
+		samplerStates.push_back(samp);
+	}
+
+	// Loop through all constant buffers
+	for (unsigned int b = 0; b < constantBufferCount; b++)
+	{
+		const ReflectedConstantBuffer& bufferDesc = reflection.ConstantBuffers[b];
+
+		// Save the type, which we reference when setting these buffers
+		constantBuffers[b].Type = (D3D_CBUFFER_TYPE)bufferDesc.Type;
 		
 		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
+		constantBuffers[b].BindIndex = bufferDesc.BindIndex;
 		constantBuffers[b].Name = bufferDesc.Name;
 		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
 
@@ -204,35 +345,111 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
 
 		// Loop through all variables in this buffer
-		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		for (auto& v : bufferDesc.Variables)
 		{
-			// Get this variable
-			ID3D11ShaderReflectionVariable* var =
-				cb->GetVariableByIndex(v);
-			
-			// Get the description of the variable and its type
-			D3D11_SHADER_VARIABLE_DESC varDesc;
-			var->GetDesc(&varDesc);
-
 			// Create the variable struct
 			SimpleShaderVariable varStruct = {};
 			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
-			varStruct.Size = varDesc.Size;
-			
-			// Get a string version
-			std::string varName(varDesc.Name);
+			varStruct.ByteOffset = v.ByteOffset;
+			varStruct.Size = v.Size;
 
 			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
+			varTable.insert(std::pair<std::string, SimpleShaderVariable>(v.Name, varStruct));
 			constantBuffers[b].Variables.push_back(varStruct);
 		}
 	}
+}
 
-	// All set
+// --------------------------------------------------------
+// Attempts to load the reflection data from the sidecar
+// cache file next to the compiled shader
+//
+// shaderFile - The compiled shader that was just loaded
+//
+// Returns true only if the cache exists, is valid and was
+// created from exactly the same compiled shader
+// --------------------------------------------------------
+bool ISimpleShader::LoadReflectionCache(LPCWSTR shaderFile)
+{
+	// Read the entire file, if it exists
+	std::wstring cachePath = std::wstring(shaderFile) + L".refl";
+	std::ifstream file(cachePath, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (bytes.empty())
+		return false;
+
+	// Parse, then verify it belongs to this exact shader
+	ShaderReflectionData data;
+	unsigned long long hash = HashShaderBytes(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize());
+	if (!ReadShaderReflectionCache(&bytes[0], bytes.size(), hash, &data))
+		return false;
+
+	reflection = data;
 	return true;
 }
 
+// --------------------------------------------------------
+// Writes the current reflection data to the sidecar cache
+// file next to the compiled shader.  Failing to write
+// (such as a read-only folder) isn't an error, as the
+// shader will simply be reflected again next time.
+//
+// shaderFile - The compiled shader that was just loaded
+// --------------------------------------------------------
+void ISimpleShader::SaveReflectionCache(LPCWSTR shaderFile)
+{
+	std::vector<unsigned char> bytes;
+	SerializeShaderReflection(reflection, bytes);
+
+	std::wstring cachePath = std::wstring(shaderFile) + L".refl";
+	std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		if (ReportWarnings)
+		{
+			LogWarning("SimpleShader::SaveReflectionCache() - Unable to write reflection cache '");
+			LogW(cachePath);
+			LogWarning("'. The shader will be reflected again next time it is loaded.\n");
+		}
+		return;
+	}
+
+	file.write((const char*)&bytes[0], bytes.size());
+}
+
+// --------------------------------------------------------
+// Sends this shader's binds (for vertex and pixel shaders)
+// to another device, like a recording one, instead of the
+// shader's own context.  Pass null to go back to the context.
+//
+// NOTE: A binding filter shared with the shader tracks what
+//       the device has bound, so it should be invalidated
+//       when switching devices.
+// --------------------------------------------------------
+void ISimpleShader::SetRenderDevice(std::shared_ptr<IRenderDevice> device)
+{
+	if (!device)
+		device = std::make_shared<D3D11RenderDevice>(this->device, deviceContext);
+	renderDevice = device;
+}
+
+// --------------------------------------------------------
+// Checks with the binding filter (if any) whether an object
+// actually needs to be bound to this shader's stage
+//
+// Returns true if the bind should be issued
+// --------------------------------------------------------
+bool ISimpleShader::ShouldBind(unsigned int type, unsigned int slot, const void* object, unsigned int firstConstant, unsigned int numConstants)
+{
+	if (!bindingFilter)
+		return true;
+
+	return bindingFilter->ShouldBind(GetBindingStage(), type, slot, object, firstConstant, numConstants);
+}
+
 // --------------------------------------------------------
 // Helper for looking up a variable by name and also
 // verifying that it is the requested size
@@ -261,6 +478,25 @@ SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 	return var;
 }
 
+// --------------------------------------------------------
+// Helper for gathering the named variables of a single
+// constant buffer (relative to that buffer)
+// --------------------------------------------------------
+std::unordered_map<std::string, SimpleShaderVariable> ISimpleShader::GetBufferVariables(unsigned int index)
+{
+	std::unordered_map<std::string, SimpleShaderVariable> vars;
+	for (auto& v : varTable)
+	{
+		if (v.second.ConstantBufferIndex != index)
+			continue;
+
+		SimpleShaderVariable var = v.second;
+		var.ConstantBufferIndex = 0;
+		vars.insert({ v.first, var });
+	}
+	return vars;
+}
+
 // --------------------------------------------------------
 // Helper for looking up a constant buffer by name
 // --------------------------------------------------------
@@ -348,6 +584,20 @@ void ISimpleShader::CopyAllBufferData()
 	// Loop through the constant buffers and copy all data
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
+		// Shared buffers only upload when their data changes
+		if (constantBuffers[i].SharedBuffer)
+		{
+			constantBuffers[i].SharedBuffer->CopyBufferData();
+			continue;
+		}
+
+		// Using the ring instead?
+		if (cbRing && constantBuffers[i].Type == D3D11_CT_CBUFFER)
+		{
+			CopyBufferToRing(&constantBuffers[i]);
+			continue;
+		}
+
 		// Copy the entire local data buffer
 		deviceContext->UpdateSubresource(
 			constantBuffers[i].ConstantBuffer.Get(), 0, 0,
@@ -379,34 +629,379 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	SimpleConstantBuffer* cb = &this->constantBuffers[index];
 	if (!cb) return;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Shared buffers only upload when their data changes
+	if (cb->SharedBuffer)
+	{
+		cb->SharedBuffer->CopyBufferData();
+		return;
+	}
+
+	// Using the ring instead?
+	if (cbRing && cb->Type == D3D11_CT_CBUFFER)
+	{
+		CopyBufferToRing(cb);
+		return;
+	}
+
+	// Copy the data and get out
+	deviceContext->UpdateSubresource(
+		cb->ConstantBuffer.Get(), 0, 0, 
+		cb->LocalDataBuffer, 0, 0);
+}
+
+// --------------------------------------------------------
+// Copies local data to the shader's specified constant buffer
+//
+// bufferName - Specifies the name of the buffer to copy.
+//              Useful for updating more frequently-changing
+//              variables without having to re-copy all buffers.
+// --------------------------------------------------------
+void ISimpleShader::CopyBufferData(std::string bufferName)
+{
+	// Ensure the shader is valid
+	if (!shaderValid) return;
+
+	// Check for the buffer
+	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
+	if (!cb) return;
+
+	// Shared buffers only upload when their data changes
+	if (cb->SharedBuffer)
+	{
+		cb->SharedBuffer->CopyBufferData();
+		return;
+	}
+
+	// Using the ring instead?
+	if (cbRing && cb->Type == D3D11_CT_CBUFFER)
+	{
+		CopyBufferToRing(cb);
+		return;
+	}
+
+	// Copy the data and get out
+	deviceContext->UpdateSubresource(
+		cb->ConstantBuffer.Get(), 0, 0, 
+		cb->LocalDataBuffer, 0, 0);
+}
+
+// --------------------------------------------------------
+// Uploads the local data of every constant buffer, like
+// CopyAllBufferData(), but without binding anything.  The
+// data's whereabouts can then be found with
+// GetConstantBufferBindings() and bound on another context
+// (a deferred one, for instance).
+//
+// NOTE: Without a ring, every upload lands in the shader's
+//       one buffer per cbuffer, so only the most recent data
+//       survives until the bindings are actually used.
+//
+// Returns false if the ring couldn't take the data
+// --------------------------------------------------------
+bool ISimpleShader::UploadAllBufferData()
+{
+	// Ensure the shader is valid
+	if (!shaderValid) return false;
+
+	bool uploaded = true;
+	for (unsigned int i = 0; i < constantBufferCount; i++)
+	{
+		SimpleConstantBuffer* cb = &constantBuffers[i];
+		if (cb->SharedBuffer)
+		{
+			cb->SharedBuffer->CopyBufferData();
+		}
+		else if (cbRing && cb->Type == D3D11_CT_CBUFFER)
+		{
+			if (!cbRing->Upload(cb->LocalDataBuffer, cb->Size, &cb->RingRange))
+				uploaded = false;
+		}
+		else
+		{
+			deviceContext->UpdateSubresource(cb->ConstantBuffer.Get(), 0, 0, cb->LocalDataBuffer, 0, 0);
+		}
+	}
+	return uploaded;
+}
+
+// --------------------------------------------------------
+// Gets the buffer (and range of it, if using the ring) that
+// each constant buffer's most recent data is in
+//
+// bindings    - Array to fill, one per constant buffer
+// maxBindings - Size of the array
+//
+// Returns the number of bindings filled in
+// --------------------------------------------------------
+unsigned int ISimpleShader::GetConstantBufferBindings(SimpleConstantBufferBinding* bindings, unsigned int maxBindings)
+{
+	if (!shaderValid) return 0;
+
+	unsigned int count = (std::min)(constantBufferCount, maxBindings);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		SimpleConstantBuffer* cb = &constantBuffers[i];
+		SimpleConstantBufferBinding& binding = bindings[i];
+		binding.BindIndex = cb->BindIndex;
+		binding.FirstConstant = 0;
+		binding.NumConstants = 0;
+
+		if (cb->SharedBuffer)
+		{
+			binding.Buffer = cb->SharedBuffer->GetBuffer();
+		}
+		else if (cbRing && cb->Type == D3D11_CT_CBUFFER)
+		{
+			// Offsets and sizes are in 16-byte constants
+			binding.Buffer = cbRing->GetBuffer();
+			binding.FirstConstant = cb->RingRange.Offset / 16;
+			binding.NumConstants = cb->RingRange.Size / 16;
+		}
+		else
+		{
+			binding.Buffer = cb->ConstantBuffer.Get();
+		}
+	}
+	return count;
+}
+
+
+// --------------------------------------------------------
+// Switches this shader to suballocating its constant data
+// from the given ring.  Uploads then bind a range of the
+// ring immediately, rather than updating the shader's own
+// buffers.  Pass null to return to the per-shader buffers.
+//
+// NOTE: Since copying now binds, copy a shader's data while
+//       that shader is the one set (as is typical), otherwise
+//       the ring range replaces the active shader's binding.
+//
+// Returns false if the ring isn't supported by the device,
+// in which case the per-shader buffers remain in use
+// --------------------------------------------------------
+bool ISimpleShader::SetConstantBufferRing(std::shared_ptr<ConstantBufferRing> ring)
+{
+	// Turning it off?
+	if (!ring)
+	{
+		cbRing = 0;
+		deviceContext1 = 0;
+		return true;
+	}
+
+	// Can we actually use it?
+	if (!ring->IsSupported())
+	{
+		if (ReportWarnings)
+			LogWarning("SimpleShader::SetConstantBufferRing() - Ring is not supported by this device (requires D3D 11.1 constant buffer offsetting). Using per-shader constant buffers instead.\n");
+		return false;
+	}
+
+	// Save the ring and forget any old ranges
+	cbRing = ring;
+	deviceContext1 = ring->GetContext1();
+	for (unsigned int i = 0; i < constantBufferCount; i++)
+		constantBuffers[i].RingRange = {};
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Gets the number of bytes of the ring that copying all of
+// this shader's data would use, for reserving room for a
+// whole draw's constants before any of them are uploaded
+// --------------------------------------------------------
+unsigned int ISimpleShader::GetRingUploadSize()
+{
+	if (!shaderValid || !cbRing)
+		return 0;
+
+	unsigned int size = 0;
+	for (unsigned int i = 0; i < constantBufferCount; i++)
+	{
+		SimpleConstantBuffer* cb = &constantBuffers[i];
+		if (!cb->SharedBuffer && cb->Type == D3D11_CT_CBUFFER)
+			size += (cb->Size + CONSTANT_BUFFER_RING_ALIGNMENT - 1) & ~(CONSTANT_BUFFER_RING_ALIGNMENT - 1);
+	}
+	return size;
+}
+
+// --------------------------------------------------------
+// Reserves room for copying all data of two shaders drawn
+// together, so the ring can't wrap (discarding the first
+// shader's bound range) while the second one uploads
+// --------------------------------------------------------
+void ISimpleShader::ReserveRingSpace(ISimpleShader* first, ISimpleShader* second)
+{
+	if (first->cbRing && first->cbRing == second->cbRing)
+	{
+		first->cbRing->Reserve(first->GetRingUploadSize() + second->GetRingUploadSize());
+		return;
+	}
+
+	// Separate rings can't discard each other's ranges
+	if (first->cbRing) first->cbRing->Reserve(first->GetRingUploadSize());
+	if (second->cbRing) second->cbRing->Reserve(second->GetRingUploadSize());
+}
+
+// --------------------------------------------------------
+// Copies a constant buffer's local data into a new range of
+// the ring and binds that range to its register
+// --------------------------------------------------------
+void ISimpleShader::CopyBufferToRing(SimpleConstantBuffer* cb)
+{
+	if (!cbRing->Upload(cb->LocalDataBuffer, cb->Size, &cb->RingRange))
+		return;
+
+	// Offsets and sizes are in 16-byte constants
+	SetConstantBufferRange(
+		cb->BindIndex,
+		cbRing->GetBuffer(),
+		cb->RingRange.Offset / 16,
+		cb->RingRange.Size / 16);
+}
+
+// --------------------------------------------------------
+// Binds the most recent ring range of a constant buffer,
+// uploading the data again if the ring has wrapped since
+// --------------------------------------------------------
+void ISimpleShader::SetRingConstantBuffer(SimpleConstantBuffer* cb)
+{
+	if (!cbRing->IsAllocationValid(cb->RingRange))
+	{
+		CopyBufferToRing(cb);
+		return;
+	}
+
+	SetConstantBufferRange(
+		cb->BindIndex,
+		cbRing->GetBuffer(),
+		cb->RingRange.Offset / 16,
+		cb->RingRange.Size / 16);
+}
+
+// --------------------------------------------------------
+// Creates a shared constant buffer using this shader's
+// layout of the given buffer.  The result can then be
+// attached to this shader and any others that declare the
+// same buffer with SetSharedConstantBuffer().
+//
+// bufferName - The name of the cbuffer in the shader
+//
+// Returns the new shared buffer, or null if not found
+// --------------------------------------------------------
+std::shared_ptr<SimpleSharedConstantBuffer> ISimpleShader::CreateSharedConstantBuffer(std::string bufferName)
+{
+	// Find the buffer and verify
+	SimpleConstantBuffer* cb = FindConstantBuffer(bufferName);
+	if (cb == 0 || cb->Type != D3D11_CT_CBUFFER)
+	{
+		if (ReportWarnings)
+		{
+			LogWarning("SimpleShader::CreateSharedConstantBuffer() - Constant buffer '");
+			Log(bufferName);
+			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
+		}
+		return 0;
+	}
+
+	// Copy the reflected layout into the shared buffer
+	unsigned int index = (unsigned int)(cb - constantBuffers);
+	return std::make_shared<SimpleSharedConstantBuffer>(
+		device,
+		deviceContext,
+		cb->Name,
+		cb->Size,
+		GetBufferVariables(index));
+}
+
+// --------------------------------------------------------
+// Replaces this shader's copy of a constant buffer with a
+// shared one.  The shared buffer is matched by name, and
+// is bound to whichever register this shader declares it.
+// Setting variables from that buffer on this shader will
+// write to the shared buffer instead.
+//
+// sharedBuffer - The shared buffer to use
+//
+// Returns false if the shader doesn't declare a buffer of
+// the same name or if the layouts don't match exactly
+// --------------------------------------------------------
+bool ISimpleShader::SetSharedConstantBuffer(std::shared_ptr<SimpleSharedConstantBuffer> sharedBuffer)
+{
+	// A shader that fails to share would draw with its own,
+	// never filled, copy of the data, so these are errors
+	if (!sharedBuffer)
+	{
+		if (ReportErrors)
+			LogError("SimpleShader::SetSharedConstantBuffer() - The shared buffer is null. Ensure it was created from a shader that has a constant buffer of that name.\n");
+		return false;
+	}
+
+	// Find the matching buffer
+	SimpleConstantBuffer* cb = FindConstantBuffer(sharedBuffer->GetName());
+	if (cb == 0)
+	{
+		if (ReportErrors)
+		{
+			LogError("SimpleShader::SetSharedConstantBuffer() - Constant buffer '");
+			Log(sharedBuffer->GetName());
+			LogError("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
+		}
+		return false;
+	}
+
+	// Only share when the data would line up exactly
+	if (!IsLayoutCompatible(sharedBuffer->GetName(), sharedBuffer))
+	{
+		if (ReportErrors)
+		{
+			LogError("SimpleShader::SetSharedConstantBuffer() - Layout of constant buffer '");
+			Log(sharedBuffer->GetName());
+			LogError("' does not match the shared buffer. Ensure both declarations have the same variables, in the same order.\n");
+		}
+		return false;
+	}
+
+	cb->SharedBuffer = sharedBuffer;
+	return true;
 }
 
 // --------------------------------------------------------
-// Copies local data to the shader's specified constant buffer
+// Determines if one of this shader's constant buffers has
+// exactly the same layout (size, variable names, offsets
+// and sizes) as a shared buffer
 //
-// bufferName - Specifies the name of the buffer to copy.
-//              Useful for updating more frequently-changing
-//              variables without having to re-copy all buffers.
+// bufferName   - The name of the cbuffer in this shader
+// sharedBuffer - The shared buffer to compare against
 // --------------------------------------------------------
-void ISimpleShader::CopyBufferData(std::string bufferName)
+bool ISimpleShader::IsLayoutCompatible(std::string bufferName, std::shared_ptr<SimpleSharedConstantBuffer> sharedBuffer)
 {
-	// Ensure the shader is valid
-	if (!shaderValid) return;
+	SimpleConstantBuffer* cb = FindConstantBuffer(bufferName);
+	if (cb == 0 || !sharedBuffer || cb->Type != D3D11_CT_CBUFFER)
+		return false;
 
-	// Check for the buffer
-	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
-	if (!cb) return;
+	// Overall size must match
+	if (cb->Size != sharedBuffer->GetSize())
+		return false;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
-}
+	// As must every single variable
+	std::unordered_map<std::string, SimpleShaderVariable> vars = GetBufferVariables((unsigned int)(cb - constantBuffers));
+	const std::unordered_map<std::string, SimpleShaderVariable>& sharedVars = sharedBuffer->GetVariables();
+	if (vars.size() != sharedVars.size())
+		return false;
+
+	for (auto& v : vars)
+	{
+		auto it = sharedVars.find(v.first);
+		if (it == sharedVars.end() ||
+			it->second.ByteOffset != v.second.ByteOffset ||
+			it->second.Size != v.second.Size)
+			return false;
+	}
 
+	return true;
+}
 
 // --------------------------------------------------------
 // Sets a variable by name with arbitrary data of the specified size
@@ -445,6 +1040,11 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		return false;
 	}
 
+	// Is this variable actually part of a shared buffer?
+	SimpleConstantBuffer* cb = &constantBuffers[var->ConstantBufferIndex];
+	if (cb->SharedBuffer)
+		return cb->SharedBuffer->SetData(name, data, size);
+
 	// Set the data in the local data buffer
 	memcpy(
 		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
@@ -684,6 +1284,88 @@ const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(unsigned int index)
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// ------ SHARED CONSTANT BUFFER ----------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+// --------------------------------------------------------
+// Creates the buffer and its local data.  Typically called
+// through ISimpleShader::CreateSharedConstantBuffer(), which
+// supplies the reflected layout.
+//
+// name      - Name of the cbuffer as declared in shaders
+// size      - Size of the cbuffer in bytes
+// variables - Variables in the buffer, relative to the buffer
+// --------------------------------------------------------
+SimpleSharedConstantBuffer::SimpleSharedConstantBuffer(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	std::string name,
+	unsigned int size,
+	const std::unordered_map<std::string, SimpleShaderVariable>& variables)
+	:
+	name(name),
+	size(size),
+	dirty(true),
+	localData(size, 0),
+	variables(variables),
+	deviceContext(context)
+{
+	// Create the actual constant buffer
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.ByteWidth = ((size + 15) / 16) * 16; // Same 16-byte alignment as shader-owned buffers
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	device->CreateBuffer(&desc, 0, constantBuffer.GetAddressOf());
+}
+
+// --------------------------------------------------------
+// Sets a variable by name with arbitrary data.  The buffer
+// is only marked as changed if the data actually differs,
+// so shaders can redundantly set the same value cheaply.
+//
+// Returns true if the variable exists and is large enough
+// --------------------------------------------------------
+bool SimpleSharedConstantBuffer::SetData(std::string name, const void* data, unsigned int size)
+{
+	// Look for the variable and verify
+	auto it = variables.find(name);
+	if (it == variables.end() || size > it->second.Size)
+		return false;
+
+	// Only copy if something is different
+	unsigned char* dest = &localData[it->second.ByteOffset];
+	if (memcmp(dest, data, size) != 0)
+	{
+		memcpy(dest, data, size);
+		dirty = true;
+	}
+
+	return true;
+}
+
+bool SimpleSharedConstantBuffer::SetInt(std::string name, int data) { return SetData(name, &data, sizeof(int)); }
+bool SimpleSharedConstantBuffer::SetFloat(std::string name, float data) { return SetData(name, &data, sizeof(float)); }
+bool SimpleSharedConstantBuffer::SetFloat2(std::string name, const DirectX::XMFLOAT2 data) { return SetData(name, &data, sizeof(float) * 2); }
+bool SimpleSharedConstantBuffer::SetFloat3(std::string name, const DirectX::XMFLOAT3 data) { return SetData(name, &data, sizeof(float) * 3); }
+bool SimpleSharedConstantBuffer::SetFloat4(std::string name, const DirectX::XMFLOAT4 data) { return SetData(name, &data, sizeof(float) * 4); }
+bool SimpleSharedConstantBuffer::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data) { return SetData(name, &data, sizeof(float) * 16); }
+
+// --------------------------------------------------------
+// Copies the local data to the GPU if it has changed
+// since the last copy
+// --------------------------------------------------------
+void SimpleSharedConstantBuffer::CopyBufferData()
+{
+	if (!dirty)
+		return;
+
+	deviceContext->UpdateSubresource(constantBuffer.Get(), 0, 0, &localData[0], 0, 0);
+	dirty = false;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // ------ SIMPLE VERTEX SHADER ------------------------------------------------
 ///////////////////////////////////////////////////////////////////////////////
@@ -767,48 +1449,23 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 		return true;
 
 	// Vertex shader was created successfully, so we now use the
-	// shader code to re-reflect and create an input layout that 
-	// matches what the vertex shader expects.  Code adapted from:
-	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
-
-	// Reflect shader info
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-	
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
-	// Read input layout description from shader info
+	// reflected input signature to create an input layout that 
+	// matches what the vertex shader expects
 	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
-	for (unsigned int i = 0; i< shaderDesc.InputParameters; i++)
+	for (auto& e : reflection.InputElements)
 	{
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetInputParameterDesc(i, &paramDesc);
-
-		// Check the semantic name for "_PER_INSTANCE"
-		std::string perInstanceStr = "_PER_INSTANCE";
-		std::string sem = paramDesc.SemanticName;
-		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
-		bool isPerInstance = 
-			lenDiff >= 0 &&
-			sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
-
 		// Fill out input element desc
 		D3D11_INPUT_ELEMENT_DESC elementDesc = {};
-		elementDesc.SemanticName = paramDesc.SemanticName;
-		elementDesc.SemanticIndex = paramDesc.SemanticIndex;
+		elementDesc.SemanticName = e.SemanticName.c_str();
+		elementDesc.SemanticIndex = e.SemanticIndex;
+		elementDesc.Format = (DXGI_FORMAT)e.Format;
 		elementDesc.InputSlot = 0;
 		elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
 		elementDesc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 		elementDesc.InstanceDataStepRate = 0;
 
 		// Replace anything affected by "per instance" data
-		if (isPerInstance)
+		if (e.PerInstance)
 		{
 			elementDesc.InputSlot = 1; // Assume per instance data comes from another input slot!
 			elementDesc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
@@ -817,32 +1474,6 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 			perInstanceCompatible = true;
 		}
 
-		// Determine DXGI format
-		if (paramDesc.Mask == 1)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 3)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 7)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 15)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-		}
-
 		// Save element desc
 		inputLayoutDesc.push_back(elementDesc);
 	}
@@ -869,8 +1500,10 @@ void SimpleVertexShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout.Get());
-	deviceContext->VSSetShader(shader.Get(), 0, 0);
+	if (ShouldBind(BINDING_TYPE_INPUT_LAYOUT, 0, inputLayout.Get()))
+		renderDevice->SetInputLayout(D3D11RenderDevice::GetHandle(inputLayout.Get()));
+	if (ShouldBind(BINDING_TYPE_SHADER, 0, shader.Get()))
+		renderDevice->SetShader(BINDING_STAGE_VERTEX, D3D11RenderDevice::GetHandle(shader.Get()));
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -879,14 +1512,43 @@ void SimpleVertexShader::SetShaderAndCBs()
 		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
 			continue;
 
-		// This is a real constant buffer, so set it
-		deviceContext->VSSetConstantBuffers(
+		// Shared buffers are owned (and uploaded) elsewhere
+		if (constantBuffers[i].SharedBuffer)
+		{
+			ID3D11Buffer* sharedBuffer = constantBuffers[i].SharedBuffer->GetBuffer();
+			if (ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, constantBuffers[i].BindIndex, sharedBuffer))
+				renderDevice->SetConstantBuffer(BINDING_STAGE_VERTEX, constantBuffers[i].BindIndex, D3D11RenderDevice::GetHandle(sharedBuffer));
+			continue;
+		}
+
+		// Ring-based data is bound as a range of the ring
+		if (cbRing)
+		{
+			SetRingConstantBuffer(&constantBuffers[i]);
+			continue;
+		}
+
+		// This is a real constant buffer, so set it (if necessary)
+		if (!ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get()))
+			continue;
+
+		renderDevice->SetConstantBuffer(
+			BINDING_STAGE_VERTEX,
 			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			D3D11RenderDevice::GetHandle(constantBuffers[i].ConstantBuffer.Get()));
 	}
 }
 
+// --------------------------------------------------------
+// Binds a range of a larger constant buffer (in 16-byte
+// constants) to the vertex shader stage
+// --------------------------------------------------------
+void SimpleVertexShader::SetConstantBufferRange(unsigned int bindIndex, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int numConstants)
+{
+	if (ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, bindIndex, buffer, firstConstant, numConstants))
+		renderDevice->SetConstantBuffer(BINDING_STAGE_VERTEX, bindIndex, D3D11RenderDevice::GetHandle(buffer), firstConstant, numConstants);
+}
+
 // --------------------------------------------------------
 // Sets a shader resource view in the vertex shader stage
 //
@@ -911,7 +1573,8 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 	}
 
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (ShouldBind(BINDING_TYPE_SHADER_RESOURCE, srvInfo->BindIndex, srv.Get()))
+		renderDevice->SetTexture(BINDING_STAGE_VERTEX, srvInfo->BindIndex, D3D11RenderDevice::GetHandle(srv.Get()));
 
 	// Success
 	return true;
@@ -941,7 +1604,8 @@ bool SimpleVertexShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 	}
 
 	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (ShouldBind(BINDING_TYPE_SAMPLER, sampInfo->BindIndex, samplerState.Get()))
+		renderDevice->SetSampler(BINDING_STAGE_VERTEX, sampInfo->BindIndex, D3D11RenderDevice::GetHandle(samplerState.Get()));
 
 	// Success
 	return true;
@@ -1012,7 +1676,8 @@ void SimplePixelShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 	
 	// Set the shader
-	deviceContext->PSSetShader(shader.Get(), 0, 0);
+	if (ShouldBind(BINDING_TYPE_SHADER, 0, shader.Get()))
+		renderDevice->SetShader(BINDING_STAGE_PIXEL, D3D11RenderDevice::GetHandle(shader.Get()));
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1021,14 +1686,43 @@ void SimplePixelShader::SetShaderAndCBs()
 		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
 			continue;
 
-		// This is a real constant buffer, so set it
-		deviceContext->PSSetConstantBuffers(
+		// Shared buffers are owned (and uploaded) elsewhere
+		if (constantBuffers[i].SharedBuffer)
+		{
+			ID3D11Buffer* sharedBuffer = constantBuffers[i].SharedBuffer->GetBuffer();
+			if (ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, constantBuffers[i].BindIndex, sharedBuffer))
+				renderDevice->SetConstantBuffer(BINDING_STAGE_PIXEL, constantBuffers[i].BindIndex, D3D11RenderDevice::GetHandle(sharedBuffer));
+			continue;
+		}
+
+		// Ring-based data is bound as a range of the ring
+		if (cbRing)
+		{
+			SetRingConstantBuffer(&constantBuffers[i]);
+			continue;
+		}
+
+		// This is a real constant buffer, so set it (if necessary)
+		if (!ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get()))
+			continue;
+
+		renderDevice->SetConstantBuffer(
+			BINDING_STAGE_PIXEL,
 			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			D3D11RenderDevice::GetHandle(constantBuffers[i].ConstantBuffer.Get()));
 	}
 }
 
+// --------------------------------------------------------
+// Binds a range of a larger constant buffer (in 16-byte
+// constants) to the pixel shader stage
+// --------------------------------------------------------
+void SimplePixelShader::SetConstantBufferRange(unsigned int bindIndex, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int numConstants)
+{
+	if (ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, bindIndex, buffer, firstConstant, numConstants))
+		renderDevice->SetConstantBuffer(BINDING_STAGE_PIXEL, bindIndex, D3D11RenderDevice::GetHandle(buffer), firstConstant, numConstants);
+}
+
 // --------------------------------------------------------
 // Sets a shader resource view in the pixel shader stage
 //
@@ -1053,7 +1747,8 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, Microsoft::WRL::
 	}
 
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (ShouldBind(BINDING_TYPE_SHADER_RESOURCE, srvInfo->BindIndex, srv.Get()))
+		renderDevice->SetTexture(BINDING_STAGE_PIXEL, srvInfo->BindIndex, D3D11RenderDevice::GetHandle(srv.Get()));
 
 	// Success
 	return true;
@@ -1083,7 +1778,8 @@ bool SimplePixelShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr
 	}
 
 	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (ShouldBind(BINDING_TYPE_SAMPLER, sampInfo->BindIndex, samplerState.Get()))
+		renderDevice->SetSampler(BINDING_STAGE_PIXEL, sampInfo->BindIndex, D3D11RenderDevice::GetHandle(samplerState.Get()));
 
 	// Success
 	return true;
@@ -1156,7 +1852,8 @@ void SimpleDomainShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->DSSetShader(shader.Get(), 0, 0);
+	if (ShouldBind(BINDING_TYPE_SHADER, 0, shader.Get()))
+		deviceContext->DSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1165,7 +1862,26 @@ void SimpleDomainShader::SetShaderAndCBs()
 		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
 			continue;
 
-		// This is a real constant buffer, so set it
+		// Shared buffers are owned (and uploaded) elsewhere
+		if (constantBuffers[i].SharedBuffer)
+		{
+			ID3D11Buffer* sharedBuffer = constantBuffers[i].SharedBuffer->GetBuffer();
+			if (ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, constantBuffers[i].BindIndex, sharedBuffer))
+				deviceContext->DSSetConstantBuffers(constantBuffers[i].BindIndex, 1, &sharedBuffer);
+			continue;
+		}
+
+		// Ring-based data is bound as a range of the ring
+		if (cbRing)
+		{
+			SetRingConstantBuffer(&constantBuffers[i]);
+			continue;
+		}
+
+		// This is a real constant buffer, so set it (if necessary)
+		if (!ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get()))
+			continue;
+
 		deviceContext->DSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
@@ -1173,6 +1889,16 @@ void SimpleDomainShader::SetShaderAndCBs()
 	}
 }
 
+// --------------------------------------------------------
+// Binds a range of a larger constant buffer (in 16-byte
+// constants) to the domain shader stage
+// --------------------------------------------------------
+void SimpleDomainShader::SetConstantBufferRange(unsigned int bindIndex, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int numConstants)
+{
+	if (ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, bindIndex, buffer, firstConstant, numConstants))
+		deviceContext1->DSSetConstantBuffers1(bindIndex, 1, &buffer, &firstConstant, &numConstants);
+}
+
 // --------------------------------------------------------
 // Sets a shader resource view in the domain shader stage
 //
@@ -1197,7 +1923,8 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 	}
 
 	// Set the shader resource view
-	deviceContext->DSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (ShouldBind(BINDING_TYPE_SHADER_RESOURCE, srvInfo->BindIndex, srv.Get()))
+		deviceContext->DSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1227,7 +1954,8 @@ bool SimpleDomainShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 	}
 
 	// Set the shader resource view
-	deviceContext->DSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (ShouldBind(BINDING_TYPE_SAMPLER, sampInfo->BindIndex, samplerState.Get()))
+		deviceContext->DSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
@@ -1299,7 +2027,8 @@ void SimpleHullShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->HSSetShader(shader.Get(), 0, 0);
+	if (ShouldBind(BINDING_TYPE_SHADER, 0, shader.Get()))
+		deviceContext->HSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1308,7 +2037,26 @@ void SimpleHullShader::SetShaderAndCBs()
 		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
 			continue;
 
-		// This is a real constant buffer, so set it
+		// Shared buffers are owned (and uploaded) elsewhere
+		if (constantBuffers[i].SharedBuffer)
+		{
+			ID3D11Buffer* sharedBuffer = constantBuffers[i].SharedBuffer->GetBuffer();
+			if (ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, constantBuffers[i].BindIndex, sharedBuffer))
+				deviceContext->HSSetConstantBuffers(constantBuffers[i].BindIndex, 1, &sharedBuffer);
+			continue;
+		}
+
+		// Ring-based data is bound as a range of the ring
+		if (cbRing)
+		{
+			SetRingConstantBuffer(&constantBuffers[i]);
+			continue;
+		}
+
+		// This is a real constant buffer, so set it (if necessary)
+		if (!ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get()))
+			continue;
+
 		deviceContext->HSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
@@ -1316,6 +2064,16 @@ void SimpleHullShader::SetShaderAndCBs()
 	}
 }
 
+// --------------------------------------------------------
+// Binds a range of a larger constant buffer (in 16-byte
+// constants) to the hull shader stage
+// --------------------------------------------------------
+void SimpleHullShader::SetConstantBufferRange(unsigned int bindIndex, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int numConstants)
+{
+	if (ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, bindIndex, buffer, firstConstant, numConstants))
+		deviceContext1->HSSetConstantBuffers1(bindIndex, 1, &buffer, &firstConstant, &numConstants);
+}
+
 // --------------------------------------------------------
 // Sets a shader resource view in the hull shader stage
 //
@@ -1340,7 +2098,8 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, Microsoft::WRL::C
 	}
 
 	// Set the shader resource view
-	deviceContext->HSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (ShouldBind(BINDING_TYPE_SHADER_RESOURCE, srvInfo->BindIndex, srv.Get()))
+		deviceContext->HSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1370,7 +2129,8 @@ bool SimpleHullShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<
 	}
 
 	// Set the shader resource view
-	deviceContext->HSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (ShouldBind(BINDING_TYPE_SAMPLER, sampInfo->BindIndex, samplerState.Get()))
+		deviceContext->HSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
@@ -1573,7 +2333,8 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->GSSetShader(shader.Get(), 0, 0);
+	if (ShouldBind(BINDING_TYPE_SHADER, 0, shader.Get()))
+		deviceContext->GSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1582,7 +2343,26 @@ void SimpleGeometryShader::SetShaderAndCBs()
 		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
 			continue;
 
-		// This is a real constant buffer, so set it
+		// Shared buffers are owned (and uploaded) elsewhere
+		if (constantBuffers[i].SharedBuffer)
+		{
+			ID3D11Buffer* sharedBuffer = constantBuffers[i].SharedBuffer->GetBuffer();
+			if (ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, constantBuffers[i].BindIndex, sharedBuffer))
+				deviceContext->GSSetConstantBuffers(constantBuffers[i].BindIndex, 1, &sharedBuffer);
+			continue;
+		}
+
+		// Ring-based data is bound as a range of the ring
+		if (cbRing)
+		{
+			SetRingConstantBuffer(&constantBuffers[i]);
+			continue;
+		}
+
+		// This is a real constant buffer, so set it (if necessary)
+		if (!ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get()))
+			continue;
+
 		deviceContext->GSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
@@ -1590,6 +2370,16 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	}
 }
 
+// --------------------------------------------------------
+// Binds a range of a larger constant buffer (in 16-byte
+// constants) to the geometry shader stage
+// --------------------------------------------------------
+void SimpleGeometryShader::SetConstantBufferRange(unsigned int bindIndex, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int numConstants)
+{
+	if (ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, bindIndex, buffer, firstConstant, numConstants))
+		deviceContext1->GSSetConstantBuffers1(bindIndex, 1, &buffer, &firstConstant, &numConstants);
+}
+
 // --------------------------------------------------------
 // Sets a shader resource view in the Geometry shader stage
 //
@@ -1614,7 +2404,8 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, Microsoft::WR
 	}
 
 	// Set the shader resource view
-	deviceContext->GSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (ShouldBind(BINDING_TYPE_SHADER_RESOURCE, srvInfo->BindIndex, srv.Get()))
+		deviceContext->GSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1644,7 +2435,8 @@ bool SimpleGeometryShader::SetSamplerState(std::string name, Microsoft::WRL::Com
 	}
 
 	// Set the shader resource view
-	deviceContext->GSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (ShouldBind(BINDING_TYPE_SAMPLER, sampInfo->BindIndex, samplerState.Get()))
+		deviceContext->GSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
@@ -1783,7 +2575,8 @@ void SimpleComputeShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->CSSetShader(shader.Get(), 0, 0);
+	if (ShouldBind(BINDING_TYPE_SHADER, 0, shader.Get()))
+		deviceContext->CSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1792,7 +2585,26 @@ void SimpleComputeShader::SetShaderAndCBs()
 		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
 			continue;
 
-		// This is a real constant buffer, so set it
+		// Shared buffers are owned (and uploaded) elsewhere
+		if (constantBuffers[i].SharedBuffer)
+		{
+			ID3D11Buffer* sharedBuffer = constantBuffers[i].SharedBuffer->GetBuffer();
+			if (ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, constantBuffers[i].BindIndex, sharedBuffer))
+				deviceContext->CSSetConstantBuffers(constantBuffers[i].BindIndex, 1, &sharedBuffer);
+			continue;
+		}
+
+		// Ring-based data is bound as a range of the ring
+		if (cbRing)
+		{
+			SetRingConstantBuffer(&constantBuffers[i]);
+			continue;
+		}
+
+		// This is a real constant buffer, so set it (if necessary)
+		if (!ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get()))
+			continue;
+
 		deviceContext->CSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
@@ -1800,6 +2612,16 @@ void SimpleComputeShader::SetShaderAndCBs()
 	}
 }
 
+// --------------------------------------------------------
+// Binds a range of a larger constant buffer (in 16-byte
+// constants) to the compute shader stage
+// --------------------------------------------------------
+void SimpleComputeShader::SetConstantBufferRange(unsigned int bindIndex, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int numConstants)
+{
+	if (ShouldBind(BINDING_TYPE_CONSTANT_BUFFER, bindIndex, buffer, firstConstant, numConstants))
+		deviceContext1->CSSetConstantBuffers1(bindIndex, 1, &buffer, &firstConstant, &numConstants);
+}
+
 // --------------------------------------------------------
 // Dispatches the compute shader with the specified amount 
 // of groups, using the number of threads per group
@@ -1885,7 +2707,8 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, Microsoft::WRL
 	}
 
 	// Set the shader resource view
-	deviceContext->CSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (ShouldBind(BINDING_TYPE_SHADER_RESOURCE, srvInfo->BindIndex, srv.Get()))
+		deviceContext->CSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1915,7 +2738,8 @@ bool SimpleComputeShader::SetSamplerState(std::string name, Microsoft::WRL::ComP
 	}
 
 	// Set the shader resource view
-	deviceContext->CSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (ShouldBind(BINDING_TYPE_SAMPLER, sampInfo->BindIndex, samplerState.Get()))
+		deviceContext->CSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
@@ -1967,4 +2791,282 @@ int SimpleComputeShader::GetUnorderedAccessViewIndex(std::string name)
 
 	// Success
 	return result->second;
-}
\ No newline at end of file
+}
+
+
+// === VALIDATION =============================================
+
+// --------------------------------------------------------
+// A vertex and pixel shader to drive, and stand-in objects
+// for their bind calls (told apart only by address)
+// --------------------------------------------------------
+struct BindingTestShaders
+{
+	SimpleVertexShader* VS;
+	SimplePixelShader* PS;
+	std::string SRVName;
+	std::string SamplerName;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRVs[2];
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> Samplers[2];
+
+	// What each test points the shaders at
+	std::shared_ptr<BindingFilter> Filter;
+	std::shared_ptr<NullRenderDevice> Device;
+};
+
+// Gives both shaders a fresh filter and recording device
+static void ResetBindingTest(BindingTestShaders& s)
+{
+	s.Filter = std::make_shared<BindingFilter>();
+	s.Device = std::make_shared<NullRenderDevice>();
+	s.VS->SetBindingFilter(s.Filter);
+	s.PS->SetBindingFilter(s.Filter);
+	s.VS->SetRenderDevice(s.Device);
+	s.PS->SetRenderDevice(s.Device);
+}
+
+// Every call the filter let through reached the device, and
+// nothing else did
+static bool DeviceGotIssuedCalls(const BindingTestShaders& s)
+{
+	return s.Device->GetCommands().size() == s.Filter->GetIssuedCount();
+}
+
+// Was the last call the device received this exact binding?
+static bool LastCommandWas(const BindingTestShaders& s, unsigned int type, unsigned int stage, unsigned int slot, RenderHandle object, unsigned int firstConstant = 0, unsigned int numConstants = 0)
+{
+	const std::vector<RenderCommand>& commands = s.Device->GetCommands();
+	if (commands.empty())
+		return false;
+
+	const RenderCommand& c = commands.back();
+	return
+		c.Type == type && c.Stage == stage && c.Slot == slot && c.Object == object &&
+		c.Args[0] == firstConstant && c.Args[1] == numConstants;
+}
+
+// Each shader is only bound once, even when set again
+static bool TestSameShader(BindingTestShaders& s)
+{
+	ResetBindingTest(s);
+
+	s.PS->SetShader();
+	s.PS->SetShader();
+	s.PS->SetShader();
+	if (s.Device->GetCallCount(RENDER_COMMAND_SET_SHADER) != 1 ||
+		s.Filter->GetFilteredCount(BINDING_TYPE_SHADER) != 2)
+		return false;
+
+	// The vertex stage is its own binding, with its input layout
+	s.VS->SetShader();
+	s.VS->SetShader();
+	return
+		s.Device->GetCallCount(RENDER_COMMAND_SET_SHADER) == 2 &&
+		s.Device->GetCallCount(RENDER_COMMAND_SET_INPUT_LAYOUT) == 1 &&
+		DeviceGotIssuedCalls(s);
+}
+
+// An SRV is only bound when it changes
+static bool TestSameShaderResource(BindingTestShaders& s)
+{
+	ResetBindingTest(s);
+	const SimpleSRV* srv = s.PS->GetShaderResourceViewInfo(s.SRVName);
+	if (!srv)
+		return false;
+
+	s.PS->SetShaderResourceView(s.SRVName, s.SRVs[0]);
+	s.PS->SetShaderResourceView(s.SRVName, s.SRVs[0]);
+	if (s.Device->GetCallCount(RENDER_COMMAND_SET_TEXTURE) != 1 ||
+		!LastCommandWas(s, RENDER_COMMAND_SET_TEXTURE, BINDING_STAGE_PIXEL, srv->BindIndex, D3D11RenderDevice::GetHandle(s.SRVs[0].Get())))
+		return false;
+
+	// Swapping back and forth needs every call
+	s.PS->SetShaderResourceView(s.SRVName, s.SRVs[1]);
+	s.PS->SetShaderResourceView(s.SRVName, s.SRVs[0]);
+	return
+		s.Device->GetCallCount(RENDER_COMMAND_SET_TEXTURE) == 3 &&
+		LastCommandWas(s, RENDER_COMMAND_SET_TEXTURE, BINDING_STAGE_PIXEL, srv->BindIndex, D3D11RenderDevice::GetHandle(s.SRVs[0].Get())) &&
+		DeviceGotIssuedCalls(s);
+}
+
+// A sampler is only bound when it changes
+static bool TestSameSampler(BindingTestShaders& s)
+{
+	ResetBindingTest(s);
+	const SimpleSampler* sampler = s.PS->GetSamplerInfo(s.SamplerName);
+	if (!sampler)
+		return false;
+
+	s.PS->SetSamplerState(s.SamplerName, s.Samplers[0]);
+	s.PS->SetSamplerState(s.SamplerName, s.Samplers[0]);
+	s.PS->SetSamplerState(s.SamplerName, s.Samplers[1]);
+	s.PS->SetSamplerState(s.SamplerName, s.Samplers[1]);
+	return
+		s.Device->GetCallCount(RENDER_COMMAND_SET_SAMPLER) == 2 &&
+		s.Filter->GetFilteredCount(BINDING_TYPE_SAMPLER) == 2 &&
+		LastCommandWas(s, RENDER_COMMAND_SET_SAMPLER, BINDING_STAGE_PIXEL, sampler->BindIndex, D3D11RenderDevice::GetHandle(s.Samplers[1].Get())) &&
+		DeviceGotIssuedCalls(s);
+}
+
+// Every upload to the ring is a new range of the same buffer
+// that must be bound, but setting the shader again without
+// uploading binds nothing new
+static bool TestRingRanges(BindingTestShaders& s)
+{
+	ResetBindingTest(s);
+
+	// Without the ring, constant data has buffers of its own
+	std::shared_ptr<ConstantBufferRing> ring = s.VS->GetConstantBufferRing();
+	if (!ring)
+		return true;
+
+	s.VS->SetShader();
+	unsigned int bound = s.Device->GetCallCount(RENDER_COMMAND_SET_CONSTANT_BUFFER);
+
+	s.VS->CopyAllBufferData();
+	unsigned int uploaded = s.Device->GetCallCount(RENDER_COMMAND_SET_CONSTANT_BUFFER) - bound;
+	if (uploaded == 0 || !DeviceGotIssuedCalls(s))
+		return false;
+	RenderCommand first = s.Device->GetCommands().back();
+
+	s.VS->SetShader();
+	if (s.Device->GetCallCount(RENDER_COMMAND_SET_CONSTANT_BUFFER) != bound + uploaded)
+		return false;
+
+	s.VS->CopyAllBufferData();
+	const RenderCommand& second = s.Device->GetCommands().back();
+	return
+		s.Device->GetCallCount(RENDER_COMMAND_SET_CONSTANT_BUFFER) == bound + uploaded * 2 &&
+		second.Type == RENDER_COMMAND_SET_CONSTANT_BUFFER &&
+		second.Object == D3D11RenderDevice::GetHandle(ring->GetBuffer()) &&
+		second.Object == first.Object &&
+		second.Args[0] != first.Args[0] &&
+		DeviceGotIssuedCalls(s);
+}
+
+// Binds what a frame of the game would, after invalidating
+// the filter like the game does at the start of every frame
+static std::vector<RenderCommand> DrawBindingTestFrame(BindingTestShaders& s, bool invalidate)
+{
+	if (invalidate)
+		s.Filter->Invalidate();
+
+	s.Device->ClearCommands();
+	s.VS->SetShader();
+	s.PS->SetShader();
+	s.PS->SetShaderResourceView(s.SRVName, s.SRVs[0]);
+	s.PS->SetSamplerState(s.SamplerName, s.Samplers[0]);
+	s.VS->SetShader();
+	s.PS->SetShader();
+	return s.Device->GetCommands();
+}
+
+// Each frame's binds all reach the device again once the
+// filter is invalidated (so nothing bound outside the filter
+// in between, like the UI, is relied upon), and none do if
+// it isn't
+static bool TestInvalidate(BindingTestShaders& s)
+{
+	ResetBindingTest(s);
+
+	std::vector<RenderCommand> frames[2];
+	for (int i = 0; i < 2; i++)
+		frames[i] = DrawBindingTestFrame(s, true);
+	if (frames[0].empty() ||
+		frames[0].size() != frames[1].size() ||
+		s.Device->GetCallCount(RENDER_COMMAND_SET_TEXTURE) != 2 ||
+		s.Device->GetCallCount(RENDER_COMMAND_SET_SAMPLER) != 2)
+		return false;
+
+	for (size_t i = 0; i < frames[0].size(); i++)
+	{
+		const RenderCommand& a = frames[0][i];
+		const RenderCommand& b = frames[1][i];
+		if (a.Type != b.Type || a.Stage != b.Stage || a.Slot != b.Slot || a.Object != b.Object ||
+			memcmp(a.Args, b.Args, sizeof(a.Args)) != 0)
+			return false;
+	}
+
+	// Everything is still known without invalidating
+	return DrawBindingTestFrame(s, false).empty();
+}
+
+// --------------------------------------------------------
+// Runs each validation test with the shaders sending their
+// binds to a fresh filter and recording device, then puts
+// back whatever they were using
+//
+// device      - For creating stand-in SRVs and samplers
+// vs          - Vertex shader to drive
+// ps          - Pixel shader to drive
+// srvName     - An SRV the pixel shader declares
+// samplerName - A sampler the pixel shader declares
+// results     - Filled in with one result per test
+// --------------------------------------------------------
+void RunBindingFilterValidation(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	std::shared_ptr<SimpleVertexShader> vs,
+	std::shared_ptr<SimplePixelShader> ps,
+	std::string srvName,
+	std::string samplerName,
+	std::vector<ValidationResult>* results)
+{
+	BindingTestShaders shaders;
+	shaders.VS = vs.get();
+	shaders.PS = ps.get();
+	shaders.SRVName = srvName;
+	shaders.SamplerName = samplerName;
+
+	// Two of each, as D3D hands back the same object for
+	// identical sampler descriptions
+	unsigned int pixel = 0xFFFFFFFF;
+	D3D11_SUBRESOURCE_DATA pixelData = {};
+	pixelData.pSysMem = &pixel;
+	pixelData.SysMemPitch = sizeof(pixel);
+
+	D3D11_TEXTURE2D_DESC texDesc = {};
+	texDesc.Width = 1;
+	texDesc.Height = 1;
+	texDesc.MipLevels = 1;
+	texDesc.ArraySize = 1;
+	texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	texDesc.SampleDesc.Count = 1;
+	texDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SAMPLER_DESC sampDesc = {};
+	sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+	sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+	sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+	sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
+
+	for (int i = 0; i < 2; i++)
+	{
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		device->CreateTexture2D(&texDesc, &pixelData, texture.GetAddressOf());
+		device->CreateShaderResourceView(texture.Get(), 0, shaders.SRVs[i].GetAddressOf());
+
+		sampDesc.Filter = i == 0 ? D3D11_FILTER_MIN_MAG_MIP_POINT : D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+		device->CreateSamplerState(&sampDesc, shaders.Samplers[i].GetAddressOf());
+	}
+
+	// The shaders go back to these afterwards
+	std::shared_ptr<BindingFilter> vsFilter = vs->GetBindingFilter();
+	std::shared_ptr<BindingFilter> psFilter = ps->GetBindingFilter();
+	std::shared_ptr<IRenderDevice> vsDevice = vs->GetRenderDevice();
+	std::shared_ptr<IRenderDevice> psDevice = ps->GetRenderDevice();
+
+	const ValidationTest<BindingTestShaders&> tests[] = {
+		{ "Same Shader", TestSameShader },
+		{ "Same SRV", TestSameShaderResource },
+		{ "Same Sampler", TestSameSampler },
+		{ "Ring Ranges", TestRingRanges },
+		{ "Invalidate", TestInvalidate } };
+
+	RunValidationTests(tests, 1, results, shaders);
+
+	vs->SetBindingFilter(vsFilter);
+	ps->SetBindingFilter(psFilter);
+	vs->SetRenderDevice(vsDevice);
+	ps->SetRenderDevice(psDevice);
+}
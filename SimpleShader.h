@@ -2,7 +2,7 @@
 #pragma comment(lib, "dxguid.lib")
 #pragma comment(lib, "d3dcompiler.lib")
 
-#include <d3d11.h>
+#include <d3d11_1.h>
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 #include <wrl/client.h>
@@ -10,6 +10,14 @@
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include <memory>
+#include <functional>
+
+#include "ConstantBufferRing.h"
+#include "RenderDevice.h"
+#include "ShaderReflectionCache.h"
+#include "BindingFilter.h"
+#include "Validation.h"
 
 
 // --------------------------------------------------------
@@ -23,6 +31,9 @@ struct SimpleShaderVariable
 	unsigned int ConstantBufferIndex;
 };
 
+// Defined below, but referenced by constant buffers
+class SimpleSharedConstantBuffer;
+
 // --------------------------------------------------------
 // Contains information about a specific
 // constant buffer in a shader, as well as
@@ -37,6 +48,20 @@ struct SimpleConstantBuffer
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ConstantBuffer = 0;
 	unsigned char* LocalDataBuffer = 0;
 	std::vector<SimpleShaderVariable> Variables;
+	RingAllocation RingRange; // Most recent upload when using a ring
+	std::shared_ptr<SimpleSharedConstantBuffer> SharedBuffer; // Externally owned replacement, if any
+};
+
+// --------------------------------------------------------
+// Where a constant buffer's data currently lives, so that
+// it can be bound on a context other than the shader's own
+// --------------------------------------------------------
+struct SimpleConstantBufferBinding
+{
+	unsigned int BindIndex = 0;
+	ID3D11Buffer* Buffer = 0;
+	unsigned int FirstConstant = 0;	// In 16-byte constants
+	unsigned int NumConstants = 0;	// Zero for the entire buffer
 };
 
 // --------------------------------------------------------
@@ -57,6 +82,55 @@ struct SimpleSampler
 	unsigned int BindIndex; // The register of the Sampler
 };
 
+// --------------------------------------------------------
+// A constant buffer that lives outside of any one shader,
+// so that data which only changes once per frame (lights,
+// camera, etc.) can be set and uploaded a single time and
+// then used by every shader declaring the same layout.
+//
+// Create one from a shader that declares the buffer, using
+// ISimpleShader::CreateSharedConstantBuffer(), and attach it
+// to other shaders with ISimpleShader::SetSharedConstantBuffer()
+// --------------------------------------------------------
+class SimpleSharedConstantBuffer
+{
+public:
+	SimpleSharedConstantBuffer(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		std::string name,
+		unsigned int size,
+		const std::unordered_map<std::string, SimpleShaderVariable>& variables);
+
+	// Sets data in the local copy of the buffer
+	bool SetData(std::string name, const void* data, unsigned int size);
+	bool SetInt(std::string name, int data);
+	bool SetFloat(std::string name, float data);
+	bool SetFloat2(std::string name, const DirectX::XMFLOAT2 data);
+	bool SetFloat3(std::string name, const DirectX::XMFLOAT3 data);
+	bool SetFloat4(std::string name, const DirectX::XMFLOAT4 data);
+	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
+
+	// Uploads the local copy, but only if it has changed
+	void CopyBufferData();
+
+	// Layout details
+	const std::string& GetName() { return name; }
+	unsigned int GetSize() { return size; }
+	const std::unordered_map<std::string, SimpleShaderVariable>& GetVariables() { return variables; }
+	ID3D11Buffer* GetBuffer() { return constantBuffer.Get(); }
+
+private:
+	std::string name;
+	unsigned int size;
+	bool dirty;
+	std::vector<unsigned char> localData;
+	std::unordered_map<std::string, SimpleShaderVariable> variables;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> constantBuffer;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext;
+};
+
 // --------------------------------------------------------
 // Base abstract class for simplifying shader handling
 // --------------------------------------------------------
@@ -68,6 +142,7 @@ public:
 
 	// Simple helpers
 	bool IsShaderValid() { return shaderValid; }
+	bool WasReflectionCached() { return reflectionCached; }
 
 	// Activating the shader and copying data
 	void SetShader();
@@ -75,6 +150,29 @@ public:
 	void CopyBufferData(unsigned int index);
 	void CopyBufferData(std::string bufferName);
 
+	// Uploading without binding, for binding elsewhere
+	bool UploadAllBufferData();
+	unsigned int GetConstantBufferBindings(SimpleConstantBufferBinding* bindings, unsigned int maxBindings);
+
+	// Suballocating constant data from a shared ring buffer
+	bool SetConstantBufferRing(std::shared_ptr<ConstantBufferRing> ring);
+	std::shared_ptr<ConstantBufferRing> GetConstantBufferRing() { return cbRing; }
+	unsigned int GetRingUploadSize();
+	static void ReserveRingSpace(ISimpleShader* first, ISimpleShader* second);
+
+	// Where vertex and pixel shader binds go
+	void SetRenderDevice(std::shared_ptr<IRenderDevice> device);
+	std::shared_ptr<IRenderDevice> GetRenderDevice() { return renderDevice; }
+
+	// Skipping redundant binds (shared between shaders)
+	void SetBindingFilter(std::shared_ptr<BindingFilter> filter) { bindingFilter = filter; }
+	std::shared_ptr<BindingFilter> GetBindingFilter() { return bindingFilter; }
+
+	// Constant buffers shared between shaders
+	std::shared_ptr<SimpleSharedConstantBuffer> CreateSharedConstantBuffer(std::string bufferName);
+	bool SetSharedConstantBuffer(std::shared_ptr<SimpleSharedConstantBuffer> sharedBuffer);
+	bool IsLayoutCompatible(std::string bufferName, std::shared_ptr<SimpleSharedConstantBuffer> sharedBuffer);
+
 	// Sets arbitrary shader data
 	bool SetData(std::string name, const void* data, unsigned int size);
 
@@ -122,13 +220,33 @@ public:
 	static bool ReportErrors;
 	static bool ReportWarnings;
 
+	// Caching reflection results next to each shader file
+	static bool ReflectionCacheEnabled;
+
+	// Reads compiled shader files (D3DReadFileToBlob() if not
+	// set), so they can come from somewhere other than disk
+	static std::function<HRESULT(LPCWSTR shaderFile, ID3DBlob** blob)> FileReader;
+
 protected:
 	
 	bool shaderValid;
+	bool reflectionCached;
+	ShaderReflectionData reflection;
 	Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
 	Microsoft::WRL::ComPtr<ID3D11Device> device;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext;
 
+	// Optional ring for constant data (requires an 11.1 context)
+	std::shared_ptr<ConstantBufferRing> cbRing;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> deviceContext1;
+
+	// Optional filter for redundant binds
+	std::shared_ptr<BindingFilter> bindingFilter;
+
+	// Receives vertex and pixel shader binds (the other stages
+	// aren't supported by devices, so use the context)
+	std::shared_ptr<IRenderDevice> renderDevice;
+
 	// Resource counts
 	unsigned int constantBufferCount;
 	
@@ -141,18 +259,32 @@ protected:
 	std::unordered_map<std::string, SimpleSRV*> textureTable;
 	std::unordered_map<std::string, SimpleSampler*> samplerTable;
 
-	// Initialization method
+	// Initialization methods
 	bool LoadShaderFile(LPCWSTR shaderFile);
+	void ReflectShader();
+	void BuildTables();
+	bool LoadReflectionCache(LPCWSTR shaderFile);
+	void SaveReflectionCache(LPCWSTR shaderFile);
 
 	// Pure virtual functions for dealing with shader types
 	virtual bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob) = 0;
 	virtual void SetShaderAndCBs() = 0;
+	virtual void SetConstantBufferRange(unsigned int bindIndex, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int numConstants) = 0;
+	virtual unsigned int GetBindingStage() = 0;
 
 	virtual void CleanUp();
 
+	// Helpers for ring-based constant buffers
+	void CopyBufferToRing(SimpleConstantBuffer* cb);
+	void SetRingConstantBuffer(SimpleConstantBuffer* cb);
+
+	// Helper for filtering redundant binds
+	bool ShouldBind(unsigned int type, unsigned int slot, const void* object, unsigned int firstConstant = 0, unsigned int numConstants = 0);
+
 	// Helpers for finding data by name
 	SimpleShaderVariable* FindVariable(std::string name, int size);
 	SimpleConstantBuffer* FindConstantBuffer(std::string name);
+	std::unordered_map<std::string, SimpleShaderVariable> GetBufferVariables(unsigned int index);
 
 	// Error logging
 	void Log(std::string message, WORD color);
@@ -187,6 +319,8 @@ protected:
 	 Microsoft::WRL::ComPtr<ID3D11VertexShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void SetConstantBufferRange(unsigned int bindIndex, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int numConstants);
+	unsigned int GetBindingStage() { return BINDING_STAGE_VERTEX; }
 	void CleanUp();
 };
 
@@ -208,6 +342,8 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void SetConstantBufferRange(unsigned int bindIndex, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int numConstants);
+	unsigned int GetBindingStage() { return BINDING_STAGE_PIXEL; }
 	void CleanUp();
 };
 
@@ -228,6 +364,8 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11DomainShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void SetConstantBufferRange(unsigned int bindIndex, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int numConstants);
+	unsigned int GetBindingStage() { return BINDING_STAGE_DOMAIN; }
 	void CleanUp();
 };
 
@@ -248,6 +386,8 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11HullShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void SetConstantBufferRange(unsigned int bindIndex, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int numConstants);
+	unsigned int GetBindingStage() { return BINDING_STAGE_HULL; }
 	void CleanUp();
 };
 
@@ -280,6 +420,8 @@ protected:
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	bool CreateShaderWithStreamOut(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void SetConstantBufferRange(unsigned int bindIndex, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int numConstants);
+	unsigned int GetBindingStage() { return BINDING_STAGE_GEOMETRY; }
 	void CleanUp();
 
 	// Helpers
@@ -319,5 +461,19 @@ protected:
 
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void SetConstantBufferRange(unsigned int bindIndex, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int numConstants);
+	unsigned int GetBindingStage() { return BINDING_STAGE_COMPUTE; }
 	void CleanUp();
-};
\ No newline at end of file
+};
+
+// Checks which of a vertex and pixel shader's bind calls
+// reach a recording render device through a binding filter:
+// rebinding the same shader, SRV or sampler, new ranges of
+// the ring, and a frame's binds again after Invalidate()
+void RunBindingFilterValidation(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	std::shared_ptr<SimpleVertexShader> vs,
+	std::shared_ptr<SimplePixelShader> ps,
+	std::string srvName,
+	std::string samplerName,
+	std::vector<ValidationResult>* results);
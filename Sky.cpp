@@ -1,6 +1,12 @@
 #include "Sky.h"
 #include "WICTextureLoader.h"
 #include "DDSTextureLoader.h"
+#include "Helpers.h"
+#include "FileSystem.h"
+#include "D3D11RenderDevice.h"
+
+#include <algorithm>
+#include <fstream>
 
 using namespace DirectX;
 
@@ -21,11 +27,18 @@ Sky::Sky(
 	this->skyVS = skyVS;
 	this->skyPS = skyPS;
 
+	// No image based lighting until it's baked
+	iblReady = false;
+	iblCached = false;
+	specularMipCount = 0;
+
 	// Init render states
 	InitRenderStates();
 
 	// Load texture
-	CreateDDSTextureFromFile(device.Get(), cubemapDDSFile, 0, skySRV.GetAddressOf());
+	AssetFile file;
+	if (OpenAssetFile(cubemapDDSFile, &file))
+		CreateDDSTextureFromMemory(device.Get(), file.Data, file.Size, 0, skySRV.GetAddressOf());
 }
 
 Sky::Sky(
@@ -38,6 +51,11 @@ Sky::Sky(
 	device(device),
 	context(context)
 {
+	// No image based lighting until it's baked
+	iblReady = false;
+	iblCached = false;
+	specularMipCount = 0;
+
 	// Init render states
 	InitRenderStates();
 }
@@ -64,6 +82,11 @@ Sky::Sky(
 	this->skyVS = skyVS;
 	this->skyPS = skyPS;
 
+	// No image based lighting until it's baked
+	iblReady = false;
+	iblCached = false;
+	specularMipCount = 0;
+
 	// Init render states
 	InitRenderStates();
 
@@ -71,6 +94,35 @@ Sky::Sky(
 	skySRV = CreateCubemap(right, left, up, down, front, back);
 }
 
+Sky::Sky(
+	const TextureImage faces[6],
+	std::shared_ptr<Mesh> mesh,
+	std::shared_ptr<SimpleVertexShader> skyVS,
+	std::shared_ptr<SimplePixelShader> skyPS,
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerOptions,
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	// Save params
+	this->skyMesh = mesh;
+	this->device = device;
+	this->context = context;
+	this->samplerOptions = samplerOptions;
+	this->skyVS = skyVS;
+	this->skyPS = skyPS;
+
+	// No image based lighting until it's baked
+	iblReady = false;
+	iblCached = false;
+	specularMipCount = 0;
+
+	// Init render states
+	InitRenderStates();
+
+	// Create texture from 6 images
+	skySRV = CreateCubemap(faces);
+}
+
 Sky::Sky(
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> right,
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> left,
@@ -93,6 +145,11 @@ Sky::Sky(
 	this->skyVS = skyVS;
 	this->skyPS = skyPS;
 
+	// No image based lighting until it's baked
+	iblReady = false;
+	iblCached = false;
+	specularMipCount = 0;
+
 	// Init render states
 	InitRenderStates();
 
@@ -104,31 +161,29 @@ Sky::~Sky()
 {
 }
 
-void Sky::Draw(std::shared_ptr<Camera> camera)
+void Sky::Draw(IRenderDevice* device)
 {
 	// Change to the sky-specific rasterizer state
-	context->RSSetState(skyRasterState.Get());
-	context->OMSetDepthStencilState(skyDepthState.Get(), 0);
+	device->SetRasterizerState(D3D11RenderDevice::GetHandle(skyRasterState.Get()));
+	device->SetDepthStencilState(D3D11RenderDevice::GetHandle(skyDepthState.Get()));
 
 	// Set the sky shaders
 	skyVS->SetShader();
 	skyPS->SetShader();
 
-	// Give them proper data
-	skyVS->SetMatrix4x4("view", camera->GetView());
-	skyVS->SetMatrix4x4("projection", camera->GetProjection());
-	skyVS->CopyAllBufferData();
+	// The view and projection come from the shared per-frame
+	// buffer, which is already up to date
 
 	// Send the proper resources to the pixel shader
 	skyPS->SetShaderResourceView("skyTexture", skySRV);
 	skyPS->SetSamplerState("samplerOptions", samplerOptions);
 
 	// Set mesh buffers and draw
-	skyMesh->SetBuffersAndDraw(context);
+	skyMesh->SetBuffersAndDraw(device);
 
 	// Reset my rasterizer state to the default
-	context->RSSetState(0); // Null (or 0) puts back the defaults
-	context->OMSetDepthStencilState(0, 0);
+	device->SetRasterizerState(0); // Null (or 0) puts back the defaults
+	device->SetDepthStencilState(0);
 }
 
 void Sky::InitRenderStates()
@@ -160,18 +215,75 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
 	// - We need references to the TEXTURES, not the SHADER RESOURCE VIEWS!
 	// - Specifically NOT generating mipmaps, as we don't need them for the sky!
 	// - Order matters here!  +X, -X, +Y, -Y, +Z, -Z
+	// - Files come from a mounted pack if one has them
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textures[6] = {};
-	CreateWICTextureFromFile(device.Get(), right, 0, textures[0].GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), left, 0, textures[1].GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), up, 0, textures[2].GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), down, 0, textures[3].GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), front, 0, textures[4].GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), back, 0, textures[5].GetAddressOf());
+	const wchar_t* files[6] = { right, left, up, down, front, back };
+	for (int i = 0; i < 6; i++)
+	{
+		AssetFile file;
+		if (OpenAssetFile(files[i], &file))
+			CreateWICTextureFromMemory(device.Get(), file.Data, file.Size, 0, textures[i].GetAddressOf());
+	}
 
 	// Send back the SRV, which is what we need for our shaders
 	return CreateCubemap(textures[0], textures[1], textures[2], textures[3], textures[4], textures[5]);
 }
 
+// --------------------------------------------------------
+// Creates the cube map straight from decoded face images,
+// which also lets image based lighting skip reading the
+// faces back from the GPU
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(const TextureImage faces[6])
+{
+	// Every face needs to match the first
+	unsigned int size = faces[0].Width;
+	for (int i = 0; i < 6; i++)
+	{
+		if (faces[i].Width != size || faces[i].Height != size || faces[i].Pixels.empty())
+			return 0;
+	}
+
+	D3D11_TEXTURE2D_DESC cubeDesc = {};
+	cubeDesc.ArraySize = 6;
+	cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	cubeDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	cubeDesc.Width = size;
+	cubeDesc.Height = size;
+	cubeDesc.MipLevels = 1;
+	cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+	cubeDesc.Usage = D3D11_USAGE_IMMUTABLE; // Filled in right away, then never changes
+	cubeDesc.SampleDesc.Count = 1;
+
+	D3D11_SUBRESOURCE_DATA faceData[6] = {};
+	for (int i = 0; i < 6; i++)
+	{
+		faceData[i].pSysMem = &faces[i].Pixels[0];
+		faceData[i].SysMemPitch = size * 4;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeMapTexture;
+	if (FAILED(device->CreateTexture2D(&cubeDesc, faceData, cubeMapTexture.GetAddressOf())))
+		return 0;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = cubeDesc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+	srvDesc.TextureCube.MipLevels = 1;
+	srvDesc.TextureCube.MostDetailedMip = 0;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cubeSRV;
+	device->CreateShaderResourceView(cubeMapTexture.Get(), &srvDesc, cubeSRV.GetAddressOf());
+
+	// Image based lighting from the same faces
+	iblSource.Size = (std::min)(size, IBLBakeSettings().SourceSize);
+	for (unsigned int i = 0; i < 6; i++)
+		DownsampleIBLFace(&faces[i].Pixels[0], size, size * 4, false, i, &iblSource);
+	BakeOrLoadIBL();
+
+	return cubeSRV;
+}
+
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> right,
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> left,
@@ -248,6 +360,9 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cubeSRV;
 	device->CreateShaderResourceView(cubeMapTexture.Get(), &srvDesc, cubeSRV.GetAddressOf());
 
+	// Bake (or load) image based lighting from the same faces
+	CreateIBL(textures, faceDesc);
+
 	// Clean up our extra texture refs
 	for (int i = 0; i < 6; i++)
 		textures[i]->Release();
@@ -255,3 +370,199 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
 	// Send back the SRV, which is what we need for our shaders
 	return cubeSRV;
 }
+
+// --------------------------------------------------------
+// Sets up image based lighting from the six face textures:
+// reads them back, then loads the baked results from the
+// cache or bakes (and caches) them, and finally creates
+// the textures the PBR shader reads
+// --------------------------------------------------------
+void Sky::CreateIBL(ID3D11Resource* faces[6], const D3D11_TEXTURE2D_DESC& faceDesc)
+{
+	if (!ReadIBLSource(faces, faceDesc))
+		return;
+
+	BakeOrLoadIBL();
+}
+
+// --------------------------------------------------------
+// Loads the baked results for the IBL source from the
+// cache, or bakes (and caches) them, then creates the
+// textures the PBR shader reads
+// --------------------------------------------------------
+void Sky::BakeOrLoadIBL()
+{
+	// The cache is keyed by the downsampled sky and settings
+	IBLBakeSettings settings;
+	unsigned long long hash = HashIBLSource(iblSource, settings);
+	wchar_t cacheName[64] = {};
+	swprintf_s(cacheName, L"IBL_%016llX.iblcache", hash);
+	std::wstring cachePath = FixPath(cacheName);
+
+	iblCached = LoadIBLCache(cachePath, hash);
+	if (!iblCached)
+	{
+		BakeIBL(iblSource, settings, &ibl, &iblTimings);
+		SaveIBLCache(cachePath);
+	}
+
+	CreateIBLResources();
+}
+
+// --------------------------------------------------------
+// Copies each face back from the GPU and downsamples it
+// into the IBL source cube map
+//
+// Returns false for formats the baker doesn't understand
+// (anything other than 8-bit RGBA or BGRA)
+// --------------------------------------------------------
+bool Sky::ReadIBLSource(ID3D11Resource* faces[6], const D3D11_TEXTURE2D_DESC& faceDesc)
+{
+	bool bgra;
+	switch (faceDesc.Format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		bgra = false;
+		break;
+
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+		bgra = true;
+		break;
+
+	default:
+		return false;
+	}
+
+	// A CPU-readable texture to copy each face into
+	D3D11_TEXTURE2D_DESC stagingDesc = faceDesc;
+	stagingDesc.MipLevels = 1;
+	stagingDesc.ArraySize = 1;
+	stagingDesc.BindFlags = 0;
+	stagingDesc.MiscFlags = 0;
+	stagingDesc.Usage = D3D11_USAGE_STAGING;
+	stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> staging;
+	if (FAILED(device->CreateTexture2D(&stagingDesc, 0, staging.GetAddressOf())))
+		return false;
+
+	iblSource.Size = (std::min)(faceDesc.Width, IBLBakeSettings().SourceSize);
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		context->CopySubresourceRegion(staging.Get(), 0, 0, 0, 0, faces[i], 0, 0);
+
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (FAILED(context->Map(staging.Get(), 0, D3D11_MAP_READ, 0, &mapped)))
+			return false;
+
+		DownsampleIBLFace((const unsigned char*)mapped.pData, faceDesc.Width, mapped.RowPitch, bgra, i, &iblSource);
+		context->Unmap(staging.Get(), 0);
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Reads previously baked results, if the cache file exists
+// and was baked from this exact sky with these settings
+// --------------------------------------------------------
+bool Sky::LoadIBLCache(const std::wstring& path, unsigned long long hash)
+{
+	AssetFile file;
+	if (!OpenAssetFile(path, &file) || file.Size == 0)
+		return false;
+
+	IBLData data;
+	if (!DeserializeIBL(file.Data, file.Size, &data) || data.Hash != hash)
+		return false;
+
+	ibl = data;
+	return true;
+}
+
+// --------------------------------------------------------
+// Writes the baked results to the cache.  Failing to write
+// isn't an error, as the sky will simply be baked again.
+// --------------------------------------------------------
+void Sky::SaveIBLCache(const std::wstring& path)
+{
+	std::vector<unsigned char> bytes;
+	SerializeIBL(ibl, bytes);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (file.is_open())
+		file.write((const char*)&bytes[0], bytes.size());
+}
+
+// --------------------------------------------------------
+// Creates the prefiltered specular cube map and the BRDF
+// look up texture from the baked data, then frees the CPU
+// copies of their texels
+// --------------------------------------------------------
+void Sky::CreateIBLResources()
+{
+	if (ibl.SpecularMips.empty() || ibl.BRDFLUT.empty())
+		return;
+
+	// Prefiltered specular: every mip of every face
+	specularMipCount = (unsigned int)ibl.SpecularMips.size();
+	std::vector<D3D11_SUBRESOURCE_DATA> specularData(6 * specularMipCount);
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int mip = 0; mip < specularMipCount; mip++)
+		{
+			const IBLCubemap& level = ibl.SpecularMips[mip];
+			D3D11_SUBRESOURCE_DATA& data = specularData[D3D11CalcSubresource(mip, face, specularMipCount)];
+			data.pSysMem = &level.Texels[face * level.Size * level.Size];
+			data.SysMemPitch = level.Size * sizeof(DirectX::XMFLOAT4);
+		}
+	}
+
+	D3D11_TEXTURE2D_DESC specularDesc = {};
+	specularDesc.Width = ibl.SpecularMips[0].Size;
+	specularDesc.Height = ibl.SpecularMips[0].Size;
+	specularDesc.MipLevels = specularMipCount;
+	specularDesc.ArraySize = 6;
+	specularDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	specularDesc.SampleDesc.Count = 1;
+	specularDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	specularDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	specularDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> specularTexture;
+	device->CreateTexture2D(&specularDesc, &specularData[0], specularTexture.GetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC specularSRVDesc = {};
+	specularSRVDesc.Format = specularDesc.Format;
+	specularSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+	specularSRVDesc.TextureCube.MipLevels = specularMipCount;
+	device->CreateShaderResourceView(specularTexture.Get(), &specularSRVDesc, specularIBLSRV.GetAddressOf());
+
+	// Split-sum BRDF look up table
+	D3D11_SUBRESOURCE_DATA lutData = {};
+	lutData.pSysMem = &ibl.BRDFLUT[0];
+	lutData.SysMemPitch = ibl.BRDFLUTSize * sizeof(DirectX::XMFLOAT2);
+
+	D3D11_TEXTURE2D_DESC lutDesc = {};
+	lutDesc.Width = ibl.BRDFLUTSize;
+	lutDesc.Height = ibl.BRDFLUTSize;
+	lutDesc.MipLevels = 1;
+	lutDesc.ArraySize = 1;
+	lutDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+	lutDesc.SampleDesc.Count = 1;
+	lutDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	lutDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> lutTexture;
+	device->CreateTexture2D(&lutDesc, &lutData, lutTexture.GetAddressOf());
+	device->CreateShaderResourceView(lutTexture.Get(), 0, brdfLookUpSRV.GetAddressOf());
+
+	// The GPU has its own copies now
+	ibl.SpecularMips.clear();
+	ibl.BRDFLUT.clear();
+	iblReady = specularIBLSRV.Get() != 0 && brdfLookUpSRV.Get() != 0;
+}
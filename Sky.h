@@ -5,6 +5,8 @@
 #include "Mesh.h"
 #include "SimpleShader.h"
 #include "Camera.h"
+#include "IBLBaker.h"
+#include "TextureCooker.h"
 
 #include <wrl/client.h> // Used for ComPtr
 
@@ -47,6 +49,19 @@ public:
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context
 	);
 
+	// Constructor that makes a cube map from 6 already decoded
+	// images (+X, -X, +Y, -Y, +Z, -Z), which must be square and
+	// all the same size
+	Sky(
+		const TextureImage faces[6],
+		std::shared_ptr<Mesh> mesh,
+		std::shared_ptr<SimpleVertexShader> skyVS,
+		std::shared_ptr<SimplePixelShader> skyPS,
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerOptions,
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context
+	);
+
 	// Constructor that takes 6 existing SRVs and makes a cube map
 	Sky(
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> right,
@@ -65,12 +80,30 @@ public:
 
 	~Sky();
 
-	void Draw(std::shared_ptr<Camera> camera);
+	void Draw(IRenderDevice* device);
+
+	// Image based lighting, baked from skies made of 6 images
+	bool HasIBL() { return iblReady; }
+	bool WasIBLCached() { return iblCached; }
+	IBLBakeTimings GetIBLBakeTimings() { return iblTimings; }
+	const IBLCubemap& GetIBLSource() { return iblSource; }
+	const DirectX::XMFLOAT3* GetIrradianceSH() { return ibl.IrradianceSH; }
+	unsigned int GetSpecularMipCount() { return specularMipCount; }
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSpecularIBL() { return specularIBLSRV; }
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetBRDFLookUpTexture() { return brdfLookUpSRV; }
 
 private:
 
 	void InitRenderStates();
 
+	// Helpers for image based lighting
+	void CreateIBL(ID3D11Resource* faces[6], const D3D11_TEXTURE2D_DESC& faceDesc);
+	bool ReadIBLSource(ID3D11Resource* faces[6], const D3D11_TEXTURE2D_DESC& faceDesc);
+	void BakeOrLoadIBL();
+	bool LoadIBLCache(const std::wstring& path, unsigned long long hash);
+	void SaveIBLCache(const std::wstring& path);
+	void CreateIBLResources();
+
 	// Helper for creating a cubemap from 6 individual textures
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(
 		const wchar_t* right,
@@ -80,6 +113,8 @@ private:
 		const wchar_t* front,
 		const wchar_t* back);
 
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(const TextureImage faces[6]);
+
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> right,
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> left,
@@ -98,6 +133,16 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> skyDepthState;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> skySRV;
 
+	// Image based lighting resources
+	bool iblReady;
+	bool iblCached;
+	IBLBakeTimings iblTimings;
+	IBLCubemap iblSource;	// Downsampled sky, kept for re-baking
+	IBLData ibl;			// Only the SH is kept after upload
+	unsigned int specularMipCount;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> specularIBLSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> brdfLookUpSRV;
+
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerOptions;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
 	Microsoft::WRL::ComPtr<ID3D11Device> device;
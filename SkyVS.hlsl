@@ -2,7 +2,9 @@
 // The variables defined in this cbuffer will pull their data from the 
 // constant buffer (ID3D11Buffer) bound to "vertex shader constant buffer slot 0"
 // It was bound using context->VSSetConstantBuffers() over in C++.
-cbuffer ExternalData : register(b0)
+// The name (and layout) matches the other vertex shader's per-frame
+// buffer so a single shared buffer can feed both.
+cbuffer perFrame : register(b0)
 {
 	matrix view;
 	matrix projection;
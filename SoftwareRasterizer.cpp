@@ -0,0 +1,1174 @@
+#include "SoftwareRasterizer.h"
+#include "LightingSIMD.h"
+#include "EntityLightLists.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace DirectX;
+
+#define SOFTWARE_SUBPIXEL_SCALE		(1 << SOFTWARE_SUBPIXEL_BITS)
+#define SOFTWARE_NO_TRIANGLE		0xFFFFFFFF
+
+// The most vertices clipping a triangle against the near
+// plane and the four guard band planes can produce
+#define SOFTWARE_MAX_CLIPPED_VERTICES	8
+
+
+// === MATH HELPERS =================================================
+
+// Small helpers mirroring HLSL's float3 operations
+static XMFLOAT3 Add(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z); }
+static XMFLOAT3 Sub(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+static XMFLOAT3 Mul(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x * b.x, a.y * b.y, a.z * b.z); }
+static XMFLOAT3 Scale(XMFLOAT3 a, float s) { return XMFLOAT3(a.x * s, a.y * s, a.z * s); }
+static float Dot(XMFLOAT3 a, XMFLOAT3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static XMFLOAT3 Cross(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+static float Saturate(float f) { return f < 0.0f ? 0.0f : (f > 1.0f ? 1.0f : f); }
+static XMFLOAT3 Normalize(XMFLOAT3 a) { return Scale(a, 1.0f / sqrtf(Dot(a, a))); }
+static XMFLOAT3 Pow(XMFLOAT3 a, float p) { return XMFLOAT3(powf(a.x, p), powf(a.y, p), powf(a.z, p)); }
+static float Lerp(float a, float b, float t) { return a + (b - a) * t; }
+
+// Row vector times matrix, as DirectXMath does (and as the
+// shaders do with the matrices they're given)
+static XMFLOAT4 Transform(XMFLOAT4 v, const XMFLOAT4X4& m)
+{
+	return XMFLOAT4(
+		v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0] + v.w * m.m[3][0],
+		v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1] + v.w * m.m[3][1],
+		v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2] + v.w * m.m[3][2],
+		v.x * m.m[0][3] + v.y * m.m[1][3] + v.z * m.m[2][3] + v.w * m.m[3][3]);
+}
+
+// Only the upper 3x3, for directions
+static XMFLOAT3 TransformNormal(XMFLOAT3 v, const XMFLOAT4X4& m)
+{
+	return XMFLOAT3(
+		v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0],
+		v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1],
+		v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2]);
+}
+
+static XMFLOAT4X4 Multiply(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+{
+	XMFLOAT4X4 result;
+	for (int r = 0; r < 4; r++)
+		for (int c = 0; c < 4; c++)
+			result.m[r][c] = a.m[r][0] * b.m[0][c] + a.m[r][1] * b.m[1][c] + a.m[r][2] * b.m[2][c] + a.m[r][3] * b.m[3][c];
+	return result;
+}
+
+// --------------------------------------------------------
+// General 4x4 inverse (by cofactors), which leaves the
+// matrix alone if it can't be inverted
+// --------------------------------------------------------
+static XMFLOAT4X4 Inverse(const XMFLOAT4X4& matrix)
+{
+	const float* m = &matrix.m[0][0];
+	float inv[16];
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+	float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	if (det == 0.0f)
+		return matrix;
+
+	XMFLOAT4X4 result;
+	for (int i = 0; i < 16; i++)
+		(&result.m[0][0])[i] = inv[i] / det;
+	return result;
+}
+
+// Rounding towards negative infinity, for sub-pixel positions
+// on either side of the screen's edge
+static int FloorDivide(int a, int b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+
+// === SAMPLING =====================================================
+
+// --------------------------------------------------------
+// Bilinear sample of a texture with wrapped addressing,
+// from the mip nearest the level of detail
+// --------------------------------------------------------
+static XMFLOAT4 SampleTexture(const SoftwareTexture& texture, XMFLOAT2 uv, float lodBias)
+{
+	const TextureImage& top = texture.Mips[0];
+	float lod = lodBias + 0.5f * log2f((float)top.Width * top.Height);
+	int mipCount = (int)texture.Mips.size();
+	int mip = (int)floorf(lod + 0.5f);
+	mip = mip < 0 ? 0 : (mip >= mipCount ? mipCount - 1 : mip);
+	const TextureImage& image = texture.Mips[mip];
+
+	// Texel space, with centers on whole numbers
+	float x = uv.x * image.Width - 0.5f;
+	float y = uv.y * image.Height - 0.5f;
+	float fx = floorf(x);
+	float fy = floorf(y);
+	float tx = x - fx;
+	float ty = y - fy;
+
+	int w = (int)image.Width;
+	int h = (int)image.Height;
+	int x0 = (int)fmodf(fx, (float)w);
+	int y0 = (int)fmodf(fy, (float)h);
+	x0 = x0 < 0 ? x0 + w : x0;
+	y0 = y0 < 0 ? y0 + h : y0;
+	int x1 = x0 + 1 < w ? x0 + 1 : 0;
+	int y1 = y0 + 1 < h ? y0 + 1 : 0;
+
+	const unsigned char* p00 = &image.Pixels[(y0 * w + x0) * 4];
+	const unsigned char* p10 = &image.Pixels[(y0 * w + x1) * 4];
+	const unsigned char* p01 = &image.Pixels[(y1 * w + x0) * 4];
+	const unsigned char* p11 = &image.Pixels[(y1 * w + x1) * 4];
+
+	float result[4];
+	for (int c = 0; c < 4; c++)
+	{
+		float topRow = Lerp(p00[c], p10[c], tx);
+		float bottomRow = Lerp(p01[c], p11[c], tx);
+		result[c] = Lerp(topRow, bottomRow, ty) / 255.0f;
+	}
+	return XMFLOAT4(result[0], result[1], result[2], result[3]);
+}
+
+// --------------------------------------------------------
+// Bilinear, clamped sample of the split-sum BRDF table
+// --------------------------------------------------------
+static XMFLOAT2 SampleBRDFLookUp(const IBLData& ibl, float NdotV, float roughness)
+{
+	unsigned int size = ibl.BRDFLUTSize;
+	float maxCoord = (float)(size - 1);
+	float x = fminf(fmaxf(NdotV * size - 0.5f, 0.0f), maxCoord);
+	float y = fminf(fmaxf(roughness * size - 0.5f, 0.0f), maxCoord);
+
+	unsigned int x0 = (unsigned int)x;
+	unsigned int y0 = (unsigned int)y;
+	unsigned int x1 = x0 + 1 < size ? x0 + 1 : x0;
+	unsigned int y1 = y0 + 1 < size ? y0 + 1 : y0;
+	float tx = x - x0;
+	float ty = y - y0;
+
+	const XMFLOAT2* lut = &ibl.BRDFLUT[0];
+	XMFLOAT2 a = lut[y0 * size + x0], b = lut[y0 * size + x1];
+	XMFLOAT2 c = lut[y1 * size + x0], d = lut[y1 * size + x1];
+	return XMFLOAT2(
+		Lerp(Lerp(a.x, b.x, tx), Lerp(c.x, d.x, tx), ty),
+		Lerp(Lerp(a.y, b.y, tx), Lerp(c.y, d.y, tx), ty));
+}
+
+
+// === SHADERS ======================================================
+
+// Same as IrradianceSH() in Lighting.hlsli
+static XMFLOAT3 IrradianceSH(const XMFLOAT3 sh[IBL_SH_COEFFICIENTS], XMFLOAT3 n)
+{
+	XMFLOAT3 irradiance = Scale(sh[0], 0.282095f);
+	irradiance = Add(irradiance, Scale(sh[1], 0.488603f * n.y));
+	irradiance = Add(irradiance, Scale(sh[2], 0.488603f * n.z));
+	irradiance = Add(irradiance, Scale(sh[3], 0.488603f * n.x));
+	irradiance = Add(irradiance, Scale(sh[4], 1.092548f * n.x * n.y));
+	irradiance = Add(irradiance, Scale(sh[5], 1.092548f * n.y * n.z));
+	irradiance = Add(irradiance, Scale(sh[6], 0.315392f * (3.0f * n.z * n.z - 1.0f)));
+	irradiance = Add(irradiance, Scale(sh[7], 1.092548f * n.x * n.z));
+	irradiance = Add(irradiance, Scale(sh[8], 0.546274f * (n.x * n.x - n.y * n.y)));
+	return XMFLOAT3(fmaxf(irradiance.x, 0.0f), fmaxf(irradiance.y, 0.0f), fmaxf(irradiance.z, 0.0f));
+}
+
+// Same as IndirectPBR() in Lighting.hlsli
+static XMFLOAT3 IndirectPBR(const IBLData& ibl, const ShadingSample& sample, XMFLOAT3 camPos, XMFLOAT3 irradiance)
+{
+	XMFLOAT3 toCam = Normalize(Sub(camPos, sample.WorldPos));
+	float NdotV = Saturate(Dot(sample.Normal, toCam));
+
+	XMFLOAT3 reflection = Sub(Scale(toCam, -1.0f), Scale(sample.Normal, 2.0f * Dot(Scale(toCam, -1.0f), sample.Normal)));
+	XMFLOAT4 prefiltered = SampleIBLCubemapLevel(ibl.SpecularMips, reflection, sample.Roughness * (ibl.SpecularMips.size() - 1));
+	XMFLOAT2 brdf = SampleBRDFLookUp(ibl, NdotV, sample.Roughness);
+	XMFLOAT3 specularAmount = Add(Scale(sample.SpecularColor, brdf.x), XMFLOAT3(brdf.y, brdf.y, brdf.y));
+
+	XMFLOAT3 diffuse = Scale(Mul(Mul(irradiance, sample.SurfaceColor), Sub(XMFLOAT3(1, 1, 1), specularAmount)), 1.0f - sample.Metalness);
+	return Add(diffuse, Mul(XMFLOAT3(prefiltered.x, prefiltered.y, prefiltered.z), specularAmount));
+}
+
+// Gamma corrected 8-bit color, as a UNORM render target stores it
+static void StoreColor(XMFLOAT3 color, unsigned char* pixel)
+{
+	pixel[0] = (unsigned char)(Saturate(color.x) * 255.0f + 0.5f);
+	pixel[1] = (unsigned char)(Saturate(color.y) * 255.0f + 0.5f);
+	pixel[2] = (unsigned char)(Saturate(color.z) * 255.0f + 0.5f);
+	pixel[3] = 255;
+}
+
+
+// === RASTERIZER ===================================================
+
+SoftwareRasterizer::SoftwareRasterizer() :
+	stats(),
+	width(0),
+	height(0),
+	tilesX(0),
+	tilesY(0),
+	skyUnprojection()
+{
+}
+
+// --------------------------------------------------------
+// Renders every draw of the scene, then the sky behind them
+//
+// scene  - What to render
+// width  - Size of the image, in pixels
+// height
+// jobs   - System to spread the work across
+// image  - Receives the rendered frame
+// --------------------------------------------------------
+void SoftwareRasterizer::Render(const SoftwareScene& scene, unsigned int width, unsigned int height, JobSystem& jobs, TextureImage* image)
+{
+	PROFILE_FUNCTION();
+	auto frameStart = std::chrono::high_resolution_clock::now();
+
+	this->width = width;
+	this->height = height;
+	tilesX = (width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+	tilesY = (height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+	stats = SoftwareRenderStats();
+
+	image->Width = width;
+	image->Height = height;
+	image->Pixels.resize((size_t)width * height * 4);
+
+	// The sky is drawn without the view's translation, so any
+	// point on the far plane is a direction to sample
+	XMFLOAT4X4 viewNoTranslation = scene.View;
+	viewNoTranslation.m[3][0] = 0;
+	viewNoTranslation.m[3][1] = 0;
+	viewNoTranslation.m[3][2] = 0;
+	skyUnprojection = Inverse(Multiply(viewNoTranslation, scene.Projection));
+
+	directionalLights.clear();
+	for (auto& l : scene.Lights)
+	{
+		if (l.Type == LIGHT_TYPE_DIRECTIONAL)
+			directionalLights.push_back(&l);
+	}
+
+	// Vertices (and the lights that reach each draw)
+	unsigned int drawCount = (unsigned int)scene.Draws.size();
+	drawVertices.resize(drawCount);
+	drawTriangles.resize(drawCount);
+	drawLights.resize(drawCount);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	jobs.ParallelFor(drawCount, 1, [&](unsigned int first, unsigned int end)
+	{
+		for (unsigned int d = first; d < end; d++)
+			ShadeVertices(scene, d);
+	});
+	stats.VertexTime = MillisecondsSince(start);
+
+	// Triangles, kept in draw order
+	start = std::chrono::high_resolution_clock::now();
+	jobs.ParallelFor(drawCount, 1, [&](unsigned int first, unsigned int end)
+	{
+		for (unsigned int d = first; d < end; d++)
+			SetUpTriangles(scene, d);
+	});
+
+	triangles.clear();
+	for (unsigned int d = 0; d < drawCount; d++)
+	{
+		stats.Triangles += (unsigned int)scene.Meshes[scene.Draws[d].Mesh].Indices.size() / 3;
+		triangles.insert(triangles.end(), drawTriangles[d].begin(), drawTriangles[d].end());
+	}
+	stats.Rasterized = (unsigned int)triangles.size();
+	stats.SetupTime = MillisecondsSince(start);
+
+	// Tiles each triangle touches
+	start = std::chrono::high_resolution_clock::now();
+	tileBins.resize(tilesX * tilesY);
+	jobs.ParallelFor(tilesY, 1, [&](unsigned int first, unsigned int end) { BinTriangles(first, end); });
+	for (auto& bin : tileBins)
+		stats.Binned += (unsigned int)bin.size();
+	stats.BinTime = MillisecondsSince(start);
+
+	// Pixels
+	start = std::chrono::high_resolution_clock::now();
+	tileShadedPixels.assign(tilesX * tilesY, 0);
+	jobs.ParallelFor(tilesX * tilesY, 1, [&](unsigned int first, unsigned int end)
+	{
+		for (unsigned int t = first; t < end; t++)
+			RenderTile(scene, t, image);
+	});
+	for (unsigned int count : tileShadedPixels)
+		stats.ShadedPixels += count;
+	stats.TileTime = MillisecondsSince(start);
+
+	stats.TotalTime = MillisecondsSince(frameStart);
+}
+
+// --------------------------------------------------------
+// Runs the vertex shader on every vertex of a draw, and
+// finds the point and spot lights that can reach it
+// --------------------------------------------------------
+void SoftwareRasterizer::ShadeVertices(const SoftwareScene& scene, unsigned int draw)
+{
+	const SoftwareDraw& d = scene.Draws[draw];
+	const SoftwareMesh& mesh = scene.Meshes[d.Mesh];
+
+	// Same as VertexShader.hlsl
+	XMFLOAT4X4 worldViewProj = Multiply(Multiply(d.World, scene.View), scene.Projection);
+	std::vector<ShadedVertex>& vertices = drawVertices[draw];
+	vertices.resize(mesh.Vertices.size());
+	for (size_t i = 0; i < mesh.Vertices.size(); i++)
+	{
+		const Vertex& in = mesh.Vertices[i];
+		XMFLOAT4 position(in.Position.x, in.Position.y, in.Position.z, 1.0f);
+		XMFLOAT4 worldPos = Transform(position, d.World);
+
+		ShadedVertex& out = vertices[i];
+		out.Position = Transform(position, worldViewProj);
+		out.WorldPos = XMFLOAT3(worldPos.x, worldPos.y, worldPos.z);
+		out.Normal = Normalize(TransformNormal(in.Normal, d.WorldInverseTranspose));
+		out.Tangent = Normalize(TransformNormal(in.Tangent, d.World));
+		out.UV = in.UV;
+	}
+
+	// Bounds in world space, scaled by the largest axis
+	XMFLOAT4 local = mesh.BoundingSphere;
+	XMFLOAT4 center = Transform(XMFLOAT4(local.x, local.y, local.z, 1.0f), d.World);
+	float scale = 0.0f;
+	for (int r = 0; r < 3; r++)
+		scale = fmaxf(scale, sqrtf(d.World.m[r][0] * d.World.m[r][0] + d.World.m[r][1] * d.World.m[r][1] + d.World.m[r][2] * d.World.m[r][2]));
+	XMFLOAT4 sphere(center.x, center.y, center.z, local.w * scale);
+
+	std::vector<const Light*>& lights = drawLights[draw];
+	lights.clear();
+	for (auto& l : scene.Lights)
+	{
+		if (ScoreLight(l, sphere) > 0.0f)
+			lights.push_back(&l);
+	}
+}
+
+// --------------------------------------------------------
+// Clips each of a draw's triangles to the near plane and
+// the guard band, then projects, snaps and culls the pieces
+// --------------------------------------------------------
+void SoftwareRasterizer::SetUpTriangles(const SoftwareScene& scene, unsigned int draw)
+{
+	const SoftwareDraw& d = scene.Draws[draw];
+	const SoftwareMesh& mesh = scene.Meshes[d.Mesh];
+	XMFLOAT2 uvScale = scene.Materials[d.Material].UVScale;
+	const std::vector<ShadedVertex>& vertices = drawVertices[draw];
+	std::vector<Triangle>& output = drawTriangles[draw];
+	output.clear();
+
+	// Clip space planes, as (x, y, z, w) weights that must sum
+	// to zero or more
+	static const float planes[5][4] =
+	{
+		{ 0, 0, 1, 0 },						// Near
+		{ 1, 0, 0, SOFTWARE_GUARD_BAND },	// Left
+		{ -1, 0, 0, SOFTWARE_GUARD_BAND },	// Right
+		{ 0, 1, 0, SOFTWARE_GUARD_BAND },	// Bottom
+		{ 0, -1, 0, SOFTWARE_GUARD_BAND },	// Top
+	};
+
+	for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3)
+	{
+		ShadedVertex polygon[SOFTWARE_MAX_CLIPPED_VERTICES];
+		polygon[0] = vertices[mesh.Indices[i]];
+		polygon[1] = vertices[mesh.Indices[i + 1]];
+		polygon[2] = vertices[mesh.Indices[i + 2]];
+		unsigned int count = 3;
+
+		// Only clip when some vertex is actually outside
+		for (int p = 0; p < 5 && count >= 3; p++)
+		{
+			float distances[SOFTWARE_MAX_CLIPPED_VERTICES];
+			bool anyOutside = false;
+			for (unsigned int v = 0; v < count; v++)
+			{
+				const XMFLOAT4& pos = polygon[v].Position;
+				distances[v] = pos.x * planes[p][0] + pos.y * planes[p][1] + pos.z * planes[p][2] + pos.w * planes[p][3];
+				anyOutside |= distances[v] < 0.0f;
+			}
+			if (!anyOutside)
+				continue;
+
+			// Keep the inside vertices, and add one wherever an
+			// edge crosses the plane
+			ShadedVertex clipped[SOFTWARE_MAX_CLIPPED_VERTICES];
+			unsigned int clippedCount = 0;
+			for (unsigned int v = 0; v < count; v++)
+			{
+				unsigned int next = (v + 1) % count;
+				if (distances[v] >= 0.0f)
+					clipped[clippedCount++] = polygon[v];
+				if ((distances[v] >= 0.0f) != (distances[next] >= 0.0f) && clippedCount < SOFTWARE_MAX_CLIPPED_VERTICES)
+				{
+					float t = distances[v] / (distances[v] - distances[next]);
+					const ShadedVertex& a = polygon[v];
+					const ShadedVertex& b = polygon[next];
+					ShadedVertex& c = clipped[clippedCount++];
+					const float* fa = &a.Position.x;
+					const float* fb = &b.Position.x;
+					float* fc = &c.Position.x;
+					for (size_t f = 0; f < sizeof(ShadedVertex) / sizeof(float); f++)
+						fc[f] = Lerp(fa[f], fb[f], t);
+				}
+			}
+
+			memcpy(polygon, clipped, sizeof(ShadedVertex) * clippedCount);
+			count = clippedCount;
+		}
+
+		// Back into triangles, as a fan
+		for (unsigned int v = 1; v + 1 < count; v++)
+		{
+			ShadedVertex triangle[3] = { polygon[0], polygon[v], polygon[v + 1] };
+			AddTriangle(triangle, 3, draw, uvScale, &output);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Projects and snaps a triangle that's already clipped,
+// keeping it if it faces the camera and covers any pixel
+// --------------------------------------------------------
+void SoftwareRasterizer::AddTriangle(const ShadedVertex* vertices, unsigned int count, unsigned int draw, XMFLOAT2 uvScale, std::vector<Triangle>* output)
+{
+	Triangle t;
+	for (unsigned int v = 0; v < count; v++)
+	{
+		const XMFLOAT4& pos = vertices[v].Position;
+		float invW = 1.0f / pos.w;
+		float screenX = (pos.x * invW * 0.5f + 0.5f) * width;
+		float screenY = (0.5f - pos.y * invW * 0.5f) * height;
+
+		t.Vertices[v] = vertices[v];
+		t.X[v] = (int)floorf(screenX * SOFTWARE_SUBPIXEL_SCALE + 0.5f);
+		t.Y[v] = (int)floorf(screenY * SOFTWARE_SUBPIXEL_SCALE + 0.5f);
+		t.Z[v] = pos.z * invW;
+		t.InvW[v] = invW;
+	}
+
+	// Clockwise (on screen) is the front, as D3D's default
+	t.Area = (long long)(t.X[1] - t.X[0]) * (t.Y[2] - t.Y[0]) - (long long)(t.Y[1] - t.Y[0]) * (t.X[2] - t.X[0]);
+	if (t.Area <= 0)
+		return;
+
+	// Pixels whose centers could be inside, within the screen
+	int minX = (std::min)(t.X[0], (std::min)(t.X[1], t.X[2]));
+	int minY = (std::min)(t.Y[0], (std::min)(t.Y[1], t.Y[2]));
+	int maxX = (std::max)(t.X[0], (std::max)(t.X[1], t.X[2]));
+	int maxY = (std::max)(t.Y[0], (std::max)(t.Y[1], t.Y[2]));
+	int half = SOFTWARE_SUBPIXEL_SCALE / 2;
+	t.MinX = (std::max)(-FloorDivide(half - minX, SOFTWARE_SUBPIXEL_SCALE), 0);
+	t.MinY = (std::max)(-FloorDivide(half - minY, SOFTWARE_SUBPIXEL_SCALE), 0);
+	t.MaxX = (std::min)(FloorDivide(maxX - half, SOFTWARE_SUBPIXEL_SCALE), (int)width - 1);
+	t.MaxY = (std::min)(FloorDivide(maxY - half, SOFTWARE_SUBPIXEL_SCALE), (int)height - 1);
+	if (t.MinX > t.MaxX || t.MinY > t.MaxY)
+		return;
+
+	// Texels per pixel for a 1x1 texture, as a mip level
+	const XMFLOAT2& uv0 = vertices[0].UV;
+	const XMFLOAT2& uv1 = vertices[1].UV;
+	const XMFLOAT2& uv2 = vertices[2].UV;
+	float uvArea = fabsf(((uv1.x - uv0.x) * (uv2.y - uv0.y) - (uv2.x - uv0.x) * (uv1.y - uv0.y)) * uvScale.x * uvScale.y);
+	float pixelArea = (float)t.Area / (SOFTWARE_SUBPIXEL_SCALE * SOFTWARE_SUBPIXEL_SCALE);
+	t.LODBias = uvArea > 0.0f ? 0.5f * log2f(uvArea / pixelArea) : 0.0f;
+
+	t.Draw = draw;
+	output->push_back(t);
+}
+
+// --------------------------------------------------------
+// Adds every triangle to the bins of the tiles it touches,
+// for a range of tile rows
+// --------------------------------------------------------
+void SoftwareRasterizer::BinTriangles(unsigned int firstRow, unsigned int endRow)
+{
+	for (unsigned int row = firstRow; row < endRow; row++)
+		for (unsigned int x = 0; x < tilesX; x++)
+			tileBins[row * tilesX + x].clear();
+
+	for (unsigned int i = 0; i < (unsigned int)triangles.size(); i++)
+	{
+		const Triangle& t = triangles[i];
+		unsigned int top = (std::max)((unsigned int)t.MinY / SOFTWARE_TILE_SIZE, firstRow);
+		unsigned int bottom = (std::min)((unsigned int)t.MaxY / SOFTWARE_TILE_SIZE + 1, endRow);
+		unsigned int left = (unsigned int)t.MinX / SOFTWARE_TILE_SIZE;
+		unsigned int right = (unsigned int)t.MaxX / SOFTWARE_TILE_SIZE;
+		for (unsigned int row = top; row < bottom; row++)
+			for (unsigned int x = left; x <= right; x++)
+				tileBins[row * tilesX + x].push_back(i);
+	}
+}
+
+// --------------------------------------------------------
+// Finds the closest triangle at each pixel of a tile, then
+// shades each pixel once (or draws the sky behind it)
+// --------------------------------------------------------
+void SoftwareRasterizer::RenderTile(const SoftwareScene& scene, unsigned int tile, TextureImage* image)
+{
+	int tileX = (int)(tile % tilesX) * SOFTWARE_TILE_SIZE;
+	int tileY = (int)(tile / tilesX) * SOFTWARE_TILE_SIZE;
+	int tileWidth = (std::min)(SOFTWARE_TILE_SIZE, (int)width - tileX);
+	int tileHeight = (std::min)(SOFTWARE_TILE_SIZE, (int)height - tileY);
+
+	float depth[SOFTWARE_TILE_SIZE * SOFTWARE_TILE_SIZE];
+	unsigned int closest[SOFTWARE_TILE_SIZE * SOFTWARE_TILE_SIZE];
+	for (int i = 0; i < SOFTWARE_TILE_SIZE * SOFTWARE_TILE_SIZE; i++)
+	{
+		depth[i] = 1.0f;
+		closest[i] = SOFTWARE_NO_TRIANGLE;
+	}
+
+	// Edge functions, each giving the weight of the vertex
+	// opposite the edge.  Pixels exactly on an edge belong to
+	// it only if it's a top or left edge.
+	static const int edgeStart[3] = { 1, 2, 0 };
+	static const int edgeEnd[3] = { 2, 0, 1 };
+	auto edgeBias = [](const Triangle& t, int e)
+	{
+		int dx = t.X[edgeEnd[e]] - t.X[edgeStart[e]];
+		int dy = t.Y[edgeEnd[e]] - t.Y[edgeStart[e]];
+		return (dy == 0 && dx > 0) || dy < 0 ? 0 : -1;
+	};
+	auto edgeValue = [](const Triangle& t, int e, long long x, long long y)
+	{
+		int a = edgeStart[e];
+		int b = edgeEnd[e];
+		return (long long)(t.X[b] - t.X[a]) * (y - t.Y[a]) - (long long)(t.Y[b] - t.Y[a]) * (x - t.X[a]);
+	};
+	int half = SOFTWARE_SUBPIXEL_SCALE / 2;
+
+	// Depth pass, in draw order
+	for (unsigned int index : tileBins[tile])
+	{
+		const Triangle& t = triangles[index];
+		int startX = (std::max)(t.MinX, tileX);
+		int endX = (std::min)(t.MaxX, tileX + tileWidth - 1);
+		int startY = (std::max)(t.MinY, tileY);
+		int endY = (std::min)(t.MaxY, tileY + tileHeight - 1);
+		if (startX > endX || startY > endY)
+			continue;
+
+		long long bias[3];
+		long long stepX[3];
+		for (int e = 0; e < 3; e++)
+		{
+			bias[e] = edgeBias(t, e);
+			stepX[e] = -(long long)(t.Y[edgeEnd[e]] - t.Y[edgeStart[e]]) * SOFTWARE_SUBPIXEL_SCALE;
+		}
+		float invArea = 1.0f / (float)t.Area;
+
+		for (int y = startY; y <= endY; y++)
+		{
+			long long sampleY = (long long)y * SOFTWARE_SUBPIXEL_SCALE + half;
+			long long sampleX = (long long)startX * SOFTWARE_SUBPIXEL_SCALE + half;
+			long long edges[3];
+			for (int e = 0; e < 3; e++)
+				edges[e] = edgeValue(t, e, sampleX, sampleY);
+
+			for (int x = startX; x <= endX; x++)
+			{
+				if (edges[0] + bias[0] >= 0 && edges[1] + bias[1] >= 0 && edges[2] + bias[2] >= 0)
+				{
+					float z =
+						(float)edges[0] * invArea * t.Z[0] +
+						(float)edges[1] * invArea * t.Z[1] +
+						(float)edges[2] * invArea * t.Z[2];
+
+					int pixel = (y - tileY) * SOFTWARE_TILE_SIZE + (x - tileX);
+					if (z < depth[pixel] && z <= 1.0f)
+					{
+						depth[pixel] = z;
+						closest[pixel] = index;
+					}
+				}
+
+				for (int e = 0; e < 3; e++)
+					edges[e] += stepX[e];
+			}
+		}
+	}
+
+	// Shading pass
+	unsigned int shaded = 0;
+	bool hasIBL = scene.IBLIntensity > 0.0f && !scene.IBL.SpecularMips.empty() && scene.IBL.BRDFLUTSize > 0;
+	for (int y = 0; y < tileHeight; y++)
+	{
+		for (int x = 0; x < tileWidth; x++)
+		{
+			int px = tileX + x;
+			int py = tileY + y;
+			unsigned char* out = &image->Pixels[((size_t)py * width + px) * 4];
+			unsigned int index = closest[y * SOFTWARE_TILE_SIZE + x];
+
+			// Sky, which is on the far plane
+			if (index == SOFTWARE_NO_TRIANGLE)
+			{
+				if (scene.Sky.Size == 0)
+				{
+					StoreColor(XMFLOAT3(0, 0, 0), out);
+					continue;
+				}
+
+				float ndcX = (px + 0.5f) / width * 2.0f - 1.0f;
+				float ndcY = 1.0f - (py + 0.5f) / height * 2.0f;
+				XMFLOAT4 far = Transform(XMFLOAT4(ndcX, ndcY, 1.0f, 1.0f), skyUnprojection);
+				XMFLOAT4 sky = SampleIBLCubemap(scene.Sky, XMFLOAT3(far.x / far.w, far.y / far.w, far.z / far.w));
+				StoreColor(Pow(XMFLOAT3(sky.x, sky.y, sky.z), 1.0f / 2.2f), out);
+				continue;
+			}
+
+			// Perspective correct weights of each vertex
+			const Triangle& t = triangles[index];
+			long long sampleX = (long long)px * SOFTWARE_SUBPIXEL_SCALE + half;
+			long long sampleY = (long long)py * SOFTWARE_SUBPIXEL_SCALE + half;
+			float weights[3];
+			float weightSum = 0.0f;
+			for (int e = 0; e < 3; e++)
+			{
+				weights[e] = (float)edgeValue(t, e, sampleX, sampleY) / (float)t.Area * t.InvW[e];
+				weightSum += weights[e];
+			}
+
+			ShadedVertex in;
+			float* fin = &in.Position.x;
+			const float* f0 = &t.Vertices[0].Position.x;
+			const float* f1 = &t.Vertices[1].Position.x;
+			const float* f2 = &t.Vertices[2].Position.x;
+			for (size_t f = 0; f < sizeof(ShadedVertex) / sizeof(float); f++)
+				fin[f] = (f0[f] * weights[0] + f1[f] * weights[1] + f2[f] * weights[2]) / weightSum;
+
+			// Same as PixelShaderPBR.hlsl
+			const SoftwareMaterial& material = scene.Materials[scene.Draws[t.Draw].Material];
+			XMFLOAT3 normal = Normalize(in.Normal);
+			XMFLOAT3 tangent = Normalize(in.Tangent);
+			XMFLOAT2 uv(in.UV.x * material.UVScale.x + material.UVOffset.x, in.UV.y * material.UVScale.y + material.UVOffset.y);
+
+			if (material.NormalMap >= 0)
+			{
+				XMFLOAT4 mapped = SampleTexture(scene.Textures[material.NormalMap], uv, t.LODBias);
+				float nx = mapped.x * 2.0f - 1.0f;
+				float ny = mapped.y * 2.0f - 1.0f;
+				float nz = sqrtf(Saturate(1.0f - nx * nx - ny * ny));
+
+				XMFLOAT3 T = Normalize(Sub(tangent, Scale(normal, Dot(tangent, normal))));
+				XMFLOAT3 B = Cross(T, normal);
+				normal = Normalize(Add(Add(Scale(T, nx), Scale(B, ny)), Scale(normal, nz)));
+			}
+
+			float roughness = 1.0f;
+			float metal = 0.0f;
+			if (material.RoughnessMetalMap >= 0)
+			{
+				XMFLOAT4 roughnessMetal = SampleTexture(scene.Textures[material.RoughnessMetalMap], uv, t.LODBias);
+				roughness = roughnessMetal.x;
+				metal = roughnessMetal.y;
+			}
+
+			XMFLOAT3 surfaceColor(1, 1, 1);
+			if (material.Albedo >= 0)
+			{
+				XMFLOAT4 albedo = SampleTexture(scene.Textures[material.Albedo], uv, t.LODBias);
+				surfaceColor = Pow(XMFLOAT3(albedo.x, albedo.y, albedo.z), 2.2f);
+			}
+			surfaceColor = Mul(surfaceColor, material.ColorTint);
+
+			ShadingSample sample;
+			sample.Normal = normal;
+			sample.WorldPos = in.WorldPos;
+			sample.Roughness = roughness;
+			sample.Metalness = metal;
+			sample.SurfaceColor = surfaceColor;
+			sample.SpecularColor = XMFLOAT3(
+				Lerp(LIGHTING_F0_NON_METAL, surfaceColor.x, metal),
+				Lerp(LIGHTING_F0_NON_METAL, surfaceColor.y, metal),
+				Lerp(LIGHTING_F0_NON_METAL, surfaceColor.z, metal));
+
+			XMFLOAT3 total(0, 0, 0);
+			for (const Light* light : directionalLights)
+				total = Add(total, DirLightPBRScalar(*light, sample, scene.CameraPosition));
+
+			for (const Light* light : drawLights[t.Draw])
+			{
+				if (light->Type == LIGHT_TYPE_POINT)
+					total = Add(total, PointLightPBRScalar(*light, sample, scene.CameraPosition));
+				else
+					total = Add(total, SpotLightPBRScalar(*light, sample, scene.CameraPosition));
+			}
+
+			if (hasIBL)
+			{
+				XMFLOAT3 irradiance = IrradianceSH(scene.IBL.IrradianceSH, normal);
+				total = Add(total, Scale(IndirectPBR(scene.IBL, sample, scene.CameraPosition, irradiance), scene.IBLIntensity));
+			}
+
+			StoreColor(Pow(total, 1.0f / 2.2f), out);
+			shaded++;
+		}
+	}
+
+	tileShadedPixels[tile] = shaded;
+}
+
+
+// === TEST SCENE ===================================================
+
+// --------------------------------------------------------
+// A sphere of radius 0.5 (like sphere.obj), with u around
+// and v down, wound clockwise from outside
+// --------------------------------------------------------
+static void MakeSphere(unsigned int slices, unsigned int stacks, SoftwareMesh* mesh)
+{
+	const float pi = LIGHTING_PI;
+	for (unsigned int i = 0; i <= stacks; i++)
+	{
+		float theta = pi * i / stacks;
+		for (unsigned int j = 0; j <= slices; j++)
+		{
+			float phi = 2.0f * pi * j / slices;
+			XMFLOAT3 normal(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+
+			Vertex v;
+			v.Position = Scale(normal, 0.5f);
+			v.Normal = normal;
+			v.Tangent = XMFLOAT3(-sinf(phi), 0, cosf(phi));
+			v.UV = XMFLOAT2((float)j / slices, (float)i / stacks);
+			mesh->Vertices.push_back(v);
+		}
+	}
+
+	for (unsigned int i = 0; i < stacks; i++)
+	{
+		for (unsigned int j = 0; j < slices; j++)
+		{
+			unsigned int a = i * (slices + 1) + j;
+			unsigned int b = a + slices + 1;
+			unsigned int quad[6] = { a, a + 1, b, a + 1, b + 1, b };
+			mesh->Indices.insert(mesh->Indices.end(), quad, quad + 6);
+		}
+	}
+
+	mesh->BoundingSphere = XMFLOAT4(0, 0, 0, 0.5f);
+}
+
+// --------------------------------------------------------
+// A 1x1 square facing up, wound clockwise from above
+// --------------------------------------------------------
+static void MakeFloor(SoftwareMesh* mesh)
+{
+	const float corners[4][2] = { { -0.5f, -0.5f }, { -0.5f, 0.5f }, { 0.5f, 0.5f }, { 0.5f, -0.5f } };
+	for (int c = 0; c < 4; c++)
+	{
+		Vertex v;
+		v.Position = XMFLOAT3(corners[c][0], 0, corners[c][1]);
+		v.Normal = XMFLOAT3(0, 1, 0);
+		v.Tangent = XMFLOAT3(1, 0, 0);
+		v.UV = XMFLOAT2(corners[c][0] + 0.5f, 0.5f - corners[c][1]);
+		mesh->Vertices.push_back(v);
+	}
+
+	unsigned int indices[6] = { 0, 1, 2, 0, 2, 3 };
+	mesh->Indices.assign(indices, indices + 6);
+	mesh->BoundingSphere = XMFLOAT4(0, 0, 0, 0.7072f);
+}
+
+// Makes a texture's mip chain, filtered for how it's used
+static int AddTexture(const TextureImage& image, unsigned int format, SoftwareScene* scene)
+{
+	SoftwareTexture texture;
+	GenerateMipChain(image, format, &texture.Mips);
+	scene->Textures.push_back(texture);
+	return (int)scene->Textures.size() - 1;
+}
+
+static XMFLOAT4X4 ScaleTranslation(float scale, XMFLOAT3 position)
+{
+	XMFLOAT4X4 m = {};
+	m.m[0][0] = m.m[1][1] = m.m[2][2] = scale;
+	m.m[3][0] = position.x;
+	m.m[3][1] = position.y;
+	m.m[3][2] = position.z;
+	m.m[3][3] = 1.0f;
+	return m;
+}
+
+// --------------------------------------------------------
+// Fills in a grid of spheres, each with its own roughness
+// and metalness, above a floor and under a gradient sky
+//
+// gridSize    - Spheres along each side of the grid
+// aspectRatio - Of the images the scene will be rendered to
+// scene       - Receives the scene (which is cleared first)
+// --------------------------------------------------------
+void BuildSoftwareTestScene(unsigned int gridSize, float aspectRatio, SoftwareScene* scene)
+{
+	*scene = SoftwareScene();
+	SoftwareMesh sphere, floor;
+	MakeSphere(32, 16, &sphere);
+	MakeFloor(&floor);
+	scene->Meshes.push_back(sphere);
+	scene->Meshes.push_back(floor);
+
+	// Checkered albedo in a few colors
+	const unsigned int size = 64;
+	const unsigned char colors[4][3] = { { 200, 60, 50 }, { 60, 160, 70 }, { 50, 90, 200 }, { 220, 200, 150 } };
+	int albedo[4];
+	for (int c = 0; c < 4; c++)
+	{
+		TextureImage image;
+		image.Width = image.Height = size;
+		image.Pixels.resize(size * size * 4);
+		for (unsigned int y = 0; y < size; y++)
+		{
+			for (unsigned int x = 0; x < size; x++)
+			{
+				bool light = ((x / 8) + (y / 8)) % 2 == 0;
+				unsigned char* p = &image.Pixels[(y * size + x) * 4];
+				for (int i = 0; i < 3; i++)
+					p[i] = (unsigned char)(light ? colors[c][i] : colors[c][i] / 2);
+				p[3] = 255;
+			}
+		}
+		albedo[c] = AddTexture(image, TEXTURE_COOK_BC7, scene);
+	}
+
+	// Rows of bumps, as tangent space normals
+	TextureImage bumps;
+	bumps.Width = bumps.Height = size;
+	bumps.Pixels.resize(size * size * 4);
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			float nx = 0.4f * sinf(2.0f * LIGHTING_PI * x / 16.0f);
+			float ny = 0.4f * sinf(2.0f * LIGHTING_PI * y / 16.0f);
+			unsigned char* p = &bumps.Pixels[(y * size + x) * 4];
+			p[0] = (unsigned char)((nx * 0.5f + 0.5f) * 255.0f + 0.5f);
+			p[1] = (unsigned char)((ny * 0.5f + 0.5f) * 255.0f + 0.5f);
+			p[2] = 255;
+			p[3] = 255;
+		}
+	}
+	int normalMap = AddTexture(bumps, TEXTURE_COOK_BC5, scene);
+
+	// Roughness across the grid, metals on every other row
+	std::vector<int> roughnessMetal(gridSize * 2);
+	for (unsigned int i = 0; i < gridSize * 2; i++)
+	{
+		TextureImage image;
+		image.Width = image.Height = 4;
+		image.Pixels.resize(4 * 4 * 4);
+		for (unsigned int p = 0; p < 16; p++)
+		{
+			image.Pixels[p * 4 + 0] = (unsigned char)(255.0f * ((i / 2) + 0.5f) / gridSize);
+			image.Pixels[p * 4 + 1] = i % 2 ? 255 : 0;
+			image.Pixels[p * 4 + 2] = 0;
+			image.Pixels[p * 4 + 3] = 255;
+		}
+		roughnessMetal[i] = AddTexture(image, TEXTURE_COOK_BC5_LINEAR, scene);
+	}
+
+	// A sphere per material, one unit apart
+	float extent = (float)gridSize;
+	for (unsigned int row = 0; row < gridSize; row++)
+	{
+		for (unsigned int column = 0; column < gridSize; column++)
+		{
+			SoftwareMaterial material;
+			material.ColorTint = XMFLOAT3(1, 1, 1);
+			material.UVScale = XMFLOAT2(2, 1);
+			material.UVOffset = XMFLOAT2(0, 0);
+			material.Albedo = albedo[(row + column) % 4];
+			material.NormalMap = normalMap;
+			material.RoughnessMetalMap = roughnessMetal[column * 2 + row % 2];
+			scene->Materials.push_back(material);
+
+			SoftwareDraw draw;
+			draw.Mesh = 0;
+			draw.Material = (unsigned int)scene->Materials.size() - 1;
+			draw.World = ScaleTranslation(0.8f, XMFLOAT3(column - extent * 0.5f + 0.5f, 0.4f, row - extent * 0.5f + 0.5f));
+			draw.WorldInverseTranspose = ScaleTranslation(1.0f / 0.8f, XMFLOAT3(0, 0, 0));
+			scene->Draws.push_back(draw);
+		}
+	}
+
+	SoftwareMaterial floorMaterial = { XMFLOAT3(0.6f, 0.6f, 0.6f), XMFLOAT2(extent, extent), XMFLOAT2(0, 0), albedo[3], normalMap, -1 };
+	scene->Materials.push_back(floorMaterial);
+	SoftwareDraw floorDraw;
+	floorDraw.Mesh = 1;
+	floorDraw.Material = (unsigned int)scene->Materials.size() - 1;
+	floorDraw.World = ScaleTranslation(extent + 2.0f, XMFLOAT3(0, 0, 0));
+	floorDraw.WorldInverseTranspose = ScaleTranslation(1.0f / (extent + 2.0f), XMFLOAT3(0, 0, 0));
+	scene->Draws.push_back(floorDraw);
+
+	// A sun, and a colored point light over every other sphere
+	Light sun = {};
+	sun.Type = LIGHT_TYPE_DIRECTIONAL;
+	sun.Direction = Normalize(XMFLOAT3(1, -1, 1));
+	sun.Color = XMFLOAT3(1, 1, 1);
+	sun.Intensity = 1.0f;
+	scene->Lights.push_back(sun);
+
+	for (unsigned int i = 0; i < gridSize * gridSize; i += 2)
+	{
+		Light point = {};
+		point.Type = LIGHT_TYPE_POINT;
+		point.Position = XMFLOAT3((i % gridSize) - extent * 0.5f + 0.5f, 1.5f, (i / gridSize) - extent * 0.5f + 0.5f);
+		point.Range = 2.5f;
+		point.Color = XMFLOAT3(colors[i % 4][0] / 255.0f, colors[i % 4][1] / 255.0f, colors[i % 4][2] / 255.0f);
+		point.Intensity = 2.0f;
+		scene->Lights.push_back(point);
+	}
+
+	// Camera above the front of the grid, looking across it
+	// with a little sky above the far edge
+	XMFLOAT3 eye(0, extent * 0.35f + 1.0f, -extent * 1.1f - 1.0f);
+	XMFLOAT3 forward = Normalize(Sub(XMFLOAT3(0, 0.5f, 0), eye));
+	XMFLOAT3 right = Normalize(Cross(XMFLOAT3(0, 1, 0), forward));
+	XMFLOAT3 up = Cross(forward, right);
+	XMFLOAT4X4 view = {};
+	view.m[0][0] = right.x; view.m[0][1] = up.x; view.m[0][2] = forward.x;
+	view.m[1][0] = right.y; view.m[1][1] = up.y; view.m[1][2] = forward.y;
+	view.m[2][0] = right.z; view.m[2][1] = up.z; view.m[2][2] = forward.z;
+	view.m[3][0] = -Dot(right, eye);
+	view.m[3][1] = -Dot(up, eye);
+	view.m[3][2] = -Dot(forward, eye);
+	view.m[3][3] = 1.0f;
+	scene->View = view;
+	scene->CameraPosition = eye;
+
+	// Left handed perspective, depth from 0 (near) to 1 (far)
+	float nearClip = 0.1f;
+	float farClip = 100.0f;
+	float yScale = 1.0f / tanf(LIGHTING_PI / 8.0f);
+	XMFLOAT4X4 projection = {};
+	projection.m[0][0] = yScale / aspectRatio;
+	projection.m[1][1] = yScale;
+	projection.m[2][2] = farClip / (farClip - nearClip);
+	projection.m[2][3] = 1.0f;
+	projection.m[3][2] = -nearClip * farClip / (farClip - nearClip);
+	scene->Projection = projection;
+
+	// Sky fading from a bright horizon to blue overhead, over
+	// dark ground
+	IBLCubemap& sky = scene->Sky;
+	sky.Size = 32;
+	sky.Texels.resize(6 * sky.Size * sky.Size);
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int y = 0; y < sky.Size; y++)
+		{
+			for (unsigned int x = 0; x < sky.Size; x++)
+			{
+				// Height of the texel's direction, from the face's layout
+				float s = (x + 0.5f) / sky.Size * 2.0f - 1.0f;
+				float t = (y + 0.5f) / sky.Size * 2.0f - 1.0f;
+				XMFLOAT3 dir;
+				switch (face)
+				{
+				case 0: dir = XMFLOAT3(1, -t, -s); break;
+				case 1: dir = XMFLOAT3(-1, -t, s); break;
+				case 2: dir = XMFLOAT3(s, 1, t); break;
+				case 3: dir = XMFLOAT3(s, -1, -t); break;
+				case 4: dir = XMFLOAT3(s, -t, 1); break;
+				default: dir = XMFLOAT3(-s, -t, -1); break;
+				}
+				float height = Normalize(dir).y;
+
+				XMFLOAT4 color = height >= 0.0f ?
+					XMFLOAT4(Lerp(0.9f, 0.15f, height), Lerp(0.9f, 0.35f, height), Lerp(0.95f, 0.8f, height), 1.0f) :
+					XMFLOAT4(0.15f, 0.12f, 0.1f, 1.0f);
+				sky.Texels[(face * sky.Size + y) * sky.Size + x] = color;
+			}
+		}
+	}
+
+	// Image based lighting, at low resolution
+	IBLBakeSettings settings;
+	settings.SpecularSize = 16;
+	settings.SpecularMipCount = 3;
+	settings.SpecularSamples = 16;
+	settings.BRDFLUTSize = 32;
+	settings.BRDFSamples = 64;
+	BakeIBL(sky, settings, &scene->IBL);
+	scene->IBLIntensity = 1.0f;
+}
+
+
+// === IMAGES =======================================================
+
+// --------------------------------------------------------
+// Writes an image as a binary PPM file
+// --------------------------------------------------------
+void SerializeSoftwareImage(const TextureImage& image, std::vector<unsigned char>& bytes)
+{
+	char header[64];
+	int headerSize = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", image.Width, image.Height);
+
+	bytes.resize(headerSize + (size_t)image.Width * image.Height * 3);
+	memcpy(&bytes[0], header, headerSize);
+	unsigned char* rgb = &bytes[headerSize];
+	for (size_t p = 0; p < (size_t)image.Width * image.Height; p++)
+	{
+		rgb[p * 3 + 0] = image.Pixels[p * 4 + 0];
+		rgb[p * 3 + 1] = image.Pixels[p * 4 + 1];
+		rgb[p * 3 + 2] = image.Pixels[p * 4 + 2];
+	}
+}
+
+// --------------------------------------------------------
+// Reads a binary PPM file with 8-bit channels (skipping
+// any comments), failing if it's anything else
+// --------------------------------------------------------
+bool DeserializeSoftwareImage(const unsigned char* bytes, size_t size, TextureImage* image)
+{
+	if (size < 2 || bytes[0] != 'P' || bytes[1] != '6')
+		return false;
+
+	// Width, height and the largest value, separated by
+	// whitespace (or comments)
+	size_t position = 2;
+	unsigned int values[3];
+	for (int v = 0; v < 3; v++)
+	{
+		while (position < size && (isspace(bytes[position]) || bytes[position] == '#'))
+		{
+			if (bytes[position] == '#')
+			{
+				while (position < size && bytes[position] != '\n')
+					position++;
+			}
+			else
+			{
+				position++;
+			}
+		}
+
+		if (position >= size || !isdigit(bytes[position]))
+			return false;
+		values[v] = 0;
+		while (position < size && isdigit(bytes[position]) && values[v] < 100000)
+			values[v] = values[v] * 10 + (bytes[position++] - '0');
+	}
+
+	// A single whitespace character before the pixels
+	position++;
+	size_t pixelCount = (size_t)values[0] * values[1];
+	if (values[2] != 255 || position > size || size - position < pixelCount * 3)
+		return false;
+
+	image->Width = values[0];
+	image->Height = values[1];
+	image->Pixels.resize(pixelCount * 4);
+	for (size_t p = 0; p < pixelCount; p++)
+	{
+		image->Pixels[p * 4 + 0] = bytes[position + p * 3 + 0];
+		image->Pixels[p * 4 + 1] = bytes[position + p * 3 + 1];
+		image->Pixels[p * 4 + 2] = bytes[position + p * 3 + 2];
+		image->Pixels[p * 4 + 3] = 255;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Compares two images pixel by pixel
+//
+// tolerance - Largest difference in any channel that still
+//             counts as the same
+// --------------------------------------------------------
+SoftwareImageDifference CompareSoftwareImages(const TextureImage& a, const TextureImage& b, unsigned int tolerance)
+{
+	SoftwareImageDifference difference = {};
+	difference.SameSize = a.Width == b.Width && a.Height == b.Height &&
+		a.Pixels.size() == b.Pixels.size() && a.Pixels.size() == (size_t)a.Width * a.Height * 4;
+	if (!difference.SameSize)
+		return difference;
+
+	for (size_t p = 0; p < (size_t)a.Width * a.Height; p++)
+	{
+		unsigned int pixelDifference = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			int d = (int)a.Pixels[p * 4 + c] - (int)b.Pixels[p * 4 + c];
+			pixelDifference = (std::max)(pixelDifference, (unsigned int)(d < 0 ? -d : d));
+		}
+
+		difference.MaxDifference = (std::max)(difference.MaxDifference, pixelDifference);
+		if (pixelDifference > tolerance)
+			difference.DifferentPixels++;
+	}
+	return difference;
+}
+
+
+// === BENCHMARK ====================================================
+
+// --------------------------------------------------------
+// Renders the scene at a few 16:9 resolutions, timing each
+// on the given jobs and on one thread, and checking both
+// give exactly the same image
+//
+// jobs    - System to render with
+// scene   - What to render
+// frames  - Frames to average each time over
+// timings - Receives one timing per resolution
+// --------------------------------------------------------
+void RunSoftwareRasterizerBenchmark(JobSystem& jobs, const SoftwareScene& scene, unsigned int frames, std::vector<SoftwareRasterizerTiming>* timings)
+{
+	timings->clear();
+	frames = (std::max)(frames, 1u);
+
+	const unsigned int resolutions[][2] = { { 320, 180 }, { 640, 360 }, { 1280, 720 }, { 1920, 1080 } };
+	SoftwareRasterizer rasterizer;
+	JobSystem singleThread(0);
+	for (auto& r : resolutions)
+	{
+		SoftwareRasterizerTiming timing = {};
+		timing.Width = r[0];
+		timing.Height = r[1];
+
+		TextureImage threaded, single;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int f = 0; f < frames; f++)
+			rasterizer.Render(scene, r[0], r[1], jobs, &threaded);
+		timing.Time = MillisecondsSince(start) / frames;
+		timing.Triangles = rasterizer.GetStats().Rasterized;
+
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int f = 0; f < frames; f++)
+			rasterizer.Render(scene, r[0], r[1], singleThread, &single);
+		timing.SingleThreadTime = MillisecondsSince(start) / frames;
+
+		timing.Deterministic = threaded.Pixels == single.Pixels;
+		timings->push_back(timing);
+	}
+}
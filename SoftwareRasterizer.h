@@ -0,0 +1,233 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Vertex.h"
+#include "Lights.h"
+#include "IBLBaker.h"
+#include "TextureCooker.h"
+#include "JobSystem.h"
+
+// Screen space tiles, each rasterized and shaded by one job
+#define SOFTWARE_TILE_SIZE		64
+
+// Vertex positions are snapped to this many bits of sub-pixel
+// precision, matching D3D's rasterization rules
+#define SOFTWARE_SUBPIXEL_BITS	8
+
+// Triangles are clipped to the near plane and to this many
+// screen widths (and heights) around the screen, which keeps
+// snapped coordinates well within range
+#define SOFTWARE_GUARD_BAND		16.0f
+
+// --------------------------------------------------------
+// A texture and its full mip chain, filtered the same way
+// the GPU version is cooked (see GenerateMipChain())
+// --------------------------------------------------------
+struct SoftwareTexture
+{
+	std::vector<TextureImage> Mips;
+};
+
+// --------------------------------------------------------
+// Triangle list geometry, and a sphere around it (in local
+// space) for choosing the lights that can reach it
+// --------------------------------------------------------
+struct SoftwareMesh
+{
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;
+	DirectX::XMFLOAT4 BoundingSphere;
+};
+
+// --------------------------------------------------------
+// The data PixelShaderPBR reads for a material.  Textures
+// are indices into the scene's list, or -1 for a constant
+// (white albedo, a flat normal, fully rough and not metal).
+// --------------------------------------------------------
+struct SoftwareMaterial
+{
+	DirectX::XMFLOAT3 ColorTint;
+	DirectX::XMFLOAT2 UVScale;
+	DirectX::XMFLOAT2 UVOffset;
+	int Albedo;
+	int NormalMap;
+	int RoughnessMetalMap;	// Roughness in red, metalness in green
+};
+
+// --------------------------------------------------------
+// One mesh drawn with one material
+// --------------------------------------------------------
+struct SoftwareDraw
+{
+	unsigned int Mesh;
+	unsigned int Material;
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT4X4 WorldInverseTranspose;
+};
+
+// --------------------------------------------------------
+// Everything needed to render a frame: the draws and what
+// they use, the lights, the camera and the sky
+// --------------------------------------------------------
+struct SoftwareScene
+{
+	std::vector<SoftwareMesh> Meshes;
+	std::vector<SoftwareMaterial> Materials;
+	std::vector<SoftwareTexture> Textures;
+	std::vector<SoftwareDraw> Draws;
+	std::vector<Light> Lights;
+
+	// Matrices as the shaders receive them
+	DirectX::XMFLOAT4X4 View;
+	DirectX::XMFLOAT4X4 Projection;
+	DirectX::XMFLOAT3 CameraPosition;
+
+	// The sky (in linear color) drawn behind everything, and the
+	// image based lighting baked from it.  Pixels nothing covers
+	// are black when there's no sky, and IBL is skipped when
+	// there's no data or no intensity.
+	IBLCubemap Sky;
+	IBLData IBL;
+	float IBLIntensity;
+};
+
+// --------------------------------------------------------
+// Counts and times (in milliseconds) for the last frame
+// --------------------------------------------------------
+struct SoftwareRenderStats
+{
+	unsigned int Triangles;			// In every draw
+	unsigned int Rasterized;		// After culling and clipping
+	unsigned int Binned;			// Across every tile they touch
+	unsigned int ShadedPixels;
+	double VertexTime;
+	double SetupTime;
+	double BinTime;
+	double TileTime;				// Rasterizing and shading
+	double TotalTime;
+};
+
+// --------------------------------------------------------
+// Renders scenes on the CPU, for places without a GPU (and
+// for image regression tests and CPU benchmarks anywhere).
+// Implements only what the project draws: indexed triangle
+// lists of Vertex with back face culling and a less-than
+// depth test, VertexShader and PixelShaderPBR ported line
+// by line (without clustering, as every light that can reach
+// a draw is considered), and the sky behind everything.
+//
+// Work is split into stages, each spread across threads:
+// vertex shading per draw, triangle setup (clipping, culling
+// and snapping) per draw, binning into tiles per row of
+// tiles, then rasterizing and shading per tile.  Each tile
+// finds the closest triangle at every pixel first and then
+// shades each pixel once.  Triangles stay in draw order
+// throughout, so results are identical on any number of
+// threads.
+//
+// Textures are sampled bilinearly from a mip chosen once per
+// triangle (from its texel to pixel ratio), rather than per
+// pixel quad with anisotropy as the GPU does, so images are
+// close to the GPU's but not identical.
+//
+// Has no knowledge of Direct3D, so it can be exercised on
+// its own.
+// --------------------------------------------------------
+class SoftwareRasterizer
+{
+public:
+	SoftwareRasterizer();
+
+	// Renders to an 8-bit RGBA image of the given size
+	void Render(const SoftwareScene& scene, unsigned int width, unsigned int height, JobSystem& jobs, TextureImage* image);
+
+	const SoftwareRenderStats& GetStats() { return stats; }
+
+private:
+	// Output of the vertex shader
+	struct ShadedVertex
+	{
+		DirectX::XMFLOAT4 Position;		// Clip space
+		DirectX::XMFLOAT2 UV;
+		DirectX::XMFLOAT3 Normal;
+		DirectX::XMFLOAT3 Tangent;
+		DirectX::XMFLOAT3 WorldPos;
+	};
+
+	// A clipped, projected and snapped triangle, ready to bin
+	struct Triangle
+	{
+		ShadedVertex Vertices[3];
+		int X[3];					// Snapped screen position
+		int Y[3];
+		float Z[3];					// Depth (z / w)
+		float InvW[3];
+		long long Area;				// Twice the area, in sub-pixels
+		int MinX, MinY, MaxX, MaxY;	// Pixels covered, within the screen
+		unsigned int Draw;
+		float LODBias;				// Mip level for a 1x1 texture
+	};
+
+	SoftwareRenderStats stats;
+	unsigned int width;
+	unsigned int height;
+	unsigned int tilesX;
+	unsigned int tilesY;
+	DirectX::XMFLOAT4X4 skyUnprojection; // Screen to sky direction
+
+	// Kept between frames to avoid reallocating
+	std::vector<std::vector<ShadedVertex>> drawVertices;
+	std::vector<std::vector<Triangle>> drawTriangles;
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<unsigned int>> tileBins;
+	std::vector<unsigned int> tileShadedPixels;
+	std::vector<const Light*> directionalLights;
+	std::vector<std::vector<const Light*>> drawLights;
+
+	void ShadeVertices(const SoftwareScene& scene, unsigned int draw);
+	void SetUpTriangles(const SoftwareScene& scene, unsigned int draw);
+	void AddTriangle(const ShadedVertex* vertices, unsigned int count, unsigned int draw, DirectX::XMFLOAT2 uvScale, std::vector<Triangle>* output);
+	void BinTriangles(unsigned int firstRow, unsigned int endRow);
+	void RenderTile(const SoftwareScene& scene, unsigned int tile, TextureImage* image);
+};
+
+// Fills in a grid of spheres on a floor, with procedural
+// textures and sky, for rendering where there are no assets
+void BuildSoftwareTestScene(unsigned int gridSize, float aspectRatio, SoftwareScene* scene);
+
+// Converting images to and from binary PPM files (RGB only,
+// so alpha is dropped)
+void SerializeSoftwareImage(const TextureImage& image, std::vector<unsigned char>& bytes);
+bool DeserializeSoftwareImage(const unsigned char* bytes, size_t size, TextureImage* image);
+
+// --------------------------------------------------------
+// How far one image is from another
+// --------------------------------------------------------
+struct SoftwareImageDifference
+{
+	unsigned int MaxDifference;		// Largest of any channel
+	unsigned int DifferentPixels;	// Beyond the tolerance
+	bool SameSize;
+};
+
+// Compares the color (not alpha) of two images
+SoftwareImageDifference CompareSoftwareImages(const TextureImage& a, const TextureImage& b, unsigned int tolerance);
+
+// --------------------------------------------------------
+// Cost of rendering a scene at one resolution
+// --------------------------------------------------------
+struct SoftwareRasterizerTiming
+{
+	unsigned int Width;
+	unsigned int Height;
+	double Time;				// Milliseconds per frame, on every thread
+	double SingleThreadTime;
+	unsigned int Triangles;		// After culling and clipping
+	bool Deterministic;			// Same image on one thread?
+};
+
+// Renders the scene at increasing resolutions, on the given
+// jobs and on the calling thread alone
+void RunSoftwareRasterizerBenchmark(JobSystem& jobs, const SoftwareScene& scene, unsigned int frames, std::vector<SoftwareRasterizerTiming>* timings);
@@ -0,0 +1,97 @@
+#include "StructuredBuffer.h"
+
+#include <string.h>
+
+// --------------------------------------------------------
+// Creates the buffer with room for an initial number of
+// elements
+//
+// stride          - Size of a single element, in bytes
+// initialCapacity - Number of elements to start with
+// --------------------------------------------------------
+StructuredBuffer::StructuredBuffer(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	unsigned int stride,
+	unsigned int initialCapacity)
+	:
+	stride(stride),
+	capacity(0),
+	count(0),
+	device(device),
+	context(context)
+{
+	CreateBuffer(initialCapacity > 0 ? initialCapacity : 1);
+}
+
+// --------------------------------------------------------
+// Overwrites the contents of the buffer, growing it first
+// if the data won't fit.  Note that growing replaces the
+// SRV, so grab it again with GetSRV() after uploading.
+//
+// data  - The tightly packed elements to copy
+// count - Number of elements
+//
+// Returns true if the data was copied
+// --------------------------------------------------------
+bool StructuredBuffer::Upload(const void* data, unsigned int count)
+{
+	// Grow by doubling, so steadily increasing counts
+	// don't recreate the buffer every frame
+	if (count > capacity)
+	{
+		unsigned int newCapacity = capacity;
+		while (newCapacity < count)
+			newCapacity *= 2;
+
+		if (!CreateBuffer(newCapacity))
+			return false;
+	}
+
+	this->count = count;
+	if (count == 0)
+		return true;
+
+	// Discard the old contents entirely, as the GPU
+	// may still be using them from the last frame
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return false;
+
+	memcpy(mapped.pData, data, (size_t)stride * count);
+	context->Unmap(buffer.Get(), 0);
+	return true;
+}
+
+// --------------------------------------------------------
+// Helper for (re)creating the buffer and SRV
+// --------------------------------------------------------
+bool StructuredBuffer::CreateBuffer(unsigned int newCapacity)
+{
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = stride * newCapacity;
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	desc.StructureByteStride = stride;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> newBuffer;
+	if (FAILED(device->CreateBuffer(&desc, 0, newBuffer.GetAddressOf())))
+		return false;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = newCapacity;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> newSRV;
+	if (FAILED(device->CreateShaderResourceView(newBuffer.Get(), &srvDesc, newSRV.GetAddressOf())))
+		return false;
+
+	buffer = newBuffer;
+	srv = newSRV;
+	capacity = newCapacity;
+	return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+// --------------------------------------------------------
+// A dynamic structured buffer (and its SRV) for large
+// arrays of data that are rewritten by the CPU each frame.
+// Grows as needed, so the element count is only limited
+// by memory rather than the 64 KB constant buffer limit.
+// --------------------------------------------------------
+class StructuredBuffer
+{
+public:
+	StructuredBuffer(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		unsigned int stride,
+		unsigned int initialCapacity);
+
+	bool Upload(const void* data, unsigned int count);
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSRV() { return srv; }
+	unsigned int GetStride() { return stride; }
+	unsigned int GetCapacity() { return capacity; }
+	unsigned int GetCount() { return count; }
+
+private:
+	unsigned int stride;
+	unsigned int capacity;
+	unsigned int count;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	bool CreateBuffer(unsigned int newCapacity);
+};
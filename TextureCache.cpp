@@ -0,0 +1,386 @@
+#include "TextureCache.h"
+#include "WICTextureLoader.h"
+#include "DDSTextureLoader.h"
+#include "Helpers.h"
+#include "FileSystem.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <fstream>
+#include <wincodec.h>
+
+// === FILE HELPERS =================================================
+
+// Cooked files go next to the executable, named after the
+// source (without its extension) plus a suffix
+static std::wstring GetCookedPath(const std::wstring& file, const std::wstring& suffix)
+{
+	size_t nameStart = file.find_last_of(L"\\/");
+	nameStart = nameStart == std::wstring::npos ? 0 : nameStart + 1;
+	std::wstring name = file.substr(nameStart, file.find_last_of(L'.') - nameStart);
+	return FixPath(name + suffix + L".cooked.dds");
+}
+
+// Opens the first frame of an image file with WIC, decoding
+// straight from the file's bytes (which must outlive the
+// frame).  Each call makes its own factory, so threads
+// share nothing.
+static bool OpenImageFrame(
+	const std::wstring& path,
+	AssetFile& file,
+	Microsoft::WRL::ComPtr<IWICImagingFactory>& factory,
+	Microsoft::WRL::ComPtr<IWICBitmapFrameDecode>& frame)
+{
+	Microsoft::WRL::ComPtr<IWICStream> stream;
+	Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+	return
+		OpenAssetFile(path, &file) &&
+		SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, 0, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf()))) &&
+		SUCCEEDED(factory->CreateStream(stream.GetAddressOf())) &&
+		SUCCEEDED(stream->InitializeFromMemory((BYTE*)file.Data, (DWORD)file.Size)) &&
+		SUCCEEDED(factory->CreateDecoderFromStream(stream.Get(), 0, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())) &&
+		SUCCEEDED(decoder->GetFrame(0, frame.GetAddressOf()));
+}
+
+// Reads just the size of an image file, without decoding it
+static bool ReadImageSize(const std::wstring& path, unsigned int* width, unsigned int* height)
+{
+	AssetFile file;
+	Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+	Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> frame;
+	return OpenImageFrame(path, file, factory, frame) && SUCCEEDED(frame->GetSize(width, height));
+}
+
+// --------------------------------------------------------
+// Decodes an image file to 8-bit RGBA using WIC, which
+// handles every format WICTextureLoader does
+// --------------------------------------------------------
+bool DecodeImageFile(const std::wstring& path, TextureImage* image)
+{
+	AssetFile file;
+	Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+	Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> frame;
+	if (!OpenImageFrame(path, file, factory, frame))
+		return false;
+
+	UINT width = 0;
+	UINT height = 0;
+	if (FAILED(frame->GetSize(&width, &height)) || width == 0 || height == 0)
+		return false;
+
+	// Convert whatever the file holds to RGBA
+	Microsoft::WRL::ComPtr<IWICFormatConverter> converter;
+	if (FAILED(factory->CreateFormatConverter(converter.GetAddressOf())) ||
+		FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, 0, 0.0, WICBitmapPaletteTypeCustom)))
+		return false;
+
+	image->Width = width;
+	image->Height = height;
+	image->Pixels.resize((size_t)width * height * 4);
+	return SUCCEEDED(converter->CopyPixels(0, width * 4, (UINT)image->Pixels.size(), &image->Pixels[0]));
+}
+
+
+// === TEXTURE CACHE ================================================
+
+// --------------------------------------------------------
+// Creates an empty cache
+//
+// budget - Bytes of textures to keep once nothing uses them
+// --------------------------------------------------------
+TextureCache::TextureCache(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	size_t budget) :
+	device(device),
+	context(context),
+	registry(budget)
+{
+}
+
+// --------------------------------------------------------
+// Loads a texture, using its cooked DDS file if it's up to
+// date, or cooking (and saving) it otherwise.  Anything
+// that can't be cooked is loaded uncompressed instead.
+//
+// file   - Full path to the source image
+// format - Which TEXTURE_COOK_ format to cook it to
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureCache::Load(const std::wstring& file, unsigned int format)
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (Find(GetKey(file, format), &srv))
+		return srv;
+
+	PreparedTexture prepared;
+	Prepare(file, format, &prepared);
+	return Create(prepared);
+}
+
+// --------------------------------------------------------
+// Loads a roughness and a metalness map packed into the
+// red and green channels of one texture, so shaders read
+// both with a single sample.  Otherwise works like Load().
+//
+// Returns no texture if either source can't be read, as
+// there's no uncompressed equivalent to fall back to.
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureCache::LoadPacked(const std::wstring& roughnessFile, const std::wstring& metalFile)
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (Find(GetPackedKey(roughnessFile, metalFile), &srv))
+		return srv;
+
+	PreparedTexture prepared;
+	PreparePacked(roughnessFile, metalFile, &prepared);
+	return Create(prepared);
+}
+
+// --------------------------------------------------------
+// Reads a texture's up to date cooked file, or cooks it
+// (saving the result).  Touches no D3D objects or shared
+// state, so any number can run at once.
+// --------------------------------------------------------
+void TextureCache::Prepare(const std::wstring& file, unsigned int format, PreparedTexture* prepared)
+{
+	PROFILE_FUNCTION();
+
+	prepared->File = file;
+	prepared->Key = GetKey(file, format);
+
+	AssetFile source;
+	if (!OpenAssetFile(file, &source) || source.Size == 0)
+		return;
+	unsigned long long hash = HashTextureSource(source.Data, source.Size, format);
+
+	PrepareCooked(
+		GetCookedPath(file, L""),
+		hash,
+		format,
+		[&](TextureImage* image) { return DecodeImageFile(file, image); },
+		prepared);
+}
+
+// --------------------------------------------------------
+// Prepare() for a packed roughness and metalness texture
+// --------------------------------------------------------
+void TextureCache::PreparePacked(const std::wstring& roughnessFile, const std::wstring& metalFile, PreparedTexture* prepared)
+{
+	PROFILE_FUNCTION();
+
+	prepared->File = roughnessFile;
+	prepared->Key = GetPackedKey(roughnessFile, metalFile);
+	prepared->Packed = true;
+
+	// Both sources (in order) key the cache
+	AssetFile roughnessSource;
+	AssetFile metalSource;
+	if (!OpenAssetFile(roughnessFile, &roughnessSource) || !OpenAssetFile(metalFile, &metalSource) ||
+		roughnessSource.Size == 0 || metalSource.Size == 0)
+		return;
+	std::vector<unsigned char> sources(roughnessSource.Data, roughnessSource.Data + roughnessSource.Size);
+	sources.insert(sources.end(), metalSource.Data, metalSource.Data + metalSource.Size);
+	unsigned long long hash = HashTextureSource(&sources[0], sources.size(), TEXTURE_COOK_BC5_LINEAR);
+
+	auto decode = [&](TextureImage* image)
+	{
+		TextureImage roughness;
+		TextureImage metal;
+		if (!DecodeImageFile(roughnessFile, &roughness) || !DecodeImageFile(metalFile, &metal))
+			return false;
+
+		const TextureImage* sources[4] = { &roughness, &metal, 0, 0 };
+		PackTextureChannels(sources, image);
+		return true;
+	};
+
+	PrepareCooked(GetCookedPath(roughnessFile, L"_packed"), hash, TEXTURE_COOK_BC5_LINEAR, decode, prepared);
+
+	// Compare with loading the sources separately, either
+	// cooked individually or as they are
+	const std::wstring* files[] = { &roughnessFile, &metalFile };
+	for (auto file : files)
+	{
+		unsigned int width = 0;
+		unsigned int height = 0;
+		if (!ReadImageSize(*file, &width, &height))
+			continue;
+
+		prepared->SourceUncompressedBytes += GetUncompressedTextureSize(width, height);
+		prepared->SourceCookedBytes += GetCookedTextureSize(width, height, TEXTURE_COOK_BC4);
+	}
+}
+
+// --------------------------------------------------------
+// Reads a cooked DDS file, first cooking (and saving) it
+// if the file is missing or out of date
+//
+// cookedPath - Where the cooked file is (or will be)
+// hash       - Of the source, which the file must match
+// format     - Which TEXTURE_COOK_ format to cook to
+// decode     - Gets the image to cook, if necessary
+// prepared   - Receives the file and its details
+// --------------------------------------------------------
+void TextureCache::PrepareCooked(
+	const std::wstring& cookedPath,
+	unsigned long long hash,
+	unsigned int format,
+	const std::function<bool(TextureImage* image)>& decode,
+	PreparedTexture* prepared)
+{
+	// Is there an up to date cooked file?
+	prepared->CookedPath = cookedPath;
+	AssetFile& cooked = prepared->Cooked;
+	if (OpenAssetFile(cookedPath, &cooked) &&
+		ReadCookedTextureInfo(cooked.Data, cooked.Size, &prepared->Info) &&
+		prepared->Info.SourceHash == hash)
+		return;
+
+	cooked = AssetFile();
+	PROFILE_SCOPE("Cook Texture");
+	TextureImage image;
+	CookedTexture texture;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	if (!decode(&image) || !CookTexture(image, format, &texture))
+		return;
+	auto end = std::chrono::high_resolution_clock::now();
+	prepared->CookTime = std::chrono::duration<double, std::milli>(end - start).count();
+	prepared->WasCooked = true;
+
+	std::shared_ptr<std::vector<unsigned char>> bytes = std::make_shared<std::vector<unsigned char>>();
+	SerializeCookedTexture(texture, hash, *bytes);
+	cooked.Data = &(*bytes)[0];
+	cooked.Size = bytes->size();
+	cooked.Owner = bytes;
+	ReadCookedTextureInfo(cooked.Data, cooked.Size, &prepared->Info);
+
+	// Failing to save isn't an error, as it will simply
+	// be cooked again next time
+	std::ofstream out(cookedPath, std::ios::binary | std::ios::trunc);
+	if (out.is_open())
+		out.write((const char*)cooked.Data, cooked.Size);
+}
+
+// --------------------------------------------------------
+// Creates the texture for prepared data, which must happen
+// on the thread that owns the context.  Textures that
+// weren't cooked are loaded uncompressed (except packed
+// ones, which have nothing to fall back to).
+//
+// If the same texture was loaded since it was prepared, or
+// another file had identical contents, that one is shared.
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureCache::Create(const PreparedTexture& prepared)
+{
+	PROFILE_FUNCTION();
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	bool cooked = prepared.Cooked.Size > 0;
+	if (registry.Find(prepared.Key, &srv) ||
+		(cooked && registry.FindByHash(prepared.Info.SourceHash, prepared.Info.DataSize, prepared.Key, &srv)))
+	{
+		stats.SharedCount++;
+		return srv;
+	}
+
+	stats.TextureCount++;
+	stats.PackedCount += prepared.Packed ? 1 : 0;
+	stats.CookedCount += prepared.WasCooked ? 1 : 0;
+	stats.CookTime += prepared.CookTime;
+
+	if (cooked && streamer)
+		srv = streamer->Create(prepared.CookedPath, prepared.Cooked, prepared.Info);
+	if (cooked && !srv)
+		DirectX::CreateDDSTextureFromMemory(device.Get(), prepared.Cooked.Data, prepared.Cooked.Size, 0, srv.GetAddressOf());
+
+	if (!srv)
+	{
+		if (prepared.Packed)
+			return srv;
+
+		// Nothing to compare contents with, so only the path is shared
+		size_t bytes = 0;
+		srv = LoadUncompressed(prepared.File, &bytes);
+		if (srv)
+			registry.Add(prepared.Key, 0, srv, bytes);
+		return srv;
+	}
+
+	registry.Add(prepared.Key, prepared.Info.SourceHash, srv, prepared.Info.DataSize);
+	stats.CompressedBytes += prepared.Info.DataSize;
+	if (prepared.Packed)
+	{
+		stats.PackedBytes += prepared.Info.DataSize;
+		stats.PackedSeparateBytes += prepared.SourceCookedBytes;
+		stats.UncompressedBytes += prepared.SourceUncompressedBytes;
+	}
+	else
+	{
+		stats.UncompressedBytes += GetUncompressedTextureSize(prepared.Info.Width, prepared.Info.Height);
+	}
+
+	return srv;
+}
+
+// --------------------------------------------------------
+// Registry key for a texture, which includes the format as
+// the same file can be cooked more than one way
+// --------------------------------------------------------
+std::wstring TextureCache::GetKey(const std::wstring& file, unsigned int format)
+{
+	return NormalizeAssetPath(file) + L"|" + std::to_wstring(format);
+}
+
+// --------------------------------------------------------
+// Registry key for a packed roughness and metalness texture
+// --------------------------------------------------------
+std::wstring TextureCache::GetPackedKey(const std::wstring& roughnessFile, const std::wstring& metalFile)
+{
+	return NormalizeAssetPath(roughnessFile) + L"+" + NormalizeAssetPath(metalFile);
+}
+
+// --------------------------------------------------------
+// Finds an already loaded texture by its key, which comes
+// from GetKey() or GetPackedKey()
+// --------------------------------------------------------
+bool TextureCache::Find(const std::wstring& key, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* srv)
+{
+	if (!registry.Find(key, srv))
+		return false;
+
+	stats.SharedCount++;
+	return true;
+}
+
+// --------------------------------------------------------
+// Loads a texture the way it was before cooking: as is,
+// with mips generated by the GPU
+//
+// path  - The source image
+// bytes - Receives the texture's size (without mips)
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureCache::LoadUncompressed(const std::wstring& path, size_t* bytes)
+{
+	stats.UncompressedCount++;
+
+	AssetFile file;
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (!OpenAssetFile(path, &file) ||
+		FAILED(DirectX::CreateWICTextureFromMemory(device.Get(), context.Get(), file.Data, file.Size, resource.GetAddressOf(), srv.GetAddressOf())))
+		return srv;
+
+	// Count it in the totals too
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (SUCCEEDED(resource.As(&texture)))
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		texture->GetDesc(&desc);
+		*bytes = GetUncompressedTextureSize(desc.Width, desc.Height);
+		stats.CompressedBytes += *bytes;
+		stats.UncompressedBytes += *bytes;
+	}
+
+	return srv;
+}
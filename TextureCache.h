@@ -0,0 +1,130 @@
+#pragma once
+
+#include <d3d11.h>
+#include <functional>
+#include <string>
+#include <wrl/client.h> // Used for ComPtr
+
+#include "TextureCooker.h"
+#include "TextureStreamer.h"
+#include "AssetRegistry.h"
+#include "FileSystem.h"
+
+// Textures are shared through an AssetRegistry, which counts
+// references with COM's own counts
+inline long GetAssetReferenceCount(const Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+{
+	if (!srv)
+		return 0;
+	srv->AddRef();
+	return (long)srv->Release();
+}
+
+// --------------------------------------------------------
+// Totals across every texture loaded through the cache
+// --------------------------------------------------------
+struct TextureCacheStats
+{
+	unsigned int TextureCount = 0;
+	unsigned int CookedCount = 0;		// Cooked this run (not found in the cache)
+	unsigned int UncompressedCount = 0;	// Couldn't be cooked, so loaded as is
+	size_t CompressedBytes = 0;			// GPU memory of the cooked textures
+	size_t UncompressedBytes = 0;		// What they would have used as RGBA8
+	double CookTime = 0;				// Milliseconds spent cooking
+	unsigned int SharedCount = 0;		// Already loaded, so shared instead (not in the totals)
+
+	// Textures packed from more than one source, which are
+	// also included in the totals above
+	unsigned int PackedCount = 0;
+	size_t PackedBytes = 0;				// GPU memory of the packed textures
+	size_t PackedSeparateBytes = 0;		// What their sources would use cooked one by one
+};
+
+// --------------------------------------------------------
+// Everything read (or cooked) from disk for a texture,
+// before any D3D resources are made from it
+// --------------------------------------------------------
+struct PreparedTexture
+{
+	std::wstring File;					// Source, for loading as is if it wasn't cooked
+	std::wstring Key;					// For sharing through the registry
+	AssetFile Cooked;					// The whole DDS file (Size is 0 without one)
+	std::wstring CookedPath;			// Where it's saved, for streaming
+	CookedTextureInfo Info;
+	bool Packed = false;
+	bool WasCooked = false;				// Rather than loaded from the cache
+	double CookTime = 0;
+
+	// Packed textures only, for comparison
+	size_t SourceUncompressedBytes = 0;	// The sources as RGBA8
+	size_t SourceCookedBytes = 0;		// The sources cooked one by one
+};
+
+// Decodes an image file to 8-bit RGBA (safe on any thread
+// with COM initialized)
+bool DecodeImageFile(const std::wstring& path, TextureImage* image);
+
+// --------------------------------------------------------
+// Loads image files as block compressed textures with full
+// mip chains.  Each is cooked the first time it's loaded
+// and saved as a DDS file next to the executable, which
+// later loads use until the source file changes.  Every
+// file is read through mounted packs when they have it.
+//
+// Loaded textures are kept in a registry, so loading the
+// same file (or an identical copy) again shares the first.
+// With a streamer, cooked textures start with only their
+// lowest mips, and the rest are streamed in as needed.
+//
+// Loading is split in two so the slow part can happen on
+// other threads: Prepare() only touches files and memory,
+// while Create() makes the D3D resources.
+// --------------------------------------------------------
+class TextureCache
+{
+public:
+	TextureCache(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		size_t budget);
+
+	// Format is a TEXTURE_COOK_ value
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Load(const std::wstring& file, unsigned int format);
+
+	// Roughness in red and metalness in green of one texture
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> LoadPacked(const std::wstring& roughnessFile, const std::wstring& metalFile);
+
+	// The two halves of the above
+	static void Prepare(const std::wstring& file, unsigned int format, PreparedTexture* prepared);
+	static void PreparePacked(const std::wstring& roughnessFile, const std::wstring& metalFile, PreparedTexture* prepared);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Create(const PreparedTexture& prepared);
+
+	// Finding already loaded textures, to skip preparing them
+	static std::wstring GetKey(const std::wstring& file, unsigned int format);
+	static std::wstring GetPackedKey(const std::wstring& roughnessFile, const std::wstring& metalFile);
+	bool Find(const std::wstring& key, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* srv);
+
+	TextureCacheStats GetStats() { return stats; }
+	void ResetStats() { stats = TextureCacheStats(); }
+	AssetRegistryStats GetRegistryStats() { return registry.GetStats(); }
+	void TrimRegistry() { registry.Trim(); }
+
+	// Textures loaded from now on are streamed (or not, if null)
+	void SetStreamer(std::shared_ptr<TextureStreamer> streamer) { this->streamer = streamer; }
+
+private:
+	static void PrepareCooked(
+		const std::wstring& cookedPath,
+		unsigned long long hash,
+		unsigned int format,
+		const std::function<bool(TextureImage* image)>& decode,
+		PreparedTexture* prepared);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> LoadUncompressed(const std::wstring& path, size_t* bytes);
+
+	TextureCacheStats stats;
+	AssetRegistry<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> registry;
+	std::shared_ptr<TextureStreamer> streamer;
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+};
@@ -0,0 +1,858 @@
+#include "TextureCooker.h"
+#include "AssetRegistry.h"
+#include "Parallel.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+// Cooked files are DDS files with a DX10 header, identified
+// by this value in the header's reserved space
+#define TEXTURE_COOK_MAGIC	0x444B4354 // "TCKD"
+
+#define DDS_MAGIC			0x20534444 // "DDS "
+#define DDS_FOURCC_DX10		0x30315844 // "DX10"
+#define DDS_HEADER_DWORDS	31
+#define DX10_HEADER_DWORDS	5
+
+// DXGI_FORMAT values, matching TEXTURE_COOK_ order.  These are
+// UNORM (not SRGB) as the shaders convert from gamma themselves.
+static const unsigned int DXGIFormats[TEXTURE_COOK_FORMAT_COUNT] = {
+	71,	// DXGI_FORMAT_BC1_UNORM
+	80,	// DXGI_FORMAT_BC4_UNORM
+	83,	// DXGI_FORMAT_BC5_UNORM
+	98,	// DXGI_FORMAT_BC7_UNORM
+	83 };	// DXGI_FORMAT_BC5_UNORM
+
+// Bytes per 4x4 block, matching TEXTURE_COOK_ order
+static const unsigned int BlockBytes[TEXTURE_COOK_FORMAT_COUNT] = { 8, 8, 16, 16, 16 };
+
+
+// === SIZES ========================================================
+
+// Number of mips down to and including 1x1
+static unsigned int GetMipCount(unsigned int width, unsigned int height)
+{
+	unsigned int count = 1;
+	while (width > 1 || height > 1)
+	{
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+		count++;
+	}
+	return count;
+}
+
+// Bytes of blocks for one mip
+static size_t GetCompressedMipSize(unsigned int width, unsigned int height, unsigned int format)
+{
+	size_t blocksX = (width + 3) / 4;
+	size_t blocksY = (height + 3) / 4;
+	return blocksX * blocksY * BlockBytes[format];
+}
+
+// --------------------------------------------------------
+// Bytes of RGBA8 for every mip, which is what loading the
+// source without cooking costs
+// --------------------------------------------------------
+size_t GetUncompressedTextureSize(unsigned int width, unsigned int height)
+{
+	size_t size = 0;
+	unsigned int mipCount = GetMipCount(width, height);
+	for (unsigned int i = 0; i < mipCount; i++)
+	{
+		size += (size_t)width * height * 4;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return size;
+}
+
+// --------------------------------------------------------
+// Bytes of blocks for every mip once cooked
+// --------------------------------------------------------
+size_t GetCookedTextureSize(unsigned int width, unsigned int height, unsigned int format)
+{
+	size_t size = 0;
+	unsigned int mipCount = GetMipCount(width, height);
+	for (unsigned int i = 0; i < mipCount; i++)
+	{
+		size += GetCompressedMipSize(width, height, format);
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return size;
+}
+
+// --------------------------------------------------------
+// Bytes of blocks for one mip of a cooked texture
+// --------------------------------------------------------
+size_t GetCookedMipSize(unsigned int width, unsigned int height, unsigned int format, unsigned int mip)
+{
+	width = (width >> mip) > 0 ? width >> mip : 1;
+	height = (height >> mip) > 0 ? height >> mip : 1;
+	return GetCompressedMipSize(width, height, format);
+}
+
+// --------------------------------------------------------
+// Where a mip's blocks start in a file written by
+// SerializeCookedTexture(), so single mips can be read
+// without loading the rest
+// --------------------------------------------------------
+size_t GetCookedMipOffset(unsigned int width, unsigned int height, unsigned int format, unsigned int mip)
+{
+	size_t offset = (1 + DDS_HEADER_DWORDS + DX10_HEADER_DWORDS) * sizeof(unsigned int);
+	for (unsigned int i = 0; i < mip; i++)
+		offset += GetCookedMipSize(width, height, format, i);
+	return offset;
+}
+
+// --------------------------------------------------------
+// Number of mips in a full chain, which every cooked
+// texture has
+// --------------------------------------------------------
+unsigned int GetCookedMipCount(unsigned int width, unsigned int height)
+{
+	return GetMipCount(width, height);
+}
+
+// --------------------------------------------------------
+// The DXGI_FORMAT value a TEXTURE_COOK_ format is stored as
+// --------------------------------------------------------
+unsigned int GetCookedDXGIFormat(unsigned int format)
+{
+	return DXGIFormats[format];
+}
+
+
+// === CHANNEL PACKING ==============================================
+
+// --------------------------------------------------------
+// Bilinearly samples one channel of an image at a point
+// given in 0-1 texture coordinates (clamped at the edges)
+// --------------------------------------------------------
+static float SampleChannel(const TextureImage& image, unsigned int channel, float u, float v)
+{
+	float x = u * image.Width - 0.5f;
+	float y = v * image.Height - 0.5f;
+	x = x < 0.0f ? 0.0f : (x > image.Width - 1.0f ? image.Width - 1.0f : x);
+	y = y < 0.0f ? 0.0f : (y > image.Height - 1.0f ? image.Height - 1.0f : y);
+
+	unsigned int x0 = (unsigned int)x;
+	unsigned int y0 = (unsigned int)y;
+	unsigned int x1 = x0 + 1 < image.Width ? x0 + 1 : x0;
+	unsigned int y1 = y0 + 1 < image.Height ? y0 + 1 : y0;
+	float fx = x - x0;
+	float fy = y - y0;
+
+	auto texel = [&](unsigned int tx, unsigned int ty) { return (float)image.Pixels[((size_t)ty * image.Width + tx) * 4 + channel]; };
+	float top = texel(x0, y0) + (texel(x1, y0) - texel(x0, y0)) * fx;
+	float bottom = texel(x0, y1) + (texel(x1, y1) - texel(x0, y1)) * fx;
+	return top + (bottom - top) * fy;
+}
+
+// --------------------------------------------------------
+// Packs the red channel of up to four grayscale images
+// into the channels of one image, so they can be read
+// with a single sample.  The result is the size of the
+// largest source, with smaller ones filtered up to match.
+// Channels without a source are zero, except alpha which
+// is opaque.
+// --------------------------------------------------------
+void PackTextureChannels(const TextureImage* const sources[4], TextureImage* packed)
+{
+	unsigned int width = 0;
+	unsigned int height = 0;
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		if (!sources[c])
+			continue;
+		width = sources[c]->Width > width ? sources[c]->Width : width;
+		height = sources[c]->Height > height ? sources[c]->Height : height;
+	}
+
+	packed->Width = width;
+	packed->Height = height;
+	packed->Pixels.resize((size_t)width * height * 4);
+
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		const TextureImage* source = sources[c];
+		for (unsigned int y = 0; y < height; y++)
+		{
+			for (unsigned int x = 0; x < width; x++)
+			{
+				unsigned char value = c == 3 ? 255 : 0;
+				if (source && source->Width == width && source->Height == height)
+					value = source->Pixels[((size_t)y * width + x) * 4];
+				else if (source)
+					value = (unsigned char)(SampleChannel(*source, 0, (x + 0.5f) / width, (y + 0.5f) / height) + 0.5f);
+
+				packed->Pixels[((size_t)y * width + x) * 4 + c] = value;
+			}
+		}
+	}
+}
+
+
+// === MIP GENERATION ===============================================
+
+// --------------------------------------------------------
+// Converts 8-bit pixels to floats to filter with:
+//  - Color is converted from gamma 2.2 to linear, so mips
+//    don't darken (alpha is already linear)
+//  - Normals are unpacked to -1 to 1, so they can be
+//    renormalized
+//  - Anything else is just scaled to 0 to 1
+// --------------------------------------------------------
+static void DecodeLevel(const TextureImage& image, unsigned int format, std::vector<float>* level)
+{
+	float toLinear[256];
+	for (int i = 0; i < 256; i++)
+		toLinear[i] = powf(i / 255.0f, 2.2f);
+
+	size_t count = (size_t)image.Width * image.Height * 4;
+	level->resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned char value = image.Pixels[i];
+		bool alpha = (i & 3) == 3;
+
+		if (format == TEXTURE_COOK_BC1 || format == TEXTURE_COOK_BC7)
+			(*level)[i] = alpha ? value / 255.0f : toLinear[value];
+		else if (format == TEXTURE_COOK_BC5)
+			(*level)[i] = value / 255.0f * 2.0f - 1.0f;
+		else
+			(*level)[i] = value / 255.0f;
+	}
+}
+
+// Reverses DecodeLevel()
+static void EncodeLevel(const std::vector<float>& level, unsigned int width, unsigned int height, unsigned int format, TextureImage* image)
+{
+	image->Width = width;
+	image->Height = height;
+	image->Pixels.resize(level.size());
+	for (size_t i = 0; i < level.size(); i++)
+	{
+		float value = level[i];
+		bool alpha = (i & 3) == 3;
+
+		if (format == TEXTURE_COOK_BC1 || format == TEXTURE_COOK_BC7)
+			value = alpha ? value : powf(value > 0.0f ? value : 0.0f, 1.0f / 2.2f);
+		else if (format == TEXTURE_COOK_BC5)
+			value = value * 0.5f + 0.5f;
+
+		value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+		image->Pixels[i] = (unsigned char)(value * 255.0f + 0.5f);
+	}
+}
+
+// --------------------------------------------------------
+// Box filters a level down to half size, four channels
+// at a time.  Odd sizes clamp at the last row and column.
+// Normals are renormalized after averaging.
+// --------------------------------------------------------
+static void DownsampleLevel(
+	const std::vector<float>& source,
+	unsigned int width,
+	unsigned int height,
+	bool normals,
+	std::vector<float>* dest)
+{
+	unsigned int destWidth = width > 1 ? width / 2 : 1;
+	unsigned int destHeight = height > 1 ? height / 2 : 1;
+	dest->resize((size_t)destWidth * destHeight * 4);
+
+	const __m128 quarter = _mm_set1_ps(0.25f);
+	for (unsigned int y = 0; y < destHeight; y++)
+	{
+		const float* row0 = &source[(size_t)(y * 2 < height ? y * 2 : height - 1) * width * 4];
+		const float* row1 = &source[(size_t)(y * 2 + 1 < height ? y * 2 + 1 : height - 1) * width * 4];
+		float* out = &(*dest)[(size_t)y * destWidth * 4];
+
+		for (unsigned int x = 0; x < destWidth; x++)
+		{
+			unsigned int x0 = (x * 2 < width ? x * 2 : width - 1) * 4;
+			unsigned int x1 = (x * 2 + 1 < width ? x * 2 + 1 : width - 1) * 4;
+
+			__m128 sum = _mm_add_ps(
+				_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)),
+				_mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+			__m128 average = _mm_mul_ps(sum, quarter);
+
+			if (normals)
+			{
+				// Length of xyz only
+				__m128 squared = _mm_mul_ps(average, average);
+				float lengthSq[4];
+				_mm_storeu_ps(lengthSq, squared);
+				float length = sqrtf(lengthSq[0] + lengthSq[1] + lengthSq[2]);
+
+				if (length > 0.0001f)
+					average = _mm_mul_ps(average, _mm_set1_ps(1.0f / length));
+				else
+					average = _mm_set_ps(1.0f, 1.0f, 0.0f, 0.0f);
+			}
+
+			_mm_storeu_ps(out + x * 4, average);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Builds a full mip chain (including the image itself as
+// the first mip), filtering in the space that suits the
+// format.  Each mip is filtered from the previous one at
+// full precision, so rounding doesn't build up.
+// --------------------------------------------------------
+void GenerateMipChain(const TextureImage& image, unsigned int format, std::vector<TextureImage>* mips)
+{
+	mips->clear();
+	if (image.Width == 0 || image.Height == 0)
+		return;
+
+	unsigned int mipCount = GetMipCount(image.Width, image.Height);
+	mips->resize(mipCount);
+	(*mips)[0] = image;
+
+	std::vector<float> level;
+	std::vector<float> nextLevel;
+	DecodeLevel(image, format, &level);
+
+	unsigned int width = image.Width;
+	unsigned int height = image.Height;
+	for (unsigned int i = 1; i < mipCount; i++)
+	{
+		DownsampleLevel(level, width, height, format == TEXTURE_COOK_BC5, &nextLevel);
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+
+		EncodeLevel(nextLevel, width, height, format, &(*mips)[i]);
+		level.swap(nextLevel);
+	}
+}
+
+
+// === BLOCK ENCODERS ===============================================
+
+// --------------------------------------------------------
+// Finds the mean of a block and the axis its pixels vary
+// along most (via power iteration on the covariance), for
+// the first channelCount channels
+// --------------------------------------------------------
+static void FindPrincipalAxis(const unsigned char pixels[16][4], unsigned int channelCount, float mean[4], float axis[4])
+{
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		mean[c] = 0.0f;
+		axis[c] = 0.0f;
+	}
+
+	for (unsigned int i = 0; i < 16; i++)
+		for (unsigned int c = 0; c < channelCount; c++)
+			mean[c] += pixels[i][c];
+	for (unsigned int c = 0; c < channelCount; c++)
+		mean[c] /= 16.0f;
+
+	float covariance[4][4] = {};
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		float d[4];
+		for (unsigned int c = 0; c < channelCount; c++)
+			d[c] = pixels[i][c] - mean[c];
+		for (unsigned int a = 0; a < channelCount; a++)
+			for (unsigned int b = 0; b < channelCount; b++)
+				covariance[a][b] += d[a] * d[b];
+	}
+
+	// Start along the diagonal, which is a good guess for
+	// most color blocks
+	for (unsigned int c = 0; c < channelCount; c++)
+		axis[c] = 1.0f;
+
+	for (unsigned int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		for (unsigned int a = 0; a < channelCount; a++)
+			for (unsigned int b = 0; b < channelCount; b++)
+				next[a] += covariance[a][b] * axis[b];
+
+		float lengthSq = 0.0f;
+		for (unsigned int c = 0; c < channelCount; c++)
+			lengthSq += next[c] * next[c];
+
+		// A flat block has no axis, and any will do
+		if (lengthSq < 1e-12f)
+			return;
+
+		float scale = 1.0f / sqrtf(lengthSq);
+		for (unsigned int c = 0; c < channelCount; c++)
+			axis[c] = next[c] * scale;
+	}
+}
+
+// --------------------------------------------------------
+// Places two endpoints at the extremes of the block's
+// pixels along its principal axis
+// --------------------------------------------------------
+static void FindEndpoints(const unsigned char pixels[16][4], unsigned int channelCount, float end0[4], float end1[4])
+{
+	float mean[4];
+	float axis[4];
+	FindPrincipalAxis(pixels, channelCount, mean, axis);
+
+	float minT = FLT_MAX;
+	float maxT = -FLT_MAX;
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (unsigned int c = 0; c < channelCount; c++)
+			t += (pixels[i][c] - mean[c]) * axis[c];
+		minT = t < minT ? t : minT;
+		maxT = t > maxT ? t : maxT;
+	}
+
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		end0[c] = mean[c] + axis[c] * maxT;
+		end1[c] = mean[c] + axis[c] * minT;
+		end0[c] = end0[c] < 0.0f ? 0.0f : (end0[c] > 255.0f ? 255.0f : end0[c]);
+		end1[c] = end1[c] < 0.0f ? 0.0f : (end1[c] > 255.0f ? 255.0f : end1[c]);
+	}
+}
+
+// Rounds a 0-255 color to 5:6:5
+static unsigned short PackRGB565(const float color[4])
+{
+	unsigned int r = (unsigned int)(color[0] * 31.0f / 255.0f + 0.5f);
+	unsigned int g = (unsigned int)(color[1] * 63.0f / 255.0f + 0.5f);
+	unsigned int b = (unsigned int)(color[2] * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+// Expands 5:6:5 back to 0-255, the way hardware does
+static void UnpackRGB565(unsigned short packed, int color[3])
+{
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+// --------------------------------------------------------
+// BC1: two 5:6:5 endpoints and a 2-bit index per pixel.
+// Always uses four color mode (color0 > color1), as every
+// pixel is treated as opaque.
+// --------------------------------------------------------
+static void EncodeBC1Block(const unsigned char pixels[16][4], unsigned char* out)
+{
+	float end0[4];
+	float end1[4];
+	FindEndpoints(pixels, 3, end0, end1);
+
+	unsigned short color0 = PackRGB565(end0);
+	unsigned short color1 = PackRGB565(end1);
+	if (color0 < color1)
+	{
+		unsigned short swap = color0;
+		color0 = color1;
+		color1 = swap;
+	}
+
+	unsigned int indices = 0;
+	if (color0 != color1)
+	{
+		int palette[4][3];
+		UnpackRGB565(color0, palette[0]);
+		UnpackRGB565(color1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (unsigned int i = 0; i < 16; i++)
+		{
+			unsigned int best = 0;
+			int bestError = INT_MAX;
+			for (unsigned int p = 0; p < 4; p++)
+			{
+				int error = 0;
+				for (int c = 0; c < 3; c++)
+				{
+					int d = pixels[i][c] - palette[p][c];
+					error += d * d;
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					best = p;
+				}
+			}
+			indices |= best << (i * 2);
+		}
+	}
+
+	out[0] = (unsigned char)(color0 & 0xFF);
+	out[1] = (unsigned char)(color0 >> 8);
+	out[2] = (unsigned char)(color1 & 0xFF);
+	out[3] = (unsigned char)(color1 >> 8);
+	memcpy(out + 4, &indices, 4);
+}
+
+// --------------------------------------------------------
+// BC4: the channel's min and max as endpoints, with six
+// values between them, and a 3-bit index per pixel
+// --------------------------------------------------------
+static void EncodeBC4Block(const unsigned char pixels[16][4], unsigned int channel, unsigned char* out)
+{
+	unsigned char low = 255;
+	unsigned char high = 0;
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		unsigned char value = pixels[i][channel];
+		low = value < low ? value : low;
+		high = value > high ? value : high;
+	}
+
+	unsigned long long indices = 0;
+	if (high != low)
+	{
+		// Index 0 and 1 are the endpoints, 2 through 7 are
+		// evenly spaced from the first toward the second
+		float palette[8];
+		palette[0] = high;
+		palette[1] = low;
+		for (unsigned int p = 1; p < 7; p++)
+			palette[p + 1] = ((7 - p) * high + p * low) / 7.0f;
+
+		for (unsigned int i = 0; i < 16; i++)
+		{
+			unsigned int best = 0;
+			float bestError = FLT_MAX;
+			for (unsigned int p = 0; p < 8; p++)
+			{
+				float error = fabsf(pixels[i][channel] - palette[p]);
+				if (error < bestError)
+				{
+					bestError = error;
+					best = p;
+				}
+			}
+			indices |= (unsigned long long)best << (i * 3);
+		}
+	}
+
+	out[0] = high;
+	out[1] = low;
+	for (unsigned int b = 0; b < 6; b++)
+		out[b + 2] = (unsigned char)(indices >> (b * 8));
+}
+
+// --------------------------------------------------------
+// Writes bits from least to most significant, which is
+// how BC7 blocks are laid out
+// --------------------------------------------------------
+struct BlockBitWriter
+{
+	unsigned char* Out;
+	unsigned int Position;
+
+	void Write(unsigned int value, unsigned int count)
+	{
+		for (unsigned int i = 0; i < count; i++, Position++)
+		{
+			if ((value >> i) & 1)
+				Out[Position >> 3] |= (unsigned char)(1 << (Position & 7));
+		}
+	}
+};
+
+// --------------------------------------------------------
+// BC7 using only mode 6: one subset, RGBA endpoints of
+// 7 bits plus a shared low bit each, and a 4-bit index
+// per pixel.  The other modes would help blocks with more
+// than one gradient, but mode 6 alone is already far
+// better than BC1 and much simpler to search.
+// --------------------------------------------------------
+static void EncodeBC7Block(const unsigned char pixels[16][4], unsigned char* out)
+{
+	static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	float ends[2][4];
+	FindEndpoints(pixels, 4, ends[0], ends[1]);
+
+	// Quantize each endpoint to 7 bits, choosing whichever
+	// low (p) bit reconstructs it best
+	unsigned int quantized[2][4];
+	unsigned int pBits[2];
+	int endpoints[2][4];
+	for (unsigned int e = 0; e < 2; e++)
+	{
+		float bestError = FLT_MAX;
+		for (unsigned int p = 0; p < 2; p++)
+		{
+			unsigned int q[4];
+			float error = 0.0f;
+			for (unsigned int c = 0; c < 4; c++)
+			{
+				int value = (int)((ends[e][c] - p) * 0.5f + 0.5f);
+				q[c] = value < 0 ? 0 : (value > 127 ? 127 : value);
+				float d = ends[e][c] - (float)((q[c] << 1) | p);
+				error += d * d;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				pBits[e] = p;
+				memcpy(quantized[e], q, sizeof(q));
+			}
+		}
+
+		for (unsigned int c = 0; c < 4; c++)
+			endpoints[e][c] = (int)((quantized[e][c] << 1) | pBits[e]);
+	}
+
+	// Closest of the 16 interpolated colors for each pixel
+	unsigned int indices[16];
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		int bestError = INT_MAX;
+		indices[i] = 0;
+		for (unsigned int w = 0; w < 16; w++)
+		{
+			int error = 0;
+			for (unsigned int c = 0; c < 4; c++)
+			{
+				int value = ((64 - weights[w]) * endpoints[0][c] + weights[w] * endpoints[1][c] + 32) >> 6;
+				int d = pixels[i][c] - value;
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[i] = w;
+			}
+		}
+	}
+
+	// The first index is stored with one less bit, so its top
+	// bit must be zero - swap the endpoints if it isn't
+	if (indices[0] >= 8)
+	{
+		for (unsigned int c = 0; c < 4; c++)
+		{
+			unsigned int swap = quantized[0][c];
+			quantized[0][c] = quantized[1][c];
+			quantized[1][c] = swap;
+		}
+		unsigned int swap = pBits[0];
+		pBits[0] = pBits[1];
+		pBits[1] = swap;
+
+		for (unsigned int i = 0; i < 16; i++)
+			indices[i] = 15 - indices[i];
+	}
+
+	memset(out, 0, 16);
+	BlockBitWriter bits = { out, 0 };
+	bits.Write(1 << 6, 7); // Mode 6
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		bits.Write(quantized[0][c], 7);
+		bits.Write(quantized[1][c], 7);
+	}
+	bits.Write(pBits[0], 1);
+	bits.Write(pBits[1], 1);
+	bits.Write(indices[0], 3);
+	for (unsigned int i = 1; i < 16; i++)
+		bits.Write(indices[i], 4);
+}
+
+
+// === COOKING ======================================================
+
+// --------------------------------------------------------
+// Compresses a single image (one mip) into 4x4 blocks,
+// one row of blocks at a time.  Blocks hanging over the
+// edge of an image repeat its last row and column.
+// --------------------------------------------------------
+void CompressImage(const TextureImage& image, unsigned int format, std::vector<unsigned char>* blocks, bool multithreaded)
+{
+	unsigned int blocksX = (image.Width + 3) / 4;
+	unsigned int blocksY = (image.Height + 3) / 4;
+	unsigned int blockBytes = BlockBytes[format];
+	blocks->resize((size_t)blocksX * blocksY * blockBytes);
+
+	auto compressRows = [&](unsigned int start, unsigned int end)
+	{
+		unsigned char pixels[16][4];
+		for (unsigned int by = start; by < end; by++)
+		{
+			for (unsigned int bx = 0; bx < blocksX; bx++)
+			{
+				for (unsigned int i = 0; i < 16; i++)
+				{
+					unsigned int x = bx * 4 + (i & 3);
+					unsigned int y = by * 4 + (i >> 2);
+					x = x < image.Width ? x : image.Width - 1;
+					y = y < image.Height ? y : image.Height - 1;
+					memcpy(pixels[i], &image.Pixels[((size_t)y * image.Width + x) * 4], 4);
+				}
+
+				unsigned char* out = &(*blocks)[((size_t)by * blocksX + bx) * blockBytes];
+				switch (format)
+				{
+				case TEXTURE_COOK_BC1: EncodeBC1Block(pixels, out); break;
+				case TEXTURE_COOK_BC4: EncodeBC4Block(pixels, 0, out); break;
+				case TEXTURE_COOK_BC5:
+				case TEXTURE_COOK_BC5_LINEAR:
+					EncodeBC4Block(pixels, 0, out);
+					EncodeBC4Block(pixels, 1, out + 8);
+					break;
+				case TEXTURE_COOK_BC7: EncodeBC7Block(pixels, out); break;
+				}
+			}
+		}
+	};
+
+	if (multithreaded)
+		ParallelFor(blocksY, compressRows);
+	else
+		compressRows(0, blocksY);
+}
+
+// --------------------------------------------------------
+// Generates mips for an image and compresses all of them
+//
+// Returns false if the image can't be block compressed,
+// as D3D needs the top mip's size to be a multiple of 4
+// --------------------------------------------------------
+bool CookTexture(const TextureImage& image, unsigned int format, CookedTexture* cooked, bool multithreaded)
+{
+	if (format >= TEXTURE_COOK_FORMAT_COUNT ||
+		image.Width == 0 || image.Height == 0 ||
+		image.Width % 4 != 0 || image.Height % 4 != 0 ||
+		image.Pixels.size() != (size_t)image.Width * image.Height * 4)
+		return false;
+
+	std::vector<TextureImage> mips;
+	GenerateMipChain(image, format, &mips);
+
+	cooked->Width = image.Width;
+	cooked->Height = image.Height;
+	cooked->Format = format;
+	cooked->Mips.resize(mips.size());
+	for (size_t i = 0; i < mips.size(); i++)
+		CompressImage(mips[i], format, &cooked->Mips[i], multithreaded);
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Hashes the source file's bytes, the format and the cook
+// version, the same way as every other asset
+// --------------------------------------------------------
+unsigned long long HashTextureSource(const void* data, size_t size, unsigned int format)
+{
+	unsigned int values[] = { format, TEXTURE_COOK_VERSION };
+	unsigned long long hash = HashAssetData(values, sizeof(values));
+	return HashAssetData(data, size, hash);
+}
+
+
+// === DDS FILES ====================================================
+
+// --------------------------------------------------------
+// Writes a cooked texture as a DDS file: the magic, the
+// header (with the cook magic, version, source hash and
+// format in its reserved space), the DX10 header, then
+// every mip
+// --------------------------------------------------------
+void SerializeCookedTexture(const CookedTexture& cooked, unsigned long long sourceHash, std::vector<unsigned char>& bytes)
+{
+	unsigned int header[1 + DDS_HEADER_DWORDS + DX10_HEADER_DWORDS] = {};
+	unsigned int* dds = header + 1;
+	unsigned int* dx10 = dds + DDS_HEADER_DWORDS;
+
+	header[0] = DDS_MAGIC;
+	dds[0] = DDS_HEADER_DWORDS * 4;
+	dds[1] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // Caps, height, width, pixel format, mip count, linear size
+	dds[2] = cooked.Height;
+	dds[3] = cooked.Width;
+	dds[4] = (unsigned int)GetCompressedMipSize(cooked.Width, cooked.Height, cooked.Format);
+	dds[6] = (unsigned int)cooked.Mips.size();
+	dds[7] = TEXTURE_COOK_MAGIC;
+	dds[8] = TEXTURE_COOK_VERSION;
+	dds[9] = (unsigned int)(sourceHash & 0xFFFFFFFF);
+	dds[10] = (unsigned int)(sourceHash >> 32);
+	dds[11] = cooked.Format; // As more than one can share a DXGI format
+	dds[18] = 32;				// Pixel format size
+	dds[19] = 0x4;				// Four CC
+	dds[20] = DDS_FOURCC_DX10;
+	dds[26] = 0x1000 | 0x400000 | 0x8;	// Texture, mip map, complex
+
+	dx10[0] = DXGIFormats[cooked.Format];
+	dx10[1] = 3; // Texture 2D
+	dx10[3] = 1; // Array size
+
+	bytes.clear();
+	const unsigned char* raw = (const unsigned char*)header;
+	bytes.insert(bytes.end(), raw, raw + sizeof(header));
+	for (auto& mip : cooked.Mips)
+		bytes.insert(bytes.end(), mip.begin(), mip.end());
+}
+
+// --------------------------------------------------------
+// Reads the header of a file written by
+// SerializeCookedTexture()
+//
+// Returns false if it isn't one, was cooked by another
+// version, or is the wrong size
+// --------------------------------------------------------
+bool ReadCookedTextureInfo(const unsigned char* bytes, size_t size, CookedTextureInfo* info)
+{
+	unsigned int header[1 + DDS_HEADER_DWORDS + DX10_HEADER_DWORDS];
+	if (size < sizeof(header))
+		return false;
+	memcpy(header, bytes, sizeof(header));
+
+	const unsigned int* dds = header + 1;
+	const unsigned int* dx10 = dds + DDS_HEADER_DWORDS;
+	if (header[0] != DDS_MAGIC ||
+		dds[0] != DDS_HEADER_DWORDS * 4 ||
+		dds[7] != TEXTURE_COOK_MAGIC ||
+		dds[8] != TEXTURE_COOK_VERSION ||
+		dds[20] != DDS_FOURCC_DX10)
+		return false;
+
+	// Which of our formats?
+	unsigned int format = dds[11];
+	if (format >= TEXTURE_COOK_FORMAT_COUNT || DXGIFormats[format] != dx10[0])
+		return false;
+
+	unsigned int width = dds[3];
+	unsigned int height = dds[2];
+	unsigned int mipCount = dds[6];
+	if (width == 0 || height == 0 || mipCount != GetMipCount(width, height))
+		return false;
+
+	// The blocks must fill the rest of the file exactly
+	size_t dataSize = GetCookedTextureSize(width, height, format);
+	if (size - sizeof(header) != dataSize)
+		return false;
+
+	info->SourceHash = dds[9] | ((unsigned long long)dds[10] << 32);
+	info->Width = width;
+	info->Height = height;
+	info->MipCount = mipCount;
+	info->Format = format;
+	info->DataSize = dataSize;
+	return true;
+}
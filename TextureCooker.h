@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// Block compressed formats a texture can be cooked to.  Each
+// also decides how the mip chain is filtered.
+#define TEXTURE_COOK_BC1	0	// Opaque color (4 bpp), gamma-correct mips
+#define TEXTURE_COOK_BC4	1	// Red channel only (4 bpp), linear mips
+#define TEXTURE_COOK_BC5	2	// Tangent space normals (8 bpp), renormalized mips
+#define TEXTURE_COOK_BC7	3	// High quality color and alpha (8 bpp), gamma-correct mips
+#define TEXTURE_COOK_BC5_LINEAR	4	// Two unrelated channels (8 bpp), linear mips
+#define TEXTURE_COOK_FORMAT_COUNT	5
+
+// Bumped whenever cooking changes, so old cached files are
+// cooked again
+#define TEXTURE_COOK_VERSION	2
+
+// --------------------------------------------------------
+// An uncompressed 8-bit RGBA image (rows top to bottom,
+// no padding between rows)
+// --------------------------------------------------------
+struct TextureImage
+{
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	std::vector<unsigned char> Pixels;
+};
+
+// --------------------------------------------------------
+// A block compressed texture and its full mip chain
+// --------------------------------------------------------
+struct CookedTexture
+{
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	unsigned int Format = TEXTURE_COOK_BC1; // A TEXTURE_COOK_ value
+	std::vector<std::vector<unsigned char>> Mips;
+};
+
+// --------------------------------------------------------
+// What a cooked DDS file's header says about it
+// --------------------------------------------------------
+struct CookedTextureInfo
+{
+	unsigned long long SourceHash = 0;
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	unsigned int MipCount = 0;
+	unsigned int Format = 0;
+	size_t DataSize = 0; // Bytes of compressed blocks
+};
+
+// Individual steps of cooking
+void PackTextureChannels(const TextureImage* const sources[4], TextureImage* packed);
+void GenerateMipChain(const TextureImage& image, unsigned int format, std::vector<TextureImage>* mips);
+void CompressImage(const TextureImage& image, unsigned int format, std::vector<unsigned char>* blocks, bool multithreaded = true);
+
+// Mips and compression together, failing if the size
+// isn't a multiple of 4 (which D3D requires for blocks)
+bool CookTexture(const TextureImage& image, unsigned int format, CookedTexture* cooked, bool multithreaded = true);
+
+// Keys the cache: the source file's bytes, the format and
+// the cook version
+unsigned long long HashTextureSource(const void* data, size_t size, unsigned int format);
+
+// Converting to and from DDS files (with a DX10 header),
+// which record the source hash in their reserved fields
+void SerializeCookedTexture(const CookedTexture& cooked, unsigned long long sourceHash, std::vector<unsigned char>& bytes);
+bool ReadCookedTextureInfo(const unsigned char* bytes, size_t size, CookedTextureInfo* info);
+
+// Bytes used with a full mip chain, as uncompressed RGBA8
+// (for comparison) or cooked to a TEXTURE_COOK_ format
+size_t GetUncompressedTextureSize(unsigned int width, unsigned int height);
+size_t GetCookedTextureSize(unsigned int width, unsigned int height, unsigned int format);
+
+// Layout of cooked files, for reading mips individually
+size_t GetCookedMipSize(unsigned int width, unsigned int height, unsigned int format, unsigned int mip);
+size_t GetCookedMipOffset(unsigned int width, unsigned int height, unsigned int format, unsigned int mip);
+unsigned int GetCookedMipCount(unsigned int width, unsigned int height);
+unsigned int GetCookedDXGIFormat(unsigned int format);
@@ -0,0 +1,396 @@
+#include "TextureStreamer.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+
+// --------------------------------------------------------
+// Creates a streamer with no textures
+//
+// budget      - Bytes for every streamed texture together
+// workerCount - Threads for reading from disk
+// --------------------------------------------------------
+TextureStreamer::TextureStreamer(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	size_t budget,
+	unsigned int workerCount) :
+	device(device),
+	context(context),
+	budget(budget),
+	stopping(false)
+{
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers.push_back(std::thread(&TextureStreamer::WorkerLoop, this));
+}
+
+// --------------------------------------------------------
+// Stops the workers, dropping any reads still queued
+// --------------------------------------------------------
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	requestReady.notify_all();
+
+	for (auto& w : workers)
+		w.join();
+}
+
+// --------------------------------------------------------
+// Creates a streamed texture from a cooked file, with only
+// the mips from its lowest streaming mip down
+//
+// cookedPath - Where the rest of the mips are read from
+// cooked     - The whole cooked file
+// info       - What its header says
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureStreamer::Create(
+	const std::wstring& cookedPath,
+	const AssetFile& cooked,
+	const CookedTextureInfo& info)
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	StreamingTexture desc = MakeStreamingTexture(info.Width, info.Height, info.Format);
+	if (desc.LowestMip == 0)
+		return srv;
+
+	D3D11_TEXTURE2D_DESC texDesc = {};
+	texDesc.Width = info.Width >> desc.LowestMip;
+	texDesc.Height = info.Height >> desc.LowestMip;
+	texDesc.MipLevels = desc.MipCount - desc.LowestMip;
+	texDesc.ArraySize = 1;
+	texDesc.Format = (DXGI_FORMAT)GetCookedDXGIFormat(info.Format);
+	texDesc.SampleDesc.Count = 1;
+	texDesc.Usage = D3D11_USAGE_DEFAULT; // Later textures copy from it
+	texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	// The resident mips straight from the file's bytes
+	std::vector<D3D11_SUBRESOURCE_DATA> data(texDesc.MipLevels);
+	for (unsigned int mip = desc.LowestMip; mip < desc.MipCount; mip++)
+	{
+		unsigned int rows = (((info.Height >> mip) > 0 ? info.Height >> mip : 1) + 3) / 4;
+		size_t size = GetCookedMipSize(info.Width, info.Height, info.Format, mip);
+		D3D11_SUBRESOURCE_DATA& d = data[mip - desc.LowestMip];
+		d.pSysMem = cooked.Data + GetCookedMipOffset(info.Width, info.Height, info.Format, mip);
+		d.SysMemPitch = (UINT)(size / rows);
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(device->CreateTexture2D(&texDesc, &data[0], texture.GetAddressOf())) ||
+		FAILED(device->CreateShaderResourceView(texture.Get(), 0, srv.GetAddressOf())))
+		return 0;
+
+	StreamedTexture streamed;
+	streamed.CookedPath = cookedPath;
+	streamed.Texture = texture;
+	streamed.SRV = srv;
+	streamed.Original = srv;
+
+	unsigned int index = (unsigned int)textures.size();
+	textures.push_back(streamed);
+	policy.push_back(desc);
+	resident.push_back(desc.LowestMip);
+	targets.push_back(desc.LowestMip);
+	loading.push_back(false);
+	textureBySRV[srv.Get()] = index;
+	return srv;
+}
+
+// --------------------------------------------------------
+// Starts keeping a material's texture up to date, swapping
+// in the current one right away if it's already changed
+//
+// material - Uses the texture
+// name     - Which of its textures
+// --------------------------------------------------------
+void TextureStreamer::Track(std::shared_ptr<Material> material, const std::string& name)
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv = material->GetTextureSRV(name);
+	auto found = textureBySRV.find(srv.Get());
+	if (!srv || found == textureBySRV.end())
+		return;
+
+	unsigned int index = found->second;
+	StreamedTexture& t = textures[index];
+	if (srv != t.SRV)
+	{
+		material->RemoveTextureSRV(name);
+		material->AddTextureSRV(name, t.SRV);
+	}
+
+	// Forget anything left by an old material at the same address
+	TrackedMaterial& tracked = materials[material.get()];
+	if (tracked.Material.lock() != material)
+	{
+		tracked.Material = material;
+		tracked.Textures.clear();
+	}
+
+	if (std::find(tracked.Textures.begin(), tracked.Textures.end(), index) != tracked.Textures.end())
+	{
+		// Already tracked under this name?
+		for (auto& b : t.Bindings)
+		{
+			if (b.first.lock() == material && b.second == name)
+				return;
+		}
+	}
+	else
+	{
+		tracked.Textures.push_back(index);
+	}
+	t.Bindings.push_back(std::make_pair(std::weak_ptr<Material>(material), name));
+}
+
+// --------------------------------------------------------
+// Clears last frame's feedback
+// --------------------------------------------------------
+void TextureStreamer::BeginFeedback()
+{
+	ResetStreamingFeedback(policy);
+}
+
+// --------------------------------------------------------
+// Adds feedback for something drawn with a material
+//
+// material     - What it's drawn with
+// pixelsAcross - Its size on screen (see GetSphereScreenSize())
+// --------------------------------------------------------
+void TextureStreamer::AddFeedback(Material* material, float pixelsAcross)
+{
+	auto found = materials.find(material);
+	if (found == materials.end() || found->second.Material.lock().get() != material)
+		return;
+
+	DirectX::XMFLOAT2 uvScale = material->GetUVScale();
+	for (unsigned int t : found->second.Textures)
+		AddStreamingFeedback(policy[t], pixelsAcross, (std::max)(uvScale.x, uvScale.y));
+}
+
+// --------------------------------------------------------
+// Applies this frame's feedback: chooses the mips to keep
+// resident, drops any that aren't needed, makes textures
+// from finished reads and starts new ones
+// --------------------------------------------------------
+void TextureStreamer::Update()
+{
+	PROFILE_FUNCTION();
+	auto start = std::chrono::high_resolution_clock::now();
+
+	ChooseResidentMips(policy, budget, &targets);
+
+	// Evict right away, as it only needs a GPU copy
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		if (targets[i] > resident[i] && SetTopMip(i, targets[i], 0))
+			stats.Evictions++;
+	}
+
+	// Finish a few reads
+	std::vector<LoadResult> finished;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		while (!results.empty() && finished.size() < TEXTURE_STREAMER_MAX_UPLOADS)
+		{
+			finished.push_back(std::move(results.front()));
+			results.pop_front();
+		}
+	}
+
+	for (auto& result : finished)
+	{
+		unsigned int i = result.Texture;
+		loading[i] = false;
+
+		// Couldn't be read, so stop asking for more
+		if (!result.Succeeded)
+		{
+			policy[i].LowestMip = resident[i];
+			continue;
+		}
+
+		// Only use what's still needed, and only if nothing was
+		// evicted since the read started
+		unsigned int topMip = (std::max)(result.TopMip, targets[i]);
+		if (resident[i] != result.Resident || topMip >= resident[i])
+			continue;
+
+		size_t offset = 0;
+		for (unsigned int mip = result.TopMip; mip < topMip; mip++)
+			offset += GetCookedMipSize(policy[i].Width, policy[i].Height, policy[i].Format, mip);
+
+		unsigned int mipCount = resident[i] - topMip;
+		if (SetTopMip(i, topMip, &result.Data[offset]))
+			stats.MipLoads += mipCount;
+	}
+
+	// Start new reads
+	unsigned int inFlight = (unsigned int)std::count(loading.begin(), loading.end(), true);
+	std::vector<unsigned int> loads;
+	ChooseStreamingLoads(policy, targets, resident, loading, TEXTURE_STREAMER_MAX_LOADS - inFlight, &loads);
+	if (!loads.empty())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (unsigned int i : loads)
+			{
+				LoadRequest request;
+				request.Texture = i;
+				request.Path = textures[i].CookedPath;
+				request.Desc = policy[i];
+				request.TopMip = targets[i];
+				request.Resident = resident[i];
+				requests.push_back(request);
+				loading[i] = true;
+			}
+		}
+		requestReady.notify_all();
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	stats.UpdateTime = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// --------------------------------------------------------
+// Gets the current totals
+// --------------------------------------------------------
+TextureStreamerStats TextureStreamer::GetStats()
+{
+	stats.TextureCount = (unsigned int)textures.size();
+	stats.Budget = budget;
+	stats.ResidentBytes = 0;
+	stats.FullBytes = 0;
+	stats.LoadsInFlight = (unsigned int)std::count(loading.begin(), loading.end(), true);
+
+	unsigned int visible = 0;
+	unsigned int satisfied = 0;
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		stats.ResidentBytes += GetStreamingResidentSize(policy[i], resident[i]);
+		stats.FullBytes += GetStreamingResidentSize(policy[i], 0);
+		if (policy[i].Priority > 0)
+		{
+			visible++;
+			satisfied += resident[i] <= policy[i].RequiredMip ? 1 : 0;
+		}
+	}
+	stats.SatisfiedPercent = visible > 0 ? 100.0 * satisfied / visible : 100.0;
+
+	return stats;
+}
+
+// --------------------------------------------------------
+// Replaces a texture with one that has a different top mip,
+// then swaps it into every material using the texture
+//
+// texture - Which one
+// topMip  - The new most detailed mip
+// newMips - If adding mips, the blocks of every mip from
+//           topMip to the current top, one after another
+//
+// Returns false if the texture couldn't be made
+// --------------------------------------------------------
+bool TextureStreamer::SetTopMip(unsigned int texture, unsigned int topMip, const unsigned char* newMips)
+{
+	const StreamingTexture& desc = policy[texture];
+	StreamedTexture& t = textures[texture];
+	unsigned int oldTopMip = resident[texture];
+
+	D3D11_TEXTURE2D_DESC texDesc = {};
+	texDesc.Width = desc.Width >> topMip;
+	texDesc.Height = desc.Height >> topMip;
+	texDesc.MipLevels = desc.MipCount - topMip;
+	texDesc.ArraySize = 1;
+	texDesc.Format = (DXGI_FORMAT)GetCookedDXGIFormat(desc.Format);
+	texDesc.SampleDesc.Count = 1;
+	texDesc.Usage = D3D11_USAGE_DEFAULT;
+	texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> newTexture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> newSRV;
+	if (FAILED(device->CreateTexture2D(&texDesc, 0, newTexture.GetAddressOf())) ||
+		FAILED(device->CreateShaderResourceView(newTexture.Get(), 0, newSRV.GetAddressOf())))
+		return false;
+
+	// Upload the new mips
+	size_t offset = 0;
+	for (unsigned int mip = topMip; mip < oldTopMip; mip++)
+	{
+		unsigned int rows = (((desc.Height >> mip) > 0 ? desc.Height >> mip : 1) + 3) / 4;
+		size_t size = GetCookedMipSize(desc.Width, desc.Height, desc.Format, mip);
+		context->UpdateSubresource(newTexture.Get(), mip - topMip, 0, newMips + offset, (UINT)(size / rows), 0);
+		offset += size;
+	}
+
+	// Copy the rest from the old texture
+	for (unsigned int mip = (std::max)(topMip, oldTopMip); mip < desc.MipCount; mip++)
+		context->CopySubresourceRegion(newTexture.Get(), mip - topMip, 0, 0, 0, t.Texture.Get(), mip - oldTopMip, 0);
+
+	// Swap it in everywhere, forgetting materials that are gone
+	auto binding = t.Bindings.begin();
+	while (binding != t.Bindings.end())
+	{
+		std::shared_ptr<Material> material = binding->first.lock();
+		if (!material)
+		{
+			binding = t.Bindings.erase(binding);
+			continue;
+		}
+
+		material->RemoveTextureSRV(binding->second);
+		material->AddTextureSRV(binding->second, newSRV);
+		++binding;
+	}
+
+	if (t.SRV != t.Original)
+		textureBySRV.erase(t.SRV.Get());
+	textureBySRV[newSRV.Get()] = texture;
+
+	t.Texture = newTexture;
+	t.SRV = newSRV;
+	resident[texture] = topMip;
+	return true;
+}
+
+// --------------------------------------------------------
+// Reads requested mips from cooked files until stopped
+// --------------------------------------------------------
+void TextureStreamer::WorkerLoop()
+{
+	PROFILE_THREAD("Texture Streaming");
+	while (true)
+	{
+		LoadRequest request;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			requestReady.wait(lock, [&]() { return stopping || !requests.empty(); });
+			if (stopping)
+				return;
+
+			request = requests.front();
+			requests.pop_front();
+		}
+
+		PROFILE_SCOPE("Read Mips");
+
+		// Mips are stored most detailed first, so the ones
+		// needed are all together
+		const StreamingTexture& d = request.Desc;
+		size_t start = GetCookedMipOffset(d.Width, d.Height, d.Format, request.TopMip);
+		size_t end = GetCookedMipOffset(d.Width, d.Height, d.Format, request.Resident);
+
+		LoadResult result;
+		result.Texture = request.Texture;
+		result.TopMip = request.TopMip;
+		result.Resident = request.Resident;
+		result.Data.resize(end - start);
+
+		result.Succeeded = ReadAssetFileRange(request.Path, start, result.Data.size(), &result.Data[0]);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		results.push_back(std::move(result));
+	}
+}
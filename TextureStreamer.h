@@ -0,0 +1,148 @@
+#pragma once
+
+#include <d3d11.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <wrl/client.h> // Used for ComPtr
+
+#include "FileSystem.h"
+#include "Material.h"
+#include "TextureCooker.h"
+#include "TextureStreaming.h"
+
+// Limits on work per frame, to keep streaming from causing hitches
+#define TEXTURE_STREAMER_MAX_LOADS		4	// Reads in flight at once
+#define TEXTURE_STREAMER_MAX_UPLOADS	4	// Finished reads made into textures each frame
+
+// --------------------------------------------------------
+// Current state of the streamer
+// --------------------------------------------------------
+struct TextureStreamerStats
+{
+	unsigned int TextureCount = 0;
+	size_t ResidentBytes = 0;
+	size_t FullBytes = 0;				// With every mip resident
+	size_t Budget = 0;
+	unsigned int LoadsInFlight = 0;
+	unsigned long long MipLoads = 0;	// Individual mips read, ever
+	unsigned long long Evictions = 0;	// Textures dropped to fewer mips, ever
+	double SatisfiedPercent = 0;		// Of visible textures with their required mip resident
+	double UpdateTime = 0;				// Milliseconds for the last Update()
+};
+
+// --------------------------------------------------------
+// Streams the mips of cooked textures from disk based on
+// how large they are on screen, keeping everything within
+// a memory budget (see ChooseResidentMips() for the policy).
+//
+// Textures start with only their lowest mips resident.
+// Each frame, feedback says how large each material is on
+// screen, and Update() evicts mips that are no longer
+// needed and streams in needed ones on worker threads.
+//
+// D3D 11 can't add or remove mips of a texture in place,
+// so each change makes a new texture (copying the mips it
+// shares with the old one on the GPU) and swaps it into
+// every material using it.  The original low mip texture
+// is kept only to identify the texture when materials are
+// tracked.
+// --------------------------------------------------------
+class TextureStreamer
+{
+public:
+	TextureStreamer(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		size_t budget,
+		unsigned int workerCount);
+	~TextureStreamer();
+
+	// Creates a texture with only its lowest mips resident,
+	// from the bytes of its cooked file (which the rest are
+	// streamed from).  Returns null if it's too small to
+	// bother streaming.
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Create(
+		const std::wstring& cookedPath,
+		const AssetFile& cooked,
+		const CookedTextureInfo& info);
+
+	// Keeps a material's texture up to date as it streams (if
+	// it's one of ours)
+	void Track(std::shared_ptr<Material> material, const std::string& name);
+
+	// Feedback for the frame, before Update()
+	void BeginFeedback();
+	void AddFeedback(Material* material, float pixelsAcross);
+
+	// Evicts, finishes loads and starts new ones
+	void Update();
+
+	void SetBudget(size_t budget) { this->budget = budget; }
+	TextureStreamerStats GetStats();
+
+private:
+	struct StreamedTexture
+	{
+		std::wstring CookedPath;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> Texture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Original;
+		std::vector<std::pair<std::weak_ptr<Material>, std::string>> Bindings;
+	};
+	struct TrackedMaterial
+	{
+		std::weak_ptr<Material> Material;
+		std::vector<unsigned int> Textures;
+	};
+
+	// Reads of mips [TopMip, Resident) from a cooked file
+	struct LoadRequest
+	{
+		unsigned int Texture;
+		std::wstring Path;
+		StreamingTexture Desc;
+		unsigned int TopMip;
+		unsigned int Resident;
+	};
+	struct LoadResult
+	{
+		unsigned int Texture;
+		unsigned int TopMip;
+		unsigned int Resident;
+		bool Succeeded;
+		std::vector<unsigned char> Data;
+	};
+
+	bool SetTopMip(unsigned int texture, unsigned int topMip, const unsigned char* newMips);
+	void WorkerLoop();
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	size_t budget;
+
+	// Every texture, along with its residency (in parallel
+	// arrays, as the policy functions expect)
+	std::vector<StreamedTexture> textures;
+	std::vector<StreamingTexture> policy;
+	std::vector<unsigned int> resident;
+	std::vector<unsigned int> targets;
+	std::vector<bool> loading;
+	std::unordered_map<ID3D11ShaderResourceView*, unsigned int> textureBySRV;
+	std::unordered_map<Material*, TrackedMaterial> materials;
+
+	TextureStreamerStats stats;
+
+	// Worker threads and their queues
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable requestReady;
+	std::deque<LoadRequest> requests;
+	std::deque<LoadResult> results;
+	bool stopping;
+};
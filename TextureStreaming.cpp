@@ -0,0 +1,392 @@
+#include "TextureStreaming.h"
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <math.h>
+#include <queue>
+
+// --------------------------------------------------------
+// Describes a cooked texture for streaming.  Its lowest mip
+// is the first that fits TEXTURE_STREAMING_RESIDENT_SIZE,
+// but never past a mip that couldn't be the top of a block
+// compressed texture (which needs a multiple of 4 in each
+// dimension).
+// --------------------------------------------------------
+StreamingTexture MakeStreamingTexture(unsigned int width, unsigned int height, unsigned int format)
+{
+	StreamingTexture texture;
+	texture.Width = width;
+	texture.Height = height;
+	texture.Format = format;
+	texture.MipCount = GetCookedMipCount(width, height);
+
+	unsigned int mip = 0;
+	while (((width >> mip) > TEXTURE_STREAMING_RESIDENT_SIZE || (height >> mip) > TEXTURE_STREAMING_RESIDENT_SIZE) &&
+		(width >> (mip + 1)) % 4 == 0 && (width >> (mip + 1)) > 0 &&
+		(height >> (mip + 1)) % 4 == 0 && (height >> (mip + 1)) > 0)
+		mip++;
+
+	texture.LowestMip = mip;
+	texture.RequiredMip = mip;
+	return texture;
+}
+
+// --------------------------------------------------------
+// Bytes of blocks for a texture with the given mip (and all
+// less detailed ones) resident
+// --------------------------------------------------------
+size_t GetStreamingResidentSize(const StreamingTexture& texture, unsigned int topMip)
+{
+	size_t size = 0;
+	for (unsigned int mip = topMip; mip < texture.MipCount; mip++)
+		size += GetCookedMipSize(texture.Width, texture.Height, texture.Format, mip);
+	return size;
+}
+
+// --------------------------------------------------------
+// Estimates how many pixels tall a sphere is on screen, or
+// returns zero if it's entirely behind the camera.  Being
+// inside the sphere counts as filling the screen.
+// --------------------------------------------------------
+float GetSphereScreenSize(
+	const DirectX::XMFLOAT3& center,
+	float radius,
+	const DirectX::XMFLOAT3& cameraPosition,
+	const DirectX::XMFLOAT3& cameraForward,
+	float fieldOfView,
+	float screenHeight)
+{
+	float x = center.x - cameraPosition.x;
+	float y = center.y - cameraPosition.y;
+	float z = center.z - cameraPosition.z;
+	float distanceSquared = x * x + y * y + z * z;
+	if (distanceSquared <= radius * radius)
+		return screenHeight;
+
+	if (x * cameraForward.x + y * cameraForward.y + z * cameraForward.z < -radius)
+		return 0;
+
+	// Tangent of the sphere's angular radius, compared to the
+	// tangent of half the field of view
+	float tangent = radius / sqrtf(distanceSquared - radius * radius);
+	return tangent / tanf(fieldOfView * 0.5f) * screenHeight;
+}
+
+// --------------------------------------------------------
+// Clears feedback before a new frame's is added, leaving
+// every texture unseen
+// --------------------------------------------------------
+void ResetStreamingFeedback(std::vector<StreamingTexture>& textures)
+{
+	for (auto& t : textures)
+	{
+		t.RequiredMip = t.LowestMip;
+		t.Priority = 0;
+	}
+}
+
+// --------------------------------------------------------
+// Adds a use of a texture on something the given number of
+// pixels across.  Its texels are assumed to span that once
+// (times the UV scale), and the mip needed is the first
+// with no more than 2 texels per pixel.
+// --------------------------------------------------------
+void AddStreamingFeedback(StreamingTexture& texture, float pixelsAcross, float uvScale)
+{
+	if (pixelsAcross <= 0)
+		return;
+
+	float texelsAcross = (std::max)(texture.Width, texture.Height) * uvScale;
+	float ratio = texelsAcross / pixelsAcross;
+	unsigned int mip = ratio > 2.0f ? (unsigned int)log2f(ratio) : 0;
+
+	texture.RequiredMip = (std::min)(texture.RequiredMip, (std::min)(mip, texture.LowestMip));
+	texture.Priority = (std::max)(texture.Priority, pixelsAcross);
+}
+
+// --------------------------------------------------------
+// Chooses the mip each texture should have resident.  If
+// every required mip fits the budget, those are the ones.
+// Otherwise mips are dropped one at a time from whichever
+// texture gives the fewest pixels on screen per byte of
+// its top mip, until everything fits or only the lowest
+// mips remain.
+//
+// textures - Including this frame's feedback
+// budget   - Bytes for every texture together
+// targets  - Receives the mip for each texture
+// --------------------------------------------------------
+void ChooseResidentMips(const std::vector<StreamingTexture>& textures, size_t budget, std::vector<unsigned int>* targets)
+{
+	targets->resize(textures.size());
+
+	size_t total = 0;
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		(*targets)[i] = (std::min)(textures[i].RequiredMip, textures[i].LowestMip);
+		total += GetStreamingResidentSize(textures[i], (*targets)[i]);
+	}
+
+	// Least valuable first, with ties broken by index so
+	// the result never depends on anything but the input
+	typedef std::pair<double, unsigned int> Candidate;
+	std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+	auto value = [&](unsigned int i)
+	{
+		const StreamingTexture& t = textures[i];
+		return t.Priority / (double)GetCookedMipSize(t.Width, t.Height, t.Format, (*targets)[i]);
+	};
+
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		if ((*targets)[i] < textures[i].LowestMip)
+			candidates.push(Candidate(value(i), i));
+	}
+
+	while (total > budget && !candidates.empty())
+	{
+		unsigned int i = candidates.top().second;
+		candidates.pop();
+
+		const StreamingTexture& t = textures[i];
+		total -= GetCookedMipSize(t.Width, t.Height, t.Format, (*targets)[i]);
+		(*targets)[i]++;
+
+		if ((*targets)[i] < t.LowestMip)
+			candidates.push(Candidate(value(i), i));
+	}
+}
+
+// --------------------------------------------------------
+// Chooses which textures to start loading more mips of:
+// those below their target that aren't already loading,
+// largest on screen first
+//
+// loads - Receives up to maxLoads texture indices
+// --------------------------------------------------------
+void ChooseStreamingLoads(
+	const std::vector<StreamingTexture>& textures,
+	const std::vector<unsigned int>& targets,
+	const std::vector<unsigned int>& resident,
+	const std::vector<bool>& loading,
+	unsigned int maxLoads,
+	std::vector<unsigned int>* loads)
+{
+	loads->clear();
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		if (targets[i] < resident[i] && !loading[i])
+			loads->push_back(i);
+	}
+
+	std::stable_sort(loads->begin(), loads->end(), [&](unsigned int a, unsigned int b) { return textures[a].Priority > textures[b].Priority; });
+	if (loads->size() > maxLoads)
+		loads->resize(maxLoads);
+}
+
+
+// === SIMULATION ===================================================
+
+// --------------------------------------------------------
+// Simulates streaming along a camera path, following the
+// same steps as the streamer each frame:
+//  - Gathers feedback and chooses resident mips
+//  - Drops mips from textures over their target right away
+//  - Finishes loads started LoadLatency frames ago
+//  - Starts new loads
+//
+// Loads go straight from the resident mip to the target at
+// the time, and finish at whatever the target is by then.
+// --------------------------------------------------------
+void SimulateTextureStreaming(
+	const std::vector<StreamingTexture>& sourceTextures,
+	const std::vector<StreamingObject>& objects,
+	const std::vector<DirectX::XMFLOAT3>& cameraPath,
+	const StreamingSimulationSettings& settings,
+	StreamingSimulationResults* results)
+{
+	*results = StreamingSimulationResults();
+
+	std::vector<StreamingTexture> textures = sourceTextures;
+	std::vector<unsigned int> resident(textures.size());
+	std::vector<unsigned int> loadMip(textures.size());
+	std::vector<unsigned int> loadFinish(textures.size());
+	std::vector<bool> loading(textures.size(), false);
+	for (size_t i = 0; i < textures.size(); i++)
+		resident[i] = textures[i].LowestMip;
+
+	std::vector<unsigned int> targets;
+	std::vector<unsigned int> loads;
+	double totalBytes = 0;
+	unsigned long long visible = 0;
+	unsigned long long satisfied = 0;
+	unsigned long long mipsMissing = 0;
+
+	for (unsigned int frame = 0; frame < cameraPath.size(); frame++)
+	{
+		// Look from this point towards the next
+		DirectX::XMFLOAT3 position = cameraPath[frame];
+		DirectX::XMFLOAT3 next = cameraPath[(std::min)(frame + 1, (unsigned int)cameraPath.size() - 1)];
+		DirectX::XMFLOAT3 forward(next.x - position.x, next.y - position.y, next.z - position.z);
+		float length = sqrtf(forward.x * forward.x + forward.y * forward.y + forward.z * forward.z);
+		if (length > 0)
+			forward = DirectX::XMFLOAT3(forward.x / length, forward.y / length, forward.z / length);
+		else
+			forward = DirectX::XMFLOAT3(0, 0, 1);
+
+		ResetStreamingFeedback(textures);
+		for (auto& o : objects)
+		{
+			float pixels = GetSphereScreenSize(o.Center, o.Radius, position, forward, settings.FieldOfView, settings.ScreenHeight);
+			for (unsigned int t : o.Textures)
+				AddStreamingFeedback(textures[t], pixels, o.UVScale);
+		}
+		ChooseResidentMips(textures, settings.Budget, &targets);
+
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			// Evict
+			if (targets[i] > resident[i])
+			{
+				resident[i] = targets[i];
+				results->Evictions++;
+			}
+
+			// Finish loading, unless the target has since dropped
+			// to what's already resident
+			if (loading[i] && loadFinish[i] <= frame)
+			{
+				loading[i] = false;
+				resident[i] = (std::min)(resident[i], (std::max)(loadMip[i], targets[i]));
+			}
+		}
+
+		ChooseStreamingLoads(textures, targets, resident, loading, settings.LoadsPerFrame, &loads);
+		for (unsigned int i : loads)
+		{
+			loading[i] = true;
+			loadMip[i] = targets[i];
+			loadFinish[i] = frame + settings.LoadLatency;
+			results->MipLoads += resident[i] - targets[i];
+		}
+
+		// Totals
+		size_t bytes = 0;
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			bytes += GetStreamingResidentSize(textures[i], resident[i]);
+			if (textures[i].Priority <= 0)
+				continue;
+
+			visible++;
+			if (resident[i] <= textures[i].RequiredMip)
+				satisfied++;
+			else
+				mipsMissing += resident[i] - textures[i].RequiredMip;
+		}
+
+		results->PeakBytes = (std::max)(results->PeakBytes, bytes);
+		results->FramesOverBudget += bytes > settings.Budget ? 1 : 0;
+		totalBytes += bytes;
+	}
+
+	results->FrameCount = (unsigned int)cameraPath.size();
+	if (results->FrameCount > 0)
+		results->AverageBytes = totalBytes / results->FrameCount;
+	if (visible > 0)
+		results->SatisfiedPercent = 100.0 * satisfied / visible;
+	if (visible > satisfied)
+		results->AverageMipsMissing = (double)mipsMissing / (visible - satisfied);
+}
+
+
+// === SIMULATION TESTS =============================================
+
+// --------------------------------------------------------
+// Tests the streaming policy on the CPU: a large scene of
+// spheres sharing 60 textures, viewed along several camera
+// paths at several budgets.  Everything comes from a fixed
+// seed, so every run simulates exactly the same frames.
+//
+// fieldOfView  - Of the simulated camera, in radians
+// screenHeight - In pixels
+// results      - Filled in with one result per path and budget
+// --------------------------------------------------------
+void RunTextureStreamingSimulation(float fieldOfView, float screenHeight, std::vector<TextureStreamingResult>* results)
+{
+	results->clear();
+
+	// Simple LCG, so the results don't depend on rand()
+	unsigned int seed = 24680;
+	auto random = [&seed](float min, float max)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return min + (seed >> 8) / 16777216.0f * (max - min);
+	};
+
+	// 20 materials, each an albedo, normal and packed map
+	std::vector<StreamingTexture> textures;
+	unsigned int sizes[] = { 512, 1024, 2048 };
+	for (unsigned int m = 0; m < 20; m++)
+	{
+		unsigned int size = sizes[m % 3];
+		textures.push_back(MakeStreamingTexture(size, size, TEXTURE_COOK_BC7));
+		textures.push_back(MakeStreamingTexture(size, size, TEXTURE_COOK_BC5));
+		textures.push_back(MakeStreamingTexture(size, size, TEXTURE_COOK_BC5_LINEAR));
+	}
+
+	// 2000 spheres across a 200x200 area
+	std::vector<StreamingObject> objects(2000);
+	for (auto& o : objects)
+	{
+		unsigned int m = (unsigned int)random(0, 19.99f);
+		o.Center = DirectX::XMFLOAT3(random(-100, 100), random(0, 5), random(-100, 100));
+		o.Radius = random(0.5f, 3.0f);
+		o.UVScale = random(0, 1) > 0.5f ? 2.0f : 1.0f;
+		o.Textures = { m * 3, m * 3 + 1, m * 3 + 2 };
+	}
+
+	// Camera paths of 1000 frames each: flying straight across,
+	// orbiting the middle, and jumping to a new spot every second
+	const unsigned int frames = 1000;
+	std::vector<DirectX::XMFLOAT3> paths[3];
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		float t = f / (float)frames;
+		paths[0].push_back(DirectX::XMFLOAT3(-100 + t * 200, 2, sinf(t * DirectX::XM_2PI * 3) * 20));
+		paths[1].push_back(DirectX::XMFLOAT3(cosf(t * DirectX::XM_2PI) * 60, 10, sinf(t * DirectX::XM_2PI) * 60));
+	}
+	for (unsigned int f = 0; f < frames; f += 60)
+	{
+		DirectX::XMFLOAT3 from(random(-100, 100), 2, random(-100, 100));
+		DirectX::XMFLOAT3 to(from.x + random(-1, 1), 2, from.z + random(-1, 1));
+		for (unsigned int i = 0; i < 60 && f + i < frames; i++)
+			paths[2].push_back(i < 59 ? from : to);
+	}
+	const char* pathNames[] = { "Fly Through", "Orbit", "Teleports" };
+
+	unsigned int budgets[] = { 16, 32, 64, 128 };
+	for (int p = 0; p < 3; p++)
+	{
+		for (unsigned int budget : budgets)
+		{
+			StreamingSimulationSettings settings;
+			settings.Budget = (size_t)budget * 1024 * 1024;
+			settings.FieldOfView = fieldOfView;
+			settings.ScreenHeight = screenHeight;
+
+			TextureStreamingResult result = {};
+			result.PathName = pathNames[p];
+			result.BudgetMB = budget;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			SimulateTextureStreaming(textures, objects, paths[p], settings, &result.Results);
+			auto end = std::chrono::high_resolution_clock::now();
+			result.Time = std::chrono::duration<double, std::milli>(end - start).count();
+
+			results->push_back(result);
+		}
+	}
+}
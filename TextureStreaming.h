@@ -0,0 +1,116 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <stddef.h>
+#include <vector>
+
+// Mips this size (in their largest dimension) and smaller
+// are always resident, so every texture has something to show
+#define TEXTURE_STREAMING_RESIDENT_SIZE	64
+
+// --------------------------------------------------------
+// What the residency policy knows about one streamed
+// (cooked) texture.  Mips are numbered as usual, so a lower
+// mip is a more detailed one.
+// --------------------------------------------------------
+struct StreamingTexture
+{
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	unsigned int Format = 0;		// A TEXTURE_COOK_ value
+	unsigned int MipCount = 0;
+	unsigned int LowestMip = 0;		// Most detailed mip that's always resident
+
+	// This frame's feedback
+	unsigned int RequiredMip = 0;	// Most detailed mip anything needs
+	float Priority = 0;				// Largest size on screen, in pixels (0 if unseen)
+};
+
+// Describing a texture, and the bytes it uses with a given
+// mip (and everything below it) resident
+StreamingTexture MakeStreamingTexture(unsigned int width, unsigned int height, unsigned int format);
+size_t GetStreamingResidentSize(const StreamingTexture& texture, unsigned int topMip);
+
+// Feedback: how large something is on screen, and so which
+// mip its textures need
+float GetSphereScreenSize(
+	const DirectX::XMFLOAT3& center,
+	float radius,
+	const DirectX::XMFLOAT3& cameraPosition,
+	const DirectX::XMFLOAT3& cameraForward,
+	float fieldOfView,
+	float screenHeight);
+void ResetStreamingFeedback(std::vector<StreamingTexture>& textures);
+void AddStreamingFeedback(StreamingTexture& texture, float pixelsAcross, float uvScale);
+
+// The policy itself: which mip each texture should have
+// resident to fit the budget, and which textures to load
+// more of next
+void ChooseResidentMips(const std::vector<StreamingTexture>& textures, size_t budget, std::vector<unsigned int>* targets);
+void ChooseStreamingLoads(
+	const std::vector<StreamingTexture>& textures,
+	const std::vector<unsigned int>& targets,
+	const std::vector<unsigned int>& resident,
+	const std::vector<bool>& loading,
+	unsigned int maxLoads,
+	std::vector<unsigned int>* loads);
+
+
+// === SIMULATION ===================================================
+
+// --------------------------------------------------------
+// Something in a simulated scene: a sphere drawn with some
+// of the simulation's textures
+// --------------------------------------------------------
+struct StreamingObject
+{
+	DirectX::XMFLOAT3 Center;
+	float Radius;
+	float UVScale;
+	std::vector<unsigned int> Textures;
+};
+
+struct StreamingSimulationSettings
+{
+	size_t Budget = 64 * 1024 * 1024;
+	unsigned int LoadsPerFrame = 4;		// New loads started each frame
+	unsigned int LoadLatency = 3;		// Frames for a load to finish
+	float FieldOfView = 0.785f;
+	float ScreenHeight = 720.0f;
+};
+
+struct StreamingSimulationResults
+{
+	unsigned int FrameCount = 0;
+	size_t PeakBytes = 0;
+	double AverageBytes = 0;
+	unsigned int FramesOverBudget = 0;	// Should be zero unless the lowest mips alone don't fit
+	unsigned long long MipLoads = 0;	// Individual mips read
+	unsigned long long Evictions = 0;	// Textures dropped to fewer mips
+	double SatisfiedPercent = 0;		// Of visible textures with their required mip resident
+	double AverageMipsMissing = 0;		// For visible textures that didn't
+};
+
+// Runs the same policy the streamer uses along a camera
+// path, one position per frame (looking along the path)
+void SimulateTextureStreaming(
+	const std::vector<StreamingTexture>& textures,
+	const std::vector<StreamingObject>& objects,
+	const std::vector<DirectX::XMFLOAT3>& cameraPath,
+	const StreamingSimulationSettings& settings,
+	StreamingSimulationResults* results);
+
+// --------------------------------------------------------
+// Results of simulating one camera path at one budget
+// --------------------------------------------------------
+struct TextureStreamingResult
+{
+	const char* PathName;
+	unsigned int BudgetMB;
+	StreamingSimulationResults Results;
+	double Time;				// Milliseconds for the whole simulation
+};
+
+// Simulates a fixed test scene along several camera paths,
+// at several budgets
+void RunTextureStreamingSimulation(float fieldOfView, float screenHeight, std::vector<TextureStreamingResult>* results);
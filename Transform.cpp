@@ -7,6 +7,9 @@ Transform::Transform() :
 	position(0, 0, 0),
 	pitchYawRoll(0, 0, 0),
 	scale(1, 1, 1),
+	previousPosition(0, 0, 0),
+	previousPitchYawRoll(0, 0, 0),
+	previousScale(1, 1, 1),
 	up(0, 1, 0),
 	right(1, 0, 0),
 	forward(0, 0, 1),
@@ -184,6 +187,30 @@ DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
 	return worldMatrix;
 }
 
+void Transform::SavePreviousState()
+{
+	previousPosition = position;
+	previousPitchYawRoll = pitchYawRoll;
+	previousScale = scale;
+}
+
+// --------------------------------------------------------
+// Sets another transform partway between this one's
+// previous state (alpha of 0) and its current state (1).
+// The angles are blended directly, which suits the small
+// change from one step to the next.
+// --------------------------------------------------------
+void Transform::Interpolate(float alpha, Transform* result)
+{
+	XMFLOAT3 p, r, s;
+	XMStoreFloat3(&p, XMVectorLerp(XMLoadFloat3(&previousPosition), XMLoadFloat3(&position), alpha));
+	XMStoreFloat3(&r, XMVectorLerp(XMLoadFloat3(&previousPitchYawRoll), XMLoadFloat3(&pitchYawRoll), alpha));
+	XMStoreFloat3(&s, XMVectorLerp(XMLoadFloat3(&previousScale), XMLoadFloat3(&scale), alpha));
+	result->SetPosition(p);
+	result->SetRotation(r);
+	result->SetScale(s);
+}
+
 void Transform::UpdateMatrices()
 {
 	// Anything to update?
@@ -41,12 +41,23 @@ public:
 	DirectX::XMFLOAT4X4 GetWorldMatrix();
 	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix();
 
+	// Interpolation between fixed simulation steps: save the
+	// state before each step, then draw somewhere between it
+	// and the current state
+	void SavePreviousState();
+	void Interpolate(float alpha, Transform* result);
+
 private:
 	// Raw transformation data
 	DirectX::XMFLOAT3 position;
 	DirectX::XMFLOAT3 pitchYawRoll;
 	DirectX::XMFLOAT3 scale;
 
+	// The same, as of the last SavePreviousState()
+	DirectX::XMFLOAT3 previousPosition;
+	DirectX::XMFLOAT3 previousPitchYawRoll;
+	DirectX::XMFLOAT3 previousScale;
+
 	// Local orientation vectors
 	bool vectorsDirty;
 	DirectX::XMFLOAT3 up;
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+// --------------------------------------------------------
+// Outcome of one validation test, over every round
+// --------------------------------------------------------
+struct ValidationResult
+{
+	const char* Name;
+	bool Passed;
+	double Time;		// Milliseconds for every round
+};
+
+// --------------------------------------------------------
+// A named test, taking whatever its suite passes to all of
+// its tests (nothing, or the job system to use, etc.)
+// --------------------------------------------------------
+template<typename... Args>
+struct ValidationTest
+{
+	const char* Name;
+	bool(*Run)(Args...);
+};
+
+// --------------------------------------------------------
+// Runs every test of a suite for a number of rounds,
+// stopping a test at its first failure
+//
+// tests   - The suite's table of tests
+// rounds  - Times to repeat each test
+// results - Receives a result per test
+// args    - Passed to every test
+// --------------------------------------------------------
+template<typename Test, size_t TestCount, typename... Args>
+void RunValidationTests(const Test(&tests)[TestCount], unsigned int rounds, std::vector<ValidationResult>* results, Args&&... args)
+{
+	results->clear();
+	for (const Test& test : tests)
+	{
+		ValidationResult result;
+		result.Name = test.Name;
+		result.Passed = true;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int r = 0; r < rounds && result.Passed; r++)
+			result.Passed = test.Run(args...);
+		result.Time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		results->push_back(result);
+	}
+}
@@ -1,9 +1,14 @@
 
-// Constant Buffer for external (C++) data
-cbuffer externalData : register(b0)
+// Constant Buffer for per-object (C++) data
+cbuffer perObject : register(b0)
 {
 	matrix world;
 	matrix worldInverseTranspose;
+};
+
+// Constant Buffer for per-frame data, shared with the sky
+cbuffer perFrame : register(b1)
+{
 	matrix view;
 	matrix projection;
 };